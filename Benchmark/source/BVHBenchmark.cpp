@@ -0,0 +1,508 @@
+#include "BVHBenchmark.h"
+#include "../../LibGame/source/BoundingBox.h"
+
+#include <algorithm>
+#include <cmath>
+
+CBVHBenchmark::CBVHBenchmark()
+{
+	m_bQueriesValid = false;
+}
+
+void CBVHBenchmark::Initialize(GLint iRuns, GLuint uiSeed)
+{
+	SetRuns(iRuns, uiSeed);
+	m_vResults.clear();
+	m_bQueriesValid = false;
+}
+
+void CBVHBenchmark::Run()
+{
+	m_bQueriesValid = CheckQueries();
+
+	for (const GLint iObjects : BENCHMARK_BVH_SIZES)
+	{
+		BenchmarkSize(iObjects);
+	}
+}
+
+/*
+ * CreateBoxes - Random world boxes of area objects.
+ * @eScene: Uniform, clustered or stacked.
+ * @iObjects: Number of boxes.
+ * @fWorldSize: Side of the square the boxes are spread over.
+ * @vBoxes: Receives the boxes.
+ *
+ * One box in 50 is large, like a building among props.
+ */
+void CBVHBenchmark::CreateBoxes(EBVHScene eScene, GLint iObjects, GLfloat fWorldSize, std::vector<TCullBox>& vBoxes)
+{
+	std::uniform_real_distribution<GLfloat> distWorld(0.0f, fWorldSize);
+	std::uniform_real_distribution<GLfloat> distHeight(0.0f, 100.0f);
+	std::uniform_real_distribution<GLfloat> distCluster(-30.0f, 30.0f);
+	std::uniform_real_distribution<GLfloat> distExtent(1.0f, 12.0f);
+	std::uniform_real_distribution<GLfloat> distLargeExtent(40.0f, 160.0f);
+
+	SVector3Df v3Clusters[8];
+	for (SVector3Df& v3Cluster : v3Clusters)
+	{
+		v3Cluster = SVector3Df(distWorld(m_Random), 50.0f, distWorld(m_Random));
+	}
+
+	vBoxes.resize(iObjects);
+
+	for (GLint i = 0; i < iObjects; i++)
+	{
+		if (eScene == BVH_SCENE_STACKED && i % 4 != 0)
+		{
+			vBoxes[i] = vBoxes[i - i % 4];
+			continue;
+		}
+
+		if (eScene == BVH_SCENE_STACKED && i % 200 == 0)
+		{
+			vBoxes[i] = TCullBox(SVector3Df(-FLT_MAX, -FLT_MAX, -FLT_MAX), SVector3Df(FLT_MAX, FLT_MAX, FLT_MAX));
+			continue;
+		}
+
+		SVector3Df v3Center;
+		if (eScene == BVH_SCENE_CLUSTERED)
+		{
+			v3Center = v3Clusters[i % 8] + SVector3Df(distCluster(m_Random), distCluster(m_Random), distCluster(m_Random));
+		}
+		else
+		{
+			v3Center = SVector3Df(distWorld(m_Random), distHeight(m_Random), distWorld(m_Random));
+		}
+
+		const SVector3Df v3Extent = (i % 50 == 0) ?
+			SVector3Df(distLargeExtent(m_Random), distExtent(m_Random), distLargeExtent(m_Random)) * 0.5f :
+			SVector3Df(distExtent(m_Random), distExtent(m_Random), distExtent(m_Random)) * 0.5f;
+
+		vBoxes[i] = TCullBox(v3Center - v3Extent, v3Center + v3Extent);
+	}
+}
+
+/*
+ * MoveBoxes - Moves one box in iMoveEvery, like edits to a placed area.
+ * @bTeleport: Half of the boxes are carried anywhere in the world instead
+ *             of nudged, which leaves their old nodes far too large.
+ * @vMoved: Receives the moved boxes.
+ */
+void CBVHBenchmark::MoveBoxes(std::vector<TCullBox>& vBoxes, GLint iMoveEvery, GLfloat fWorldSize, bool bTeleport, std::vector<GLuint>& vMoved)
+{
+	std::uniform_real_distribution<GLfloat> distWorld(0.0f, fWorldSize);
+	std::uniform_real_distribution<GLfloat> distNudge(-5.0f, 5.0f);
+	std::uniform_int_distribution<GLint> distFirst(0, iMoveEvery - 1);
+
+	vMoved.clear();
+
+	for (GLint i = distFirst(m_Random); i < static_cast<GLint>(vBoxes.size()); i += iMoveEvery)
+	{
+		TCullBox& rBox = vBoxes[i];
+		if (rBox.v3Min.x == -FLT_MAX)
+		{
+			continue;
+		}
+
+		SVector3Df v3Offset(distNudge(m_Random), distNudge(m_Random), distNudge(m_Random));
+		if (bTeleport && (vMoved.size() & 1))
+		{
+			v3Offset = SVector3Df(distWorld(m_Random), 50.0f, distWorld(m_Random)) - rBox.v3Min;
+		}
+
+		rBox.v3Min += v3Offset;
+		rBox.v3Max += v3Offset;
+		vMoved.push_back(static_cast<GLuint>(i));
+	}
+}
+
+void CBVHBenchmark::CreateRays(GLint iRays, GLfloat fWorldSize, GLfloat fRange, std::vector<CRay>& vRays)
+{
+	std::uniform_real_distribution<GLfloat> distWorld(0.0f, fWorldSize);
+	std::uniform_real_distribution<GLfloat> distHeight(0.0f, 100.0f);
+	std::uniform_real_distribution<GLfloat> distCameraHeight(120.0f, 300.0f);
+	std::uniform_real_distribution<GLfloat> distAim(-0.25f * fRange, 0.25f * fRange);
+	std::uniform_int_distribution<GLint> distAxis(0, 5);
+
+	vRays.clear();
+	vRays.reserve(iRays);
+
+	for (GLint i = 0; i < iRays; i++)
+	{
+		SVector3Df v3Origin(distWorld(m_Random), (i % 4 == 0) ? distHeight(m_Random) : distCameraHeight(m_Random), distWorld(m_Random));
+		SVector3Df v3Dir;
+
+		if (i % 16 == 0)
+		{
+			const GLint iAxis = distAxis(m_Random);
+			v3Dir = SVector3Df(0.0f, 0.0f, 0.0f);
+			v3Dir[iAxis / 2] = (iAxis & 1) ? -1.0f : 1.0f;
+		}
+		else
+		{
+			const SVector3Df v3Target(v3Origin.x + distAim(m_Random), distHeight(m_Random), v3Origin.z + distAim(m_Random));
+			v3Dir = v3Target - v3Origin;
+		}
+
+		vRays.push_back(CRay(v3Origin, v3Dir, fRange));
+	}
+}
+
+// FRUSTUM_PLANES_NUM planes per view, cameras above the world looking a little down
+void CBVHBenchmark::CreateFrustums(GLint iFrustums, GLfloat fWorldSize, std::vector<SVector4Df>& vPlanes)
+{
+	std::uniform_real_distribution<GLfloat> distWorld(0.0f, fWorldSize);
+	std::uniform_real_distribution<GLfloat> distHeight(50.0f, 300.0f);
+	std::uniform_real_distribution<GLfloat> distYaw(0.0f, 2.0f * 3.14159265f);
+	std::uniform_real_distribution<GLfloat> distPitch(0.1f, 0.6f);
+
+	CMatrix4Df matProjection{};
+	matProjection.InitPersProjTransform(TPersProjInfo{ 45.0f, 1600.0f, 960.0f, 1.0f, BENCHMARK_BVH_FAR_PLANE });
+
+	vPlanes.resize(static_cast<size_t>(iFrustums) * FRUSTUM_PLANES_NUM);
+
+	for (GLint i = 0; i < iFrustums; i++)
+	{
+		const SVector3Df v3Eye(distWorld(m_Random), distHeight(m_Random), distWorld(m_Random));
+		const GLfloat fYaw = distYaw(m_Random);
+
+		CMatrix4Df matView{};
+		matView.InitCameraTransform(v3Eye, SVector3Df(std::cos(fYaw), -distPitch(m_Random), std::sin(fYaw)).normalize(), SVector3Df(0.0f, 1.0f, 0.0f));
+
+		SFrustumCulling(matProjection * matView).GetPlanes(&vPlanes[static_cast<size_t>(i) * FRUSTUM_PLANES_NUM]);
+	}
+}
+
+// What CTerrainAreaData::PickObject would do without the tree, items i % iRejectEvery == 0 and unbounded ones are skipped
+GLint CBVHBenchmark::RaycastBruteForce(const std::vector<TCullBox>& vBoxes, const CRay& ray, GLfloat* pfDistance, GLint iRejectEvery)
+{
+	GLint iClosestItem = -1;
+	GLfloat fClosestT = FLT_MAX;
+
+	const SVector3Df v3InvDir = ray.GetInverseDirection();
+	GLfloat fT = 0.0f;
+
+	for (GLint i = 0; i < static_cast<GLint>(vBoxes.size()); i++)
+	{
+		if ((iRejectEvery > 0 && i % iRejectEvery == 0) || vBoxes[i].v3Min.x == -FLT_MAX)
+		{
+			continue;
+		}
+
+		if (SBoundingBox::IntersectRay(ray.GetOrigin(), v3InvDir, vBoxes[i].v3Min, vBoxes[i].v3Max, &fT) && fT <= ray.GetRayRange() && fT < fClosestT)
+		{
+			fClosestT = fT;
+			iClosestItem = i;
+		}
+	}
+
+	*pfDistance = fClosestT;
+	return (iClosestItem);
+}
+
+GLuint CBVHBenchmark::CullBruteForce(const std::vector<TCullBox>& vBoxes, const SVector4Df* pv4Planes, GLuint* puiVisible)
+{
+	SVector3Df v3AbsNormals[FRUSTUM_PLANES_NUM];
+	SFrustumCulling::GetAbsNormals(pv4Planes, v3AbsNormals);
+
+	GLuint uiVisible = 0;
+	for (GLuint i = 0; i < static_cast<GLuint>(vBoxes.size()); i++)
+	{
+		if (SFrustumCulling::IsCullBoxInside(vBoxes[i], pv4Planes, v3AbsNormals))
+		{
+			puiVisible[uiVisible++] = i;
+		}
+	}
+
+	return (uiVisible);
+}
+
+/*
+ * CheckTree - Raycast and CullFrustum against testing every box.
+ * @pszStage: Named in the error, build, refit or rebuild.
+ *
+ * Several boxes may be hit at the same distance, so the distances are
+ * compared rather than the items. Half of the rays skip some items through
+ * the accept function. The culled items are compared as sorted sets, an
+ * item reported twice fails too.
+ */
+bool CBVHBenchmark::CheckTree(const CBoundingVolumeHierarchy& bvh, const std::vector<TCullBox>& vBoxes, GLint iScene, const char* pszStage)
+{
+	if (bvh.GetItemsCount() != static_cast<GLuint>(vBoxes.size()))
+	{
+		sys_err("CBVHBenchmark::CheckTree: Scene %d %s, %u items instead of %u", iScene, pszStage, bvh.GetItemsCount(), static_cast<GLuint>(vBoxes.size()));
+		return (false);
+	}
+
+	std::vector<CRay> vRays;
+	CreateRays(BENCHMARK_BVH_CHECK_PICKS / 2, BENCHMARK_BVH_CHECK_WORLD_SIZE, 0.25f * BENCHMARK_BVH_CHECK_WORLD_SIZE, vRays);
+
+	std::vector<CRay> vLongRays;
+	CreateRays(BENCHMARK_BVH_CHECK_PICKS / 2, BENCHMARK_BVH_CHECK_WORLD_SIZE, 2.0f * BENCHMARK_BVH_CHECK_WORLD_SIZE, vLongRays);
+	vRays.insert(vRays.end(), vLongRays.begin(), vLongRays.end());
+
+	for (GLint iRay = 0; iRay < static_cast<GLint>(vRays.size()); iRay++)
+	{
+		const GLint iRejectEvery = (iRay & 1) ? 7 : 0;
+		const auto fnAccept = [&vBoxes, iRejectEvery](GLuint uiItem)
+		{
+			return (!(iRejectEvery > 0 && uiItem % iRejectEvery == 0) && vBoxes[uiItem].v3Min.x != -FLT_MAX);
+		};
+
+		GLfloat fExpectedT, fBVHT;
+		const GLint iExpected = RaycastBruteForce(vBoxes, vRays[iRay], &fExpectedT, iRejectEvery);
+		const GLint iItem = bvh.Raycast(vRays[iRay], &fBVHT, fnAccept);
+
+		if ((iItem < 0) != (iExpected < 0) || (iExpected >= 0 && fBVHT != fExpectedT))
+		{
+			sys_err("CBVHBenchmark::CheckTree: Scene %d %s ray %d, the tree hits at %f instead of %f", iScene, pszStage, iRay, fBVHT, fExpectedT);
+			return (false);
+		}
+	}
+
+	std::vector<SVector4Df> vPlanes;
+	CreateFrustums(BENCHMARK_BVH_CHECK_FRUSTUMS, BENCHMARK_BVH_CHECK_WORLD_SIZE, vPlanes);
+
+	std::vector<GLuint> vExpected(vBoxes.size()), vVisible(vBoxes.size());
+
+	for (GLint iFrustum = 0; iFrustum < BENCHMARK_BVH_CHECK_FRUSTUMS; iFrustum++)
+	{
+		const SVector4Df* pv4Planes = &vPlanes[static_cast<size_t>(iFrustum) * FRUSTUM_PLANES_NUM];
+
+		const GLuint uiExpected = CullBruteForce(vBoxes, pv4Planes, vExpected.data());
+		const GLuint uiVisible = bvh.CullFrustum(pv4Planes, vVisible.data());
+		std::sort(vVisible.begin(), vVisible.begin() + uiVisible);
+
+		if (uiVisible != uiExpected || !std::equal(vVisible.begin(), vVisible.begin() + uiVisible, vExpected.begin()))
+		{
+			sys_err("CBVHBenchmark::CheckTree: Scene %d %s frustum %d, %u items visible instead of %u", iScene, pszStage, iFrustum, uiVisible, uiExpected);
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * CheckQueries - The tree answers like testing every box.
+ *
+ * The first scenes hold no and a single object. Each scene is checked
+ * once built, after every round of moves and Refit, then built again from
+ * the moved boxes.
+ */
+bool CBVHBenchmark::CheckQueries()
+{
+	std::uniform_int_distribution<GLint> distObjects(2, BENCHMARK_BVH_CHECK_MAX_OBJECTS);
+
+	std::vector<TCullBox> vBoxes;
+	std::vector<GLuint> vMoved;
+
+	for (GLint iScene = 0; iScene < BENCHMARK_BVH_CHECK_SCENES; iScene++)
+	{
+		const EBVHScene eScene = static_cast<EBVHScene>(iScene % 3);
+		CreateBoxes(eScene, iScene < 2 ? iScene : distObjects(m_Random), BENCHMARK_BVH_CHECK_WORLD_SIZE, vBoxes);
+
+		CBoundingVolumeHierarchy bvh;
+		bvh.Build(vBoxes.data(), static_cast<GLuint>(vBoxes.size()));
+
+		if (!CheckTree(bvh, vBoxes, iScene, "build"))
+		{
+			return (false);
+		}
+
+		for (GLint iEdit = 0; iEdit < BENCHMARK_BVH_CHECK_EDITS; iEdit++)
+		{
+			MoveBoxes(vBoxes, 10, BENCHMARK_BVH_CHECK_WORLD_SIZE, true, vMoved);
+
+			for (const GLuint uiItem : vMoved)
+			{
+				bvh.SetItemBox(uiItem, vBoxes[uiItem]);
+			}
+
+			bvh.Refit();
+
+			if (!CheckTree(bvh, vBoxes, iScene, "refit"))
+			{
+				return (false);
+			}
+		}
+
+		bvh.Build(vBoxes.data(), static_cast<GLuint>(vBoxes.size()));
+
+		if (!CheckTree(bvh, vBoxes, iScene, "rebuild"))
+		{
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * BenchmarkSize - Build, refit and queries over one area of iObjects.
+ *
+ * The same rays and views go through the tree and through the test of
+ * every box, SFrustumCulling::CullBoxes being what CTerrainAreaData did
+ * before. The timed refits follow small moves, the check covers the far
+ * ones that make Refit build again. The moves themselves are not timed.
+ */
+void CBVHBenchmark::BenchmarkSize(GLint iObjects)
+{
+	TBVHBenchmarkResult result;
+	result.iObjects = iObjects;
+
+	std::vector<TCullBox> vBoxes;
+	CreateBoxes(BVH_SCENE_UNIFORM, iObjects, BENCHMARK_BVH_WORLD_SIZE, vBoxes);
+
+	CBoundingVolumeHierarchy bvh;
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		const Clock::time_point start = Clock::now();
+		bvh.Build(vBoxes.data(), static_cast<GLuint>(vBoxes.size()));
+		result.vBuildSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	result.uiNodes = bvh.GetNodesCount();
+	result.iDepth = bvh.GetDepth();
+	result.dSAHCost = bvh.GetSAHCost();
+
+	std::vector<GLuint> vMoved;
+	result.iRefitRebuilds = 0;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		MoveBoxes(vBoxes, BENCHMARK_BVH_MOVE_EVERY, BENCHMARK_BVH_WORLD_SIZE, false, vMoved);
+
+		const Clock::time_point start = Clock::now();
+		for (const GLuint uiItem : vMoved)
+		{
+			bvh.SetItemBox(uiItem, vBoxes[uiItem]);
+		}
+
+		result.iRefitRebuilds += bvh.Refit() ? 1 : 0;
+		result.vRefitSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	std::vector<CRay> vRays;
+	CreateRays(BENCHMARK_BVH_PICKS, BENCHMARK_BVH_WORLD_SIZE, BENCHMARK_BVH_PICK_RANGE, vRays);
+
+	GLfloat fDistance = 0.0f;
+	GLint iHits = 0;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		iHits = 0;
+
+		const Clock::time_point start = Clock::now();
+		for (const CRay& ray : vRays)
+		{
+			iHits += bvh.Raycast(ray, &fDistance) >= 0 ? 1 : 0;
+		}
+
+		result.vPickSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		const Clock::time_point start = Clock::now();
+		for (const CRay& ray : vRays)
+		{
+			RaycastBruteForce(vBoxes, ray, &fDistance, 0);
+		}
+
+		result.vPickBruteForceSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	std::vector<SVector4Df> vPlanes;
+	CreateFrustums(BENCHMARK_BVH_FRUSTUMS, BENCHMARK_BVH_WORLD_SIZE, vPlanes);
+
+	std::vector<GLuint> vVisible(vBoxes.size());
+	const SVector3Df v3Eye(0.0f, 0.0f, 0.0f);
+	GLuint uiVisibleTotal = 0;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		uiVisibleTotal = 0;
+
+		const Clock::time_point start = Clock::now();
+		for (GLint iFrustum = 0; iFrustum < BENCHMARK_BVH_FRUSTUMS; iFrustum++)
+		{
+			uiVisibleTotal += bvh.CullFrustum(&vPlanes[static_cast<size_t>(iFrustum) * FRUSTUM_PLANES_NUM], vVisible.data());
+		}
+
+		result.vCullSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		const Clock::time_point start = Clock::now();
+		for (GLint iFrustum = 0; iFrustum < BENCHMARK_BVH_FRUSTUMS; iFrustum++)
+		{
+			// No distance limit, only the planes like CullFrustum
+			SFrustumCulling::CullBoxes(vBoxes.data(), static_cast<GLuint>(vBoxes.size()), &vPlanes[static_cast<size_t>(iFrustum) * FRUSTUM_PLANES_NUM], v3Eye, 0.0f, vVisible.data());
+		}
+
+		result.vCullBoxesSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	result.dHitRatio = static_cast<double>(iHits) / static_cast<double>(BENCHMARK_BVH_PICKS);
+	result.dVisibleRatio = static_cast<double>(uiVisibleTotal) / (static_cast<double>(BENCHMARK_BVH_FRUSTUMS) * static_cast<double>(iObjects));
+
+	m_vResults.push_back(result);
+}
+
+json CBVHBenchmark::GetReport() const
+{
+	json jsonReport;
+	jsonReport["checks"]["queries"] = m_bQueriesValid;
+	jsonReport["world_size"] = BENCHMARK_BVH_WORLD_SIZE;
+	jsonReport["rays_per_sample"] = BENCHMARK_BVH_PICKS;
+	jsonReport["ray_range"] = BENCHMARK_BVH_PICK_RANGE;
+	jsonReport["frustums_per_sample"] = BENCHMARK_BVH_FRUSTUMS;
+
+	json jsonResults = json::array();
+	for (const TBVHBenchmarkResult& rResult : m_vResults)
+	{
+		json jsonResult;
+		jsonResult["objects"] = rResult.iObjects;
+		jsonResult["nodes"] = rResult.uiNodes;
+		jsonResult["depth"] = rResult.iDepth;
+		jsonResult["sah_cost"] = rResult.dSAHCost;
+		jsonResult["hit_ratio"] = rResult.dHitRatio;
+		jsonResult["visible_ratio"] = rResult.dVisibleRatio;
+		jsonResult["build"] = GetSampleStats(rResult.vBuildSamplesMs);
+		jsonResult["refit"] = GetSampleStats(rResult.vRefitSamplesMs);
+		jsonResult["refit_rebuilds"] = rResult.iRefitRebuilds;
+
+		json jsonPicking;
+		jsonPicking["bvh"] = GetSampleStats(rResult.vPickSamplesMs);
+		jsonPicking["brute_force"] = GetSampleStats(rResult.vPickBruteForceSamplesMs);
+
+		for (const char* pszMethod : { "bvh", "brute_force" })
+		{
+			const double dMedianMs = jsonPicking[pszMethod]["median_ms"].get<double>();
+			jsonPicking[pszMethod]["picks_per_second"] = dMedianMs > 0.0 ? 1000.0 * static_cast<double>(BENCHMARK_BVH_PICKS) / dMedianMs : 0.0;
+		}
+
+		json jsonCulling;
+		jsonCulling["bvh"] = GetSampleStats(rResult.vCullSamplesMs);
+		jsonCulling["cull_boxes"] = GetSampleStats(rResult.vCullBoxesSamplesMs);
+
+		const double dBVHMs = jsonCulling["bvh"]["median_ms"].get<double>();
+		const double dCullBoxesMs = jsonCulling["cull_boxes"]["median_ms"].get<double>();
+		jsonCulling["bvh_speedup"] = dBVHMs > 0.0 ? dCullBoxesMs / dBVHMs : 0.0;
+
+		jsonResult["picking"] = jsonPicking;
+		jsonResult["culling"] = jsonCulling;
+		jsonResults.push_back(jsonResult);
+	}
+
+	jsonReport["results"] = jsonResults;
+	return (jsonReport);
+}
+
+bool CBVHBenchmark::AreQueriesValid() const
+{
+	return (m_bQueriesValid);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "BenchmarkBase.h"
+#include "../../LibMath/source/stdafx.h"
+#include "../../LibGame/source/BoundingVolumeHierarchy.h"
+#include "../../LibMath/source/ray.h"
+
+constexpr GLint BENCHMARK_BVH_SIZES[] = { 1000, 10000, 100000 };	// Objects of the timed areas
+constexpr GLfloat BENCHMARK_BVH_WORLD_SIZE = 4000.0f;				// Side of the square the objects are spread over
+constexpr GLint BENCHMARK_BVH_PICKS = 500;							// Timed rays per sample
+constexpr GLfloat BENCHMARK_BVH_PICK_RANGE = 512.0f;				// Range of the CScreen picking ray
+constexpr GLint BENCHMARK_BVH_FRUSTUMS = 16;						// Timed views per sample
+constexpr GLfloat BENCHMARK_BVH_FAR_PLANE = 1500.0f;
+constexpr GLint BENCHMARK_BVH_MOVE_EVERY = 100;						// Timed refit, one object in 100 is nudged
+constexpr GLint BENCHMARK_BVH_CHECK_SCENES = 12;
+constexpr GLint BENCHMARK_BVH_CHECK_MAX_OBJECTS = 3000;
+constexpr GLfloat BENCHMARK_BVH_CHECK_WORLD_SIZE = 800.0f;
+constexpr GLint BENCHMARK_BVH_CHECK_EDITS = 4;						// Rounds of moves, each followed by a Refit
+constexpr GLint BENCHMARK_BVH_CHECK_PICKS = 300;					// Rays per check, compared against every box
+constexpr GLint BENCHMARK_BVH_CHECK_FRUSTUMS = 12;					// Views per check, compared against every box
+
+enum EBVHScene
+{
+	BVH_SCENE_UNIFORM,		// Spread over the whole world
+	BVH_SCENE_CLUSTERED,	// Packed in a few small clusters
+	BVH_SCENE_STACKED,		// Objects sharing their box, and a few without bounds like an instance without a mesh
+};
+
+// Timings of one area size
+typedef struct SBVHBenchmarkResult
+{
+	GLint iObjects;
+	GLuint uiNodes;
+	GLint iDepth;
+	double dSAHCost;
+	std::vector<double> vBuildSamplesMs;
+	std::vector<double> vRefitSamplesMs;
+	GLint iRefitRebuilds;							// Refits that built the tree again
+	std::vector<double> vPickSamplesMs;
+	std::vector<double> vPickBruteForceSamplesMs;	// Every box tested
+	std::vector<double> vCullSamplesMs;
+	std::vector<double> vCullBoxesSamplesMs;		// SFrustumCulling::CullBoxes over every box
+	double dHitRatio;
+	double dVisibleRatio;
+} TBVHBenchmarkResult;
+
+/**
+ * CBVHBenchmark - CBoundingVolumeHierarchy against testing every box.
+ *
+ * The check builds trees over random scenes, then compares Raycast with
+ * the closest box hit by SBoundingBox::IntersectRay and CullFrustum with
+ * the boxes SFrustumCulling::IsCullBoxInside keeps. Objects are moved and
+ * the tree refitted several times, each time checked again, as is a tree
+ * built from scratch over the moved boxes.
+ *
+ * The timings cover the build, a refit after moving a few objects, picking
+ * and culling on areas of 1k, 10k and 100k objects.
+ */
+class CBVHBenchmark : public CBenchmark
+{
+public:
+	CBVHBenchmark();
+
+	void Initialize(GLint iRuns, GLuint uiSeed);
+	void Run() override;
+
+	json GetReport() const override;
+	bool AreQueriesValid() const;
+
+protected:
+	bool CheckQueries();
+	bool CheckTree(const CBoundingVolumeHierarchy& bvh, const std::vector<TCullBox>& vBoxes, GLint iScene, const char* pszStage);
+	void BenchmarkSize(GLint iObjects);
+
+	// The world is a square of fWorldSize with its corner on the origin
+	void CreateBoxes(EBVHScene eScene, GLint iObjects, GLfloat fWorldSize, std::vector<TCullBox>& vBoxes);
+	void MoveBoxes(std::vector<TCullBox>& vBoxes, GLint iMoveEvery, GLfloat fWorldSize, bool bTeleport, std::vector<GLuint>& vMoved);
+	// Rays looking down on a world of fWorldSize, some along an axis, some starting among the objects
+	void CreateRays(GLint iRays, GLfloat fWorldSize, GLfloat fRange, std::vector<CRay>& vRays);
+	// Planes of random views over a world of fWorldSize
+	void CreateFrustums(GLint iFrustums, GLfloat fWorldSize, std::vector<SVector4Df>& vPlanes);
+
+	static GLint RaycastBruteForce(const std::vector<TCullBox>& vBoxes, const CRay& ray, GLfloat* pfDistance, GLint iRejectEvery);
+	static GLuint CullBruteForce(const std::vector<TCullBox>& vBoxes, const SVector4Df* pv4Planes, GLuint* puiVisible);
+
+private:
+	bool m_bQueriesValid;
+
+	std::vector<TBVHBenchmarkResult> m_vResults;
+};
@@ -0,0 +1,56 @@
+#include "BenchmarkBase.h"
+
+#include <algorithm>
+#include <cmath>
+
+CBenchmark::CBenchmark()
+{
+	m_iRuns = BENCHMARK_DEFAULT_RUNS;
+	m_uiSeed = BENCHMARK_DEFAULT_SEED;
+	m_Random.seed(m_uiSeed);
+}
+
+void CBenchmark::SetRuns(GLint iRuns, GLuint uiSeed)
+{
+	m_iRuns = std::max(iRuns, 1);
+	m_uiSeed = uiSeed;
+	m_Random.seed(uiSeed);
+}
+
+double CBenchmark::GetElapsedMs(const Clock::time_point& start)
+{
+	return (std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+}
+
+// Nearest rank percentile, dPercentile on [0, 100]
+double CBenchmark::GetPercentile(const std::vector<double>& vSortedSamples, double dPercentile)
+{
+	if (vSortedSamples.empty())
+	{
+		return (0.0);
+	}
+
+	const size_t sRank = static_cast<size_t>(std::ceil(dPercentile / 100.0 * static_cast<double>(vSortedSamples.size())));
+	return (vSortedSamples[std::clamp<size_t>(sRank, 1, vSortedSamples.size()) - 1]);
+}
+
+json CBenchmark::GetSampleStats(const std::vector<double>& vSamplesMs)
+{
+	std::vector<double> vSorted = vSamplesMs;
+	std::sort(vSorted.begin(), vSorted.end());
+
+	double dTotalMs = 0.0;
+	for (double dSample : vSorted)
+	{
+		dTotalMs += dSample;
+	}
+
+	json jsonStats;
+	jsonStats["samples"] = vSorted.size();
+	jsonStats["median_ms"] = GetPercentile(vSorted, 50.0);
+	jsonStats["p95_ms"] = GetPercentile(vSorted, 95.0);
+	jsonStats["min_ms"] = vSorted.empty() ? 0.0 : vSorted.front();
+	jsonStats["max_ms"] = vSorted.empty() ? 0.0 : vSorted.back();
+	jsonStats["mean_ms"] = vSorted.empty() ? 0.0 : dTotalMs / static_cast<double>(vSorted.size());
+	return (jsonStats);
+}
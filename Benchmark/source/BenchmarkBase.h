@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+constexpr GLint BENCHMARK_DEFAULT_RUNS = 15;
+constexpr GLuint BENCHMARK_DEFAULT_SEED = 1337;
+
+/**
+ * CBenchmark - Shared timing helpers of the benchmarks.
+ *
+ * Every benchmark is repeated m_iRuns times and reported as the median/p95
+ * of its samples; random inputs come from a fixed seed so two runs do the
+ * same work.
+ */
+class CBenchmark
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	CBenchmark();
+	virtual ~CBenchmark() = default;
+
+	virtual void Run() = 0;
+	virtual json GetReport() const = 0;
+
+protected:
+	void SetRuns(GLint iRuns, GLuint uiSeed);
+
+	static double GetElapsedMs(const Clock::time_point& start);
+	static double GetPercentile(const std::vector<double>& vSortedSamples, double dPercentile);
+
+	// samples, median_ms, p95_ms, min_ms, max_ms and mean_ms of a set of samples
+	static json GetSampleStats(const std::vector<double>& vSamplesMs);
+
+protected:
+	GLint m_iRuns;
+	GLuint m_uiSeed;
+	std::mt19937 m_Random;
+};
@@ -0,0 +1,784 @@
+#include "BroadphaseBenchmark.h"
+#include "../../LibGame/source/SpatialGrid.h"
+#include "../../LibGame/source/SweepAndPrune.h"
+#include "../../LibGame/source/PhysicsWorld.h"
+
+#include <algorithm>
+#include <functional>
+
+CBroadphaseBenchmark::CBroadphaseBenchmark()
+{
+	m_bPairsValid = false;
+	m_bPicksValid = false;
+	m_bGridKeysValid = false;
+}
+
+void CBroadphaseBenchmark::Initialize(GLint iRuns, GLuint uiSeed)
+{
+	SetRuns(iRuns, uiSeed);
+	m_vResults.clear();
+	m_PickingResult = TPickingBenchmarkResult();
+	m_bPairsValid = false;
+	m_bPicksValid = false;
+	m_bGridKeysValid = false;
+}
+
+void CBroadphaseBenchmark::Run()
+{
+	m_bPairsValid = CheckPairs();
+	m_bPicksValid = CheckPicks();
+	m_bGridKeysValid = CheckGridKeys();
+
+	for (GLint iObjects : BENCHMARK_BROADPHASE_OBJECT_COUNTS)
+	{
+		BenchmarkScene(BROADPHASE_SCENE_UNIFORM, iObjects);
+		BenchmarkScene(BROADPHASE_SCENE_CLUSTERED, iObjects);
+	}
+
+	BenchmarkPicks();
+}
+
+/*
+ * CreateScene - Random objects and velocities.
+ * @eScene: Uniform or clustered.
+ * @iObjects: Number of objects.
+ * @fWorldSize: Side of the square the objects are spread over.
+ * @rScene: Receives the scene.
+ *
+ * One object in 50 is large enough to span several grid cells. The
+ * objects only have a world AABB, moving one is moving its AABB.
+ */
+void CBroadphaseBenchmark::CreateScene(EBroadphaseScene eScene, GLint iObjects, GLfloat fWorldSize, TBroadphaseScene& rScene)
+{
+	const GLfloat fHalfWorld = 0.5f * fWorldSize;
+	const GLfloat fHalfCluster = 0.5f * std::min(BENCHMARK_BROADPHASE_CLUSTER_SIZE, fWorldSize);
+
+	std::uniform_real_distribution<GLfloat> distWorld(-fHalfWorld, fHalfWorld);
+	std::uniform_real_distribution<GLfloat> distHeight(0.0f, 100.0f);
+	std::uniform_real_distribution<GLfloat> distCluster(-fHalfCluster, fHalfCluster);
+	std::uniform_real_distribution<GLfloat> distExtent(1.0f, 12.0f);
+	std::uniform_real_distribution<GLfloat> distLargeExtent(40.0f, 160.0f);
+	std::uniform_real_distribution<GLfloat> distSpeed(-20.0f, 20.0f);
+
+	rScene.vObjects.clear();
+	rScene.vObjects.resize(iObjects);
+	rScene.vVelocities.assign(iObjects, SVector3Df(0.0f, 0.0f, 0.0f));
+
+	if (eScene == BROADPHASE_SCENE_CLUSTERED)
+	{
+		rScene.v3MoverMin = SVector3Df(-fHalfCluster, 0.0f, -fHalfCluster);
+		rScene.v3MoverMax = SVector3Df(fHalfCluster, 2.0f * fHalfCluster, fHalfCluster);
+	}
+	else
+	{
+		rScene.v3MoverMin = SVector3Df(-fHalfWorld, 0.0f, -fHalfWorld);
+		rScene.v3MoverMax = SVector3Df(fHalfWorld, 100.0f, fHalfWorld);
+	}
+
+	for (GLint i = 0; i < iObjects; i++)
+	{
+		const bool bMover = eScene == BROADPHASE_SCENE_UNIFORM || (i % BENCHMARK_BROADPHASE_MOVER_EVERY) == 0;
+
+		SVector3Df v3Center;
+		SVector3Df v3Extent;
+
+		if (bMover && eScene == BROADPHASE_SCENE_CLUSTERED)
+		{
+			v3Center = SVector3Df(distCluster(m_Random), distCluster(m_Random) + fHalfCluster, distCluster(m_Random));
+			v3Extent = SVector3Df(distExtent(m_Random), distExtent(m_Random), distExtent(m_Random)) * 0.5f;
+		}
+		else
+		{
+			v3Center = SVector3Df(distWorld(m_Random), distHeight(m_Random), distWorld(m_Random));
+			v3Extent = (i % 50 == 0) ?
+				SVector3Df(distLargeExtent(m_Random), distExtent(m_Random), distLargeExtent(m_Random)) :
+				SVector3Df(distExtent(m_Random), distExtent(m_Random), distExtent(m_Random));
+		}
+
+		rScene.vObjects[i].SetBoundingBoxWorld(TBoundingBox(v3Center - v3Extent, v3Center + v3Extent));
+
+		if (bMover)
+		{
+			rScene.vVelocities[i] = SVector3Df(distSpeed(m_Random), distSpeed(m_Random), distSpeed(m_Random));
+		}
+	}
+}
+
+// Movers going out of their box on an axis come back on that axis
+void CBroadphaseBenchmark::MoveScene(TBroadphaseScene& rScene, GLfloat fDeltaTime)
+{
+	for (size_t i = 0; i < rScene.vObjects.size(); i++)
+	{
+		SVector3Df& v3Velocity = rScene.vVelocities[i];
+		if (v3Velocity.x == 0.0f && v3Velocity.y == 0.0f && v3Velocity.z == 0.0f)
+		{
+			continue;
+		}
+
+		TBoundingBox worldBox = rScene.vObjects[i].GetBoundingBoxWorld();
+		const SVector3Df v3Move = v3Velocity * fDeltaTime;
+		SVector3Df v3Min = worldBox.v3Min + v3Move;
+		SVector3Df v3Max = worldBox.v3Max + v3Move;
+
+		for (GLint iAxis = 0; iAxis < 3; iAxis++)
+		{
+			if ((v3Min[iAxis] < rScene.v3MoverMin[iAxis] && v3Velocity[iAxis] < 0.0f) ||
+				(v3Max[iAxis] > rScene.v3MoverMax[iAxis] && v3Velocity[iAxis] > 0.0f))
+			{
+				v3Velocity[iAxis] = -v3Velocity[iAxis];
+			}
+		}
+
+		rScene.vObjects[i].SetBoundingBoxWorld(TBoundingBox(v3Min, v3Max));
+	}
+}
+
+GLint CBroadphaseBenchmark::GetMoversCount(const TBroadphaseScene& rScene)
+{
+	GLint iMovers = 0;
+	for (const SVector3Df& v3Velocity : rScene.vVelocities)
+	{
+		if (v3Velocity.x != 0.0f || v3Velocity.y != 0.0f || v3Velocity.z != 0.0f)
+		{
+			iMovers++;
+		}
+	}
+
+	return (iMovers);
+}
+
+// What CPhysicsWorld::Step asks of the broadphase, every object is updated
+size_t CBroadphaseBenchmark::StepBroadphase(CBroadphase& rBroadphase, TBroadphaseScene& rScene)
+{
+	for (CPhysicsObject& rObject : rScene.vObjects)
+	{
+		rBroadphase.UpdateObject(&rObject);
+	}
+
+	return (rBroadphase.GetPotentialCollisions().size());
+}
+
+double CBroadphaseBenchmark::TimeFrames(CBroadphase& rBroadphase, TBroadphaseScene& rScene, size_t* psPairs)
+{
+	for (CPhysicsObject& rObject : rScene.vObjects)
+	{
+		rBroadphase.AddObject(&rObject);
+	}
+
+	// The first step sorts or fills the cells from scratch, not what a frame costs
+	rBroadphase.GetPotentialCollisions();
+
+	double dElapsedMs = 0.0;
+	*psPairs = 0;
+
+	for (GLint iFrame = 0; iFrame < BENCHMARK_BROADPHASE_FRAMES; iFrame++)
+	{
+		MoveScene(rScene, PHYSICS_FIXED_TIMESTEP);
+
+		const Clock::time_point start = Clock::now();
+		*psPairs += StepBroadphase(rBroadphase, rScene);
+		dElapsedMs += GetElapsedMs(start);
+	}
+
+	return (dElapsedMs);
+}
+
+/*
+ * BenchmarkScene - Both broadphases over the same frames.
+ * @eScene: Uniform or clustered.
+ * @iObjects: Number of objects.
+ *
+ * Every sample starts again from the initial scene with a new broadphase.
+ * The world keeps its size, more objects make a denser scene.
+ */
+void CBroadphaseBenchmark::BenchmarkScene(EBroadphaseScene eScene, GLint iObjects)
+{
+	TBroadphaseScene initial;
+	CreateScene(eScene, iObjects, BENCHMARK_BROADPHASE_WORLD_SIZE, initial);
+
+	TBroadphaseBenchmarkResult result;
+	result.stScene = (eScene == BROADPHASE_SCENE_CLUSTERED) ? "clustered" : "uniform";
+	result.iObjects = iObjects;
+	result.iMovers = GetMoversCount(initial);
+	result.dPairsPerFrame = 0.0;
+
+	TBroadphaseScene scene;
+	size_t sPairs = 0;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		scene = initial;
+		CSpatialGrid grid(100.0f);
+		result.vGridSamplesMs.push_back(TimeFrames(grid, scene, &sPairs));
+	}
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		scene = initial;
+		CSweepAndPrune sweepAndPrune;
+		result.vSweepSamplesMs.push_back(TimeFrames(sweepAndPrune, scene, &sPairs));
+	}
+
+	result.dPairsPerFrame = static_cast<double>(sPairs) / static_cast<double>(BENCHMARK_BROADPHASE_FRAMES);
+	m_vResults.push_back(result);
+}
+
+bool CBroadphaseBenchmark::GetSortedPairs(const std::vector<TCollisionPair>& vPairs, std::vector<TCollisionPair>& vSorted)
+{
+	vSorted.clear();
+	vSorted.reserve(vPairs.size());
+
+	for (const TCollisionPair& pair : vPairs)
+	{
+		if (std::less<CPhysicsObject*>()(pair.second, pair.first))
+		{
+			vSorted.push_back(std::make_pair(pair.second, pair.first));
+		}
+		else
+		{
+			vSorted.push_back(pair);
+		}
+	}
+
+	std::sort(vSorted.begin(), vSorted.end());
+	return (std::adjacent_find(vSorted.begin(), vSorted.end()) == vSorted.end());
+}
+
+void CBroadphaseBenchmark::GetBruteForcePairs(std::vector<CPhysicsObject>& vObjects, const std::vector<bool>& vTracked, std::vector<TCollisionPair>& vPairs)
+{
+	vPairs.clear();
+
+	for (size_t i = 0; i < vObjects.size(); i++)
+	{
+		if (!vTracked[i])
+		{
+			continue;
+		}
+
+		const TBoundingBox boxA = vObjects[i].GetBoundingBoxWorld();
+
+		for (size_t j = i + 1; j < vObjects.size(); j++)
+		{
+			if (vTracked[j] && boxA.Intersects(vObjects[j].GetBoundingBoxWorld()))
+			{
+				vPairs.push_back(std::make_pair(&vObjects[i], &vObjects[j]));
+			}
+		}
+	}
+}
+
+// Distinct grid cells covered by the tracked objects, the cells the grid must keep
+size_t CBroadphaseBenchmark::GetOccupiedCellsCount(const CSpatialGrid& rGrid, std::vector<CPhysicsObject>& vObjects, const std::vector<bool>& vTracked)
+{
+	std::vector<GLuint64> vKeys;
+
+	for (size_t i = 0; i < vObjects.size(); i++)
+	{
+		if (!vTracked[i])
+		{
+			continue;
+		}
+
+		const TGridCellRange cellRange = rGrid.GetCellRange(vObjects[i].GetBoundingBoxWorld());
+		for (GLint iX = cellRange.iMinX; iX <= cellRange.iMaxX; ++iX)
+		{
+			for (GLint iY = cellRange.iMinY; iY <= cellRange.iMaxY; ++iY)
+			{
+				for (GLint iZ = cellRange.iMinZ; iZ <= cellRange.iMaxZ; ++iZ)
+				{
+					vKeys.push_back(CSpatialGrid::GetKey(iX, iY, iZ));
+				}
+			}
+		}
+	}
+
+	std::sort(vKeys.begin(), vKeys.end());
+	return (static_cast<size_t>(std::unique(vKeys.begin(), vKeys.end()) - vKeys.begin()));
+}
+
+/*
+ * CheckGridKeys - Cell coordinates and keys of CSpatialGrid on negative and boundary cells.
+ *
+ * GetCellCoord must floor, -0.5 falls in cell -1 and not in cell 0 as a
+ * truncation would give, and clamp to the cells a key can hold. Every
+ * combination of cells around the origin and at the limits gets its own
+ * key, and each field decodes back to its coordinate, so a negative
+ * coordinate never borrows from the field next to it.
+ */
+bool CBroadphaseBenchmark::CheckGridKeys()
+{
+	static const TGridCoordCase coordCases[] =
+	{
+		{ 1.0f, -0.5f, -1 },
+		{ 1.0f, -0.0f, 0 },
+		{ 1.0f, 0.0f, 0 },
+		{ 1.0f, 0.5f, 0 },
+		{ 1.0f, 0.999f, 0 },
+		{ 1.0f, 1.0f, 1 },
+		{ 1.0f, -1.0f, -1 },
+		{ 1.0f, -1.001f, -2 },
+		{ 1.0f, -1.5f, -2 },
+		{ 100.0f, -0.01f, -1 },
+		{ 100.0f, -50.0f, -1 },
+		{ 100.0f, -100.0f, -1 },
+		{ 100.0f, -100.01f, -2 },
+		{ 100.0f, -200.0f, -2 },
+		{ 100.0f, 99.99f, 0 },
+		{ 100.0f, 100.0f, 1 },
+		{ 1.0f, -1e9f, SPATIAL_GRID_MIN_CELL },
+		{ 1.0f, 1e9f, SPATIAL_GRID_MAX_CELL },
+		{ 1.0f, static_cast<GLfloat>(SPATIAL_GRID_MIN_CELL), SPATIAL_GRID_MIN_CELL },
+		{ 1.0f, static_cast<GLfloat>(SPATIAL_GRID_MAX_CELL), SPATIAL_GRID_MAX_CELL },
+	};
+
+	for (const TGridCoordCase& coordCase : coordCases)
+	{
+		const CSpatialGrid grid(coordCase.fCellSize);
+		const GLint iCell = grid.GetCellCoord(coordCase.fCoord);
+		if (iCell != coordCase.iCell)
+		{
+			sys_err("CBroadphaseBenchmark::CheckGridKeys: %g with cells of %g falls in cell %d instead of %d", coordCase.fCoord, coordCase.fCellSize, iCell, coordCase.iCell);
+			return (false);
+		}
+	}
+
+	// A box straddling the origin on every axis
+	const CSpatialGrid grid(100.0f);
+	const TGridCellRange cellRange = grid.GetCellRange(TBoundingBox(SVector3Df(-0.5f, -150.0f, -0.01f), SVector3Df(0.5f, -100.0f, 99.99f)));
+	if (cellRange.iMinX != -1 || cellRange.iMinY != -2 || cellRange.iMinZ != -1 || cellRange.iMaxX != 0 || cellRange.iMaxY != -1 || cellRange.iMaxZ != 0)
+	{
+		sys_err("CBroadphaseBenchmark::CheckGridKeys: A box straddling the origin covers cells (%d %d %d) to (%d %d %d)", cellRange.iMinX, cellRange.iMinY, cellRange.iMinZ, cellRange.iMaxX, cellRange.iMaxY, cellRange.iMaxZ);
+		return (false);
+	}
+
+	static const GLint cells[] = { 0, -1, 1, -2, 2, SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MIN_CELL + 1, SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL - 1 };
+	const GLuint64 ulMask = (static_cast<GLuint64>(1) << SPATIAL_GRID_KEY_BITS) - 1;
+	std::vector<GLuint64> vKeys;
+
+	for (const GLint iX : cells)
+	{
+		for (const GLint iY : cells)
+		{
+			for (const GLint iZ : cells)
+			{
+				const GLuint64 ulKey = CSpatialGrid::GetKey(iX, iY, iZ);
+				const GLint iKeyX = static_cast<GLint>((ulKey >> (2 * SPATIAL_GRID_KEY_BITS)) & ulMask) - SPATIAL_GRID_KEY_BIAS;
+				const GLint iKeyY = static_cast<GLint>((ulKey >> SPATIAL_GRID_KEY_BITS) & ulMask) - SPATIAL_GRID_KEY_BIAS;
+				const GLint iKeyZ = static_cast<GLint>(ulKey & ulMask) - SPATIAL_GRID_KEY_BIAS;
+
+				if ((ulKey >> (3 * SPATIAL_GRID_KEY_BITS)) != 0 || iKeyX != iX || iKeyY != iY || iKeyZ != iZ)
+				{
+					sys_err("CBroadphaseBenchmark::CheckGridKeys: The key of cell (%d %d %d) decodes to (%d %d %d)", iX, iY, iZ, iKeyX, iKeyY, iKeyZ);
+					return (false);
+				}
+
+				vKeys.push_back(ulKey);
+			}
+		}
+	}
+
+	std::sort(vKeys.begin(), vKeys.end());
+	if (std::adjacent_find(vKeys.begin(), vKeys.end()) != vKeys.end())
+	{
+		sys_err("CBroadphaseBenchmark::CheckGridKeys: Two cells share a key");
+		return (false);
+	}
+
+	return (true);
+}
+
+/*
+ * CheckPairs - Both broadphases report exactly the overlapping AABB pairs.
+ *
+ * Random uniform and clustered scenes, each stepped a few frames with a
+ * long time step so the sorted lists change order and objects change
+ * cells. Every frame one random object leaves both broadphases or comes
+ * back, so the removals and insertions are covered too.
+ *
+ * The grid must only keep the cells its objects cover, the cells left
+ * empty are released, and none once every object is removed.
+ */
+bool CBroadphaseBenchmark::CheckPairs()
+{
+	std::uniform_int_distribution<GLint> distObjects(BENCHMARK_BROADPHASE_CHECK_MAX_OBJECTS / 4, BENCHMARK_BROADPHASE_CHECK_MAX_OBJECTS);
+
+	TBroadphaseScene scene;
+	std::vector<TCollisionPair> vExpected, vGridPairs, vSweepPairs;
+
+	for (GLint iScene = 0; iScene < BENCHMARK_BROADPHASE_CHECK_SCENES; iScene++)
+	{
+		const EBroadphaseScene eScene = (iScene & 1) ? BROADPHASE_SCENE_CLUSTERED : BROADPHASE_SCENE_UNIFORM;
+		CreateScene(eScene, distObjects(m_Random), BENCHMARK_BROADPHASE_CHECK_WORLD_SIZE, scene);
+
+		CSpatialGrid grid(100.0f);
+		CSweepAndPrune sweepAndPrune;
+		std::vector<bool> vTracked(scene.vObjects.size(), true);
+
+		for (CPhysicsObject& rObject : scene.vObjects)
+		{
+			grid.AddObject(&rObject);
+			sweepAndPrune.AddObject(&rObject);
+		}
+
+		std::uniform_int_distribution<size_t> distObject(0, scene.vObjects.size() - 1);
+
+		for (GLint iFrame = 0; iFrame < BENCHMARK_BROADPHASE_CHECK_FRAMES; iFrame++)
+		{
+			if (iFrame > 0)
+			{
+				MoveScene(scene, 0.25f);
+
+				const size_t sToggled = distObject(m_Random);
+				if (vTracked[sToggled])
+				{
+					grid.RemoveObject(&scene.vObjects[sToggled]);
+					sweepAndPrune.RemoveObject(&scene.vObjects[sToggled]);
+				}
+
+				vTracked[sToggled] = !vTracked[sToggled];
+			}
+
+			for (size_t i = 0; i < scene.vObjects.size(); i++)
+			{
+				if (vTracked[i])
+				{
+					grid.UpdateObject(&scene.vObjects[i]);
+					sweepAndPrune.UpdateObject(&scene.vObjects[i]);
+				}
+			}
+
+			GetBruteForcePairs(scene.vObjects, vTracked, vExpected);
+			std::sort(vExpected.begin(), vExpected.end());
+
+			if (!GetSortedPairs(grid.GetPotentialCollisions(), vGridPairs) || vGridPairs != vExpected)
+			{
+				sys_err("CBroadphaseBenchmark::CheckPairs: Scene %d frame %d, the grid reports %zu pairs instead of %zu", iScene, iFrame, vGridPairs.size(), vExpected.size());
+				return (false);
+			}
+
+			if (!GetSortedPairs(sweepAndPrune.GetPotentialCollisions(), vSweepPairs) || vSweepPairs != vExpected)
+			{
+				sys_err("CBroadphaseBenchmark::CheckPairs: Scene %d frame %d, sweep and prune reports %zu pairs instead of %zu", iScene, iFrame, vSweepPairs.size(), vExpected.size());
+				return (false);
+			}
+
+			const size_t sOccupiedCells = GetOccupiedCellsCount(grid, scene.vObjects, vTracked);
+			if (grid.GetCellsCount() != sOccupiedCells)
+			{
+				sys_err("CBroadphaseBenchmark::CheckPairs: Scene %d frame %d, the grid keeps %zu cells instead of %zu", iScene, iFrame, grid.GetCellsCount(), sOccupiedCells);
+				return (false);
+			}
+		}
+
+		for (CPhysicsObject& rObject : scene.vObjects)
+		{
+			grid.RemoveObject(&rObject);
+		}
+
+		if (grid.GetCellsCount() != 0)
+		{
+			sys_err("CBroadphaseBenchmark::CheckPairs: Scene %d, the grid keeps %zu cells once empty", iScene, grid.GetCellsCount());
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * CreateRays - Random picking rays over a scene.
+ * @iRays: Number of rays.
+ * @fWorldSize: Side of the square the objects are spread over.
+ * @fRange: Range of the rays.
+ * @vRays: Receives the rays.
+ *
+ * Most rays come from a camera above the world and aim at a point among
+ * the objects. One in 16 goes along an axis, so the walk meets directions
+ * with zero components, and one in 4 starts among the objects, sometimes
+ * inside one.
+ */
+void CBroadphaseBenchmark::CreateRays(GLint iRays, GLfloat fWorldSize, GLfloat fRange, std::vector<CRay>& vRays)
+{
+	const GLfloat fHalfWorld = 0.5f * fWorldSize;
+
+	std::uniform_real_distribution<GLfloat> distWorld(-fHalfWorld, fHalfWorld);
+	std::uniform_real_distribution<GLfloat> distHeight(0.0f, 100.0f);
+	std::uniform_real_distribution<GLfloat> distCameraHeight(120.0f, 300.0f);
+	std::uniform_real_distribution<GLfloat> distAim(-0.25f * fRange, 0.25f * fRange);
+	std::uniform_int_distribution<GLint> distAxis(0, 5);
+
+	vRays.clear();
+	vRays.reserve(iRays);
+
+	for (GLint i = 0; i < iRays; i++)
+	{
+		SVector3Df v3Origin(distWorld(m_Random), (i % 4 == 0) ? distHeight(m_Random) : distCameraHeight(m_Random), distWorld(m_Random));
+		SVector3Df v3Dir;
+
+		if (i % 16 == 0)
+		{
+			const GLint iAxis = distAxis(m_Random);
+			v3Dir = SVector3Df(0.0f, 0.0f, 0.0f);
+			v3Dir[iAxis / 2] = (iAxis & 1) ? -1.0f : 1.0f;
+		}
+		else
+		{
+			const SVector3Df v3Target(v3Origin.x + distAim(m_Random), distHeight(m_Random), v3Origin.z + distAim(m_Random));
+			v3Dir = v3Target - v3Origin;
+		}
+
+		vRays.push_back(CRay(v3Origin, v3Dir, fRange));
+	}
+}
+
+// What CPhysicsWorld::PickObject did before the broadphase walked the ray
+CPhysicsObject* CBroadphaseBenchmark::PickBruteForce(std::vector<CPhysicsObject>& vObjects, const std::vector<bool>& vTracked, const CRay& ray, GLfloat* pfDistance)
+{
+	CPhysicsObject* pClosestObject = nullptr;
+	GLfloat fClosestT = FLT_MAX;
+
+	const SVector3Df v3InvDir = ray.GetInverseDirection();
+	GLfloat fT = 0.0f;
+
+	for (size_t i = 0; i < vObjects.size(); i++)
+	{
+		if (!vTracked[i] || !vObjects[i].IsCollidable())
+		{
+			continue;
+		}
+
+		const TBoundingBox worldBox = vObjects[i].GetBoundingBoxWorld();
+		if (SBoundingBox::IntersectRay(ray.GetOrigin(), v3InvDir, worldBox.v3Min, worldBox.v3Max, &fT) && fT <= ray.GetRayRange() && fT < fClosestT)
+		{
+			fClosestT = fT;
+			pClosestObject = &vObjects[i];
+		}
+	}
+
+	*pfDistance = fClosestT;
+	return (pClosestObject);
+}
+
+double CBroadphaseBenchmark::TimePicks(CBroadphase& rBroadphase, const std::vector<CRay>& vRays, GLint* piHits)
+{
+	GLfloat fDistance = 0.0f;
+	*piHits = 0;
+
+	const Clock::time_point start = Clock::now();
+	for (const CRay& ray : vRays)
+	{
+		if (rBroadphase.PickObject(ray, &fDistance))
+		{
+			(*piHits)++;
+		}
+	}
+
+	return (GetElapsedMs(start));
+}
+
+/*
+ * CheckPicks - PickObject finds the closest hit over every object.
+ *
+ * The scenes move and lose or get back an object between frames like in
+ * CheckPairs, one object in 10 is not collidable. Several objects may be hit at the same distance, so the
+ * distances are compared rather than the objects.
+ */
+bool CBroadphaseBenchmark::CheckPicks()
+{
+	std::uniform_int_distribution<GLint> distObjects(BENCHMARK_BROADPHASE_CHECK_MAX_OBJECTS / 4, BENCHMARK_BROADPHASE_CHECK_MAX_OBJECTS);
+
+	TBroadphaseScene scene;
+	std::vector<CRay> vRays;
+
+	for (GLint iScene = 0; iScene < BENCHMARK_BROADPHASE_CHECK_SCENES; iScene++)
+	{
+		const EBroadphaseScene eScene = (iScene & 1) ? BROADPHASE_SCENE_CLUSTERED : BROADPHASE_SCENE_UNIFORM;
+		CreateScene(eScene, distObjects(m_Random), BENCHMARK_BROADPHASE_CHECK_WORLD_SIZE, scene);
+
+		CSpatialGrid grid(100.0f);
+		CSweepAndPrune sweepAndPrune;
+		std::vector<bool> vTracked(scene.vObjects.size(), true);
+
+		// Tracked but not pickable, like an object turned off since the last step
+		for (size_t i = 0; i < scene.vObjects.size(); i++)
+		{
+			scene.vObjects[i].SetCollidable(i % 10 != 0);
+			grid.AddObject(&scene.vObjects[i]);
+			sweepAndPrune.AddObject(&scene.vObjects[i]);
+		}
+
+		std::uniform_int_distribution<size_t> distObject(0, scene.vObjects.size() - 1);
+
+		for (GLint iFrame = 0; iFrame < BENCHMARK_BROADPHASE_CHECK_PICK_FRAMES; iFrame++)
+		{
+			if (iFrame > 0)
+			{
+				MoveScene(scene, 0.25f);
+
+				const size_t sToggled = distObject(m_Random);
+				if (vTracked[sToggled])
+				{
+					grid.RemoveObject(&scene.vObjects[sToggled]);
+					sweepAndPrune.RemoveObject(&scene.vObjects[sToggled]);
+				}
+
+				vTracked[sToggled] = !vTracked[sToggled];
+
+				for (size_t i = 0; i < scene.vObjects.size(); i++)
+				{
+					if (vTracked[i])
+					{
+						grid.UpdateObject(&scene.vObjects[i]);
+						sweepAndPrune.UpdateObject(&scene.vObjects[i]);
+					}
+				}
+			}
+
+			// Short rays stop inside the scene, long ones cross all of it
+			const GLfloat fRange = (iFrame & 1) ? 2.0f * BENCHMARK_BROADPHASE_CHECK_WORLD_SIZE : 0.25f * BENCHMARK_BROADPHASE_CHECK_WORLD_SIZE;
+			CreateRays(BENCHMARK_BROADPHASE_CHECK_PICKS, BENCHMARK_BROADPHASE_CHECK_WORLD_SIZE, fRange, vRays);
+
+			for (GLint iRay = 0; iRay < BENCHMARK_BROADPHASE_CHECK_PICKS; iRay++)
+			{
+				GLfloat fExpectedT, fGridT, fSweepT;
+				const CPhysicsObject* pExpected = PickBruteForce(scene.vObjects, vTracked, vRays[iRay], &fExpectedT);
+				const CPhysicsObject* pGridPick = grid.PickObject(vRays[iRay], &fGridT);
+				const CPhysicsObject* pSweepPick = sweepAndPrune.PickObject(vRays[iRay], &fSweepT);
+
+				if ((pGridPick == nullptr) != (pExpected == nullptr) || (pExpected && fGridT != fExpectedT))
+				{
+					sys_err("CBroadphaseBenchmark::CheckPicks: Scene %d frame %d ray %d, the grid hits at %f instead of %f", iScene, iFrame, iRay, fGridT, fExpectedT);
+					return (false);
+				}
+
+				if ((pSweepPick == nullptr) != (pExpected == nullptr) || (pExpected && fSweepT != fExpectedT))
+				{
+					sys_err("CBroadphaseBenchmark::CheckPicks: Scene %d frame %d ray %d, sweep and prune hits at %f instead of %f", iScene, iFrame, iRay, fSweepT, fExpectedT);
+					return (false);
+				}
+			}
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * BenchmarkPicks - Picks per second on the static uniform scene.
+ *
+ * The same screen-like rays go through both broadphases and through the
+ * test of every object.
+ */
+void CBroadphaseBenchmark::BenchmarkPicks()
+{
+	TBroadphaseScene scene;
+	CreateScene(BROADPHASE_SCENE_UNIFORM, BENCHMARK_BROADPHASE_PICK_OBJECTS, BENCHMARK_BROADPHASE_WORLD_SIZE, scene);
+
+	std::vector<CRay> vRays;
+	CreateRays(BENCHMARK_BROADPHASE_PICKS, BENCHMARK_BROADPHASE_WORLD_SIZE, BENCHMARK_BROADPHASE_PICK_RANGE, vRays);
+
+	CSpatialGrid grid(100.0f);
+	CSweepAndPrune sweepAndPrune;
+	for (CPhysicsObject& rObject : scene.vObjects)
+	{
+		grid.AddObject(&rObject);
+		sweepAndPrune.AddObject(&rObject);
+	}
+
+	m_PickingResult.iObjects = BENCHMARK_BROADPHASE_PICK_OBJECTS;
+	m_PickingResult.iRays = BENCHMARK_BROADPHASE_PICKS;
+
+	GLint iHits = 0;
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		m_PickingResult.vGridSamplesMs.push_back(TimePicks(grid, vRays, &iHits));
+	}
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		m_PickingResult.vSweepSamplesMs.push_back(TimePicks(sweepAndPrune, vRays, &iHits));
+	}
+
+	const std::vector<bool> vTracked(scene.vObjects.size(), true);
+	GLfloat fDistance = 0.0f;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		GLint iBruteForceHits = 0;
+
+		const Clock::time_point start = Clock::now();
+		for (const CRay& ray : vRays)
+		{
+			if (PickBruteForce(scene.vObjects, vTracked, ray, &fDistance))
+			{
+				iBruteForceHits++;
+			}
+		}
+
+		m_PickingResult.vBruteForceSamplesMs.push_back(GetElapsedMs(start));
+		iHits = iBruteForceHits;
+	}
+
+	m_PickingResult.dHitRatio = static_cast<double>(iHits) / static_cast<double>(BENCHMARK_BROADPHASE_PICKS);
+}
+
+json CBroadphaseBenchmark::GetReport() const
+{
+	json jsonReport;
+	jsonReport["frames_per_sample"] = BENCHMARK_BROADPHASE_FRAMES;
+	jsonReport["checks"]["pairs"] = m_bPairsValid;
+	jsonReport["checks"]["picks"] = m_bPicksValid;
+	jsonReport["checks"]["grid_keys"] = m_bGridKeysValid;
+
+	json jsonResults = json::array();
+	for (const TBroadphaseBenchmarkResult& rResult : m_vResults)
+	{
+		json jsonResult;
+		jsonResult["scene"] = rResult.stScene;
+		jsonResult["objects"] = rResult.iObjects;
+		jsonResult["movers"] = rResult.iMovers;
+		jsonResult["pairs_per_frame"] = rResult.dPairsPerFrame;
+		jsonResult["spatial_grid"] = GetSampleStats(rResult.vGridSamplesMs);
+		jsonResult["sweep_and_prune"] = GetSampleStats(rResult.vSweepSamplesMs);
+
+		const double dGridMs = jsonResult["spatial_grid"]["median_ms"].get<double>();
+		const double dSweepMs = jsonResult["sweep_and_prune"]["median_ms"].get<double>();
+		jsonResult["sweep_and_prune_speedup"] = dSweepMs > 0.0 ? dGridMs / dSweepMs : 0.0;
+		jsonResults.push_back(jsonResult);
+	}
+
+	jsonReport["results"] = jsonResults;
+
+	json jsonPicking;
+	jsonPicking["objects"] = m_PickingResult.iObjects;
+	jsonPicking["rays_per_sample"] = m_PickingResult.iRays;
+	jsonPicking["ray_range"] = BENCHMARK_BROADPHASE_PICK_RANGE;
+	jsonPicking["hit_ratio"] = m_PickingResult.dHitRatio;
+	jsonPicking["spatial_grid"] = GetSampleStats(m_PickingResult.vGridSamplesMs);
+	jsonPicking["sweep_and_prune"] = GetSampleStats(m_PickingResult.vSweepSamplesMs);
+	jsonPicking["brute_force"] = GetSampleStats(m_PickingResult.vBruteForceSamplesMs);
+
+	for (const char* pszMethod : { "spatial_grid", "sweep_and_prune", "brute_force" })
+	{
+		const double dMedianMs = jsonPicking[pszMethod]["median_ms"].get<double>();
+		jsonPicking[pszMethod]["picks_per_second"] = dMedianMs > 0.0 ? 1000.0 * static_cast<double>(m_PickingResult.iRays) / dMedianMs : 0.0;
+	}
+
+	jsonReport["picking"] = jsonPicking;
+	return (jsonReport);
+}
+
+bool CBroadphaseBenchmark::ArePairsValid() const
+{
+	return (m_bPairsValid);
+}
+
+bool CBroadphaseBenchmark::ArePicksValid() const
+{
+	return (m_bPicksValid);
+}
+
+bool CBroadphaseBenchmark::AreGridKeysValid() const
+{
+	return (m_bGridKeysValid);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "BenchmarkBase.h"
+#include "../../LibGame/source/PhysicsObject.h"
+#include "../../LibGame/source/Broadphase.h"
+#include "../../LibMath/source/ray.h"
+
+class CSpatialGrid;
+
+constexpr GLint BENCHMARK_BROADPHASE_OBJECT_COUNTS[] = { 1000, 10000, 50000 };	// Scene sizes timed, over the same world
+constexpr GLint BENCHMARK_BROADPHASE_FRAMES = 60;			// Timed steps per sample
+constexpr GLint BENCHMARK_BROADPHASE_MOVER_EVERY = 20;		// Clustered scene, one object in 20 moves
+constexpr GLfloat BENCHMARK_BROADPHASE_WORLD_SIZE = 4000.0f;	// Side of the square the objects are spread over
+constexpr GLfloat BENCHMARK_BROADPHASE_CLUSTER_SIZE = 60.0f;		// Side of the cube the movers of the clustered scene stay in
+constexpr GLint BENCHMARK_BROADPHASE_CHECK_SCENES = 16;
+constexpr GLint BENCHMARK_BROADPHASE_CHECK_FRAMES = 10;
+constexpr GLint BENCHMARK_BROADPHASE_CHECK_MAX_OBJECTS = 1500;	// Compared against every pair
+constexpr GLfloat BENCHMARK_BROADPHASE_CHECK_WORLD_SIZE = 800.0f;	// Small enough for many overlaps and objects over several cells
+constexpr GLint BENCHMARK_BROADPHASE_PICK_OBJECTS = 10000;
+constexpr GLint BENCHMARK_BROADPHASE_PICKS = 2000;				// Timed rays per sample
+constexpr GLfloat BENCHMARK_BROADPHASE_PICK_RANGE = 512.0f;		// Range of the CScreen picking ray
+constexpr GLint BENCHMARK_BROADPHASE_CHECK_PICK_FRAMES = 4;
+constexpr GLint BENCHMARK_BROADPHASE_CHECK_PICKS = 400;			// Rays per checked frame, compared against every object
+
+enum EBroadphaseScene
+{
+	BROADPHASE_SCENE_UNIFORM,		// Every object moves, spread over the whole world
+	BROADPHASE_SCENE_CLUSTERED,		// Static objects over the world, the movers packed in one cluster
+};
+
+// Objects and the velocity of their AABB, zero for the static ones
+typedef struct SBroadphaseScene
+{
+	std::vector<CPhysicsObject> vObjects;
+	std::vector<SVector3Df> vVelocities;
+	SVector3Df v3MoverMin;		// The movers bounce inside this box
+	SVector3Df v3MoverMax;
+} TBroadphaseScene;
+
+// A world coordinate and the grid cell it falls in
+typedef struct SGridCoordCase
+{
+	GLfloat fCellSize;
+	GLfloat fCoord;
+	GLint iCell;
+} TGridCoordCase;
+
+// Timings of both broadphases on one scene and size
+typedef struct SBroadphaseBenchmarkResult
+{
+	std::string stScene;
+	GLint iObjects;
+	GLint iMovers;
+	std::vector<double> vGridSamplesMs;
+	std::vector<double> vSweepSamplesMs;
+	double dPairsPerFrame;
+} TBroadphaseBenchmarkResult;
+
+// Timings of PickObject on the static uniform scene
+typedef struct SPickingBenchmarkResult
+{
+	GLint iObjects;
+	GLint iRays;
+	std::vector<double> vGridSamplesMs;
+	std::vector<double> vSweepSamplesMs;
+	std::vector<double> vBruteForceSamplesMs;	// Every object tested, as before the broadphase
+	double dHitRatio;
+} TPickingBenchmarkResult;
+
+/**
+ * CBroadphaseBenchmark - CSpatialGrid against CSweepAndPrune.
+ *
+ * The check runs both broadphases on random scenes, with objects moving,
+ * leaving and coming back, and compares their pairs with the pairs found
+ * by testing every AABB against every other one. The timings cover the
+ * UpdateObject calls and GetPotentialCollisions of CPhysicsWorld::Step on
+ * a uniform and a clustered scene, each at every size of
+ * BENCHMARK_BROADPHASE_OBJECT_COUNTS.
+ *
+ * Picking is checked the same way, the closest hit of PickObject against
+ * the closest hit over every object, and timed in picks per second.
+ *
+ * The grid keys and cell coordinates are checked on their own around the
+ * origin and at the limits of the key fields.
+ */
+class CBroadphaseBenchmark : public CBenchmark
+{
+public:
+	CBroadphaseBenchmark();
+
+	void Initialize(GLint iRuns, GLuint uiSeed);
+	void Run() override;
+
+	json GetReport() const override;
+	bool ArePairsValid() const;
+	bool ArePicksValid() const;
+	bool AreGridKeysValid() const;
+
+protected:
+	bool CheckPairs();
+	bool CheckPicks();
+	static bool CheckGridKeys();
+	void BenchmarkScene(EBroadphaseScene eScene, GLint iObjects);
+	void BenchmarkPicks();
+
+	// The world is a square of fWorldSize centered on the origin
+	void CreateScene(EBroadphaseScene eScene, GLint iObjects, GLfloat fWorldSize, TBroadphaseScene& rScene);
+	static void MoveScene(TBroadphaseScene& rScene, GLfloat fDeltaTime);
+	static GLint GetMoversCount(const TBroadphaseScene& rScene);
+
+	// One step of the broadphase, returns the number of pairs
+	static size_t StepBroadphase(CBroadphase& rBroadphase, TBroadphaseScene& rScene);
+	// BENCHMARK_BROADPHASE_FRAMES steps from the given scene, the moves are not timed
+	static double TimeFrames(CBroadphase& rBroadphase, TBroadphaseScene& rScene, size_t* psPairs);
+
+	// Pairs with the smaller pointer first, sorted, false when a pair is reported twice
+	static bool GetSortedPairs(const std::vector<TCollisionPair>& vPairs, std::vector<TCollisionPair>& vSorted);
+	static void GetBruteForcePairs(std::vector<CPhysicsObject>& vObjects, const std::vector<bool>& vTracked, std::vector<TCollisionPair>& vPairs);
+	static size_t GetOccupiedCellsCount(const CSpatialGrid& rGrid, std::vector<CPhysicsObject>& vObjects, const std::vector<bool>& vTracked);
+
+	// Rays looking down on a world of fWorldSize, some along an axis, some starting among the objects
+	void CreateRays(GLint iRays, GLfloat fWorldSize, GLfloat fRange, std::vector<CRay>& vRays);
+	static CPhysicsObject* PickBruteForce(std::vector<CPhysicsObject>& vObjects, const std::vector<bool>& vTracked, const CRay& ray, GLfloat* pfDistance);
+	static double TimePicks(CBroadphase& rBroadphase, const std::vector<CRay>& vRays, GLint* piHits);
+
+private:
+	bool m_bPairsValid;
+	bool m_bPicksValid;
+	bool m_bGridKeysValid;
+
+	std::vector<TBroadphaseBenchmarkResult> m_vResults;
+	TPickingBenchmarkResult m_PickingResult;
+};
@@ -0,0 +1,300 @@
+#include "JobBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+CJobBenchmark::CJobBenchmark()
+{
+	m_bDependencyOrder = false;
+	m_bExceptionPropagation = false;
+	m_bShutdownWithPendingJobs = false;
+}
+
+void CJobBenchmark::Initialize(GLint iRuns, GLuint uiSeed)
+{
+	SetRuns(iRuns, uiSeed);
+	m_vResults.clear();
+
+	std::uniform_real_distribution<GLfloat> dist(0.0f, 1000.0f);
+
+	m_vInputs.resize(BENCHMARK_JOB_ITEMS);
+	m_vExpected.resize(BENCHMARK_JOB_ITEMS);
+
+	for (GLint i = 0; i < BENCHMARK_JOB_ITEMS; i++)
+	{
+		m_vInputs[i] = dist(m_Random);
+		m_vExpected[i] = GetKernelValue(m_vInputs[i]);
+	}
+}
+
+void CJobBenchmark::Run()
+{
+	m_bDependencyOrder = CheckDependencyOrder();
+	m_bExceptionPropagation = CheckExceptionPropagation();
+	m_bShutdownWithPendingJobs = CheckShutdownWithPendingJobs();
+	BenchmarkScaling();
+}
+
+/*
+ * CheckDependencyOrder - A parent completes after its whole job tree.
+ *
+ * The children are created from outside and each one creates its own
+ * children on the root while it runs. A job scheduled before any of them
+ * waits on the root from a worker and must see every one of them done.
+ */
+bool CJobBenchmark::CheckDependencyOrder()
+{
+	CJobSystem jobSystem(BENCHMARK_JOB_CHECK_WORKERS);
+
+	std::atomic<GLint> iChildrenDone(0);
+	std::atomic<GLint> iGrandChildrenDone(0);
+	GLint iChildrenSeen = 0;
+	GLint iGrandChildrenSeen = 0;
+
+	TJobHandle pRoot = jobSystem.CreateJob(nullptr);
+
+	TJobHandle pContinuation = jobSystem.Schedule([&]()
+	{
+		jobSystem.Wait(pRoot);
+		iChildrenSeen = iChildrenDone.load();
+		iGrandChildrenSeen = iGrandChildrenDone.load();
+	});
+
+	for (GLint iChild = 0; iChild < BENCHMARK_JOB_CHILDREN; iChild++)
+	{
+		jobSystem.Run(jobSystem.CreateJob([&]()
+		{
+			for (GLint iGrandChild = 0; iGrandChild < BENCHMARK_JOB_GRANDCHILDREN; iGrandChild++)
+			{
+				jobSystem.Schedule([&]() { iGrandChildrenDone.fetch_add(1); }, pRoot);
+			}
+
+			iChildrenDone.fetch_add(1);
+		}, pRoot));
+	}
+
+	jobSystem.Run(pRoot);
+	jobSystem.Wait(pContinuation);
+
+	return (jobSystem.IsCompleted(pRoot) &&
+		iChildrenSeen == BENCHMARK_JOB_CHILDREN &&
+		iGrandChildrenSeen == BENCHMARK_JOB_CHILDREN * BENCHMARK_JOB_GRANDCHILDREN);
+}
+
+/*
+ * CheckExceptionPropagation - Failures reach the waiting thread.
+ *
+ * One index of a ParallelFor throws, the other chunks still run and the
+ * exception comes out of ParallelFor. A throw two levels under a root is
+ * rethrown by Wait() on the root. The system stays usable afterwards.
+ */
+bool CJobBenchmark::CheckExceptionPropagation()
+{
+	CJobSystem jobSystem(BENCHMARK_JOB_CHECK_WORKERS);
+
+	const GLint iCount = 1000;
+	const GLint iGrain = 10;
+	const GLint iFailingIndex = 737;
+
+	std::atomic<GLint> iIndicesRun(0);
+	bool bParallelForThrew = false;
+
+	try
+	{
+		jobSystem.ParallelFor(0, iCount, iGrain, [&](GLint iBegin, GLint iEnd)
+		{
+			for (GLint i = iBegin; i < iEnd; i++)
+			{
+				if (i == iFailingIndex)
+				{
+					throw std::runtime_error("index 737");
+				}
+
+				iIndicesRun.fetch_add(1);
+			}
+		});
+	}
+	catch (const std::runtime_error& e)
+	{
+		bParallelForThrew = std::strcmp(e.what(), "index 737") == 0;
+	}
+
+	// The failing chunk stops at its failing index, the others all ran
+	const GLint iExpectedRun = iCount - (iGrain - iFailingIndex % iGrain);
+
+	TJobHandle pRoot = jobSystem.CreateJob(nullptr);
+	TJobHandle pMiddle = jobSystem.CreateJob(nullptr, pRoot);
+	jobSystem.Run(jobSystem.CreateJob([]() { throw std::logic_error("grandchild"); }, pMiddle));
+	jobSystem.Run(pMiddle);
+	jobSystem.Run(pRoot);
+
+	bool bWaitThrew = false;
+	try
+	{
+		jobSystem.Wait(pRoot);
+	}
+	catch (const std::logic_error& e)
+	{
+		bWaitThrew = std::strcmp(e.what(), "grandchild") == 0;
+	}
+
+	std::atomic<GLint> iSum(0);
+	jobSystem.ParallelFor(0, iCount, iGrain, [&](GLint iBegin, GLint iEnd)
+	{
+		iSum.fetch_add(iEnd - iBegin);
+	});
+
+	return (bParallelForThrew && iIndicesRun.load() == iExpectedRun && bWaitThrew && iSum.load() == iCount);
+}
+
+/*
+ * CheckShutdownWithPendingJobs - Shutdown() drops no job.
+ *
+ * Jobs and main thread jobs are queued and Shutdown() is called right
+ * away. Every one of them has to run, including a job created by a job
+ * while the workers stop, and a job run after Shutdown() runs at once.
+ */
+bool CJobBenchmark::CheckShutdownWithPendingJobs()
+{
+	const GLint iMainThreadJobs = 16;
+
+	std::atomic<GLint> iJobsRun(0);
+	std::atomic<GLint> iMainThreadJobsRun(0);
+	std::vector<TJobHandle> vJobs;
+
+	CJobSystem jobSystem(BENCHMARK_JOB_CHECK_WORKERS);
+
+	for (GLint i = 0; i < BENCHMARK_JOB_PENDING; i++)
+	{
+		vJobs.push_back(jobSystem.Schedule([&]() { iJobsRun.fetch_add(1); }));
+	}
+
+	vJobs.push_back(jobSystem.Schedule([&]()
+	{
+		jobSystem.Schedule([&]() { iJobsRun.fetch_add(1); });
+	}));
+
+	for (GLint i = 0; i < iMainThreadJobs; i++)
+	{
+		vJobs.push_back(jobSystem.RunOnMainThread([&]() { iMainThreadJobsRun.fetch_add(1); }));
+	}
+
+	jobSystem.Shutdown();
+
+	const bool bAllCompleted = std::all_of(vJobs.begin(), vJobs.end(), [&](const TJobHandle& pJob) { return (jobSystem.IsCompleted(pJob)); });
+	const bool bPendingRun = iJobsRun.load() == BENCHMARK_JOB_PENDING + 1 && iMainThreadJobsRun.load() == iMainThreadJobs;
+
+	jobSystem.Schedule([&]() { iJobsRun.fetch_add(1); });
+	const bool bRunAfterShutdown = iJobsRun.load() == BENCHMARK_JOB_PENDING + 2;
+
+	return (bAllCompleted && bPendingRun && bRunAfterShutdown);
+}
+
+/*
+ * BenchmarkScaling - ParallelFor from one thread to every hardware thread.
+ *
+ * The thread count doubles up to the hardware thread count, which is
+ * always measured. One thread is the caller alone, without worker.
+ */
+void CJobBenchmark::BenchmarkScaling()
+{
+	const GLint iHardwareThreads = std::max(static_cast<GLint>(std::thread::hardware_concurrency()), 1);
+
+	std::vector<GLint> vThreadCounts;
+	for (GLint iThreads = 1; iThreads < iHardwareThreads; iThreads *= 2)
+	{
+		vThreadCounts.push_back(iThreads);
+	}
+	vThreadCounts.push_back(iHardwareThreads);
+
+	std::vector<GLfloat> vOutputs(BENCHMARK_JOB_ITEMS);
+
+	for (GLint iThreads : vThreadCounts)
+	{
+		CJobSystem jobSystem(iThreads - 1);
+
+		TJobScalingResult result;
+		result.iThreads = iThreads;
+		result.bMatchesSerial = true;
+
+		for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+		{
+			std::fill(vOutputs.begin(), vOutputs.end(), 0.0f);
+
+			const Clock::time_point start = Clock::now();
+			jobSystem.ParallelFor(0, BENCHMARK_JOB_ITEMS, 0, [&](GLint iBegin, GLint iEnd)
+			{
+				for (GLint i = iBegin; i < iEnd; i++)
+				{
+					vOutputs[i] = GetKernelValue(m_vInputs[i]);
+				}
+			});
+			result.vSamplesMs.push_back(GetElapsedMs(start));
+
+			result.bMatchesSerial = result.bMatchesSerial && std::memcmp(vOutputs.data(), m_vExpected.data(), vOutputs.size() * sizeof(GLfloat)) == 0;
+		}
+
+		m_vResults.push_back(result);
+	}
+}
+
+// Dependent chain of float operations, the same bits whatever thread runs it
+GLfloat CJobBenchmark::GetKernelValue(GLfloat fInput)
+{
+	GLfloat fValue = fInput;
+
+	for (GLint iStep = 0; iStep < BENCHMARK_JOB_ITEM_STEPS; iStep++)
+	{
+		fValue = fValue * 0.999f + std::sqrt(fValue + 1.0f);
+	}
+
+	return (fValue);
+}
+
+json CJobBenchmark::GetReport() const
+{
+	json jsonReport;
+	jsonReport["items"] = BENCHMARK_JOB_ITEMS;
+	jsonReport["steps_per_item"] = BENCHMARK_JOB_ITEM_STEPS;
+
+	jsonReport["checks"]["dependency_order"] = m_bDependencyOrder;
+	jsonReport["checks"]["exception_propagation"] = m_bExceptionPropagation;
+	jsonReport["checks"]["shutdown_with_pending_jobs"] = m_bShutdownWithPendingJobs;
+
+	double dSingleThreadMs = 0.0;
+
+	json jsonResults = json::array();
+	for (const TJobScalingResult& rResult : m_vResults)
+	{
+		json jsonResult = GetSampleStats(rResult.vSamplesMs);
+		const double dMedianMs = jsonResult["median_ms"].get<double>();
+
+		if (rResult.iThreads == 1)
+		{
+			dSingleThreadMs = dMedianMs;
+		}
+
+		const double dSpeedup = (dMedianMs > 0.0 && dSingleThreadMs > 0.0) ? dSingleThreadMs / dMedianMs : 0.0;
+
+		jsonResult["threads"] = rResult.iThreads;
+		jsonResult["speedup"] = dSpeedup;
+		jsonResult["efficiency"] = dSpeedup / static_cast<double>(rResult.iThreads);
+		jsonResult["matches_serial"] = rResult.bMatchesSerial;
+		jsonResults.push_back(jsonResult);
+	}
+
+	jsonReport["scaling"] = jsonResults;
+	return (jsonReport);
+}
+
+bool CJobBenchmark::AreChecksValid() const
+{
+	if (!m_bDependencyOrder || !m_bExceptionPropagation || !m_bShutdownWithPendingJobs)
+	{
+		return (false);
+	}
+
+	return (std::all_of(m_vResults.begin(), m_vResults.end(), [](const TJobScalingResult& rResult) { return (rResult.bMatchesSerial); }));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "BenchmarkBase.h"
+#include "../../LibGL/source/JobSystem.h"
+
+constexpr GLint BENCHMARK_JOB_ITEMS = 1 << 18;
+constexpr GLint BENCHMARK_JOB_ITEM_STEPS = 64;		// Kernel iterations per item
+constexpr GLint BENCHMARK_JOB_CHECK_WORKERS = 3;
+constexpr GLint BENCHMARK_JOB_CHILDREN = 64;
+constexpr GLint BENCHMARK_JOB_GRANDCHILDREN = 4;		// Spawned by each child
+constexpr GLint BENCHMARK_JOB_PENDING = 1000;			// Jobs still queued when Shutdown is called
+
+// ParallelFor timings of one thread count, the caller included
+typedef struct SJobScalingResult
+{
+	GLint iThreads;
+	std::vector<double> vSamplesMs;
+	bool bMatchesSerial;	// Every item equal to the single threaded result
+} TJobScalingResult;
+
+/**
+ * CJobBenchmark - Checks and scaling of CJobSystem.
+ *
+ * The checks only look at counters and results, never at timings, so they
+ * give the same answer on any machine: a parent waits for its whole job
+ * tree, an exception thrown by a job reaches Wait() and ParallelFor(), and
+ * Shutdown() runs the pending jobs instead of dropping them. The scaling
+ * run times ParallelFor over the same items from one thread up to the
+ * hardware thread count.
+ */
+class CJobBenchmark : public CBenchmark
+{
+public:
+	CJobBenchmark();
+
+	void Initialize(GLint iRuns, GLuint uiSeed);
+	void Run() override;
+
+	json GetReport() const override;
+	bool AreChecksValid() const;
+
+protected:
+	bool CheckDependencyOrder();
+	bool CheckExceptionPropagation();
+	bool CheckShutdownWithPendingJobs();
+	void BenchmarkScaling();
+
+	static GLfloat GetKernelValue(GLfloat fInput);
+
+private:
+	std::vector<GLfloat> m_vInputs;
+	std::vector<GLfloat> m_vExpected;
+
+	bool m_bDependencyOrder;
+	bool m_bExceptionPropagation;
+	bool m_bShutdownWithPendingJobs;
+
+	std::vector<TJobScalingResult> m_vResults;
+};
@@ -0,0 +1,586 @@
+#include "MatrixBenchmark.h"
+#include "../../LibGL/source/stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+
+CMatrixBenchmark::CMatrixBenchmark()
+{
+	m_bFrustumBoxesValid = false;
+}
+
+void CMatrixBenchmark::Initialize(GLint iRuns, GLuint uiSeed)
+{
+	SetRuns(iRuns, uiSeed);
+	m_vResults.clear();
+	m_bFrustumBoxesValid = false;
+
+	std::uniform_real_distribution<GLfloat> distPosition(-1000.0f, 1000.0f);
+
+	m_vMatrices.resize(BENCHMARK_MATRIX_COUNT);
+	m_vVectors.resize(BENCHMARK_MATRIX_COUNT);
+
+	for (GLint i = 0; i < BENCHMARK_MATRIX_COUNT; i++)
+	{
+		m_vMatrices[i] = GetRandomAffineMatrix();
+		m_vVectors[i] = SVector4Df(distPosition(m_Random), distPosition(m_Random), distPosition(m_Random), 1.0f);
+	}
+}
+
+void CMatrixBenchmark::Run()
+{
+#if defined(MATH_SIMD_SSE)
+	BenchmarkMultiply();
+	BenchmarkTransform();
+	BenchmarkTranspose();
+	BenchmarkInverseAffine();
+#endif
+	BenchmarkWorldTranslation();
+	BenchmarkFrustumCulling();
+	m_bFrustumBoxesValid = CheckFrustumBoxes();
+}
+
+// Chains every matrix with the next one, like world * view * projection
+void CMatrixBenchmark::BenchmarkMultiply()
+{
+#if defined(MATH_SIMD_SSE)
+	const size_t sCount = m_vMatrices.size();
+	std::vector<CMatrix4Df> vScalar(sCount), vSIMD(sCount);
+
+	TMatrixBenchmarkResult result;
+	result.stName = "multiply";
+	result.stDescription = "CMatrix4Df::MultiplyScalar against MultiplySIMD";
+
+	MeasureKernels(result,
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vScalar[i] = CMatrix4Df::MultiplyScalar(m_vMatrices[i], m_vMatrices[(i + 1) % sCount]);
+			}
+		},
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vSIMD[i] = CMatrix4Df::MultiplySIMD(m_vMatrices[i], m_vMatrices[(i + 1) % sCount]);
+			}
+		});
+
+	result.fMaxError = GetMaxError(vScalar, vSIMD);
+	m_vResults.push_back(result);
+#endif
+}
+
+void CMatrixBenchmark::BenchmarkTransform()
+{
+#if defined(MATH_SIMD_SSE)
+	const size_t sCount = m_vMatrices.size();
+	std::vector<SVector4Df> vScalar(sCount), vSIMD(sCount);
+
+	TMatrixBenchmarkResult result;
+	result.stName = "transform";
+	result.stDescription = "CMatrix4Df::TransformScalar against TransformSIMD";
+
+	MeasureKernels(result,
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vScalar[i] = CMatrix4Df::TransformScalar(m_vMatrices[i], m_vVectors[i]);
+			}
+		},
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vSIMD[i] = CMatrix4Df::TransformSIMD(m_vMatrices[i], m_vVectors[i]);
+			}
+		});
+
+	result.fMaxError = GetMaxError(vScalar, vSIMD);
+	m_vResults.push_back(result);
+#endif
+}
+
+void CMatrixBenchmark::BenchmarkTranspose()
+{
+#if defined(MATH_SIMD_SSE)
+	const size_t sCount = m_vMatrices.size();
+	std::vector<CMatrix4Df> vScalar(sCount), vSIMD(sCount);
+
+	TMatrixBenchmarkResult result;
+	result.stName = "transpose";
+	result.stDescription = "CMatrix4Df::TransposeScalar against TransposeSIMD";
+
+	MeasureKernels(result,
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vScalar[i] = CMatrix4Df::TransposeScalar(m_vMatrices[i]);
+			}
+		},
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vSIMD[i] = CMatrix4Df::TransposeSIMD(m_vMatrices[i]);
+			}
+		});
+
+	result.fMaxError = GetMaxError(vScalar, vSIMD);
+	m_vResults.push_back(result);
+#endif
+}
+
+void CMatrixBenchmark::BenchmarkInverseAffine()
+{
+#if defined(MATH_SIMD_SSE)
+	const size_t sCount = m_vMatrices.size();
+	std::vector<CMatrix4Df> vScalar(sCount), vSIMD(sCount);
+
+	TMatrixBenchmarkResult result;
+	result.stName = "inverse_affine";
+	result.stDescription = "CMatrix4Df::InverseAffineScalar against InverseAffineSIMD";
+
+	MeasureKernels(result,
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vScalar[i] = CMatrix4Df::InverseAffineScalar(m_vMatrices[i]);
+			}
+		},
+		[&]()
+		{
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vSIMD[i] = CMatrix4Df::InverseAffineSIMD(m_vMatrices[i]);
+			}
+		});
+
+	result.fMaxError = GetMaxError(vScalar, vSIMD);
+	m_vResults.push_back(result);
+#endif
+}
+
+/*
+ * BenchmarkWorldTranslation - Cached CWorldTranslation matrices.
+ *
+ * Every transform goes through a random sequence of setters with GetMatrix()
+ * calls in between, then its cached matrix must match the one rebuilt from
+ * its position, rotation and scale. The timing moves every transform (so all
+ * caches are dirty) and compares rebuilding the three matrices per object
+ * with one CWorldTranslation::UpdateMatrices pass.
+ */
+void CMatrixBenchmark::BenchmarkWorldTranslation()
+{
+	const size_t sCount = m_vMatrices.size();
+	std::vector<CWorldTranslation> vTransforms(sCount);
+
+	for (CWorldTranslation& rTransform : vTransforms)
+	{
+		for (GLint iSetter = 0; iSetter < BENCHMARK_TRANSFORM_SETTERS; iSetter++)
+		{
+			ApplyRandomSetter(rTransform);
+
+			// Refresh the cache now and then so later setters have to dirty it again
+			if (m_Random() % 3 == 0)
+			{
+				rTransform.GetMatrix();
+			}
+		}
+	}
+
+	std::vector<CMatrix4Df> vReference(sCount), vCached(sCount);
+	for (size_t i = 0; i < sCount; i++)
+	{
+		vReference[i] = GetReferenceWorldMatrix(vTransforms[i]);
+		vCached[i] = vTransforms[i].GetMatrix();
+	}
+
+	TMatrixBenchmarkResult result;
+	result.stName = "world_translation";
+	result.stDescription = "Translation * Rotation * Scale per object against CWorldTranslation::UpdateMatrices";
+	result.fMaxError = GetMaxError(vReference, vCached);
+
+	GLfloat fOffset = 0.0f;
+
+	MeasureKernels(result,
+		[&]()
+		{
+			fOffset += 1.0f;
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vTransforms[i].SetPosition(vTransforms[i].GetPosition().x, fOffset, vTransforms[i].GetPosition().z);
+				vReference[i] = GetReferenceWorldMatrix(vTransforms[i]);
+			}
+		},
+		[&]()
+		{
+			fOffset += 1.0f;
+			for (size_t i = 0; i < sCount; i++)
+			{
+				vTransforms[i].SetPosition(vTransforms[i].GetPosition().x, fOffset, vTransforms[i].GetPosition().z);
+			}
+
+			CWorldTranslation::UpdateMatrices(vTransforms.data(), sCount);
+		});
+
+	m_vResults.push_back(result);
+}
+
+/*
+ * BenchmarkFrustumCulling - Area object culling on BENCHMARK_CULL_BOXES boxes.
+ *
+ * Boxes are spread over a 4x4 terrain map seen from above one corner. The
+ * reference tests each box with IsBoxInsideViewFrustum and the distance to
+ * its closest point, CullBoxes does both over the packed array. The error
+ * is the share of boxes the two classify differently.
+ */
+void CMatrixBenchmark::BenchmarkFrustumCulling()
+{
+	std::uniform_real_distribution<GLfloat> distPosition(0.0f, 4.0f * 25600.0f);
+	std::uniform_real_distribution<GLfloat> distHeight(0.0f, 500.0f);
+	std::uniform_real_distribution<GLfloat> distSize(1.0f, 50.0f);
+
+	std::vector<TCullBox> vBoxes(BENCHMARK_CULL_BOXES);
+	for (TCullBox& rBox : vBoxes)
+	{
+		rBox.v3Min = SVector3Df(distPosition(m_Random), distHeight(m_Random), distPosition(m_Random));
+		rBox.v3Max = rBox.v3Min + SVector3Df(distSize(m_Random), distSize(m_Random), distSize(m_Random));
+	}
+
+	const SVector3Df v3Eye(1000.0f, 300.0f, 1000.0f);
+
+	CMatrix4Df matView{}, matProjection{};
+	matView.InitCameraTransform(v3Eye, SVector3Df(1.0f, -0.2f, 1.0f).normalize(), SVector3Df(0.0f, 1.0f, 0.0f));
+	matProjection.InitPersProjTransform(TPersProjInfo{ 45.0f, 1600.0f, 960.0f, 1.0f, 10000.0f });
+
+	const SFrustumCulling frustumCulling(matProjection * matView);
+
+	SVector4Df v4Planes[FRUSTUM_PLANES_NUM];
+	frustumCulling.GetPlanes(v4Planes);
+
+	const GLfloat fMaxDistanceSq = BENCHMARK_CULL_DISTANCE * BENCHMARK_CULL_DISTANCE;
+	std::vector<GLuint> vReference(BENCHMARK_CULL_BOXES), vCulled(BENCHMARK_CULL_BOXES);
+	GLuint uiReferenceCount = 0, uiCulledCount = 0;
+
+	TMatrixBenchmarkResult result;
+	result.stName = "frustum_cull";
+	result.stDescription = "SFrustumCulling::IsBoxInsideViewFrustum per box against CullBoxes";
+
+	MeasureKernels(result,
+		[&]()
+		{
+			uiReferenceCount = 0;
+			for (GLuint i = 0; i < vBoxes.size(); i++)
+			{
+				const TCullBox& rBox = vBoxes[i];
+				if (!frustumCulling.IsBoxInsideViewFrustum(rBox.v3Min, rBox.v3Max))
+				{
+					continue;
+				}
+
+				const SVector3Df v3Closest(MyMath::fminmax(rBox.v3Min.x, v3Eye.x, rBox.v3Max.x), MyMath::fminmax(rBox.v3Min.y, v3Eye.y, rBox.v3Max.y), MyMath::fminmax(rBox.v3Min.z, v3Eye.z, rBox.v3Max.z));
+				const SVector3Df v3Delta = v3Closest - v3Eye;
+				if (v3Delta.x * v3Delta.x + v3Delta.y * v3Delta.y + v3Delta.z * v3Delta.z <= fMaxDistanceSq)
+				{
+					vReference[uiReferenceCount++] = i;
+				}
+			}
+		},
+		[&]()
+		{
+			uiCulledCount = SFrustumCulling::CullBoxes(vBoxes.data(), static_cast<GLuint>(vBoxes.size()), v4Planes, v3Eye, BENCHMARK_CULL_DISTANCE, vCulled.data());
+		});
+
+	// Both lists are in increasing order, count the indices only one of them has
+	GLuint uiMismatches = 0;
+	for (GLuint i = 0, j = 0; i < uiReferenceCount || j < uiCulledCount;)
+	{
+		if (j == uiCulledCount || (i < uiReferenceCount && vReference[i] < vCulled[j]))
+		{
+			uiMismatches++;
+			i++;
+		}
+		else if (i == uiReferenceCount || vCulled[j] < vReference[i])
+		{
+			uiMismatches++;
+			j++;
+		}
+		else
+		{
+			i++;
+			j++;
+		}
+	}
+
+	result.fMaxError = static_cast<GLfloat>(uiMismatches) / static_cast<GLfloat>(BENCHMARK_CULL_BOXES);
+	m_vResults.push_back(result);
+}
+
+void CMatrixBenchmark::MeasureKernels(TMatrixBenchmarkResult& rResult, const std::function<void()>& fnReference, const std::function<void()>& fnOptimized)
+{
+	// One untimed pass each so the first samples do not pay for page faults
+	fnReference();
+	fnOptimized();
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		for (GLint iKernel = 0; iKernel < 2; iKernel++)
+		{
+			const bool bOptimized = (iKernel + iRun) % 2 == 1;
+			const std::function<void()>& fnKernel = bOptimized ? fnOptimized : fnReference;
+
+			const Clock::time_point start = Clock::now();
+			for (GLint iPass = 0; iPass < BENCHMARK_MATRIX_PASSES; iPass++)
+			{
+				fnKernel();
+			}
+
+			(bOptimized ? rResult.vOptimizedSamplesMs : rResult.vReferenceSamplesMs).push_back(GetElapsedMs(start));
+		}
+	}
+}
+
+// Translation * Rotation * Scale with non uniform scale, like CWorldTranslation
+CMatrix4Df CMatrixBenchmark::GetRandomAffineMatrix()
+{
+	std::uniform_real_distribution<GLfloat> distAngle(-180.0f, 180.0f);
+	std::uniform_real_distribution<GLfloat> distScale(0.25f, 4.0f);
+	std::uniform_real_distribution<GLfloat> distPosition(-1000.0f, 1000.0f);
+
+	CMatrix4Df matScale{}, matRotation{}, matTranslation{};
+	matScale.InitScaleTransform(distScale(m_Random), distScale(m_Random), distScale(m_Random));
+	matRotation.InitRotateTransformZYX(distAngle(m_Random), distAngle(m_Random), distAngle(m_Random));
+	matTranslation.InitTranslationTransform(distPosition(m_Random), distPosition(m_Random), distPosition(m_Random));
+
+	return (CMatrix4Df::MultiplyScalar(CMatrix4Df::MultiplyScalar(matTranslation, matRotation), matScale));
+}
+
+void CMatrixBenchmark::ApplyRandomSetter(CWorldTranslation& rTransform)
+{
+	std::uniform_real_distribution<GLfloat> distAngle(-180.0f, 180.0f);
+	std::uniform_real_distribution<GLfloat> distScale(0.25f, 4.0f);
+	std::uniform_real_distribution<GLfloat> distPosition(-1000.0f, 1000.0f);
+
+	switch (m_Random() % 7)
+	{
+	case 0:
+		rTransform.SetPosition(distPosition(m_Random), distPosition(m_Random), distPosition(m_Random));
+		break;
+	case 1:
+		rTransform.SetPosition(SVector3Df(distPosition(m_Random), distPosition(m_Random), distPosition(m_Random)));
+		break;
+	case 2:
+		rTransform.SetRotation(distAngle(m_Random), distAngle(m_Random), distAngle(m_Random));
+		break;
+	case 3:
+		rTransform.Rotate(SVector3Df(distAngle(m_Random), distAngle(m_Random), distAngle(m_Random)));
+		break;
+	case 4:
+		rTransform.SetScale(distScale(m_Random));
+		break;
+	case 5:
+		rTransform.SetScale(distScale(m_Random), distScale(m_Random), distScale(m_Random));
+		break;
+	default:
+		// Same value again, must not lose a pending rebuild
+		rTransform.SetPosition(rTransform.GetPosition());
+		break;
+	}
+}
+
+CMatrix4Df CMatrixBenchmark::GetReferenceWorldMatrix(const CWorldTranslation& rTransform)
+{
+	const SVector3Df& v3Pos = rTransform.GetPosition();
+	const SVector3Df& v3Rot = rTransform.GetRotation();
+	const SVector3Df& v3Scale = rTransform.GetScale();
+
+	CMatrix4Df matScale{}, matRotation{}, matTranslation{};
+	matScale.InitScaleTransform(v3Scale.x, v3Scale.y, v3Scale.z);
+	matRotation.InitRotateTransformZYX(v3Rot.x, v3Rot.y, v3Rot.z);
+	matTranslation.InitTranslationTransform(v3Pos.x, v3Pos.y, v3Pos.z);
+
+	return (CMatrix4Df::MultiplyScalar(CMatrix4Df::MultiplyScalar(matTranslation, matRotation), matScale));
+}
+
+/*
+ * GetMaxError - Largest normwise relative difference over a set of results.
+ *
+ * Differences are divided by the largest element of the expected result
+ * (or 1 if smaller): an element that cancels down to ~0 from terms in the
+ * thousands legitimately carries an absolute error of that order.
+ */
+GLfloat CMatrixBenchmark::GetMaxError(const std::vector<CMatrix4Df>& vExpected, const std::vector<CMatrix4Df>& vValues)
+{
+	GLfloat fMaxError = 0.0f;
+
+	for (size_t i = 0; i < vExpected.size(); i++)
+	{
+		const GLfloat* pExpected = &vExpected[i].mat4[0][0];
+		const GLfloat* pValue = &vValues[i].mat4[0][0];
+
+		fMaxError = std::max(fMaxError, GetRelativeError(pExpected, pValue, 16));
+	}
+
+	return (fMaxError);
+}
+
+GLfloat CMatrixBenchmark::GetMaxError(const std::vector<SVector4Df>& vExpected, const std::vector<SVector4Df>& vValues)
+{
+	GLfloat fMaxError = 0.0f;
+
+	for (size_t i = 0; i < vExpected.size(); i++)
+	{
+		const GLfloat fExpected[4] = { vExpected[i].x, vExpected[i].y, vExpected[i].z, vExpected[i].w };
+		const GLfloat fValue[4] = { vValues[i].x, vValues[i].y, vValues[i].z, vValues[i].w };
+
+		fMaxError = std::max(fMaxError, GetRelativeError(fExpected, fValue, 4));
+	}
+
+	return (fMaxError);
+}
+
+GLfloat CMatrixBenchmark::GetRelativeError(const GLfloat* pExpected, const GLfloat* pValue, GLint iCount)
+{
+	GLfloat fScale = 1.0f;
+	GLfloat fMaxDifference = 0.0f;
+
+	for (GLint i = 0; i < iCount; i++)
+	{
+		fScale = std::max(fScale, std::fabs(pExpected[i]));
+		fMaxDifference = std::max(fMaxDifference, std::fabs(pExpected[i] - pValue[i]));
+	}
+
+	return (fMaxDifference / fScale);
+}
+
+/*
+ * CheckFrustumBoxes - IsBoxInsideViewFrustum on boxes placed by hand.
+ *
+ * A CCamera with a square 90 degree view, so in camera space the side
+ * planes are x = +-z and y = +-z between the near and far planes. Boxes
+ * well inside, boxes straddling each plane and a box holding the whole
+ * frustum must be kept; boxes beyond each plane must be rejected. The
+ * same boxes are checked from cameras moved and turned to look along
+ * other axes, the boxes following them, so every plane normal sign is
+ * used. Boxes keep a margin from the planes they do not cross, the
+ * camera axes rebuilt from its angles are not exact.
+ */
+bool CMatrixBenchmark::CheckFrustumBoxes()
+{
+	const TFrustumBoxCase aCases[] =
+	{
+		{ "inside",				SVector3Df(-1.0f, -1.0f, 10.0f),	SVector3Df(1.0f, 1.0f, 12.0f),		true },
+		{ "inside_large",		SVector3Df(-15.0f, -15.0f, 20.0f),	SVector3Df(15.0f, 15.0f, 80.0f),	true },
+		{ "holds_frustum",		SVector3Df(-500.0f, -500.0f, -500.0f),	SVector3Df(500.0f, 500.0f, 500.0f),	true },
+		{ "straddles_near",		SVector3Df(-0.2f, -0.2f, 0.5f),		SVector3Df(0.2f, 0.2f, 2.0f),		true },
+		{ "straddles_far",		SVector3Df(-5.0f, -5.0f, 90.0f),	SVector3Df(5.0f, 5.0f, 110.0f),		true },
+		{ "straddles_left",		SVector3Df(-25.0f, -2.0f, 20.0f),	SVector3Df(-15.0f, 2.0f, 22.0f),	true },
+		{ "straddles_right",	SVector3Df(15.0f, -2.0f, 20.0f),	SVector3Df(25.0f, 2.0f, 22.0f),		true },
+		{ "straddles_bottom",	SVector3Df(-2.0f, -25.0f, 20.0f),	SVector3Df(2.0f, -15.0f, 22.0f),	true },
+		{ "straddles_top",		SVector3Df(-2.0f, 15.0f, 20.0f),	SVector3Df(2.0f, 25.0f, 22.0f),		true },
+		{ "straddles_corner",	SVector3Df(15.0f, 15.0f, 20.0f),	SVector3Df(25.0f, 25.0f, 22.0f),	true },
+		{ "behind",				SVector3Df(-5.0f, -5.0f, -20.0f),	SVector3Df(5.0f, 5.0f, -2.0f),		false },
+		{ "before_near",		SVector3Df(-0.2f, -0.2f, 0.1f),		SVector3Df(0.2f, 0.2f, 0.5f),		false },
+		{ "beyond_far",			SVector3Df(-5.0f, -5.0f, 110.0f),	SVector3Df(5.0f, 5.0f, 130.0f),		false },
+		{ "left",				SVector3Df(-60.0f, -2.0f, 20.0f),	SVector3Df(-40.0f, 2.0f, 30.0f),	false },
+		{ "right",				SVector3Df(40.0f, -2.0f, 20.0f),	SVector3Df(60.0f, 2.0f, 30.0f),		false },
+		{ "below",				SVector3Df(-2.0f, -60.0f, 20.0f),	SVector3Df(2.0f, -40.0f, 30.0f),	false },
+		{ "above",				SVector3Df(-2.0f, 40.0f, 20.0f),	SVector3Df(2.0f, 60.0f, 30.0f),		false },
+	};
+
+	// Position and direction of each camera, all level so the boxes stay axis aligned
+	const SVector3Df av3Positions[] = { SVector3Df(0.0f, 0.0f, 0.0f), SVector3Df(100.0f, 50.0f, -30.0f), SVector3Df(-20.0f, 300.0f, 40.0f) };
+	const SVector3Df av3Directions[] = { SVector3Df(0.0f, 0.0f, 1.0f), SVector3Df(-1.0f, 0.0f, 0.0f), SVector3Df(1.0f, 0.0f, 0.0f) };
+
+	for (GLint iCamera = 0; iCamera < 3; iCamera++)
+	{
+		const SVector3Df& v3Position = av3Positions[iCamera];
+
+		const CCamera camera(TPersProjInfo{ 90.0f, 1000.0f, 1000.0f, BENCHMARK_FRUSTUM_NEAR, BENCHMARK_FRUSTUM_FAR }, v3Position, av3Directions[iCamera], SVector3Df(0.0f, 1.0f, 0.0f));
+		const SFrustumCulling frustumCulling(camera.GetViewProjMatrix());
+
+		// The camera rebuilds its target from its angles, the boxes follow the axes it ends up with
+		const SVector3Df& v3Forward = camera.GetTarget();
+		const SVector3Df& v3Up = camera.GetUp();
+
+		// Which way right points does not matter, every case is the same mirrored
+		const SVector3Df v3Right = v3Up.cross(v3Forward);
+
+		for (const TFrustumBoxCase& rCase : aCases)
+		{
+			const SVector3Df v3CornerA = v3Position + v3Right * rCase.v3Min.x + v3Up * rCase.v3Min.y + v3Forward * rCase.v3Min.z;
+			const SVector3Df v3CornerB = v3Position + v3Right * rCase.v3Max.x + v3Up * rCase.v3Max.y + v3Forward * rCase.v3Max.z;
+
+			const SVector3Df v3Min(std::min(v3CornerA.x, v3CornerB.x), std::min(v3CornerA.y, v3CornerB.y), std::min(v3CornerA.z, v3CornerB.z));
+			const SVector3Df v3Max(std::max(v3CornerA.x, v3CornerB.x), std::max(v3CornerA.y, v3CornerB.y), std::max(v3CornerA.z, v3CornerB.z));
+
+			if (frustumCulling.IsBoxInsideViewFrustum(v3Min, v3Max) != rCase.bInside)
+			{
+				sys_err("CMatrixBenchmark::CheckFrustumBoxes: Camera %d box %s reported %s", iCamera, rCase.pszName, rCase.bInside ? "outside" : "inside");
+				return (false);
+			}
+		}
+	}
+
+	return (true);
+}
+
+bool CMatrixBenchmark::AreFrustumBoxesValid() const
+{
+	return (m_bFrustumBoxesValid);
+}
+
+bool CMatrixBenchmark::IsWithinTolerance() const
+{
+	for (const TMatrixBenchmarkResult& rResult : m_vResults)
+	{
+		if (!(rResult.fMaxError <= BENCHMARK_MATRIX_TOLERANCE))
+		{
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+json CMatrixBenchmark::GetReport() const
+{
+	json jsonReport;
+#if defined(MATH_SIMD_AVX2)
+	jsonReport["simd"] = "AVX2";
+#elif defined(MATH_SIMD_SSE)
+	jsonReport["simd"] = "SSE";
+#else
+	jsonReport["simd"] = "none";
+#endif
+	jsonReport["matrices"] = BENCHMARK_MATRIX_COUNT;
+	jsonReport["passes_per_sample"] = BENCHMARK_MATRIX_PASSES;
+	jsonReport["tolerance"] = BENCHMARK_MATRIX_TOLERANCE;
+
+	json jsonResults = json::array();
+	for (const TMatrixBenchmarkResult& rResult : m_vResults)
+	{
+		json jsonResult;
+		jsonResult["name"] = rResult.stName;
+		jsonResult["description"] = rResult.stDescription;
+		jsonResult["reference"] = GetSampleStats(rResult.vReferenceSamplesMs);
+		jsonResult["optimized"] = GetSampleStats(rResult.vOptimizedSamplesMs);
+
+		const double dReferenceMs = jsonResult["reference"]["median_ms"].get<double>();
+		const double dOptimizedMs = jsonResult["optimized"]["median_ms"].get<double>();
+
+		jsonResult["speedup"] = dOptimizedMs > 0.0 ? dReferenceMs / dOptimizedMs : 0.0;
+		jsonResult["max_error"] = rResult.fMaxError;
+		jsonResult["within_tolerance"] = rResult.fMaxError <= BENCHMARK_MATRIX_TOLERANCE;
+		jsonResults.push_back(jsonResult);
+	}
+
+	jsonReport["results"] = jsonResults;
+	jsonReport["checks"]["frustum_boxes"] = m_bFrustumBoxesValid;
+	return (jsonReport);
+}
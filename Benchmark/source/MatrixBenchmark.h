@@ -0,0 +1,86 @@
+#pragma once
+
+#include <functional>
+
+#include "BenchmarkBase.h"
+#include "../../LibMath/source/stdafx.h"
+
+constexpr GLint BENCHMARK_MATRIX_COUNT = 4096;
+constexpr GLint BENCHMARK_MATRIX_PASSES = 16;			// Passes over the matrices per sample
+constexpr GLfloat BENCHMARK_MATRIX_TOLERANCE = 1.0e-5f;	// Normwise relative, optimized against reference
+constexpr GLint BENCHMARK_TRANSFORM_SETTERS = 16;		// Random setter calls per transform in the cache check
+constexpr GLint BENCHMARK_CULL_BOXES = 100000;
+constexpr GLfloat BENCHMARK_CULL_DISTANCE = 4000.0f;	// Max draw distance of the culling check
+constexpr GLfloat BENCHMARK_FRUSTUM_NEAR = 1.0f;		// CheckFrustumBoxes camera, 90 degrees square so a side plane is |x| = z
+constexpr GLfloat BENCHMARK_FRUSTUM_FAR = 100.0f;
+
+// Timings of a reference implementation and of its optimized version
+typedef struct SMatrixBenchmarkResult
+{
+	std::string stName;
+	std::string stDescription;
+	std::vector<double> vReferenceSamplesMs;
+	std::vector<double> vOptimizedSamplesMs;
+	GLfloat fMaxError;		// Largest normwise relative difference between the two results
+} TMatrixBenchmarkResult;
+
+// Box of CheckFrustumBoxes in camera space: x right, y up, z forward
+typedef struct SFrustumBoxCase
+{
+	const char* pszName;
+	SVector3Df v3Min;
+	SVector3Df v3Max;
+	bool bInside;
+} TFrustumBoxCase;
+
+/**
+ * CMatrixBenchmark - Optimized matrix paths against their reference.
+ *
+ * Runs the scalar and SIMD versions of the CMatrix4Df multiply, vector
+ * transform, transpose and affine inverse on the same random affine
+ * matrices, the cached CWorldTranslation matrices against rebuilding
+ * Translation * Rotation * Scale, and SFrustumCulling::CullBoxes against
+ * one IsBoxInsideViewFrustum call per box. Reports the speedups and checks
+ * that the results agree within BENCHMARK_MATRIX_TOLERANCE.
+ */
+class CMatrixBenchmark : public CBenchmark
+{
+public:
+	CMatrixBenchmark();
+
+	void Initialize(GLint iRuns, GLuint uiSeed);
+	void Run() override;
+
+	json GetReport() const override;
+	bool IsWithinTolerance() const;
+	// IsBoxInsideViewFrustum keeps the boxes inside or crossing a CCamera frustum and rejects the ones outside
+	bool AreFrustumBoxesValid() const;
+
+protected:
+	void BenchmarkMultiply();
+	void BenchmarkTransform();
+	void BenchmarkTranspose();
+	void BenchmarkInverseAffine();
+	void BenchmarkWorldTranslation();
+	void BenchmarkFrustumCulling();
+	bool CheckFrustumBoxes();
+
+	// Times both versions m_iRuns times, alternating which one goes first
+	void MeasureKernels(TMatrixBenchmarkResult& rResult, const std::function<void()>& fnReference, const std::function<void()>& fnOptimized);
+
+	CMatrix4Df GetRandomAffineMatrix();
+	void ApplyRandomSetter(CWorldTranslation& rTransform);
+
+	// Translation * Rotation * Scale from three matrices, what CWorldTranslation::GetMatrix used to do per call
+	static CMatrix4Df GetReferenceWorldMatrix(const CWorldTranslation& rTransform);
+
+	static GLfloat GetMaxError(const std::vector<CMatrix4Df>& vExpected, const std::vector<CMatrix4Df>& vValues);
+	static GLfloat GetMaxError(const std::vector<SVector4Df>& vExpected, const std::vector<SVector4Df>& vValues);
+	static GLfloat GetRelativeError(const GLfloat* pExpected, const GLfloat* pValue, GLint iCount);
+
+private:
+	std::vector<CMatrix4Df> m_vMatrices;
+	std::vector<SVector4Df> m_vVectors;
+	std::vector<TMatrixBenchmarkResult> m_vResults;
+	bool m_bFrustumBoxesValid;
+};
@@ -0,0 +1,454 @@
+#include "PhysicsBenchmark.h"
+#include "../../LibGame/source/PhysicsWorld.h"
+#include "../../LibGL/source/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+CPhysicsBenchmark::CPhysicsBenchmark()
+{
+	m_pTerrainMap = nullptr;
+	m_fAreaSizeX = m_fAreaSizeZ = 1000.0f;
+	m_bInterpolationValid = false;
+	m_bDropValid = false;
+}
+
+void CPhysicsBenchmark::Initialize(CTerrainMap* pTerrainMap, GLint iRuns, GLuint uiSeed)
+{
+	SetRuns(iRuns, uiSeed);
+	m_vResults.clear();
+	m_bInterpolationValid = false;
+	m_bDropValid = false;
+
+	m_pTerrainMap = pTerrainMap;
+	m_fAreaSizeX = m_fAreaSizeZ = 1000.0f;
+
+	if (m_pTerrainMap)
+	{
+		GLint iTerrainCountX = 0, iTerrainCountZ = 0;
+		m_pTerrainMap->GetTerrainsCount(&iTerrainCountX, &iTerrainCountZ);
+
+		if (iTerrainCountX > 0 && iTerrainCountZ > 0)
+		{
+			m_fAreaSizeX = static_cast<GLfloat>(iTerrainCountX * TERRAIN_XSIZE);
+			m_fAreaSizeZ = static_cast<GLfloat>(iTerrainCountZ * TERRAIN_ZSIZE);
+		}
+		else
+		{
+			m_pTerrainMap = nullptr;
+		}
+	}
+}
+
+void CPhysicsBenchmark::Run()
+{
+	m_bInterpolationValid = CheckInterpolation();
+	m_bDropValid = CheckDrop();
+
+	for (GLint iBodies : BENCHMARK_PHYSICS_BODY_COUNTS)
+	{
+		BenchmarkIntegration(iBodies);
+	}
+}
+
+/*
+ * CheckInterpolation - Matrices of GetInterpolatedMatrix on wrapping angles.
+ *
+ * Each case loads a step into an object and compares its matrix with the
+ * one built from the expected rotation. Angles going over 180 or below
+ * -180, and some a whole turn apart, must blend over the short arc.
+ */
+bool CPhysicsBenchmark::CheckInterpolation()
+{
+	static const TInterpolationCase interpolationCases[] =
+	{
+		{ SVector3Df(0.0f, 0.0f, 0.0f), SVector3Df(90.0f, -45.0f, 30.0f), 0.5f, SVector3Df(45.0f, -22.5f, 15.0f) },
+		{ SVector3Df(350.0f, 10.0f, -170.0f), SVector3Df(10.0f, 350.0f, 170.0f), 0.5f, SVector3Df(0.0f, 0.0f, 180.0f) },
+		{ SVector3Df(179.0f, -90.0f, 170.0f), SVector3Df(-179.0f, 80.0f, -170.0f), 0.25f, SVector3Df(179.5f, -47.5f, 175.0f) },
+		{ SVector3Df(720.0f, -360.0f, 5.0f), SVector3Df(10.0f, 20.0f, 365.0f), 0.5f, SVector3Df(5.0f, 10.0f, 5.0f) },
+	};
+
+	const SVector3Df v3PrevPosition(0.0f, 0.0f, 0.0f);
+	const SVector3Df v3Position(10.0f, 20.0f, 30.0f);
+	const SVector3Df v3Scale(1.0f, 2.0f, 1.0f);
+
+	const GLint iCases = static_cast<GLint>(sizeof(interpolationCases) / sizeof(interpolationCases[0]));
+
+	for (GLint iCase = 0; iCase < iCases; iCase++)
+	{
+		const TInterpolationCase& interpolationCase = interpolationCases[iCase];
+
+		CPhysicsObject object;
+		object.SetScale(v3Scale);
+
+		TPhysicsBodyState state;
+		object.GetBodyState(state);
+		state.v3PrevPosition = v3PrevPosition;
+		state.v3Position = v3Position;
+		state.v3PrevRotation = interpolationCase.v3PrevRotation;
+		state.v3Rotation = interpolationCase.v3Rotation;
+		object.LoadBodyState(state);
+
+		const CMatrix4Df matrix = object.GetInterpolatedMatrix(interpolationCase.fAlpha);
+		const CMatrix4Df expected = CWorldTranslation::BuildMatrix(v3PrevPosition + (v3Position - v3PrevPosition) * interpolationCase.fAlpha, interpolationCase.v3Expected, v3Scale);
+
+		for (GLint i = 0; i < 16; i++)
+		{
+			const GLfloat fExpected = expected.mat4[i / 4][i % 4];
+			const GLfloat fValue = matrix.mat4[i / 4][i % 4];
+
+			if (std::abs(fExpected - fValue) > BENCHMARK_PHYSICS_TOLERANCE * std::max(std::abs(fExpected), 1.0f))
+			{
+				sys_err("CPhysicsBenchmark::CheckInterpolation: Case %d, element %d is %g instead of %g", iCase, i, fValue, fExpected);
+				return (false);
+			}
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * CheckDrop - Rest position of a dropped box at several framerates.
+ *
+ * The same box falls on the terrain map for BENCHMARK_PHYSICS_DROP_SECONDS
+ * through CPhysicsWorld::Update, called at each of the
+ * BENCHMARK_PHYSICS_DROP_RATES. The fixed step must bring it to rest on
+ * the ground at the same place every time.
+ */
+bool CPhysicsBenchmark::CheckDrop()
+{
+	if (!m_pTerrainMap)
+	{
+		sys_err("CPhysicsBenchmark::CheckDrop: No terrain map to drop the box on");
+		return (false);
+	}
+
+	const GLint iRates = static_cast<GLint>(sizeof(BENCHMARK_PHYSICS_DROP_RATES) / sizeof(BENCHMARK_PHYSICS_DROP_RATES[0]));
+
+	SVector3Df v3FirstRest;
+	for (GLint iRate = 0; iRate < iRates; iRate++)
+	{
+		SVector3Df v3Rest;
+		if (!DropBox(BENCHMARK_PHYSICS_DROP_RATES[iRate], v3Rest))
+		{
+			return (false);
+		}
+
+		if (iRate == 0)
+		{
+			v3FirstRest = v3Rest;
+			continue;
+		}
+
+		const SVector3Df v3Delta = v3Rest - v3FirstRest;
+		if (std::abs(v3Delta.x) > BENCHMARK_PHYSICS_DROP_TOLERANCE || std::abs(v3Delta.y) > BENCHMARK_PHYSICS_DROP_TOLERANCE || std::abs(v3Delta.z) > BENCHMARK_PHYSICS_DROP_TOLERANCE)
+		{
+			sys_err("CPhysicsBenchmark::CheckDrop: At %g Hz the box rests at (%g, %g, %g) instead of (%g, %g, %g)", BENCHMARK_PHYSICS_DROP_RATES[iRate],
+				v3Rest.x, v3Rest.y, v3Rest.z, v3FirstRest.x, v3FirstRest.y, v3FirstRest.z);
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * DropBox - Drops a box in a world of its own.
+ * @fFrameRate: Frames per second CPhysicsWorld::Update is called at.
+ * @v3RestPosition: Where the box ends.
+ *
+ * The box starts above the middle of the map, sliding, and must end on
+ * the ground without moving. Returns false when it does not.
+ */
+bool CPhysicsBenchmark::DropBox(GLfloat fFrameRate, SVector3Df& v3RestPosition)
+{
+	const GLfloat fX = m_fAreaSizeX * 0.5f;
+	const GLfloat fZ = m_fAreaSizeZ * 0.5f;
+
+	CPhysicsObject* pBox = new CPhysicsObject();
+	pBox->SetType(OBJECT_TYPE_DYNAMIC);
+	pBox->EnableGravity(true);
+	pBox->SetOnGround(false);
+	pBox->SetFriction(0.5f);
+	pBox->SetRestitution(0.5f);
+	pBox->SetBoundingBoxLocal(TBoundingBox(SVector3Df(-1.0f, 0.0f, -1.0f), SVector3Df(1.0f, 2.0f, 1.0f)));
+	pBox->SetTerrainMap(m_pTerrainMap);
+	pBox->SetPosition(SVector3Df(fX, m_pTerrainMap->GetHeight(fX, fZ) + BENCHMARK_PHYSICS_DROP_HEIGHT, fZ));
+	pBox->SetVelocity(SVector3Df(2.0f, 0.0f, -1.0f));
+
+	// The world owns the box from here and deletes it with itself
+	CPhysicsWorld world;
+	world.AddObject(pBox);
+
+	const GLint iFrames = static_cast<GLint>(std::lround(BENCHMARK_PHYSICS_DROP_SECONDS * fFrameRate));
+	for (GLint iFrame = 0; iFrame < iFrames; iFrame++)
+	{
+		world.Update(1.0f / fFrameRate);
+	}
+
+	v3RestPosition = pBox->GetPosition();
+
+	const SVector3Df& v3Velocity = pBox->GetVelocity();
+	if (!pBox->IsOnGround() || v3Velocity.x != 0.0f || v3Velocity.z != 0.0f || std::abs(v3Velocity.y) > PHYSICS_BOUNCE_STOP_SPEED)
+	{
+		sys_err("CPhysicsBenchmark::DropBox: At %g Hz the box still moves after %g seconds, velocity (%g, %g, %g)", fFrameRate, BENCHMARK_PHYSICS_DROP_SECONDS,
+			v3Velocity.x, v3Velocity.y, v3Velocity.z);
+		return (false);
+	}
+
+	return (true);
+}
+
+/*
+ * BenchmarkIntegration - Steps the same bodies through both paths.
+ * @iBodies: Number of bodies.
+ *
+ * Every sample starts again from the initial bodies. The serial samples
+ * run before the job system exists, so CPhysicsBodies::Integrate stays on
+ * the calling thread, the parallel ones while it does.
+ */
+void CPhysicsBenchmark::BenchmarkIntegration(GLint iBodies)
+{
+	std::vector<CPhysicsObject> vInitial;
+	CreateObjects(iBodies, vInitial);
+
+	TPhysicsBenchmarkResult result;
+	result.iBodies = iBodies;
+	result.fMaxError = 0.0f;
+
+	std::vector<CPhysicsObject> vObjects;
+	CPhysicsBodies bodies;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		vObjects = vInitial;
+
+		const Clock::time_point start = Clock::now();
+		for (GLint iStep = 0; iStep < BENCHMARK_PHYSICS_STEPS; iStep++)
+		{
+			for (CPhysicsObject& rObject : vObjects)
+			{
+				rObject.Update(PHYSICS_FIXED_TIMESTEP);
+			}
+		}
+		result.vObjectSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		FillBodies(vInitial, bodies);
+
+		const Clock::time_point start = Clock::now();
+		for (GLint iStep = 0; iStep < BENCHMARK_PHYSICS_STEPS; iStep++)
+		{
+			bodies.Integrate(PHYSICS_FIXED_TIMESTEP);
+		}
+		result.vSerialSamplesMs.push_back(GetElapsedMs(start));
+
+		result.fMaxError = std::max(result.fMaxError, GetMaxError(vObjects, bodies));
+	}
+
+	CJobSystem jobSystem;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		FillBodies(vInitial, bodies);
+
+		const Clock::time_point start = Clock::now();
+		for (GLint iStep = 0; iStep < BENCHMARK_PHYSICS_STEPS; iStep++)
+		{
+			bodies.Integrate(PHYSICS_FIXED_TIMESTEP);
+		}
+		result.vParallelSamplesMs.push_back(GetElapsedMs(start));
+
+		result.fMaxError = std::max(result.fMaxError, GetMaxError(vObjects, bodies));
+	}
+
+	m_vResults.push_back(result);
+}
+
+void CPhysicsBenchmark::CreateObjects(GLint iBodies, std::vector<CPhysicsObject>& vObjects)
+{
+	std::uniform_real_distribution<GLfloat> distUnit(0.0f, 1.0f);
+	std::uniform_real_distribution<GLfloat> distAreaX(0.0f, m_fAreaSizeX);
+	std::uniform_real_distribution<GLfloat> distAreaZ(0.0f, m_fAreaSizeZ);
+	std::uniform_real_distribution<GLfloat> distHeight(0.0f, 20.0f);
+	std::uniform_real_distribution<GLfloat> distSpeed(-10.0f, 10.0f);
+	std::uniform_real_distribution<GLfloat> distAngle(-180.0f, 180.0f);
+	std::uniform_real_distribution<GLfloat> distAngularSpeed(-90.0f, 90.0f);
+	std::uniform_real_distribution<GLfloat> distScale(0.5f, 2.0f);
+	std::uniform_real_distribution<GLfloat> distExtent(0.5f, 5.0f);
+
+	vObjects.clear();
+	vObjects.resize(iBodies);
+
+	for (GLint i = 0; i < iBodies; i++)
+	{
+		CPhysicsObject& rObject = vObjects[i];
+
+		rObject.SetType(i % BENCHMARK_PHYSICS_STATIC_EVERY == 0 ? OBJECT_TYPE_STATIC : OBJECT_TYPE_DYNAMIC);
+		rObject.EnableGravity(true);
+		rObject.SetOnGround(false);
+		rObject.SetFriction(distUnit(m_Random));
+		rObject.SetRestitution(distUnit(m_Random));
+		rObject.SetMomentOfInertiay(i % BENCHMARK_PHYSICS_NO_ROTATION_EVERY == 0 ? 0.0f : distScale(m_Random));
+
+		const SVector3Df v3Extent(distExtent(m_Random), distExtent(m_Random), distExtent(m_Random));
+		rObject.SetBoundingBoxLocal(TBoundingBox(SVector3Df(-v3Extent.x, 0.0f, -v3Extent.z), v3Extent));
+
+		SVector3Df v3Position(distAreaX(m_Random), 0.0f, distAreaZ(m_Random));
+		if (m_pTerrainMap && (i & 1))
+		{
+			rObject.SetTerrainMap(m_pTerrainMap);
+			v3Position.y = m_pTerrainMap->GetHeight(v3Position.x, v3Position.z) + distHeight(m_Random);
+		}
+		else
+		{
+			v3Position.y = distHeight(m_Random) * 5.0f;
+		}
+
+		rObject.SetPosition(v3Position);
+		rObject.SetRotation(SVector3Df(distAngle(m_Random), distAngle(m_Random), distAngle(m_Random)));
+		rObject.SetScale(SVector3Df(distScale(m_Random), distScale(m_Random), distScale(m_Random)));
+
+		rObject.SetVelocity(SVector3Df(distSpeed(m_Random), distSpeed(m_Random), distSpeed(m_Random)));
+		rObject.SetAcceleration(SVector3Df(distSpeed(m_Random), distSpeed(m_Random), distSpeed(m_Random)));
+		rObject.SetAngularVelocity(SVector3Df(distAngularSpeed(m_Random), distAngularSpeed(m_Random), distAngularSpeed(m_Random)));
+		rObject.SetTorque(SVector3Df(distSpeed(m_Random), distSpeed(m_Random), distSpeed(m_Random)));
+	}
+}
+
+// The bodies are added in the order of the objects, body i is object i
+void CPhysicsBenchmark::FillBodies(const std::vector<CPhysicsObject>& vObjects, CPhysicsBodies& rBodies)
+{
+	rBodies.Clear();
+
+	TPhysicsBodyState state;
+	for (const CPhysicsObject& rObject : vObjects)
+	{
+		rObject.GetBodyState(state);
+		rBodies.Add(nullptr, state);
+	}
+}
+
+/*
+ * GetMaxError - Largest relative difference between objects and bodies.
+ * @vExpected: Objects stepped with CPhysicsObject::Update.
+ * @rBodies: Bodies stepped with CPhysicsBodies::Integrate.
+ *
+ * Compares the position, rotation, velocities and world AABB. A body that
+ * does not agree on being on the ground counts as the largest error.
+ */
+GLfloat CPhysicsBenchmark::GetMaxError(const std::vector<CPhysicsObject>& vExpected, const CPhysicsBodies& rBodies)
+{
+	if (static_cast<GLint>(vExpected.size()) != rBodies.GetCount())
+	{
+		return (std::numeric_limits<GLfloat>::max());
+	}
+
+	GLfloat fMaxError = 0.0f;
+	TPhysicsBodyState state;
+
+	for (GLint i = 0; i < rBodies.GetCount(); i++)
+	{
+		const CPhysicsObject& rObject = vExpected[i];
+		rBodies.GetStateAt(i, state);
+
+		if (rObject.IsOnGround() != ((state.ubFlags & PHYSICS_BODY_FLAG_ON_GROUND) != 0))
+		{
+			return (std::numeric_limits<GLfloat>::max());
+		}
+
+		const TBoundingBox worldBox = rObject.GetBoundingBoxWorld();
+
+		fMaxError = std::max(fMaxError, GetRelativeError(rObject.GetPosition(), state.v3Position));
+		fMaxError = std::max(fMaxError, GetRelativeError(rObject.GetRotation(), state.v3Rotation));
+		fMaxError = std::max(fMaxError, GetRelativeError(rObject.GetVelocity(), state.v3Velocity));
+		fMaxError = std::max(fMaxError, GetRelativeError(rObject.GetAngularVelocity(), state.v3AngularVelocity));
+		fMaxError = std::max(fMaxError, GetRelativeError(worldBox.v3Min, state.v3WorldMin));
+		fMaxError = std::max(fMaxError, GetRelativeError(worldBox.v3Max, state.v3WorldMax));
+	}
+
+	return (fMaxError);
+}
+
+// Per component, relative to the larger magnitude and absolute below 1
+GLfloat CPhysicsBenchmark::GetRelativeError(const SVector3Df& v3Expected, const SVector3Df& v3Value)
+{
+	const GLfloat fExpected[3] = { v3Expected.x, v3Expected.y, v3Expected.z };
+	const GLfloat fValue[3] = { v3Value.x, v3Value.y, v3Value.z };
+
+	GLfloat fMaxError = 0.0f;
+	for (GLint i = 0; i < 3; i++)
+	{
+		const GLfloat fScale = std::max({ 1.0f, std::abs(fExpected[i]), std::abs(fValue[i]) });
+		fMaxError = std::max(fMaxError, std::abs(fExpected[i] - fValue[i]) / fScale);
+	}
+
+	return (fMaxError);
+}
+
+double CPhysicsBenchmark::GetBodyStepsPerSecond(GLint iBodies, double dMedianMs)
+{
+	if (dMedianMs <= 0.0)
+	{
+		return (0.0);
+	}
+
+	return (static_cast<double>(iBodies) * BENCHMARK_PHYSICS_STEPS * 1000.0 / dMedianMs);
+}
+
+json CPhysicsBenchmark::GetReport() const
+{
+	json jsonReport;
+	jsonReport["steps_per_sample"] = BENCHMARK_PHYSICS_STEPS;
+	jsonReport["threads"] = std::max(static_cast<GLint>(std::thread::hardware_concurrency()), 1);
+	jsonReport["terrain_map"] = m_pTerrainMap != nullptr;
+	jsonReport["tolerance"] = BENCHMARK_PHYSICS_TOLERANCE;
+	jsonReport["checks"]["interpolation"] = m_bInterpolationValid;
+	jsonReport["checks"]["drop"] = m_bDropValid;
+
+	json jsonResults = json::array();
+	for (const TPhysicsBenchmarkResult& rResult : m_vResults)
+	{
+		json jsonResult;
+		jsonResult["bodies"] = rResult.iBodies;
+		jsonResult["objects"] = GetSampleStats(rResult.vObjectSamplesMs);
+		jsonResult["soa_serial"] = GetSampleStats(rResult.vSerialSamplesMs);
+		jsonResult["soa_parallel"] = GetSampleStats(rResult.vParallelSamplesMs);
+
+		const double dObjectsMs = jsonResult["objects"]["median_ms"].get<double>();
+		const double dSerialMs = jsonResult["soa_serial"]["median_ms"].get<double>();
+		const double dParallelMs = jsonResult["soa_parallel"]["median_ms"].get<double>();
+
+		jsonResult["objects"]["body_steps_per_second"] = GetBodyStepsPerSecond(rResult.iBodies, dObjectsMs);
+		jsonResult["soa_serial"]["body_steps_per_second"] = GetBodyStepsPerSecond(rResult.iBodies, dSerialMs);
+		jsonResult["soa_parallel"]["body_steps_per_second"] = GetBodyStepsPerSecond(rResult.iBodies, dParallelMs);
+
+		jsonResult["serial_speedup"] = dSerialMs > 0.0 ? dObjectsMs / dSerialMs : 0.0;
+		jsonResult["parallel_speedup"] = dParallelMs > 0.0 ? dObjectsMs / dParallelMs : 0.0;
+		jsonResult["max_error"] = rResult.fMaxError;
+		jsonResult["within_tolerance"] = rResult.fMaxError <= BENCHMARK_PHYSICS_TOLERANCE;
+		jsonResults.push_back(jsonResult);
+	}
+
+	jsonReport["results"] = jsonResults;
+	return (jsonReport);
+}
+
+bool CPhysicsBenchmark::IsWithinTolerance() const
+{
+	return (!m_vResults.empty() && std::all_of(m_vResults.begin(), m_vResults.end(), [](const TPhysicsBenchmarkResult& rResult) { return (rResult.fMaxError <= BENCHMARK_PHYSICS_TOLERANCE); }));
+}
+
+bool CPhysicsBenchmark::IsInterpolationValid() const
+{
+	return (m_bInterpolationValid);
+}
+
+bool CPhysicsBenchmark::IsDropValid() const
+{
+	return (m_bDropValid);
+}
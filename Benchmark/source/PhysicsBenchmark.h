@@ -0,0 +1,82 @@
+#pragma once
+
+#include "BenchmarkBase.h"
+#include "../../LibGame/source/PhysicsObject.h"
+
+constexpr GLint BENCHMARK_PHYSICS_BODY_COUNTS[] = { 10000, 25000, 50000, 100000 };
+constexpr GLint BENCHMARK_PHYSICS_STEPS = 60;				// Fixed steps per sample, one simulated second
+constexpr GLint BENCHMARK_PHYSICS_STATIC_EVERY = 8;			// One body in 8 is static and must not move
+constexpr GLint BENCHMARK_PHYSICS_NO_ROTATION_EVERY = 5;	// One body in 5 has no moment of inertia
+constexpr GLfloat BENCHMARK_PHYSICS_TOLERANCE = 1.0e-4f;	// Relative, CPhysicsBodies against CPhysicsObject::Update
+constexpr GLfloat BENCHMARK_PHYSICS_DROP_RATES[] = { 30.0f, 60.0f, 144.0f };	// Frames per second CPhysicsWorld::Update is called at
+constexpr GLfloat BENCHMARK_PHYSICS_DROP_SECONDS = 10.0f;	// Simulated time of each drop
+constexpr GLfloat BENCHMARK_PHYSICS_DROP_HEIGHT = 20.0f;	// Above the terrain
+constexpr GLfloat BENCHMARK_PHYSICS_DROP_TOLERANCE = 1.0e-3f;	// Units, between the rest positions of two framerates
+
+// Rotations before and after a step, and the one the frame at fAlpha must show
+typedef struct SInterpolationCase
+{
+	SVector3Df v3PrevRotation;
+	SVector3Df v3Rotation;
+	GLfloat fAlpha;
+	SVector3Df v3Expected;
+} TInterpolationCase;
+
+// Integration timings of one body count
+typedef struct SPhysicsBenchmarkResult
+{
+	GLint iBodies;
+	std::vector<double> vObjectSamplesMs;	// CPhysicsObject::Update on every object
+	std::vector<double> vSerialSamplesMs;	// CPhysicsBodies::Integrate without job system
+	std::vector<double> vParallelSamplesMs;	// CPhysicsBodies::Integrate on every hardware thread
+	GLfloat fMaxError;						// Largest relative difference with the objects, both runs
+} TPhysicsBenchmarkResult;
+
+/**
+ * CPhysicsBenchmark - Body integration on arrays against the objects.
+ *
+ * The same random bodies are stepped BENCHMARK_PHYSICS_STEPS times through
+ * CPhysicsObject::Update and through CPhysicsBodies::Integrate, first on
+ * the calling thread then on the job system. Some bodies are static, some
+ * do not rotate and half of them fall on the terrain map when there is
+ * one, so every branch of the step is compared.
+ *
+ * GetInterpolatedMatrix is checked on angles wrapping around, each must
+ * turn the short way. A box dropped on the terrain through
+ * CPhysicsWorld::Update must come to rest at the same place whatever the
+ * framerate.
+ */
+class CPhysicsBenchmark : public CBenchmark
+{
+public:
+	CPhysicsBenchmark();
+
+	void Initialize(CTerrainMap* pTerrainMap, GLint iRuns, GLuint uiSeed);
+	void Run() override;
+
+	json GetReport() const override;
+	bool IsWithinTolerance() const;
+	bool IsInterpolationValid() const;
+	bool IsDropValid() const;
+
+protected:
+	static bool CheckInterpolation();
+	bool CheckDrop();
+	bool DropBox(GLfloat fFrameRate, SVector3Df& v3RestPosition);
+	void BenchmarkIntegration(GLint iBodies);
+	void CreateObjects(GLint iBodies, std::vector<CPhysicsObject>& vObjects);
+
+	static void FillBodies(const std::vector<CPhysicsObject>& vObjects, CPhysicsBodies& rBodies);
+	static GLfloat GetMaxError(const std::vector<CPhysicsObject>& vExpected, const CPhysicsBodies& rBodies);
+	static GLfloat GetRelativeError(const SVector3Df& v3Expected, const SVector3Df& v3Value);
+	static double GetBodyStepsPerSecond(GLint iBodies, double dMedianMs);
+
+private:
+	CTerrainMap* m_pTerrainMap;
+	GLfloat m_fAreaSizeX;		// Bodies are spread over the map, or over a default area without one
+	GLfloat m_fAreaSizeZ;
+	bool m_bInterpolationValid;
+	bool m_bDropValid;
+
+	std::vector<TPhysicsBenchmarkResult> m_vResults;
+};
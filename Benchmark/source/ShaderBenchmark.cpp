@@ -0,0 +1,175 @@
+#include "ShaderBenchmark.h"
+#include "../../LibGL/source/stdafx.h"
+
+CShaderBenchmark::CShaderBenchmark()
+{
+	m_uiFakeLookups = 0;
+	m_bUniformCacheValid = false;
+}
+
+void CShaderBenchmark::Initialize(GLint iRuns, GLuint uiSeed)
+{
+	SetRuns(iRuns, uiSeed);
+	m_vLookupSamplesMs.clear();
+
+	// Locations of an array follow each other, as glGetUniformLocation gives them
+	m_mapFakeUniforms.clear();
+	m_mapFakeUniforms["u_matViewProjection"] = 0;
+	m_mapFakeUniforms["u_v3LightDirection"] = 4;
+	m_mapFakeUniforms["u_afWeights[0]"] = 5;
+	m_mapFakeUniforms["u_afWeights[1]"] = 6;
+	m_mapFakeUniforms["u_afWeights[2]"] = 7;
+
+	for (GLint i = 0; i < BENCHMARK_UNIFORM_NAMES; i++)
+	{
+		m_mapFakeUniforms["u_fValue" + std::to_string(i)] = 8 + i;
+	}
+
+	m_uiFakeLookups = 0;
+}
+
+void CShaderBenchmark::Run()
+{
+	m_bUniformCacheValid = CheckUniformCache();
+	BenchmarkUniformLookups();
+}
+
+GLint CShaderBenchmark::LookupFakeUniform(const std::string& stName)
+{
+	m_uiFakeLookups++;
+
+	auto it = m_mapFakeUniforms.find(stName);
+	if (it == m_mapFakeUniforms.end())
+	{
+		return (-1);
+	}
+
+	return (it->second);
+}
+
+/*
+ * CheckUniformCache - Locations and lookup calls of CUniformLocationCache.
+ *
+ * The array is added like CShader adds its active uniforms, the other
+ * names are only asked for. Each request is made twice: the second one
+ * must give the same location without calling the lookup. Clear must
+ * forget the names, and a cache without a lookup must answer -1.
+ */
+bool CShaderBenchmark::CheckUniformCache()
+{
+	CUniformLocationCache cache;
+	cache.SetLookup([this](const std::string& stName)
+	{
+		return (LookupFakeUniform(stName));
+	});
+
+	m_uiFakeLookups = 0;
+
+	if (!cache.AddUniform("u_afWeights[0]", 3) || cache.AddUniform("u_blockMember", 1))
+	{
+		sys_err("CShaderBenchmark::CheckUniformCache: AddUniform does not tell a located uniform from one without location");
+		return (false);
+	}
+
+	typedef struct SUniformRequest
+	{
+		const char* pszName;
+		GLint iExpected;
+		GLuint uiLookups;	// Lookup calls made once the request is answered, asked for the first time
+	} TUniformRequest;
+
+	const TUniformRequest aRequests[] =
+	{
+		{ "u_matViewProjection",	0,	3 },	// Hit, looked up on its first use
+		{ "u_afWeights",			5,	3 },	// Array base name, from AddUniform
+		{ "u_afWeights[2]",			7,	3 },	// Array element, from AddUniform
+		{ "u_fMissing",				-1,	4 },	// Miss, kept as -1
+		{ "u_blockMember",			-1,	5 },	// AddUniform skipped it, looked up again on its first use
+		{ "u_v3LightDirection",		4,	6 },
+	};
+
+	for (const TUniformRequest& rRequest : aRequests)
+	{
+		for (GLint iPass = 0; iPass < 2; iPass++)
+		{
+			const GLint iLocation = cache.GetLocation(rRequest.pszName);
+
+			if (iLocation != rRequest.iExpected)
+			{
+				sys_err("CShaderBenchmark::CheckUniformCache: %s at %d instead of %d", rRequest.pszName, iLocation, rRequest.iExpected);
+				return (false);
+			}
+
+			if (m_uiFakeLookups != rRequest.uiLookups || cache.GetLookupCount() != rRequest.uiLookups)
+			{
+				sys_err("CShaderBenchmark::CheckUniformCache: %s request %d made %u lookups in all (cache counts %u) instead of %u",
+					rRequest.pszName, iPass + 1, m_uiFakeLookups, cache.GetLookupCount(), rRequest.uiLookups);
+				return (false);
+			}
+		}
+	}
+
+	cache.Clear();
+	if (cache.GetLocation("u_matViewProjection") != 0 || cache.GetLookupCount() != 1)
+	{
+		sys_err("CShaderBenchmark::CheckUniformCache: Clear kept the cached locations");
+		return (false);
+	}
+
+	CUniformLocationCache noLookupCache;
+	if (noLookupCache.AddUniform("u_matViewProjection", 1) || noLookupCache.GetLocation("u_matViewProjection") != -1 || noLookupCache.GetSize() != 0)
+	{
+		sys_err("CShaderBenchmark::CheckUniformCache: A cache without lookup does not answer -1");
+		return (false);
+	}
+
+	return (true);
+}
+
+void CShaderBenchmark::BenchmarkUniformLookups()
+{
+	CUniformLocationCache cache;
+	cache.SetLookup([this](const std::string& stName)
+	{
+		return (LookupFakeUniform(stName));
+	});
+
+	std::vector<std::string> vNames;
+	for (GLint i = 0; i < BENCHMARK_UNIFORM_NAMES; i++)
+	{
+		vNames.push_back("u_fValue" + std::to_string(i));
+		cache.AddUniform(vNames.back());
+	}
+
+	// Summed so the lookups cannot be optimized away
+	volatile GLint iSink = 0;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		GLint iSum = 0;
+
+		const Clock::time_point start = Clock::now();
+		for (GLint i = 0; i < BENCHMARK_UNIFORM_LOOKUPS; i++)
+		{
+			iSum += cache.GetLocation(vNames[i % BENCHMARK_UNIFORM_NAMES]);
+		}
+		m_vLookupSamplesMs.push_back(GetElapsedMs(start));
+
+		iSink = iSink + iSum;
+	}
+}
+
+json CShaderBenchmark::GetReport() const
+{
+	json jsonReport;
+	jsonReport["uniforms"] = BENCHMARK_UNIFORM_NAMES;
+	jsonReport["lookups_per_sample"] = BENCHMARK_UNIFORM_LOOKUPS;
+	jsonReport["cached_lookups"] = GetSampleStats(m_vLookupSamplesMs);
+	jsonReport["checks"]["uniform_cache"] = m_bUniformCacheValid;
+	return (jsonReport);
+}
+
+bool CShaderBenchmark::IsUniformCacheValid() const
+{
+	return (m_bUniformCacheValid);
+}
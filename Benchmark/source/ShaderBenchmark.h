@@ -0,0 +1,44 @@
+#pragma once
+
+#include "BenchmarkBase.h"
+#include "../../LibGL/source/shader.h"
+
+constexpr GLint BENCHMARK_UNIFORM_NAMES = 64;			// Uniforms of the fake program
+constexpr GLint BENCHMARK_UNIFORM_LOOKUPS = 1 << 16;	// Timed GetLocation calls per sample
+
+/**
+ * CShaderBenchmark - CUniformLocationCache without a GL context.
+ *
+ * The cache gets a lookup function over a fake uniform list that counts
+ * its calls. The check asks for an active uniform, an array element, an
+ * unknown name and each of them again: the locations must be the ones of
+ * the list, -1 for the unknown name, and the lookup must be called only
+ * the first time a name is seen. The timing covers GetLocation on names
+ * already cached, the path of every uniform set in a frame.
+ */
+class CShaderBenchmark : public CBenchmark
+{
+public:
+	CShaderBenchmark();
+
+	void Initialize(GLint iRuns, GLuint uiSeed);
+	void Run() override;
+
+	json GetReport() const override;
+	bool IsUniformCacheValid() const;
+
+protected:
+	bool CheckUniformCache();
+	void BenchmarkUniformLookups();
+
+	// Lookup over m_mapFakeUniforms, -1 for a name missing from it
+	GLint LookupFakeUniform(const std::string& stName);
+
+private:
+	std::unordered_map<std::string, GLint> m_mapFakeUniforms;
+	GLuint m_uiFakeLookups;
+
+	bool m_bUniformCacheValid;
+
+	std::vector<double> m_vLookupSamplesMs;
+};
@@ -0,0 +1,1935 @@
+#include "TerrainBenchmark.h"
+#include "../../LibTerrain/source/Terrain.h"
+#include "../../LibTerrain/source/TerrainLoader.h"
+#include "../../LibTerrain/source/TerrainAreaData.h"
+#include "../../LibTerrain/source/TerrainChunk.h"
+#include "../../LibTerrain/source/TerrainVao.h"
+#include "../../LibGame/source/PhysicsWorld.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+CTerrainBenchmark::CTerrainBenchmark()
+{
+	m_iTerrainCountX = m_iTerrainCountZ = 0;
+	m_uiFirstFrameUploads = m_uiStaticFrameUploads = m_uiMovedObjectUploads = 0;
+	m_bDirtyRectsValid = false;
+	m_bUndoRedoValid = false;
+	m_bHeightBatchValid = false;
+	m_bPickingValid = false;
+	m_bChunkRoundTripValid = false;
+	m_bDrawCommandsValid = false;
+	m_bWaterPlanesValid = false;
+	m_bPatchBoxesValid = false;
+	m_bStreamingValid = false;
+	m_bTerrainLoadsValid = false;
+}
+
+CTerrainBenchmark::~CTerrainBenchmark()
+{
+	m_TerrainMap.Destroy();
+}
+
+bool CTerrainBenchmark::Initialize(const std::string& stMapName, GLint iRuns, GLuint uiSeed)
+{
+	SetRuns(iRuns, uiSeed);
+	m_stMapName = stMapName;
+	m_vResults.clear();
+
+	m_TerrainMap.SetMapName(stMapName);
+	if (!m_TerrainMap.LoadMapData())
+	{
+		sys_err("CTerrainBenchmark::Initialize: Failed to Load Map %s", stMapName.c_str());
+		return (false);
+	}
+
+	m_TerrainMap.GetTerrainsCount(&m_iTerrainCountX, &m_iTerrainCountZ);
+	return (true);
+}
+
+void CTerrainBenchmark::Run()
+{
+	BenchmarkTerrainLoad();
+	BenchmarkPatchGeneration();
+	BenchmarkHeightQueries();
+	BenchmarkHeightBrush();
+	BenchmarkTextureBrush();
+	BenchmarkInstanceUpdate();
+	m_bDirtyRectsValid = CheckDirtyRects();
+	m_bUndoRedoValid = CheckUndoRedo();
+	m_bHeightBatchValid = CheckHeightBatch();
+	m_bPickingValid = CheckPicking();
+	BenchmarkPicking();
+	m_bChunkRoundTripValid = CheckChunkRoundTrip();
+	m_bDrawCommandsValid = CheckDrawCommands();
+	m_bWaterPlanesValid = CheckWaterPlanes();
+	m_bPatchBoxesValid = CheckPatchBoxes();
+	// Load the map again, keep them last
+	m_bStreamingValid = CheckStreaming();
+	m_bTerrainLoadsValid = CheckTerrainLoads();
+}
+
+/*
+ * BenchmarkTerrainLoad - CPU stage of CTerrainMap::LoadTerrain.
+ *
+ * Times CTerrainLoader::LoadTerrainData (file reads and patch generation)
+ * on a pooled terrain, one sample per terrain and run. The terrains of the
+ * map stay loaded so the normals see their neighbours like in the game.
+ */
+void CTerrainBenchmark::BenchmarkTerrainLoad()
+{
+	TBenchmarkResult result;
+	result.stName = "terrain_load";
+	result.stDescription = "CTerrainLoader::LoadTerrainData, one terrain";
+	result.iItemsPerSample = 1;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		for (GLint iTerrainCoordZ = 0; iTerrainCoordZ < m_iTerrainCountZ; iTerrainCoordZ++)
+		{
+			for (GLint iTerrainCoordX = 0; iTerrainCoordX < m_iTerrainCountX; iTerrainCoordX++)
+			{
+				CTerrain* pTerrain = CTerrain::New();
+				pTerrain->Clear();
+				pTerrain->SetTerrainMapOwner(&m_TerrainMap);
+				pTerrain->SetTerrainCoords(iTerrainCoordX, iTerrainCoordZ);
+
+				TTerrainLoadRequest request{};
+				request.pTerrain = pTerrain;
+				request.stMapDirectory = m_stMapName;
+				request.iTerrainCoordX = iTerrainCoordX;
+				request.iTerrainCoordZ = iTerrainCoordZ;
+				request.iTerrainNum = iTerrainCoordZ * m_iTerrainCountX + iTerrainCoordX;
+
+				const Clock::time_point start = Clock::now();
+				CTerrainLoader::LoadTerrainData(request);
+				result.vSamplesMs.push_back(GetElapsedMs(start));
+
+				CTerrain::Delete(pTerrain);
+			}
+		}
+	}
+
+	m_vResults.push_back(result);
+}
+
+// Vertex, normal and water generation of the 64 patches of a terrain
+void CTerrainBenchmark::BenchmarkPatchGeneration()
+{
+	TBenchmarkResult result;
+	result.stName = "patch_generation";
+	result.stDescription = "CTerrain::CalculateTerrainPatches, every patch of one terrain";
+	result.iItemsPerSample = PATCH_XCOUNT * PATCH_ZCOUNT;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		for (GLint iTerrainNum = 0; iTerrainNum < m_iTerrainCountX * m_iTerrainCountZ; iTerrainNum++)
+		{
+			CTerrain* pTerrain = nullptr;
+			if (!m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain))
+			{
+				continue;
+			}
+
+			for (GLint iPatchNumZ = 0; iPatchNumZ < PATCH_ZCOUNT; iPatchNumZ++)
+			{
+				for (GLint iPatchNumX = 0; iPatchNumX < PATCH_XCOUNT; iPatchNumX++)
+				{
+					pTerrain->GetTerrainPatchPtr(iPatchNumX, iPatchNumZ)->SetUpdateNeed(true);
+				}
+			}
+
+			const Clock::time_point start = Clock::now();
+			pTerrain->CalculateTerrainPatches(false);
+			result.vSamplesMs.push_back(GetElapsedMs(start));
+		}
+	}
+
+	m_vResults.push_back(result);
+}
+
+// CTerrainMap::GetHeight then CTerrainMap::GetHeights over the same uniformly distributed points of the whole map
+void CTerrainBenchmark::BenchmarkHeightQueries()
+{
+	TBenchmarkResult result;
+	result.stName = "get_height";
+	result.stDescription = "CTerrainMap::GetHeight, random points over the map";
+	result.iItemsPerSample = BENCHMARK_HEIGHT_QUERIES;
+
+	TBenchmarkResult batchResult;
+	batchResult.stName = "get_heights";
+	batchResult.stDescription = "CTerrainMap::GetHeights, the same points in one call";
+	batchResult.iItemsPerSample = BENCHMARK_HEIGHT_QUERIES;
+
+	std::uniform_real_distribution<GLfloat> distX(0.0f, static_cast<GLfloat>(m_iTerrainCountX * TERRAIN_XSIZE));
+	std::uniform_real_distribution<GLfloat> distZ(0.0f, static_cast<GLfloat>(m_iTerrainCountZ * TERRAIN_ZSIZE));
+
+	std::vector<GLfloat> vXs(BENCHMARK_HEIGHT_QUERIES);
+	std::vector<GLfloat> vZs(BENCHMARK_HEIGHT_QUERIES);
+	for (GLint i = 0; i < BENCHMARK_HEIGHT_QUERIES; i++)
+	{
+		vXs[i] = distX(m_Random);
+		vZs[i] = distZ(m_Random);
+	}
+
+	std::vector<GLfloat> vHeights(BENCHMARK_HEIGHT_QUERIES);
+
+	// Summed so the queries cannot be optimized away
+	volatile GLfloat fSink = 0.0f;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		GLfloat fSum = 0.0f;
+
+		Clock::time_point start = Clock::now();
+		for (GLint i = 0; i < BENCHMARK_HEIGHT_QUERIES; i++)
+		{
+			fSum += m_TerrainMap.GetHeight(vXs[i], vZs[i]);
+		}
+		result.vSamplesMs.push_back(GetElapsedMs(start));
+
+		start = Clock::now();
+		m_TerrainMap.GetHeights(vXs.data(), vZs.data(), vHeights.data(), vHeights.size());
+		batchResult.vSamplesMs.push_back(GetElapsedMs(start));
+
+		fSink = fSink + fSum + vHeights[iRun % BENCHMARK_HEIGHT_QUERIES];
+	}
+
+	m_vResults.push_back(result);
+	m_vResults.push_back(batchResult);
+}
+
+// Raise then lower the same spot, the map ends up where it started (up to rounding)
+void CTerrainBenchmark::BenchmarkHeightBrush()
+{
+	TBenchmarkResult result;
+	result.stName = "height_brush";
+	result.stDescription = "CTerrainMap::DrawHeightBrush, one up or down stroke";
+	result.iItemsPerSample = 1;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		for (GLint iStroke = 0; iStroke < BENCHMARK_BRUSH_STROKES; iStroke++)
+		{
+			GLint iTerrainX, iTerrainZ, iCellX, iCellZ;
+			GetRandomBrushCell(&iTerrainX, &iTerrainZ, &iCellX, &iCellZ);
+
+			Clock::time_point start = Clock::now();
+			m_TerrainMap.DrawHeightBrush(BRUSH_SHAPE_CIRCLE, BRUSH_TYPE_UP, iTerrainX, iTerrainZ, iCellX, iCellZ, BENCHMARK_BRUSH_SIZE, BENCHMARK_BRUSH_STRENGTH);
+			result.vSamplesMs.push_back(GetElapsedMs(start));
+
+			start = Clock::now();
+			m_TerrainMap.DrawHeightBrush(BRUSH_SHAPE_CIRCLE, BRUSH_TYPE_DOWN, iTerrainX, iTerrainZ, iCellX, iCellZ, BENCHMARK_BRUSH_SIZE, BENCHMARK_BRUSH_STRENGTH);
+			result.vSamplesMs.push_back(GetElapsedMs(start));
+		}
+	}
+
+	m_vResults.push_back(result);
+}
+
+void CTerrainBenchmark::BenchmarkTextureBrush()
+{
+	TBenchmarkResult result;
+	result.stName = "texture_brush";
+	result.stDescription = "CTerrainMap::DrawTextureBrush, one stroke";
+	result.iItemsPerSample = 1;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		for (GLint iStroke = 0; iStroke < BENCHMARK_BRUSH_STROKES; iStroke++)
+		{
+			GLint iTerrainX, iTerrainZ, iCellX, iCellZ;
+			GetRandomBrushCell(&iTerrainX, &iTerrainZ, &iCellX, &iCellZ);
+
+			const GLint iTextureIndex = iStroke % 4;
+
+			const Clock::time_point start = Clock::now();
+			m_TerrainMap.DrawTextureBrush(BRUSH_SHAPE_CIRCLE, iTerrainX, iTerrainZ, iCellX, iCellZ, 0, 0, BENCHMARK_BRUSH_SIZE, BENCHMARK_BRUSH_STRENGTH, iTextureIndex);
+			result.vSamplesMs.push_back(GetElapsedMs(start));
+		}
+	}
+
+	m_vResults.push_back(result);
+}
+
+/*
+ * BenchmarkInstanceUpdate - Per frame instance refresh of a static area.
+ *
+ * Times CTerrainAreaData::UpdateInstanceMatrices over an area of objects
+ * that never move. The first frame fills every slot, the following ones
+ * must find nothing to upload. Moving one object afterwards must upload
+ * exactly that object.
+ */
+void CTerrainBenchmark::BenchmarkInstanceUpdate()
+{
+	// AddObjectInstanceGroup registers the objects with the physics world
+	CPhysicsWorld physicsWorld;
+	CTerrainAreaData areaData;
+
+	std::uniform_real_distribution<GLfloat> distPosition(0.0f, static_cast<GLfloat>(TERRAIN_XSIZE));
+	std::uniform_real_distribution<GLfloat> distAngle(-180.0f, 180.0f);
+
+	for (GLint i = 0; i < BENCHMARK_AREA_OBJECTS; i++)
+	{
+		TObjectData objectData;
+		objectData.eObjectType = OBJECT_TYPE_STATIC;
+		objectData.WorldTranslation.SetPosition(distPosition(m_Random), 0.0f, distPosition(m_Random));
+		objectData.WorldTranslation.SetRotation(0.0f, distAngle(m_Random), 0.0f);
+
+		// No mesh or shader, nothing is drawn, the instance data is still kept
+		areaData.AddObjectInstanceGroup(nullptr, nullptr, objectData);
+	}
+
+	TBenchmarkResult result;
+	result.stName = "instance_update";
+	result.stDescription = "CTerrainAreaData::UpdateInstanceMatrices, one frame of a static area";
+	result.iItemsPerSample = BENCHMARK_AREA_OBJECTS;
+
+	m_uiFirstFrameUploads = areaData.UpdateInstanceMatrices(1.0f);
+	m_uiStaticFrameUploads = 0;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		const Clock::time_point start = Clock::now();
+		m_uiStaticFrameUploads += areaData.UpdateInstanceMatrices(1.0f);
+		result.vSamplesMs.push_back(GetElapsedMs(start));
+	}
+
+	SObjectData* pObjectData = areaData.GetObjectsGroups().front().vecObjects.back();
+	pObjectData->WorldTranslation.SetPosition(pObjectData->WorldTranslation.GetPosition() + SVector3Df(1.0f, 0.0f, 0.0f));
+	m_uiMovedObjectUploads = areaData.UpdateInstanceMatrices(1.0f);
+
+	m_vResults.push_back(result);
+}
+
+/*
+ * CheckDirtyRects - Brush edits report the cells they changed.
+ *
+ * A height, texture, attribute and water brush is drawn at the corners,
+ * at the middle of the edges and at the center of the first terrain. The
+ * grids are compared with a copy taken before the stroke: every dirty rect
+ * must hold the changed texels and stay inside the grid and the brush
+ * square. The height and the square brushes write every cell they cover,
+ * their rect must be exact. The grids are restored afterwards.
+ */
+bool CTerrainBenchmark::CheckDirtyRects()
+{
+	CTerrain* pTerrain = nullptr;
+	if (!m_TerrainMap.GetTerrainPtr(0, &pTerrain))
+	{
+		sys_err("CTerrainBenchmark::CheckDirtyRects: No terrain loaded");
+		return (false);
+	}
+
+	CGrid<GLfloat>& rHeightMap = pTerrain->GetHeightMap();
+	TTerrainSplatData& rSplatData = pTerrain->GetSplatData();
+	TTerrainAttrData& rAttrData = pTerrain->GetAttrData();
+	TTerrainWaterData& rWaterData = pTerrain->GetWaterData();
+
+	if (!rHeightMap.IsInitialized() || !rSplatData.weightGrid.IsInitialized() || !rSplatData.indexGrid.IsInitialized() ||
+		!rAttrData.m_ubAttrMap.IsInitialized() || !rWaterData.m_ubWaterMap.IsInitialized())
+	{
+		sys_err("CTerrainBenchmark::CheckDirtyRects: Terrain grids are not initialized");
+		return (false);
+	}
+
+	const std::vector<GLubyte> vOrigHeights = GetGridBytes(rHeightMap.GetBaseAddr(), rHeightMap.GetSizeByBytes());
+	const std::vector<GLubyte> vOrigWeights = GetGridBytes(rSplatData.weightGrid.GetBaseAddr(), rSplatData.weightGrid.GetSizeByBytes());
+	const std::vector<GLubyte> vOrigIndices = GetGridBytes(rSplatData.indexGrid.GetBaseAddr(), rSplatData.indexGrid.GetSizeByBytes());
+	const std::vector<GLubyte> vOrigAttrs = GetGridBytes(rAttrData.m_ubAttrMap.GetBaseAddr(), rAttrData.m_ubAttrMap.GetSizeByBytes());
+	const std::vector<GLubyte> vOrigWater = GetGridBytes(rWaterData.m_ubWaterMap.GetBaseAddr(), rWaterData.m_ubWaterMap.GetSizeByBytes());
+	const GLubyte ubOrigNumWater = rWaterData.m_ubNumWater;
+	GLfloat afOrigWaterHeights[MAX_WATER_NUM + 1];
+	std::memcpy(afOrigWaterHeights, rWaterData.m_fWaterHeight, sizeof(afOrigWaterHeights));
+
+	const GLint iBrushSize = BENCHMARK_BRUSH_SIZE;
+	const GLint aiCells[] = { 0, XSIZE / 2, XSIZE };
+
+	bool bValid = true;
+
+	for (GLint iCellZ : aiCells)
+	{
+		for (GLint iCellX : aiCells)
+		{
+			// Height, cells [center - size, center + size - 1] and inside the raw heightmap
+			std::vector<GLubyte> vBefore = GetGridBytes(rHeightMap.GetBaseAddr(), rHeightMap.GetSizeByBytes());
+			pTerrain->ClearDirtyRects();
+			pTerrain->DrawHeightBrush(BRUSH_SHAPE_CIRCLE, BRUSH_TYPE_UP, iCellX, iCellZ, iBrushSize, BENCHMARK_BRUSH_STRENGTH);
+
+			TDirtyRect brushRect(iCellX - iBrushSize, iCellZ - iBrushSize, iCellX + iBrushSize - 1, iCellZ + iBrushSize - 1);
+			brushRect.Clip(HEIGHTMAP_RAW_XSIZE, HEIGHTMAP_RAW_ZSIZE);
+
+			// Copied, the next strokes clear the rects
+			const TDirtyRect heightRect = pTerrain->GetHeightDirtyRect();
+			const TDirtyRect heightChanged = GetChangedRect(vBefore, rHeightMap.GetBaseAddr(), HEIGHTMAP_RAW_XSIZE, HEIGHTMAP_RAW_ZSIZE, sizeof(GLfloat));
+			bValid = bValid && !heightRect.IsEmpty() && brushRect.Contains(heightRect) && heightRect == heightChanged;
+
+			// Texture, the weights and indices share one rect
+			const GLint iTileRadius = iBrushSize * HEIGHT_TILE_XRATIO;
+			brushRect = TDirtyRect(iCellX * HEIGHT_TILE_XRATIO - iTileRadius, iCellZ * HEIGHT_TILE_ZRATIO - iTileRadius, iCellX * HEIGHT_TILE_XRATIO + iTileRadius, iCellZ * HEIGHT_TILE_ZRATIO + iTileRadius);
+			brushRect.Clip(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE);
+
+			vBefore = GetGridBytes(rSplatData.weightGrid.GetBaseAddr(), rSplatData.weightGrid.GetSizeByBytes());
+			std::vector<GLubyte> vIndicesBefore = GetGridBytes(rSplatData.indexGrid.GetBaseAddr(), rSplatData.indexGrid.GetSizeByBytes());
+			pTerrain->ClearDirtyRects();
+			pTerrain->DrawTextureBrush(BRUSH_SHAPE_CIRCLE, iCellX, iCellZ, 0, 0, iBrushSize, BENCHMARK_BRUSH_STRENGTH, 1);
+
+			const TDirtyRect& rSplatRect = pTerrain->GetSplatDirtyRect();
+			TDirtyRect splatChanged = GetChangedRect(vBefore, rSplatData.weightGrid.GetBaseAddr(), TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, sizeof(SVector4Df));
+			splatChanged.Add(GetChangedRect(vIndicesBefore, rSplatData.indexGrid.GetBaseAddr(), TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, sizeof(SVector4Di)));
+			bValid = bValid && !rSplatRect.IsEmpty() && brushRect.Contains(rSplatRect) && rSplatRect.Contains(splatChanged);
+
+			// Attribute, a square brush writes its whole clipped square
+			brushRect.Clip(ATTRMAP_XSIZE, ATTRMAP_ZSIZE);
+
+			vBefore = GetGridBytes(rAttrData.m_ubAttrMap.GetBaseAddr(), rAttrData.m_ubAttrMap.GetSizeByBytes());
+			pTerrain->ClearDirtyRects();
+			pTerrain->DrawAttributeBrush(BRUSH_SHAPE_SQUARE, TERRAIN_ATTRIBUTE_BLOCK, iCellX, iCellZ, 0, 0, iBrushSize, BENCHMARK_BRUSH_STRENGTH, false);
+
+			const TDirtyRect& rAttrRect = pTerrain->GetAttrDirtyRect();
+			const TDirtyRect attrChanged = GetChangedRect(vBefore, rAttrData.m_ubAttrMap.GetBaseAddr(), ATTRMAP_XSIZE, ATTRMAP_ZSIZE, sizeof(GLubyte));
+			bValid = bValid && rAttrRect == brushRect && rAttrRect.Contains(attrChanged);
+
+			// Water, the attribute texels under the water cells follow
+			const GLint iWaterRadius = iBrushSize * HEIGHT_WATER_XRATIO;
+			brushRect = TDirtyRect(iCellX * HEIGHT_WATER_XRATIO - iWaterRadius, iCellZ * HEIGHT_WATER_ZRATIO - iWaterRadius, iCellX * HEIGHT_WATER_XRATIO + iWaterRadius, iCellZ * HEIGHT_WATER_ZRATIO + iWaterRadius);
+			brushRect.Clip(WATERMAP_XSIZE, WATERMAP_ZSIZE);
+
+			const GLint iAttrToWaterRatio = ATTRMAP_XSIZE / WATERMAP_XSIZE;
+			const TDirtyRect attrUnderWater(brushRect.iMinX * iAttrToWaterRatio, brushRect.iMinZ * iAttrToWaterRatio, brushRect.iMaxX * iAttrToWaterRatio + iAttrToWaterRatio - 1, brushRect.iMaxZ * iAttrToWaterRatio + iAttrToWaterRatio - 1);
+
+			vBefore = GetGridBytes(rWaterData.m_ubWaterMap.GetBaseAddr(), rWaterData.m_ubWaterMap.GetSizeByBytes());
+			pTerrain->ClearDirtyRects();
+			pTerrain->DrawWaterBrush(BRUSH_SHAPE_SQUARE, iCellX, iCellZ, 0, 0, iBrushSize, BENCHMARK_BRUSH_STRENGTH, 1.0f, false);
+
+			const TDirtyRect& rWaterRect = pTerrain->GetWaterDirtyRect();
+			const TDirtyRect waterChanged = GetChangedRect(vBefore, rWaterData.m_ubWaterMap.GetBaseAddr(), WATERMAP_XSIZE, WATERMAP_ZSIZE, sizeof(GLubyte));
+			bValid = bValid && rWaterRect == brushRect && rWaterRect.Contains(waterChanged) && pTerrain->GetAttrDirtyRect() == attrUnderWater;
+
+			if (iCellX != 0 || iCellZ != 0)
+			{
+				continue;
+			}
+
+			// Corner stroke, only the first patch is partly uploaded, one out of its reach is sent whole
+			GLint iFirstRow, iLastRow;
+			const bool bFirstPatch = CTerrain::GetPatchDirtyRows(heightRect, 0, 0, &iFirstRow, &iLastRow);
+			bValid = bValid && bFirstPatch && iFirstRow == 0 && iLastRow == MyMath::imin(heightRect.iMaxZ + 1, PATCH_ZSIZE);
+
+			const bool bLastPatch = CTerrain::GetPatchDirtyRows(heightRect, PATCH_XCOUNT - 1, PATCH_ZCOUNT - 1, &iFirstRow, &iLastRow);
+			bValid = bValid && !bLastPatch && iFirstRow == 0 && iLastRow == PATCH_ZSIZE;
+		}
+	}
+
+	std::memcpy(rHeightMap.GetBaseAddr(), vOrigHeights.data(), vOrigHeights.size());
+	std::memcpy(rSplatData.weightGrid.GetBaseAddr(), vOrigWeights.data(), vOrigWeights.size());
+	std::memcpy(rSplatData.indexGrid.GetBaseAddr(), vOrigIndices.data(), vOrigIndices.size());
+	std::memcpy(rAttrData.m_ubAttrMap.GetBaseAddr(), vOrigAttrs.data(), vOrigAttrs.size());
+	std::memcpy(rWaterData.m_ubWaterMap.GetBaseAddr(), vOrigWater.data(), vOrigWater.size());
+	rWaterData.m_ubNumWater = ubOrigNumWater;
+	std::memcpy(rWaterData.m_fWaterHeight, afOrigWaterHeights, sizeof(afOrigWaterHeights));
+
+	for (GLint iPatchNumZ = 0; iPatchNumZ < PATCH_ZCOUNT; iPatchNumZ++)
+	{
+		for (GLint iPatchNumX = 0; iPatchNumX < PATCH_XCOUNT; iPatchNumX++)
+		{
+			pTerrain->GetTerrainPatchPtr(iPatchNumX, iPatchNumZ)->SetUpdateNeed(true);
+		}
+	}
+
+	pTerrain->CalculateTerrainPatches(false);
+	pTerrain->ClearDirtyRects();
+
+	return (bValid);
+}
+
+/*
+ * CheckUndoRedo - Brush strokes come back bit for bit.
+ *
+ * Random strokes of every brush and brush type are drawn anywhere on the
+ * map, the terrain borders and the map borders included, so the strokes
+ * reach the neighbour terrains. Undoing them all must give back the grids
+ * of every terrain as they were, redoing them all the edited grids, and
+ * undoing them again the original ones. The history is emptied before and
+ * after, the strokes of the timings are not part of it.
+ */
+bool CTerrainBenchmark::CheckUndoRedo()
+{
+	CTerrainHistory& rHistory = m_TerrainMap.GetEditHistory();
+	rHistory.Clear();
+
+	const std::vector<std::vector<GLubyte>> vOriginal = GetBrushGridsBytes();
+
+	const GLbyte abHeightTypes[] = { BRUSH_TYPE_UP, BRUSH_TYPE_DOWN, BRUSH_TYPE_FLATTEN, BRUSH_TYPE_NOISE, BRUSH_TYPE_SMOOTH };
+	const GLint iHeightTypes = static_cast<GLint>(sizeof(abHeightTypes) / sizeof(abHeightTypes[0]));
+
+	std::uniform_int_distribution<GLint> distTerrainX(0, m_iTerrainCountX - 1);
+	std::uniform_int_distribution<GLint> distTerrainZ(0, m_iTerrainCountZ - 1);
+	std::uniform_int_distribution<GLint> distCell(0, XSIZE - 1);
+	std::uniform_int_distribution<GLint> distSubCell(0, HEIGHT_TILE_XRATIO - 1);
+	std::uniform_int_distribution<GLint> distSize(1, BENCHMARK_BRUSH_SIZE);
+	std::uniform_int_distribution<GLint> distBrush(0, iHeightTypes + 2);
+
+	for (GLint iStroke = 0; iStroke < BENCHMARK_UNDO_STROKES; iStroke++)
+	{
+		const GLint iTerrainX = distTerrainX(m_Random);
+		const GLint iTerrainZ = distTerrainZ(m_Random);
+		const GLint iCellX = distCell(m_Random);
+		const GLint iCellZ = distCell(m_Random);
+		const GLint iSubCellX = distSubCell(m_Random);
+		const GLint iSubCellZ = distSubCell(m_Random);
+		const GLint iBrushSize = distSize(m_Random);
+		const GLint iBrush = distBrush(m_Random);
+		const GLbyte bShape = (iStroke % 2 == 0) ? BRUSH_SHAPE_CIRCLE : BRUSH_SHAPE_SQUARE;
+		const bool bErase = (iStroke % 3 == 0);
+
+		if (iBrush < iHeightTypes)
+		{
+			m_TerrainMap.DrawHeightBrush(bShape, abHeightTypes[iBrush], iTerrainX, iTerrainZ, iCellX, iCellZ, iBrushSize, BENCHMARK_BRUSH_STRENGTH);
+		}
+		else if (iBrush == iHeightTypes)
+		{
+			m_TerrainMap.DrawTextureBrush(BRUSH_SHAPE_CIRCLE, iTerrainX, iTerrainZ, iCellX, iCellZ, iSubCellX, iSubCellZ, iBrushSize, BENCHMARK_BRUSH_STRENGTH, iStroke % 4);
+		}
+		else if (iBrush == iHeightTypes + 1)
+		{
+			m_TerrainMap.DrawAttributeBrush(bShape, TERRAIN_ATTRIBUTE_BLOCK, iTerrainX, iTerrainZ, iCellX, iCellZ, iSubCellX, iSubCellZ, iBrushSize, BENCHMARK_BRUSH_STRENGTH, bErase);
+		}
+		else
+		{
+			m_TerrainMap.DrawWaterBrush(bShape, iTerrainX, iTerrainZ, iCellX, iCellZ, iSubCellX, iSubCellZ, iBrushSize, BENCHMARK_BRUSH_STRENGTH, static_cast<GLfloat>(iStroke + 1), bErase);
+		}
+	}
+
+	const std::vector<std::vector<GLubyte>> vEdited = GetBrushGridsBytes();
+	const GLint iSteps = rHistory.GetUndoCount();
+
+	const auto fnUndoAll = [&]()
+	{
+		while (rHistory.CanUndo())
+		{
+			if (!m_TerrainMap.UndoEdit())
+			{
+				return (false);
+			}
+		}
+
+		return (true);
+	};
+
+	bool bValid = iSteps > 0 && vEdited != vOriginal;
+
+	bValid = bValid && fnUndoAll() && GetBrushGridsBytes() == vOriginal && rHistory.GetRedoCount() == iSteps;
+
+	while (bValid && rHistory.CanRedo())
+	{
+		bValid = m_TerrainMap.RedoEdit();
+	}
+	bValid = bValid && GetBrushGridsBytes() == vEdited && rHistory.GetUndoCount() == iSteps;
+
+	bValid = bValid && fnUndoAll() && GetBrushGridsBytes() == vOriginal;
+	bValid = bValid && rHistory.GetUsedBytes() <= rHistory.GetMaxBytes();
+
+	rHistory.Clear();
+	return (bValid);
+}
+
+TDirtyRect CTerrainBenchmark::GetChangedRect(const std::vector<GLubyte>& vBefore, const void* pAfter, GLint iWidth, GLint iDepth, GLint iTexelSize)
+{
+	const GLubyte* pAfterBytes = static_cast<const GLubyte*>(pAfter);
+	TDirtyRect rect;
+
+	for (GLint iZ = 0; iZ < iDepth; iZ++)
+	{
+		for (GLint iX = 0; iX < iWidth; iX++)
+		{
+			const size_t offset = (static_cast<size_t>(iZ) * iWidth + iX) * iTexelSize;
+			if (std::memcmp(vBefore.data() + offset, pAfterBytes + offset, iTexelSize) != 0)
+			{
+				rect.Add(iX, iZ);
+			}
+		}
+	}
+
+	return (rect);
+}
+
+std::vector<GLubyte> CTerrainBenchmark::GetGridBytes(const void* pGridBase, GLint iSizeInBytes)
+{
+	const GLubyte* pBytes = static_cast<const GLubyte*>(pGridBase);
+	return (std::vector<GLubyte>(pBytes, pBytes + iSizeInBytes));
+}
+
+std::vector<std::vector<GLubyte>> CTerrainBenchmark::GetBrushGridsBytes()
+{
+	std::vector<std::vector<GLubyte>> vTerrainsBytes(static_cast<size_t>(m_iTerrainCountX) * m_iTerrainCountZ);
+
+	for (GLint iTerrainNum = 0; iTerrainNum < static_cast<GLint>(vTerrainsBytes.size()); iTerrainNum++)
+	{
+		CTerrain* pTerrain = nullptr;
+		if (!m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain))
+		{
+			continue;
+		}
+
+		CGrid<GLfloat>& rHeightMap = pTerrain->GetHeightMap();
+		TTerrainSplatData& rSplatData = pTerrain->GetSplatData();
+		TTerrainAttrData& rAttrData = pTerrain->GetAttrData();
+		TTerrainWaterData& rWaterData = pTerrain->GetWaterData();
+
+		std::vector<GLubyte>& rBytes = vTerrainsBytes[iTerrainNum];
+		const auto fnAppend = [&rBytes](const void* pData, size_t lSize)
+		{
+			const GLubyte* pBytes = static_cast<const GLubyte*>(pData);
+			rBytes.insert(rBytes.end(), pBytes, pBytes + lSize);
+		};
+
+		fnAppend(rHeightMap.GetBaseAddr(), rHeightMap.GetSizeByBytes());
+		fnAppend(rSplatData.weightGrid.GetBaseAddr(), rSplatData.weightGrid.GetSizeByBytes());
+		fnAppend(rSplatData.indexGrid.GetBaseAddr(), rSplatData.indexGrid.GetSizeByBytes());
+		fnAppend(rAttrData.m_ubAttrMap.GetBaseAddr(), rAttrData.m_ubAttrMap.GetSizeByBytes());
+		fnAppend(rWaterData.m_ubWaterMap.GetBaseAddr(), rWaterData.m_ubWaterMap.GetSizeByBytes());
+		fnAppend(&rWaterData.m_ubNumWater, sizeof(rWaterData.m_ubNumWater));
+		fnAppend(rWaterData.m_fWaterHeight, sizeof(rWaterData.m_fWaterHeight));
+	}
+
+	return (vTerrainsBytes);
+}
+
+void CTerrainBenchmark::GetRandomBrushCell(GLint* piTerrainX, GLint* piTerrainZ, GLint* piCellX, GLint* piCellZ)
+{
+	std::uniform_int_distribution<GLint> distTerrainX(0, m_iTerrainCountX - 1);
+	std::uniform_int_distribution<GLint> distTerrainZ(0, m_iTerrainCountZ - 1);
+	std::uniform_int_distribution<GLint> distCell(BENCHMARK_BRUSH_SIZE, XSIZE - 1 - BENCHMARK_BRUSH_SIZE);
+
+	*piTerrainX = distTerrainX(m_Random);
+	*piTerrainZ = distTerrainZ(m_Random);
+	*piCellX = distCell(m_Random);
+	*piCellZ = distCell(m_Random);
+}
+
+/*
+ * CheckHeightBatch - CTerrainMap::GetHeights against CTerrainMap::GetHeight.
+ *
+ * BENCHMARK_HEIGHT_QUERIES random points, a terrain beyond every side of
+ * the map included so the points without terrain are covered too. Every
+ * height must be bit for bit the GetHeight one. A normal is checked by
+ * rebuilding the point height from the height of its cell corner and the
+ * slopes the normal gives, off the map it must point straight up.
+ */
+bool CTerrainBenchmark::CheckHeightBatch()
+{
+	std::uniform_real_distribution<GLfloat> distX(-static_cast<GLfloat>(TERRAIN_XSIZE), static_cast<GLfloat>((m_iTerrainCountX + 1) * TERRAIN_XSIZE));
+	std::uniform_real_distribution<GLfloat> distZ(-static_cast<GLfloat>(TERRAIN_ZSIZE), static_cast<GLfloat>((m_iTerrainCountZ + 1) * TERRAIN_ZSIZE));
+
+	std::vector<GLfloat> vXs(BENCHMARK_HEIGHT_QUERIES);
+	std::vector<GLfloat> vZs(BENCHMARK_HEIGHT_QUERIES);
+	for (GLint i = 0; i < BENCHMARK_HEIGHT_QUERIES; i++)
+	{
+		vXs[i] = distX(m_Random);
+		vZs[i] = distZ(m_Random);
+	}
+
+	std::vector<GLfloat> vHeights(BENCHMARK_HEIGHT_QUERIES);
+	std::vector<SVector3Df> vNormals(BENCHMARK_HEIGHT_QUERIES);
+	m_TerrainMap.GetHeights(vXs.data(), vZs.data(), vHeights.data(), vNormals.data(), vHeights.size());
+
+	const GLfloat fMapSizeX = static_cast<GLfloat>(m_iTerrainCountX * TERRAIN_XSIZE);
+	const GLfloat fMapSizeZ = static_cast<GLfloat>(m_iTerrainCountZ * TERRAIN_ZSIZE);
+
+	for (GLint i = 0; i < BENCHMARK_HEIGHT_QUERIES; i++)
+	{
+		const GLfloat fExpected = m_TerrainMap.GetHeight(vXs[i], vZs[i]);
+		if (std::memcmp(&fExpected, &vHeights[i], sizeof(GLfloat)) != 0)
+		{
+			sys_err("CTerrainBenchmark::CheckHeightBatch: Height %f at (%f, %f) instead of %f", vHeights[i], vXs[i], vZs[i], fExpected);
+			return (false);
+		}
+
+		const SVector3Df& v3Normal = vNormals[i];
+		const bool bOnMap = vXs[i] >= 0.0f && vZs[i] >= 0.0f && vXs[i] < fMapSizeX && vZs[i] < fMapSizeZ;
+
+		if (!bOnMap)
+		{
+			if (v3Normal.x != 0.0f || v3Normal.y != 1.0f || v3Normal.z != 0.0f)
+			{
+				sys_err("CTerrainBenchmark::CheckHeightBatch: Normal off the map at (%f, %f) is not straight up", vXs[i], vZs[i]);
+				return (false);
+			}
+			continue;
+		}
+
+		// GetHeight works on whole meters, the cell corner height is its top left sample
+		const GLint iX = static_cast<GLint>(vXs[i]);
+		const GLint iZ = static_cast<GLint>(vZs[i]);
+		const GLint iLocalX = iX % CELL_SCALE_METER;
+		const GLint iLocalZ = iZ % CELL_SCALE_METER;
+		const GLfloat fCornerY = m_TerrainMap.GetHeight(static_cast<GLfloat>(iX - iLocalX), static_cast<GLfloat>(iZ - iLocalZ));
+
+		const GLfloat fRebuilt = fCornerY - (static_cast<GLfloat>(iLocalX) * v3Normal.x + static_cast<GLfloat>(iLocalZ) * v3Normal.z) / v3Normal.y;
+		if (v3Normal.y <= 0.0f || std::abs(fRebuilt - fExpected) > BENCHMARK_HEIGHT_NORMAL_TOLERANCE * std::max(1.0f, std::abs(fExpected)))
+		{
+			sys_err("CTerrainBenchmark::CheckHeightBatch: Normal (%f, %f, %f) at (%f, %f) gives height %f instead of %f",
+				v3Normal.x, v3Normal.y, v3Normal.z, vXs[i], vZs[i], fRebuilt, fExpected);
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * CheckPicking - Two-level DDA picking against testing every triangle.
+ *
+ * Random up and noise strokes give the map relief first, the patches are
+ * rebuilt so their boxes hold the new heights. Every ray must hit or miss
+ * like the brute force scan of both triangles of every cell, a hit at the
+ * same point within BENCHMARK_PICKING_TOLERANCE meters, and a ray straight
+ * down over the map cannot miss it.
+ * GetPickingCoordinateWithRay must agree with IntersectRayWithTerrains.
+ */
+bool CTerrainBenchmark::CheckPicking()
+{
+	for (GLint iStroke = 0; iStroke < BENCHMARK_PICKING_RELIEF_STROKES; iStroke++)
+	{
+		GLint iTerrainX, iTerrainZ, iCellX, iCellZ;
+		GetRandomBrushCell(&iTerrainX, &iTerrainZ, &iCellX, &iCellZ);
+
+		const GLbyte bBrushType = (iStroke % 2 == 0) ? BRUSH_TYPE_UP : BRUSH_TYPE_NOISE;
+		m_TerrainMap.DrawHeightBrush(BRUSH_SHAPE_CIRCLE, bBrushType, iTerrainX, iTerrainZ, iCellX, iCellZ, BENCHMARK_BRUSH_SIZE, BENCHMARK_BRUSH_STRENGTH);
+	}
+
+	for (GLint iTerrainNum = 0; iTerrainNum < m_iTerrainCountX * m_iTerrainCountZ; iTerrainNum++)
+	{
+		CTerrain* pTerrain = nullptr;
+		if (m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain))
+		{
+			pTerrain->CalculateTerrainPatches(false);
+		}
+	}
+
+	std::vector<CRay> vRays;
+	CreatePickingRays(BENCHMARK_PICKING_CHECK_RAYS, vRays);
+
+	const GLfloat fMapSizeX = static_cast<GLfloat>(m_iTerrainCountX * TERRAIN_XSIZE);
+	const GLfloat fMapSizeZ = static_cast<GLfloat>(m_iTerrainCountZ * TERRAIN_ZSIZE);
+
+	for (const CRay& rRay : vRays)
+	{
+		const SVector3Df& v3Start = rRay.GetStartPoint();
+		const SVector3Df& v3End = rRay.GetEndPoint();
+
+		GLfloat fHitT = 0.0f, fExpectedT = 0.0f;
+		const bool bHit = m_TerrainMap.IntersectRayWithTerrains(v3Start, v3End, &fHitT);
+		const bool bExpected = IntersectRayBruteForce(v3Start, v3End, &fExpectedT);
+
+		if (bHit != bExpected)
+		{
+			sys_err("CTerrainBenchmark::CheckPicking: Ray from (%f, %f, %f) to (%f, %f, %f) %s the terrain, testing every triangle it %s",
+				v3Start.x, v3Start.y, v3Start.z, v3End.x, v3End.y, v3End.z, bHit ? "hits" : "misses", bExpected ? "hits" : "misses");
+			return (false);
+		}
+
+		if (bHit && std::abs(fHitT - fExpectedT) * BENCHMARK_PICKING_RANGE > BENCHMARK_PICKING_TOLERANCE)
+		{
+			sys_err("CTerrainBenchmark::CheckPicking: Ray from (%f, %f, %f) hits %f meters away instead of %f",
+				v3Start.x, v3Start.y, v3Start.z, fHitT * BENCHMARK_PICKING_RANGE, fExpectedT * BENCHMARK_PICKING_RANGE);
+			return (false);
+		}
+
+		SVector3Df v3Picked;
+		GLint iCellX, iCellZ, iSubCellX, iSubCellZ, iTerrainNumX, iTerrainNumZ;
+		if (m_TerrainMap.GetPickingCoordinateWithRay(rRay, &v3Picked, &iCellX, &iCellZ, &iSubCellX, &iSubCellZ, &iTerrainNumX, &iTerrainNumZ) != bHit)
+		{
+			sys_err("CTerrainBenchmark::CheckPicking: GetPickingCoordinateWithRay disagrees with IntersectRayWithTerrains");
+			return (false);
+		}
+
+		// Both could agree on missing everything, the terrain lies under the whole map
+		const bool bStraightDown = v3Start.x == v3End.x && v3Start.z == v3End.z;
+		if (bStraightDown && !bHit && v3Start.x >= 0.0f && v3Start.x < fMapSizeX && v3Start.z >= 0.0f && v3Start.z < fMapSizeZ)
+		{
+			sys_err("CTerrainBenchmark::CheckPicking: Ray straight down from (%f, %f, %f) misses the terrain", v3Start.x, v3Start.y, v3Start.z);
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+void CTerrainBenchmark::BenchmarkPicking()
+{
+	TBenchmarkResult result;
+	result.stName = "picking";
+	result.stDescription = "CTerrainMap::GetPickingCoordinateWithRay, random rays over the map";
+	result.iItemsPerSample = BENCHMARK_PICKING_RAYS;
+
+	std::vector<CRay> vRays;
+	CreatePickingRays(BENCHMARK_PICKING_RAYS, vRays);
+
+	// Counted so the picks cannot be optimized away
+	volatile GLint iSink = 0;
+
+	for (GLint iRun = 0; iRun < m_iRuns; iRun++)
+	{
+		GLint iHits = 0;
+
+		const Clock::time_point start = Clock::now();
+		for (const CRay& rRay : vRays)
+		{
+			SVector3Df v3Picked;
+			GLint iCellX, iCellZ, iSubCellX, iSubCellZ, iTerrainNumX, iTerrainNumZ;
+			if (m_TerrainMap.GetPickingCoordinateWithRay(rRay, &v3Picked, &iCellX, &iCellZ, &iSubCellX, &iSubCellZ, &iTerrainNumX, &iTerrainNumZ))
+			{
+				iHits++;
+			}
+		}
+		result.vSamplesMs.push_back(GetElapsedMs(start));
+
+		iSink = iSink + iHits;
+	}
+
+	m_vResults.push_back(result);
+}
+
+void CTerrainBenchmark::CreatePickingRays(GLint iRays, std::vector<CRay>& vRays)
+{
+	const GLfloat fMapSizeX = static_cast<GLfloat>(m_iTerrainCountX * TERRAIN_XSIZE);
+	const GLfloat fMapSizeZ = static_cast<GLfloat>(m_iTerrainCountZ * TERRAIN_ZSIZE);
+
+	GLfloat fMaxHeight = 0.0f;
+	for (GLint iTerrainNum = 0; iTerrainNum < m_iTerrainCountX * m_iTerrainCountZ; iTerrainNum++)
+	{
+		CTerrain* pTerrain = nullptr;
+		if (!m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain))
+		{
+			continue;
+		}
+
+		for (GLint iZ = 0; iZ <= ZSIZE; iZ++)
+		{
+			for (GLint iX = 0; iX <= XSIZE; iX++)
+			{
+				fMaxHeight = std::max(fMaxHeight, pTerrain->GetHeightMapValue(iX, iZ));
+			}
+		}
+	}
+
+	std::uniform_real_distribution<GLfloat> distX(-0.1f * fMapSizeX, 1.1f * fMapSizeX);
+	std::uniform_real_distribution<GLfloat> distZ(-0.1f * fMapSizeZ, 1.1f * fMapSizeZ);
+	std::uniform_real_distribution<GLfloat> distHeight(fMaxHeight + 5.0f, fMaxHeight + 300.0f);
+	std::uniform_real_distribution<GLfloat> distDir(-1.0f, 1.0f);
+	std::uniform_real_distribution<GLfloat> distSteep(-1.0f, -0.2f);
+	std::uniform_real_distribution<GLfloat> distShallow(-0.2f, -0.02f);
+
+	vRays.clear();
+	vRays.reserve(iRays);
+
+	for (GLint i = 0; i < iRays; i++)
+	{
+		SVector3Df v3Start(distX(m_Random), distHeight(m_Random), distZ(m_Random));
+		SVector3Df v3Dir(distDir(m_Random), 0.0f, distDir(m_Random));
+
+		switch (i % 4)
+		{
+		case 0:
+			v3Dir.y = distSteep(m_Random);
+			break;
+
+		case 1:
+			v3Dir.y = distShallow(m_Random);
+			break;
+
+		case 2:
+			// Straight down, the DDA never leaves its first cell
+			v3Dir = SVector3Df(0.0f, -1.0f, 0.0f);
+			break;
+
+		default:
+			// From beside the map towards its center
+			v3Start.x = (i % 8 == 3) ? -0.2f * fMapSizeX : 1.2f * fMapSizeX;
+			v3Dir = SVector3Df(0.5f * fMapSizeX - v3Start.x, 0.0f, 0.5f * fMapSizeZ - v3Start.z);
+			v3Dir.normalize();
+			v3Dir.y = distShallow(m_Random);
+			break;
+		}
+
+		vRays.emplace_back(v3Start, v3Dir, BENCHMARK_PICKING_RANGE);
+	}
+}
+
+bool CTerrainBenchmark::IntersectRayBruteForce(const SVector3Df& v3Start, const SVector3Df& v3End, GLfloat* pfHitT)
+{
+	const SVector3Df v3Dir = v3End - v3Start;
+	const GLfloat fCellSize = static_cast<GLfloat>(CELL_SCALE_METER);
+
+	GLfloat fBestT = FLT_MAX;
+
+	for (GLint iTerrainNum = 0; iTerrainNum < m_iTerrainCountX * m_iTerrainCountZ; iTerrainNum++)
+	{
+		CTerrain* pTerrain = nullptr;
+		if (!m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain) || !pTerrain->IsReady())
+		{
+			continue;
+		}
+
+		GLint iTerrainCoordX, iTerrainCoordZ;
+		pTerrain->GetTerrainCoords(&iTerrainCoordX, &iTerrainCoordZ);
+
+		for (GLint iZ = 0; iZ < ZSIZE; iZ++)
+		{
+			for (GLint iX = 0; iX < XSIZE; iX++)
+			{
+				const GLfloat fX0 = static_cast<GLfloat>(iTerrainCoordX * XSIZE + iX) * fCellSize;
+				const GLfloat fZ0 = static_cast<GLfloat>(iTerrainCoordZ * ZSIZE + iZ) * fCellSize;
+
+				const SVector3Df v3TopLeft(fX0, pTerrain->GetHeightMapValue(iX, iZ), fZ0);
+				const SVector3Df v3TopRight(fX0 + fCellSize, pTerrain->GetHeightMapValue(iX + 1, iZ), fZ0);
+				const SVector3Df v3BottomLeft(fX0, pTerrain->GetHeightMapValue(iX, iZ + 1), fZ0 + fCellSize);
+				const SVector3Df v3BottomRight(fX0 + fCellSize, pTerrain->GetHeightMapValue(iX + 1, iZ + 1), fZ0 + fCellSize);
+
+				GLfloat fT = 0.0f;
+				if (CTerrainMap::IntersectRayWithTriangle(v3Start, v3Dir, v3TopLeft, v3BottomLeft, v3TopRight, &fT) && fT >= 0.0f && fT <= 1.0f)
+				{
+					fBestT = std::min(fBestT, fT);
+				}
+
+				if (CTerrainMap::IntersectRayWithTriangle(v3Start, v3Dir, v3TopRight, v3BottomLeft, v3BottomRight, &fT) && fT >= 0.0f && fT <= 1.0f)
+				{
+					fBestT = std::min(fBestT, fT);
+				}
+			}
+		}
+	}
+
+	if (fBestT == FLT_MAX)
+	{
+		return (false);
+	}
+
+	*pfHitT = fBestT;
+	return (true);
+}
+
+/*
+ * CheckChunkRoundTrip - CTerrain::SaveChunk then CTerrain::LoadChunk.
+ *
+ * The first terrain of the map is loaded again, its maps filled with random
+ * values and saved to a chunk under the temp directory. The terrain loaded
+ * back from it must have the same heights, attributes, splat indices and
+ * water bit for bit, and every splat weight within half a quantization step.
+ * The chunk is then written again with a section claiming more bytes than
+ * the file holds and a section too large to be real, CTerrainChunk::Load
+ * must refuse both.
+ */
+bool CTerrainBenchmark::CheckChunkRoundTrip()
+{
+	const std::filesystem::path chunkMapPath = std::filesystem::temp_directory_path() / "metin3_benchmark_chunk";
+	const std::string stChunkMap = chunkMapPath.string();
+	const std::string stChunkFile = CTerrainChunk::GetFileName(stChunkMap, 0, 0);
+
+	std::error_code errorCode;
+	std::filesystem::remove_all(chunkMapPath, errorCode);
+	std::filesystem::create_directories(std::filesystem::path(stChunkFile).parent_path(), errorCode);
+
+	CTerrain* pSaved = CTerrain::New();
+	pSaved->Clear();
+	pSaved->SetTerrainMapOwner(&m_TerrainMap);
+	pSaved->SetTerrainCoords(0, 0);
+
+	TTerrainLoadRequest request{};
+	request.pTerrain = pSaved;
+	request.stMapDirectory = m_stMapName;
+	request.iTerrainCoordX = 0;
+	request.iTerrainCoordZ = 0;
+	request.iTerrainNum = 0;
+
+	if (!CTerrainLoader::LoadTerrainData(request))
+	{
+		sys_err("CTerrainBenchmark::CheckChunkRoundTrip: Failed to load terrain (0, 0) of %s", m_stMapName.c_str());
+		CTerrain::Delete(pSaved);
+		return (false);
+	}
+
+	std::uniform_real_distribution<GLfloat> distHeight(-50.0f, 500.0f);
+	std::uniform_real_distribution<GLfloat> distWeight(0.0f, 1.0f);
+	std::uniform_int_distribution<GLint> distByte(0, 255);
+
+	CGrid<GLfloat>& rSavedHeights = pSaved->GetHeightMap();
+	for (GLint i = 0; i < rSavedHeights.GetSize(); i++)
+	{
+		rSavedHeights.GetBaseAddr()[i] = distHeight(m_Random);
+	}
+
+	CGrid<GLubyte>& rSavedAttrs = pSaved->GetAttrData().m_ubAttrMap;
+	for (GLint i = 0; i < rSavedAttrs.GetSize(); i++)
+	{
+		rSavedAttrs.GetBaseAddr()[i] = static_cast<GLubyte>(distByte(m_Random));
+	}
+
+	TTerrainSplatData& rSavedSplat = pSaved->GetSplatData();
+	for (GLint i = 0; i < rSavedSplat.weightGrid.GetSize(); i++)
+	{
+		rSavedSplat.weightGrid.GetBaseAddr()[i] = SVector4Df(distWeight(m_Random), distWeight(m_Random), distWeight(m_Random), distWeight(m_Random));
+		rSavedSplat.indexGrid.GetBaseAddr()[i] = SVector4Di(distByte(m_Random), distByte(m_Random), distByte(m_Random), distByte(m_Random));
+	}
+
+	const bool bSaved = pSaved->SaveChunk(stChunkMap);
+
+	CTerrain* pLoaded = CTerrain::New();
+	pLoaded->Clear();
+	pLoaded->SetTerrainCoords(0, 0);
+
+	bool bValid = bSaved && pLoaded->LoadChunk(stChunkFile);
+	if (!bValid)
+	{
+		sys_err("CTerrainBenchmark::CheckChunkRoundTrip: Failed to save or load %s", stChunkFile.c_str());
+	}
+
+	if (bValid && (std::memcmp(rSavedHeights.GetBaseAddr(), pLoaded->GetHeightMap().GetBaseAddr(), rSavedHeights.GetSizeByBytes()) != 0 ||
+		std::memcmp(rSavedAttrs.GetBaseAddr(), pLoaded->GetAttrData().m_ubAttrMap.GetBaseAddr(), rSavedAttrs.GetSizeByBytes()) != 0))
+	{
+		sys_err("CTerrainBenchmark::CheckChunkRoundTrip: Heights or attributes differ after the round trip");
+		bValid = false;
+	}
+
+	// SaveChunk recalculated the water map of the saved terrain, that is the one written
+	const TTerrainWaterData& rSavedWater = pSaved->GetWaterData();
+	const TTerrainWaterData& rLoadedWater = pLoaded->GetWaterData();
+	if (bValid && (rSavedWater.m_ubNumWater != rLoadedWater.m_ubNumWater ||
+		std::memcmp(rSavedWater.m_fWaterHeight, rLoadedWater.m_fWaterHeight, rSavedWater.m_ubNumWater * sizeof(GLfloat)) != 0 ||
+		std::memcmp(rSavedWater.m_ubWaterMap.GetBaseAddr(), rLoadedWater.m_ubWaterMap.GetBaseAddr(), rSavedWater.m_ubWaterMap.GetSizeByBytes()) != 0))
+	{
+		sys_err("CTerrainBenchmark::CheckChunkRoundTrip: Water differs after the round trip");
+		bValid = false;
+	}
+
+	const TTerrainSplatData& rLoadedSplat = pLoaded->GetSplatData();
+	for (GLint i = 0; bValid && i < rSavedSplat.weightGrid.GetSize(); i++)
+	{
+		const SVector4Df& v4Saved = rSavedSplat.weightGrid.GetBaseAddr()[i];
+		const SVector4Df& v4Loaded = rLoadedSplat.weightGrid.GetBaseAddr()[i];
+		const SVector4Di& v4SavedIndex = rSavedSplat.indexGrid.GetBaseAddr()[i];
+		const SVector4Di& v4LoadedIndex = rLoadedSplat.indexGrid.GetBaseAddr()[i];
+
+		const GLfloat fError = std::max(std::max(std::abs(v4Saved.x - v4Loaded.x), std::abs(v4Saved.y - v4Loaded.y)),
+			std::max(std::abs(v4Saved.z - v4Loaded.z), std::abs(v4Saved.w - v4Loaded.w)));
+
+		if (fError > BENCHMARK_CHUNK_WEIGHT_TOLERANCE)
+		{
+			sys_err("CTerrainBenchmark::CheckChunkRoundTrip: Splat weight %d is off by %f after the round trip", i, fError);
+			bValid = false;
+		}
+		else if (v4SavedIndex.x != v4LoadedIndex.x || v4SavedIndex.y != v4LoadedIndex.y || v4SavedIndex.z != v4LoadedIndex.z || v4SavedIndex.w != v4LoadedIndex.w)
+		{
+			sys_err("CTerrainBenchmark::CheckChunkRoundTrip: Splat index %d differs after the round trip", i);
+			bValid = false;
+		}
+	}
+
+	CTerrain::Delete(pLoaded);
+	CTerrain::Delete(pSaved);
+
+	// Corrupted copies of the chunk, the first section claiming too many bytes
+	std::vector<char> vFile;
+	if (bValid)
+	{
+		std::ifstream fileIn(stChunkFile, std::ios::binary);
+		vFile.assign(std::istreambuf_iterator<char>(fileIn), std::istreambuf_iterator<char>());
+	}
+
+	const size_t uiFirstSection = sizeof(TTerrainChunkHeader);
+	if (bValid && vFile.size() < uiFirstSection + sizeof(TTerrainChunkSection))
+	{
+		sys_err("CTerrainBenchmark::CheckChunkRoundTrip: %s is too small to hold a section", stChunkFile.c_str());
+		bValid = false;
+	}
+
+	const GLuint auiStoredSizes[] = { static_cast<GLuint>(vFile.size()), TERRAIN_CHUNK_MAX_SECTION_SIZE };
+	const GLuint auiRawSizes[] = { static_cast<GLuint>(vFile.size()), 0xFFFFFFF0 };
+
+	for (GLint iCase = 0; bValid && iCase < 2; iCase++)
+	{
+		TTerrainChunkSection section;
+		std::memcpy(&section, vFile.data() + uiFirstSection, sizeof(section));
+		section.uiStoredSize = auiStoredSizes[iCase];
+		section.uiRawSize = auiRawSizes[iCase];
+
+		std::vector<char> vCorrupted = vFile;
+		std::memcpy(vCorrupted.data() + uiFirstSection, &section, sizeof(section));
+
+		{
+			std::ofstream fileOut(stChunkFile, std::ios::binary | std::ios::trunc);
+			fileOut.write(vCorrupted.data(), static_cast<std::streamsize>(vCorrupted.size()));
+		}
+
+		CTerrainChunk chunk;
+		if (chunk.Load(stChunkFile))
+		{
+			sys_err("CTerrainBenchmark::CheckChunkRoundTrip: A chunk with section sizes (raw %u, stored %u) was loaded", section.uiRawSize, section.uiStoredSize);
+			bValid = false;
+		}
+	}
+
+	std::filesystem::remove_all(chunkMapPath, errorCode);
+	return (bValid);
+}
+
+/*
+ * CheckDrawCommands - CTerrain::BuildPatchDrawCommands on chosen masks.
+ *
+ * No patch, every patch, the first and last patch, every other patch and a
+ * few random masks. There must be one command per set bit, in patch order,
+ * each drawing the whole shared index buffer once from the first vertex of
+ * its patch. The shared indices must stay inside one patch, so no command
+ * reads the vertices of another.
+ */
+bool CTerrainBenchmark::CheckDrawCommands()
+{
+	std::vector<GLuint> vIndices;
+	CTerrainVAO::BuildPatchIndices(vIndices);
+
+	if (vIndices.size() != PATCH_INDEX_COUNT || *std::max_element(vIndices.begin(), vIndices.end()) >= static_cast<GLuint>(PATCH_VERTEX_COUNT))
+	{
+		sys_err("CTerrainBenchmark::CheckDrawCommands: The shared patch indices do not fit one patch");
+		return (false);
+	}
+
+	std::vector<GLuint64> vMasks = { 0, ~static_cast<GLuint64>(0), (static_cast<GLuint64>(1) << 63) | 1, 0x5555555555555555, 0x0000000100000000 };
+
+	std::uniform_int_distribution<GLuint64> distMask;
+	for (GLint i = 0; i < 8; i++)
+	{
+		// Ands of random masks, down to a few patches
+		GLuint64 ulMask = distMask(m_Random);
+		for (GLint j = 0; j < i % 4; j++)
+		{
+			ulMask &= distMask(m_Random);
+		}
+		vMasks.push_back(ulMask);
+	}
+
+	std::vector<TDrawElementsIndirectCommand> vCommands;
+
+	for (const GLuint64 ulMask : vMasks)
+	{
+		// Left over commands must be dropped
+		vCommands.assign(3, TDrawElementsIndirectCommand{ 1, 2, 3, 4, 5 });
+
+		const GLsizei iDrawCount = CTerrain::BuildPatchDrawCommands(ulMask, vCommands);
+
+		if (iDrawCount != static_cast<GLsizei>(vCommands.size()))
+		{
+			sys_err("CTerrainBenchmark::CheckDrawCommands: Mask 0x%016llX returned %d commands but wrote %zu", ulMask, iDrawCount, vCommands.size());
+			return (false);
+		}
+
+		size_t uiCommand = 0;
+		for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
+		{
+			if ((ulMask & (static_cast<GLuint64>(1) << iPatchNum)) == 0)
+			{
+				continue;
+			}
+
+			if (uiCommand >= vCommands.size())
+			{
+				sys_err("CTerrainBenchmark::CheckDrawCommands: Mask 0x%016llX misses patch %d", ulMask, iPatchNum);
+				return (false);
+			}
+
+			const TDrawElementsIndirectCommand& rCommand = vCommands[uiCommand++];
+			if (rCommand.uiCount != PATCH_INDEX_COUNT || rCommand.uiInstanceCount != 1 || rCommand.uiFirstIndex != 0 ||
+				rCommand.iBaseVertex != iPatchNum * PATCH_VERTEX_COUNT || rCommand.uiBaseInstance != static_cast<GLuint>(iPatchNum))
+			{
+				sys_err("CTerrainBenchmark::CheckDrawCommands: Mask 0x%016llX patch %d has count %u, instances %u, first index %u, base vertex %d, base instance %u",
+					ulMask, iPatchNum, rCommand.uiCount, rCommand.uiInstanceCount, rCommand.uiFirstIndex, rCommand.iBaseVertex, rCommand.uiBaseInstance);
+				return (false);
+			}
+		}
+
+		if (uiCommand != vCommands.size())
+		{
+			sys_err("CTerrainBenchmark::CheckDrawCommands: Mask 0x%016llX draws %zu commands for %zu visible patches", ulMask, vCommands.size(), uiCommand);
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * CheckWaterPlanes - Water pass planning on a synthetic water map.
+ *
+ * Terrain (0, 0) is loaded again, flattened to 0 and every patch flooded by
+ * one of five waters or left dry. Two waters share a height and two are one
+ * float step apart, so they must give three and two passes of their own.
+ * Seen whole and seen in part, the planes must be ascending, each height
+ * once, and hold the height of every water patch the view keeps and no
+ * other.
+ */
+bool CTerrainBenchmark::CheckWaterPlanes()
+{
+	CTerrain* pTerrain = CTerrain::New();
+	pTerrain->Clear();
+	pTerrain->SetTerrainMapOwner(&m_TerrainMap);
+	pTerrain->SetTerrainCoords(0, 0);
+
+	TTerrainLoadRequest request{};
+	request.pTerrain = pTerrain;
+	request.stMapDirectory = m_stMapName;
+	request.iTerrainNum = 0;
+
+	if (!CTerrainLoader::LoadTerrainData(request))
+	{
+		sys_err("CTerrainBenchmark::CheckWaterPlanes: Failed to load terrain (0, 0) of %s", m_stMapName.c_str());
+		CTerrain::Delete(pTerrain);
+		return (false);
+	}
+
+	const GLfloat afWaterHeights[] = { 2.0f, 5.0f, 5.0f, 8.0f, std::nextafter(8.0f, 9.0f) };
+	const GLint iWaters = static_cast<GLint>(sizeof(afWaterHeights) / sizeof(afWaterHeights[0]));
+
+	CGrid<GLfloat>& rHeightMap = pTerrain->GetHeightMap();
+	std::fill(rHeightMap.GetBaseAddr(), rHeightMap.GetBaseAddr() + rHeightMap.GetSize(), 0.0f);
+
+	TTerrainWaterData& rWaterData = pTerrain->GetWaterData();
+	rWaterData.m_ubNumWater = static_cast<GLubyte>(iWaters);
+	std::copy(afWaterHeights, afWaterHeights + iWaters, rWaterData.m_fWaterHeight);
+
+	// Water iWaters is no water, the patch stays dry
+	std::uniform_int_distribution<GLint> distWater(0, iWaters);
+
+	for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
+	{
+		// The first patches take every water once, the others a random one
+		const GLint iWater = (iPatchNum <= iWaters) ? iPatchNum : distWater(m_Random);
+		const GLubyte ubWater = (iWater < iWaters) ? static_cast<GLubyte>(iWater) : 0xFF;
+
+		const GLint iPatchStartX = (iPatchNum % PATCH_XCOUNT) * PATCH_XSIZE;
+		const GLint iPatchStartZ = (iPatchNum / PATCH_XCOUNT) * PATCH_ZSIZE;
+
+		for (GLint iZ = iPatchStartZ; iZ < iPatchStartZ + PATCH_ZSIZE; iZ++)
+		{
+			for (GLint iX = iPatchStartX; iX < iPatchStartX + PATCH_XSIZE; iX++)
+			{
+				rWaterData.m_ubWaterMap.GetBaseAddr()[iZ * WATERMAP_XSIZE + iX] = ubWater;
+			}
+		}
+
+		pTerrain->GetTerrainPatchPtr(iPatchNum % PATCH_XCOUNT, iPatchNum / PATCH_XCOUNT)->SetUpdateNeed(true);
+	}
+
+	pTerrain->CalculateTerrainPatches(false);
+
+	const GLfloat fTerrainCenter = 0.5f * static_cast<GLfloat>(TERRAIN_XSIZE);
+
+	// The whole terrain from high above one side, then a narrow view from a corner
+	CMatrix4Df matView{}, matProjection{};
+	const SVector3Df v3WholeEye(fTerrainCenter, 2000.0f, -600.0f);
+	matView.InitCameraTransform(v3WholeEye, (SVector3Df(fTerrainCenter, 0.0f, fTerrainCenter) - v3WholeEye).normalize(), SVector3Df(0.0f, 1.0f, 0.0f));
+	matProjection.InitPersProjTransform(TPersProjInfo{ 45.0f, 1600.0f, 960.0f, 1.0f, 10000.0f });
+	const SFrustumCulling wholeView(matProjection * matView);
+
+	matView.InitCameraTransform(SVector3Df(0.0f, 40.0f, 0.0f), SVector3Df(1.0f, -0.4f, 0.2f).normalize(), SVector3Df(0.0f, 1.0f, 0.0f));
+	matProjection.InitPersProjTransform(TPersProjInfo{ 30.0f, 1600.0f, 960.0f, 1.0f, 200.0f });
+	const SFrustumCulling partialView(matProjection * matView);
+
+	bool bValid = CheckWaterPlanesView(pTerrain, wholeView, "whole");
+	bValid = bValid && CheckWaterPlanesView(pTerrain, partialView, "partial");
+
+	// Seen whole, every water gets a pass and the two at 5 share theirs
+	std::vector<GLfloat> vWaterHeights, vWaterPlanes;
+	pTerrain->CollectWaterHeights(wholeView, vWaterHeights);
+	CTerrainMap::PlanWaterPlanes(vWaterHeights, vWaterPlanes);
+
+	if (bValid && vWaterPlanes.size() != static_cast<size_t>(iWaters - 1))
+	{
+		sys_err("CTerrainBenchmark::CheckWaterPlanes: %zu planes for %d distinct water heights", vWaterPlanes.size(), iWaters - 1);
+		bValid = false;
+	}
+
+	CTerrain::Delete(pTerrain);
+	return (bValid);
+}
+
+bool CTerrainBenchmark::CheckWaterPlanesView(CTerrain* pTerrain, const SFrustumCulling& frustumCulling, const char* pszView)
+{
+	std::vector<GLfloat> vWaterHeights, vWaterPlanes;
+	pTerrain->CollectWaterHeights(frustumCulling, vWaterHeights);
+	CTerrainMap::PlanWaterPlanes(vWaterHeights, vWaterPlanes);
+
+	for (size_t i = 1; i < vWaterPlanes.size(); i++)
+	{
+		if (!(vWaterPlanes[i - 1] < vWaterPlanes[i]))
+		{
+			sys_err("CTerrainBenchmark::CheckWaterPlanes: %s view plans %f after %f, one pass per height in ascending order expected",
+				pszView, vWaterPlanes[i], vWaterPlanes[i - 1]);
+			return (false);
+		}
+	}
+
+	// Every plane must draw at least one visible water patch, every visible water patch must get a plane
+	std::vector<bool> vPlaneUsed(vWaterPlanes.size(), false);
+
+	for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
+	{
+		CTerrainPatch* pPatch = pTerrain->GetTerrainPatchPtr(iPatchNum % PATCH_XCOUNT, iPatchNum / PATCH_XCOUNT);
+		const TBoundingBox patchBox = pPatch->GetBoundingBox();
+
+		if (!pPatch->IsWaterPatch() || !frustumCulling.IsBoxInsideViewFrustum(patchBox.v3Min, patchBox.v3Max))
+		{
+			continue;
+		}
+
+		// CTerrain::RenderWater draws the patches whose height equals the plane
+		const auto it = std::find(vWaterPlanes.begin(), vWaterPlanes.end(), pPatch->GetWaterHeight());
+		if (it == vWaterPlanes.end())
+		{
+			sys_err("CTerrainBenchmark::CheckWaterPlanes: %s view has no pass for water patch %d at %f", pszView, iPatchNum, pPatch->GetWaterHeight());
+			return (false);
+		}
+
+		vPlaneUsed[it - vWaterPlanes.begin()] = true;
+	}
+
+	for (size_t i = 0; i < vWaterPlanes.size(); i++)
+	{
+		if (!vPlaneUsed[i])
+		{
+			sys_err("CTerrainBenchmark::CheckWaterPlanes: %s view plans a pass at %f without a visible water patch", pszView, vWaterPlanes[i]);
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * CheckPatchBoxes - Patch bounding boxes on known heights.
+ *
+ * Terrain (0, 0) is loaded again and given heights that change at every
+ * vertex, so each patch has its own lowest and highest vertex. A third of
+ * the patches is flooded above the terrain, a third below it where no
+ * water quad is drawn. The boxes must hold every terrain and water vertex
+ * of their patch and reach exactly the lowest and highest one.
+ *
+ * A brush then raises the corner shared by four patches and another sinks
+ * the middle of one patch. Only the patches they flag are rebuilt, their
+ * boxes must follow.
+ */
+bool CTerrainBenchmark::CheckPatchBoxes()
+{
+	CTerrain* pTerrain = CTerrain::New();
+	pTerrain->Clear();
+	pTerrain->SetTerrainMapOwner(&m_TerrainMap);
+	pTerrain->SetTerrainCoords(0, 0);
+
+	TTerrainLoadRequest request{};
+	request.pTerrain = pTerrain;
+	request.stMapDirectory = m_stMapName;
+	request.iTerrainNum = 0;
+
+	if (!CTerrainLoader::LoadTerrainData(request))
+	{
+		sys_err("CTerrainBenchmark::CheckPatchBoxes: Failed to load terrain (0, 0) of %s", m_stMapName.c_str());
+		CTerrain::Delete(pTerrain);
+		return (false);
+	}
+
+	// Heights on [-20, 28], the water above and below all of them
+	CGrid<GLfloat>& rHeightMap = pTerrain->GetHeightMap();
+	for (GLint iZ = 0; iZ < HEIGHTMAP_RAW_ZSIZE; iZ++)
+	{
+		for (GLint iX = 0; iX < HEIGHTMAP_RAW_XSIZE; iX++)
+		{
+			rHeightMap.GetBaseAddr()[iZ * HEIGHTMAP_RAW_XSIZE + iX] = static_cast<GLfloat>((iX * 37 + iZ * 101) % 97) * 0.5f - 20.0f;
+		}
+	}
+
+	TTerrainWaterData& rWaterData = pTerrain->GetWaterData();
+	rWaterData.m_ubNumWater = 2;
+	rWaterData.m_fWaterHeight[0] = 60.0f;
+	rWaterData.m_fWaterHeight[1] = -30.0f;
+
+	for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
+	{
+		const GLubyte ubWater = (iPatchNum % 3 < 2) ? static_cast<GLubyte>(iPatchNum % 3) : 0xFF;
+
+		const GLint iPatchStartX = (iPatchNum % PATCH_XCOUNT) * PATCH_XSIZE;
+		const GLint iPatchStartZ = (iPatchNum / PATCH_XCOUNT) * PATCH_ZSIZE;
+
+		for (GLint iZ = iPatchStartZ; iZ < iPatchStartZ + PATCH_ZSIZE; iZ++)
+		{
+			for (GLint iX = iPatchStartX; iX < iPatchStartX + PATCH_XSIZE; iX++)
+			{
+				rWaterData.m_ubWaterMap.GetBaseAddr()[iZ * WATERMAP_XSIZE + iX] = ubWater;
+			}
+		}
+
+		pTerrain->GetTerrainPatchPtr(iPatchNum % PATCH_XCOUNT, iPatchNum / PATCH_XCOUNT)->SetUpdateNeed(true);
+	}
+
+	pTerrain->CalculateTerrainPatches(false);
+	bool bValid = CheckPatchBoxesFit(pTerrain, "built");
+
+	// Above every water on the corner of patches (0, 0) to (1, 1), then below every water inside patch (2, 1).
+	// Without GL objects the brushes rebuild the flagged patches only
+	pTerrain->DrawHeightBrush(BRUSH_SHAPE_CIRCLE, BRUSH_TYPE_UP, PATCH_XSIZE, PATCH_ZSIZE, 3, 200);
+	pTerrain->DrawHeightBrush(BRUSH_SHAPE_CIRCLE, BRUSH_TYPE_DOWN, PATCH_XSIZE * 2 + PATCH_XSIZE / 2, PATCH_ZSIZE + PATCH_ZSIZE / 2, 3, 200);
+
+	bValid = bValid && CheckPatchBoxesFit(pTerrain, "edited");
+
+	CTerrain::Delete(pTerrain);
+	return (bValid);
+}
+
+bool CTerrainBenchmark::CheckPatchBoxesFit(CTerrain* pTerrain, const char* pszStage)
+{
+	for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
+	{
+		CTerrainPatch* pPatch = pTerrain->GetTerrainPatchPtr(iPatchNum % PATCH_XCOUNT, iPatchNum / PATCH_XCOUNT);
+		const TBoundingBox patchBox = pPatch->GetBoundingBox();
+
+		GLfloat fMinY = FLT_MAX, fMaxY = -FLT_MAX;
+		const auto fnFits = [&patchBox, &fMinY, &fMaxY](const SVector3Df& v3Position)
+		{
+			fMinY = std::min(fMinY, v3Position.y);
+			fMaxY = std::max(fMaxY, v3Position.y);
+
+			return (v3Position.x >= patchBox.v3Min.x && v3Position.y >= patchBox.v3Min.y && v3Position.z >= patchBox.v3Min.z &&
+				v3Position.x <= patchBox.v3Max.x && v3Position.y <= patchBox.v3Max.y && v3Position.z <= patchBox.v3Max.z);
+		};
+
+		for (const TTerrainVertex& rVertex : pPatch->GetPatchVertices())
+		{
+			if (!fnFits(rVertex.m_v3Position))
+			{
+				sys_err("CTerrainBenchmark::CheckPatchBoxes: %s patch %d box misses its vertex (%f, %f, %f)",
+					pszStage, iPatchNum, rVertex.m_v3Position.x, rVertex.m_v3Position.y, rVertex.m_v3Position.z);
+				return (false);
+			}
+		}
+
+		for (const TTerrainWaterVertex& rVertex : pPatch->GetPatchWaterVertices())
+		{
+			if (!fnFits(rVertex.m_v3Position))
+			{
+				sys_err("CTerrainBenchmark::CheckPatchBoxes: %s patch %d box misses its water vertex (%f, %f, %f)",
+					pszStage, iPatchNum, rVertex.m_v3Position.x, rVertex.m_v3Position.y, rVertex.m_v3Position.z);
+				return (false);
+			}
+		}
+
+		if (pPatch->GetPatchVertices().size() != PATCH_VERTEX_COUNT || patchBox.v3Min.y != fMinY || patchBox.v3Max.y != fMaxY)
+		{
+			sys_err("CTerrainBenchmark::CheckPatchBoxes: %s patch %d box spans %f to %f, its %zu vertices %f to %f",
+				pszStage, iPatchNum, patchBox.v3Min.y, patchBox.v3Max.y, pPatch->GetPatchVertices().size(), fMinY, fMaxY);
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * CheckStreaming - UpdateMap streaming without GL.
+ *
+ * The map is loaded again with CTerrainMap::LoadMap streaming the CPU side
+ * only, with a ring of BENCHMARK_STREAMING_LOAD_SIZE terrains, and the
+ * camera is moved over it, see CheckStreamingMoves. The map is then loaded
+ * whole again for the benchmarks run after this one.
+ */
+bool CTerrainBenchmark::CheckStreaming()
+{
+	m_TerrainMap.SetTerrainLoadSize(BENCHMARK_STREAMING_LOAD_SIZE);
+	const bool bValid = CheckStreamingMoves();
+	m_TerrainMap.SetTerrainLoadSize(TERRAIN_LOAD_SIZE);
+
+	if (!m_TerrainMap.LoadMapData())
+	{
+		sys_err("CTerrainBenchmark::CheckStreaming: Failed to Load Map %s again", m_stMapName.c_str());
+		return (false);
+	}
+
+	return (bValid);
+}
+
+/*
+ * CheckStreamingMoves - Camera moves of CheckStreaming.
+ *
+ * The camera walks from terrain to terrain along the first row, down the
+ * last column and back along the diagonal, steps back and forth across a
+ * border a hair from it, and leaves the map on both sides. The loads are
+ * waited for after each move, see CheckStreamingRing: every terrain that
+ * entered the ring must be uploaded once and the others kept as they are.
+ *
+ * The walk is then made again without waiting, so terrains leave the ring
+ * while they are still loading. Once waited for, only the ring must be
+ * resident and the pool must hold no other terrain.
+ */
+bool CTerrainBenchmark::CheckStreamingMoves()
+{
+	const GLfloat fTerrainSize = static_cast<GLfloat>(TERRAIN_XSIZE);
+	const auto fnTerrainCenter = [fTerrainSize](GLint iTerrainX, GLint iTerrainZ)
+	{
+		return (SVector3Df((static_cast<GLfloat>(iTerrainX) + 0.5f) * fTerrainSize, 0.0f, (static_cast<GLfloat>(iTerrainZ) + 0.5f) * fTerrainSize));
+	};
+
+	std::vector<SVector3Df> vMoves;
+	for (GLint iTerrainX = 1; iTerrainX < m_iTerrainCountX; iTerrainX++)
+	{
+		vMoves.push_back(fnTerrainCenter(iTerrainX, 0));
+	}
+	for (GLint iTerrainZ = 1; iTerrainZ < m_iTerrainCountZ; iTerrainZ++)
+	{
+		vMoves.push_back(fnTerrainCenter(m_iTerrainCountX - 1, iTerrainZ));
+	}
+	for (GLint iStep = std::max(m_iTerrainCountX, m_iTerrainCountZ) - 2; iStep >= 0; iStep--)
+	{
+		vMoves.push_back(fnTerrainCenter(std::min(iStep, m_iTerrainCountX - 1), std::min(iStep, m_iTerrainCountZ - 1)));
+	}
+	for (GLint iCrossing = 0; iCrossing < 4; iCrossing++)
+	{
+		const GLfloat fSide = (iCrossing % 2 == 0) ? BENCHMARK_STREAMING_BORDER : -BENCHMARK_STREAMING_BORDER;
+		vMoves.push_back(SVector3Df(fTerrainSize + fSide, 0.0f, 0.5f * fTerrainSize));
+	}
+	vMoves.push_back(SVector3Df(-4.0f * fTerrainSize, 0.0f, -4.0f * fTerrainSize));
+	vMoves.push_back(SVector3Df((m_iTerrainCountX + 4) * fTerrainSize, 0.0f, (m_iTerrainCountZ + 4) * fTerrainSize));
+
+	const SVector3Df v3Start = fnTerrainCenter(0, 0);
+	if (!m_TerrainMap.LoadMap(v3Start, false))
+	{
+		sys_err("CTerrainBenchmark::CheckStreaming: Failed to Load Map %s without GL state", m_stMapName.c_str());
+		return (false);
+	}
+
+	// The start is checked like a move, every terrain of its ring entered
+	std::vector<CTerrain*> vResident(static_cast<size_t>(m_iTerrainCountX) * m_iTerrainCountZ, nullptr);
+	GLuint uiUploads = 0;
+	GLint iEntered = 0;
+
+	for (size_t i = 0; i <= vMoves.size(); i++)
+	{
+		const SVector3Df& v3Camera = (i == 0) ? v3Start : vMoves[i - 1];
+		if (i > 0)
+		{
+			m_TerrainMap.UpdateMap(v3Camera);
+			m_TerrainMap.FinishTerrainLoads();
+		}
+
+		if (!CheckStreamingRing(v3Camera, vResident, &iEntered))
+		{
+			return (false);
+		}
+
+		if (m_TerrainMap.GetNumTerrainUploads() - uiUploads != static_cast<GLuint>(iEntered))
+		{
+			sys_err("CTerrainBenchmark::CheckStreaming: Move %zu uploaded %u terrains, %d entered the ring", i, m_TerrainMap.GetNumTerrainUploads() - uiUploads, iEntered);
+			return (false);
+		}
+
+		uiUploads = m_TerrainMap.GetNumTerrainUploads();
+	}
+
+	// Nothing waited for in between, loads in flight are dropped
+	for (const SVector3Df& v3Camera : vMoves)
+	{
+		m_TerrainMap.UpdateMap(v3Camera);
+	}
+	m_TerrainMap.FinishTerrainLoads();
+
+	std::fill(vResident.begin(), vResident.end(), nullptr);
+	if (!CheckStreamingRing(vMoves.back(), vResident, &iEntered))
+	{
+		return (false);
+	}
+
+	uiUploads = m_TerrainMap.GetNumTerrainUploads();
+
+	// Waited for already, one more move to the same terrain must not upload anything
+	m_TerrainMap.UpdateMap(vMoves.back());
+	m_TerrainMap.FinishTerrainLoads();
+
+	if (m_TerrainMap.GetNumTerrainUploads() != uiUploads)
+	{
+		sys_err("CTerrainBenchmark::CheckStreaming: %u terrains uploaded again without moving", m_TerrainMap.GetNumTerrainUploads() - uiUploads);
+		return (false);
+	}
+
+	return (true);
+}
+
+bool CTerrainBenchmark::CheckStreamingRing(const SVector3Df& v3Camera, std::vector<CTerrain*>& vResident, GLint* piEntered)
+{
+	const GLint iCameraX = std::clamp(static_cast<GLint>(std::floor(v3Camera.x / static_cast<GLfloat>(TERRAIN_XSIZE))), 0, m_iTerrainCountX - 1);
+	const GLint iCameraZ = std::clamp(static_cast<GLint>(std::floor(v3Camera.z / static_cast<GLfloat>(TERRAIN_ZSIZE))), 0, m_iTerrainCountZ - 1);
+
+	GLint iExpected = 0, iEntered = 0;
+
+	for (GLint iTerrainNum = 0; iTerrainNum < m_iTerrainCountX * m_iTerrainCountZ; iTerrainNum++)
+	{
+		const GLint iTerrainX = iTerrainNum % m_iTerrainCountX;
+		const GLint iTerrainZ = iTerrainNum / m_iTerrainCountX;
+		const bool bInRing = std::abs(iTerrainX - iCameraX) <= BENCHMARK_STREAMING_LOAD_SIZE && std::abs(iTerrainZ - iCameraZ) <= BENCHMARK_STREAMING_LOAD_SIZE;
+
+		CTerrain* pTerrain = nullptr;
+		const bool bResident = m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain);
+
+		if (bResident != bInRing)
+		{
+			sys_err("CTerrainBenchmark::CheckStreaming: Camera on terrain (%d, %d), terrain (%d, %d) is %s",
+				iCameraX, iCameraZ, iTerrainX, iTerrainZ, bResident ? "resident outside the ring" : "missing from the ring");
+			return (false);
+		}
+
+		if (!bResident)
+		{
+			vResident[iTerrainNum] = nullptr;
+			continue;
+		}
+
+		GLint iCoordX = -1, iCoordZ = -1;
+		pTerrain->GetTerrainCoords(&iCoordX, &iCoordZ);
+
+		if (iCoordX != iTerrainX || iCoordZ != iTerrainZ || !pTerrain->IsReady())
+		{
+			sys_err("CTerrainBenchmark::CheckStreaming: Slot of terrain (%d, %d) holds terrain (%d, %d)%s",
+				iTerrainX, iTerrainZ, iCoordX, iCoordZ, pTerrain->IsReady() ? "" : " not ready");
+			return (false);
+		}
+
+		if (vResident[iTerrainNum] && vResident[iTerrainNum] != pTerrain)
+		{
+			sys_err("CTerrainBenchmark::CheckStreaming: Terrain (%d, %d) stayed in the ring but was built again", iTerrainX, iTerrainZ);
+			return (false);
+		}
+
+		iEntered += vResident[iTerrainNum] ? 0 : 1;
+		vResident[iTerrainNum] = pTerrain;
+		iExpected++;
+	}
+
+	*piEntered = iEntered;
+
+	// Terrains dropped while loading go back to the pool too
+	const size_t sPooled = CTerrain::ms_TerrainPool.GetUsedCount();
+
+	if (m_TerrainMap.GetNumLoadedTerrains() != iExpected || sPooled != static_cast<size_t>(iExpected))
+	{
+		sys_err("CTerrainBenchmark::CheckStreaming: %d terrains in the ring, the map counts %d and the pool holds %zu",
+			iExpected, m_TerrainMap.GetNumLoadedTerrains(), sPooled);
+		return (false);
+	}
+
+	return (true);
+}
+
+/*
+ * CheckTerrainLoads - Worker stage of the terrain loads, failed and stale ones included.
+ *
+ * Every terrain of the map but one is saved to a chunk in a copy of the map
+ * under the temp directory, the missing one fails to load there. The copy
+ * is streamed with CTerrainMap::LoadMap without GL state, see
+ * CheckTerrainLoadsMoves, then the map is loaded whole again from its own
+ * directory.
+ */
+bool CTerrainBenchmark::CheckTerrainLoads()
+{
+	const std::filesystem::path loadMapPath = std::filesystem::temp_directory_path() / "metin3_benchmark_loads";
+	const std::string stLoadMap = loadMapPath.string();
+
+	std::error_code errorCode;
+	std::filesystem::remove_all(loadMapPath, errorCode);
+	std::filesystem::create_directories(loadMapPath, errorCode);
+
+	// Right of the first terrain, in the ring of the start and on the far side of the border crossed
+	const GLint iFailedX = std::min(1, m_iTerrainCountX - 1);
+	const GLint iFailedZ = 0;
+
+	bool bValid = std::filesystem::copy_file(m_stMapName + "\\map_settings.json", stLoadMap + "\\map_settings.json", errorCode);
+
+	for (GLint iTerrainNum = 0; bValid && iTerrainNum < m_iTerrainCountX * m_iTerrainCountZ; iTerrainNum++)
+	{
+		CTerrain* pTerrain = nullptr;
+		if (!m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain))
+		{
+			continue;
+		}
+
+		GLint iTerrainX = -1, iTerrainZ = -1;
+		pTerrain->GetTerrainCoords(&iTerrainX, &iTerrainZ);
+		if (iTerrainX == iFailedX && iTerrainZ == iFailedZ)
+		{
+			continue;
+		}
+
+		std::filesystem::create_directories(std::filesystem::path(CTerrainChunk::GetFileName(stLoadMap, iTerrainX, iTerrainZ)).parent_path(), errorCode);
+		bValid = pTerrain->SaveChunk(stLoadMap);
+	}
+
+	if (!bValid)
+	{
+		sys_err("CTerrainBenchmark::CheckTerrainLoads: Failed to copy the map %s to %s", m_stMapName.c_str(), stLoadMap.c_str());
+	}
+	else
+	{
+		m_TerrainMap.SetMapName(stLoadMap);
+		m_TerrainMap.SetTerrainLoadSize(BENCHMARK_STREAMING_LOAD_SIZE);
+		bValid = CheckTerrainLoadsMoves(iFailedX, iFailedZ);
+	}
+
+	m_TerrainMap.SetMapName(m_stMapName);
+	m_TerrainMap.SetTerrainLoadSize(TERRAIN_LOAD_SIZE);
+
+	if (!m_TerrainMap.LoadMapData())
+	{
+		sys_err("CTerrainBenchmark::CheckTerrainLoads: Failed to Load Map %s again", m_stMapName.c_str());
+		bValid = false;
+	}
+
+	std::filesystem::remove_all(loadMapPath, errorCode);
+	return (bValid);
+}
+
+/*
+ * CheckTerrainLoadsMoves - Camera moves of CheckTerrainLoads.
+ *
+ * The first ring comes from LoadMap. The camera then goes to the far corner
+ * of the map and straight back without waiting, the loads of the far ring
+ * are stale once they finish. It then crosses the border next to the
+ * failed terrain and back, each crossing asks for the failed terrain
+ * again. After each, FinishTerrainLoads must leave the ring resident
+ * without the failed terrain, see CheckTerrainLoadsRing.
+ */
+bool CTerrainBenchmark::CheckTerrainLoadsMoves(GLint iFailedX, GLint iFailedZ)
+{
+	const GLfloat fTerrainSize = static_cast<GLfloat>(TERRAIN_XSIZE);
+	const SVector3Df v3Start(0.5f * fTerrainSize, 0.0f, 0.5f * fTerrainSize);
+	const SVector3Df v3Far((static_cast<GLfloat>(m_iTerrainCountX) - 0.5f) * fTerrainSize, 0.0f, (static_cast<GLfloat>(m_iTerrainCountZ) - 0.5f) * fTerrainSize);
+
+	if (!m_TerrainMap.LoadMap(v3Start, false))
+	{
+		sys_err("CTerrainBenchmark::CheckTerrainLoads: Failed to Load Map %s without GL state", m_TerrainMap.GetMapName().c_str());
+		return (false);
+	}
+
+	if (!CheckTerrainLoadsRing(0, 0, iFailedX, iFailedZ, "first ring"))
+	{
+		return (false);
+	}
+
+	// Only the terrains that loaded count as uploads
+	if (m_TerrainMap.GetNumTerrainUploads() != static_cast<GLuint>(m_TerrainMap.GetNumLoadedTerrains()))
+	{
+		sys_err("CTerrainBenchmark::CheckTerrainLoads: The first ring uploaded %u terrains, %d loaded", m_TerrainMap.GetNumTerrainUploads(), m_TerrainMap.GetNumLoadedTerrains());
+		return (false);
+	}
+
+	m_TerrainMap.UpdateMap(v3Far);
+	m_TerrainMap.UpdateMap(v3Start);
+	m_TerrainMap.FinishTerrainLoads();
+
+	if (!CheckTerrainLoadsRing(0, 0, iFailedX, iFailedZ, "back from the far corner"))
+	{
+		return (false);
+	}
+
+	const GLint iCrossedX = std::min(1, m_iTerrainCountX - 1);
+
+	m_TerrainMap.UpdateMap(SVector3Df(fTerrainSize + BENCHMARK_STREAMING_BORDER, 0.0f, 0.5f * fTerrainSize));
+	m_TerrainMap.FinishTerrainLoads();
+
+	if (!CheckTerrainLoadsRing(iCrossedX, 0, iFailedX, iFailedZ, "across the border"))
+	{
+		return (false);
+	}
+
+	m_TerrainMap.UpdateMap(SVector3Df(fTerrainSize - BENCHMARK_STREAMING_BORDER, 0.0f, 0.5f * fTerrainSize));
+	m_TerrainMap.FinishTerrainLoads();
+
+	return (CheckTerrainLoadsRing(0, 0, iFailedX, iFailedZ, "back across the border"));
+}
+
+bool CTerrainBenchmark::CheckTerrainLoadsRing(GLint iCameraX, GLint iCameraZ, GLint iFailedX, GLint iFailedZ, const char* pszStage)
+{
+	GLint iExpected = 0;
+
+	for (GLint iTerrainNum = 0; iTerrainNum < m_iTerrainCountX * m_iTerrainCountZ; iTerrainNum++)
+	{
+		const GLint iTerrainX = iTerrainNum % m_iTerrainCountX;
+		const GLint iTerrainZ = iTerrainNum / m_iTerrainCountX;
+		const bool bFailed = iTerrainX == iFailedX && iTerrainZ == iFailedZ;
+		const bool bInRing = std::abs(iTerrainX - iCameraX) <= BENCHMARK_STREAMING_LOAD_SIZE && std::abs(iTerrainZ - iCameraZ) <= BENCHMARK_STREAMING_LOAD_SIZE;
+
+		CTerrain* pTerrain = nullptr;
+		const bool bResident = m_TerrainMap.GetTerrainPtr(iTerrainNum, &pTerrain);
+
+		if (bResident != (bInRing && !bFailed))
+		{
+			sys_err("CTerrainBenchmark::CheckTerrainLoads: %s, terrain (%d, %d)%s is %s", pszStage, iTerrainX, iTerrainZ,
+				bFailed ? " failing to load" : "", bResident ? "resident" : "missing from the ring");
+			return (false);
+		}
+
+		CTerrainAreaData* pArea = nullptr;
+		if (m_TerrainMap.GetAreaPtr(iTerrainNum, &pArea) && !bResident)
+		{
+			sys_err("CTerrainBenchmark::CheckTerrainLoads: %s, area (%d, %d) is loaded without its terrain", pszStage, iTerrainX, iTerrainZ);
+			return (false);
+		}
+
+		if (!bResident)
+		{
+			continue;
+		}
+
+		GLint iCoordX = -1, iCoordZ = -1;
+		pTerrain->GetTerrainCoords(&iCoordX, &iCoordZ);
+
+		if (iCoordX != iTerrainX || iCoordZ != iTerrainZ || !pTerrain->IsReady())
+		{
+			sys_err("CTerrainBenchmark::CheckTerrainLoads: %s, slot of terrain (%d, %d) holds terrain (%d, %d)%s",
+				pszStage, iTerrainX, iTerrainZ, iCoordX, iCoordZ, pTerrain->IsReady() ? "" : " not ready");
+			return (false);
+		}
+
+		iExpected++;
+	}
+
+	// The failed terrain and the stale ones went back to the pool
+	const size_t sPooled = CTerrain::ms_TerrainPool.GetUsedCount();
+
+	if (m_TerrainMap.GetNumLoadedTerrains() != iExpected || sPooled != static_cast<size_t>(iExpected))
+	{
+		sys_err("CTerrainBenchmark::CheckTerrainLoads: %s, %d terrains resident, the map counts %d and the pool holds %zu",
+			pszStage, iExpected, m_TerrainMap.GetNumLoadedTerrains(), sPooled);
+		return (false);
+	}
+
+	return (true);
+}
+
+json CTerrainBenchmark::GetReport() const
+{
+	json jsonReport;
+	jsonReport["map"] = m_stMapName;
+	jsonReport["map_size"]["x"] = m_iTerrainCountX;
+	jsonReport["map_size"]["z"] = m_iTerrainCountZ;
+	jsonReport["runs"] = m_iRuns;
+	jsonReport["seed"] = m_uiSeed;
+#if defined(_DEBUG)
+	jsonReport["configuration"] = "Debug";
+#else
+	jsonReport["configuration"] = "Release";
+#endif
+
+	json jsonResults = json::array();
+	double dHeightMs = 0.0;
+	double dHeightsMs = 0.0;
+	double dPickingMs = 0.0;
+	for (const TBenchmarkResult& rResult : m_vResults)
+	{
+		json jsonResult = GetSampleStats(rResult.vSamplesMs);
+		jsonResult["name"] = rResult.stName;
+		jsonResult["description"] = rResult.stDescription;
+		jsonResult["items_per_sample"] = rResult.iItemsPerSample;
+		jsonResult["median_ns_per_item"] = jsonResult["median_ms"].get<double>() * 1.0e6 / static_cast<double>(std::max(rResult.iItemsPerSample, 1));
+		jsonResults.push_back(jsonResult);
+
+		if (rResult.stName == "get_height")
+		{
+			dHeightMs = jsonResult["median_ms"].get<double>();
+		}
+		else if (rResult.stName == "get_heights")
+		{
+			dHeightsMs = jsonResult["median_ms"].get<double>();
+		}
+		else if (rResult.stName == "picking")
+		{
+			dPickingMs = jsonResult["median_ms"].get<double>();
+		}
+	}
+
+	jsonReport["results"] = jsonResults;
+	jsonReport["height_batch_speedup"] = dHeightsMs > 0.0 ? dHeightMs / dHeightsMs : 0.0;
+	jsonReport["picking_rays_per_second"] = dPickingMs > 0.0 ? BENCHMARK_PICKING_RAYS * 1000.0 / dPickingMs : 0.0;
+
+	jsonReport["instance_uploads"]["objects"] = BENCHMARK_AREA_OBJECTS;
+	jsonReport["instance_uploads"]["first_frame"] = m_uiFirstFrameUploads;
+	jsonReport["instance_uploads"]["static_frames"] = m_uiStaticFrameUploads;
+	jsonReport["instance_uploads"]["one_object_moved"] = m_uiMovedObjectUploads;
+	jsonReport["checks"]["dirty_rects"] = m_bDirtyRectsValid;
+	jsonReport["checks"]["undo_redo"] = m_bUndoRedoValid;
+	jsonReport["checks"]["height_batch"] = m_bHeightBatchValid;
+	jsonReport["checks"]["picking"] = m_bPickingValid;
+	jsonReport["checks"]["chunk_round_trip"] = m_bChunkRoundTripValid;
+	jsonReport["checks"]["draw_commands"] = m_bDrawCommandsValid;
+	jsonReport["checks"]["water_planes"] = m_bWaterPlanesValid;
+	jsonReport["checks"]["patch_boxes"] = m_bPatchBoxesValid;
+	jsonReport["checks"]["streaming"] = m_bStreamingValid;
+	jsonReport["checks"]["terrain_loads"] = m_bTerrainLoadsValid;
+	return (jsonReport);
+}
+
+bool CTerrainBenchmark::IsInstanceUpdateValid() const
+{
+	return (m_uiFirstFrameUploads == static_cast<GLuint>(BENCHMARK_AREA_OBJECTS) && m_uiStaticFrameUploads == 0 && m_uiMovedObjectUploads == 1);
+}
+
+bool CTerrainBenchmark::AreDirtyRectsValid() const
+{
+	return (m_bDirtyRectsValid);
+}
+
+CTerrainMap* CTerrainBenchmark::GetTerrainMap()
+{
+	return (&m_TerrainMap);
+}
+
+bool CTerrainBenchmark::IsUndoRedoValid() const
+{
+	return (m_bUndoRedoValid);
+}
+
+bool CTerrainBenchmark::IsHeightBatchValid() const
+{
+	return (m_bHeightBatchValid);
+}
+
+bool CTerrainBenchmark::IsPickingValid() const
+{
+	return (m_bPickingValid);
+}
+
+bool CTerrainBenchmark::IsChunkRoundTripValid() const
+{
+	return (m_bChunkRoundTripValid);
+}
+
+bool CTerrainBenchmark::AreDrawCommandsValid() const
+{
+	return (m_bDrawCommandsValid);
+}
+
+bool CTerrainBenchmark::AreWaterPlanesValid() const
+{
+	return (m_bWaterPlanesValid);
+}
+
+bool CTerrainBenchmark::ArePatchBoxesValid() const
+{
+	return (m_bPatchBoxesValid);
+}
+
+bool CTerrainBenchmark::IsStreamingValid() const
+{
+	return (m_bStreamingValid);
+}
+
+bool CTerrainBenchmark::AreTerrainLoadsValid() const
+{
+	return (m_bTerrainLoadsValid);
+}
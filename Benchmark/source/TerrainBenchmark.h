@@ -0,0 +1,139 @@
+#pragma once
+
+#include "BenchmarkBase.h"
+#include "../../LibTerrain/source/TerrainMap.h"
+
+constexpr GLint BENCHMARK_HEIGHT_QUERIES = 1000000;
+constexpr GLfloat BENCHMARK_HEIGHT_NORMAL_TOLERANCE = 1.0e-3f;	// Meters, cell height rebuilt from a batch normal against GetHeight
+constexpr GLint BENCHMARK_BRUSH_STROKES = 64;	// Per run and per brush
+constexpr GLint BENCHMARK_BRUSH_SIZE = 8;
+constexpr GLint BENCHMARK_BRUSH_STRENGTH = 50;
+constexpr GLint BENCHMARK_AREA_OBJECTS = 4096;
+constexpr GLint BENCHMARK_UNDO_STROKES = 48;	// Random strokes of every brush undone and redone by CheckUndoRedo
+constexpr GLint BENCHMARK_PICKING_RELIEF_STROKES = 96;	// Up and noise strokes giving the map relief before the picking check
+constexpr GLint BENCHMARK_PICKING_CHECK_RAYS = 256;		// Rays per check, compared against every triangle of the map
+constexpr GLint BENCHMARK_PICKING_RAYS = 10000;			// Timed rays per sample
+constexpr GLfloat BENCHMARK_PICKING_RANGE = 2000.0f;
+constexpr GLfloat BENCHMARK_PICKING_TOLERANCE = 0.01f;	// Meters between the DDA hit and the brute force hit
+constexpr GLfloat BENCHMARK_CHUNK_WEIGHT_TOLERANCE = 0.5f / 255.0f + 1.0e-6f;	// Splat weights are quantized to a byte
+constexpr GLint BENCHMARK_STREAMING_LOAD_SIZE = 1;		// Ring of CheckStreaming, 3x3 terrains
+constexpr GLfloat BENCHMARK_STREAMING_BORDER = 0.01f;	// Meters from a terrain border of the positions crossing it
+
+// Timings of one measured operation, one sample per repetition
+typedef struct SBenchmarkResult
+{
+	std::string stName;
+	std::string stDescription;
+	std::vector<double> vSamplesMs;
+	GLint iItemsPerSample;		// Work done by one sample (terrains, patches, queries, strokes)
+} TBenchmarkResult;
+
+/**
+ * CTerrainBenchmark - Headless timings of the terrain CPU paths.
+ *
+ * The map is built with CTerrainMap::LoadMapData, so no window or GL context
+ * is needed. The streaming and loader checks load it again without GL
+ * state and load it whole once done.
+ */
+class CTerrainBenchmark : public CBenchmark
+{
+public:
+	CTerrainBenchmark();
+	~CTerrainBenchmark();
+
+	bool Initialize(const std::string& stMapName, GLint iRuns, GLuint uiSeed);
+	void Run() override;
+
+	json GetReport() const override;
+	// A static area must not upload instance matrices again after its first frame
+	bool IsInstanceUpdateValid() const;
+	// Brushes at the corners and edges of a terrain report the cells they changed
+	bool AreDirtyRectsValid() const;
+	// Undoing every stroke gives back the map bit for bit, redoing them gives back the edited one
+	bool IsUndoRedoValid() const;
+	// CTerrainMap::GetHeights gives the GetHeight heights bit for bit and normals matching its slopes
+	bool IsHeightBatchValid() const;
+	// CTerrainMap::IntersectRayWithTerrains finds the hit testing every triangle of the map finds
+	bool IsPickingValid() const;
+	// A terrain saved to a chunk loads back with the same maps, and a chunk with bad section sizes is refused
+	bool IsChunkRoundTripValid() const;
+	// CTerrain::BuildPatchDrawCommands draws exactly the visible patches, each with its own vertex range
+	bool AreDrawCommandsValid() const;
+	// CTerrainMap::PlanWaterPlanes gives one pass per distinct water height and a pass to every visible water patch
+	bool AreWaterPlanesValid() const;
+	// Every patch box holds all the terrain and water vertices of its patch and no more height, after an edit too
+	bool ArePatchBoxesValid() const;
+	// UpdateMap keeps exactly the ring around the camera resident, never builds a resident terrain again and leaks none
+	bool IsStreamingValid() const;
+	// Loads finished by the worker leave the ring resident, a failed load leaves neither terrain nor area and stale ones are dropped
+	bool AreTerrainLoadsValid() const;
+
+	// The loaded map, shared with the benchmarks that need a terrain
+	CTerrainMap* GetTerrainMap();
+
+protected:
+	void BenchmarkTerrainLoad();
+	void BenchmarkPatchGeneration();
+	void BenchmarkHeightQueries();
+	void BenchmarkHeightBrush();
+	void BenchmarkTextureBrush();
+	void BenchmarkInstanceUpdate();
+	bool CheckDirtyRects();
+	bool CheckUndoRedo();
+	bool CheckHeightBatch();
+	bool CheckPicking();
+	void BenchmarkPicking();
+	bool CheckChunkRoundTrip();
+	bool CheckDrawCommands();
+	bool CheckWaterPlanes();
+	// Planes of CollectWaterHeights + PlanWaterPlanes against the water patches the view keeps
+	static bool CheckWaterPlanesView(CTerrain* pTerrain, const SFrustumCulling& frustumCulling, const char* pszView);
+	bool CheckPatchBoxes();
+	static bool CheckPatchBoxesFit(CTerrain* pTerrain, const char* pszStage);
+	bool CheckStreaming();
+	bool CheckStreamingMoves();
+	// Resident terrains against the ring around v3Camera; vResident holds the previous ones and gets the new ones, *piEntered counts the new ones
+	bool CheckStreamingRing(const SVector3Df& v3Camera, std::vector<CTerrain*>& vResident, GLint* piEntered);
+	bool CheckTerrainLoads();
+	bool CheckTerrainLoadsMoves(GLint iFailedX, GLint iFailedZ);
+	// Resident terrains and areas against the ring around the camera terrain less the terrain that fails to load
+	bool CheckTerrainLoadsRing(GLint iCameraX, GLint iCameraZ, GLint iFailedX, GLint iFailedZ, const char* pszStage);
+
+	// Rays looking down on the map from above its highest point, some shallow, some straight down, some from off the map
+	void CreatePickingRays(GLint iRays, std::vector<CRay>& vRays);
+	// Closest hit of every cell triangle of the ready terrains, *pfHitT on [0, 1] like IntersectRayWithTerrains
+	bool IntersectRayBruteForce(const SVector3Df& v3Start, const SVector3Df& v3End, GLfloat* pfHitT);
+
+	// Bounding rect of the texels that differ between a copy of a grid and the grid
+	static TDirtyRect GetChangedRect(const std::vector<GLubyte>& vBefore, const void* pAfter, GLint iWidth, GLint iDepth, GLint iTexelSize);
+	static std::vector<GLubyte> GetGridBytes(const void* pGridBase, GLint iSizeInBytes);
+	// Every grid the brushes write, one byte string per terrain slot (empty when not loaded)
+	std::vector<std::vector<GLubyte>> GetBrushGridsBytes();
+
+	// Random cell of a loaded terrain, away from the terrain borders
+	void GetRandomBrushCell(GLint* piTerrainX, GLint* piTerrainZ, GLint* piCellX, GLint* piCellZ);
+
+private:
+	CTerrainMap m_TerrainMap;
+	std::string m_stMapName;
+	GLint m_iTerrainCountX;
+	GLint m_iTerrainCountZ;
+
+	// CTerrainAreaData::UpdateInstanceMatrices results of BenchmarkInstanceUpdate
+	GLuint m_uiFirstFrameUploads;
+	GLuint m_uiStaticFrameUploads;	// Summed over every frame after the first
+	GLuint m_uiMovedObjectUploads;	// After moving a single object
+
+	bool m_bDirtyRectsValid;
+	bool m_bUndoRedoValid;
+	bool m_bHeightBatchValid;
+	bool m_bPickingValid;
+	bool m_bChunkRoundTripValid;
+	bool m_bDrawCommandsValid;
+	bool m_bWaterPlanesValid;
+	bool m_bPatchBoxesValid;
+	bool m_bStreamingValid;
+	bool m_bTerrainLoadsValid;
+
+	std::vector<TBenchmarkResult> m_vResults;
+};
@@ -0,0 +1,284 @@
+#include "TerrainBenchmark.h"
+#include "MatrixBenchmark.h"
+#include "JobBenchmark.h"
+#include "PhysicsBenchmark.h"
+#include "BroadphaseBenchmark.h"
+#include "BVHBenchmark.h"
+#include "ShaderBenchmark.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#pragma comment(lib, "glfw3.lib")
+#if defined(_DEBUG)
+#pragma comment(lib, "Debug/assimp-vc143-mtd.lib")
+#pragma comment(lib, "Debug/zlibstaticd.lib")
+#pragma comment(lib, "Debug/meshoptimizer_mtd.lib")
+#else
+#pragma comment(lib, "Release/assimp-vc143-mt.lib")
+#pragma comment(lib, "Release/zlibstatic.lib")
+#pragma comment(lib, "Release/meshoptimizer.lib")
+#endif
+
+/*
+ * Usage: Benchmark [map directory] [--runs N] [--seed S] [--out file.json]
+ *
+ * The map directory defaults to the 4x4 map of UserInterface. The engine
+ * logs to stdout too, so the report is also written to --out (default
+ * benchmark.json) to be diffed between runs. Exits with a failure when the
+ * SIMD matrix kernels or the cached world matrices disagree with their
+ * reference, when a static area uploads instance matrices again, when
+ * a job system check fails, or when the physics bodies integrated on
+ * arrays drift from CPhysicsObject::Update.
+ *
+ * The matrix, job, broadphase, BVH and shader benchmarks need no map and
+ * always run; when the map fails to load the terrain and physics benchmarks
+ * are reported as skipped and the remaining checks still decide the exit
+ * code.
+ */
+int main(int argc, char** argv)
+{
+	std::string stMapName = "..\\UserInterface\\metin3_map_4v4";
+	std::string stOutFile = "benchmark.json";
+	GLint iRuns = BENCHMARK_DEFAULT_RUNS;
+	GLuint uiSeed = BENCHMARK_DEFAULT_SEED;
+
+	for (GLint i = 1; i < argc; i++)
+	{
+		const std::string stArg = argv[i];
+
+		if (stArg == "--runs" && i + 1 < argc)
+		{
+			iRuns = std::atoi(argv[++i]);
+		}
+		else if (stArg == "--seed" && i + 1 < argc)
+		{
+			uiSeed = static_cast<GLuint>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (stArg == "--out" && i + 1 < argc)
+		{
+			stOutFile = argv[++i];
+		}
+		else if (!stArg.empty() && stArg[0] != '-')
+		{
+			stMapName = stArg;
+		}
+		else
+		{
+			sys_err("Benchmark: Unknown argument %s", stArg.c_str());
+			sys_err("Usage: Benchmark [map directory] [--runs N] [--seed S] [--out file.json]");
+			return (EXIT_FAILURE);
+		}
+	}
+
+	// These need no map, they run and are checked even when the map fails to load
+	CMatrixBenchmark matrixBenchmark;
+	matrixBenchmark.Initialize(iRuns, uiSeed);
+	matrixBenchmark.Run();
+
+	CJobBenchmark jobBenchmark;
+	jobBenchmark.Initialize(iRuns, uiSeed);
+	jobBenchmark.Run();
+
+	CBroadphaseBenchmark broadphaseBenchmark;
+	broadphaseBenchmark.Initialize(iRuns, uiSeed);
+	broadphaseBenchmark.Run();
+
+	CBVHBenchmark bvhBenchmark;
+	bvhBenchmark.Initialize(iRuns, uiSeed);
+	bvhBenchmark.Run();
+
+	CShaderBenchmark shaderBenchmark;
+	shaderBenchmark.Initialize(iRuns, uiSeed);
+	shaderBenchmark.Run();
+
+	CTerrainBenchmark terrainBenchmark;
+	CPhysicsBenchmark physicsBenchmark;
+	const bool bMapLoaded = terrainBenchmark.Initialize(stMapName, iRuns, uiSeed);
+	if (bMapLoaded)
+	{
+		terrainBenchmark.Run();
+
+		physicsBenchmark.Initialize(terrainBenchmark.GetTerrainMap(), iRuns, uiSeed);
+		physicsBenchmark.Run();
+	}
+	else
+	{
+		sys_err("Benchmark: Failed to Initialize with Map %s, skipping the terrain and physics benchmarks", stMapName.c_str());
+	}
+
+	json jsonReport;
+	if (bMapLoaded)
+	{
+		jsonReport = terrainBenchmark.GetReport();
+		jsonReport["physics"] = physicsBenchmark.GetReport();
+	}
+	else
+	{
+		jsonReport["map"] = stMapName;
+		jsonReport["skipped"] = true;
+		jsonReport["physics"]["skipped"] = true;
+	}
+
+	jsonReport["map_loaded"] = bMapLoaded;
+	jsonReport["matrix"] = matrixBenchmark.GetReport();
+	jsonReport["jobs"] = jobBenchmark.GetReport();
+	jsonReport["broadphase"] = broadphaseBenchmark.GetReport();
+	jsonReport["bvh"] = bvhBenchmark.GetReport();
+	jsonReport["shader"] = shaderBenchmark.GetReport();
+
+	std::ofstream file(stOutFile);
+	if (file.is_open())
+	{
+		file << std::setw(4) << jsonReport << std::endl;
+	}
+	else
+	{
+		sys_err("Benchmark: Failed to write the report to %s", stOutFile.c_str());
+	}
+
+	std::cout << std::setw(4) << jsonReport << std::endl;
+
+	// Every failed check is reported, not only the first one
+	bool bChecksValid = true;
+
+	if (!matrixBenchmark.IsWithinTolerance())
+	{
+		sys_err("Benchmark: Optimized matrix results differ from their reference by more than %g", BENCHMARK_MATRIX_TOLERANCE);
+		bChecksValid = false;
+	}
+
+	if (!matrixBenchmark.AreFrustumBoxesValid())
+	{
+		sys_err("Benchmark: SFrustumCulling::IsBoxInsideViewFrustum misplaces a box inside, across or outside the frustum");
+		bChecksValid = false;
+	}
+
+	if (!jobBenchmark.AreChecksValid())
+	{
+		sys_err("Benchmark: Job system dependency, exception, shutdown or ParallelFor check failed");
+		bChecksValid = false;
+	}
+
+	if (!broadphaseBenchmark.ArePairsValid())
+	{
+		sys_err("Benchmark: A broadphase does not report exactly the overlapping AABB pairs");
+		bChecksValid = false;
+	}
+
+	if (!broadphaseBenchmark.ArePicksValid())
+	{
+		sys_err("Benchmark: A broadphase does not pick the closest object the ray hits");
+		bChecksValid = false;
+	}
+
+	if (!broadphaseBenchmark.AreGridKeysValid())
+	{
+		sys_err("Benchmark: The spatial grid does not floor its cell coordinates or packs two cells in one key");
+		bChecksValid = false;
+	}
+
+	if (!bvhBenchmark.AreQueriesValid())
+	{
+		sys_err("Benchmark: The BVH does not answer the ray and frustum queries like testing every box");
+		bChecksValid = false;
+	}
+
+	if (!shaderBenchmark.IsUniformCacheValid())
+	{
+		sys_err("Benchmark: CUniformLocationCache gives a wrong location or calls its lookup again for a cached name");
+		bChecksValid = false;
+	}
+
+	if (!bMapLoaded)
+	{
+		return (bChecksValid ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (!terrainBenchmark.IsInstanceUpdateValid())
+	{
+		sys_err("Benchmark: Static area objects uploaded instance matrices after their first frame");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.AreDirtyRectsValid())
+	{
+		sys_err("Benchmark: A brush dirty rect misses a changed cell or leaves the brush or grid bounds");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.IsUndoRedoValid())
+	{
+		sys_err("Benchmark: Undoing or redoing the brush strokes did not give back the terrain grids bit for bit");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.IsHeightBatchValid())
+	{
+		sys_err("Benchmark: CTerrainMap::GetHeights does not match CTerrainMap::GetHeight");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.IsPickingValid())
+	{
+		sys_err("Benchmark: Terrain picking does not find the hit testing every triangle finds");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.IsChunkRoundTripValid())
+	{
+		sys_err("Benchmark: A terrain chunk does not load back what was saved, or a chunk with bad section sizes was loaded");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.AreDrawCommandsValid())
+	{
+		sys_err("Benchmark: CTerrain::BuildPatchDrawCommands does not draw exactly the visible patches");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.AreWaterPlanesValid())
+	{
+		sys_err("Benchmark: CTerrainMap::PlanWaterPlanes does not give one pass per water height covering every water patch");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.ArePatchBoxesValid())
+	{
+		sys_err("Benchmark: CTerrain::CalculateTerrainPatch builds a patch box that misses a vertex or is not tight");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.IsStreamingValid())
+	{
+		sys_err("Benchmark: CTerrainMap::UpdateMap does not keep exactly the ring around the camera, builds a terrain twice or leaks one");
+		bChecksValid = false;
+	}
+
+	if (!terrainBenchmark.AreTerrainLoadsValid())
+	{
+		sys_err("Benchmark: The terrain loader publishes a failed or stale load, or leaks its terrain");
+		bChecksValid = false;
+	}
+
+	if (!physicsBenchmark.IsWithinTolerance())
+	{
+		sys_err("Benchmark: Integrated physics bodies differ from CPhysicsObject::Update by more than %g", BENCHMARK_PHYSICS_TOLERANCE);
+		bChecksValid = false;
+	}
+
+	if (!physicsBenchmark.IsInterpolationValid())
+	{
+		sys_err("Benchmark: Interpolated physics matrices do not turn the short way on wrapping angles");
+		bChecksValid = false;
+	}
+
+	if (!physicsBenchmark.IsDropValid())
+	{
+		sys_err("Benchmark: A box dropped through CPhysicsWorld::Update does not rest at the same place at every framerate");
+		bChecksValid = false;
+	}
+
+	return (bChecksValid ? EXIT_SUCCESS : EXIT_FAILURE);
+}
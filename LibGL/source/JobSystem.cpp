@@ -0,0 +1,417 @@
+#include "stdafx.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+thread_local GLint CJobSystem::ms_iThreadQueue = -1;
+thread_local const CJobSystem* CJobSystem::ms_pThreadOwner = nullptr;
+
+CJobSystem::CJobSystem(GLint iWorkerCount)
+{
+	m_MainThreadId = std::this_thread::get_id();
+	m_iQueuedJobs.store(0);
+	m_iWaiters.store(0);
+	m_bStop = false;
+	m_bShutdown.store(false);
+
+	if (iWorkerCount < 0)
+	{
+		const GLint iHardwareThreads = static_cast<GLint>(std::thread::hardware_concurrency());
+		iWorkerCount = std::max(iHardwareThreads - 1, 1);
+	}
+
+	iWorkerCount = std::min(iWorkerCount, JOB_MAX_WORKERS);
+
+	m_iQueueCount = iWorkerCount + 1;
+	m_pQueues = std::make_unique<TJobQueue[]>(m_iQueueCount);
+
+	m_vWorkers.reserve(iWorkerCount);
+	for (GLint i = 0; i < iWorkerCount; i++)
+	{
+		m_vWorkers.emplace_back(&CJobSystem::WorkerLoop, this, i);
+	}
+}
+
+CJobSystem::~CJobSystem()
+{
+	Shutdown();
+}
+
+/*
+ * Shutdown - Stops the workers without dropping any job.
+ *
+ * Workers leave once every queue is empty, so the jobs queued before the
+ * call and the ones they create still run. What the other threads queued
+ * meanwhile and the main thread jobs are then run by the calling thread,
+ * which should be the main thread. Jobs run after this are executed on
+ * the spot.
+ */
+void CJobSystem::Shutdown()
+{
+	if (m_bShutdown.exchange(true))
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStop = true;
+	}
+	m_WakeCond.notify_all();
+
+	for (std::thread& rWorker : m_vWorkers)
+	{
+		if (rWorker.joinable())
+		{
+			rWorker.join();
+		}
+	}
+	m_vWorkers.clear();
+
+	TJobHandle pJob;
+	while ((pJob = PopJob()) != nullptr)
+	{
+		Execute(pJob);
+	}
+
+	std::deque<TJobHandle> dqMainThreadJobs;
+	{
+		std::lock_guard<std::mutex> lock(m_MainThreadMutex);
+		dqMainThreadJobs.swap(m_dqMainThreadJobs);
+	}
+
+	for (const TJobHandle& pMainThreadJob : dqMainThreadJobs)
+	{
+		Execute(pMainThreadJob);
+	}
+}
+
+TJobHandle CJobSystem::CreateJob(const std::function<void()>& fnWork, const TJobHandle& pParent)
+{
+	TJobHandle pJob = std::make_shared<TJob>();
+	pJob->fnWork = fnWork;
+	pJob->iUnfinished.store(1);
+
+	if (pParent)
+	{
+		if (pParent->iUnfinished.fetch_add(1) == 0)
+		{
+			// A complete parent was already reported to its waiters
+			pParent->iUnfinished.fetch_sub(1);
+			sys_err("CJobSystem::CreateJob: Parent job is already complete");
+		}
+		else
+		{
+			pJob->pParent = pParent;
+		}
+	}
+
+	return (pJob);
+}
+
+void CJobSystem::Run(const TJobHandle& pJob)
+{
+	if (!pJob)
+	{
+		return;
+	}
+
+	if (m_bShutdown.load())
+	{
+		Execute(pJob);
+		return;
+	}
+
+	const GLint iQueue = (ms_pThreadOwner == this) ? ms_iThreadQueue : 0;
+
+	// Counted before it is pushed so the count never goes below the queued jobs
+	m_iQueuedJobs.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(m_pQueues[iQueue].Mutex);
+		m_pQueues[iQueue].dqJobs.push_back(pJob);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+	}
+	m_WakeCond.notify_one();
+}
+
+TJobHandle CJobSystem::Schedule(const std::function<void()>& fnWork, const TJobHandle& pParent)
+{
+	TJobHandle pJob = CreateJob(fnWork, pParent);
+	Run(pJob);
+	return (pJob);
+}
+
+/*
+ * Wait - Blocks until a job and its children completed.
+ * @pJob: Job waited on.
+ *
+ * The calling thread runs the queued jobs meanwhile. With none left it
+ * sleeps until a job is queued or one completes, then looks again. Main
+ * thread jobs are left to RunMainThreadJobs(). The first exception of the
+ * job tree is rethrown.
+ */
+void CJobSystem::Wait(const TJobHandle& pJob)
+{
+	if (!pJob)
+	{
+		return;
+	}
+
+	while (pJob->iUnfinished.load() > 0)
+	{
+		TJobHandle pNextJob = PopJob();
+		if (pNextJob)
+		{
+			Execute(pNextJob);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_iWaiters.fetch_add(1);
+		m_WakeCond.wait(lock, [this, &pJob]() { return (pJob->iUnfinished.load() == 0 || m_iQueuedJobs.load() > 0); });
+		m_iWaiters.fetch_sub(1);
+	}
+
+	if (pJob->pException)
+	{
+		std::rethrow_exception(pJob->pException);
+	}
+}
+
+bool CJobSystem::IsCompleted(const TJobHandle& pJob) const
+{
+	return (!pJob || pJob->iUnfinished.load() == 0);
+}
+
+/*
+ * ParallelFor - Splits an index range over the workers.
+ * @iBegin: First index.
+ * @iEnd: One past the last index.
+ * @iGrain: Indices per job, 0 or less gives four jobs per thread.
+ * @fnBody: Called with the range of one job, from any thread.
+ *
+ * Every chunk is a child of one root job the caller waits on, helping with
+ * the chunks meanwhile. A range of a single chunk runs on the caller. The
+ * first exception thrown by a chunk is rethrown once all chunks ran.
+ */
+void CJobSystem::ParallelFor(GLint iBegin, GLint iEnd, GLint iGrain, const std::function<void(GLint, GLint)>& fnBody)
+{
+	const GLint iCount = iEnd - iBegin;
+	if (iCount <= 0)
+	{
+		return;
+	}
+
+	if (iGrain <= 0)
+	{
+		const GLint iJobCount = m_iQueueCount * 4;
+		iGrain = (iCount + iJobCount - 1) / iJobCount;
+	}
+
+	if (iCount <= iGrain)
+	{
+		fnBody(iBegin, iEnd);
+		return;
+	}
+
+	TJobHandle pRoot = CreateJob(nullptr);
+
+	for (GLint iChunkBegin = iBegin; iChunkBegin < iEnd; iChunkBegin += iGrain)
+	{
+		const GLint iChunkEnd = std::min(iChunkBegin + iGrain, iEnd);
+		Run(CreateJob([&fnBody, iChunkBegin, iChunkEnd]() { fnBody(iChunkBegin, iChunkEnd); }, pRoot));
+	}
+
+	// The root has no work of its own, only its children keep it open now
+	Execute(pRoot);
+	Wait(pRoot);
+}
+
+TJobHandle CJobSystem::RunOnMainThread(const std::function<void()>& fnWork)
+{
+	TJobHandle pJob = CreateJob(fnWork);
+
+	if (m_bShutdown.load())
+	{
+		Execute(pJob);
+		return (pJob);
+	}
+
+	std::lock_guard<std::mutex> lock(m_MainThreadMutex);
+	m_dqMainThreadJobs.push_back(pJob);
+	return (pJob);
+}
+
+/*
+ * RunMainThreadJobs - Runs the jobs given to RunOnMainThread().
+ *
+ * Only the jobs queued before the call run, the ones they queue wait for
+ * the next call so a job queuing itself does not stall the frame.
+ */
+GLint CJobSystem::RunMainThreadJobs()
+{
+	if (!IsMainThread())
+	{
+		sys_err("CJobSystem::RunMainThreadJobs: Called outside of the main thread");
+		return (0);
+	}
+
+	std::deque<TJobHandle> dqJobs;
+	{
+		std::lock_guard<std::mutex> lock(m_MainThreadMutex);
+		dqJobs.swap(m_dqMainThreadJobs);
+	}
+
+	for (const TJobHandle& pJob : dqJobs)
+	{
+		Execute(pJob);
+	}
+
+	return (static_cast<GLint>(dqJobs.size()));
+}
+
+GLint CJobSystem::GetWorkerCount() const
+{
+	return (m_iQueueCount - 1);
+}
+
+bool CJobSystem::IsMainThread() const
+{
+	return (std::this_thread::get_id() == m_MainThreadId);
+}
+
+bool CJobSystem::IsJobThread() const
+{
+	return (ms_pThreadOwner == this || IsMainThread());
+}
+
+void CJobSystem::WorkerLoop(GLint iWorkerIndex)
+{
+	ms_pThreadOwner = this;
+	ms_iThreadQueue = iWorkerIndex + 1;
+
+	while (true)
+	{
+		TJobHandle pJob = PopJob();
+		if (pJob)
+		{
+			Execute(pJob);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_bStop && m_iQueuedJobs.load() == 0)
+		{
+			break;
+		}
+
+		m_WakeCond.wait(lock, [this]() { return (m_bStop || m_iQueuedJobs.load() > 0); });
+	}
+
+	ms_pThreadOwner = nullptr;
+	ms_iThreadQueue = -1;
+}
+
+// Newest job of the thread's own queue, else the oldest job of another queue
+TJobHandle CJobSystem::PopJob()
+{
+	if (m_iQueuedJobs.load() == 0)
+	{
+		return (nullptr);
+	}
+
+	const GLint iOwnQueue = (ms_pThreadOwner == this) ? ms_iThreadQueue : 0;
+
+	{
+		TJobQueue& rQueue = m_pQueues[iOwnQueue];
+		std::lock_guard<std::mutex> lock(rQueue.Mutex);
+
+		if (!rQueue.dqJobs.empty())
+		{
+			TJobHandle pJob = std::move(rQueue.dqJobs.back());
+			rQueue.dqJobs.pop_back();
+			m_iQueuedJobs.fetch_sub(1);
+			return (pJob);
+		}
+	}
+
+	for (GLint i = 1; i < m_iQueueCount; i++)
+	{
+		TJobQueue& rQueue = m_pQueues[(iOwnQueue + i) % m_iQueueCount];
+		std::lock_guard<std::mutex> lock(rQueue.Mutex);
+
+		if (!rQueue.dqJobs.empty())
+		{
+			TJobHandle pJob = std::move(rQueue.dqJobs.front());
+			rQueue.dqJobs.pop_front();
+			m_iQueuedJobs.fetch_sub(1);
+			return (pJob);
+		}
+	}
+
+	return (nullptr);
+}
+
+void CJobSystem::Execute(const TJobHandle& pJob)
+{
+	if (pJob->fnWork)
+	{
+		try
+		{
+			pJob->fnWork();
+		}
+		catch (...)
+		{
+			SetException(*pJob, std::current_exception());
+		}
+
+		// Releases what the work captured as soon as it ran
+		pJob->fnWork = nullptr;
+	}
+
+	Finish(pJob);
+}
+
+// Drops the job's own count, a job reaching 0 wakes the waiters, hands its exception to its parent and finishes it in turn
+void CJobSystem::Finish(const TJobHandle& pJob)
+{
+	if (pJob->iUnfinished.fetch_sub(1) != 1)
+	{
+		return;
+	}
+
+	// Taking the mutex orders the wake after a waiter that checked the job but is not asleep yet
+	if (m_iWaiters.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+		}
+		m_WakeCond.notify_all();
+	}
+
+	TJobHandle pParent = std::move(pJob->pParent);
+	if (!pParent)
+	{
+		return;
+	}
+
+	if (pJob->pException)
+	{
+		SetException(*pParent, pJob->pException);
+	}
+
+	Finish(pParent);
+}
+
+void CJobSystem::SetException(TJob& rJob, const std::exception_ptr& pException)
+{
+	std::lock_guard<std::mutex> lock(rJob.ExceptionMutex);
+
+	if (!rJob.pException)
+	{
+		rJob.pException = pException;
+	}
+}
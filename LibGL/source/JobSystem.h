@@ -0,0 +1,113 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "singleton.h"
+
+constexpr GLint JOB_MAX_WORKERS = 64;
+
+typedef struct SJob
+{
+	std::function<void()> fnWork;		// May be empty, the job then only waits for its children
+	std::shared_ptr<SJob> pParent;
+	std::atomic<GLint> iUnfinished;		// Own work plus unfinished children, 0 once complete
+	std::mutex ExceptionMutex;
+	std::exception_ptr pException;		// First failure of the job or of one of its children
+} TJob;
+
+typedef std::shared_ptr<TJob> TJobHandle;
+
+// Jobs of one thread, its owner pops the back and the other threads steal the front
+typedef struct SJobQueue
+{
+	std::mutex Mutex;
+	std::deque<TJobHandle> dqJobs;
+} TJobQueue;
+
+/**
+ * CJobSystem - Work-stealing thread pool.
+ *
+ * Every worker owns a queue, jobs run by a worker go to its own queue and
+ * jobs run by any other thread go to a shared one. An idle worker steals
+ * the oldest job of the other queues. A job created with a parent keeps
+ * that parent incomplete until it is complete itself, Wait() on the parent
+ * therefore waits for the whole tree. An exception thrown by a job is kept
+ * on it and on its parents and rethrown by Wait().
+ *
+ * A thread in Wait() runs queued jobs while there are some, so jobs may
+ * wait on other jobs and a system without worker still makes progress, and
+ * sleeps on the wake condition otherwise. Jobs given to RunOnMainThread()
+ * only run in RunMainThreadJobs(), called once per frame by CWindow::Update
+ * on the thread that created the system, never from Wait(). A job that is
+ * waited on must therefore not depend on one of them.
+ */
+class CJobSystem : public CSingleton<CJobSystem>
+{
+public:
+	// -1 uses one worker per hardware thread besides the calling one
+	CJobSystem(GLint iWorkerCount = -1);
+	~CJobSystem();
+
+	// Runs every pending job, including the main thread ones, then joins the workers
+	void Shutdown();
+
+	// Creates a job without queuing it, counted by pParent until it completes
+	TJobHandle CreateJob(const std::function<void()>& fnWork, const TJobHandle& pParent = TJobHandle());
+	// Queues a created job, runs it on the calling thread after Shutdown()
+	void Run(const TJobHandle& pJob);
+	TJobHandle Schedule(const std::function<void()>& fnWork, const TJobHandle& pParent = TJobHandle());
+
+	// Blocks until the job and its children completed, running pool jobs meanwhile, rethrows their first exception
+	void Wait(const TJobHandle& pJob);
+	bool IsCompleted(const TJobHandle& pJob) const;
+
+	// fnBody(iChunkBegin, iChunkEnd) over [iBegin, iEnd) in chunks of iGrain indices, returns once all ran
+	void ParallelFor(GLint iBegin, GLint iEnd, GLint iGrain, const std::function<void(GLint, GLint)>& fnBody);
+
+	TJobHandle RunOnMainThread(const std::function<void()>& fnWork);
+	// Main thread only, returns the number of jobs run
+	GLint RunMainThreadJobs();
+
+	GLint GetWorkerCount() const;
+	bool IsMainThread() const;
+	// Main thread or one of the workers, the threads whose jobs the pool expects
+	bool IsJobThread() const;
+
+protected:
+	void WorkerLoop(GLint iWorkerIndex);
+
+	TJobHandle PopJob();
+	void Execute(const TJobHandle& pJob);
+	void Finish(const TJobHandle& pJob);
+
+	static void SetException(TJob& rJob, const std::exception_ptr& pException);
+
+protected:
+	std::vector<std::thread> m_vWorkers;
+	// Queue 0 is shared by the threads that are not workers, worker N owns queue N + 1
+	std::unique_ptr<TJobQueue[]> m_pQueues;
+	GLint m_iQueueCount;
+
+	std::atomic<GLint> m_iQueuedJobs;
+	std::atomic<GLint> m_iWaiters;		// Threads asleep in Wait(), woken by Finish() when a job completes
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeCond;
+	bool m_bStop;
+	std::atomic<bool> m_bShutdown;
+
+	std::thread::id m_MainThreadId;
+	std::mutex m_MainThreadMutex;
+	std::deque<TJobHandle> m_dqMainThreadJobs;
+
+	// Queue of the current thread, -1 when it is not a worker of this system
+	static thread_local GLint ms_iThreadQueue;
+	static thread_local const CJobSystem* ms_pThreadOwner;
+};
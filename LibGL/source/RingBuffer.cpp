@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include "RingBuffer.h"
+
+CRingBuffer::CRingBuffer()
+{
+	m_uiBuffer = 0;
+	m_pMapped = nullptr;
+	m_lFrameSize = 0;
+	m_iFrame = 0;
+	m_lHead = 0;
+
+	for (GLint i = 0; i < RING_BUFFER_FRAMES; i++)
+	{
+		m_Fences[i] = nullptr;
+	}
+}
+
+CRingBuffer::~CRingBuffer()
+{
+	Destroy();
+}
+
+bool CRingBuffer::Create(GLsizeiptr lFrameSize)
+{
+	Destroy();
+
+	if (lFrameSize <= 0)
+	{
+		sys_err("CRingBuffer::Create: Invalid size %lld", static_cast<long long>(lFrameSize));
+		return (false);
+	}
+
+	glCreateBuffers(1, &m_uiBuffer);
+	if (!m_uiBuffer)
+	{
+		sys_err("CRingBuffer::Create: Failed to create buffer");
+		return (false);
+	}
+
+	const GLbitfield uiFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr lTotalSize = lFrameSize * RING_BUFFER_FRAMES;
+
+	glNamedBufferStorage(m_uiBuffer, lTotalSize, nullptr, uiFlags);
+	m_pMapped = static_cast<GLubyte*>(glMapNamedBufferRange(m_uiBuffer, 0, lTotalSize, uiFlags));
+
+	if (!m_pMapped)
+	{
+		sys_err("CRingBuffer::Create: Failed to map %lld bytes", static_cast<long long>(lTotalSize));
+		Destroy();
+		return (false);
+	}
+
+	m_lFrameSize = lFrameSize;
+	m_iFrame = 0;
+	m_lHead = 0;
+	return (true);
+}
+
+void CRingBuffer::Destroy()
+{
+	for (GLint i = 0; i < RING_BUFFER_FRAMES; i++)
+	{
+		if (m_Fences[i])
+		{
+			glDeleteSync(m_Fences[i]);
+			m_Fences[i] = nullptr;
+		}
+	}
+
+	if (m_uiBuffer)
+	{
+		if (m_pMapped)
+		{
+			glUnmapNamedBuffer(m_uiBuffer);
+		}
+
+		glDeleteBuffers(1, &m_uiBuffer);
+		m_uiBuffer = 0;
+	}
+
+	m_pMapped = nullptr;
+	m_lFrameSize = 0;
+	m_lHead = 0;
+}
+
+/*
+ * BeginFrame - Moves to the next region of the ring.
+ *
+ * Blocks until the GPU is done with the commands fenced the last time the
+ * region was used, RING_BUFFER_FRAMES frames ago. That is normally long
+ * finished, the wait only happens when the GPU falls behind.
+ */
+void CRingBuffer::BeginFrame()
+{
+	if (!m_pMapped)
+	{
+		return;
+	}
+
+	m_iFrame = (m_iFrame + 1) % RING_BUFFER_FRAMES;
+	m_lHead = 0;
+
+	GLsync& rFence = m_Fences[m_iFrame];
+	if (rFence)
+	{
+		GLbitfield uiWaitFlags = 0;
+		GLuint64 ulTimeout = 0;
+
+		while (true)
+		{
+			const GLenum eResult = glClientWaitSync(rFence, uiWaitFlags, ulTimeout);
+			if (eResult == GL_ALREADY_SIGNALED || eResult == GL_CONDITION_SATISFIED || eResult == GL_WAIT_FAILED)
+			{
+				break;
+			}
+
+			// Flush once so the fence is sure to reach the GPU, then wait for real
+			uiWaitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			ulTimeout = 1000000; // 1 ms
+		}
+
+		glDeleteSync(rFence);
+		rFence = nullptr;
+	}
+}
+
+void CRingBuffer::EndFrame()
+{
+	if (!m_pMapped || m_lHead == 0)
+	{
+		return;
+	}
+
+	m_Fences[m_iFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr CRingBuffer::Allocate(GLsizeiptr lSize, GLsizeiptr lAlignment, void** ppData)
+{
+	if (!m_pMapped || lSize <= 0)
+	{
+		return (-1);
+	}
+
+	const GLsizeiptr lStart = lAlignment > 1 ? (m_lHead + lAlignment - 1) / lAlignment * lAlignment : m_lHead;
+	if (lStart + lSize > m_lFrameSize)
+	{
+		return (-1);
+	}
+
+	m_lHead = lStart + lSize;
+
+	const GLintptr lOffset = m_iFrame * m_lFrameSize + lStart;
+	*ppData = m_pMapped + lOffset;
+	return (lOffset);
+}
+
+GLuint CRingBuffer::GetBuffer() const
+{
+	return (m_uiBuffer);
+}
+
+bool CRingBuffer::IsCreated() const
+{
+	return (m_pMapped != nullptr);
+}
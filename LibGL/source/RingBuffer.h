@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glad/glad.h>
+
+constexpr GLint RING_BUFFER_FRAMES = 3;	// Frames the GPU may still be reading when the CPU writes
+
+/**
+ * CRingBuffer - Persistently mapped buffer for per frame streaming.
+ *
+ * The storage is split in RING_BUFFER_FRAMES regions, one per frame in
+ * flight. BeginFrame() moves to the next region and waits on the fence
+ * placed by EndFrame() the last time that region was used, so the CPU
+ * never writes memory the GPU is still reading. Allocate() hands out
+ * ranges of the current region, written through the mapped pointer and
+ * consumed by copies or binds issued before EndFrame(). Nothing is
+ * carried over between frames.
+ */
+class CRingBuffer
+{
+public:
+	CRingBuffer();
+	~CRingBuffer();
+
+	bool Create(GLsizeiptr lFrameSize);
+	void Destroy();
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Offset of lSize bytes in the buffer, -1 if the region is full
+	GLintptr Allocate(GLsizeiptr lSize, GLsizeiptr lAlignment, void** ppData);
+
+	GLuint GetBuffer() const;
+	bool IsCreated() const;
+
+protected:
+	GLuint m_uiBuffer;
+	GLubyte* m_pMapped;
+	GLsizeiptr m_lFrameSize;
+
+	GLint m_iFrame;			// Region written this frame
+	GLsizeiptr m_lHead;		// Bytes used in the region
+	GLsync m_Fences[RING_BUFFER_FRAMES];
+};
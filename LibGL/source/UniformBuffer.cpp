@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "UniformBuffer.h"
+
+CUniformBuffer::CUniformBuffer()
+{
+	m_uiUBO = 0;
+	m_uiBinding = 0;
+	m_lSize = 0;
+}
+
+CUniformBuffer::~CUniformBuffer()
+{
+	Destroy();
+}
+
+bool CUniformBuffer::Create(GLsizeiptr lSize, GLuint uiBinding)
+{
+	Destroy();
+
+	if (lSize <= 0)
+	{
+		sys_err("CUniformBuffer::Create: Invalid size %lld", static_cast<long long>(lSize));
+		return (false);
+	}
+
+	glCreateBuffers(1, &m_uiUBO);
+	if (!m_uiUBO)
+	{
+		sys_err("CUniformBuffer::Create: Failed to create buffer (binding %u)", uiBinding);
+		return (false);
+	}
+
+	glNamedBufferStorage(m_uiUBO, lSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	m_uiBinding = uiBinding;
+	m_lSize = lSize;
+
+	Bind();
+	return (true);
+}
+
+void CUniformBuffer::Destroy()
+{
+	if (m_uiUBO)
+	{
+		glDeleteBuffers(1, &m_uiUBO);
+		m_uiUBO = 0;
+	}
+
+	m_lSize = 0;
+}
+
+void CUniformBuffer::Update(const void* pData, GLsizeiptr lSize)
+{
+	if (!m_uiUBO || lSize > m_lSize)
+	{
+		sys_err("CUniformBuffer::Update: Buffer %u too small (%lld > %lld)", m_uiUBO, static_cast<long long>(lSize), static_cast<long long>(m_lSize));
+		return;
+	}
+
+	glNamedBufferSubData(m_uiUBO, 0, lSize, pData);
+}
+
+void CUniformBuffer::Bind() const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, m_uiBinding, m_uiUBO);
+}
+
+GLuint CUniformBuffer::GetBuffer() const
+{
+	return (m_uiUBO);
+}
+
+GLuint CUniformBuffer::GetBinding() const
+{
+	return (m_uiBinding);
+}
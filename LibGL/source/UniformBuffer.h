@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include "../../LibMath/source/stdafx.h"
+
+/*
+ * Uniform block binding points, shared by every program that declares
+ * the block. Must match the layout(binding = N) of the GLSL declarations.
+ */
+enum EUniformBlockBindings
+{
+	UNIFORM_BLOCK_FRAME = 0,
+};
+
+/*
+ * TFrameUniforms - CPU mirror of the std140 "FrameUniforms" block.
+ *
+ * Declared as layout(std140, row_major, binding = 0) in the shaders, so
+ * CMatrix4Df is copied as is (row-major, no transpose). vec3 values are
+ * stored in vec4 slots, std140 pads them to 16 bytes anyway. Any change
+ * here must be reflected in every shader declaring the block.
+ */
+typedef struct SFrameUniforms
+{
+	CMatrix4Df mat4View;			// offset 0
+	CMatrix4Df mat4Projection;		// offset 64
+	CMatrix4Df mat4ViewProj;		// offset 128
+	CMatrix4Df mat4InvView;			// offset 192
+	CMatrix4Df mat4InvProjection;	// offset 256
+	SVector4Df v4CameraPos;			// offset 320, w unused
+	SVector4Df v4LightDir;			// offset 336, normalized, w unused
+	SVector4Df v4LightPos;			// offset 352, w unused
+	SVector4Df v4LightColor;		// offset 368, w unused
+	SVector4Df v4ClipPlane;			// offset 384, (0, 0, 0, 0) clips nothing
+	SVector2Df v2Resolution;		// offset 400
+	GLfloat fTime;					// offset 408
+	GLfloat fPadding;				// offset 412
+} TFrameUniforms;
+
+static_assert(sizeof(CMatrix4Df) == 64, "TFrameUniforms: CMatrix4Df must be 16 floats");
+static_assert(sizeof(SVector4Df) == 16, "TFrameUniforms: SVector4Df must be 4 floats");
+static_assert(sizeof(SVector2Df) == 8, "TFrameUniforms: SVector2Df must be 2 floats");
+static_assert(offsetof(TFrameUniforms, mat4View) == 0, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, mat4Projection) == 64, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, mat4ViewProj) == 128, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, mat4InvView) == 192, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, mat4InvProjection) == 256, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, v4CameraPos) == 320, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, v4LightDir) == 336, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, v4LightPos) == 352, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, v4LightColor) == 368, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, v4ClipPlane) == 384, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, v2Resolution) == 400, "TFrameUniforms: std140 offset mismatch");
+static_assert(offsetof(TFrameUniforms, fTime) == 408, "TFrameUniforms: std140 offset mismatch");
+static_assert(sizeof(TFrameUniforms) == 416, "TFrameUniforms: std140 size must be a multiple of 16");
+
+/**
+ * CUniformBuffer - Uniform buffer object bound to a fixed block binding.
+ *
+ * The storage is allocated once with a fixed size and rewritten whole by
+ * Update(). Binding is done once in Create(), programs pick the block up
+ * through their layout(binding = N) qualifier, no per program setup.
+ */
+class CUniformBuffer
+{
+public:
+	CUniformBuffer();
+	~CUniformBuffer();
+
+	bool Create(GLsizeiptr lSize, GLuint uiBinding);
+	void Destroy();
+
+	void Update(const void* pData, GLsizeiptr lSize);
+	void Bind() const;
+
+	GLuint GetBuffer() const;
+	GLuint GetBinding() const;
+
+protected:
+	GLuint m_uiUBO;
+	GLuint m_uiBinding;
+	GLsizeiptr m_lSize;
+};
@@ -532,7 +532,7 @@ void CCamera::UpdateBillBoardMatrix()
 	m_matBillBoard.mat4[3][2] = 0.0f;
 	m_matBillBoard.mat4[3][3] = 1.0f;
 
-	m_matViewInverse = GetViewMatrix().Inverse();
+	m_matViewInverse = GetViewMatrix().InverseAffine();
 }
 
 const float CCamera::GetSpeed() const
@@ -70,6 +70,7 @@ bool CShader::LinkPrograms()
 	if (CheckCompileErrors(GetID(), "program", ""))
 	{
 		m_bIsLinked = true;
+		CacheUniformLocations();
 		sys_log("CShader::LinkPrograms Program %s Linked Correctly", GetName().c_str());
 
 		while (!m_lShaders.empty())
@@ -212,6 +213,51 @@ void CShader::SetName(const std::string& stShaderProgramName)
 	m_stName = stShaderProgramName;
 }
 
+/**
+ * Fills the uniform location cache of the linked program.
+ *
+ * Queries every active uniform once (GL_ACTIVE_UNIFORMS). Uniforms living
+ * in a uniform block have no location and are skipped.
+ */
+void CShader::CacheUniformLocations()
+{
+	m_UniformCache.Clear();
+
+	const GLuint uiProgramID = GetID();
+	m_UniformCache.SetLookup([uiProgramID](const std::string& stName)
+	{
+		return (glGetUniformLocation(uiProgramID, stName.c_str()));
+	});
+
+	GLint iNumUniforms = 0;
+	GLint iMaxNameLength = 0;
+	glGetProgramiv(GetID(), GL_ACTIVE_UNIFORMS, &iNumUniforms);
+	glGetProgramiv(GetID(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &iMaxNameLength);
+
+	std::vector<GLchar> vName(static_cast<size_t>(iMaxNameLength) + 1);
+
+	for (GLint i = 0; i < iNumUniforms; i++)
+	{
+		GLsizei iLength = 0;
+		GLint iArraySize = 0;
+		GLenum eType = 0;
+		glGetActiveUniform(GetID(), static_cast<GLuint>(i), static_cast<GLsizei>(vName.size()), &iLength, &iArraySize, &eType, vName.data());
+
+		m_UniformCache.AddUniform(std::string(vName.data(), iLength), iArraySize);
+	}
+}
+
+/**
+ * Retrieves the location of a uniform from the cache.
+ *
+ * @param name: The name of the uniform variable in the shader.
+ * @return The location, -1 if the uniform is not active in the program.
+ */
+GLint CShader::GetUniformLocation(const std::string& name) const
+{
+	return (m_UniformCache.GetLocation(name));
+}
+
 /**
  * Sets a boolean uniform in the shader program.
  *
@@ -223,7 +269,7 @@ void CShader::SetName(const std::string& stShaderProgramName)
  */
 void CShader::setBool(const std::string& name, bool value) const
 {
-	GLuint iboolLoc = glGetUniformLocation(GetID(), name.c_str());
+	GLint iboolLoc = GetUniformLocation(name);
 	glUniform1i(iboolLoc, (GLuint) value);
 }
 
@@ -239,7 +285,7 @@ void CShader::setBool(const std::string& name, bool value) const
  */
 void CShader::setInt(const std::string& name, GLint value) const
 {
-	GLuint iIntLoc = glGetUniformLocation(GetID(), name.c_str());
+	GLint iIntLoc = GetUniformLocation(name);
 	glUniform1i(iIntLoc, value);
 }
 
@@ -257,7 +303,7 @@ void CShader::setInt(const std::string& name, GLint value) const
 void CShader::setIntArray(const std::string & name, int index, int value) const
 {
 	std::string fullName = name + "[" + std::to_string(index) + "]";
-	GLuint iIntLoc = glGetUniformLocation(GetID(), fullName.c_str());
+	GLint iIntLoc = GetUniformLocation(fullName);
 	glUniform1i(iIntLoc, value);
 }
 
@@ -274,7 +320,7 @@ void CShader::setIntArray(const std::string & name, int index, int value) const
  */
 void CShader::setFloat(const std::string& name, float value) const
 {
-	GLuint iFloatLoc = glGetUniformLocation(GetID(), name.c_str());
+	GLint iFloatLoc = GetUniformLocation(name);
 	glUniform1f(iFloatLoc, value);
 }
 
@@ -291,7 +337,7 @@ void CShader::setFloat(const std::string& name, float value) const
  */
 void CShader::set2Float(const std::string& name, float value1, float value2) const
 {
-	GLuint iFloatLoc = glGetUniformLocation(GetID(), name.c_str());
+	GLint iFloatLoc = GetUniformLocation(name);
 	glUniform2f(iFloatLoc, value1, value2);
 }
 
@@ -306,7 +352,7 @@ void CShader::set2Float(const std::string& name, float value1, float value2) con
  */
 void CShader::setVec2(const std::string& name, const glm::vec2& vec2) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform2fv(iVectorLocation, 1, glm::value_ptr(vec2));
 }
 
@@ -322,7 +368,7 @@ void CShader::setVec2(const std::string& name, const glm::vec2& vec2) const
  */
 void CShader::setVec2(const std::string& name, float x, float y) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform2f(iVectorLocation, x, y);
 }
 
@@ -337,7 +383,7 @@ void CShader::setVec2(const std::string& name, float x, float y) const
  */
 void CShader::setVec3(const std::string& name, const glm::vec3& vec3) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform3fv(iVectorLocation, 1, glm::value_ptr(vec3));
 }
 
@@ -354,7 +400,7 @@ void CShader::setVec3(const std::string& name, const glm::vec3& vec3) const
  */
 void CShader::setVec3(const std::string& name, float x, float y, float z) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform3f(iVectorLocation, x, y, z);
 }
 
@@ -369,8 +415,8 @@ void CShader::setVec3(const std::string& name, float x, float y, float z) const
  */
 void CShader::setVec4(const std::string& name, const glm::vec4& vec4) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
-	glUniform3fv(iVectorLocation, 1, glm::value_ptr(vec4));
+	GLint iVectorLocation = GetUniformLocation(name);
+	glUniform4fv(iVectorLocation, 1, glm::value_ptr(vec4));
 }
 
 /**
@@ -387,7 +433,7 @@ void CShader::setVec4(const std::string& name, const glm::vec4& vec4) const
  */
 void CShader::setVec4(const std::string& name, float x, float y, float z, float w) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform4f(iVectorLocation, x, y, z, w);
 }
 
@@ -402,7 +448,7 @@ void CShader::setVec4(const std::string& name, float x, float y, float z, float
  */
 void CShader::setMat2(const std::string& name, const glm::mat2& matrix) const
 {
-	GLuint iMatLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iMatLocation = GetUniformLocation(name);
 	glUniformMatrix2fv(iMatLocation, 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
@@ -417,7 +463,7 @@ void CShader::setMat2(const std::string& name, const glm::mat2& matrix) const
  */
 void CShader::setMat3(const std::string& name, const glm::mat3& matrix) const
 {
-	GLuint iMatLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iMatLocation = GetUniformLocation(name);
 	glUniformMatrix3fv(iMatLocation, 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
@@ -432,7 +478,7 @@ void CShader::setMat3(const std::string& name, const glm::mat3& matrix) const
  */
 void CShader::setMat4(const std::string& name, const glm::mat4& matrix) const
 {
-	GLuint iMatLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iMatLocation = GetUniformLocation(name);
 	glUniformMatrix4fv(iMatLocation, 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
@@ -449,7 +495,7 @@ void CShader::setMat4(const std::string& name, const glm::mat4& matrix) const
  */
 void CShader::setVec2(const std::string& name, const SVector2Df& vec2) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform2f(iVectorLocation, vec2.x, vec2.y);
 }
 
@@ -464,7 +510,7 @@ void CShader::setVec2(const std::string& name, const SVector2Df& vec2) const
  */
 void CShader::setVec3(const std::string& name, const SVector3Df& vec3) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform3f(iVectorLocation, vec3.x, vec3.y, vec3.z);
 }
 
@@ -479,7 +525,7 @@ void CShader::setVec3(const std::string& name, const SVector3Df& vec3) const
  */
 void CShader::setVec4(const std::string& name, const SVector4Df& vec4) const
 {
-	GLuint iVectorLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iVectorLocation = GetUniformLocation(name);
 	glUniform4f(iVectorLocation, vec4.x, vec4.y, vec4.z, vec4.w);
 }
 
@@ -495,7 +541,7 @@ void CShader::setVec4(const std::string& name, const SVector4Df& vec4) const
  */
 void CShader::setMat4(const std::string& name, const CMatrix4Df& matrix, bool bTranspose) const
 {
-	GLuint iMatrixLocation = glGetUniformLocation(GetID(), name.c_str());
+	GLint iMatrixLocation = GetUniformLocation(name);
 	glUniformMatrix4fv(iMatrixLocation, 1, bTranspose, (const GLfloat*)matrix.mat4);
 }
 
@@ -541,7 +587,7 @@ void CShader::setSampler3D(const std::string& name, GLuint iTexValue, GLint iTex
  */
 void CShader::setBindlessSampler2D(const std::string& name, GLuint64 value) const
 {
-	GLint iIntLoc = glGetUniformLocation(GetID(), name.c_str());
+	GLint iIntLoc = GetUniformLocation(name);
 
 	if (iIntLoc == -1)
 	{
@@ -551,3 +597,140 @@ void CShader::setBindlessSampler2D(const std::string& name, GLuint64 value) cons
 
 	glUniformHandleui64ARB(iIntLoc, value);
 }
+
+/* pre-resolved location overloads */
+
+void CShader::setBool(GLint iLocation, bool value) const
+{
+	glUniform1i(iLocation, (GLint)value);
+}
+
+void CShader::setInt(GLint iLocation, GLint value) const
+{
+	glUniform1i(iLocation, value);
+}
+
+void CShader::setFloat(GLint iLocation, float value) const
+{
+	glUniform1f(iLocation, value);
+}
+
+void CShader::setVec2(GLint iLocation, float x, float y) const
+{
+	glUniform2f(iLocation, x, y);
+}
+
+void CShader::setVec3(GLint iLocation, const SVector3Df& vec3) const
+{
+	glUniform3f(iLocation, vec3.x, vec3.y, vec3.z);
+}
+
+void CShader::setVec4(GLint iLocation, float x, float y, float z, float w) const
+{
+	glUniform4f(iLocation, x, y, z, w);
+}
+
+void CShader::setMat4(GLint iLocation, const CMatrix4Df& matrix, bool bTranspose) const
+{
+	glUniformMatrix4fv(iLocation, 1, bTranspose, (const GLfloat*)matrix.mat4);
+}
+
+void CShader::setBindlessSampler2D(GLint iLocation, GLuint64 value) const
+{
+	if (iLocation == -1)
+	{
+		return;
+	}
+
+	glUniformHandleui64ARB(iLocation, value);
+}
+
+/* CUniformLocationCache */
+
+CUniformLocationCache::CUniformLocationCache()
+{
+	m_uiLookupCount = 0;
+}
+
+void CUniformLocationCache::SetLookup(const std::function<GLint(const std::string&)>& fnLookup)
+{
+	m_fnLookup = fnLookup;
+}
+
+void CUniformLocationCache::Clear()
+{
+	m_mapLocations.clear();
+	m_uiLookupCount = 0;
+}
+
+/**
+ * Adds an active uniform to the table.
+ *
+ * @param stName: Name as reported by glGetActiveUniform, arrays end with "[0]".
+ * @param iArraySize: Number of elements, 1 for non arrays.
+ * @return false when the lookup gives no location (uniform block member), nothing is added.
+ */
+bool CUniformLocationCache::AddUniform(const std::string& stName, GLint iArraySize)
+{
+	if (!m_fnLookup)
+	{
+		return (false);
+	}
+
+	const GLint iLocation = m_fnLookup(stName);
+	m_uiLookupCount++;
+
+	if (iLocation == -1)
+	{
+		return (false);
+	}
+
+	const size_t sArraySuffix = stName.size() >= 3 ? stName.rfind("[0]") : std::string::npos;
+	if (sArraySuffix == std::string::npos || sArraySuffix != stName.size() - 3)
+	{
+		m_mapLocations[stName] = iLocation;
+		return (true);
+	}
+
+	// Elements of an array of basic types have consecutive locations
+	const std::string stBaseName = stName.substr(0, sArraySuffix);
+	m_mapLocations[stBaseName] = iLocation;
+
+	for (GLint i = 0; i < iArraySize; i++)
+	{
+		m_mapLocations[stBaseName + "[" + std::to_string(i) + "]"] = iLocation + i;
+	}
+
+	return (true);
+}
+
+GLint CUniformLocationCache::GetLocation(const std::string& stName) const
+{
+	auto it = m_mapLocations.find(stName);
+	if (it != m_mapLocations.end())
+	{
+		return (it->second);
+	}
+
+	if (!m_fnLookup)
+	{
+		return (-1);
+	}
+
+	// Kept even when -1, a uniform missing from the program is not asked for again
+	const GLint iLocation = m_fnLookup(stName);
+	m_uiLookupCount++;
+
+	m_mapLocations.emplace(stName, iLocation);
+	return (iLocation);
+}
+
+size_t CUniformLocationCache::GetSize() const
+{
+	return (m_mapLocations.size());
+}
+
+GLuint CUniformLocationCache::GetLookupCount() const
+{
+	return (m_uiLookupCount);
+}
@@ -4,9 +4,46 @@
 #include <string>
 #include "BaseShader.h"
 #include <list>
+#include <unordered_map>
+#include <functional>
 
 struct SShaderProgramDefinitions;
 
+/**
+ * CUniformLocationCache - Uniform name to location table of a program.
+ *
+ * Filled once after linking from the active uniform list, so setting a
+ * uniform is a hash lookup instead of a glGetUniformLocation call. Arrays
+ * are stored under their base name and under every "name[i]" element.
+ * Holds no GL state: locations come from the lookup function the owner
+ * sets (glGetUniformLocation for CShader), each name is looked up once and
+ * a miss is kept as -1 too.
+ */
+class CUniformLocationCache
+{
+public:
+	CUniformLocationCache();
+
+	void SetLookup(const std::function<GLint(const std::string&)>& fnLookup);
+	void Clear();
+
+	// Looks the uniform up, an array by its "name[0]" first element; false when it has no location
+	bool AddUniform(const std::string& stName, GLint iArraySize = 1);
+
+	// -1 when the uniform is unknown (inactive or optimized out), like GL
+	GLint GetLocation(const std::string& stName) const;
+	size_t GetSize() const;
+	// Calls made to the lookup function since the last Clear
+	GLuint GetLookupCount() const;
+
+protected:
+	std::function<GLint(const std::string&)> m_fnLookup;
+
+	// Names missing from the active list are looked up on their first use
+	mutable std::unordered_map<std::string, GLint> m_mapLocations;
+	mutable GLuint m_uiLookupCount;
+};
+
 class CShader
 {
 public:
@@ -34,6 +71,9 @@ public:
 	std::string GetName() const;
 	void SetName(const std::string& stShaderProgramName);
 
+	/* cached location, resolve once and use the location overloads on hot paths */
+	GLint GetUniformLocation(const std::string& name) const;
+
 	/* utility uniform functions */
 	void setBool(const std::string& name, bool value) const;
 	void setInt(const std::string& name, GLint value) const;
@@ -61,6 +101,19 @@ public:
 
 	void setBindlessSampler2D(const std::string& name, GLuint64 value) const;
 
+	/* pre-resolved location overloads, see GetUniformLocation */
+	void setBool(GLint iLocation, bool value) const;
+	void setInt(GLint iLocation, GLint value) const;
+	void setFloat(GLint iLocation, float value) const;
+	void setVec2(GLint iLocation, float x, float y) const;
+	void setVec3(GLint iLocation, const SVector3Df& vec3) const;
+	void setVec4(GLint iLocation, float x, float y, float z, float w) const;
+	void setMat4(GLint iLocation, const CMatrix4Df& matrix, bool bTranspose = GL_TRUE) const;
+	void setBindlessSampler2D(GLint iLocation, GLuint64 value) const;
+
+protected:
+	void CacheUniformLocations();
+
 protected:
 	/* the program ID */
 	GLuint m_uiID{0}; // Recommended: ensures m_uiID is always valid.;
@@ -70,4 +123,6 @@ protected:
 
 	bool m_bIsLinked;
 	bool m_bIsCompute;
+
+	CUniformLocationCache m_UniformCache;
 };
\ No newline at end of file
@@ -35,6 +35,12 @@ public:
 		assert(ms_pSingleton);
 		return (ms_pSingleton);
 	}
+
+	// For optional services, Instance() asserts when there is none
+	static bool HasInstance()
+	{
+		return (ms_pSingleton != nullptr);
+	}
 };
 
 template <typename T> T* CSingleton <T>::ms_pSingleton = nullptr;
\ No newline at end of file
@@ -50,6 +50,7 @@ CWindow::CWindow()
 #endif
 	m_pSkyBox = nullptr;
 	m_pScreenSpaceShader = nullptr;
+	m_FrameUniforms = TFrameUniforms();
 }
 
 CWindow::CWindow(const std::string& stTitle, const GLuint& width, const GLuint& height, const bool& bIsFullScreen)
@@ -73,6 +74,7 @@ CWindow::CWindow(const std::string& stTitle, const GLuint& width, const GLuint&
 
 	m_pSkyBox = nullptr;
 	m_pScreenSpaceShader = nullptr;
+	m_FrameUniforms = TFrameUniforms();
 
 	InitializeWindow(stTitle, width, height, bIsFullScreen);
 }
@@ -136,6 +138,11 @@ bool CWindow::InitializeWindow(const std::string& stTitle, const GLuint& width,
 	//glDebugMessageCallback(message_callback, nullptr);
 	glDebugMessageCallback(MyDebugCallback, nullptr);
 
+	if (!m_FrameUniformBuffer.Create(sizeof(TFrameUniforms), UNIFORM_BLOCK_FRAME))
+	{
+		glfwTerminate();
+		return (false);
+	}
 
 	m_bIsMouseFocusedIn = true;
 	m_bMouseState.at(0) = GLFW_RELEASE;
@@ -413,6 +420,7 @@ void CWindow::Destroy()
 	safe_delete(m_pScreen);
 	safe_delete(m_pTerrainManager);
 	safe_delete(m_pSkyBox);
+	m_FrameUniformBuffer.Destroy();
 
 	glfwDestroyWindow(m_pWindow);
 	glfwTerminate();
@@ -477,8 +485,50 @@ CFrameBuffer* CWindow::GetFrameBuffer()
 	return (m_pFrameBufObj);
 }
 
+/*
+ * UpdateFrameUniforms - Uploads the uniform block shared by the programs.
+ * @rCamera: Camera of the view about to be drawn.
+ * @v4ClipPlane: World space plane for gl_ClipDistance[0], zero to keep all.
+ *
+ * One 416 bytes upload per view replaces the camera, light and time
+ * uniforms each draw used to set. The light comes from the skybox, so it
+ * must have been updated for this frame already.
+ */
+void CWindow::UpdateFrameUniforms(const CCamera& rCamera, const SVector4Df& v4ClipPlane)
+{
+	const CMatrix4Df& mat4Projection = rCamera.GetProjectionMat();
+	const CMatrix4Df mat4View = rCamera.GetViewMatrix();
+
+	m_FrameUniforms.mat4View = mat4View;
+	m_FrameUniforms.mat4Projection = mat4Projection;
+	m_FrameUniforms.mat4ViewProj = rCamera.GetViewProjMatrix();
+	m_FrameUniforms.mat4InvView = mat4View.InverseAffine();
+	m_FrameUniforms.mat4InvProjection = mat4Projection.Inverse();
+	m_FrameUniforms.v4CameraPos = SVector4Df(rCamera.GetPosition(), 1.0f);
+
+	if (m_pSkyBox)
+	{
+		SVector3Df v3LightDir = m_pSkyBox->GetLightDir();
+		v3LightDir.normalize();
+
+		m_FrameUniforms.v4LightDir = SVector4Df(v3LightDir, 0.0f);
+		m_FrameUniforms.v4LightPos = SVector4Df(m_pSkyBox->GetLightPos(), 1.0f);
+		m_FrameUniforms.v4LightColor = SVector4Df(m_pSkyBox->GetLightColor(), 1.0f);
+	}
+
+	m_FrameUniforms.v4ClipPlane = v4ClipPlane;
+	m_FrameUniforms.v2Resolution = SVector2Df(static_cast<GLfloat>(GetWidth()), static_cast<GLfloat>(GetHeight()));
+	m_FrameUniforms.fTime = static_cast<GLfloat>(glfwGetTime());
+	m_FrameUniforms.fPadding = 0.0f;
+
+	m_FrameUniformBuffer.Update(&m_FrameUniforms, sizeof(TFrameUniforms));
+}
+
 void CWindow::Update(GLfloat fDeltaTime)
 {
+	// Work handed back to the GL thread by the jobs of the last frame
+	job_system.RunMainThreadJobs();
+
 	m_pFrameBufObj->BindForWriting();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	//glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -514,7 +564,13 @@ void CWindow::Update(GLfloat fDeltaTime)
 
 	if (m_pTerrainManager->IsMapReady())
 	{
-	//	m_pTerrainManager->Update();
+		m_pTerrainManager->UpdateMap(CCameraManager::Instance().GetCurrentCamera()->GetPosition());
+
+		// Fixed step simulation, once per frame whatever the object count
+		CPhysicsWorld::Instance().Update(fDeltaTime);
+
+		// Main view, the terrain map rebinds it after its water passes
+		UpdateFrameUniforms(CCameraManager::Instance().GetCurrentCameraRef());
 		m_pSkyBox->Render();
 
 		m_pScreen->Update();
@@ -5,6 +5,8 @@
 #include <string>
 #include "Camera.h"
 #include "FrameBuffer.h"
+#include "UniformBuffer.h"
+#include "JobSystem.h"
 #include "../../LibGame/source/ResourcesManager.h"
 #include "../../LibGame/source/PhysicsWorld.h"
 
@@ -48,6 +50,10 @@ public:
 	void SetFrameBuffer(CFrameBuffer* pFBO);
 	CFrameBuffer* GetFrameBuffer();
 
+	// Rewrites the per-view uniform block, call before drawing each view
+	void UpdateFrameUniforms(const CCamera& rCamera, const SVector4Df& v4ClipPlane = SVector4Df(0.0f, 0.0f, 0.0f, 0.0f));
+	const TFrameUniforms& GetFrameUniforms() const { return m_FrameUniforms; }
+
 	CScreen* GetScreen() { return m_pScreen; }
 
 	void Update(GLfloat fDeltaTime = 0.0f);
@@ -74,6 +80,7 @@ protected:
 	static GLuint m_uiRandSeed;
 
 public: // Singleton Classes
+	CJobSystem job_system;		// Declared first, outlives the other members
 	CCameraManager camera_manager;
 	CResourcesManager resources_manager;
 	CPhysicsWorld physics_world;
@@ -92,6 +99,8 @@ private:
 	GLfloat m_fBrushInterval;	// Time interval in seconds for brush application
 	GLfloat m_fBrushTimer;		// Timer to track elapsed time
 	CFrameBuffer* m_pFrameBufObj;
+	CUniformBuffer m_FrameUniformBuffer;
+	TFrameUniforms m_FrameUniforms;
 	CScreen* m_pScreen;
 	static CTerrainManager* m_pTerrainManager;
 	CSkyBox *m_pSkyBox;
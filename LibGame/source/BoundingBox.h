@@ -176,6 +176,29 @@ typedef struct SBoundingBox
 			(v3Min.z <= other.v3Max.z && v3Max.z >= other.v3Min.z);
 	}
 
+	// Slab test of the ray v3Origin + t * dir against a box, v3InvDir is 1 / dir. *pfT is the entry t, negative when the origin is inside
+	static bool IntersectRay(const SVector3Df& v3Origin, const SVector3Df& v3InvDir, const SVector3Df& v3BoxMin, const SVector3Df& v3BoxMax, GLfloat* pfT)
+	{
+		const GLfloat fT1 = (v3BoxMin.x - v3Origin.x) * v3InvDir.x;
+		const GLfloat fT2 = (v3BoxMax.x - v3Origin.x) * v3InvDir.x;
+		const GLfloat fT3 = (v3BoxMin.y - v3Origin.y) * v3InvDir.y;
+		const GLfloat fT4 = (v3BoxMax.y - v3Origin.y) * v3InvDir.y;
+		const GLfloat fT5 = (v3BoxMin.z - v3Origin.z) * v3InvDir.z;
+		const GLfloat fT6 = (v3BoxMax.z - v3Origin.z) * v3InvDir.z;
+
+		const GLfloat fTMin = std::max(std::max(std::min(fT1, fT2), std::min(fT3, fT4)), std::min(fT5, fT6));
+		const GLfloat fTMax = std::min(std::min(std::max(fT1, fT2), std::max(fT3, fT4)), std::max(fT5, fT6));
+
+		// Behind the origin, or missed
+		if (fTMax < 0.0f || fTMin > fTMax)
+		{
+			return (false);
+		}
+
+		*pfT = fTMin;
+		return (true);
+	}
+
 	void Draw(bool hIsSelectedObject)
 	{
 		if (hIsSelectedObject)
@@ -0,0 +1,634 @@
+#include "Stdafx.h"
+#include "BoundingVolumeHierarchy.h"
+#include "BoundingBox.h"
+#include "../../LibMath/source/ray.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cfloat>
+
+CBoundingVolumeHierarchy::CBoundingVolumeHierarchy()
+{
+	m_iDepth = 0;
+	m_dBuildCost = 0.0;
+	m_dCost = 0.0;
+	m_bRefitPending = false;
+}
+
+void CBoundingVolumeHierarchy::Clear()
+{
+	m_vNodes.clear();
+	m_vItems.clear();
+	m_vBoxes.clear();
+	m_vCentroids.clear();
+
+	m_iDepth = 0;
+	m_dBuildCost = 0.0;
+	m_dCost = 0.0;
+	m_bRefitPending = false;
+}
+
+void CBoundingVolumeHierarchy::Build(const TCullBox* pBoxes, GLuint uiCount)
+{
+	m_vBoxes.assign(pBoxes, pBoxes + uiCount);
+	BuildTree();
+}
+
+void CBoundingVolumeHierarchy::SetItemBox(GLuint uiItem, const TCullBox& box)
+{
+	assert(uiItem < m_vBoxes.size());
+	m_vBoxes[uiItem] = box;
+	m_bRefitPending = true;
+}
+
+const TCullBox& CBoundingVolumeHierarchy::GetItemBox(GLuint uiItem) const
+{
+	return (m_vBoxes[uiItem]);
+}
+
+GLuint CBoundingVolumeHierarchy::GetItemsCount() const
+{
+	return (static_cast<GLuint>(m_vBoxes.size()));
+}
+
+GLuint CBoundingVolumeHierarchy::GetNodesCount() const
+{
+	return (static_cast<GLuint>(m_vNodes.size()));
+}
+
+GLint CBoundingVolumeHierarchy::GetDepth() const
+{
+	return (m_iDepth);
+}
+
+double CBoundingVolumeHierarchy::GetSAHCost() const
+{
+	return (m_dCost);
+}
+
+// One bin per item below BVH_SAH_BINS, the sweeps over the bins would cost more than the items
+GLint CBoundingVolumeHierarchy::GetBinsCount(GLuint uiCount)
+{
+	return (static_cast<GLint>(std::min<GLuint>(uiCount, BVH_SAH_BINS)));
+}
+
+GLint CBoundingVolumeHierarchy::GetBin(GLfloat fCentroid, GLfloat fMin, GLfloat fScale, GLint iBins)
+{
+	// Clamped as a float, a centroid spread of a few ulps gives a huge scale
+	return (static_cast<GLint>(MyMath::fminmax(0.0f, (fCentroid - fMin) * fScale, static_cast<GLfloat>(iBins - 1))));
+}
+
+// Bins per unit of centroid spread on each axis, 0 where the centroids are all equal
+SVector3Df CBoundingVolumeHierarchy::GetBinScale(const TCullBox& centroidBox, GLint iBins)
+{
+	const SVector3Df v3Extent = centroidBox.v3Max - centroidBox.v3Min;
+	const GLfloat fBins = static_cast<GLfloat>(iBins);
+
+	return (SVector3Df(
+		v3Extent.x > 0.0f ? MyMath::fmin(fBins / v3Extent.x, FLT_MAX) : 0.0f,
+		v3Extent.y > 0.0f ? MyMath::fmin(fBins / v3Extent.y, FLT_MAX) : 0.0f,
+		v3Extent.z > 0.0f ? MyMath::fmin(fBins / v3Extent.z, FLT_MAX) : 0.0f));
+}
+
+// In doubles, a box spanning -FLT_MAX..FLT_MAX would overflow a float
+double CBoundingVolumeHierarchy::GetSurfaceArea(const SVector3Df& v3Min, const SVector3Df& v3Max)
+{
+	const double dX = static_cast<double>(v3Max.x) - static_cast<double>(v3Min.x);
+	const double dY = static_cast<double>(v3Max.y) - static_cast<double>(v3Min.y);
+	const double dZ = static_cast<double>(v3Max.z) - static_cast<double>(v3Min.z);
+
+	if (dX < 0.0 || dY < 0.0 || dZ < 0.0)
+	{
+		return (0.0);
+	}
+
+	return (2.0 * (dX * dY + dY * dZ + dZ * dX));
+}
+
+void CBoundingVolumeHierarchy::ExpandBox(TCullBox& rBox, const SVector3Df& v3Min, const SVector3Df& v3Max)
+{
+	rBox.v3Min.x = MyMath::fmin(rBox.v3Min.x, v3Min.x);
+	rBox.v3Min.y = MyMath::fmin(rBox.v3Min.y, v3Min.y);
+	rBox.v3Min.z = MyMath::fmin(rBox.v3Min.z, v3Min.z);
+	rBox.v3Max.x = MyMath::fmax(rBox.v3Max.x, v3Max.x);
+	rBox.v3Max.y = MyMath::fmax(rBox.v3Max.y, v3Max.y);
+	rBox.v3Max.z = MyMath::fmax(rBox.v3Max.z, v3Max.z);
+}
+
+void CBoundingVolumeHierarchy::ResetBin(TBVHBin& rBin)
+{
+	for (GLint iAxis = 0; iAxis < 3; iAxis++)
+	{
+		rBin.fMin[iAxis] = FLT_MAX;
+		rBin.fMax[iAxis] = -FLT_MAX;
+	}
+
+	rBin.uiCount = 0;
+}
+
+void CBoundingVolumeHierarchy::ExpandBin(TBVHBin& rBin, const TBVHBin& other)
+{
+	for (GLint iAxis = 0; iAxis < 3; iAxis++)
+	{
+		rBin.fMin[iAxis] = MyMath::fmin(rBin.fMin[iAxis], other.fMin[iAxis]);
+		rBin.fMax[iAxis] = MyMath::fmax(rBin.fMax[iAxis], other.fMax[iAxis]);
+	}
+
+	rBin.uiCount += other.uiCount;
+}
+
+double CBoundingVolumeHierarchy::GetBinArea(const TBVHBin& bin)
+{
+	if (bin.uiCount == 0)
+	{
+		return (0.0);
+	}
+
+	const double dX = static_cast<double>(bin.fMax[0]) - static_cast<double>(bin.fMin[0]);
+	const double dY = static_cast<double>(bin.fMax[1]) - static_cast<double>(bin.fMin[1]);
+	const double dZ = static_cast<double>(bin.fMax[2]) - static_cast<double>(bin.fMin[2]);
+
+	return (2.0 * (dX * dY + dY * dZ + dZ * dX));
+}
+
+void CBoundingVolumeHierarchy::BuildTree()
+{
+	const GLuint uiCount = GetItemsCount();
+
+	m_vNodes.clear();
+	m_vItems.resize(uiCount);
+	std::iota(m_vItems.begin(), m_vItems.end(), 0);
+
+	// Halved before the sum like SFrustumCulling::IsCullBoxInside, so unbounded boxes stay finite
+	m_vCentroids.resize(uiCount);
+	for (GLuint i = 0; i < uiCount; i++)
+	{
+		m_vCentroids[i] = m_vBoxes[i].v3Max * 0.5f + m_vBoxes[i].v3Min * 0.5f;
+	}
+
+	m_iDepth = 0;
+	m_bRefitPending = false;
+
+	if (uiCount == 0)
+	{
+		m_dBuildCost = m_dCost = 0.0;
+		return;
+	}
+
+	// A binary tree with one item per leaf at worst, BuildNode keeps indices into it
+	m_vNodes.reserve(2 * static_cast<size_t>(uiCount) - 1);
+	m_vNodes.push_back(TBVHNode());
+	BuildNode(0, 0, uiCount, 0);
+
+	m_dBuildCost = m_dCost = ComputeSAHCost();
+}
+
+/*
+ * FindSAHSplit - Cheapest bin border of a node.
+ * @uiFirst, @uiCount: Run of m_vItems owned by the node.
+ * @node: The node, its bounds are set.
+ * @centroidBox: Bounds of the centroids of the run.
+ * @piAxis, @piBin: Receive the axis and the last bin of the left side.
+ * @pdCost: Receives the cost, 1 for the node plus the area weighted item counts of both sides.
+ *
+ * The three axes are binned in the same pass over the items. Only the
+ * axes where the centroids are spread are tried, false when none is.
+ */
+bool CBoundingVolumeHierarchy::FindSAHSplit(GLuint uiFirst, GLuint uiCount, const TBVHNode& node, const TCullBox& centroidBox, GLint* piAxis, GLint* piBin, double* pdCost) const
+{
+	const double dNodeArea = GetSurfaceArea(node.v3Min, node.v3Max);
+	const GLint iBins = GetBinsCount(uiCount);
+	const SVector3Df v3Scale = GetBinScale(centroidBox, iBins);
+	const GLfloat fCentroidMin[3] = { centroidBox.v3Min.x, centroidBox.v3Min.y, centroidBox.v3Min.z };
+	const GLfloat fScale[3] = { v3Scale.x, v3Scale.y, v3Scale.z };
+
+	TBVHBin bins[3][BVH_SAH_BINS];
+	for (TBVHBin (&axisBins)[BVH_SAH_BINS] : bins)
+	{
+		for (GLint iBin = 0; iBin < iBins; iBin++)
+		{
+			ResetBin(axisBins[iBin]);
+		}
+	}
+
+	for (GLuint i = uiFirst; i < uiFirst + uiCount; i++)
+	{
+		const GLuint uiItem = m_vItems[i];
+		const SVector3Df& v3Centroid = m_vCentroids[uiItem];
+		const TCullBox& box = m_vBoxes[uiItem];
+
+		const GLfloat fCentroid[3] = { v3Centroid.x, v3Centroid.y, v3Centroid.z };
+		TBVHBin itemBin = { { box.v3Min.x, box.v3Min.y, box.v3Min.z }, { box.v3Max.x, box.v3Max.y, box.v3Max.z }, 1 };
+
+		for (GLint iAxis = 0; iAxis < 3; iAxis++)
+		{
+			ExpandBin(bins[iAxis][GetBin(fCentroid[iAxis], fCentroidMin[iAxis], fScale[iAxis], iBins)], itemBin);
+		}
+	}
+
+	bool bFound = false;
+	*pdCost = DBL_MAX;
+
+	for (GLint iAxis = 0; iAxis < 3; iAxis++)
+	{
+		if (!(fScale[iAxis] > 0.0f))
+		{
+			continue;
+		}
+
+		const TBVHBin* pBins = bins[iAxis];
+
+		// Right side areas and counts of the split after each bin, swept from the last bin
+		double dRightAreas[BVH_SAH_BINS];
+		GLuint uiRightCounts[BVH_SAH_BINS];
+		TBVHBin rightBin;
+		ResetBin(rightBin);
+
+		for (GLint iBin = iBins - 1; iBin > 0; iBin--)
+		{
+			ExpandBin(rightBin, pBins[iBin]);
+			dRightAreas[iBin - 1] = GetBinArea(rightBin);
+			uiRightCounts[iBin - 1] = rightBin.uiCount;
+		}
+
+		TBVHBin leftBin;
+		ResetBin(leftBin);
+
+		for (GLint iBin = 0; iBin < iBins - 1; iBin++)
+		{
+			ExpandBin(leftBin, pBins[iBin]);
+
+			if (leftBin.uiCount == 0 || uiRightCounts[iBin] == 0)
+			{
+				continue;
+			}
+
+			const double dSides = GetBinArea(leftBin) * leftBin.uiCount + dRightAreas[iBin] * uiRightCounts[iBin];
+			const double dCost = 1.0 + (dNodeArea > 0.0 ? dSides / dNodeArea : 0.0);
+
+			if (dCost < *pdCost)
+			{
+				*pdCost = dCost;
+				*piAxis = iAxis;
+				*piBin = iBin;
+				bFound = true;
+			}
+		}
+	}
+
+	return (bFound);
+}
+
+// Items whose centroid falls in the bins up to iBin go first, returns how many
+GLuint CBoundingVolumeHierarchy::PartitionItems(GLuint uiFirst, GLuint uiCount, GLint iAxis, GLint iBin, const TCullBox& centroidBox)
+{
+	const GLfloat fMin = centroidBox.v3Min[iAxis];
+	const GLint iBins = GetBinsCount(uiCount);
+	const GLfloat fScale = GetBinScale(centroidBox, iBins)[iAxis];
+
+	auto itBegin = m_vItems.begin() + uiFirst;
+	auto itMiddle = std::partition(itBegin, itBegin + uiCount, [this, iAxis, iBin, fMin, fScale, iBins](GLuint uiItem)
+	{
+		return (GetBin(m_vCentroids[uiItem][iAxis], fMin, fScale, iBins) <= iBin);
+	});
+
+	return (static_cast<GLuint>(itMiddle - itBegin));
+}
+
+/*
+ * BuildNode - Bounds of a node, then its split.
+ * @uiNode: Node to fill, already allocated.
+ * @uiFirst, @uiCount: Run of m_vItems it owns.
+ * @iDepth: 0 for the root.
+ *
+ * The node stays a leaf when the SAH finds no cheaper split and it holds
+ * at most BVH_MAX_LEAF_ITEMS items. A run the bins cannot separate, such
+ * as items sharing their centroid, is cut in halves along the widest axis
+ * of the centroids.
+ */
+void CBoundingVolumeHierarchy::BuildNode(GLuint uiNode, GLuint uiFirst, GLuint uiCount, GLint iDepth)
+{
+	TCullBox nodeBox(SVector3Df(FLT_MAX, FLT_MAX, FLT_MAX), SVector3Df(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	TCullBox centroidBox = nodeBox;
+
+	for (GLuint i = uiFirst; i < uiFirst + uiCount; i++)
+	{
+		const GLuint uiItem = m_vItems[i];
+		ExpandBox(nodeBox, m_vBoxes[uiItem].v3Min, m_vBoxes[uiItem].v3Max);
+		ExpandBox(centroidBox, m_vCentroids[uiItem], m_vCentroids[uiItem]);
+	}
+
+	m_vNodes[uiNode].v3Min = nodeBox.v3Min;
+	m_vNodes[uiNode].v3Max = nodeBox.v3Max;
+	m_vNodes[uiNode].uiFirst = uiFirst;
+	m_vNodes[uiNode].uiCount = uiCount;
+	m_iDepth = std::max(m_iDepth, iDepth);
+
+	if (uiCount == 1 || iDepth >= BVH_MAX_DEPTH)
+	{
+		return;
+	}
+
+	GLint iAxis = 0;
+	GLint iBin = 0;
+	double dCost = 0.0;
+	const bool bSplit = FindSAHSplit(uiFirst, uiCount, m_vNodes[uiNode], centroidBox, &iAxis, &iBin, &dCost);
+
+	// A leaf costs one test per item
+	if (uiCount <= BVH_MAX_LEAF_ITEMS && (!bSplit || dCost >= static_cast<double>(uiCount)))
+	{
+		return;
+	}
+
+	GLuint uiLeftCount = bSplit ? PartitionItems(uiFirst, uiCount, iAxis, iBin, centroidBox) : 0;
+
+	if (uiLeftCount == 0 || uiLeftCount == uiCount)
+	{
+		const SVector3Df v3Spread = centroidBox.v3Max - centroidBox.v3Min;
+		iAxis = (v3Spread.x >= v3Spread.y && v3Spread.x >= v3Spread.z) ? 0 : (v3Spread.y >= v3Spread.z ? 1 : 2);
+		uiLeftCount = uiCount / 2;
+
+		auto itBegin = m_vItems.begin() + uiFirst;
+		std::nth_element(itBegin, itBegin + uiLeftCount, itBegin + uiCount, [this, iAxis](GLuint uiItemA, GLuint uiItemB)
+		{
+			return (m_vCentroids[uiItemA][iAxis] < m_vCentroids[uiItemB][iAxis]);
+		});
+	}
+
+	const GLuint uiLeft = static_cast<GLuint>(m_vNodes.size());
+	m_vNodes.push_back(TBVHNode());
+	m_vNodes.push_back(TBVHNode());
+
+	m_vNodes[uiNode].uiFirst = uiLeft;
+	m_vNodes[uiNode].uiCount = 0;
+
+	BuildNode(uiLeft, uiFirst, uiLeftCount, iDepth + 1);
+	BuildNode(uiLeft + 1, uiFirst + uiLeftCount, uiCount - uiLeftCount, iDepth + 1);
+}
+
+// Sum over the nodes of their area relative to the root, times their items for the leaves
+double CBoundingVolumeHierarchy::ComputeSAHCost() const
+{
+	if (m_vNodes.empty())
+	{
+		return (0.0);
+	}
+
+	const double dRootArea = GetSurfaceArea(m_vNodes[0].v3Min, m_vNodes[0].v3Max);
+	if (dRootArea <= 0.0)
+	{
+		return (0.0);
+	}
+
+	double dCost = 0.0;
+	for (const TBVHNode& node : m_vNodes)
+	{
+		const double dWeight = node.uiCount > 0 ? static_cast<double>(node.uiCount) : 1.0;
+		dCost += GetSurfaceArea(node.v3Min, node.v3Max) * dWeight;
+	}
+
+	return (dCost / dRootArea);
+}
+
+/*
+ * Refit - Brings the node bounds back around the moved items.
+ *
+ * Children always come after their parent, so one backward pass over the
+ * nodes is enough. Items moved far from their neighbours leave large,
+ * overlapping nodes behind; once the SAH cost exceeds
+ * BVH_REBUILD_COST_RATIO times the cost of the last build the tree is
+ * built again.
+ */
+bool CBoundingVolumeHierarchy::Refit()
+{
+	if (!m_bRefitPending)
+	{
+		return (false);
+	}
+
+	m_bRefitPending = false;
+
+	for (size_t i = m_vNodes.size(); i-- > 0;)
+	{
+		TBVHNode& node = m_vNodes[i];
+		TCullBox nodeBox(SVector3Df(FLT_MAX, FLT_MAX, FLT_MAX), SVector3Df(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+
+		if (node.uiCount > 0)
+		{
+			for (GLuint j = node.uiFirst; j < node.uiFirst + node.uiCount; j++)
+			{
+				ExpandBox(nodeBox, m_vBoxes[m_vItems[j]].v3Min, m_vBoxes[m_vItems[j]].v3Max);
+			}
+		}
+		else
+		{
+			ExpandBox(nodeBox, m_vNodes[node.uiFirst].v3Min, m_vNodes[node.uiFirst].v3Max);
+			ExpandBox(nodeBox, m_vNodes[node.uiFirst + 1].v3Min, m_vNodes[node.uiFirst + 1].v3Max);
+		}
+
+		node.v3Min = nodeBox.v3Min;
+		node.v3Max = nodeBox.v3Max;
+	}
+
+	m_dCost = ComputeSAHCost();
+
+	if (m_dCost > m_dBuildCost * static_cast<double>(BVH_REBUILD_COST_RATIO))
+	{
+		BuildTree();
+		return (true);
+	}
+
+	return (false);
+}
+
+/*
+ * Raycast - Closest item the ray enters within its range.
+ * @ray: World ray.
+ * @pfDistance: Receives the ray parameter of the hit, FLT_MAX when none.
+ * @fnAccept: Items it returns false for are not hit, every item when empty.
+ *
+ * Nearest child first. A node is entered no later than the items inside
+ * it (its bounds are theirs, the slab test is monotonic), so nodes entered
+ * after the closest hit so far are skipped without missing a closer item.
+ */
+GLint CBoundingVolumeHierarchy::Raycast(const CRay& ray, GLfloat* pfDistance, const std::function<bool(GLuint)>& fnAccept) const
+{
+	*pfDistance = FLT_MAX;
+
+	if (m_vNodes.empty())
+	{
+		return (-1);
+	}
+
+	const SVector3Df& v3Origin = ray.GetOrigin();
+	const SVector3Df v3InvDir = ray.GetInverseDirection();
+	const GLfloat fRange = ray.GetRayRange();
+
+	GLint iClosestItem = -1;
+	GLfloat fClosestT = FLT_MAX;
+	GLfloat fT = 0.0f;
+
+	if (!SBoundingBox::IntersectRay(v3Origin, v3InvDir, m_vNodes[0].v3Min, m_vNodes[0].v3Max, &fT) || fT > fRange)
+	{
+		return (-1);
+	}
+
+	TBVHRayEntry stack[BVH_STACK_SIZE];
+	GLint iStackSize = 0;
+	stack[iStackSize++] = { 0, fT };
+
+	while (iStackSize > 0)
+	{
+		const TBVHRayEntry entry = stack[--iStackSize];
+		if (entry.fT >= fClosestT)
+		{
+			continue;
+		}
+
+		const TBVHNode& node = m_vNodes[entry.uiNode];
+
+		if (node.uiCount > 0)
+		{
+			for (GLuint i = node.uiFirst; i < node.uiFirst + node.uiCount; i++)
+			{
+				const GLuint uiItem = m_vItems[i];
+				const TCullBox& box = m_vBoxes[uiItem];
+
+				if (SBoundingBox::IntersectRay(v3Origin, v3InvDir, box.v3Min, box.v3Max, &fT) && fT <= fRange && fT < fClosestT &&
+					(!fnAccept || fnAccept(uiItem)))
+				{
+					fClosestT = fT;
+					iClosestItem = static_cast<GLint>(uiItem);
+				}
+			}
+			continue;
+		}
+
+		GLfloat fLeftT = 0.0f;
+		GLfloat fRightT = 0.0f;
+		const TBVHNode& left = m_vNodes[node.uiFirst];
+		const TBVHNode& right = m_vNodes[node.uiFirst + 1];
+
+		const bool bLeft = SBoundingBox::IntersectRay(v3Origin, v3InvDir, left.v3Min, left.v3Max, &fLeftT) && fLeftT <= fRange && fLeftT < fClosestT;
+		const bool bRight = SBoundingBox::IntersectRay(v3Origin, v3InvDir, right.v3Min, right.v3Max, &fRightT) && fRightT <= fRange && fRightT < fClosestT;
+
+		// The far child goes on the stack first, the near one is popped next
+		if (bLeft && bRight)
+		{
+			if (fLeftT <= fRightT)
+			{
+				stack[iStackSize++] = { node.uiFirst + 1, fRightT };
+				stack[iStackSize++] = { node.uiFirst, fLeftT };
+			}
+			else
+			{
+				stack[iStackSize++] = { node.uiFirst, fLeftT };
+				stack[iStackSize++] = { node.uiFirst + 1, fRightT };
+			}
+		}
+		else if (bLeft)
+		{
+			stack[iStackSize++] = { node.uiFirst, fLeftT };
+		}
+		else if (bRight)
+		{
+			stack[iStackSize++] = { node.uiFirst + 1, fRightT };
+		}
+	}
+
+	*pfDistance = fClosestT;
+	return (iClosestItem);
+}
+
+/*
+ * CullFrustum - Items inside the view planes.
+ * @pv4Planes: FRUSTUM_PLANES_NUM planes from SFrustumCulling::GetPlanes.
+ * @puiVisible: Receives the visible items, in no particular order.
+ *
+ * A node outside one plane is dropped with everything under it, a node
+ * inside every plane keeps everything under it without testing the
+ * items. Only the leaves crossing a plane test their items, with
+ * SFrustumCulling::IsCullBoxInside. The node tests are computed another
+ * way than the item ones, BVH_CULL_EPSILON keeps their rounding from
+ * deciding for an item touching a plane. Returns the visible count.
+ */
+GLuint CBoundingVolumeHierarchy::CullFrustum(const SVector4Df* pv4Planes, GLuint* puiVisible) const
+{
+	if (m_vNodes.empty())
+	{
+		return (0);
+	}
+
+	SVector3Df v3AbsNormals[FRUSTUM_PLANES_NUM];
+	SFrustumCulling::GetAbsNormals(pv4Planes, v3AbsNormals);
+
+	TBVHCullEntry stack[BVH_STACK_SIZE];
+	GLint iStackSize = 0;
+	stack[iStackSize++] = { 0, false };
+
+	GLuint uiVisible = 0;
+
+	while (iStackSize > 0)
+	{
+		const TBVHCullEntry entry = stack[--iStackSize];
+		const TBVHNode& node = m_vNodes[entry.uiNode];
+		bool bInside = entry.bInside;
+
+		if (!bInside)
+		{
+			const GLfloat fCenterX = node.v3Max.x * 0.5f + node.v3Min.x * 0.5f;
+			const GLfloat fCenterY = node.v3Max.y * 0.5f + node.v3Min.y * 0.5f;
+			const GLfloat fCenterZ = node.v3Max.z * 0.5f + node.v3Min.z * 0.5f;
+			const GLfloat fExtentX = node.v3Max.x * 0.5f - node.v3Min.x * 0.5f;
+			const GLfloat fExtentY = node.v3Max.y * 0.5f - node.v3Min.y * 0.5f;
+			const GLfloat fExtentZ = node.v3Max.z * 0.5f - node.v3Min.z * 0.5f;
+
+			bool bOutside = false;
+			bInside = true;
+
+			for (GLint iPlane = 0; iPlane < FRUSTUM_PLANES_NUM; iPlane++)
+			{
+				const SVector4Df& v4Plane = pv4Planes[iPlane];
+				const SVector3Df& v3AbsNormal = v3AbsNormals[iPlane];
+
+				const GLfloat fCenter = v4Plane.x * fCenterX + v4Plane.y * fCenterY + v4Plane.z * fCenterZ + v4Plane.w;
+				const GLfloat fReach = v3AbsNormal.x * fExtentX + v3AbsNormal.y * fExtentY + v3AbsNormal.z * fExtentZ;
+				const GLfloat fSlack = (std::fabs(fCenter) + fReach) * BVH_CULL_EPSILON;
+
+				if (fCenter + fReach < -fSlack)
+				{
+					bOutside = true;
+					break;
+				}
+
+				if (fCenter - fReach < fSlack)
+				{
+					bInside = false;
+				}
+			}
+
+			if (bOutside)
+			{
+				continue;
+			}
+		}
+
+		if (node.uiCount > 0)
+		{
+			for (GLuint i = node.uiFirst; i < node.uiFirst + node.uiCount; i++)
+			{
+				const GLuint uiItem = m_vItems[i];
+				if (bInside || SFrustumCulling::IsCullBoxInside(m_vBoxes[uiItem], pv4Planes, v3AbsNormals))
+				{
+					puiVisible[uiVisible++] = uiItem;
+				}
+			}
+			continue;
+		}
+
+		stack[iStackSize++] = { node.uiFirst + 1, bInside };
+		stack[iStackSize++] = { node.uiFirst, bInside };
+	}
+
+	return (uiVisible);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "../../LibMath/source/frustum.h"
+
+class CRay;
+
+constexpr GLint BVH_SAH_BINS = 16;					// Candidate split planes per axis are the borders of these bins, fewer for smaller nodes
+constexpr GLuint BVH_MAX_LEAF_ITEMS = 8;			// Larger nodes are split even when the SAH prefers a leaf
+constexpr GLint BVH_MAX_DEPTH = 48;					// Deeper nodes become leaves, bounds the traversal stacks
+constexpr GLint BVH_STACK_SIZE = BVH_MAX_DEPTH + 2;
+constexpr GLfloat BVH_REBUILD_COST_RATIO = 1.5f;	// Refit builds again once the SAH cost grew this much since the last build
+constexpr GLfloat BVH_CULL_EPSILON = 1e-5f;			// Relative slack of the node plane tests, the items are tested exactly
+
+// Leaves own a run of m_vItems, inner nodes have their two children next to each other
+typedef struct SBVHNode
+{
+	SVector3Df v3Min;
+	GLuint uiFirst;		// Leaf: first slot in m_vItems, inner node: index of the left child
+	SVector3Df v3Max;
+	GLuint uiCount;		// Items of a leaf, 0 for an inner node
+} TBVHNode;
+
+// Bounds of the items binned by FindSAHSplit, plain floats so the bins are cheap to reset and grow
+typedef struct SBVHBin
+{
+	GLfloat fMin[3];
+	GLfloat fMax[3];
+	GLuint uiCount;
+} TBVHBin;
+
+// Node waiting on the Raycast stack, fT is where the ray enters it
+typedef struct SBVHRayEntry
+{
+	GLuint uiNode;
+	GLfloat fT;
+} TBVHRayEntry;
+
+// Node waiting on the CullFrustum stack, bInside when an ancestor is inside every plane
+typedef struct SBVHCullEntry
+{
+	GLuint uiNode;
+	bool bInside;
+} TBVHCullEntry;
+
+/**
+ * CBoundingVolumeHierarchy - Static BVH over world boxes, for picking and
+ * frustum culling.
+ *
+ * Built top down with binned SAH splits: the centroids of a node are
+ * spread over BVH_SAH_BINS bins on each axis and the bin border with the
+ * lowest surface area cost splits it. The items keep their index from
+ * Build, the queries return those indices.
+ *
+ * Meant for objects that rarely move. A moved item only refits the boxes
+ * of the nodes, the tree keeps its shape until it has grown too loose,
+ * then it is built again. The queries give the same items as testing every
+ * box: Raycast the closest hit of SBoundingBox::IntersectRay, CullFrustum
+ * the boxes SFrustumCulling::IsCullBoxInside keeps.
+ */
+class CBoundingVolumeHierarchy
+{
+public:
+	CBoundingVolumeHierarchy();
+
+	void Clear();
+
+	// Copies the boxes, item i is pBoxes[i]
+	void Build(const TCullBox* pBoxes, GLuint uiCount);
+
+	// Moves an item, the nodes follow at the next Refit
+	void SetItemBox(GLuint uiItem, const TCullBox& box);
+	const TCullBox& GetItemBox(GLuint uiItem) const;
+	// Bounds of the nodes after SetItemBox calls, returns true when it built the tree again
+	bool Refit();
+
+	// Closest item whose box the ray enters within its range, -1 when none; fnAccept may skip items
+	GLint Raycast(const CRay& ray, GLfloat* pfDistance, const std::function<bool(GLuint)>& fnAccept = nullptr) const;
+	// Items inside the FRUSTUM_PLANES_NUM planes of SFrustumCulling::GetPlanes, puiVisible has room for every item
+	GLuint CullFrustum(const SVector4Df* pv4Planes, GLuint* puiVisible) const;
+
+	GLuint GetItemsCount() const;
+	GLuint GetNodesCount() const;
+	GLint GetDepth() const;
+	// Expected cost of a query relative to the root, one per node visited and per item tested
+	double GetSAHCost() const;
+
+protected:
+	void BuildTree();
+	void BuildNode(GLuint uiNode, GLuint uiFirst, GLuint uiCount, GLint iDepth);
+	bool FindSAHSplit(GLuint uiFirst, GLuint uiCount, const TBVHNode& node, const TCullBox& centroidBox, GLint* piAxis, GLint* piBin, double* pdCost) const;
+	GLuint PartitionItems(GLuint uiFirst, GLuint uiCount, GLint iAxis, GLint iBin, const TCullBox& centroidBox);
+	double ComputeSAHCost() const;
+
+	static GLint GetBinsCount(GLuint uiCount);
+	static GLint GetBin(GLfloat fCentroid, GLfloat fMin, GLfloat fScale, GLint iBins);
+	static SVector3Df GetBinScale(const TCullBox& centroidBox, GLint iBins);
+	static double GetSurfaceArea(const SVector3Df& v3Min, const SVector3Df& v3Max);
+	static void ExpandBox(TCullBox& rBox, const SVector3Df& v3Min, const SVector3Df& v3Max);
+	static void ResetBin(TBVHBin& rBin);
+	static void ExpandBin(TBVHBin& rBin, const TBVHBin& other);
+	static double GetBinArea(const TBVHBin& bin);
+
+private:
+	std::vector<TBVHNode> m_vNodes;
+	std::vector<GLuint> m_vItems;			// Item indices, in leaf order
+	std::vector<TCullBox> m_vBoxes;			// By item index
+	std::vector<SVector3Df> m_vCentroids;	// By item index, built with the tree
+
+	GLint m_iDepth;
+	double m_dBuildCost;					// GetSAHCost right after the last build
+	double m_dCost;
+	bool m_bRefitPending;
+};
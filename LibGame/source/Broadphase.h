@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <utility>
+
+class CPhysicsObject;
+class CRay;
+
+typedef std::pair<CPhysicsObject*, CPhysicsObject*> TCollisionPair;
+
+enum EBroadphaseType
+{
+	BROADPHASE_SPATIAL_GRID,		// CSpatialGrid, uniform cells
+	BROADPHASE_SWEEP_AND_PRUNE,		// CSweepAndPrune, sorted axis lists
+};
+
+/**
+ * CBroadphase - Tracks the world AABBs of the physics objects and reports
+ * the pairs that may collide.
+ *
+ * Every implementation reports the same pairs: each pair of objects whose
+ * world AABBs overlap (SBoundingBox::Intersects), once, in no particular
+ * order. CPhysicsWorld only goes through this interface.
+ */
+class CBroadphase
+{
+public:
+	virtual ~CBroadphase() = default;
+
+	virtual void Clear() = 0;
+
+	// Inserts the object, or moves it if it is already tracked
+	virtual void AddObject(CPhysicsObject* pObject) = 0;
+	// Takes the current world AABB of the object, inserts it when not tracked yet
+	virtual void UpdateObject(CPhysicsObject* pObject) = 0;
+	virtual void RemoveObject(CPhysicsObject* pObject) = 0;
+	virtual bool HasObject(const CPhysicsObject* pObject) const = 0;
+
+	// The vector is owned by the broadphase and reused by the next call
+	virtual const std::vector<TCollisionPair>& GetPotentialCollisions() = 0;
+
+	// Objects the ray may hit within its range, each once; the caller runs the exact tests
+	virtual std::vector<CPhysicsObject*> GetObjectsAlongRay(const CRay& ray) = 0;
+
+	// Closest collidable object whose stored AABB the ray enters within its range (SBoundingBox::IntersectRay), nullptr when none
+	virtual CPhysicsObject* PickObject(const CRay& ray, GLfloat* pfDistance) = 0;
+
+	virtual size_t GetObjectsCount() const = 0;
+};
@@ -13,7 +13,7 @@ CMesh::CMesh()
 	m_uiVAO = 0;
 	arr_mem_zero(m_uiBuffers);
 	m_bIsPBR = false;
-	m_uiMaxInstances = 1;
+	m_fMaxDrawDistance = 0.0f;
 }
 
 CMesh::~CMesh()
@@ -127,29 +127,38 @@ void CMesh::Render(GLuint uiDrawIndex, GLuint uiPrimID)
 
 }
 
-void CMesh::Render(GLuint uiNumInstances, const std::vector<CMatrix4Df>& matWorld, const std::vector<CMatrix4Df>& matWVP)
+/*
+ * Render - Instanced draw of every sub mesh.
+ * @uiNumInstances: Instances to draw.
+ * @uiMatrixBuffer: Buffer holding the world matrices (CMatrix4Df) of every instance.
+ * @uiIndexBuffer: Buffer holding one matrix index (GLuint) per drawn instance.
+ * @lIndexOffset: Byte offset of the first index in uiIndexBuffer.
+ *
+ * The buffers are owned by the caller, so the same mesh can be drawn by
+ * several areas, and culling only changes the indices, not the matrices.
+ * View and projection come from the FrameUniforms block.
+ */
+void CMesh::Render(GLuint uiNumInstances, GLuint uiMatrixBuffer, GLuint uiIndexBuffer, GLintptr lIndexOffset)
 {
-	const GLuint iInstances = static_cast<GLuint>(matWorld.size());
+	if (uiNumInstances == 0 || !uiMatrixBuffer || !uiIndexBuffer)
+	{
+		return;
+	}
 
-	if (iInstances > m_uiMaxInstances)
-		ResizeInstanceBuffers(iInstances);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_MATRICES_BINDING, uiMatrixBuffer);
 
 	if (IsGLVersionHigher(4, 5))
 	{
-		glNamedBufferSubData(m_uiBuffers[WVP_MAT_BUFFER], 0, sizeof(CMatrix4Df) * iInstances, matWVP.data());
-		glNamedBufferSubData(m_uiBuffers[WORLD_MAT_BUFFER], 0, sizeof(CMatrix4Df) * iInstances, matWorld.data());
+		glVertexArrayVertexBuffer(m_uiVAO, INSTANCE_BINDING, uiIndexBuffer, lIndexOffset, sizeof(GLuint));
+		glBindVertexArray(m_uiVAO);
 	}
 	else
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, m_uiBuffers[WVP_MAT_BUFFER]);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(CMatrix4Df) * iInstances, matWVP.data());
-
-		glBindBuffer(GL_ARRAY_BUFFER, m_uiBuffers[WORLD_MAT_BUFFER]);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(CMatrix4Df) * iInstances, matWorld.data());
+		glBindVertexArray(m_uiVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, uiIndexBuffer);
+		glVertexAttribIPointer(INSTANCE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (const GLvoid*)lIndexOffset);
 	}
 
-	glBindVertexArray(m_uiVAO);
-
 	for (size_t i = 0; i < m_vMeshes.size(); i++)
 	{
 		const GLuint uiMaterialIndex = m_vMeshes[i].uiMaterialIndex;
@@ -165,7 +174,7 @@ void CMesh::Render(GLuint uiNumInstances, const std::vector<CMatrix4Df>& matWorl
 			m_vMaterials[uiMaterialIndex].m_pSpecularMap->Bind(SPECULAR_EXPONENT_UNIT);
 		}
 
-		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_vMeshes[i].uiNumIndices, GL_UNSIGNED_INT, (void*)(sizeof(GLuint)* m_vMeshes[i].uiBaseIndex), iInstances, m_vMeshes[i].uiBaseVertex);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_vMeshes[i].uiNumIndices, GL_UNSIGNED_INT, (void*)(sizeof(GLuint)* m_vMeshes[i].uiBaseIndex), uiNumInstances, m_vMeshes[i].uiBaseVertex);
 	}
 
 	// Make sure the VAO is not changed from the outside
@@ -342,6 +351,16 @@ TBoundingBox& CMesh::GetBoundingBox()
 	return (m_MeshBoundBoxLocal);
 }
 
+void CMesh::SetMaxDrawDistance(GLfloat fDistance)
+{
+	m_fMaxDrawDistance = fDistance;
+}
+
+GLfloat CMesh::GetMaxDrawDistance() const
+{
+	return (m_fMaxDrawDistance);
+}
+
 // Protected Members
 
 void CMesh::Clear()
@@ -496,31 +515,11 @@ void CMesh::PopulateBuffersDSA()
 
 	sNumFloats += 2; // 3 Elements x,y for the tex coords vector
 
-	// Allocate WVP buffer
-	//glNamedBufferStorage(m_uiBuffers[WVP_MAT_BUFFER], sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferData(m_uiBuffers[WVP_MAT_BUFFER], sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_DRAW);
-
-	glVertexArrayVertexBuffer(m_uiVAO, 1, m_uiBuffers[WVP_MAT_BUFFER], 0, sizeof(CMatrix4Df));
-	for (GLuint i = 0; i < 4; i++)
-	{
-		glEnableVertexArrayAttrib(m_uiVAO, WVP_LOCATION + i);
-		glVertexArrayAttribFormat(m_uiVAO, WVP_LOCATION + i, 4, GL_FLOAT, GL_FALSE, i * sizeof(float) * 4);
-		glVertexArrayAttribBinding(m_uiVAO, WVP_LOCATION + i, 1); // Binding index 1  matches buffer now
-	}
-	glVertexArrayBindingDivisor(m_uiVAO, 1, 1); // Per-instance
-
-	// Allocate World buffer
-	//glNamedBufferStorage(m_uiBuffers[WORLD_MAT_BUFFER], sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferData(m_uiBuffers[WORLD_MAT_BUFFER], sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_DRAW);
-
-	glVertexArrayVertexBuffer(m_uiVAO, 2, m_uiBuffers[WORLD_MAT_BUFFER], 0, sizeof(CMatrix4Df));
-	for (GLuint i = 0; i < 4; i++)
-	{
-		glEnableVertexArrayAttrib(m_uiVAO, WORLD_LOCATION + i);
-		glVertexArrayAttribFormat(m_uiVAO, WORLD_LOCATION + i, 4, GL_FLOAT, GL_FALSE, i * sizeof(float) * 4);
-		glVertexArrayAttribBinding(m_uiVAO, WORLD_LOCATION + i, 2); // Binding index 2  match this
-	}
-	glVertexArrayBindingDivisor(m_uiVAO, 2, 1);
+	// Per-instance matrix index, the buffer is attached by the instanced Render
+	glEnableVertexArrayAttrib(m_uiVAO, INSTANCE_LOCATION);
+	glVertexArrayAttribIFormat(m_uiVAO, INSTANCE_LOCATION, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(m_uiVAO, INSTANCE_LOCATION, INSTANCE_BINDING);
+	glVertexArrayBindingDivisor(m_uiVAO, INSTANCE_BINDING, 1); // Per-instance
 }
 
 void CMesh::PopulateBuffersNonDSA()
@@ -544,23 +543,9 @@ void CMesh::PopulateBuffersNonDSA()
 	glEnableVertexAttribArray(TEX_COORDS_LOCATION);
 	glVertexAttribPointer(TEX_COORDS_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(TMeshVertex), (const void*)(sNumFloats * sizeof(float)));
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_uiBuffers[WVP_MAT_BUFFER]);
-
-	for (GLuint i = 0; i < 4; i++)
-	{
-		glEnableVertexAttribArray(WVP_LOCATION + i);
-		glVertexAttribPointer(WVP_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(CMatrix4Df), (const GLvoid*)(sizeof(GLfloat) * i * 4));
-		glVertexAttribDivisor(WVP_LOCATION + i, 1);
-	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_uiBuffers[WORLD_MAT_BUFFER]);
-
-	for (GLuint i = 0; i < 4; i++)
-	{
-		glEnableVertexAttribArray(WORLD_LOCATION + i);
-		glVertexAttribPointer(WORLD_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(CMatrix4Df), (const GLvoid*)(sizeof(GLfloat) * i * 4));
-		glVertexAttribDivisor(WORLD_LOCATION + i, 1);
-	}
+	// Per-instance matrix index, the pointer is set by the instanced Render
+	glEnableVertexAttribArray(INSTANCE_LOCATION);
+	glVertexAttribDivisor(INSTANCE_LOCATION, 1);
 }
 
 // Priave Members
@@ -1059,60 +1044,3 @@ void CMesh::SetupRenderMaterialsPhong(GLuint uiMeshIndex, GLuint uiMaterialIndex
 	}
 }
 
-void CMesh::ResizeInstanceBuffers(GLuint newMaxInstances)
-{
-	// Add some slack to avoid re-sizing too often
-	m_uiMaxInstances = newMaxInstances + 32;
-
-	if (IsGLVersionHigher(4, 5))
-	{
-		// --- Resize WVP Buffer ---
-		// 1. Create a new, larger data store for the buffer object
-		glNamedBufferData(m_uiBuffers[WVP_MAT_BUFFER], sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_DRAW);
-		// 2. CRITICAL: Re-bind this new buffer data store to the VAO's binding point (index 1)
-		glVertexArrayVertexBuffer(m_uiVAO, 1, m_uiBuffers[WVP_MAT_BUFFER], 0, sizeof(CMatrix4Df));
-
-
-		// --- Resize World Buffer ---
-		// 1. Create a new, larger data store for the buffer object
-		glNamedBufferData(m_uiBuffers[WORLD_MAT_BUFFER], sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_DRAW);
-		// 2. CRITICAL: Re-bind this new buffer data store to the VAO's binding point (index 2)
-		glVertexArrayVertexBuffer(m_uiVAO, 2, m_uiBuffers[WORLD_MAT_BUFFER], 0, sizeof(CMatrix4Df));
-	}
-	else
-	{
-		// To modify the vertex attribute bindings, we must bind the VAO first
-		glBindVertexArray(m_uiVAO);
-
-		// --- Resize WVP Buffer ---
-		// 1. Bind the buffer to the global context
-		glBindBuffer(GL_ARRAY_BUFFER, m_uiBuffers[WVP_MAT_BUFFER]);
-		// 2. Re-allocate its storage
-		glBufferData(GL_ARRAY_BUFFER, sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_DRAW);
-		// 3. Re-configure the attribute pointers for the WVP matrix. This re-links the
-		//    newly allocated buffer to the attributes stored in the currently bound VAO.
-		for (GLuint i = 0; i < 4; i++)
-		{
-			glEnableVertexAttribArray(WVP_LOCATION + i);
-			glVertexAttribPointer(WVP_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(CMatrix4Df), (const GLvoid*)(sizeof(GLfloat) * i * 4));
-			glVertexAttribDivisor(WVP_LOCATION + i, 1);
-		}
-
-		// --- Resize World Buffer ---
-		// 1. Bind the buffer to the global context
-		glBindBuffer(GL_ARRAY_BUFFER, m_uiBuffers[WORLD_MAT_BUFFER]);
-		// 2. Re-allocate its storage
-		glBufferData(GL_ARRAY_BUFFER, sizeof(CMatrix4Df) * m_uiMaxInstances, nullptr, GL_DYNAMIC_DRAW);
-		// 3. Re-configure the attribute pointers for the World matrix.
-		for (GLuint i = 0; i < 4; i++)
-		{
-			glEnableVertexAttribArray(WORLD_LOCATION + i);
-			glVertexAttribPointer(WORLD_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(CMatrix4Df), (const GLvoid*)(sizeof(GLfloat) * i * 4));
-			glVertexAttribDivisor(WORLD_LOCATION + i, 1);
-		}
-
-		// Unbind the VAO to prevent accidental modification
-		glBindVertexArray(0);
-	}
-}
-
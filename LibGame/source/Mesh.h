@@ -41,8 +41,9 @@
 #define POSITION_LOCATION  0
 #define NORMALS_LOCATION    1
 #define TEX_COORDS_LOCATION 2
-#define WVP_LOCATION 3
-#define WORLD_LOCATION 7
+#define INSTANCE_LOCATION 3				// uint, index of the instance world matrix
+#define INSTANCE_BINDING 1				// Vertex buffer binding of the per-instance indices
+#define INSTANCE_MATRICES_BINDING 3		// Shader storage binding of the world matrices
 
 #define GLCheckError() (glGetError() == GL_NO_ERROR)
 
@@ -141,7 +142,7 @@ public:
 	bool LoadMesh(const std::string& stFileName, bool bIsUVFlipped = false);
 	void Render();
 	void Render(GLuint uiDrawIndex, GLuint uiPrimID);
-	void Render(GLuint uiNumInstances, const std::vector<CMatrix4Df>& matWorld, const std::vector<CMatrix4Df>& matWVP);
+	void Render(GLuint uiNumInstances, GLuint uiMatrixBuffer, GLuint uiIndexBuffer, GLintptr lIndexOffset);
 
 	const TMaterial& GetMaterial();
 	TPBRMaterial& GetPBRMaterial();
@@ -171,6 +172,10 @@ public:
 
 	void ComputeBoundingVolumes();
 
+	// Instances further than this from the camera are culled, 0 for no limit
+	void SetMaxDrawDistance(GLfloat fDistance);
+	GLfloat GetMaxDrawDistance() const;
+
 	TBoundingBox& GetBoundingBox();
 	std::string GetMeshName() const { return m_sMeshName; }
 	void SetMeshName(const std::string& stName) { m_sMeshName = stName; }
@@ -204,9 +209,7 @@ protected:
 	{
 		INDEX_BUFFER,
 		VERTEX_BUFFER,
-		WVP_MAT_BUFFER = 2,  // required only for instancing
-		WORLD_MAT_BUFFER = 3,  // required only for instancing
-		NUM_BUFFERS = 4
+		NUM_BUFFERS = 2
 	};
 
 	std::vector<TMeshEntry> m_vMeshes;
@@ -250,8 +253,6 @@ private:
 	void SetupRenderMaterialsPBR();
 	void SetupRenderMaterialsPhong(GLuint uiMeshIndex, GLuint uiMaterialIndex);
 
-	void ResizeInstanceBuffers(GLuint newMaxInstances);
-
 	std::vector<TMaterial> m_vMaterials;
 
 	// Temporary space for vertex stuff before we load them into the GPU
@@ -267,6 +268,6 @@ private:
 private:
 	CPhysicsObject* m_pPhysicsObject;
 	bool m_bNeedsUpdate;
-	GLuint m_uiMaxInstances; // current buffer capacity
+	GLfloat m_fMaxDrawDistance;
 	std::string m_sMeshName;
 };
\ No newline at end of file
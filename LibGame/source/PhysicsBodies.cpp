@@ -0,0 +1,579 @@
+#include "Stdafx.h"
+#include "PhysicsBodies.h"
+#include "../../LibTerrain/source/TerrainMap.h"
+#include "../../LibGL/source/JobSystem.h"
+
+CPhysicsBodies::CPhysicsBodies()
+{
+	Clear();
+}
+
+void CPhysicsBodies::Clear()
+{
+	m_Position.Clear();
+	m_PrevPosition.Clear();
+	m_Rotation.Clear();
+	m_PrevRotation.Clear();
+	m_Scale.Clear();
+	m_Velocity.Clear();
+	m_Acceleration.Clear();
+	m_AngularVelocity.Clear();
+	m_Torque.Clear();
+
+	m_vFriction.clear();
+	m_vGravity.clear();
+	m_vRestitution.clear();
+	m_vMomentOfInertia.clear();
+	m_vFlags.clear();
+	m_vTerrainMaps.clear();
+
+	m_LocalMin.Clear();
+	m_LocalMax.Clear();
+	m_WorldMin.Clear();
+	m_WorldMax.Clear();
+
+	m_vOwners.clear();
+	m_vBodySlots.clear();
+
+	m_vSlotIndices.clear();
+	m_vSlotGenerations.clear();
+	m_vFreeSlots.clear();
+}
+
+/*
+ * Add - Appends a body at the end of the arrays.
+ * @pOwner: Object the body belongs to, may be nullptr.
+ * @rState: Initial state of the body.
+ *
+ * A freed slot is reused with its generation bumped, so the handles of
+ * the body that held it before do not resolve to the new one.
+ *
+ * Return: The handle of the body.
+ */
+TPhysicsBodyHandle CPhysicsBodies::Add(CPhysicsObject* pOwner, const TPhysicsBodyState& rState)
+{
+	TPhysicsBodyHandle hBody;
+
+	if (!m_vFreeSlots.empty())
+	{
+		hBody.uiSlot = m_vFreeSlots.back();
+		m_vFreeSlots.pop_back();
+	}
+	else
+	{
+		hBody.uiSlot = static_cast<GLuint>(m_vSlotIndices.size());
+		m_vSlotIndices.push_back(PHYSICS_BODY_INVALID_SLOT);
+		m_vSlotGenerations.push_back(0);
+	}
+
+	hBody.uiGeneration = m_vSlotGenerations[hBody.uiSlot];
+	m_vSlotIndices[hBody.uiSlot] = static_cast<GLuint>(m_vOwners.size());
+
+	PushBackState(rState);
+	m_vOwners.push_back(pOwner);
+	m_vBodySlots.push_back(hBody.uiSlot);
+
+	return (hBody);
+}
+
+bool CPhysicsBodies::Remove(const TPhysicsBodyHandle& hBody)
+{
+	const GLint iIndex = GetIndex(hBody);
+	if (iIndex < 0)
+	{
+		return (false);
+	}
+
+	const GLint iLast = GetCount() - 1;
+	if (iIndex != iLast)
+	{
+		MoveBody(iIndex, iLast);
+		m_vSlotIndices[m_vBodySlots[iIndex]] = static_cast<GLuint>(iIndex);
+	}
+
+	PopBackBody();
+
+	m_vSlotIndices[hBody.uiSlot] = PHYSICS_BODY_INVALID_SLOT;
+	m_vSlotGenerations[hBody.uiSlot]++;
+	m_vFreeSlots.push_back(hBody.uiSlot);
+	return (true);
+}
+
+GLint CPhysicsBodies::GetIndex(const TPhysicsBodyHandle& hBody) const
+{
+	if (hBody.uiSlot >= m_vSlotIndices.size() || m_vSlotGenerations[hBody.uiSlot] != hBody.uiGeneration)
+	{
+		return (-1);
+	}
+
+	const GLuint uiIndex = m_vSlotIndices[hBody.uiSlot];
+	return (uiIndex == PHYSICS_BODY_INVALID_SLOT ? -1 : static_cast<GLint>(uiIndex));
+}
+
+bool CPhysicsBodies::IsValid(const TPhysicsBodyHandle& hBody) const
+{
+	return (GetIndex(hBody) >= 0);
+}
+
+bool CPhysicsBodies::SetState(const TPhysicsBodyHandle& hBody, const TPhysicsBodyState& rState)
+{
+	const GLint iIndex = GetIndex(hBody);
+	if (iIndex < 0)
+	{
+		return (false);
+	}
+
+	SetStateAt(iIndex, rState);
+	return (true);
+}
+
+bool CPhysicsBodies::GetState(const TPhysicsBodyHandle& hBody, TPhysicsBodyState& rState) const
+{
+	const GLint iIndex = GetIndex(hBody);
+	if (iIndex < 0)
+	{
+		return (false);
+	}
+
+	GetStateAt(iIndex, rState);
+	return (true);
+}
+
+void CPhysicsBodies::GetStateAt(GLint iIndex, TPhysicsBodyState& rState) const
+{
+	rState.v3Position = m_Position.Get(iIndex);
+	rState.v3PrevPosition = m_PrevPosition.Get(iIndex);
+	rState.v3Rotation = m_Rotation.Get(iIndex);
+	rState.v3PrevRotation = m_PrevRotation.Get(iIndex);
+	rState.v3Scale = m_Scale.Get(iIndex);
+	rState.v3Velocity = m_Velocity.Get(iIndex);
+	rState.v3Acceleration = m_Acceleration.Get(iIndex);
+	rState.v3AngularVelocity = m_AngularVelocity.Get(iIndex);
+	rState.v3Torque = m_Torque.Get(iIndex);
+
+	rState.fFriction = m_vFriction[iIndex];
+	rState.fGravity = m_vGravity[iIndex];
+	rState.fRestitution = m_vRestitution[iIndex];
+	rState.fMomentOfInertia = m_vMomentOfInertia[iIndex];
+	rState.ubFlags = m_vFlags[iIndex];
+	rState.pTerrainMap = m_vTerrainMaps[iIndex];
+
+	rState.v3LocalMin = m_LocalMin.Get(iIndex);
+	rState.v3LocalMax = m_LocalMax.Get(iIndex);
+	rState.v3WorldMin = m_WorldMin.Get(iIndex);
+	rState.v3WorldMax = m_WorldMax.Get(iIndex);
+}
+
+CPhysicsObject* CPhysicsBodies::GetOwner(const TPhysicsBodyHandle& hBody) const
+{
+	const GLint iIndex = GetIndex(hBody);
+	return (iIndex < 0 ? nullptr : m_vOwners[iIndex]);
+}
+
+CPhysicsObject* CPhysicsBodies::GetOwnerAt(GLint iIndex) const
+{
+	return (m_vOwners[iIndex]);
+}
+
+const std::vector<CPhysicsObject*>& CPhysicsBodies::GetOwners() const
+{
+	return (m_vOwners);
+}
+
+bool CPhysicsBodies::IsMovableAt(GLint iIndex) const
+{
+	return ((m_vFlags[iIndex] & PHYSICS_BODY_FLAG_MOVABLE) != 0);
+}
+
+GLint CPhysicsBodies::GetCount() const
+{
+	return (static_cast<GLint>(m_vOwners.size()));
+}
+
+void CPhysicsBodies::Integrate(GLfloat fDeltaTime)
+{
+	const GLint iCount = GetCount();
+	const GLint iChunkCount = std::max((iCount + PHYSICS_BODIES_GRAIN - 1) / PHYSICS_BODIES_GRAIN, 1);
+
+	if (static_cast<GLint>(m_vTerrainScratch.size()) < iChunkCount)
+	{
+		m_vTerrainScratch.resize(iChunkCount);
+	}
+
+	if (iCount >= PHYSICS_BODIES_PARALLEL_MIN && CJobSystem::HasInstance())
+	{
+		CJobSystem::Instance().ParallelFor(0, iCount, PHYSICS_BODIES_GRAIN, [this, fDeltaTime](GLint iBegin, GLint iEnd)
+		{
+			IntegrateRange(iBegin, iEnd, fDeltaTime);
+		});
+	}
+	else
+	{
+		IntegrateRange(0, iCount, fDeltaTime);
+	}
+}
+
+/*
+ * IntegrateRange - Every pass over one chunk of bodies.
+ *
+ * The passes run one after the other on a chunk, it is still in the cache
+ * for the next one. A chunk starts on a multiple of PHYSICS_BODIES_GRAIN,
+ * or is the whole range when it runs on the calling thread, so its first
+ * body picks its own scratch buffers.
+ */
+void CPhysicsBodies::IntegrateRange(GLint iBegin, GLint iEnd, GLfloat fDeltaTime)
+{
+	IntegrateLinear(iBegin, iEnd, fDeltaTime);
+	CollideTerrain(iBegin, iEnd, m_vTerrainScratch[iBegin / PHYSICS_BODIES_GRAIN]);
+	IntegrateAngular(iBegin, iEnd, fDeltaTime);
+	RefreshWorldBoxes(iBegin, iEnd);
+}
+
+/*
+ * IntegrateLinear - Gravity, acceleration, damping and position.
+ *
+ * Every body keeps its previous position, bodies that do not move keep
+ * the rest of their state through the selects.
+ */
+void CPhysicsBodies::IntegrateLinear(GLint iBegin, GLint iEnd, GLfloat fDeltaTime)
+{
+	GLfloat* pPosX = m_Position.vX.data();
+	GLfloat* pPosY = m_Position.vY.data();
+	GLfloat* pPosZ = m_Position.vZ.data();
+	GLfloat* pPrevX = m_PrevPosition.vX.data();
+	GLfloat* pPrevY = m_PrevPosition.vY.data();
+	GLfloat* pPrevZ = m_PrevPosition.vZ.data();
+	GLfloat* pVelX = m_Velocity.vX.data();
+	GLfloat* pVelY = m_Velocity.vY.data();
+	GLfloat* pVelZ = m_Velocity.vZ.data();
+	GLfloat* pAccX = m_Acceleration.vX.data();
+	GLfloat* pAccY = m_Acceleration.vY.data();
+	GLfloat* pAccZ = m_Acceleration.vZ.data();
+	const GLfloat* pFriction = m_vFriction.data();
+	const GLfloat* pGravity = m_vGravity.data();
+	const GLubyte* pFlags = m_vFlags.data();
+
+	const GLubyte ubFallMask = PHYSICS_BODY_FLAG_MOVABLE | PHYSICS_BODY_FLAG_GRAVITY | PHYSICS_BODY_FLAG_ON_GROUND;
+	const GLubyte ubFalling = PHYSICS_BODY_FLAG_MOVABLE | PHYSICS_BODY_FLAG_GRAVITY;
+
+	for (GLint i = iBegin; i < iEnd; i++)
+	{
+		pPrevX[i] = pPosX[i];
+		pPrevY[i] = pPosY[i];
+		pPrevZ[i] = pPosZ[i];
+
+		const bool bMovable = (pFlags[i] & PHYSICS_BODY_FLAG_MOVABLE) != 0;
+		const GLfloat fAccY = (pFlags[i] & ubFallMask) == ubFalling ? pAccY[i] - pGravity[i] : pAccY[i];
+		const GLfloat fDamping = 1.0f - pFriction[i] * fDeltaTime;
+
+		const GLfloat fVelX = (pVelX[i] + pAccX[i] * fDeltaTime) * fDamping;
+		const GLfloat fVelY = (pVelY[i] + fAccY * fDeltaTime) * fDamping;
+		const GLfloat fVelZ = (pVelZ[i] + pAccZ[i] * fDeltaTime) * fDamping;
+
+		pPosX[i] = bMovable ? pPosX[i] + fVelX * fDeltaTime : pPosX[i];
+		pPosY[i] = bMovable ? pPosY[i] + fVelY * fDeltaTime : pPosY[i];
+		pPosZ[i] = bMovable ? pPosZ[i] + fVelZ * fDeltaTime : pPosZ[i];
+
+		pVelX[i] = bMovable ? fVelX : pVelX[i];
+		pVelY[i] = bMovable ? fVelY : pVelY[i];
+		pVelZ[i] = bMovable ? fVelZ : pVelZ[i];
+
+		pAccX[i] = bMovable ? 0.0f : pAccX[i];
+		pAccY[i] = bMovable ? 0.0f : pAccY[i];
+		pAccZ[i] = bMovable ? 0.0f : pAccZ[i];
+	}
+}
+
+/*
+ * CollideTerrain - Keeps the moved bodies above their terrain map.
+ *
+ * A body under the ground is put back on it and bounces with its
+ * restitution until the bounce gets slower than PHYSICS_BOUNCE_STOP_SPEED.
+ * Resting bodies stop sliding under PHYSICS_SLIDE_STOP_SPEED. The ground
+ * heights of the chunk are read first, one CTerrainMap::GetHeights call per
+ * run of bodies on the same map, into buffers the chunk keeps between
+ * steps.
+ */
+void CPhysicsBodies::CollideTerrain(GLint iBegin, GLint iEnd, TPhysicsTerrainScratch& rScratch)
+{
+	std::vector<GLint>& vBodies = rScratch.vBodies;
+	std::vector<GLfloat>& vGroundX = rScratch.vGroundX;
+	std::vector<GLfloat>& vGroundZ = rScratch.vGroundZ;
+	std::vector<GLfloat>& vGroundY = rScratch.vGroundY;
+	vBodies.clear();
+	vGroundX.clear();
+	vGroundZ.clear();
+
+	for (GLint i = iBegin; i < iEnd; i++)
+	{
+		if (m_vTerrainMaps[i] && (m_vFlags[i] & PHYSICS_BODY_FLAG_MOVABLE))
+		{
+			vBodies.push_back(i);
+			vGroundX.push_back(m_Position.vX[i]);
+			vGroundZ.push_back(m_Position.vZ[i]);
+		}
+	}
+
+	vGroundY.resize(vBodies.size());
+
+	for (size_t sRun = 0; sRun < vBodies.size();)
+	{
+		CTerrainMap* pTerrainMap = m_vTerrainMaps[vBodies[sRun]];
+
+		size_t sRunEnd = sRun + 1;
+		while (sRunEnd < vBodies.size() && m_vTerrainMaps[vBodies[sRunEnd]] == pTerrainMap)
+		{
+			sRunEnd++;
+		}
+
+		pTerrainMap->GetHeights(vGroundX.data() + sRun, vGroundZ.data() + sRun, vGroundY.data() + sRun, sRunEnd - sRun);
+		sRun = sRunEnd;
+	}
+
+	for (size_t sBody = 0; sBody < vBodies.size(); sBody++)
+	{
+		const GLint i = vBodies[sBody];
+		const GLfloat fGroundY = vGroundY[sBody];
+		GLubyte& rFlags = m_vFlags[i];
+
+		if (m_Position.vY[i] > fGroundY)
+		{
+			rFlags &= ~PHYSICS_BODY_FLAG_ON_GROUND;
+			continue;
+		}
+
+		m_Position.vY[i] = fGroundY;
+
+		GLfloat& rVelY = m_Velocity.vY[i];
+		bool bOnGround = true;
+
+		if (rVelY < 0.0f)
+		{
+			rVelY = -rVelY * m_vRestitution[i];
+
+			if (std::abs(rVelY) < PHYSICS_BOUNCE_STOP_SPEED)
+			{
+				rVelY = 0.0f;
+			}
+			else
+			{
+				bOnGround = false;
+			}
+		}
+
+		if (bOnGround)
+		{
+			rFlags |= PHYSICS_BODY_FLAG_ON_GROUND;
+
+			if (std::abs(m_Velocity.vX[i]) < PHYSICS_SLIDE_STOP_SPEED && std::abs(m_Velocity.vZ[i]) < PHYSICS_SLIDE_STOP_SPEED)
+			{
+				m_Velocity.vX[i] = 0.0f;
+				m_Velocity.vZ[i] = 0.0f;
+			}
+		}
+		else
+		{
+			rFlags &= ~PHYSICS_BODY_FLAG_ON_GROUND;
+		}
+	}
+}
+
+void CPhysicsBodies::IntegrateAngular(GLint iBegin, GLint iEnd, GLfloat fDeltaTime)
+{
+	GLfloat* pRotX = m_Rotation.vX.data();
+	GLfloat* pRotY = m_Rotation.vY.data();
+	GLfloat* pRotZ = m_Rotation.vZ.data();
+	GLfloat* pPrevX = m_PrevRotation.vX.data();
+	GLfloat* pPrevY = m_PrevRotation.vY.data();
+	GLfloat* pPrevZ = m_PrevRotation.vZ.data();
+	GLfloat* pAngX = m_AngularVelocity.vX.data();
+	GLfloat* pAngY = m_AngularVelocity.vY.data();
+	GLfloat* pAngZ = m_AngularVelocity.vZ.data();
+	GLfloat* pTorqueX = m_Torque.vX.data();
+	GLfloat* pTorqueY = m_Torque.vY.data();
+	GLfloat* pTorqueZ = m_Torque.vZ.data();
+	const GLfloat* pMomentOfInertia = m_vMomentOfInertia.data();
+	const GLubyte* pFlags = m_vFlags.data();
+
+	for (GLint i = iBegin; i < iEnd; i++)
+	{
+		pPrevX[i] = pRotX[i];
+		pPrevY[i] = pRotY[i];
+		pPrevZ[i] = pRotZ[i];
+
+		const bool bMovable = (pFlags[i] & PHYSICS_BODY_FLAG_MOVABLE) != 0;
+		const bool bRotates = bMovable && pMomentOfInertia[i] > 0.0f;
+
+		// The division only feeds bodies that rotate, the others pick their old values
+		const GLfloat fMomentOfInertia = bRotates ? pMomentOfInertia[i] : 1.0f;
+
+		const GLfloat fAngX = (pAngX[i] + (pTorqueX[i] / fMomentOfInertia) * fDeltaTime) * PHYSICS_ANGULAR_DAMPING;
+		const GLfloat fAngY = (pAngY[i] + (pTorqueY[i] / fMomentOfInertia) * fDeltaTime) * PHYSICS_ANGULAR_DAMPING;
+		const GLfloat fAngZ = (pAngZ[i] + (pTorqueZ[i] / fMomentOfInertia) * fDeltaTime) * PHYSICS_ANGULAR_DAMPING;
+
+		pRotX[i] = bRotates ? pRotX[i] + fAngX * fDeltaTime : pRotX[i];
+		pRotY[i] = bRotates ? pRotY[i] + fAngY * fDeltaTime : pRotY[i];
+		pRotZ[i] = bRotates ? pRotZ[i] + fAngZ * fDeltaTime : pRotZ[i];
+
+		pAngX[i] = bRotates ? fAngX : pAngX[i];
+		pAngY[i] = bRotates ? fAngY : pAngY[i];
+		pAngZ[i] = bRotates ? fAngZ : pAngZ[i];
+
+		pTorqueX[i] = bMovable ? 0.0f : pTorqueX[i];
+		pTorqueY[i] = bMovable ? 0.0f : pTorqueY[i];
+		pTorqueZ[i] = bMovable ? 0.0f : pTorqueZ[i];
+	}
+}
+
+/*
+ * RefreshWorldBoxes - World AABB of the moved bodies.
+ *
+ * Same matrix as CWorldTranslation::BuildMatrix, applied to the center and
+ * half extents of the local box instead of its eight corners: the world
+ * half extents are the local ones through the absolute value of the
+ * rotation and scale part.
+ */
+void CPhysicsBodies::RefreshWorldBoxes(GLint iBegin, GLint iEnd)
+{
+	const GLubyte* pFlags = m_vFlags.data();
+
+	for (GLint i = iBegin; i < iEnd; i++)
+	{
+		if (!(pFlags[i] & PHYSICS_BODY_FLAG_MOVABLE))
+		{
+			continue;
+		}
+
+		const GLfloat fRotX = ToRadian(m_Rotation.vX[i]);
+		const GLfloat fRotY = ToRadian(m_Rotation.vY[i]);
+		const GLfloat fRotZ = ToRadian(m_Rotation.vZ[i]);
+
+		const GLfloat sx = std::sinf(fRotX), cx = std::cosf(fRotX);
+		const GLfloat sy = std::sinf(fRotY), cy = std::cosf(fRotY);
+		const GLfloat sz = std::sinf(fRotZ), cz = std::cosf(fRotZ);
+
+		const GLfloat fScaleX = m_Scale.vX[i];
+		const GLfloat fScaleY = m_Scale.vY[i];
+		const GLfloat fScaleZ = m_Scale.vZ[i];
+
+		const GLfloat m00 = cy * cz * fScaleX;
+		const GLfloat m01 = -cy * sz * fScaleY;
+		const GLfloat m02 = sy * fScaleZ;
+		const GLfloat m10 = (sx * sy * cz + cx * sz) * fScaleX;
+		const GLfloat m11 = (cx * cz - sx * sy * sz) * fScaleY;
+		const GLfloat m12 = -sx * cy * fScaleZ;
+		const GLfloat m20 = (sx * sz - cx * sy * cz) * fScaleX;
+		const GLfloat m21 = (cx * sy * sz + sx * cz) * fScaleY;
+		const GLfloat m22 = cx * cy * fScaleZ;
+
+		const GLfloat fCenterX = (m_LocalMin.vX[i] + m_LocalMax.vX[i]) * 0.5f;
+		const GLfloat fCenterY = (m_LocalMin.vY[i] + m_LocalMax.vY[i]) * 0.5f;
+		const GLfloat fCenterZ = (m_LocalMin.vZ[i] + m_LocalMax.vZ[i]) * 0.5f;
+		const GLfloat fHalfX = (m_LocalMax.vX[i] - m_LocalMin.vX[i]) * 0.5f;
+		const GLfloat fHalfY = (m_LocalMax.vY[i] - m_LocalMin.vY[i]) * 0.5f;
+		const GLfloat fHalfZ = (m_LocalMax.vZ[i] - m_LocalMin.vZ[i]) * 0.5f;
+
+		const GLfloat fWorldX = m00 * fCenterX + m01 * fCenterY + m02 * fCenterZ + m_Position.vX[i];
+		const GLfloat fWorldY = m10 * fCenterX + m11 * fCenterY + m12 * fCenterZ + m_Position.vY[i];
+		const GLfloat fWorldZ = m20 * fCenterX + m21 * fCenterY + m22 * fCenterZ + m_Position.vZ[i];
+
+		const GLfloat fExtentX = std::abs(m00) * fHalfX + std::abs(m01) * fHalfY + std::abs(m02) * fHalfZ;
+		const GLfloat fExtentY = std::abs(m10) * fHalfX + std::abs(m11) * fHalfY + std::abs(m12) * fHalfZ;
+		const GLfloat fExtentZ = std::abs(m20) * fHalfX + std::abs(m21) * fHalfY + std::abs(m22) * fHalfZ;
+
+		m_WorldMin.vX[i] = fWorldX - fExtentX;
+		m_WorldMin.vY[i] = fWorldY - fExtentY;
+		m_WorldMin.vZ[i] = fWorldZ - fExtentZ;
+		m_WorldMax.vX[i] = fWorldX + fExtentX;
+		m_WorldMax.vY[i] = fWorldY + fExtentY;
+		m_WorldMax.vZ[i] = fWorldZ + fExtentZ;
+	}
+}
+
+void CPhysicsBodies::SetStateAt(GLint iIndex, const TPhysicsBodyState& rState)
+{
+	m_Position.Set(iIndex, rState.v3Position);
+	m_PrevPosition.Set(iIndex, rState.v3PrevPosition);
+	m_Rotation.Set(iIndex, rState.v3Rotation);
+	m_PrevRotation.Set(iIndex, rState.v3PrevRotation);
+	m_Scale.Set(iIndex, rState.v3Scale);
+	m_Velocity.Set(iIndex, rState.v3Velocity);
+	m_Acceleration.Set(iIndex, rState.v3Acceleration);
+	m_AngularVelocity.Set(iIndex, rState.v3AngularVelocity);
+	m_Torque.Set(iIndex, rState.v3Torque);
+
+	m_vFriction[iIndex] = rState.fFriction;
+	m_vGravity[iIndex] = rState.fGravity;
+	m_vRestitution[iIndex] = rState.fRestitution;
+	m_vMomentOfInertia[iIndex] = rState.fMomentOfInertia;
+	m_vFlags[iIndex] = rState.ubFlags;
+	m_vTerrainMaps[iIndex] = rState.pTerrainMap;
+
+	m_LocalMin.Set(iIndex, rState.v3LocalMin);
+	m_LocalMax.Set(iIndex, rState.v3LocalMax);
+	m_WorldMin.Set(iIndex, rState.v3WorldMin);
+	m_WorldMax.Set(iIndex, rState.v3WorldMax);
+}
+
+void CPhysicsBodies::PushBackState(const TPhysicsBodyState& rState)
+{
+	m_Position.PushBack(rState.v3Position);
+	m_PrevPosition.PushBack(rState.v3PrevPosition);
+	m_Rotation.PushBack(rState.v3Rotation);
+	m_PrevRotation.PushBack(rState.v3PrevRotation);
+	m_Scale.PushBack(rState.v3Scale);
+	m_Velocity.PushBack(rState.v3Velocity);
+	m_Acceleration.PushBack(rState.v3Acceleration);
+	m_AngularVelocity.PushBack(rState.v3AngularVelocity);
+	m_Torque.PushBack(rState.v3Torque);
+
+	m_vFriction.push_back(rState.fFriction);
+	m_vGravity.push_back(rState.fGravity);
+	m_vRestitution.push_back(rState.fRestitution);
+	m_vMomentOfInertia.push_back(rState.fMomentOfInertia);
+	m_vFlags.push_back(rState.ubFlags);
+	m_vTerrainMaps.push_back(rState.pTerrainMap);
+
+	m_LocalMin.PushBack(rState.v3LocalMin);
+	m_LocalMax.PushBack(rState.v3LocalMax);
+	m_WorldMin.PushBack(rState.v3WorldMin);
+	m_WorldMax.PushBack(rState.v3WorldMax);
+}
+
+void CPhysicsBodies::MoveBody(GLint iTo, GLint iFrom)
+{
+	TPhysicsBodyState state;
+	GetStateAt(iFrom, state);
+	SetStateAt(iTo, state);
+
+	m_vOwners[iTo] = m_vOwners[iFrom];
+	m_vBodySlots[iTo] = m_vBodySlots[iFrom];
+}
+
+void CPhysicsBodies::PopBackBody()
+{
+	m_Position.PopBack();
+	m_PrevPosition.PopBack();
+	m_Rotation.PopBack();
+	m_PrevRotation.PopBack();
+	m_Scale.PopBack();
+	m_Velocity.PopBack();
+	m_Acceleration.PopBack();
+	m_AngularVelocity.PopBack();
+	m_Torque.PopBack();
+
+	m_vFriction.pop_back();
+	m_vGravity.pop_back();
+	m_vRestitution.pop_back();
+	m_vMomentOfInertia.pop_back();
+	m_vFlags.pop_back();
+	m_vTerrainMaps.pop_back();
+
+	m_LocalMin.PopBack();
+	m_LocalMax.PopBack();
+	m_WorldMin.PopBack();
+	m_WorldMax.PopBack();
+
+	m_vOwners.pop_back();
+	m_vBodySlots.pop_back();
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <climits>
+#include <vector>
+#include "../../LibMath/source/vectors.h"
+
+class CPhysicsObject;
+class CTerrainMap;
+
+constexpr GLint PHYSICS_BODIES_GRAIN = 1024;				// Bodies per ParallelFor chunk
+constexpr GLint PHYSICS_BODIES_PARALLEL_MIN = 4096;		// Bodies before the integration runs on the job system
+constexpr GLuint PHYSICS_BODY_INVALID_SLOT = UINT_MAX;
+
+constexpr GLfloat PHYSICS_ANGULAR_DAMPING = 0.98f;		// Angular velocity kept after each step
+constexpr GLfloat PHYSICS_BOUNCE_STOP_SPEED = 0.1f;		// Vertical speed under which a bounce on the terrain ends
+constexpr GLfloat PHYSICS_SLIDE_STOP_SPEED = 0.05f;		// Horizontal speed under which a body on the ground stops
+
+enum EPhysicsBodyFlags : GLubyte
+{
+	PHYSICS_BODY_FLAG_MOVABLE = (1 << 0),		// Neither OBJECT_TYPE_NONE nor OBJECT_TYPE_STATIC
+	PHYSICS_BODY_FLAG_GRAVITY = (1 << 1),
+	PHYSICS_BODY_FLAG_ON_GROUND = (1 << 2),
+	PHYSICS_BODY_FLAG_COLLIDABLE = (1 << 3),
+};
+
+// Stable name of a body, stays valid while other bodies are added and removed
+typedef struct SPhysicsBodyHandle
+{
+	GLuint uiSlot;
+	GLuint uiGeneration;
+
+	SPhysicsBodyHandle()
+	{
+		uiSlot = PHYSICS_BODY_INVALID_SLOT;
+		uiGeneration = 0;
+	}
+
+	bool IsValid() const
+	{
+		return (uiSlot != PHYSICS_BODY_INVALID_SLOT);
+	}
+} TPhysicsBodyHandle;
+
+// Everything a step reads or writes for one body
+typedef struct SPhysicsBodyState
+{
+	SVector3Df v3Position;
+	SVector3Df v3PrevPosition;
+	SVector3Df v3Rotation;			// Euler angles in degrees
+	SVector3Df v3PrevRotation;
+	SVector3Df v3Scale;
+	SVector3Df v3Velocity;
+	SVector3Df v3Acceleration;
+	SVector3Df v3AngularVelocity;
+	SVector3Df v3Torque;
+
+	GLfloat fFriction;
+	GLfloat fGravity;
+	GLfloat fRestitution;
+	GLfloat fMomentOfInertia;
+	GLubyte ubFlags;				// EPhysicsBodyFlags
+
+	CTerrainMap* pTerrainMap;
+
+	SVector3Df v3LocalMin;
+	SVector3Df v3LocalMax;
+	SVector3Df v3WorldMin;
+	SVector3Df v3WorldMax;
+} TPhysicsBodyState;
+
+// One vector per component, a loop over the bodies reads each of them linearly
+typedef struct SPhysicsFloat3Array
+{
+	std::vector<GLfloat> vX;
+	std::vector<GLfloat> vY;
+	std::vector<GLfloat> vZ;
+
+	SVector3Df Get(size_t sIndex) const
+	{
+		return (SVector3Df(vX[sIndex], vY[sIndex], vZ[sIndex]));
+	}
+
+	void Set(size_t sIndex, const SVector3Df& v3Value)
+	{
+		vX[sIndex] = v3Value.x;
+		vY[sIndex] = v3Value.y;
+		vZ[sIndex] = v3Value.z;
+	}
+
+	void PushBack(const SVector3Df& v3Value)
+	{
+		vX.push_back(v3Value.x);
+		vY.push_back(v3Value.y);
+		vZ.push_back(v3Value.z);
+	}
+
+	void PopBack()
+	{
+		vX.pop_back();
+		vY.pop_back();
+		vZ.pop_back();
+	}
+
+	void Clear()
+	{
+		vX.clear();
+		vY.clear();
+		vZ.clear();
+	}
+} TPhysicsFloat3Array;
+
+// Bodies of one chunk that CollideTerrain reads the ground under, kept between steps
+typedef struct SPhysicsTerrainScratch
+{
+	std::vector<GLint> vBodies;
+	std::vector<GLfloat> vGroundX;
+	std::vector<GLfloat> vGroundZ;
+	std::vector<GLfloat> vGroundY;
+} TPhysicsTerrainScratch;
+
+/**
+ * CPhysicsBodies - Physics body state stored as structure of arrays.
+ *
+ * Every field of every body lives in its own contiguous array, bodies are
+ * packed at the front of the arrays and a removal moves the last body in
+ * the hole. Handles go through a slot table with a generation, so they
+ * keep naming the same body after the arrays are reordered and stop
+ * resolving once the body is removed.
+ *
+ * Integrate() gives the same results as CPhysicsObject::Update on every
+ * body. The linear, angular and world AABB passes only select between
+ * values so the compiler can vectorize them, the terrain collision reads
+ * the ground of a whole chunk with CTerrainMap::GetHeights. Above PHYSICS_BODIES_PARALLEL_MIN
+ * bodies the chunks run on the job system, which only reads the terrain.
+ */
+class CPhysicsBodies
+{
+public:
+	CPhysicsBodies();
+
+	void Clear();
+
+	TPhysicsBodyHandle Add(CPhysicsObject* pOwner, const TPhysicsBodyState& rState);
+	bool Remove(const TPhysicsBodyHandle& hBody);
+
+	// Dense index of a body, -1 once it is removed
+	GLint GetIndex(const TPhysicsBodyHandle& hBody) const;
+	bool IsValid(const TPhysicsBodyHandle& hBody) const;
+
+	bool SetState(const TPhysicsBodyHandle& hBody, const TPhysicsBodyState& rState);
+	bool GetState(const TPhysicsBodyHandle& hBody, TPhysicsBodyState& rState) const;
+	void GetStateAt(GLint iIndex, TPhysicsBodyState& rState) const;
+
+	CPhysicsObject* GetOwner(const TPhysicsBodyHandle& hBody) const;
+	CPhysicsObject* GetOwnerAt(GLint iIndex) const;
+	const std::vector<CPhysicsObject*>& GetOwners() const;
+
+	bool IsMovableAt(GLint iIndex) const;
+	GLint GetCount() const;
+
+	// One step of fDeltaTime seconds for every body
+	void Integrate(GLfloat fDeltaTime);
+
+protected:
+	void IntegrateRange(GLint iBegin, GLint iEnd, GLfloat fDeltaTime);
+	void IntegrateLinear(GLint iBegin, GLint iEnd, GLfloat fDeltaTime);
+	void CollideTerrain(GLint iBegin, GLint iEnd, TPhysicsTerrainScratch& rScratch);
+	void IntegrateAngular(GLint iBegin, GLint iEnd, GLfloat fDeltaTime);
+	void RefreshWorldBoxes(GLint iBegin, GLint iEnd);
+
+	void SetStateAt(GLint iIndex, const TPhysicsBodyState& rState);
+	void PushBackState(const TPhysicsBodyState& rState);
+	void MoveBody(GLint iTo, GLint iFrom);
+	void PopBackBody();
+
+private:
+	TPhysicsFloat3Array m_Position;
+	TPhysicsFloat3Array m_PrevPosition;
+	TPhysicsFloat3Array m_Rotation;
+	TPhysicsFloat3Array m_PrevRotation;
+	TPhysicsFloat3Array m_Scale;
+	TPhysicsFloat3Array m_Velocity;
+	TPhysicsFloat3Array m_Acceleration;
+	TPhysicsFloat3Array m_AngularVelocity;
+	TPhysicsFloat3Array m_Torque;
+
+	std::vector<GLfloat> m_vFriction;
+	std::vector<GLfloat> m_vGravity;
+	std::vector<GLfloat> m_vRestitution;
+	std::vector<GLfloat> m_vMomentOfInertia;
+	std::vector<GLubyte> m_vFlags;
+	std::vector<CTerrainMap*> m_vTerrainMaps;
+
+	TPhysicsFloat3Array m_LocalMin;
+	TPhysicsFloat3Array m_LocalMax;
+	TPhysicsFloat3Array m_WorldMin;
+	TPhysicsFloat3Array m_WorldMax;
+
+	std::vector<CPhysicsObject*> m_vOwners;
+	std::vector<GLuint> m_vBodySlots;		// Dense index -> slot
+
+	std::vector<GLuint> m_vSlotIndices;		// Slot -> dense index, PHYSICS_BODY_INVALID_SLOT when free
+	std::vector<GLuint> m_vSlotGenerations;
+	std::vector<GLuint> m_vFreeSlots;
+
+	// One per PHYSICS_BODIES_GRAIN chunk, a chunk runs on one thread at a time and reuses its buffers every step
+	std::vector<TPhysicsTerrainScratch> m_vTerrainScratch;
+};
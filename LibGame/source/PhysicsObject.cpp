@@ -3,6 +3,7 @@
 
 CPhysicsObject::CPhysicsObject()
 {
+	m_pBodies = nullptr;
 	Reset();
 }
 
@@ -14,6 +15,7 @@ CPhysicsObject::~CPhysicsObject()
 void CPhysicsObject::Reset()
 {
 	m_WorldTranslation.SetPosition(SVector3Df(0.0f, 0.0f, 0.0f));
+	m_PrevWorldTranslation = m_WorldTranslation;
 	m_v3Velocity.SetToZero();
 	m_v3Acceleration.SetToZero();
 	m_fMass = 1.0f;
@@ -30,6 +32,8 @@ void CPhysicsObject::Reset()
 	m_pTerrainMap = nullptr;
 	m_bSelectedObject = false;
 	m_lObjectID = 0;
+
+	SyncBody();
 }
 
 const SVector3Df& CPhysicsObject::GetPosition() const
@@ -40,6 +44,8 @@ const SVector3Df& CPhysicsObject::GetPosition() const
 void CPhysicsObject::SetPosition(const SVector3Df& v3Pos)
 {
 	 m_WorldTranslation.SetPosition(v3Pos);
+	 m_PrevWorldTranslation.SetPosition(v3Pos);
+	SyncBody();
 }
 
 const SVector3Df& CPhysicsObject::GetRotation() const
@@ -50,6 +56,8 @@ const SVector3Df& CPhysicsObject::GetRotation() const
 void CPhysicsObject::SetRotation(const SVector3Df& v3Rot)
 {
 	m_WorldTranslation.SetRotation(v3Rot);
+	m_PrevWorldTranslation.SetRotation(v3Rot);
+	SyncBody();
 }
 
 const SVector3Df& CPhysicsObject::GetScale() const
@@ -60,6 +68,8 @@ const SVector3Df& CPhysicsObject::GetScale() const
 void CPhysicsObject::SetScale(const SVector3Df& v3Scale)
 {
 	m_WorldTranslation.SetScale(v3Scale);
+	m_PrevWorldTranslation.SetScale(v3Scale);
+	SyncBody();
 }
 
 const CWorldTranslation& CPhysicsObject::GetWorldTranslation() const
@@ -70,6 +80,39 @@ const CWorldTranslation& CPhysicsObject::GetWorldTranslation() const
 void CPhysicsObject::SetWorldTranslation(const CWorldTranslation& worldT)
 {
 	m_WorldTranslation = worldT;
+	m_PrevWorldTranslation = worldT;
+	SyncBody();
+}
+
+/*
+ * GetInterpolatedMatrix - World matrix between the last two physics steps.
+ * @fAlpha: 0 gives the state before the last step, 1 the current one.
+ *
+ * Physics runs at a fixed step, the frame usually lands in between two
+ * steps. Blending position and rotation hides the stepping when the frame
+ * rate is above the physics rate. Setters move both states, so teleports
+ * are not blended. Each Euler angle turns the short way, an angle wrapped
+ * from 350 to 10 degrees goes through 0 and not back through 180.
+ */
+CMatrix4Df CPhysicsObject::GetInterpolatedMatrix(GLfloat fAlpha) const
+{
+	fAlpha = MyMath::fminmax(0.0f, fAlpha, 1.0f);
+
+	const SVector3Df& v3PrevPos = m_PrevWorldTranslation.GetPosition();
+	const SVector3Df& v3PrevRot = m_PrevWorldTranslation.GetRotation();
+	const SVector3Df v3DeltaPos = m_WorldTranslation.GetPosition() - v3PrevPos;
+	const SVector3Df& v3Rot = m_WorldTranslation.GetRotation();
+	const SVector3Df v3DeltaRot(MyMath::fangledelta(v3PrevRot.x, v3Rot.x), MyMath::fangledelta(v3PrevRot.y, v3Rot.y), MyMath::fangledelta(v3PrevRot.z, v3Rot.z));
+
+	// Resting and static objects keep using their cached matrix
+	if (fAlpha == 1.0f ||
+		(v3DeltaPos.x == 0.0f && v3DeltaPos.y == 0.0f && v3DeltaPos.z == 0.0f &&
+		 v3DeltaRot.x == 0.0f && v3DeltaRot.y == 0.0f && v3DeltaRot.z == 0.0f))
+	{
+		return (m_WorldTranslation.GetMatrix());
+	}
+
+	return (CWorldTranslation::BuildMatrix(v3PrevPos + v3DeltaPos * fAlpha, v3PrevRot + v3DeltaRot * fAlpha, m_WorldTranslation.GetScale()));
 }
 
 const SVector3Df& CPhysicsObject::GetVelocity() const
@@ -80,6 +123,7 @@ const SVector3Df& CPhysicsObject::GetVelocity() const
 void CPhysicsObject::SetVelocity(const SVector3Df& v3Veloc)
 {
 	m_v3Velocity = v3Veloc;
+	SyncBody();
 }
 
 const SVector3Df& CPhysicsObject::GetAcceleration() const
@@ -90,6 +134,7 @@ const SVector3Df& CPhysicsObject::GetAcceleration() const
 void CPhysicsObject::SetAcceleration(const SVector3Df& v3Accel)
 {
 	m_v3Acceleration = v3Accel;
+	SyncBody();
 }
 
 GLfloat CPhysicsObject::GetMass() const
@@ -110,6 +155,7 @@ GLfloat CPhysicsObject::GetFriction() const
 void CPhysicsObject::SetFriction(GLfloat fFriction)
 {
 	m_fFriction = fFriction;
+	SyncBody();
 }
 
 GLfloat CPhysicsObject::GetGravity() const
@@ -120,6 +166,7 @@ GLfloat CPhysicsObject::GetGravity() const
 void CPhysicsObject::SetGravity(GLfloat fGravity)
 {
 	m_fGravityVal = fGravity;
+	SyncBody();
 }
 
 bool CPhysicsObject::UsesGravity() const
@@ -130,6 +177,7 @@ bool CPhysicsObject::UsesGravity() const
 void CPhysicsObject::SetUseGravity(bool bUseGravity)
 {
 	m_bUseGravity = bUseGravity;
+	SyncBody();
 }
 
 bool CPhysicsObject::IsCollidable() const
@@ -140,6 +188,7 @@ bool CPhysicsObject::IsCollidable() const
 void CPhysicsObject::SetCollidable(bool bCollidable)
 {
 	m_bIsCollidable = bCollidable;
+	SyncBody();
 }
 
 bool CPhysicsObject::IsOnGround() const
@@ -150,6 +199,7 @@ bool CPhysicsObject::IsOnGround() const
 void CPhysicsObject::SetOnGround(bool bOnGround)
 {
 	m_bIsOnGround = bOnGround;
+	SyncBody();
 }
 
 EObjectTypes CPhysicsObject::GetType() const
@@ -160,6 +210,7 @@ EObjectTypes CPhysicsObject::GetType() const
 void CPhysicsObject::SetType(EObjectTypes eType)
 {
 	m_ePhysicsType = eType;
+	SyncBody();
 }
 
 const SVector3Df& CPhysicsObject::GetAngularVelocity() const
@@ -170,6 +221,7 @@ const SVector3Df& CPhysicsObject::GetAngularVelocity() const
 void CPhysicsObject::SetAngularVelocity(const SVector3Df& v3AngVel)
 {
 	m_v3AngularVelocity = v3AngVel;
+	SyncBody();
 }
 
 const SVector3Df& CPhysicsObject::GetTorque() const
@@ -180,6 +232,7 @@ const SVector3Df& CPhysicsObject::GetTorque() const
 void CPhysicsObject::SetTorque(const SVector3Df& v3Torque)
 {
 	m_v3Torque = v3Torque;
+	SyncBody();
 }
 
 GLfloat CPhysicsObject::GetMomentOfInertia() const
@@ -190,11 +243,13 @@ GLfloat CPhysicsObject::GetMomentOfInertia() const
 void CPhysicsObject::SetMomentOfInertiay(GLfloat fMOIVal)
 {
 	m_fMomentOfInertia = fMOIVal;
+	SyncBody();
 }
 
 void CPhysicsObject::SetRestitution(GLfloat fRestitution)
 {
 	m_fRestitution = fRestitution;
+	SyncBody();
 }
 
 GLfloat CPhysicsObject::GetRestitution() const
@@ -205,6 +260,7 @@ GLfloat CPhysicsObject::GetRestitution() const
 void CPhysicsObject::SetTerrainMap(CTerrainMap* pTerrainMap)
 {
 	m_pTerrainMap = pTerrainMap;
+	SyncBody();
 }
 
 CTerrainMap* CPhysicsObject::GetTerrainMap()
@@ -215,6 +271,7 @@ CTerrainMap* CPhysicsObject::GetTerrainMap()
 void CPhysicsObject::SetBoundingBoxLocal(const TBoundingBox& boundBox)
 {
 	m_BoundingBoxLocal = boundBox;
+	SyncBody();
 }
 
 TBoundingBox CPhysicsObject::GetBoundingBoxLocal() const
@@ -225,6 +282,7 @@ TBoundingBox CPhysicsObject::GetBoundingBoxLocal() const
 void CPhysicsObject::SetBoundingBoxWorld(const TBoundingBox& boundBoxWorld)
 {
 	m_BoundingBoxWorld = boundBoxWorld;
+	SyncBody();
 }
 
 TBoundingBox CPhysicsObject::GetBoundingBoxWorld() const
@@ -252,8 +310,105 @@ void CPhysicsObject::SetObjectID(GLint64 lObjID)
 	m_lObjectID = lObjID;
 }
 
+void CPhysicsObject::AttachBody(CPhysicsBodies* pBodies, const TPhysicsBodyHandle& hBody)
+{
+	m_pBodies = pBodies;
+	m_hBody = hBody;
+}
+
+void CPhysicsObject::DetachBody()
+{
+	m_pBodies = nullptr;
+	m_hBody = TPhysicsBodyHandle();
+}
+
+const TPhysicsBodyHandle& CPhysicsObject::GetBodyHandle() const
+{
+	return (m_hBody);
+}
+
+void CPhysicsObject::GetBodyState(TPhysicsBodyState& rState) const
+{
+	rState.v3Position = m_WorldTranslation.GetPosition();
+	rState.v3PrevPosition = m_PrevWorldTranslation.GetPosition();
+	rState.v3Rotation = m_WorldTranslation.GetRotation();
+	rState.v3PrevRotation = m_PrevWorldTranslation.GetRotation();
+	rState.v3Scale = m_WorldTranslation.GetScale();
+	rState.v3Velocity = m_v3Velocity;
+	rState.v3Acceleration = m_v3Acceleration;
+	rState.v3AngularVelocity = m_v3AngularVelocity;
+	rState.v3Torque = m_v3Torque;
+
+	rState.fFriction = m_fFriction;
+	rState.fGravity = m_fGravityVal;
+	rState.fRestitution = m_fRestitution;
+	rState.fMomentOfInertia = m_fMomentOfInertia;
+
+	rState.ubFlags = 0;
+	if (m_ePhysicsType != OBJECT_TYPE_NONE && m_ePhysicsType != OBJECT_TYPE_STATIC)
+	{
+		rState.ubFlags |= PHYSICS_BODY_FLAG_MOVABLE;
+	}
+	if (m_bUseGravity)
+	{
+		rState.ubFlags |= PHYSICS_BODY_FLAG_GRAVITY;
+	}
+	if (m_bIsOnGround)
+	{
+		rState.ubFlags |= PHYSICS_BODY_FLAG_ON_GROUND;
+	}
+	if (m_bIsCollidable)
+	{
+		rState.ubFlags |= PHYSICS_BODY_FLAG_COLLIDABLE;
+	}
+
+	rState.pTerrainMap = m_pTerrainMap;
+
+	rState.v3LocalMin = m_BoundingBoxLocal.v3Min;
+	rState.v3LocalMax = m_BoundingBoxLocal.v3Max;
+	rState.v3WorldMin = m_BoundingBoxWorld.v3Min;
+	rState.v3WorldMax = m_BoundingBoxWorld.v3Max;
+}
+
+/*
+ * LoadBodyState - Copies the result of a world step into the object.
+ * @rState: State of the object's body after the step.
+ *
+ * Only the values a step writes are taken, and the body is not written
+ * back since it already holds them.
+ */
+void CPhysicsObject::LoadBodyState(const TPhysicsBodyState& rState)
+{
+	m_PrevWorldTranslation.SetPosition(rState.v3PrevPosition);
+	m_PrevWorldTranslation.SetRotation(rState.v3PrevRotation);
+	m_WorldTranslation.SetPosition(rState.v3Position);
+	m_WorldTranslation.SetRotation(rState.v3Rotation);
+
+	m_v3Velocity = rState.v3Velocity;
+	m_v3Acceleration = rState.v3Acceleration;
+	m_v3AngularVelocity = rState.v3AngularVelocity;
+	m_v3Torque = rState.v3Torque;
+	m_bIsOnGround = (rState.ubFlags & PHYSICS_BODY_FLAG_ON_GROUND) != 0;
+
+	m_BoundingBoxWorld = SBoundingBox(rState.v3WorldMin, rState.v3WorldMax);
+}
+
+void CPhysicsObject::SyncBody()
+{
+	if (!m_pBodies)
+	{
+		return;
+	}
+
+	TPhysicsBodyState state;
+	GetBodyState(state);
+	m_pBodies->SetState(m_hBody, state);
+}
+
 void CPhysicsObject::Update(float fDeltaTime)
 {
+	m_PrevWorldTranslation = m_WorldTranslation;
+
 	// Updating Object Physics
 	if (GetType() == OBJECT_TYPE_NONE || GetType() == OBJECT_TYPE_STATIC)
 	{
@@ -297,7 +452,7 @@ void CPhysicsObject::Update(float fDeltaTime)
 				m_v3Velocity.z *= groundFriction;
 
 				// Stop bouncing if velocity is very small
-				if (std::abs(m_v3Velocity.y) < 0.1f)
+				if (std::abs(m_v3Velocity.y) < PHYSICS_BOUNCE_STOP_SPEED)
 				{
 					m_v3Velocity.y = 0.0f;
 					m_bIsOnGround = true;
@@ -320,7 +475,7 @@ void CPhysicsObject::Update(float fDeltaTime)
 				m_v3Velocity.z *= slideFriction;
 
 				// Stop completely if both horizontal and vertical velocities are very small
-				if (std::abs(m_v3Velocity.x) < 0.05f && std::abs(m_v3Velocity.z) < 0.05f)
+				if (std::abs(m_v3Velocity.x) < PHYSICS_SLIDE_STOP_SPEED && std::abs(m_v3Velocity.z) < PHYSICS_SLIDE_STOP_SPEED)
 				{
 					m_v3Velocity.x = 0.0f;
 					m_v3Velocity.z = 0.0f;
@@ -348,8 +503,7 @@ void CPhysicsObject::Update(float fDeltaTime)
 		m_v3AngularVelocity += v3AngularAcceleration * fDeltaTime;
 
 		// Optionally, apply angular damping (rotational friction)
-		GLfloat fAngularDamping = 0.98f; // or (1.0f - friction * dt)
-		m_v3AngularVelocity *= fAngularDamping;
+		m_v3AngularVelocity *= PHYSICS_ANGULAR_DAMPING;
 
 		// Integrate angular velocity to rotation (Euler angles)
 		SVector3Df newRot = m_WorldTranslation.GetRotation() + GetAngularVelocity() * fDeltaTime;
@@ -360,6 +514,8 @@ void CPhysicsObject::Update(float fDeltaTime)
 	m_v3Torque.SetToZero();
 
 	m_BoundingBoxWorld = m_BoundingBoxLocal.Transform(m_WorldTranslation.GetMatrix());
+
+	SyncBody();
 }
 
 void CPhysicsObject::ApplyForce(const SVector3Df& v3Force)
@@ -370,6 +526,7 @@ void CPhysicsObject::ApplyForce(const SVector3Df& v3Force)
 	}
 
 	m_v3Acceleration += v3Force / m_fMass;
+	SyncBody();
 }
 
 void CPhysicsObject::ApplyImpulse(const SVector3Df& v3Impulse)
@@ -380,17 +537,20 @@ void CPhysicsObject::ApplyImpulse(const SVector3Df& v3Impulse)
 	}
 
 	m_v3Velocity += v3Impulse / m_fMass;
+	SyncBody();
 }
 
 void CPhysicsObject::Stop()
 {
 	m_v3Velocity.SetToZero();
 	m_v3Acceleration.SetToZero();
+	SyncBody();
 }
 
 void CPhysicsObject::EnableGravity(bool enable)
 {
 	m_bUseGravity = enable;
+	SyncBody();
 }
 
 bool CPhysicsObject::IsMoving() const
@@ -415,6 +575,7 @@ void CPhysicsObject::ApplyTorque(const SVector3Df& v3Torque)
 {
 	// For a real system, divide by moment of inertia
 	m_v3Torque += v3Torque;
+	SyncBody();
 }
 
 // Simple AABB collision check (expand as needed)
@@ -517,6 +678,9 @@ void CPhysicsObject::ResolveCollision(CPhysicsObject& other)
 		m_bIsOnGround = true;
 		other.m_bIsOnGround = true;
 	}
+
+	SyncBody();
+	other.SyncBody();
 }
 
 void CPhysicsObject::Launch(GLfloat fSpeed, GLfloat fElevationDeg, GLfloat fAzimuthDeg)
@@ -3,6 +3,7 @@
 #include "../../LibMath/source/stdafx.h"
 #include "../../LibTerrain/source/TerrainMap.h"
 #include "BoundingBox.h"
+#include "PhysicsBodies.h"
 
 // Simple physics body for game objects
 class CPhysicsObject
@@ -27,6 +28,9 @@ public:
 	const CWorldTranslation& GetWorldTranslation() const;
 	void SetWorldTranslation(const CWorldTranslation& worldT);
 
+	// World matrix blended between the last two physics steps, fAlpha in [0, 1]
+	CMatrix4Df GetInterpolatedMatrix(GLfloat fAlpha) const;
+
 	const SVector3Df& GetVelocity() const;
 	void SetVelocity(const SVector3Df& v3Veloc);
 
@@ -82,6 +86,15 @@ public:
 	GLint64 GetObjectID() const;
 	void SetObjectID(GLint64 lObjID);
 
+	// Body of the object in the arrays of CPhysicsWorld, attached by CPhysicsWorld::AddObject
+	void AttachBody(CPhysicsBodies* pBodies, const TPhysicsBodyHandle& hBody);
+	void DetachBody();
+	const TPhysicsBodyHandle& GetBodyHandle() const;
+
+	void GetBodyState(TPhysicsBodyState& rState) const;
+	// Takes back the values written by a step of the world
+	void LoadBodyState(const TPhysicsBodyState& rState);
+
 public:
 	// Physics step: update position and velocity based on acceleration, gravity, and friction
 	void Update(float fDeltaTime);
@@ -116,8 +129,13 @@ public:
 	// launch your object at a specific angle and speed
 	void Launch(GLfloat fSpeed, GLfloat fElevationDeg, GLfloat fAzimuthDeg = 0.0f);
 
+private:
+	// Copies a change made through the object into its body
+	void SyncBody();
+
 private:
 	CWorldTranslation m_WorldTranslation;	// World Translation of the object (position, scale, rotation, height)
+	CWorldTranslation m_PrevWorldTranslation;	// World Translation before the last physics step, for interpolation
 	SVector3Df m_v3Velocity;				// Velocity vector
 	SVector3Df m_v3Acceleration;			// Acceleration vector
 
@@ -145,4 +163,7 @@ private:
 	bool m_bSelectedObject;					// Is the object selected in the editor or game
 
 	GLint64 m_lObjectID;					// Unique ID for the object, can be used for selection or identification
+
+	CPhysicsBodies* m_pBodies;				// Arrays holding the body while the object is in the world
+	TPhysicsBodyHandle m_hBody;
 };
\ No newline at end of file
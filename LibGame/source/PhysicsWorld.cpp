@@ -1,62 +1,104 @@
 #include "Stdafx.h"
 #include "PhysicsWorld.h"
 #include "SpatialGrid.h"
+#include "SweepAndPrune.h"
 #include "PhysicsObject.h"
 
 CPhysicsWorld::CPhysicsWorld()
 {
-	m_pSpatialGrid = new CSpatialGrid(100.0f); // Default cell size
+	m_pBroadphase = new CSpatialGrid(100.0f); // Default cell size
+	m_eBroadphaseType = BROADPHASE_SPATIAL_GRID;
 	m_bUpdatePhysics = true;
+
+	m_fFixedTimeStep = PHYSICS_FIXED_TIMESTEP;
+	m_fAccumulator = 0.0f;
+	m_iMaxSubSteps = PHYSICS_MAX_SUBSTEPS;
 }
 
 CPhysicsWorld::~CPhysicsWorld()
 {
-	safe_delete(m_pSpatialGrid);
+	safe_delete(m_pBroadphase);
+
+	std::vector<CPhysicsObject*> vObjects = m_Bodies.GetOwners();
+	m_Bodies.Clear();
 
-	for (CPhysicsObject* pObject : m_vPhysicsObjects)
+	for (CPhysicsObject* pObject : vObjects)
 	{
+		pObject->DetachBody();
 		safe_delete(pObject);
 	}
-
-	m_vPhysicsObjects.clear();
 }
 
+/*
+ * Update - Advances the simulation by a frame time.
+ * @fDeltaTime: Seconds elapsed since the previous frame.
+ *
+ * The frame time is accumulated and consumed in steps of the fixed time
+ * step, so the simulation does not depend on the framerate. At most
+ * m_iMaxSubSteps steps run per frame; the time beyond that is dropped so a
+ * slow frame does not ask for even more steps on the next one. What is
+ * left in the accumulator is exposed by GetInterpolationAlpha().
+ */
 void CPhysicsWorld::Update(GLfloat fDeltaTime)
 {
 	if (!IsUpdatePhysics())
 	{
 		sys_log("CPhysicsWorld::Update: Not Updating Physics");
+		m_fAccumulator = 0.0f;
 		return;
 	}
 
-	// 1. Update object positions first
-	for (CPhysicsObject* pObject : m_vPhysicsObjects)
+	if (fDeltaTime > 0.0f)
 	{
-		if (pObject)
-		{
-			pObject->Update(fDeltaTime);
-		}
+		m_fAccumulator += fDeltaTime;
+	}
+
+	GLint iSteps = 0;
+	while (m_fAccumulator >= m_fFixedTimeStep && iSteps < m_iMaxSubSteps)
+	{
+		Step(m_fFixedTimeStep);
+		m_fAccumulator -= m_fFixedTimeStep;
+		iSteps++;
+	}
+
+	if (m_fAccumulator >= m_fFixedTimeStep)
+	{
+		m_fAccumulator = std::fmod(m_fAccumulator, m_fFixedTimeStep);
 	}
+}
 
-	// 2. Populate the grid with the new object positions
-	m_pSpatialGrid->Clear();
+/*
+ * Step - One fixed step of the simulation.
+ * @fDeltaTime: Seconds simulated.
+ *
+ * The bodies are integrated on their arrays, then the objects that can
+ * move take their new state back before the broadphase and the
+ * collisions, which still work on the objects, look at them.
+ */
+void CPhysicsWorld::Step(GLfloat fDeltaTime)
+{
+	// 1. Update object positions first
+	m_Bodies.Integrate(fDeltaTime);
+	LoadMovedObjects();
 
-	// Loop through all physics objects
-	for (CPhysicsObject* pObject : m_vPhysicsObjects)
+	// 2. Move the objects in the broadphase
+	for (CPhysicsObject* pObject : m_Bodies.GetOwners())
 	{
-		// Ensure the object is valid and collidable
-		if (pObject && pObject->IsCollidable())
+		if (pObject->IsCollidable())
 		{
-			// Add the object to the spatial grid
-			m_pSpatialGrid->AddObject(pObject);
+			m_pBroadphase->UpdateObject(pObject);
+		}
+		else
+		{
+			m_pBroadphase->RemoveObject(pObject);
 		}
 	}
 
-	// 3. Get potential collision pairs from the grid
-	auto potentialCollisions = m_pSpatialGrid->GetPotentialCollisions();
+	// 3. Get potential collision pairs from the broadphase
+	const std::vector<TCollisionPair>& potentialCollisions = m_pBroadphase->GetPotentialCollisions();
 
 	// 4. Resolve collisions for each pair
-	for (auto& pair : potentialCollisions)
+	for (const TCollisionPair& pair : potentialCollisions)
 	{
 		CPhysicsObject* pObjA = pair.first;
 		CPhysicsObject* pObjB = pair.second;
@@ -70,112 +112,163 @@ void CPhysicsWorld::Update(GLfloat fDeltaTime)
 	}
 }
 
-void CPhysicsWorld::AddObject(CPhysicsObject* pObject)
+void CPhysicsWorld::LoadMovedObjects()
 {
-	if (pObject)
+	TPhysicsBodyState state;
+
+	for (GLint i = 0; i < m_Bodies.GetCount(); i++)
 	{
-		m_vPhysicsObjects.push_back(pObject);
+		if (m_Bodies.IsMovableAt(i))
+		{
+			m_Bodies.GetStateAt(i, state);
+			m_Bodies.GetOwnerAt(i)->LoadBodyState(state);
+		}
 	}
 }
 
-void CPhysicsWorld::RemoveObject(CPhysicsObject* pObject)
+void CPhysicsWorld::SetFixedTimeStep(GLfloat fTimeStep)
 {
-	auto it = std::remove(m_vPhysicsObjects.begin(), m_vPhysicsObjects.end(), pObject);
-	if (it != m_vPhysicsObjects.end())
+	if (fTimeStep <= 0.0f)
 	{
-		safe_delete(pObject);
-
-		m_vPhysicsObjects.erase(it, m_vPhysicsObjects.end());
+		sys_err("CPhysicsWorld::SetFixedTimeStep: Invalid time step %f", fTimeStep);
+		return;
 	}
+
+	m_fFixedTimeStep = fTimeStep;
+	m_fAccumulator = 0.0f;
 }
 
-void CPhysicsWorld::SetUpdatePhysics(bool bUpdate)
+GLfloat CPhysicsWorld::GetFixedTimeStep() const
 {
-	m_bUpdatePhysics = bUpdate;
+	return (m_fFixedTimeStep);
 }
 
-bool CPhysicsWorld::IsUpdatePhysics() const
+void CPhysicsWorld::SetMaxSubSteps(GLint iMaxSubSteps)
 {
-	return m_bUpdatePhysics;
+	m_iMaxSubSteps = std::max(iMaxSubSteps, 1);
 }
 
-/*
- * RayAABBIntersection - Checks if a ray intersects an axis-aligned bounding box (AABB).
- * This is a standard and efficient "slab test" algorithm.
- * It checks for intersection between a ray and an axis-aligned bounding box.
- * @param ray The ray to test against the AABB.
- * @box The axis-aligned bounding box to test against.
- * @fIntersectionDistance The distance from the ray's origin to the intersection point, if any.
- * @return True if the ray intersects the AABB, false otherwise.
- */
-bool CPhysicsWorld::RayAABBIntersection(const CRay& ray, const SBoundingBox& box, GLfloat& fIntersectionDistance)
+GLint CPhysicsWorld::GetMaxSubSteps() const
 {
-	SVector3Df v3InvDir = 1.0f / ray.GetDirection();
-
-	// Calculate the intersection distances along each axis
-	GLfloat fT1 = (box.v3Min.x - ray.GetOrigin().x) * v3InvDir.x;
-	GLfloat fT2 = (box.v3Max.x - ray.GetOrigin().x) * v3InvDir.x;
-
-	GLfloat fT3 = (box.v3Min.y - ray.GetOrigin().y) * v3InvDir.y;
-	GLfloat fT4 = (box.v3Max.y - ray.GetOrigin().y) * v3InvDir.y;
-
-	GLfloat fT5 = (box.v3Min.z - ray.GetOrigin().z) * v3InvDir.z;
-	GLfloat fT6 = (box.v3Max.z - ray.GetOrigin().z) * v3InvDir.z;
+	return (m_iMaxSubSteps);
+}
 
-	GLfloat fTMin = std::max(std::max(std::min(fT1, fT2), std::min(fT3, fT4)), std::min(fT5, fT6));
-	GLfloat fTMax = std::min(std::min(std::max(fT1, fT2), std::max(fT3, fT4)), std::max(fT5, fT6));
+GLfloat CPhysicsWorld::GetInterpolationAlpha() const
+{
+	return (m_fAccumulator / m_fFixedTimeStep);
+}
 
-	// If fTMax < 0, ray is intersecting AABB, but the whole AABB is behind us
-	if (fTMax < 0.0f)
+void CPhysicsWorld::AddObject(CPhysicsObject* pObject)
+{
+	if (!pObject || HasObject(pObject))
 	{
-		return (false);
+		return;
 	}
 
-	// If fTMin > fTMax, ray doesn't intersect AABB
-	if (fTMin > fTMax)
+	TPhysicsBodyState state;
+	pObject->GetBodyState(state);
+	pObject->AttachBody(&m_Bodies, m_Bodies.Add(pObject, state));
+}
+
+void CPhysicsWorld::RemoveObject(CPhysicsObject* pObject)
+{
+	if (!HasObject(pObject))
 	{
-		return (false);
+		return;
 	}
 
-	fIntersectionDistance = fTMin;
-	return (true);
+	m_pBroadphase->RemoveObject(pObject);
+	m_Bodies.Remove(pObject->GetBodyHandle());
+	pObject->DetachBody();
+	safe_delete(pObject);
 }
 
-CPhysicsObject* CPhysicsWorld::PickObject(const CRay& worldRay)
+bool CPhysicsWorld::HasObject(const CPhysicsObject* pObject) const
 {
-	// 1. Get a list of potential objects from the spatial grid.
-	// This is the broad phase, which quickly culls away most objects.
-	std::vector<CPhysicsObject*> potentialObjects = m_pSpatialGrid->GetObjectsAlongRay(worldRay);
+	return (pObject && m_Bodies.GetOwner(pObject->GetBodyHandle()) == pObject);
+}
 
-	CPhysicsObject* pClosestObject = nullptr;
-	GLfloat fClosestDistance = FLT_MAX;
+const CPhysicsBodies& CPhysicsWorld::GetBodies() const
+{
+	return (m_Bodies);
+}
 
-	// 2. Iterate through the potential objects and find the closest one that intersects with the ray.
-	// Perform precise intersection tests on the potential objects.
-	// This is the narrow phase.
-	for (CPhysicsObject* pObject : potentialObjects)
+void CPhysicsWorld::SetBroadphaseType(EBroadphaseType eType)
+{
+	if (eType == m_eBroadphaseType)
 	{
-		if (!pObject || !pObject->IsCollidable())
-		{
-			continue; // Skip invalid or non-collidable objects
-		}
+		return;
+	}
+
+	CBroadphase* pBroadphase = nullptr;
+	switch (eType)
+	{
+	case BROADPHASE_SPATIAL_GRID:
+		pBroadphase = new CSpatialGrid(100.0f);
+		break;
 
-		SBoundingBox box = pObject->GetBoundingBoxWorld();
-		GLfloat fObjectDistance = 0.0f;
+	case BROADPHASE_SWEEP_AND_PRUNE:
+		pBroadphase = new CSweepAndPrune();
+		break;
+
+	default:
+		sys_err("CPhysicsWorld::SetBroadphaseType: Unknown broadphase type %d", eType);
+		return;
+	}
 
-		if (RayAABBIntersection(worldRay, box, fObjectDistance))
+	for (CPhysicsObject* pObject : m_Bodies.GetOwners())
+	{
+		if (pObject->IsCollidable())
 		{
-			// We found an intersection. Check if it's the closest one yet.
-			if (fObjectDistance < fClosestDistance)
-			{
-				fClosestDistance = fObjectDistance;
-				pClosestObject = pObject;
-			}
+			pBroadphase->AddObject(pObject);
 		}
 	}
 
+	safe_delete(m_pBroadphase);
+	m_pBroadphase = pBroadphase;
+	m_eBroadphaseType = eType;
+}
+
+EBroadphaseType CPhysicsWorld::GetBroadphaseType() const
+{
+	return (m_eBroadphaseType);
+}
+
+void CPhysicsWorld::SetUpdatePhysics(bool bUpdate)
+{
+	m_bUpdatePhysics = bUpdate;
+}
+
+bool CPhysicsWorld::IsUpdatePhysics() const
+{
+	return m_bUpdatePhysics;
+}
+
+/*
+ * RayAABBIntersection - Checks if a ray intersects an axis-aligned bounding box (AABB).
+ * This is a standard and efficient "slab test" algorithm.
+ * It checks for intersection between a ray and an axis-aligned bounding box.
+ * @param ray The ray to test against the AABB.
+ * @box The axis-aligned bounding box to test against.
+ * @fIntersectionDistance The distance from the ray's origin to the intersection point, if any.
+ * @return True if the ray intersects the AABB, false otherwise.
+ */
+bool CPhysicsWorld::RayAABBIntersection(const CRay& ray, const SBoundingBox& box, GLfloat& fIntersectionDistance)
+{
+	const SVector3Df v3InvDir = ray.GetInverseDirection();
+	return (SBoundingBox::IntersectRay(ray.GetOrigin(), v3InvDir, box.v3Min, box.v3Max, &fIntersectionDistance));
+}
 
-	// 3. Return the closest object found.
-	return pClosestObject;
+/*
+ * PickObject - Closest collidable object whose AABB the ray hits.
+ * @worldRay: Ray to cast, objects entered past its range are not hit.
+ *
+ * The broadphase runs the slab tests itself while it walks the ray, so it
+ * can stop as soon as nothing further along can be closer.
+ */
+CPhysicsObject* CPhysicsWorld::PickObject(const CRay& worldRay)
+{
+	GLfloat fDistance = 0.0f;
+	return (m_pBroadphase->PickObject(worldRay, &fDistance));
 }
 
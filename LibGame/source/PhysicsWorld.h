@@ -2,24 +2,49 @@
 
 #include <glad/glad.h>
 #include <vector>
+#include "PhysicsBodies.h"
+#include "Broadphase.h"
 
-class CSpatialGrid;
 class CPhysicsObject;
 class CRay;
 struct SBoundingBox;
 
+constexpr GLfloat PHYSICS_FIXED_TIMESTEP = 1.0f / 60.0f;	// Simulated seconds per step
+constexpr GLint PHYSICS_MAX_SUBSTEPS = 5;					// Steps allowed in one frame before dropping time
+
 class CPhysicsWorld : public CSingleton<CPhysicsWorld>
 {
 public:
 	CPhysicsWorld();
 	~CPhysicsWorld();
 
+	// Called once per frame, runs as many fixed steps as the frame time covers
 	void Update(GLfloat fDeltaTime);
 
+	// One simulation step of exactly fDeltaTime seconds
+	void Step(GLfloat fDeltaTime);
+
+	void SetFixedTimeStep(GLfloat fTimeStep);
+	GLfloat GetFixedTimeStep() const;
+
+	void SetMaxSubSteps(GLint iMaxSubSteps);
+	GLint GetMaxSubSteps() const;
+
+	// Fraction of a step left in the accumulator, blends previous and current states for rendering
+	GLfloat GetInterpolationAlpha() const;
+
 	void AddObject(CPhysicsObject* pObject);
 
 	void RemoveObject(CPhysicsObject* pObject);
 
+	bool HasObject(const CPhysicsObject* pObject) const;
+
+	const CPhysicsBodies& GetBodies() const;
+
+	// Replaces the broadphase, the collidable objects are moved to the new one
+	void SetBroadphaseType(EBroadphaseType eType);
+	EBroadphaseType GetBroadphaseType() const;
+
 	void SetUpdatePhysics(bool bUpdate);
 
 	bool IsUpdatePhysics() const;
@@ -30,13 +55,22 @@ public:
 
 	/**
 	 * @brief Finds the closest object intersected by a ray.
-	 * @param worldRay The ray to cast into the world.
+	 * @param worldRay The ray to cast into the world, hits past its range are ignored.
 	 * @return A pointer to the closest physics object hit, or nullptr if none was hit.
 	 */
 	CPhysicsObject* PickObject(const CRay& worldRay);
 
 private:
-	std::vector<CPhysicsObject*> m_vPhysicsObjects;
-	CSpatialGrid* m_pSpatialGrid;
+	// Copies the state of the bodies a step moved into their objects
+	void LoadMovedObjects();
+
+private:
+	CPhysicsBodies m_Bodies;				// State of every object added, the objects are its owners
+	CBroadphase* m_pBroadphase;
+	EBroadphaseType m_eBroadphaseType;
 	bool m_bUpdatePhysics;
+
+	GLfloat m_fFixedTimeStep;
+	GLfloat m_fAccumulator;
+	GLint m_iMaxSubSteps;
 };
\ No newline at end of file
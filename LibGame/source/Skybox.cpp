@@ -37,7 +37,7 @@ CSkyBox::CSkyBox(CWindow* pWindow)
 	DefaultPreset();
 }
 
-void CSkyBox::Render(const CCamera& rCamera)
+void CSkyBox::Render()
 {
 	//m_pSkyBoxNew->BindForWriting();
 
@@ -47,20 +47,11 @@ void CSkyBox::Render(const CCamera& rCamera)
 	glDisable(GL_BLEND); // Disable blending to avoid transparency issues
 
     // Set up shader
+    // Inverse matrices, resolution, sun position and time come from the frame uniform block
     m_pSkyboxScreenSpace->GetShader().Use();
-    m_pSkyboxScreenSpace->GetShader().setMat4("m4Inv_proj", rCamera.GetProjectionMat().Inverse());
-    m_pSkyboxScreenSpace->GetShader().setMat4("m4Inv_view", rCamera.GetViewMatrix().Inverse());
-    m_pSkyboxScreenSpace->GetShader().setVec2("v2Resolution", SVector2Df(static_cast<float>(m_pWindow->GetWidth()), static_cast<float>(m_pWindow->GetHeight())));
-
-	SVector3Df v3LightDir = (m_v3LightPos);// - CCameraManager::Instance().GetCurrentCamera()->GetPosition());
-	v3LightDir.normalize();
-
-    m_pSkyboxScreenSpace->GetShader().setVec3("v3LightDir", v3LightDir);
     m_pSkyboxScreenSpace->GetShader().setVec3("v3SkyColorTop", m_v3SkyColorTop);
     m_pSkyboxScreenSpace->GetShader().setVec3("v3SkyColorBottom", m_v3SkyColorBottom);
 
-	float currentTime = static_cast<float>(glfwGetTime());
-	m_pSkyboxScreenSpace->GetShader().setFloat("fTime", currentTime);
 	m_pSkyboxScreenSpace->GetShader().setBool("bIsNight", m_bIsNight);
 	m_pSkyboxScreenSpace->GetShader().setFloat("fStarDensity", m_fStarDensity); // [0.5 - 3.0]
 	m_pSkyboxScreenSpace->GetShader().setFloat("fStarBrightness", m_fStarBrightness); // [0.1 - 2.0]
@@ -17,7 +17,8 @@ public:
 	CSkyBox(CWindow* pWindow);
 	~CSkyBox();
 
-	void Render(const CCamera& rCamera = CCameraManager::Instance().GetCurrentCameraRef());
+	// Draws with the view currently held by the frame uniform block
+	void Render();
 	void SetGUI();
 
 	//if the class will cointain some logic, so it must be refreshed at each game loop cycle by calling update. Otherwise just don't override it.  
@@ -7,169 +7,663 @@
 CSpatialGrid::CSpatialGrid(GLfloat fCellSize)
 {
 	m_fCellSize = fCellSize;
+	m_uiCellsCount = 0;
+	m_vSlots.assign(64, SPATIAL_GRID_SLOT_FREE);
+	m_uiDeletedSlots = 0;
+
+	m_OccupiedRange = { SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MIN_CELL };
+	m_bOccupiedRangeDirty = false;
+	m_uiQueryStamp = 0;
 }
 
 void CSpatialGrid::Clear()
 {
-	m_mapObjectsGrid.clear();
+	m_vCells.clear();
+	m_uiCellsCount = 0;
+	m_vSlots.assign(64, SPATIAL_GRID_SLOT_FREE);
+	m_uiDeletedSlots = 0;
+	m_vProxies.clear();
+	m_vFreeProxies.clear();
+	m_mapObjectProxies.clear();
+	m_vPotentialPairs.clear();
+
+	m_OccupiedRange = { SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MIN_CELL };
+	m_bOccupiedRangeDirty = false;
+	m_uiQueryStamp = 0;
 }
 
-void CSpatialGrid::AddObject(CPhysicsObject* pObject)
+/*
+ * GetKey - Packs signed cell coordinates into one key.
+ * @iX, @iY, @iZ: Cell coordinates in [SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MAX_CELL].
+ *
+ * Each coordinate is biased to an unsigned 21 bits field, so negative
+ * coordinates no longer sign-extend over the neighbouring fields.
+ */
+GLuint64 CSpatialGrid::GetKey(GLint iX, GLint iY, GLint iZ)
 {
-	// Get Actual Bounding Box in World Space
-	SBoundingBox worldBox = pObject->GetBoundingBoxWorld();
-	GLint iMinX = static_cast<GLint>(std::floor(worldBox.v3Min.x / m_fCellSize));
-	GLint iMinY = static_cast<GLint>(std::floor(worldBox.v3Min.y / m_fCellSize));
-	GLint iMinZ = static_cast<GLint>(std::floor(worldBox.v3Min.z / m_fCellSize));
+	const GLuint64 ulMask = (static_cast<GLuint64>(1) << SPATIAL_GRID_KEY_BITS) - 1;
 
-	GLint iMaxX = static_cast<GLint>(std::floor(worldBox.v3Max.x / m_fCellSize));
-	GLint iMaxY = static_cast<GLint>(std::floor(worldBox.v3Max.y / m_fCellSize));
-	GLint iMaxZ = static_cast<GLint>(std::floor(worldBox.v3Max.z / m_fCellSize));
+	const GLuint64 ulX = static_cast<GLuint64>(iX + SPATIAL_GRID_KEY_BIAS) & ulMask;
+	const GLuint64 ulY = static_cast<GLuint64>(iY + SPATIAL_GRID_KEY_BIAS) & ulMask;
+	const GLuint64 ulZ = static_cast<GLuint64>(iZ + SPATIAL_GRID_KEY_BIAS) & ulMask;
 
-	// Add the object to every cell its bounding box touches
-	for (GLint iX = iMinX; iX <= iMaxX; ++iX)
+	return ((ulX << (2 * SPATIAL_GRID_KEY_BITS)) | (ulY << SPATIAL_GRID_KEY_BITS) | ulZ);
+}
+
+// Fibonacci hashing, spreads neighbouring keys over the table
+GLuint64 CSpatialGrid::HashKey(GLuint64 ulKey)
+{
+	ulKey ^= ulKey >> 29;
+	ulKey *= 0x9E3779B97F4A7C15ULL;
+	return (ulKey ^ (ulKey >> 32));
+}
+
+GLint CSpatialGrid::GetCellCoord(GLfloat fWorldCoord) const
+{
+	GLfloat fCell = std::floor(fWorldCoord / m_fCellSize);
+	fCell = MyMath::fminmax(static_cast<GLfloat>(SPATIAL_GRID_MIN_CELL), fCell, static_cast<GLfloat>(SPATIAL_GRID_MAX_CELL));
+	return (static_cast<GLint>(fCell));
+}
+
+TGridCellRange CSpatialGrid::GetCellRange(const SBoundingBox& worldBox) const
+{
+	TGridCellRange cellRange;
+	cellRange.iMinX = GetCellCoord(worldBox.v3Min.x);
+	cellRange.iMinY = GetCellCoord(worldBox.v3Min.y);
+	cellRange.iMinZ = GetCellCoord(worldBox.v3Min.z);
+	cellRange.iMaxX = GetCellCoord(worldBox.v3Max.x);
+	cellRange.iMaxY = GetCellCoord(worldBox.v3Max.y);
+	cellRange.iMaxZ = GetCellCoord(worldBox.v3Max.z);
+	return (cellRange);
+}
+
+/*
+ * GetOccupiedRange - Cell range covering the cells of every object.
+ *
+ * Insertions grow it on the fly. A proxy leaving its border may shrink it,
+ * it is only recomputed from the proxies when asked for after that.
+ */
+const TGridCellRange& CSpatialGrid::GetOccupiedRange()
+{
+	if (!m_bOccupiedRangeDirty)
+	{
+		return (m_OccupiedRange);
+	}
+
+	m_OccupiedRange = { SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MIN_CELL, SPATIAL_GRID_MIN_CELL };
+
+	for (const TGridProxy& proxy : m_vProxies)
+	{
+		if (!proxy.pObject)
+		{
+			continue;
+		}
+
+		m_OccupiedRange.iMinX = std::min(m_OccupiedRange.iMinX, proxy.cellRange.iMinX);
+		m_OccupiedRange.iMinY = std::min(m_OccupiedRange.iMinY, proxy.cellRange.iMinY);
+		m_OccupiedRange.iMinZ = std::min(m_OccupiedRange.iMinZ, proxy.cellRange.iMinZ);
+		m_OccupiedRange.iMaxX = std::max(m_OccupiedRange.iMaxX, proxy.cellRange.iMaxX);
+		m_OccupiedRange.iMaxY = std::max(m_OccupiedRange.iMaxY, proxy.cellRange.iMaxY);
+		m_OccupiedRange.iMaxZ = std::max(m_OccupiedRange.iMaxZ, proxy.cellRange.iMaxZ);
+	}
+
+	m_bOccupiedRangeDirty = false;
+	return (m_OccupiedRange);
+}
+
+size_t CSpatialGrid::GetCellsCount() const
+{
+	return (m_uiCellsCount);
+}
+
+size_t CSpatialGrid::GetObjectsCount() const
+{
+	return (m_mapObjectProxies.size());
+}
+
+// Slot holding the cell of the key, the table size when there is none
+size_t CSpatialGrid::FindSlot(GLuint64 ulKey) const
+{
+	const size_t uiMask = m_vSlots.size() - 1;
+	size_t uiSlot = static_cast<size_t>(HashKey(ulKey)) & uiMask;
+
+	while (m_vSlots[uiSlot] != SPATIAL_GRID_SLOT_FREE)
+	{
+		if (m_vSlots[uiSlot] >= 0 && m_vCells[m_vSlots[uiSlot]].ulKey == ulKey)
+		{
+			return (uiSlot);
+		}
+
+		uiSlot = (uiSlot + 1) & uiMask;
+	}
+
+	return (m_vSlots.size());
+}
+
+GLint CSpatialGrid::FindCell(GLuint64 ulKey) const
+{
+	const size_t uiSlot = FindSlot(ulKey);
+	return ((uiSlot < m_vSlots.size()) ? m_vSlots[uiSlot] : -1);
+}
+
+/*
+ * FindOrCreateCell - Live cell of the given coordinates.
+ * @iX, @iY, @iZ: Cell coordinates.
+ *
+ * A missing cell takes the first tombstone met on its probe sequence, or
+ * the free slot ending it, and reuses a released cell past the live ones
+ * when there is one.
+ */
+GLint CSpatialGrid::FindOrCreateCell(GLint iX, GLint iY, GLint iZ)
+{
+	const GLuint64 ulKey = GetKey(iX, iY, iZ);
+
+	// Keep the load factor under 1/2 so probe sequences stay short, tombstones count
+	// towards the probes so a table full of them is rebuilt at the same size
+	if ((m_uiCellsCount + 1) * 2 > m_vSlots.size())
+	{
+		Rehash(m_vSlots.size() * 2);
+	}
+	else if ((m_uiCellsCount + m_uiDeletedSlots + 1) * 4 > m_vSlots.size() * 3)
 	{
-		for (GLint iY = iMinY; iY <= iMaxY; ++iY)
+		Rehash(m_vSlots.size());
+	}
+
+	const size_t uiMask = m_vSlots.size() - 1;
+	size_t uiSlot = static_cast<size_t>(HashKey(ulKey)) & uiMask;
+	size_t uiDeletedSlot = m_vSlots.size();
+
+	while (m_vSlots[uiSlot] != SPATIAL_GRID_SLOT_FREE)
+	{
+		if (m_vSlots[uiSlot] == SPATIAL_GRID_SLOT_DELETED)
 		{
-			for (GLint iZ = iMinZ; iZ <= iMaxZ; ++iZ)
+			if (uiDeletedSlot == m_vSlots.size())
 			{
-				GLint64 key = GetKey(iX, iY, iZ);
-				m_mapObjectsGrid[key].push_back(pObject);
+				uiDeletedSlot = uiSlot;
 			}
 		}
+		else if (m_vCells[m_vSlots[uiSlot]].ulKey == ulKey)
+		{
+			return (m_vSlots[uiSlot]);
+		}
+
+		uiSlot = (uiSlot + 1) & uiMask;
 	}
+
+	if (uiDeletedSlot != m_vSlots.size())
+	{
+		uiSlot = uiDeletedSlot;
+		m_uiDeletedSlots--;
+	}
+
+	const GLint iCell = static_cast<GLint>(m_uiCellsCount);
+	if (m_uiCellsCount == m_vCells.size())
+	{
+		m_vCells.push_back(TGridCell());
+	}
+	m_uiCellsCount++;
+
+	TGridCell& cell = m_vCells[iCell];
+	cell.ulKey = ulKey;
+	cell.iX = iX;
+	cell.iY = iY;
+	cell.iZ = iZ;
+	m_vSlots[uiSlot] = iCell;
+
+	return (iCell);
 }
 
-// The Most Important Function: Get Objects in a Cell
-std::vector<std::pair<CPhysicsObject*, CPhysicsObject*>> CSpatialGrid::GetPotentialCollisions()
+/*
+ * ReleaseCell - Drops a cell left without objects.
+ * @iCell: Live cell, its proxy list empty.
+ *
+ * The last live cell moves into its place so the live cells stay packed,
+ * the released one is kept past them with its proxy storage. Its slot
+ * becomes a tombstone: later keys may sit further on the same probe
+ * sequence.
+ */
+void CSpatialGrid::ReleaseCell(GLint iCell)
 {
-	// Clear previous results
-	std::vector<std::pair<CPhysicsObject*, CPhysicsObject*>> potentialPairs;
+	const size_t uiSlot = FindSlot(m_vCells[iCell].ulKey);
+	m_vSlots[uiSlot] = SPATIAL_GRID_SLOT_DELETED;
+	m_uiDeletedSlots++;
+
+	const GLint iLastCell = static_cast<GLint>(m_uiCellsCount - 1);
+	if (iCell != iLastCell)
+	{
+		m_vSlots[FindSlot(m_vCells[iLastCell].ulKey)] = iCell;
+		std::swap(m_vCells[iCell], m_vCells[iLastCell]);
+	}
+
+	m_uiCellsCount--;
+}
 
-	// To avoid checking the same pair twice (e.g. A-B and B-A)
-	std::set<std::pair<CPhysicsObject*, CPhysicsObject*>> uniquePairs;
+void CSpatialGrid::Rehash(size_t uiCapacity)
+{
+	m_vSlots.assign(uiCapacity, SPATIAL_GRID_SLOT_FREE);
+	m_uiDeletedSlots = 0;
 
-	// Iterate through each cell in the grid
-	for (const auto& cellPair : m_mapObjectsGrid)
+	const size_t uiMask = uiCapacity - 1;
+	for (GLint iCell = 0; iCell < static_cast<GLint>(m_uiCellsCount); iCell++)
 	{
-		const std::vector<CPhysicsObject*>& objectsInCell = cellPair.second;
-		if (objectsInCell.size() < 2)
+		size_t uiSlot = static_cast<size_t>(HashKey(m_vCells[iCell].ulKey)) & uiMask;
+		while (m_vSlots[uiSlot] != SPATIAL_GRID_SLOT_FREE)
 		{
-			continue; // No possible collisions in this cell
+			uiSlot = (uiSlot + 1) & uiMask;
 		}
 
-		// Check every unique pair of objects within this cell
-		for (size_t i = 0; i < objectsInCell.size(); ++i)
+		m_vSlots[uiSlot] = iCell;
+	}
+}
+
+void CSpatialGrid::InsertProxy(GLint iProxy)
+{
+	const TGridCellRange& cellRange = m_vProxies[iProxy].cellRange;
+
+	// Add the object to every cell its bounding box touches
+	for (GLint iX = cellRange.iMinX; iX <= cellRange.iMaxX; ++iX)
+	{
+		for (GLint iY = cellRange.iMinY; iY <= cellRange.iMaxY; ++iY)
 		{
-			for (size_t j = i + 1; j < objectsInCell.size(); ++j)
+			for (GLint iZ = cellRange.iMinZ; iZ <= cellRange.iMaxZ; ++iZ)
 			{
-				CPhysicsObject* pA = objectsInCell[i];
-				CPhysicsObject* pB = objectsInCell[j];
+				GLint iCell = FindOrCreateCell(iX, iY, iZ);
+				m_vCells[iCell].vProxies.push_back(iProxy);
+			}
+		}
+	}
+
+	m_OccupiedRange.iMinX = std::min(m_OccupiedRange.iMinX, cellRange.iMinX);
+	m_OccupiedRange.iMinY = std::min(m_OccupiedRange.iMinY, cellRange.iMinY);
+	m_OccupiedRange.iMinZ = std::min(m_OccupiedRange.iMinZ, cellRange.iMinZ);
+	m_OccupiedRange.iMaxX = std::max(m_OccupiedRange.iMaxX, cellRange.iMaxX);
+	m_OccupiedRange.iMaxY = std::max(m_OccupiedRange.iMaxY, cellRange.iMaxY);
+	m_OccupiedRange.iMaxZ = std::max(m_OccupiedRange.iMaxZ, cellRange.iMaxZ);
+}
 
-				// Ensure pair is ordered to prevent duplicates like (A,B) and (B,A)
-				if (pA > pB)
+void CSpatialGrid::EraseProxy(GLint iProxy)
+{
+	const TGridCellRange& cellRange = m_vProxies[iProxy].cellRange;
+
+	if (cellRange.iMinX == m_OccupiedRange.iMinX || cellRange.iMinY == m_OccupiedRange.iMinY || cellRange.iMinZ == m_OccupiedRange.iMinZ ||
+		cellRange.iMaxX == m_OccupiedRange.iMaxX || cellRange.iMaxY == m_OccupiedRange.iMaxY || cellRange.iMaxZ == m_OccupiedRange.iMaxZ)
+	{
+		m_bOccupiedRangeDirty = true;
+	}
+
+	for (GLint iX = cellRange.iMinX; iX <= cellRange.iMaxX; ++iX)
+	{
+		for (GLint iY = cellRange.iMinY; iY <= cellRange.iMaxY; ++iY)
+		{
+			for (GLint iZ = cellRange.iMinZ; iZ <= cellRange.iMaxZ; ++iZ)
+			{
+				GLint iCell = FindCell(GetKey(iX, iY, iZ));
+				if (iCell == -1)
+				{
+					continue;
+				}
+
+				// Order inside a cell does not matter, swap with the last one
+				std::vector<GLint>& vProxies = m_vCells[iCell].vProxies;
+				auto it = std::find(vProxies.begin(), vProxies.end(), iProxy);
+				if (it != vProxies.end())
 				{
-					std::swap(pA, pB);
+					*it = vProxies.back();
+					vProxies.pop_back();
 				}
 
-				uniquePairs.insert(std::make_pair(pA, pB));
+				if (vProxies.empty())
+				{
+					ReleaseCell(iCell);
+				}
 			}
 		}
 	}
+}
+
+void CSpatialGrid::AddObject(CPhysicsObject* pObject)
+{
+	if (!pObject)
+	{
+		return;
+	}
 
-	// assign the unique pairs to the potentialPairs vector
-	potentialPairs.assign(uniquePairs.begin(), uniquePairs.end());
-	return potentialPairs;
+	if (HasObject(pObject))
+	{
+		UpdateObject(pObject);
+		return;
+	}
+
+	GLint iProxy = 0;
+	if (!m_vFreeProxies.empty())
+	{
+		iProxy = m_vFreeProxies.back();
+		m_vFreeProxies.pop_back();
+	}
+	else
+	{
+		iProxy = static_cast<GLint>(m_vProxies.size());
+		m_vProxies.push_back(TGridProxy());
+	}
+
+	// Get Actual Bounding Box in World Space
+	const TBoundingBox worldBox = pObject->GetBoundingBoxWorld();
+	m_vProxies[iProxy].pObject = pObject;
+	m_vProxies[iProxy].cellRange = GetCellRange(worldBox);
+	m_vProxies[iProxy].v3Min = worldBox.v3Min;
+	m_vProxies[iProxy].v3Max = worldBox.v3Max;
+	m_vProxies[iProxy].uiQueryStamp = 0;
+	m_mapObjectProxies[pObject] = iProxy;
+
+	InsertProxy(iProxy);
 }
 
 /*
- * GetObjectsAlongRay - Get all unique objects from cells that a ray passes through.
- * This function uses a 3D grid to efficiently find objects that a ray intersects.
- * @param ray The world-space ray to test against the grid.
- * @return A vector of potential objects to perform precise intersection tests on.
+ * UpdateObject - Moves an object to the cells of its current AABB.
+ * @pObject: Object to move, inserted when not in the grid yet.
+ *
+ * The cells are not touched while the AABB stays over the same cell range,
+ * which is the common case for objects at rest or moving inside a cell.
  */
-std::vector<CPhysicsObject*> CSpatialGrid::GetObjectsAlongRay(const CRay& ray)
+void CSpatialGrid::UpdateObject(CPhysicsObject* pObject)
 {
-	constexpr int iMaxSteps = 500; // Limit to prevent infinite loops
+	auto it = m_mapObjectProxies.find(pObject);
+	if (it == m_mapObjectProxies.end())
+	{
+		AddObject(pObject);
+		return;
+	}
 
-	// Use a set to automatically handle duplicates, since an object can be in multiple cells.
-	std::set<CPhysicsObject*> uniqueObjects;
+	const GLint iProxy = it->second;
+	const TBoundingBox worldBox = pObject->GetBoundingBoxWorld();
+	const TGridCellRange newRange = GetCellRange(worldBox);
+	const TGridCellRange& oldRange = m_vProxies[iProxy].cellRange;
 
-	// Get the starting cell coordinates from the ray's origin.
-	GLint iCurrentX = static_cast<GLint>(std::floor(ray.GetOrigin().x / m_fCellSize));
-	GLint iCurrentY = static_cast<GLint>(std::floor(ray.GetOrigin().y / m_fCellSize));
-	GLint iCurrentZ = static_cast<GLint>(std::floor(ray.GetOrigin().z / m_fCellSize));
+	m_vProxies[iProxy].v3Min = worldBox.v3Min;
+	m_vProxies[iProxy].v3Max = worldBox.v3Max;
 
-	// Determine the direction of stepping (positive or negative) along each axis.
-	GLint iStepX = (ray.GetDirection().x >= 0) ? 1 : -1;
-	GLint iStepY = (ray.GetDirection().y >= 0) ? 1 : -1;
-	GLint iStepZ = (ray.GetDirection().z >= 0) ? 1 : -1;
+	if (newRange.iMinX == oldRange.iMinX && newRange.iMinY == oldRange.iMinY && newRange.iMinZ == oldRange.iMinZ &&
+		newRange.iMaxX == oldRange.iMaxX && newRange.iMaxY == oldRange.iMaxY && newRange.iMaxZ == oldRange.iMaxZ)
+	{
+		return;
+	}
 
-	// Calculate the distance along the ray to the next grid line crossing.
-	// Avoid division by zero if the ray is parallel to an axis.
-	GLfloat fNextBoundaryX = static_cast<GLfloat>(iCurrentX + iStepX) * m_fCellSize;
-	GLfloat fNextBoundaryY = static_cast<GLfloat>(iCurrentY + iStepY) * m_fCellSize;
-	GLfloat fNextBoundaryZ = static_cast<GLfloat>(iCurrentZ + iStepZ) * m_fCellSize;
+	EraseProxy(iProxy);
+	m_vProxies[iProxy].cellRange = newRange;
+	InsertProxy(iProxy);
+}
 
-	// Calculate the maximum distance to the next boundary along each axis.
-	GLfloat fMaxX = (ray.GetDirection().x != 0) ? (fNextBoundaryX - ray.GetOrigin().x) / ray.GetDirection().x : FLT_MAX;
-	GLfloat fMaxY = (ray.GetDirection().y != 0) ? (fNextBoundaryY - ray.GetOrigin().y) / ray.GetDirection().y : FLT_MAX;
-	GLfloat fMaxZ = (ray.GetDirection().z != 0) ? (fNextBoundaryZ - ray.GetOrigin().z) / ray.GetDirection().z : FLT_MAX;
+void CSpatialGrid::RemoveObject(CPhysicsObject* pObject)
+{
+	auto it = m_mapObjectProxies.find(pObject);
+	if (it == m_mapObjectProxies.end())
+	{
+		return;
+	}
 
-	// Calculate the distance to travel along the ray to cross a whole cell.
-	GLfloat fDeltaX = (ray.GetDirection().x != 0) ? m_fCellSize / std::abs(ray.GetDirection().x) : FLT_MAX;
-	GLfloat fDeltaY = (ray.GetDirection().y != 0) ? m_fCellSize / std::abs(ray.GetDirection().y) : FLT_MAX;
-	GLfloat fDeltaZ = (ray.GetDirection().z != 0) ? m_fCellSize / std::abs(ray.GetDirection().z) : FLT_MAX;
+	const GLint iProxy = it->second;
+	EraseProxy(iProxy);
 
-	// Walk the ray through the grid. Set a reasonable limit to prevent infinite loops.
-	for (GLint i = 0; i < iMaxSteps; i++) // Limit traversal to 500 cells
-	{
-		// Check for the next boundary crossing along each axis.
-		GLint64 key = GetKey(iCurrentX, iCurrentY, iCurrentZ);
+	m_vProxies[iProxy].pObject = nullptr;
+	m_vFreeProxies.push_back(iProxy);
+	m_mapObjectProxies.erase(it);
+}
+
+bool CSpatialGrid::HasObject(const CPhysicsObject* pObject) const
+{
+	return (m_mapObjectProxies.find(pObject) != m_mapObjectProxies.end());
+}
 
-		// Check if the current cell has objects
-		std::map<GLint64, std::vector<CPhysicsObject*>>::iterator it = m_mapObjectsGrid.find(key);
+/*
+ * GetPotentialCollisions - Pairs of objects whose AABBs overlap.
+ *
+ * Only objects sharing a cell are compared. Two objects spanning several
+ * cells meet in each of them, the pair is only reported from the first
+ * shared cell (the minimum corner of the intersection of both cell
+ * ranges), which removes the duplicates without a set. Overlapping AABBs
+ * always share that cell. Only the live cells are walked, the released
+ * ones past them are empty. The returned vector keeps its capacity
+ * between steps.
+ */
+const std::vector<TCollisionPair>& CSpatialGrid::GetPotentialCollisions()
+{
+	m_vPotentialPairs.clear();
 
-		// If we found objects in this cell, add them to our unique set.
-		if (it != m_mapObjectsGrid.end())
+	for (size_t uiCell = 0; uiCell < m_uiCellsCount; ++uiCell)
+	{
+		const TGridCell& cell = m_vCells[uiCell];
+		const std::vector<GLint>& vProxies = cell.vProxies;
+		if (vProxies.size() < 2)
 		{
-			// Add all objects from this cell to our set.
-			uniqueObjects.insert(it->second.begin(), it->second.end());
+			continue; // No possible collisions in this cell
 		}
 
-		// Advance to the next cell by finding the smallest fMax.
-		if (fMaxX < fMaxY)
+		// Check every unique pair of objects within this cell
+		for (size_t i = 0; i < vProxies.size(); ++i)
 		{
-			if (fMaxX < fMaxZ)
-			{
-				iCurrentX += iStepX; // Move in the X direction
-				fMaxX += fDeltaX; // Update the next boundary crossing distance
-			}
-			else
+			const TGridProxy& proxyA = m_vProxies[vProxies[i]];
+
+			for (size_t j = i + 1; j < vProxies.size(); ++j)
 			{
-				iCurrentZ += iStepZ; // Move in the Z direction
-				fMaxZ += fDeltaZ; // Update the next boundary crossing distance
+				const TGridProxy& proxyB = m_vProxies[vProxies[j]];
+
+				if (cell.iX != std::max(proxyA.cellRange.iMinX, proxyB.cellRange.iMinX) ||
+					cell.iY != std::max(proxyA.cellRange.iMinY, proxyB.cellRange.iMinY) ||
+					cell.iZ != std::max(proxyA.cellRange.iMinZ, proxyB.cellRange.iMinZ))
+				{
+					continue;
+				}
+
+				if (proxyA.v3Min.x > proxyB.v3Max.x || proxyA.v3Max.x < proxyB.v3Min.x ||
+					proxyA.v3Min.y > proxyB.v3Max.y || proxyA.v3Max.y < proxyB.v3Min.y ||
+					proxyA.v3Min.z > proxyB.v3Max.z || proxyA.v3Max.z < proxyB.v3Min.z)
+				{
+					continue;
+				}
+
+				m_vPotentialPairs.push_back(std::make_pair(proxyA.pObject, proxyB.pObject));
 			}
 		}
-		else
+	}
+
+	return (m_vPotentialPairs);
+}
+
+/*
+ * ClipRay - Part of the ray worth walking.
+ * @ray: World ray.
+ * @pfTBegin, @pfTEnd: Receive the ray parameters where the walk starts and ends.
+ *
+ * The ray from its origin to its range is clipped to the box of the
+ * occupied cells, false when nothing is left of it.
+ */
+bool CSpatialGrid::ClipRay(const CRay& ray, GLfloat* pfTBegin, GLfloat* pfTEnd)
+{
+	const TGridCellRange& occupiedRange = GetOccupiedRange();
+	if (occupiedRange.iMinX > occupiedRange.iMaxX)
+	{
+		return (false);
+	}
+
+	const SVector3Df& v3Origin = ray.GetOrigin();
+	const SVector3Df& v3Dir = ray.GetDirection();
+
+	const GLfloat fOrigins[3] = { v3Origin.x, v3Origin.y, v3Origin.z };
+	const GLfloat fDirs[3] = { v3Dir.x, v3Dir.y, v3Dir.z };
+	const GLfloat fMins[3] = {
+		static_cast<GLfloat>(occupiedRange.iMinX) * m_fCellSize,
+		static_cast<GLfloat>(occupiedRange.iMinY) * m_fCellSize,
+		static_cast<GLfloat>(occupiedRange.iMinZ) * m_fCellSize };
+	const GLfloat fMaxs[3] = {
+		static_cast<GLfloat>(occupiedRange.iMaxX + 1) * m_fCellSize,
+		static_cast<GLfloat>(occupiedRange.iMaxY + 1) * m_fCellSize,
+		static_cast<GLfloat>(occupiedRange.iMaxZ + 1) * m_fCellSize };
+
+	GLfloat fTMin = 0.0f;
+	GLfloat fTMax = ray.GetRayRange();
+
+	for (GLint iAxis = 0; iAxis < 3; iAxis++)
+	{
+		if (fDirs[iAxis] == 0.0f)
 		{
-			if (fMaxY < fMaxZ)
+			if (fOrigins[iAxis] < fMins[iAxis] || fOrigins[iAxis] > fMaxs[iAxis])
 			{
-				iCurrentY += iStepY; // Move in the Y direction
-				fMaxY += fDeltaY; // Update the next boundary crossing distance
+				return (false);
 			}
-			else
+			continue;
+		}
+
+		GLfloat fT0 = (fMins[iAxis] - fOrigins[iAxis]) / fDirs[iAxis];
+		GLfloat fT1 = (fMaxs[iAxis] - fOrigins[iAxis]) / fDirs[iAxis];
+		if (fT0 > fT1)
+		{
+			std::swap(fT0, fT1);
+		}
+
+		fTMin = MyMath::fmax(fTMin, fT0);
+		fTMax = MyMath::fmin(fTMax, fT1);
+	}
+
+	*pfTBegin = fTMin;
+	*pfTEnd = fTMax;
+	return (fTMin <= fTMax);
+}
+
+// Stamps of the proxies met by the current query, restarted from 1 after a wrap around
+GLuint CSpatialGrid::NextQueryStamp()
+{
+	m_uiQueryStamp++;
+
+	if (m_uiQueryStamp == 0)
+	{
+		for (TGridProxy& proxy : m_vProxies)
+		{
+			proxy.uiQueryStamp = 0;
+		}
+
+		m_uiQueryStamp = 1;
+	}
+
+	return (m_uiQueryStamp);
+}
+
+/*
+ * GetObjectsAlongRay - Objects registered in the cells the ray crosses.
+ * @ray: World ray, walked from its origin up to its range.
+ *
+ * Only the part of the ray inside the occupied cells is walked. An object
+ * spanning several cells is reported once, the proxies met by this query
+ * carry its stamp. The objects come in the order the ray meets their
+ * cells.
+ */
+std::vector<CPhysicsObject*> CSpatialGrid::GetObjectsAlongRay(const CRay& ray)
+{
+	std::vector<CPhysicsObject*> vObjects;
+
+	GLfloat fTBegin, fTEnd;
+	if (!ClipRay(ray, &fTBegin, &fTEnd))
+	{
+		return (vObjects);
+	}
+
+	const GLuint uiStamp = NextQueryStamp();
+
+	TGridWalk3D walk;
+	walk.Begin(ray.GetOrigin(), ray.GetDirection(), fTBegin, m_fCellSize, m_OccupiedRange);
+
+	do
+	{
+		const GLint iCell = FindCell(GetKey(walk.iX, walk.iY, walk.iZ));
+		if (iCell != -1)
+		{
+			for (const GLint iProxy : m_vCells[iCell].vProxies)
 			{
-				iCurrentZ += iStepZ; // Move in the Z direction
-				fMaxZ += fDeltaZ; // Update the next boundary crossing distance
+				TGridProxy& proxy = m_vProxies[iProxy];
+				if (proxy.uiQueryStamp != uiStamp)
+				{
+					proxy.uiQueryStamp = uiStamp;
+					vObjects.push_back(proxy.pObject);
+				}
 			}
 		}
-	}
 
-	// Convert the set of unique objects to a vector and return it.
-	if (!uniqueObjects.empty())
+		if (walk.GetExitT() >= fTEnd)
+		{
+			break;
+		}
+
+		walk.Step();
+	} while (walk.IsInside(m_OccupiedRange));
+
+	return (vObjects);
+}
+
+/*
+ * PickObject - Closest collidable object the ray enters within its range.
+ * @ray: World ray.
+ * @pfDistance: Receives the ray parameter of the hit, FLT_MAX when none.
+ *
+ * Same walk as GetObjectsAlongRay with the slab tests done cell by cell.
+ * An object not met yet is entered in a cell further along, past the exit
+ * of the current cell, so the walk stops once the closest hit comes before
+ * that exit. The exit is accumulated cell after cell, a margin of
+ * SPATIAL_GRID_RAY_EPSILON times the cell size plus the distance covers
+ * its rounding.
+ */
+CPhysicsObject* CSpatialGrid::PickObject(const CRay& ray, GLfloat* pfDistance)
+{
+	CPhysicsObject* pClosestObject = nullptr;
+	GLfloat fClosestT = FLT_MAX;
+	*pfDistance = FLT_MAX;
+
+	GLfloat fTBegin, fTEnd;
+	if (!ClipRay(ray, &fTBegin, &fTEnd))
 	{
-		return std::vector<CPhysicsObject*>(uniqueObjects.begin(), uniqueObjects.end());
+		return (nullptr);
 	}
-	return std::vector<CPhysicsObject*>();
+
+	const GLuint uiStamp = NextQueryStamp();
+	const SVector3Df& v3Origin = ray.GetOrigin();
+	const SVector3Df v3InvDir = ray.GetInverseDirection();
+
+	TGridWalk3D walk;
+	walk.Begin(v3Origin, ray.GetDirection(), fTBegin, m_fCellSize, m_OccupiedRange);
+
+	do
+	{
+		const GLint iCell = FindCell(GetKey(walk.iX, walk.iY, walk.iZ));
+		if (iCell != -1)
+		{
+			for (const GLint iProxy : m_vCells[iCell].vProxies)
+			{
+				TGridProxy& proxy = m_vProxies[iProxy];
+				if (proxy.uiQueryStamp == uiStamp)
+				{
+					continue;
+				}
+
+				proxy.uiQueryStamp = uiStamp;
+
+				GLfloat fT = 0.0f;
+				if (proxy.pObject->IsCollidable() &&
+					SBoundingBox::IntersectRay(v3Origin, v3InvDir, proxy.v3Min, proxy.v3Max, &fT) &&
+					fT <= ray.GetRayRange() && fT < fClosestT)
+				{
+					fClosestT = fT;
+					pClosestObject = proxy.pObject;
+				}
+			}
+		}
+
+		const GLfloat fExitT = walk.GetExitT();
+		if (fExitT >= fTEnd || fClosestT < fExitT - (m_fCellSize + fExitT) * SPATIAL_GRID_RAY_EPSILON)
+		{
+			break;
+		}
+
+		walk.Step();
+	} while (walk.IsInside(m_OccupiedRange));
+
+	*pfDistance = fClosestT;
+	return (pClosestObject);
 }
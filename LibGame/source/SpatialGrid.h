@@ -1,39 +1,194 @@
 #pragma once
 
 #include <vector>
-#include <map>
-#include <set>
+#include <unordered_map>
+#include "Broadphase.h"
+#include "../../LibMath/source/vectors.h"
+#include "../../LibMath/source/utils.h"
 
-class CPhysicsObject;
-class CRay;
+struct SBoundingBox;
 
-class CSpatialGrid
+// Cell coordinates are stored on 21 bits per axis, biased so negative cells keep distinct keys
+constexpr GLint SPATIAL_GRID_KEY_BITS = 21;
+constexpr GLint SPATIAL_GRID_KEY_BIAS = 1 << (SPATIAL_GRID_KEY_BITS - 1);
+constexpr GLint SPATIAL_GRID_MIN_CELL = -SPATIAL_GRID_KEY_BIAS;
+constexpr GLint SPATIAL_GRID_MAX_CELL = SPATIAL_GRID_KEY_BIAS - 1;
+constexpr GLfloat SPATIAL_GRID_RAY_EPSILON = 1e-4f;	// Rounding margin of the ray walk, relative to the cell size plus the distance walked
+constexpr GLint SPATIAL_GRID_SLOT_FREE = -1;		// Hash slot never used since the last rehash, ends a probe sequence
+constexpr GLint SPATIAL_GRID_SLOT_DELETED = -2;		// Hash slot of a released cell, probed through and reused by insertions
+
+// Inclusive range of cells covered by an AABB
+typedef struct SGridCellRange
+{
+	GLint iMinX, iMinY, iMinZ;
+	GLint iMaxX, iMaxY, iMaxZ;
+} TGridCellRange;
+
+// An object registered in the grid and the cells it was inserted in
+typedef struct SGridProxy
+{
+	CPhysicsObject* pObject;
+	TGridCellRange cellRange;
+	SVector3Df v3Min;			// World AABB at the last update, filters the pairs sharing a cell
+	SVector3Df v3Max;
+	GLuint uiQueryStamp;		// Last ray query that met the proxy
+} TGridProxy;
+
+typedef struct SGridCell
+{
+	GLuint64 ulKey;
+	GLint iX, iY, iZ;
+	std::vector<GLint> vProxies;	// Indices in m_vProxies
+} TGridCell;
+
+/*
+ * TGridWalk3D - 3D DDA over the cells of a CSpatialGrid.
+ *
+ * Same walk as TGridWalk2D with the Y axis added: visits the cells crossed
+ * by v3Origin + t * v3Dir in order of t, GetExitT() is where the current
+ * cell is left. The start cell is clamped to the given range.
+ */
+typedef struct SGridWalk3D
+{
+	GLint iX, iY, iZ;
+	GLint iStepX, iStepY, iStepZ;
+	GLfloat fNextX, fNextY, fNextZ;		// Ray parameter of the next X / Y / Z grid plane
+	GLfloat fDeltaX, fDeltaY, fDeltaZ;	// Ray parameter span of one cell along X / Y / Z
+
+	void Begin(const SVector3Df& v3Origin, const SVector3Df& v3Dir, GLfloat fT, GLfloat fCellSize, const TGridCellRange& cellRange)
+	{
+		iX = static_cast<GLint>(std::floor((v3Origin.x + v3Dir.x * fT) / fCellSize));
+		iY = static_cast<GLint>(std::floor((v3Origin.y + v3Dir.y * fT) / fCellSize));
+		iZ = static_cast<GLint>(std::floor((v3Origin.z + v3Dir.z * fT) / fCellSize));
+		iX = MyMath::iminmax(cellRange.iMinX, iX, cellRange.iMaxX);
+		iY = MyMath::iminmax(cellRange.iMinY, iY, cellRange.iMaxY);
+		iZ = MyMath::iminmax(cellRange.iMinZ, iZ, cellRange.iMaxZ);
+
+		iStepX = (v3Dir.x >= 0.0f) ? 1 : -1;
+		iStepY = (v3Dir.y >= 0.0f) ? 1 : -1;
+		iStepZ = (v3Dir.z >= 0.0f) ? 1 : -1;
+
+		fDeltaX = (v3Dir.x != 0.0f) ? fCellSize / std::fabs(v3Dir.x) : FLT_MAX;
+		fDeltaY = (v3Dir.y != 0.0f) ? fCellSize / std::fabs(v3Dir.y) : FLT_MAX;
+		fDeltaZ = (v3Dir.z != 0.0f) ? fCellSize / std::fabs(v3Dir.z) : FLT_MAX;
+
+		fNextX = (v3Dir.x != 0.0f) ? (static_cast<GLfloat>(iX + (iStepX > 0 ? 1 : 0)) * fCellSize - v3Origin.x) / v3Dir.x : FLT_MAX;
+		fNextY = (v3Dir.y != 0.0f) ? (static_cast<GLfloat>(iY + (iStepY > 0 ? 1 : 0)) * fCellSize - v3Origin.y) / v3Dir.y : FLT_MAX;
+		fNextZ = (v3Dir.z != 0.0f) ? (static_cast<GLfloat>(iZ + (iStepZ > 0 ? 1 : 0)) * fCellSize - v3Origin.z) / v3Dir.z : FLT_MAX;
+	}
+
+	GLfloat GetExitT() const
+	{
+		return (MyMath::fmin(MyMath::fmin(fNextX, fNextY), fNextZ));
+	}
+
+	void Step()
+	{
+		if (fNextX < fNextY && fNextX < fNextZ)
+		{
+			iX += iStepX;
+			fNextX += fDeltaX;
+		}
+		else if (fNextY < fNextZ)
+		{
+			iY += iStepY;
+			fNextY += fDeltaY;
+		}
+		else
+		{
+			iZ += iStepZ;
+			fNextZ += fDeltaZ;
+		}
+	}
+
+	bool IsInside(const TGridCellRange& cellRange) const
+	{
+		return (iX >= cellRange.iMinX && iX <= cellRange.iMaxX &&
+			iY >= cellRange.iMinY && iY <= cellRange.iMaxY &&
+			iZ >= cellRange.iMinZ && iZ <= cellRange.iMaxZ);
+	}
+} TGridWalk3D;
+
+/**
+ * CSpatialGrid - Uniform grid broadphase over the physics objects.
+ *
+ * Cells live in a dense vector, found through an open addressing table
+ * (linear probing, power of two capacity) keyed by the packed cell
+ * coordinates. Only the cells holding objects are kept: a cell is released
+ * when its last object leaves, the last live cell takes its place and its
+ * slot becomes a tombstone reused by the next insertions. Released cells
+ * stay past the live count with their proxy storage, so objects moving
+ * back and forth do not reallocate it.
+ *
+ * Objects are tracked incrementally: UpdateObject() only touches the cells
+ * when the object's AABB covers a different cell range than last time.
+ *
+ * Ray queries walk the cells between the ray origin and its range, clipped
+ * to the cell range occupied by the objects, so their cost follows what
+ * the ray crosses rather than a fixed number of cells.
+ */
+class CSpatialGrid : public CBroadphase
 {
 public:
 	CSpatialGrid(GLfloat fCellSize = 100);
 
-	void Clear();
+	void Clear() override;
 
-	void AddObject(CPhysicsObject* pObject);
+	void AddObject(CPhysicsObject* pObject) override;
+	void UpdateObject(CPhysicsObject* pObject) override;
+	void RemoveObject(CPhysicsObject* pObject) override;
+	bool HasObject(const CPhysicsObject* pObject) const override;
 
-	// The Most Important Function: Get Objects in a Cell
-	std::vector<std::pair<CPhysicsObject*, CPhysicsObject*>> GetPotentialCollisions();
+	const std::vector<TCollisionPair>& GetPotentialCollisions() override;
 
 	/**
 	 * @brief Gets all unique objects from cells that a ray passes through.
-	 * @param ray The world-space ray to test against the grid.
+	 * @param ray The world-space ray to test against the grid, walked up to its range.
 	 * @return A vector of potential objects to perform precise intersection tests on.
 	 */
-	std::vector<CPhysicsObject*> GetObjectsAlongRay(const CRay& ray);
+	std::vector<CPhysicsObject*> GetObjectsAlongRay(const CRay& ray) override;
+	CPhysicsObject* PickObject(const CRay& ray, GLfloat* pfDistance) override;
+
+	GLint GetCellCoord(GLfloat fWorldCoord) const;
+	TGridCellRange GetCellRange(const SBoundingBox& worldBox) const;
+	// Cells covering every object, iMin > iMax when the grid is empty
+	const TGridCellRange& GetOccupiedRange();
+
+	static GLuint64 GetKey(GLint iX, GLint iY, GLint iZ);
+
+	size_t GetCellsCount() const;
+	size_t GetObjectsCount() const override;
+
+protected:
+	size_t FindSlot(GLuint64 ulKey) const;
+	GLint FindCell(GLuint64 ulKey) const;
+	GLint FindOrCreateCell(GLint iX, GLint iY, GLint iZ);
+	void ReleaseCell(GLint iCell);
+	void Rehash(size_t uiCapacity);
+
+	void InsertProxy(GLint iProxy);
+	void EraseProxy(GLint iProxy);
+
+	bool ClipRay(const CRay& ray, GLfloat* pfTBegin, GLfloat* pfTEnd);
+	GLuint NextQueryStamp();
+
+	static GLuint64 HashKey(GLuint64 ulKey);
 
 private:
 	GLfloat m_fCellSize;
-	std::map<GLint64, std::vector<CPhysicsObject*>> m_mapObjectsGrid; // Maps cell ID to objects in that cell
 
-	// Function to get the cell ID based on coordinates
-	GLint64 GetKey(GLint iX, GLint iY, GLint iZ) const
-	{
-		// A simple packing algorithm
-		return (static_cast<GLint64>(iX) << 40) | (static_cast<GLint64>(iY) << 20) | static_cast<GLint64>(iZ);
-	}
-};
\ No newline at end of file
+	std::vector<TGridCell> m_vCells;	// Dense cell storage, the live cells first then the released ones kept for reuse
+	size_t m_uiCellsCount;				// Live cells, the ones holding at least one proxy
+	std::vector<GLint> m_vSlots;		// Hash table, index in m_vCells or SPATIAL_GRID_SLOT_FREE / SPATIAL_GRID_SLOT_DELETED
+	size_t m_uiDeletedSlots;
+
+	std::vector<TGridProxy> m_vProxies;
+	std::vector<GLint> m_vFreeProxies;
+	std::unordered_map<const CPhysicsObject*, GLint> m_mapObjectProxies;
+
+	TGridCellRange m_OccupiedRange;
+	bool m_bOccupiedRangeDirty;		// A proxy left the border of m_OccupiedRange, recomputed by the next query
+	GLuint m_uiQueryStamp;
+
+	std::vector<TCollisionPair> m_vPotentialPairs;
+};
@@ -0,0 +1,351 @@
+#include "Stdafx.h"
+#include "SweepAndPrune.h"
+#include "PhysicsObject.h"
+#include "BoundingBox.h"
+#include "../../LibMath/source/ray.h"
+
+CSweepAndPrune::CSweepAndPrune()
+{
+	m_iAddedSinceSort = 0;
+	m_iSweepAxis = 0;
+	m_iSortedAxis = -1;
+}
+
+void CSweepAndPrune::Clear()
+{
+	m_vProxies.clear();
+	m_vFreeProxies.clear();
+	m_vRemovedProxies.clear();
+	m_mapObjectProxies.clear();
+	m_vSweepList.clear();
+
+	m_iAddedSinceSort = 0;
+	m_iSweepAxis = 0;
+	m_iSortedAxis = -1;
+	m_vSweepBounds.clear();
+	m_vSweepObjects.clear();
+	m_vPotentialPairs.clear();
+}
+
+void CSweepAndPrune::AddObject(CPhysicsObject* pObject)
+{
+	if (!pObject)
+	{
+		return;
+	}
+
+	if (HasObject(pObject))
+	{
+		UpdateObject(pObject);
+		return;
+	}
+
+	GLint iProxy = 0;
+	if (!m_vFreeProxies.empty())
+	{
+		iProxy = m_vFreeProxies.back();
+		m_vFreeProxies.pop_back();
+	}
+	else
+	{
+		iProxy = static_cast<GLint>(m_vProxies.size());
+		m_vProxies.push_back(TSweepProxy());
+	}
+
+	const TBoundingBox worldBox = pObject->GetBoundingBoxWorld();
+	m_vProxies[iProxy].pObject = pObject;
+	m_vProxies[iProxy].v3Min = worldBox.v3Min;
+	m_vProxies[iProxy].v3Max = worldBox.v3Max;
+	m_mapObjectProxies[pObject] = iProxy;
+
+	// Appended out of order, the next sort moves it to its place
+	TSweepEntry entry;
+	entry.fMin = worldBox.v3Min[m_iSweepAxis];
+	entry.iProxy = iProxy;
+	m_vSweepList.push_back(entry);
+
+	m_iAddedSinceSort++;
+}
+
+// Only the bounds are stored, the swept list is sorted again by the next GetPotentialCollisions
+void CSweepAndPrune::UpdateObject(CPhysicsObject* pObject)
+{
+	auto it = m_mapObjectProxies.find(pObject);
+	if (it == m_mapObjectProxies.end())
+	{
+		AddObject(pObject);
+		return;
+	}
+
+	const TBoundingBox worldBox = pObject->GetBoundingBoxWorld();
+	m_vProxies[it->second].v3Min = worldBox.v3Min;
+	m_vProxies[it->second].v3Max = worldBox.v3Max;
+}
+
+// The entry stays in the sweep list until the next sort, only the proxy is marked
+void CSweepAndPrune::RemoveObject(CPhysicsObject* pObject)
+{
+	auto it = m_mapObjectProxies.find(pObject);
+	if (it == m_mapObjectProxies.end())
+	{
+		return;
+	}
+
+	const GLint iProxy = it->second;
+	m_vProxies[iProxy].pObject = nullptr;
+	m_vRemovedProxies.push_back(iProxy);
+	m_mapObjectProxies.erase(it);
+}
+
+bool CSweepAndPrune::HasObject(const CPhysicsObject* pObject) const
+{
+	return (m_mapObjectProxies.find(pObject) != m_mapObjectProxies.end());
+}
+
+size_t CSweepAndPrune::GetObjectsCount() const
+{
+	return (m_mapObjectProxies.size());
+}
+
+GLint CSweepAndPrune::GetSweepAxis() const
+{
+	return (m_iSweepAxis);
+}
+
+/*
+ * InsertionSortList - Puts the sweep list back in order of its keys.
+ *
+ * Linear when the objects only moved a little since the last sort, each
+ * entry is shifted down past the ones it overtook.
+ */
+void CSweepAndPrune::InsertionSortList()
+{
+	std::vector<TSweepEntry>& vList = m_vSweepList;
+
+	for (size_t i = 1; i < vList.size(); i++)
+	{
+		const TSweepEntry entry = vList[i];
+
+		size_t j = i;
+		while (j > 0 && vList[j - 1].fMin > entry.fMin)
+		{
+			vList[j] = vList[j - 1];
+			j--;
+		}
+
+		vList[j] = entry;
+	}
+}
+
+/*
+ * SortAxis - Refreshes the keys of the sweep list and sorts it along an axis.
+ * @iAxis: 0 to 2 for X to Z.
+ *
+ * The entries of the removed proxies are dropped on the way, keeping the
+ * order of the others, and their proxies freed. The insertion sort is only
+ * used when the list was sorted along the same axis by the previous step
+ * and few proxies were appended since, otherwise it could go quadratic and
+ * the list is sorted from scratch.
+ */
+void CSweepAndPrune::SortAxis(GLint iAxis)
+{
+	std::vector<TSweepEntry>& vList = m_vSweepList;
+
+	size_t sLive = 0;
+	for (size_t i = 0; i < vList.size(); i++)
+	{
+		const TSweepProxy& proxy = m_vProxies[vList[i].iProxy];
+		if (!proxy.pObject)
+		{
+			continue;
+		}
+
+		vList[sLive].fMin = proxy.v3Min[iAxis];
+		vList[sLive].iProxy = vList[i].iProxy;
+		sLive++;
+	}
+
+	vList.resize(sLive);
+	m_vFreeProxies.insert(m_vFreeProxies.end(), m_vRemovedProxies.begin(), m_vRemovedProxies.end());
+	m_vRemovedProxies.clear();
+
+	const bool bFullSort = iAxis != m_iSortedAxis ||
+		m_iAddedSinceSort * SWEEP_AND_PRUNE_RESORT_DIVISOR > static_cast<GLint>(vList.size());
+
+	if (bFullSort)
+	{
+		std::sort(vList.begin(), vList.end(), [](const TSweepEntry& entryA, const TSweepEntry& entryB)
+		{
+			return (entryA.fMin < entryB.fMin);
+		});
+	}
+	else
+	{
+		InsertionSortList();
+	}
+
+	m_iSortedAxis = iAxis;
+	m_iAddedSinceSort = 0;
+}
+
+/*
+ * ChooseSweepAxis - Axis with the largest variance of the AABB centers.
+ *
+ * It separates the most proxies. The sweep only moves to another axis when
+ * its variance is SWEEP_AND_PRUNE_AXIS_SWITCH times larger, so two axes of
+ * about the same spread do not make it sort from scratch every step.
+ */
+GLint CSweepAndPrune::ChooseSweepAxis() const
+{
+	double dSum[SWEEP_AND_PRUNE_AXES] = { 0.0, 0.0, 0.0 };
+	double dSumSquares[SWEEP_AND_PRUNE_AXES] = { 0.0, 0.0, 0.0 };
+
+	for (const TSweepProxy& proxy : m_vProxies)
+	{
+		if (!proxy.pObject)
+		{
+			continue;
+		}
+
+		for (GLint iAxis = 0; iAxis < SWEEP_AND_PRUNE_AXES; iAxis++)
+		{
+			const double dCenter = 0.5 * (static_cast<double>(proxy.v3Min[iAxis]) + static_cast<double>(proxy.v3Max[iAxis]));
+			dSum[iAxis] += dCenter;
+			dSumSquares[iAxis] += dCenter * dCenter;
+		}
+	}
+
+	const double dCount = static_cast<double>(std::max<size_t>(m_mapObjectProxies.size(), 1));
+
+	double dVariances[SWEEP_AND_PRUNE_AXES];
+	GLint iBestAxis = 0;
+
+	for (GLint iAxis = 0; iAxis < SWEEP_AND_PRUNE_AXES; iAxis++)
+	{
+		const double dMean = dSum[iAxis] / dCount;
+		dVariances[iAxis] = dSumSquares[iAxis] / dCount - dMean * dMean;
+
+		if (dVariances[iAxis] > dVariances[iBestAxis])
+		{
+			iBestAxis = iAxis;
+		}
+	}
+
+	if (dVariances[iBestAxis] > dVariances[m_iSweepAxis] * static_cast<double>(SWEEP_AND_PRUNE_AXIS_SWITCH))
+	{
+		return (iBestAxis);
+	}
+
+	return (m_iSweepAxis);
+}
+
+/*
+ * GetPotentialCollisions - Pairs of objects whose AABBs overlap.
+ *
+ * The swept list is sorted again and the bounds of its proxies copied in
+ * order, then swept: the proxies after A are visited until one starts past
+ * the end of A, and those overlapping A on the two other axes too are
+ * reported. A pair is only met from its first proxy on the axis, so it is
+ * reported once.
+ */
+const std::vector<TCollisionPair>& CSweepAndPrune::GetPotentialCollisions()
+{
+	m_vPotentialPairs.clear();
+
+	m_iSweepAxis = ChooseSweepAxis();
+	SortAxis(m_iSweepAxis);
+
+	const GLint iAxis0 = m_iSweepAxis;
+	const GLint iAxis1 = (m_iSweepAxis + 1) % SWEEP_AND_PRUNE_AXES;
+	const GLint iAxis2 = (m_iSweepAxis + 2) % SWEEP_AND_PRUNE_AXES;
+	const std::vector<TSweepEntry>& vList = m_vSweepList;
+	const size_t sCount = vList.size();
+
+	m_vSweepBounds.resize(sCount);
+	m_vSweepObjects.resize(sCount);
+
+	for (size_t i = 0; i < sCount; i++)
+	{
+		const TSweepProxy& proxy = m_vProxies[vList[i].iProxy];
+		TSweepBounds& bounds = m_vSweepBounds[i];
+
+		bounds.fMin0 = proxy.v3Min[iAxis0];
+		bounds.fMax0 = proxy.v3Max[iAxis0];
+		bounds.fMin1 = proxy.v3Min[iAxis1];
+		bounds.fMax1 = proxy.v3Max[iAxis1];
+		bounds.fMin2 = proxy.v3Min[iAxis2];
+		bounds.fMax2 = proxy.v3Max[iAxis2];
+		m_vSweepObjects[i] = proxy.pObject;
+	}
+
+	const TSweepBounds* pBounds = m_vSweepBounds.data();
+
+	for (size_t i = 0; i < sCount; i++)
+	{
+		const TSweepBounds boundsA = pBounds[i];
+
+		for (size_t j = i + 1; j < sCount && pBounds[j].fMin0 <= boundsA.fMax0; j++)
+		{
+			const TSweepBounds& boundsB = pBounds[j];
+
+			if (boundsA.fMin1 > boundsB.fMax1 || boundsA.fMax1 < boundsB.fMin1 ||
+				boundsA.fMin2 > boundsB.fMax2 || boundsA.fMax2 < boundsB.fMin2)
+			{
+				continue;
+			}
+
+			m_vPotentialPairs.push_back(std::make_pair(m_vSweepObjects[i], m_vSweepObjects[j]));
+		}
+	}
+
+	return (m_vPotentialPairs);
+}
+
+std::vector<CPhysicsObject*> CSweepAndPrune::GetObjectsAlongRay(const CRay& ray)
+{
+	std::vector<CPhysicsObject*> vObjects;
+
+	const SVector3Df v3InvDir = ray.GetInverseDirection();
+	GLfloat fT = 0.0f;
+
+	for (const TSweepProxy& proxy : m_vProxies)
+	{
+		if (!proxy.pObject)
+		{
+			continue;
+		}
+
+		if (SBoundingBox::IntersectRay(ray.GetOrigin(), v3InvDir, proxy.v3Min, proxy.v3Max, &fT) && fT <= ray.GetRayRange())
+		{
+			vObjects.push_back(proxy.pObject);
+		}
+	}
+
+	return (vObjects);
+}
+
+CPhysicsObject* CSweepAndPrune::PickObject(const CRay& ray, GLfloat* pfDistance)
+{
+	CPhysicsObject* pClosestObject = nullptr;
+	GLfloat fClosestT = FLT_MAX;
+
+	const SVector3Df v3InvDir = ray.GetInverseDirection();
+	GLfloat fT = 0.0f;
+
+	for (const TSweepProxy& proxy : m_vProxies)
+	{
+		if (!proxy.pObject || !proxy.pObject->IsCollidable())
+		{
+			continue;
+		}
+
+		if (SBoundingBox::IntersectRay(ray.GetOrigin(), v3InvDir, proxy.v3Min, proxy.v3Max, &fT) && fT <= ray.GetRayRange() && fT < fClosestT)
+		{
+			fClosestT = fT;
+			pClosestObject = proxy.pObject;
+		}
+	}
+
+	*pfDistance = fClosestT;
+	return (pClosestObject);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <unordered_map>
+#include "Broadphase.h"
+#include "../../LibMath/source/vectors.h"
+
+constexpr GLint SWEEP_AND_PRUNE_AXES = 3;
+constexpr GLint SWEEP_AND_PRUNE_RESORT_DIVISOR = 8;		// Full sort instead of insertion sort once more than 1/8 of the proxies are new
+constexpr GLfloat SWEEP_AND_PRUNE_AXIS_SWITCH = 1.25f;	// Variance ratio another axis needs before the sweep moves to it
+
+// An object registered in the axis lists and its world AABB at the last update
+typedef struct SSweepProxy
+{
+	CPhysicsObject* pObject;
+	SVector3Df v3Min;
+	SVector3Df v3Max;
+} TSweepProxy;
+
+// A proxy in the sweep list, with its key so the sort only reads the list
+typedef struct SSweepEntry
+{
+	GLfloat fMin;
+	GLint iProxy;
+} TSweepEntry;
+
+// Bounds of a proxy read by the sweep, the swept axis first then the two others
+typedef struct SSweepBounds
+{
+	GLfloat fMin0, fMax0;
+	GLfloat fMin1, fMax1;
+	GLfloat fMin2, fMax2;
+} TSweepBounds;
+
+/**
+ * CSweepAndPrune - Sort and sweep broadphase over the physics objects.
+ *
+ * One list holds the proxies sorted by the minimum of their AABB on the
+ * swept axis, the axis where the objects are the most spread out. The pairs
+ * come from a sweep along it: a proxy is compared with the following ones
+ * until their minimum passes its maximum. The list persists between steps
+ * and objects move little from one step to the next, so an insertion sort
+ * puts it back in order in about one pass. When the sweep moves to another
+ * axis the list is sorted from scratch.
+ *
+ * A removed proxy is only marked, its entry is dropped by the next sort
+ * and its slot reused after that.
+ *
+ * Unlike CSpatialGrid there is no cell size to tune, crowded spots cost no
+ * more than the objects overlapping on the swept axis. Objects spread over
+ * a wide plane overlap a lot once projected on one axis though, there the
+ * grid compares fewer pairs.
+ */
+class CSweepAndPrune : public CBroadphase
+{
+public:
+	CSweepAndPrune();
+
+	void Clear() override;
+
+	void AddObject(CPhysicsObject* pObject) override;
+	void UpdateObject(CPhysicsObject* pObject) override;
+	void RemoveObject(CPhysicsObject* pObject) override;
+	bool HasObject(const CPhysicsObject* pObject) const override;
+
+	const std::vector<TCollisionPair>& GetPotentialCollisions() override;
+
+	// Both test the ray against the AABB of every proxy, there are no cells to walk
+	std::vector<CPhysicsObject*> GetObjectsAlongRay(const CRay& ray) override;
+	CPhysicsObject* PickObject(const CRay& ray, GLfloat* pfDistance) override;
+
+	size_t GetObjectsCount() const override;
+
+	// Axis swept by the last GetPotentialCollisions, 0 to 2 for X to Z
+	GLint GetSweepAxis() const;
+
+protected:
+	void SortAxis(GLint iAxis);
+	void InsertionSortList();
+	GLint ChooseSweepAxis() const;
+
+private:
+	std::vector<TSweepProxy> m_vProxies;
+	std::vector<GLint> m_vFreeProxies;
+	std::vector<GLint> m_vRemovedProxies;	// Still in the sweep list, free once the next sort dropped them
+	std::unordered_map<const CPhysicsObject*, GLint> m_mapObjectProxies;
+
+	std::vector<TSweepEntry> m_vSweepList;		// By v3Min on m_iSortedAxis once sorted
+	GLint m_iAddedSinceSort;
+	GLint m_iSweepAxis;
+	GLint m_iSortedAxis;			// Axis the list was sorted by on the previous step, -1 when none
+
+	// Copied in the order of the swept list, the sweep reads them linearly
+	std::vector<TSweepBounds> m_vSweepBounds;
+	std::vector<CPhysicsObject*> m_vSweepObjects;
+
+	std::vector<TCollisionPair> m_vPotentialPairs;
+};
@@ -2,6 +2,49 @@
 
 #include "matrix.h"
 
+constexpr GLint FRUSTUM_PLANES_NUM = 6;
+
+/*
+ * TCullBox - World space axis aligned box read by the culling functions.
+ *
+ * Only the two corners, so large arrays of them stay packed (24 bytes per
+ * box) while SFrustumCulling::CullBoxes streams through them.
+ */
+typedef struct SCullBox
+{
+	SVector3Df v3Min;
+	SVector3Df v3Max;
+
+	SCullBox() = default;
+
+	SCullBox(const SVector3Df& v3MinVal, const SVector3Df& v3MaxVal)
+	{
+		v3Min = v3MinVal;
+		v3Max = v3MaxVal;
+	}
+
+	/*
+	 * Transform - Box enclosing the local box v3LocalMin, v3LocalMax moved by mat.
+	 *
+	 * Arvo's method: the center is transformed as a point, the half extent
+	 * by the absolute value of the upper 3x3, no corner is visited.
+	 */
+	static SCullBox Transform(const SVector3Df& v3LocalMin, const SVector3Df& v3LocalMax, const CMatrix4Df& mat)
+	{
+		const SVector3Df v3Center = (v3LocalMin + v3LocalMax) * 0.5f;
+		const SVector3Df v3Extent = (v3LocalMax - v3LocalMin) * 0.5f;
+
+		SVector3Df v3WorldCenter, v3WorldExtent;
+		for (GLint i = 0; i < 3; i++)
+		{
+			v3WorldCenter[i] = mat.mat4[i][0] * v3Center.x + mat.mat4[i][1] * v3Center.y + mat.mat4[i][2] * v3Center.z + mat.mat4[i][3];
+			v3WorldExtent[i] = std::fabs(mat.mat4[i][0]) * v3Extent.x + std::fabs(mat.mat4[i][1]) * v3Extent.y + std::fabs(mat.mat4[i][2]) * v3Extent.z;
+		}
+
+		return (SCullBox(v3WorldCenter - v3WorldExtent, v3WorldCenter + v3WorldExtent));
+	}
+} TCullBox;
+
 struct SFrustum
 {
 	SVector4Df v4NearTopLeft;
@@ -63,14 +106,163 @@ struct SFrustumCulling
 		bool bIsInside = (
 			(m_v4LeftClipPlane.dot(v4Point) >= 0) &&
 			(m_v4RightClipPlane.dot(v4Point) <= 0) &&
-			// (m_v4BottomClipPlane.dot(v4Point) >= 0) &&
-			// (m_v4TopClipPlane.dot(v4Point) <= 0)&&
+			(m_v4BottomClipPlane.dot(v4Point) >= 0) &&
+			(m_v4TopClipPlane.dot(v4Point) <= 0) &&
 			(m_v4NearClipPlane.dot(v4Point) >= 0) &&
 			(m_v4FarClipPlane.dot(v4Point) <= 0));
 
 		return (bIsInside);
 	}
 
+	/*
+	 * IsBoxInsideViewFrustum - Tests an axis aligned box against the six planes.
+	 * @v3Min: Minimum corner of the box (world space).
+	 * @v3Max: Maximum corner of the box (world space).
+	 *
+	 * For every plane only the corner lying furthest on the inner side is
+	 * checked, the box is rejected as soon as that corner is outside. Boxes
+	 * crossing a frustum edge may be reported inside, never the opposite.
+	 */
+	bool IsBoxInsideViewFrustum(const SVector3Df& v3Min, const SVector3Df& v3Max) const
+	{
+		// Left, Bottom and Near keep the inside on their positive side
+		if (m_v4LeftClipPlane.dot(GetBoxCorner(m_v4LeftClipPlane, v3Min, v3Max, true)) < 0 ||
+			m_v4BottomClipPlane.dot(GetBoxCorner(m_v4BottomClipPlane, v3Min, v3Max, true)) < 0 ||
+			m_v4NearClipPlane.dot(GetBoxCorner(m_v4NearClipPlane, v3Min, v3Max, true)) < 0)
+		{
+			return (false);
+		}
+
+		// Right, Top and Far keep it on their negative side
+		if (m_v4RightClipPlane.dot(GetBoxCorner(m_v4RightClipPlane, v3Min, v3Max, false)) > 0 ||
+			m_v4TopClipPlane.dot(GetBoxCorner(m_v4TopClipPlane, v3Min, v3Max, false)) > 0 ||
+			m_v4FarClipPlane.dot(GetBoxCorner(m_v4FarClipPlane, v3Min, v3Max, false)) > 0)
+		{
+			return (false);
+		}
+
+		return (true);
+	}
+
+	/*
+	 * GetPlanes - The six planes with the inside on their positive side.
+	 * @pv4Planes: FRUSTUM_PLANES_NUM planes (a, b, c, d), not normalized.
+	 *
+	 * Right, Top and Far are negated, so one test fits every plane for
+	 * CullBoxes.
+	 */
+	void GetPlanes(SVector4Df* pv4Planes) const
+	{
+		pv4Planes[0] = m_v4LeftClipPlane;
+		pv4Planes[1] = m_v4RightClipPlane * -1.0f;
+		pv4Planes[2] = m_v4BottomClipPlane;
+		pv4Planes[3] = m_v4TopClipPlane * -1.0f;
+		pv4Planes[4] = m_v4NearClipPlane;
+		pv4Planes[5] = m_v4FarClipPlane * -1.0f;
+	}
+
+	/*
+	 * CullBoxes - Visible boxes of an array.
+	 * @pBoxes: uiCount world space boxes.
+	 * @pv4Planes: FRUSTUM_PLANES_NUM planes from GetPlanes.
+	 * @v3Eye: Camera position, for the distance test.
+	 * @fMaxDistance: Boxes further than this from v3Eye are culled, 0 for no limit.
+	 * @puiVisible: Receives the indices of the visible boxes, room for uiCount.
+	 *
+	 * Same conservative test as IsBoxInsideViewFrustum, written in center and
+	 * extent form: the corner furthest inside is center + extent * |normal|,
+	 * so no corner has to be selected. Boxes exactly on a plane may differ
+	 * from IsBoxInsideViewFrustum by rounding. The distance is measured to
+	 * the closest point of the box, so a box containing the eye is never
+	 * culled.
+	 * Indices are written in increasing order. Returns the visible count.
+	 */
+	static GLuint CullBoxes(const TCullBox* pBoxes, GLuint uiCount, const SVector4Df* pv4Planes, const SVector3Df& v3Eye, GLfloat fMaxDistance, GLuint* puiVisible)
+	{
+		const GLfloat fMaxDistanceSq = GetMaxDistanceSq(fMaxDistance);
+
+		SVector3Df v3AbsNormals[FRUSTUM_PLANES_NUM];
+		GetAbsNormals(pv4Planes, v3AbsNormals);
+
+		GLuint uiVisible = 0;
+
+		for (GLuint i = 0; i < uiCount; i++)
+		{
+			const bool bInside = IsCullBoxInside(pBoxes[i], pv4Planes, v3AbsNormals);
+
+			// Branch free, the index is always written and only kept when visible
+			puiVisible[uiVisible] = i;
+			uiVisible += (bInside & (GetCullBoxDistanceSq(pBoxes[i], v3Eye) <= fMaxDistanceSq)) ? 1 : 0;
+		}
+
+		return (uiVisible);
+	}
+
+	// |normal| of each plane, the furthest corner of a box is then center + extent against it
+	static void GetAbsNormals(const SVector4Df* pv4Planes, SVector3Df* pv3AbsNormals)
+	{
+		for (GLint iPlane = 0; iPlane < FRUSTUM_PLANES_NUM; iPlane++)
+		{
+			pv3AbsNormals[iPlane] = SVector3Df(std::fabs(pv4Planes[iPlane].x), std::fabs(pv4Planes[iPlane].y), std::fabs(pv4Planes[iPlane].z));
+		}
+	}
+
+	// Plane part of CullBoxes for one box, pv3AbsNormals from GetAbsNormals
+	static bool IsCullBoxInside(const TCullBox& rBox, const SVector4Df* pv4Planes, const SVector3Df* pv3AbsNormals)
+	{
+		// Halved before the sum, a box spanning -FLT_MAX..FLT_MAX stays finite
+		const GLfloat fCenterX = rBox.v3Max.x * 0.5f + rBox.v3Min.x * 0.5f;
+		const GLfloat fCenterY = rBox.v3Max.y * 0.5f + rBox.v3Min.y * 0.5f;
+		const GLfloat fCenterZ = rBox.v3Max.z * 0.5f + rBox.v3Min.z * 0.5f;
+		const GLfloat fExtentX = rBox.v3Max.x * 0.5f - rBox.v3Min.x * 0.5f;
+		const GLfloat fExtentY = rBox.v3Max.y * 0.5f - rBox.v3Min.y * 0.5f;
+		const GLfloat fExtentZ = rBox.v3Max.z * 0.5f - rBox.v3Min.z * 0.5f;
+
+		for (GLint iPlane = 0; iPlane < FRUSTUM_PLANES_NUM; iPlane++)
+		{
+			const SVector4Df& v4Plane = pv4Planes[iPlane];
+			const SVector3Df& v3AbsNormal = pv3AbsNormals[iPlane];
+
+			const GLfloat fDistance =
+				v4Plane.x * fCenterX + v4Plane.y * fCenterY + v4Plane.z * fCenterZ + v4Plane.w +
+				v3AbsNormal.x * fExtentX + v3AbsNormal.y * fExtentY + v3AbsNormal.z * fExtentZ;
+
+			if (fDistance < 0.0f)
+			{
+				return (false);
+			}
+		}
+
+		return (true);
+	}
+
+	// Squared distance from v3Eye to the closest point of the box, 0 when inside
+	static GLfloat GetCullBoxDistanceSq(const TCullBox& rBox, const SVector3Df& v3Eye)
+	{
+		const GLfloat fDX = MyMath::fmax(MyMath::fmax(rBox.v3Min.x - v3Eye.x, v3Eye.x - rBox.v3Max.x), 0.0f);
+		const GLfloat fDY = MyMath::fmax(MyMath::fmax(rBox.v3Min.y - v3Eye.y, v3Eye.y - rBox.v3Max.y), 0.0f);
+		const GLfloat fDZ = MyMath::fmax(MyMath::fmax(rBox.v3Min.z - v3Eye.z, v3Eye.z - rBox.v3Max.z), 0.0f);
+
+		return (fDX * fDX + fDY * fDY + fDZ * fDZ);
+	}
+
+	// Limit compared with GetCullBoxDistanceSq, a max distance of 0 means no limit
+	static GLfloat GetMaxDistanceSq(GLfloat fMaxDistance)
+	{
+		return (fMaxDistance > 0.0f ? fMaxDistance * fMaxDistance : FLT_MAX);
+	}
+
+private:
+	// Corner of the box furthest along (bPositive) or against the plane normal
+	static SVector4Df GetBoxCorner(const SVector4Df& v4Plane, const SVector3Df& v3Min, const SVector3Df& v3Max, bool bPositive)
+	{
+		return (SVector4Df(
+			((v4Plane.x >= 0.0f) == bPositive) ? v3Max.x : v3Min.x,
+			((v4Plane.y >= 0.0f) == bPositive) ? v3Max.y : v3Min.y,
+			((v4Plane.z >= 0.0f) == bPositive) ? v3Max.z : v3Min.z,
+			1.0f));
+	}
+
 private:
 	SVector4Df m_v4LeftClipPlane;
 	SVector4Df m_v4RightClipPlane;
@@ -6,12 +6,99 @@
 #include <memory>
 #include <algorithm>
 #include <stdexcept>
+#include <climits>
 
 #include "utils.h"
 
 // Max Size for Grid
 #define MAX_SIZE 1 << 30
 
+/*
+ * TDirtyRect - Cells of a grid changed since its last upload.
+ *
+ * Inclusive bounds in grid cells, grown by every write and reset once the
+ * cells are on the GPU. An empty rect has its min above its max.
+ */
+typedef struct SDirtyRect
+{
+	GLint iMinX;
+	GLint iMinZ;
+	GLint iMaxX;
+	GLint iMaxZ;
+
+	SDirtyRect()
+	{
+		Reset();
+	}
+
+	SDirtyRect(GLint iMinXVal, GLint iMinZVal, GLint iMaxXVal, GLint iMaxZVal)
+	{
+		iMinX = iMinXVal;
+		iMinZ = iMinZVal;
+		iMaxX = iMaxXVal;
+		iMaxZ = iMaxZVal;
+	}
+
+	void Reset()
+	{
+		iMinX = iMinZ = INT_MAX;
+		iMaxX = iMaxZ = INT_MIN;
+	}
+
+	bool IsEmpty() const
+	{
+		return (iMinX > iMaxX || iMinZ > iMaxZ);
+	}
+
+	void Add(GLint iX, GLint iZ)
+	{
+		iMinX = std::min(iMinX, iX);
+		iMinZ = std::min(iMinZ, iZ);
+		iMaxX = std::max(iMaxX, iX);
+		iMaxZ = std::max(iMaxZ, iZ);
+	}
+
+	void Add(const SDirtyRect& rect)
+	{
+		if (rect.IsEmpty())
+		{
+			return;
+		}
+
+		Add(rect.iMinX, rect.iMinZ);
+		Add(rect.iMaxX, rect.iMaxZ);
+	}
+
+	// Keeps the cells inside a grid of iWidth x iDepth
+	void Clip(GLint iWidth, GLint iDepth)
+	{
+		iMinX = std::max(iMinX, 0);
+		iMinZ = std::max(iMinZ, 0);
+		iMaxX = std::min(iMaxX, iWidth - 1);
+		iMaxZ = std::min(iMaxZ, iDepth - 1);
+	}
+
+	bool Contains(const SDirtyRect& rect) const
+	{
+		return (rect.IsEmpty() || (rect.iMinX >= iMinX && rect.iMinZ >= iMinZ && rect.iMaxX <= iMaxX && rect.iMaxZ <= iMaxZ));
+	}
+
+	GLint GetWidth() const
+	{
+		return (IsEmpty() ? 0 : iMaxX - iMinX + 1);
+	}
+
+	GLint GetDepth() const
+	{
+		return (IsEmpty() ? 0 : iMaxZ - iMinZ + 1);
+	}
+
+	bool operator==(const SDirtyRect& rect) const
+	{
+		return ((IsEmpty() && rect.IsEmpty()) || (iMinX == rect.iMinX && iMinZ == rect.iMinZ && iMaxX == rect.iMaxX && iMaxZ == rect.iMaxZ));
+	}
+} TDirtyRect;
+
 template <typename T>
 class CGrid
 {
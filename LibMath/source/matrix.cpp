@@ -4,6 +4,10 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/ext.hpp>
 
+#if defined(MATH_SIMD_SSE)
+	#include <immintrin.h>
+#endif
+
 CMatrix4Df::CMatrix4Df(const CMatrix3Df& AssimpMatrix)
 {
 	mat4[0][0] = AssimpMatrix.mat3[0][0]; mat4[0][1] = AssimpMatrix.mat3[0][1]; mat4[0][2] = AssimpMatrix.mat3[0][3]; mat4[0][3] = 0.0f;
@@ -768,6 +772,293 @@ void CMatrix4Df::InitLookAt(const SVector3Df& pos, const SVector3Df& target, con
 	mat4[3][3] = 1.0f;
 }
 
+/**
+ * Multiplies two matrices, scalar reference of operator*.
+ *
+ * @param leftMat: The left-hand side matrix.
+ * @param rightMat: The right-hand side matrix.
+ *
+ * @return leftMat * rightMat.
+ */
+CMatrix4Df CMatrix4Df::MultiplyScalar(const CMatrix4Df& leftMat, const CMatrix4Df& rightMat)
+{
+	CMatrix4Df newMat{};
+	for (int8_t i = 0; i < 4; i++)
+	{
+		for (int8_t j = 0; j < 4; j++)
+		{
+			newMat.mat4[i][j] = leftMat.mat4[i][0] * rightMat.mat4[0][j] + leftMat.mat4[i][1] * rightMat.mat4[1][j] + leftMat.mat4[i][2] * rightMat.mat4[2][j] + leftMat.mat4[i][3] * rightMat.mat4[3][j];
+		}
+	}
+	return (newMat);
+}
+
+/**
+ * Multiplies a matrix and a vector, scalar reference of operator*.
+ *
+ * @param mat: The matrix.
+ * @param vec: The vector to transform.
+ *
+ * @return mat * vec.
+ */
+SVector4Df CMatrix4Df::TransformScalar(const CMatrix4Df& mat, const SVector4Df& vec)
+{
+	SVector4Df newVec{};
+
+	newVec.x = mat.mat4[0][0] * vec.x + mat.mat4[0][1] * vec.y + mat.mat4[0][2] * vec.z + mat.mat4[0][3] * vec.w;
+	newVec.y = mat.mat4[1][0] * vec.x + mat.mat4[1][1] * vec.y + mat.mat4[1][2] * vec.z + mat.mat4[1][3] * vec.w;
+	newVec.z = mat.mat4[2][0] * vec.x + mat.mat4[2][1] * vec.y + mat.mat4[2][2] * vec.z + mat.mat4[2][3] * vec.w;
+	newVec.w = mat.mat4[3][0] * vec.x + mat.mat4[3][1] * vec.y + mat.mat4[3][2] * vec.z + mat.mat4[3][3] * vec.w;
+	return (newVec);
+}
+
+/**
+ * Transposes a matrix, scalar reference of Transpose().
+ *
+ * @param mat: The matrix to transpose.
+ *
+ * @return The transposed matrix.
+ */
+CMatrix4Df CMatrix4Df::TransposeScalar(const CMatrix4Df& mat)
+{
+	CMatrix4Df newMat{};
+
+	for (int8_t i = 0; i < 4; i++)
+	{
+		for (int8_t j = 0; j < 4; j++)
+		{
+			newMat.mat4[i][j] = mat.mat4[j][i];
+		}
+	}
+
+	return (newMat);
+}
+
+/**
+ * Inverts an affine matrix, scalar reference of InverseAffine().
+ *
+ * The inverse of the 3x3 part is its adjugate over its determinant. With
+ * r0, r1, r2 the rows of the 3x3 part, the columns of the adjugate are
+ * r1 x r2, r2 x r0 and r0 x r1, and the determinant is r0 . (r1 x r2).
+ *
+ * @param mat: The matrix to invert, its last row must be (0, 0, 0, 1).
+ *
+ * @return The inverse of the matrix, or the matrix itself if the 3x3 part is singular.
+ */
+CMatrix4Df CMatrix4Df::InverseAffineScalar(const CMatrix4Df& mat)
+{
+	const SVector3Df r0(mat.mat4[0][0], mat.mat4[0][1], mat.mat4[0][2]);
+	const SVector3Df r1(mat.mat4[1][0], mat.mat4[1][1], mat.mat4[1][2]);
+	const SVector3Df r2(mat.mat4[2][0], mat.mat4[2][1], mat.mat4[2][2]);
+
+	const SVector3Df c0 = r1.cross(r2);
+	const SVector3Df c1 = r2.cross(r0);
+	const SVector3Df c2 = r0.cross(r1);
+
+	const float fDet = r0.dot(c0);
+	if (fDet == 0.0f)
+	{
+		ASSERT(fDet == 0.0f, "Matrix Determinant Is 0");
+		return (mat);
+	}
+
+	const float fInvDet = 1.0f / fDet;
+	const float fTransX = mat.mat4[0][3];
+	const float fTransY = mat.mat4[1][3];
+	const float fTransZ = mat.mat4[2][3];
+
+	CMatrix4Df res{};
+	res.mat4[0][0] = c0.x * fInvDet; res.mat4[0][1] = c1.x * fInvDet; res.mat4[0][2] = c2.x * fInvDet;
+	res.mat4[1][0] = c0.y * fInvDet; res.mat4[1][1] = c1.y * fInvDet; res.mat4[1][2] = c2.y * fInvDet;
+	res.mat4[2][0] = c0.z * fInvDet; res.mat4[2][1] = c1.z * fInvDet; res.mat4[2][2] = c2.z * fInvDet;
+
+	for (int8_t i = 0; i < 3; i++)
+	{
+		res.mat4[i][3] = -(res.mat4[i][0] * fTransX + res.mat4[i][1] * fTransY + res.mat4[i][2] * fTransZ);
+	}
+
+	res.mat4[3][0] = 0.0f; res.mat4[3][1] = 0.0f; res.mat4[3][2] = 0.0f; res.mat4[3][3] = 1.0f;
+	return (res);
+}
+
+#if defined(MATH_SIMD_SSE)
+/**
+ * Multiplies two matrices with SSE, or AVX2 + FMA when available.
+ *
+ * Row i of the product is the sum of the rows of rightMat weighted by the
+ * elements of row i of leftMat, so each row is four broadcasts and four
+ * multiply-adds. The AVX2 path computes two rows per 256-bit register.
+ *
+ * @param leftMat: The left-hand side matrix.
+ * @param rightMat: The right-hand side matrix.
+ *
+ * @return leftMat * rightMat.
+ */
+CMatrix4Df CMatrix4Df::MultiplySIMD(const CMatrix4Df& leftMat, const CMatrix4Df& rightMat)
+{
+	CMatrix4Df newMat;
+
+#if defined(MATH_SIMD_AVX2)
+	const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rightMat.mat4[0]));
+	const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rightMat.mat4[1]));
+	const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rightMat.mat4[2]));
+	const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rightMat.mat4[3]));
+
+	for (int8_t i = 0; i < 4; i += 2)
+	{
+		// Rows i and i + 1, _mm256_permute_ps broadcasts within each 128-bit lane
+		const __m256 a = _mm256_loadu_ps(leftMat.mat4[i]);
+
+		__m256 r = _mm256_mul_ps(_mm256_permute_ps(a, 0x00), b0);
+		r = _mm256_fmadd_ps(_mm256_permute_ps(a, 0x55), b1, r);
+		r = _mm256_fmadd_ps(_mm256_permute_ps(a, 0xAA), b2, r);
+		r = _mm256_fmadd_ps(_mm256_permute_ps(a, 0xFF), b3, r);
+
+		_mm256_storeu_ps(newMat.mat4[i], r);
+	}
+#else
+	const __m128 b0 = _mm_loadu_ps(rightMat.mat4[0]);
+	const __m128 b1 = _mm_loadu_ps(rightMat.mat4[1]);
+	const __m128 b2 = _mm_loadu_ps(rightMat.mat4[2]);
+	const __m128 b3 = _mm_loadu_ps(rightMat.mat4[3]);
+
+	for (int8_t i = 0; i < 4; i++)
+	{
+		const __m128 a = _mm_loadu_ps(leftMat.mat4[i]);
+
+		__m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+
+		_mm_storeu_ps(newMat.mat4[i], r);
+	}
+#endif
+
+	return (newMat);
+}
+
+/**
+ * Multiplies a matrix and a vector with SSE.
+ *
+ * The four row products are transposed so that adding them gives the four
+ * dot products in one register, without horizontal adds.
+ *
+ * @param mat: The matrix.
+ * @param vec: The vector to transform.
+ *
+ * @return mat * vec.
+ */
+SVector4Df CMatrix4Df::TransformSIMD(const CMatrix4Df& mat, const SVector4Df& vec)
+{
+	const __m128 v = _mm_setr_ps(vec.x, vec.y, vec.z, vec.w);
+
+	__m128 r0 = _mm_mul_ps(_mm_loadu_ps(mat.mat4[0]), v);
+	__m128 r1 = _mm_mul_ps(_mm_loadu_ps(mat.mat4[1]), v);
+	__m128 r2 = _mm_mul_ps(_mm_loadu_ps(mat.mat4[2]), v);
+	__m128 r3 = _mm_mul_ps(_mm_loadu_ps(mat.mat4[3]), v);
+
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	float fResult[4];
+	_mm_storeu_ps(fResult, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+	return (SVector4Df(fResult[0], fResult[1], fResult[2], fResult[3]));
+}
+
+/**
+ * Transposes a matrix with SSE.
+ *
+ * @param mat: The matrix to transpose.
+ *
+ * @return The transposed matrix.
+ */
+CMatrix4Df CMatrix4Df::TransposeSIMD(const CMatrix4Df& mat)
+{
+	__m128 r0 = _mm_loadu_ps(mat.mat4[0]);
+	__m128 r1 = _mm_loadu_ps(mat.mat4[1]);
+	__m128 r2 = _mm_loadu_ps(mat.mat4[2]);
+	__m128 r3 = _mm_loadu_ps(mat.mat4[3]);
+
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	CMatrix4Df newMat;
+	_mm_storeu_ps(newMat.mat4[0], r0);
+	_mm_storeu_ps(newMat.mat4[1], r1);
+	_mm_storeu_ps(newMat.mat4[2], r2);
+	_mm_storeu_ps(newMat.mat4[3], r3);
+	return (newMat);
+}
+
+/**
+ * Inverts an affine matrix with SSE, same math as InverseAffineScalar().
+ *
+ * The rows are loaded whole, the translation sits in their w lane. It is
+ * masked out before the cross products so their w lane is exactly 0 (relying
+ * on a.w * b.w - a.w * b.w breaks once the compiler contracts it into an FMA),
+ * the determinant is then a plain 4 wide dot product, and transposing the
+ * scaled cofactors together with the new translation gives the rows of the
+ * result.
+ *
+ * @param mat: The matrix to invert, its last row must be (0, 0, 0, 1).
+ *
+ * @return The inverse of the matrix, or the matrix itself if the 3x3 part is singular.
+ */
+CMatrix4Df CMatrix4Df::InverseAffineSIMD(const CMatrix4Df& mat)
+{
+	const __m128 t0 = _mm_loadu_ps(mat.mat4[0]);
+	const __m128 t1 = _mm_loadu_ps(mat.mat4[1]);
+	const __m128 t2 = _mm_loadu_ps(mat.mat4[2]);
+
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	const __m128 r0 = _mm_and_ps(t0, xyzMask);
+	const __m128 r1 = _mm_and_ps(t1, xyzMask);
+	const __m128 r2 = _mm_and_ps(t2, xyzMask);
+
+	// a x b = a.yzx * b.zxy - a.zxy * b.yzx
+	const __m128 r0_yzx = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 r1_yzx = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 r2_yzx = _mm_shuffle_ps(r2, r2, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 r0_zxy = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 1, 0, 2));
+	const __m128 r1_zxy = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 1, 0, 2));
+	const __m128 r2_zxy = _mm_shuffle_ps(r2, r2, _MM_SHUFFLE(3, 1, 0, 2));
+
+	__m128 c0 = _mm_sub_ps(_mm_mul_ps(r1_yzx, r2_zxy), _mm_mul_ps(r1_zxy, r2_yzx));
+	__m128 c1 = _mm_sub_ps(_mm_mul_ps(r2_yzx, r0_zxy), _mm_mul_ps(r2_zxy, r0_yzx));
+	__m128 c2 = _mm_sub_ps(_mm_mul_ps(r0_yzx, r1_zxy), _mm_mul_ps(r0_zxy, r1_yzx));
+
+	// Determinant in every lane
+	__m128 det = _mm_mul_ps(r0, c0);
+	det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(2, 3, 0, 1)));
+	det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(1, 0, 3, 2)));
+
+	if (_mm_cvtss_f32(det) == 0.0f)
+	{
+		ASSERT(_mm_cvtss_f32(det) == 0.0f, "Matrix Determinant Is 0");
+		return (mat);
+	}
+
+	const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	c0 = _mm_mul_ps(c0, invDet);
+	c1 = _mm_mul_ps(c1, invDet);
+	c2 = _mm_mul_ps(c2, invDet);
+
+	// -inverse(3x3) * translation, the c vectors are the columns of inverse(3x3)
+	__m128 t = _mm_mul_ps(c0, _mm_shuffle_ps(t0, t0, _MM_SHUFFLE(3, 3, 3, 3)));
+	t = _mm_add_ps(t, _mm_mul_ps(c1, _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(3, 3, 3, 3))));
+	t = _mm_add_ps(t, _mm_mul_ps(c2, _mm_shuffle_ps(t2, t2, _MM_SHUFFLE(3, 3, 3, 3))));
+	t = _mm_sub_ps(_mm_setzero_ps(), t);
+
+	_MM_TRANSPOSE4_PS(c0, c1, c2, t);
+
+	CMatrix4Df res;
+	_mm_storeu_ps(res.mat4[0], c0);
+	_mm_storeu_ps(res.mat4[1], c1);
+	_mm_storeu_ps(res.mat4[2], c2);
+	_mm_storeu_ps(res.mat4[3], _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+	return (res);
+}
+#endif
+
 /**
  * Initializes the matrix for a rotation around the X-axis.
  *
@@ -19,6 +19,18 @@
 
 #include "utils.h"
 
+/*
+ * SIMD paths of CMatrix4Df, picked at compile time from the target flags:
+ * AVX2 (/arch:AVX2, which also brings FMA) or SSE2 (always on for x64).
+ * Define MATH_NO_SIMD to build the scalar code only.
+ */
+#if !defined(MATH_NO_SIMD) && defined(__AVX2__)
+	#define MATH_SIMD_AVX2
+	#define MATH_SIMD_SSE
+#elif !defined(MATH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define MATH_SIMD_SSE
+#endif
+
 class CMatrix3Df;
 
 /**
@@ -153,18 +165,13 @@ public:
 	 *
 	 * @return The product of the two matrices.
 	 */
-	CMatrix4Df operator*(const CMatrix4Df& rightMat)
+	CMatrix4Df operator*(const CMatrix4Df& rightMat) const
 	{
-		CMatrix4Df newMat{};
-		for (int8_t i = 0; i < 4; i++)
-		{
-			for (int8_t j = 0; j < 4; j++)
-			{
-				newMat.mat4[i][j] = mat4[i][0] * rightMat.mat4[0][j] + mat4[i][1] * rightMat.mat4[1][j] + mat4[i][2] * rightMat.mat4[2][j] + mat4[i][3] * rightMat.mat4[3][j];
-			}
-		}
-		return (newMat);
-
+#if defined(MATH_SIMD_SSE)
+		return (MultiplySIMD(*this, rightMat));
+#else
+		return (MultiplyScalar(*this, rightMat));
+#endif
 	}
 
 	CMatrix4Df operator=(const glm::mat4& glmMat)
@@ -187,13 +194,11 @@ public:
 	 */
 	SVector4Df operator*(const SVector4Df& vec)
 	{
-		SVector4Df newVec{};
-
-		newVec.x = mat4[0][0] * vec.x + mat4[0][1] * vec.y + mat4[0][2] * vec.z + mat4[0][3] * vec.w;
-		newVec.y = mat4[1][0] * vec.x + mat4[1][1] * vec.y + mat4[1][2] * vec.z + mat4[1][3] * vec.w;
-		newVec.z = mat4[2][0] * vec.x + mat4[2][1] * vec.y + mat4[2][2] * vec.z + mat4[2][3] * vec.w;
-		newVec.w = mat4[3][0] * vec.x + mat4[3][1] * vec.y + mat4[3][2] * vec.z + mat4[3][3] * vec.w;
-		return (newVec);
+#if defined(MATH_SIMD_SSE)
+		return (TransformSIMD(*this, vec));
+#else
+		return (TransformScalar(*this, vec));
+#endif
 	}
 
 	/**
@@ -208,13 +213,11 @@ public:
 	 */
 	SVector4Df operator*(const SVector4Df& vec) const
 	{
-		SVector4Df newVec{};
-
-		newVec.x = mat4[0][0] * vec.x + mat4[0][1] * vec.y + mat4[0][2] * vec.z + mat4[0][3] * vec.w;
-		newVec.y = mat4[1][0] * vec.x + mat4[1][1] * vec.y + mat4[1][2] * vec.z + mat4[1][3] * vec.w;
-		newVec.z = mat4[2][0] * vec.x + mat4[2][1] * vec.y + mat4[2][2] * vec.z + mat4[2][3] * vec.w;
-		newVec.w = mat4[3][0] * vec.x + mat4[3][1] * vec.y + mat4[3][2] * vec.z + mat4[3][3] * vec.w;
-		return (newVec);
+#if defined(MATH_SIMD_SSE)
+		return (TransformSIMD(*this, vec));
+#else
+		return (TransformScalar(*this, vec));
+#endif
 	}
 
 	CMatrix4Df operator*(float scalar)
@@ -299,17 +302,11 @@ public:
 	 */
 	CMatrix4Df Transpose() const
 	{
-		CMatrix4Df newMat{};
-
-		for (int8_t i = 0; i < 4; i++)
-		{
-			for (int8_t j = 0; j < 4; j++)
-			{
-				newMat.mat4[i][j] = mat4[j][i];
-			}
-		}
-
-		return (newMat);
+#if defined(MATH_SIMD_SSE)
+		return (TransposeSIMD(*this));
+#else
+		return (TransposeScalar(*this));
+#endif
 	}
 
 	/**
@@ -452,6 +449,25 @@ public:
 		return (res);
 	}
 
+	/**
+	 * Calculates the inverse of an affine matrix.
+	 *
+	 * Only valid when the last row is (0, 0, 0, 1), like world and view matrices:
+	 * the 3x3 part is inverted from its cofactors and the translation becomes
+	 * -inverse(3x3) * translation. Scale and shear are fine, projections are not,
+	 * use Inverse() for those.
+	 *
+	 * @return The inverse of the matrix, or the matrix itself if the 3x3 part is singular.
+	 */
+	CMatrix4Df InverseAffine() const
+	{
+#if defined(MATH_SIMD_SSE)
+		return (InverseAffineSIMD(*this));
+#else
+		return (InverseAffineScalar(*this));
+#endif
+	}
+
 	/**
 	 * Calculates the inverse of the matrix, Calcualted as Same as GLM Function.
 	 *
@@ -593,16 +609,11 @@ public:
 	// transforms a 3D point (SVector3Df) by the 4x4 matrix (including translation, rotation, and scale):
 	SVector3Df TransformPoint(const SVector3Df& v) const
 	{
-		// Assuming mat4 is a 4x4 float array: mat4[row][col]
-		float x = v.x, y = v.y, z = v.z;
-		float tx =
-			mat4[0][0] * x + mat4[0][1] * y + mat4[0][2] * z + mat4[0][3];
-		float ty =
-			mat4[1][0] * x + mat4[1][1] * y + mat4[1][2] * z + mat4[1][3];
-		float tz =
-			mat4[2][0] * x + mat4[2][1] * y + mat4[2][2] * z + mat4[2][3];
-		float tw =
-			mat4[3][0] * x + mat4[3][1] * y + mat4[3][2] * z + mat4[3][3];
+		const SVector4Df vTransformed = *this * SVector4Df(v.x, v.y, v.z, 1.0f);
+		float tx = vTransformed.x;
+		float ty = vTransformed.y;
+		float tz = vTransformed.z;
+		const float tw = vTransformed.w;
 
 		// Homogeneous divide (if w != 1)
 		if (tw != 0.0f && tw != 1.0f)
@@ -988,6 +999,23 @@ public:
 
 	void InitLookAt(const SVector3Df& pos, const SVector3Df& target, const SVector3Df& up);
 
+	/*
+	 * Kernels behind the operators above. Both versions are always built so
+	 * the SIMD results can be checked against the scalar reference; the
+	 * operators pick one at compile time (see MATH_SIMD_SSE).
+	 */
+	static CMatrix4Df MultiplyScalar(const CMatrix4Df& leftMat, const CMatrix4Df& rightMat);
+	static SVector4Df TransformScalar(const CMatrix4Df& mat, const SVector4Df& vec);
+	static CMatrix4Df TransposeScalar(const CMatrix4Df& mat);
+	static CMatrix4Df InverseAffineScalar(const CMatrix4Df& mat);
+
+#if defined(MATH_SIMD_SSE)
+	static CMatrix4Df MultiplySIMD(const CMatrix4Df& leftMat, const CMatrix4Df& rightMat);
+	static SVector4Df TransformSIMD(const CMatrix4Df& mat, const SVector4Df& vec);
+	static CMatrix4Df TransposeSIMD(const CMatrix4Df& mat);
+	static CMatrix4Df InverseAffineSIMD(const CMatrix4Df& mat);
+#endif
+
 private:
 	/**
 	 * Initializes the matrix for a rotation around the X-axis.
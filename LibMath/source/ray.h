@@ -98,6 +98,12 @@ public:
 		return (m_v3Dir);
 	}
 
+	// 1 / direction per component, infinite on the axes the ray is parallel to
+	SVector3Df GetInverseDirection() const
+	{
+		return (SVector3Df(1.0f / m_v3Dir.x, 1.0f / m_v3Dir.y, 1.0f / m_v3Dir.z));
+	}
+
 private:
 	SVector3Df m_v3Start;
 	SVector3Df m_v3End;
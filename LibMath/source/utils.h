@@ -422,6 +422,12 @@ namespace MyMath
         return (fmin(fmax(fX, fMinVal), fMaxVal));
     }
 
+    // Shortest turn from fFromDeg to fToDeg, in [-180, 180] degrees
+    inline float fangledelta(float fFromDeg, float fToDeg)
+    {
+        return (std::remainder(fToDeg - fFromDeg, 360.0f));
+    }
+
     inline glm::vec3 GenerateRandomVec3GLM()
     {
         std::random_device rd;  //Will be used to obtain a seed for the random number engine
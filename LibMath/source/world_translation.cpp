@@ -5,6 +5,9 @@ CWorldTranslation::CWorldTranslation()
 	m_v3Scale = SVector3Df(1.0f, 1.0f, 1.0f);
 	m_vPosition = SVector3Df(0.0f, 0.0f, 0.0f);
 	m_vRotation = SVector3Df(0.0f, 0.0f, 0.0f);
+
+	m_matWorld.InitScaleTransform(1.0f);
+	m_bMatrixDirty = false;
 }
 
 /**
@@ -20,7 +23,7 @@ CWorldTranslation::CWorldTranslation()
  */
 void CWorldTranslation::SetScale(const GLfloat fScale)
 {
-	m_v3Scale = SVector3Df(fScale, fScale, fScale);
+	SetScale(SVector3Df(fScale, fScale, fScale));
 }
 
 /**
@@ -38,7 +41,7 @@ void CWorldTranslation::SetScale(const GLfloat fScale)
  */
 void CWorldTranslation::SetScale(const GLfloat fScaleX, const GLfloat fScaleY, const GLfloat fScaleZ)
 {
-	m_v3Scale = SVector3Df(fScaleX, fScaleZ, fScaleZ);
+	SetScale(SVector3Df(fScaleX, fScaleY, fScaleZ));
 }
 
 /**
@@ -54,7 +57,13 @@ void CWorldTranslation::SetScale(const GLfloat fScaleX, const GLfloat fScaleY, c
  */
 void CWorldTranslation::SetScale(const SVector3Df& v3Scale)
 {
+	if (IsSameVector(m_v3Scale, v3Scale))
+	{
+		return;
+	}
+
 	m_v3Scale = v3Scale;
+	m_bMatrixDirty = true;
 }
 
 /**
@@ -71,9 +80,7 @@ void CWorldTranslation::SetScale(const SVector3Df& v3Scale)
  */
 void CWorldTranslation::SetPosition(const GLfloat fPosX, const GLfloat fPosY, const GLfloat fPosZ)
 {
-	m_vPosition.x = fPosX;
-	m_vPosition.y = fPosY;
-	m_vPosition.z = fPosZ;
+	SetPosition(SVector3Df(fPosX, fPosY, fPosZ));
 }
 
 /**
@@ -88,7 +95,13 @@ void CWorldTranslation::SetPosition(const GLfloat fPosX, const GLfloat fPosY, co
  */
 void CWorldTranslation::SetPosition(const SVector3Df& v3Pos)
 {
+	if (IsSameVector(m_vPosition, v3Pos))
+	{
+		return;
+	}
+
 	m_vPosition = v3Pos;
+	m_bMatrixDirty = true;
 }
 
 /**
@@ -105,9 +118,7 @@ void CWorldTranslation::SetPosition(const SVector3Df& v3Pos)
  */
 void CWorldTranslation::SetRotation(const GLfloat fRotX, const GLfloat fRotY, const GLfloat fRotZ)
 {
-	m_vRotation.x = fRotX;
-	m_vRotation.y = fRotY;
-	m_vRotation.z = fRotZ;
+	SetRotation(SVector3Df(fRotX, fRotY, fRotZ));
 }
 
 /**
@@ -122,7 +133,13 @@ void CWorldTranslation::SetRotation(const GLfloat fRotX, const GLfloat fRotY, co
  */
 void CWorldTranslation::SetRotation(const SVector3Df& v3Rot)
 {
+	if (IsSameVector(m_vRotation, v3Rot))
+	{
+		return;
+	}
+
 	m_vRotation = v3Rot;
+	m_bMatrixDirty = true;
 }
 
 /**
@@ -137,9 +154,7 @@ void CWorldTranslation::SetRotation(const SVector3Df& v3Rot)
  */
 void CWorldTranslation::Rotate(const GLfloat fRotX, const GLfloat fRotY, const GLfloat fRotZ)
 {
-	m_vRotation.x += fRotX;
-	m_vRotation.y += fRotY;
-	m_vRotation.z += fRotZ;
+	SetRotation(m_vRotation.x + fRotX, m_vRotation.y + fRotY, m_vRotation.z + fRotZ);
 }
 
 /**
@@ -151,7 +166,7 @@ void CWorldTranslation::Rotate(const GLfloat fRotX, const GLfloat fRotY, const G
  */
 void CWorldTranslation::Rotate(const SVector3Df& v3Rot)
 {
-	m_vRotation += v3Rot;
+	SetRotation(m_vRotation + v3Rot);
 }
 
 /**
@@ -194,28 +209,106 @@ const SVector3Df& CWorldTranslation::GetRotation() const
 }
 
 /**
- * GetMatrix - Computes the complete world transformation matrix
+ * GetMatrix - Gets the complete world transformation matrix
  *             from the position, rotation, and scale of the object.
  *
  * This function should be used when you want to transform local
  * object-space vertices to world-space (e.g. in rendering or physics).
  *
+ * The matrix is cached and only rebuilt when a setter changed the
+ * position, rotation or scale since the last call. Rebuilding writes the
+ * cache, so a transform shared between threads should be refreshed with
+ * UpdateMatrices() before they read it.
+ *
  * Return: A 4x4 matrix combining translation, rotation, and scaling
  *         in the order: Translation * Rotation * Scale.
  */
-CMatrix4Df CWorldTranslation::GetMatrix() const
+const CMatrix4Df& CWorldTranslation::GetMatrix() const
+{
+	if (m_bMatrixDirty)
+	{
+		UpdateMatrix();
+	}
+
+	return (m_matWorld);
+}
+
+/**
+ * BuildMatrix - Composes Translation * Rotation * Scale in closed form.
+ * @v3Pos: World position.
+ * @v3Rot: Euler angles in degrees, combined as Rx * Ry * Rz like
+ *         CMatrix4Df::InitRotateTransformZYX.
+ * @v3Scale: Scale along each axis.
+ *
+ * Same result as multiplying the three matrices, without the two matrix
+ * products and with one sin/cos per axis: the columns of the rotation are
+ * scaled by the scale and the translation is written in the last column.
+ *
+ * Return: The world transformation matrix.
+ */
+CMatrix4Df CWorldTranslation::BuildMatrix(const SVector3Df& v3Pos, const SVector3Df& v3Rot, const SVector3Df& v3Scale)
 {
-	CMatrix4Df matScale{}, matRotation{}, matTranslation{};
+	const GLfloat fRotX = ToRadian(v3Rot.x);
+	const GLfloat fRotY = ToRadian(v3Rot.y);
+	const GLfloat fRotZ = ToRadian(v3Rot.z);
 
-	matScale.InitScaleTransform(m_v3Scale.x, m_v3Scale.y, m_v3Scale.z);
+	const GLfloat sx = std::sinf(fRotX), cx = std::cosf(fRotX);
+	const GLfloat sy = std::sinf(fRotY), cy = std::cosf(fRotY);
+	const GLfloat sz = std::sinf(fRotZ), cz = std::cosf(fRotZ);
 
-	matRotation.InitRotateTransformZYX(m_vRotation.x, m_vRotation.y, m_vRotation.z);
+	CMatrix4Df matWorld;
+	matWorld.mat4[0][0] = cy * cz * v3Scale.x;
+	matWorld.mat4[0][1] = -cy * sz * v3Scale.y;
+	matWorld.mat4[0][2] = sy * v3Scale.z;
+	matWorld.mat4[0][3] = v3Pos.x;
 
-	matTranslation.InitTranslationTransform(m_vPosition.x, m_vPosition.y, m_vPosition.z);
+	matWorld.mat4[1][0] = (sx * sy * cz + cx * sz) * v3Scale.x;
+	matWorld.mat4[1][1] = (cx * cz - sx * sy * sz) * v3Scale.y;
+	matWorld.mat4[1][2] = -sx * cy * v3Scale.z;
+	matWorld.mat4[1][3] = v3Pos.y;
 
-	CMatrix4Df matWorldTransformation = matTranslation * matRotation * matScale;
+	matWorld.mat4[2][0] = (sx * sz - cx * sy * cz) * v3Scale.x;
+	matWorld.mat4[2][1] = (cx * sy * sz + sx * cz) * v3Scale.y;
+	matWorld.mat4[2][2] = cx * cy * v3Scale.z;
+	matWorld.mat4[2][3] = v3Pos.z;
 
-	return (matWorldTransformation);
+	matWorld.mat4[3][0] = 0.0f;
+	matWorld.mat4[3][1] = 0.0f;
+	matWorld.mat4[3][2] = 0.0f;
+	matWorld.mat4[3][3] = 1.0f;
+
+	return (matWorld);
+}
+
+/**
+ * UpdateMatrices - Rebuilds the dirty matrices of an array of transforms.
+ * @pTransforms: First transform of a contiguous array.
+ * @sCount: Number of transforms in the array.
+ *
+ * One linear pass over the array, so the following GetMatrix() calls are
+ * plain reads. Use it before rendering or before sharing the transforms
+ * with other threads.
+ */
+void CWorldTranslation::UpdateMatrices(CWorldTranslation* pTransforms, size_t sCount)
+{
+	for (size_t i = 0; i < sCount; i++)
+	{
+		if (pTransforms[i].m_bMatrixDirty)
+		{
+			pTransforms[i].UpdateMatrix();
+		}
+	}
+}
+
+void CWorldTranslation::UpdateMatrix() const
+{
+	m_matWorld = BuildMatrix(m_vPosition, m_vRotation, m_v3Scale);
+	m_bMatrixDirty = false;
+}
+
+bool CWorldTranslation::IsSameVector(const SVector3Df& v3Left, const SVector3Df& v3Right)
+{
+	return (v3Left.x == v3Right.x && v3Left.y == v3Right.y && v3Left.z == v3Right.z);
 }
 
 /**
@@ -21,7 +21,7 @@ public:
 	const SVector3Df& GetScale() const;
 	const SVector3Df& GetPosition() const;
 	const SVector3Df& GetRotation() const;
-	CMatrix4Df GetMatrix() const;
+	const CMatrix4Df& GetMatrix() const;
 
 	CMatrix4Df GetReversedTranslationMatrix() const;
 	CMatrix4Df GetReversedRotationMatrix() const;
@@ -29,8 +29,19 @@ public:
 	SVector3Df WorldPosToLocalPos(const SVector3Df& v3WorldPos) const;
 	SVector3Df WorldDirToLocalDir(const SVector3Df& v3WorldDir) const;
 
+	static CMatrix4Df BuildMatrix(const SVector3Df& v3Pos, const SVector3Df& v3Rot, const SVector3Df& v3Scale);
+	static void UpdateMatrices(CWorldTranslation* pTransforms, size_t sCount);
+
+private:
+	void UpdateMatrix() const;
+	static bool IsSameVector(const SVector3Df& v3Left, const SVector3Df& v3Right);
+
 private:
 	SVector3Df m_vPosition;
 	SVector3Df m_vRotation;
 	SVector3Df m_v3Scale;
+
+	// Translation * Rotation * Scale, rebuilt on the next GetMatrix() after a setter changed a value
+	mutable CMatrix4Df m_matWorld;
+	mutable bool m_bMatrixDirty;
 };
\ No newline at end of file
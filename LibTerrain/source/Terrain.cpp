@@ -1,11 +1,20 @@
 #include "Stdafx.h"
 #include "Terrain.h"
 #include "TerrainMap.h"
+#include "TerrainChunk.h"
 #include "../../LibGame/source/Skybox.h"
+#include "../../LibGL/source/JobSystem.h"
+
+#if defined(MATH_SIMD_SSE)
+	#include <immintrin.h>
+#endif
 
 
 CTerrain::CTerrain()
 {
+	m_uiPatchesVBO = 0;
+	m_uiDrawIndirectBuffer = 0;
+
 	Initialize();
 }
 
@@ -19,8 +28,21 @@ void CTerrain::Initialize()
 	m_stTerrainName = "AreaTerrain";
 	m_iTerrCoordX = m_iTerrCoordZ = 0;
 	m_pOwnerTerrainMap = nullptr;
+	m_iCulledPatchesNum = 0;
 	SetReady(false);
 
+	if (m_uiPatchesVBO)
+	{
+		glDeleteBuffers(1, &m_uiPatchesVBO);
+		m_uiPatchesVBO = 0;
+	}
+
+	if (m_uiDrawIndirectBuffer)
+	{
+		glDeleteBuffers(1, &m_uiDrawIndirectBuffer);
+		m_uiDrawIndirectBuffer = 0;
+	}
+
 	for (GLubyte z = 0; z < PATCH_ZCOUNT; z++)
 	{
 		for (GLubyte x = 0; x < PATCH_XCOUNT; x++)
@@ -33,6 +55,8 @@ void CTerrain::Initialize()
 	safe_delete(m_SplatData.m_pWeightTexture);
 	safe_delete(m_AttrData.m_pAttrTexture);
 	safe_delete(m_WaterData.m_pWaterTexture);
+
+	ClearDirtyRects();
 }
 
 void CTerrain::Clear()
@@ -145,26 +169,6 @@ bool CTerrain::LoadAttributeMap(const std::string& stAttrMapFile)
 		return false;
 	}
 
-	safe_delete(m_AttrData.m_pAttrTexture);
-
-	m_AttrData.m_pAttrTexture = new CTexture(GL_TEXTURE_2D);
-	m_AttrData.m_pAttrTexture->Generate();
-	glTextureStorage2D(m_AttrData.m_pAttrTexture->GetTextureID(), 1, GL_R8UI, ATTRMAP_XSIZE, ATTRMAP_ZSIZE);
-	glTextureSubImage2D(
-		m_AttrData.m_pAttrTexture->GetTextureID(),
-		0,
-		0, 0,
-		ATTRMAP_XSIZE,
-		ATTRMAP_ZSIZE,
-		GL_RED_INTEGER,
-		GL_UNSIGNED_BYTE,
-		m_AttrData.m_ubAttrMap.GetBaseAddr()
-	);
-	m_AttrData.m_pAttrTexture->SetFiltering(GL_NEAREST, GL_NEAREST); // <-- Important!
-	m_AttrData.m_pAttrTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-	m_AttrData.m_pAttrTexture->MakeResident();
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	return (true);
 }
 
@@ -368,26 +372,6 @@ bool CTerrain::CheckLoadingWaterMap(const std::string& stWaterMapFile)
 
 	fclose(fp);
 
-	safe_delete(m_WaterData.m_pWaterTexture);
-
-	m_WaterData.m_pWaterTexture = new CTexture(GL_TEXTURE_2D);
-	m_WaterData.m_pWaterTexture->Generate();
-	glTextureStorage2D(m_WaterData.m_pWaterTexture->GetTextureID(), 1, GL_R8UI, WATERMAP_XSIZE, WATERMAP_ZSIZE);
-	glTextureSubImage2D(
-		m_WaterData.m_pWaterTexture->GetTextureID(),
-		0,
-		0, 0,
-		WATERMAP_XSIZE,
-		WATERMAP_ZSIZE,
-		GL_RED_INTEGER,
-		GL_UNSIGNED_BYTE,
-		m_WaterData.m_ubWaterMap.GetBaseAddr()
-	);
-	m_WaterData.m_pWaterTexture->SetFiltering(GL_NEAREST, GL_NEAREST); // <-- Important!
-	m_WaterData.m_pWaterTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-	m_WaterData.m_pWaterTexture->MakeResident();
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	return (true);
 }
 
@@ -399,14 +383,13 @@ void CTerrain::UpdateWaterData()
 		return;
 	}
 
-	if (m_WaterData.m_pWaterTexture)
+	if (!m_WaterData.m_pWaterTexture || m_WaterDirtyRect.IsEmpty())
 	{
-		glTextureSubImage2D(m_WaterData.m_pWaterTexture->GetTextureID(),
-			0, 0, 0,
-			WATERMAP_XSIZE, WATERMAP_ZSIZE,
-			GL_RED_INTEGER, GL_UNSIGNED_BYTE,
-			m_WaterData.m_ubWaterMap.GetBaseAddr());
+		return;
 	}
+
+	UploadTextureRect(m_WaterData.m_pWaterTexture->GetTextureID(), m_WaterDirtyRect, WATERMAP_XSIZE, GL_RED_INTEGER, GL_UNSIGNED_BYTE, m_WaterData.m_ubWaterMap.GetBaseAddr(), sizeof(GLubyte));
+	m_WaterDirtyRect.Reset();
 }
 
 void CTerrain::GetWaterHeightByNum(GLubyte ubWaterNum, GLfloat* pfWaterHeight)
@@ -494,18 +477,6 @@ bool CTerrain::LoadSplatMapWeight(const std::string& stSplatMapWeightFile)
 		return false;
 	}
 
-	safe_delete(m_SplatData.m_pWeightTexture);
-
-	m_SplatData.m_pWeightTexture = new CTexture(GL_TEXTURE_2D);
-	m_SplatData.m_pWeightTexture->GenerateEmptyTexture2D(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA32F);
-	m_SplatData.m_pWeightTexture->SetFiltering(GL_LINEAR, GL_LINEAR); // <-- Important!
-	m_SplatData.m_pWeightTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-	m_SplatData.m_pWeightTexture->MakeResident();
-
-	glBindTexture(GL_TEXTURE_2D, m_SplatData.m_pWeightTexture->GetTextureID());
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA, GL_FLOAT, m_SplatData.weightGrid.GetBaseAddr());
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	return (true);
 }
 
@@ -532,18 +503,6 @@ bool CTerrain::LoadSplatMapIndex(const std::string& stSplatMapIndexFile)
 		return false;
 	}
 
-	safe_delete(m_SplatData.m_pIndexTexture);
-
-	m_SplatData.m_pIndexTexture = new CTexture(GL_TEXTURE_2D);
-	m_SplatData.m_pIndexTexture->GenerateEmptyTexture2D(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA32UI);
-	m_SplatData.m_pIndexTexture->SetFiltering(GL_NEAREST, GL_NEAREST); // <-- Important!
-	m_SplatData.m_pIndexTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-	m_SplatData.m_pIndexTexture->MakeResident();
-
-	glBindTexture(GL_TEXTURE_2D, m_SplatData.m_pIndexTexture->GetTextureID());
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA_INTEGER, GL_UNSIGNED_INT, m_SplatData.indexGrid.GetBaseAddr());
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	return (true);
 }
 
@@ -578,180 +537,857 @@ bool CTerrain::NewSplatMap(const std::string& stMapName)
 	fwrite(SplatMapIndexGrid.GetBaseAddr(), sizeof(SVector4Di), SplatMapIndexGrid.GetSize(), fp);
 	fclose(fp);
 
-	return (true);
+	return (true);
+}
+
+bool CTerrain::SaveSplatMap(const std::string& stMapName)
+{
+	char szFileName[256] = {};
+	GLint iTerrainID = m_iTerrCoordX * 1000L + m_iTerrCoordZ;
+	// Write the grid to file
+	FILE* fp = nullptr;
+
+	// Save the weight map grid
+	sprintf_s(szFileName, "%s\\%06d\\splat_weight.raw", stMapName.c_str(), iTerrainID);
+	errno_t err = fopen_s(&fp, szFileName, "wb");
+	if (!fp || err != 0)
+	{
+		sys_err("CTerrain::SaveSplatMap: Failed to save splat weight file: %s", szFileName);
+		return (false);
+	}
+	fwrite(m_SplatData.weightGrid.GetBaseAddr(), sizeof(SVector4Df), m_SplatData.weightGrid.GetSize(), fp);
+	fclose(fp);
+
+	// Save the index map grid
+	sprintf_s(szFileName, "%s\\%06d\\splat_index.raw", stMapName.c_str(), iTerrainID);
+	err = fopen_s(&fp, szFileName, "wb");
+	if (!fp || err != 0)
+	{
+		sys_err("CTerrain::SaveSplatMap: Failed to save splat weight file: %s", szFileName);
+		return (false);
+	}
+	fwrite(m_SplatData.indexGrid.GetBaseAddr(), sizeof(SVector4Di), m_SplatData.indexGrid.GetSize(), fp);
+	fclose(fp);
+
+	return (true);
+}
+
+void CTerrain::UpdateSplatsData()
+{
+	if (!m_SplatData.m_pWeightTexture || !m_SplatData.m_pIndexTexture || m_SplatDirtyRect.IsEmpty())
+	{
+		return;
+	}
+
+	UploadTextureRect(m_SplatData.m_pWeightTexture->GetTextureID(), m_SplatDirtyRect, TILEMAP_RAW_XSIZE, GL_RGBA, GL_FLOAT, m_SplatData.weightGrid.GetBaseAddr(), sizeof(SVector4Df));
+
+	// Upload Index Map
+	UploadTextureRect(m_SplatData.m_pIndexTexture->GetTextureID(), m_SplatDirtyRect, TILEMAP_RAW_XSIZE, GL_RGBA_INTEGER, GL_UNSIGNED_INT, m_SplatData.indexGrid.GetBaseAddr(), sizeof(SVector4Di));
+
+	m_SplatDirtyRect.Reset();
+}
+
+void CTerrain::SetSplatTexel(GLint iX, GLint iZ, const SVector4Df& weights, const SVector4Di& indices)
+{
+	if (iX < 0 || iZ < 0 || iX >= TILEMAP_RAW_XSIZE || iZ >= TILEMAP_RAW_ZSIZE)
+		return;
+
+	m_SplatData.weightGrid.Set(iX, iZ, weights);
+	m_SplatData.indexGrid.Set(iX, iZ, indices);
+	m_SplatDirtyRect.Add(iX, iZ);
+}
+
+void CTerrain::SetupBaseTexture()
+{
+	// Fill the weight grid: R=1.0, G/B/A=0.0
+	SVector4Df baseWeight(0.5f, 0.0f, 0.0f, 0.0f);
+
+	// Fill the index grid: all channels = 0
+	SVector4Di baseIndex(0, 1, 2, 3);
+
+	for (int z = 0; z < TILEMAP_RAW_ZSIZE; ++z)
+	{
+		for (int x = 0; x < TILEMAP_RAW_XSIZE; ++x)
+		{
+			m_SplatData.weightGrid.Set(x, z, baseWeight);
+			m_SplatData.indexGrid.Set(x, z, baseIndex);
+		}
+	}
+
+	// Upload to GPU
+	m_SplatDirtyRect.Add(TDirtyRect(0, 0, TILEMAP_RAW_XSIZE - 1, TILEMAP_RAW_ZSIZE - 1));
+	UpdateSplatsData();
+}
+
+void CTerrain::UpdateAttrsData()
+{
+	if (!m_AttrData.m_pAttrTexture || m_AttrDirtyRect.IsEmpty())
+	{
+		return;
+	}
+
+	UploadTextureRect(m_AttrData.m_pAttrTexture->GetTextureID(), m_AttrDirtyRect, ATTRMAP_XSIZE, GL_RED_INTEGER, GL_UNSIGNED_BYTE, m_AttrData.m_ubAttrMap.GetBaseAddr(), sizeof(GLubyte));
+	m_AttrDirtyRect.Reset();
+}
+
+/*
+ * GenerateGLState - Creates every GL object of the terrain.
+ *
+ * Must run on the thread owning the GL context, after the CPU side of the
+ * terrain (maps and patch vertices) has been built. Grids that failed to load
+ * are filled with defaults so the render path always has its four textures.
+ */
+void CTerrain::GenerateGLState()
+{
+	GenerateSplatTextures();
+	GenerateAttrTexture();
+	GenerateWaterTexture();
+
+	if (!m_uiPatchesVBO)
+	{
+		glCreateBuffers(1, &m_uiPatchesVBO);
+		glNamedBufferStorage(m_uiPatchesVBO, PATCH_XCOUNT * PATCH_ZCOUNT * PATCH_VERTEX_COUNT * sizeof(TTerrainVertex), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	if (!m_uiDrawIndirectBuffer)
+	{
+		glCreateBuffers(1, &m_uiDrawIndirectBuffer);
+		glNamedBufferStorage(m_uiDrawIndirectBuffer, PATCH_XCOUNT * PATCH_ZCOUNT * sizeof(TDrawElementsIndirectCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
+	{
+		CTerrainPatch& rPatch = m_TerrainPatches[iPatchNum];
+		UploadPatchVertices(iPatchNum);
+
+		if (rPatch.IsWaterPatch())
+		{
+			rPatch.GenerateWaterGLState();
+		}
+	}
+
+	// Everything above was uploaded whole
+	ClearDirtyRects();
+}
+
+void CTerrain::GenerateSplatTextures()
+{
+	if (!m_SplatData.weightGrid.IsInitialized())
+	{
+		m_SplatData.weightGrid.InitGrid(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, SVector4Df(0.0f));
+	}
+	if (!m_SplatData.indexGrid.IsInitialized())
+	{
+		m_SplatData.indexGrid.InitGrid(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, SVector4Di(0));
+	}
+
+	safe_delete(m_SplatData.m_pWeightTexture);
+
+	m_SplatData.m_pWeightTexture = new CTexture(GL_TEXTURE_2D);
+	m_SplatData.m_pWeightTexture->GenerateEmptyTexture2D(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA32F);
+	m_SplatData.m_pWeightTexture->SetFiltering(GL_LINEAR, GL_LINEAR); // <-- Important!
+	m_SplatData.m_pWeightTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	m_SplatData.m_pWeightTexture->MakeResident();
+
+	glBindTexture(GL_TEXTURE_2D, m_SplatData.m_pWeightTexture->GetTextureID());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA, GL_FLOAT, m_SplatData.weightGrid.GetBaseAddr());
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	safe_delete(m_SplatData.m_pIndexTexture);
+
+	m_SplatData.m_pIndexTexture = new CTexture(GL_TEXTURE_2D);
+	m_SplatData.m_pIndexTexture->GenerateEmptyTexture2D(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA32UI);
+	m_SplatData.m_pIndexTexture->SetFiltering(GL_NEAREST, GL_NEAREST); // <-- Important!
+	m_SplatData.m_pIndexTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	m_SplatData.m_pIndexTexture->MakeResident();
+
+	glBindTexture(GL_TEXTURE_2D, m_SplatData.m_pIndexTexture->GetTextureID());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, GL_RGBA_INTEGER, GL_UNSIGNED_INT, m_SplatData.indexGrid.GetBaseAddr());
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CTerrain::GenerateAttrTexture()
+{
+	if (!m_AttrData.m_ubAttrMap.IsInitialized())
+	{
+		m_AttrData.m_ubAttrMap.InitGrid(ATTRMAP_XSIZE, ATTRMAP_ZSIZE, TERRAIN_ATTRIBUTE_NONE);
+	}
+
+	safe_delete(m_AttrData.m_pAttrTexture);
+
+	m_AttrData.m_pAttrTexture = new CTexture(GL_TEXTURE_2D);
+	m_AttrData.m_pAttrTexture->Generate();
+	glTextureStorage2D(m_AttrData.m_pAttrTexture->GetTextureID(), 1, GL_R8UI, ATTRMAP_XSIZE, ATTRMAP_ZSIZE);
+	glTextureSubImage2D(
+		m_AttrData.m_pAttrTexture->GetTextureID(),
+		0,
+		0, 0,
+		ATTRMAP_XSIZE,
+		ATTRMAP_ZSIZE,
+		GL_RED_INTEGER,
+		GL_UNSIGNED_BYTE,
+		m_AttrData.m_ubAttrMap.GetBaseAddr()
+	);
+	m_AttrData.m_pAttrTexture->SetFiltering(GL_NEAREST, GL_NEAREST); // <-- Important!
+	m_AttrData.m_pAttrTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	m_AttrData.m_pAttrTexture->MakeResident();
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CTerrain::GenerateWaterTexture()
+{
+	if (!m_WaterData.m_ubWaterMap.IsInitialized())
+	{
+		m_WaterData.m_ubWaterMap.InitGrid(WATERMAP_XSIZE, WATERMAP_ZSIZE, 0xFF);
+	}
+
+	safe_delete(m_WaterData.m_pWaterTexture);
+
+	m_WaterData.m_pWaterTexture = new CTexture(GL_TEXTURE_2D);
+	m_WaterData.m_pWaterTexture->Generate();
+	glTextureStorage2D(m_WaterData.m_pWaterTexture->GetTextureID(), 1, GL_R8UI, WATERMAP_XSIZE, WATERMAP_ZSIZE);
+	glTextureSubImage2D(
+		m_WaterData.m_pWaterTexture->GetTextureID(),
+		0,
+		0, 0,
+		WATERMAP_XSIZE,
+		WATERMAP_ZSIZE,
+		GL_RED_INTEGER,
+		GL_UNSIGNED_BYTE,
+		m_WaterData.m_ubWaterMap.GetBaseAddr()
+	);
+	m_WaterData.m_pWaterTexture->SetFiltering(GL_NEAREST, GL_NEAREST); // <-- Important!
+	m_WaterData.m_pWaterTexture->SetWrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	m_WaterData.m_pWaterTexture->MakeResident();
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool CTerrain::NewTerrainProperties(const std::string& stMapName)
+{
+	GLint iTerrainID = m_iTerrCoordX * 1000 + m_iTerrCoordZ;
+
+	char c_szTerrainData[256];
+	sprintf_s(c_szTerrainData, "%s\\%06d\\TerrainData.json", stMapName.c_str(), iTerrainID);
+	json jsonMapData;
+
+	jsonMapData["script_type"] = "TerrainProperties";
+	jsonMapData["terrain_name"] = m_stTerrainName;
+
+	// Save Map Settings File
+	try
+	{
+		std::ofstream file(c_szTerrainData);
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit); // <-- this is critical
+
+		file << std::setw(4) << jsonMapData << std::endl;
+		file.close();
+
+		sys_log("CTerrain::CreateTerrainProperties: successfully created area property file (%s)", c_szTerrainData);
+	}
+	catch (const std::exception& e)
+	{
+		sys_err("CTerrain::CreateTerrainProperties: Failed to created the file %s, error: %s", c_szTerrainData, e.what());
+		return (false);
+	}
+
+	return (true);
+}
+
+bool CTerrain::SaveTerrainProperties(const std::string& stMapName)
+{
+	GLint iTerrainID = m_iTerrCoordX * 1000 + m_iTerrCoordZ;
+
+	char c_szTerrainData[256];
+	sprintf_s(c_szTerrainData, "%s\\%06d\\TerrainData.json", stMapName.c_str(), iTerrainID);
+	json jsonMapData;
+
+	jsonMapData["script_type"] = "TerrainProperties";
+	jsonMapData["terrain_name"] = m_stTerrainName;
+
+	// Save Map Settings File
+	try
+	{
+		std::ofstream file(c_szTerrainData);
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit); // <-- this is critical
+
+		file << std::setw(4) << jsonMapData << std::endl;
+		file.close();
+
+		sys_log("CTerrain::SaveTerrainProperties: successfully saved area property file (%s)", c_szTerrainData);
+	}
+	catch (const std::exception& e)
+	{
+		sys_err("CTerrain::SaveTerrainProperties: Failed to Save the file %s, error: %s", c_szTerrainData, e.what());
+		return (false);
+	}
+
+	return (true);
+}
+
+/*
+ * LoadChunk - Reads the terrain from its binary chunk.
+ * @stChunkFile: Path of the terrain.chunk file.
+ *
+ * Fills the same grids as the legacy loaders, splat weights are expanded
+ * back from bytes to [0, 1] floats. No GL call, safe on the loader thread.
+ */
+bool CTerrain::LoadChunk(const std::string& stChunkFile)
+{
+	CTerrainChunk chunk;
+	if (!chunk.Load(stChunkFile))
+	{
+		return (false);
+	}
+
+	const size_t c_uiTexelCount = static_cast<size_t>(TILEMAP_RAW_XSIZE) * TILEMAP_RAW_ZSIZE;
+	const size_t c_uiSectionSizes[TERRAIN_CHUNK_SECTION_MAX_NUM] =
+	{
+		0,	// Name, any length
+		static_cast<size_t>(HEIGHTMAP_RAW_XSIZE) * HEIGHTMAP_RAW_ZSIZE * sizeof(GLfloat),
+		static_cast<size_t>(ATTRMAP_XSIZE) * ATTRMAP_ZSIZE,
+		c_uiTexelCount * 4,
+		c_uiTexelCount * 4,
+		static_cast<size_t>(WATERMAP_XSIZE) * WATERMAP_ZSIZE,
+		0,	// Water heights, checked below
+	};
+
+	for (GLint i = 0; i < TERRAIN_CHUNK_SECTION_MAX_NUM; i++)
+	{
+		const ETerrainChunkSection eSection = static_cast<ETerrainChunkSection>(i);
+		if (!chunk.HasSection(eSection))
+		{
+			sys_err("CTerrain::LoadChunk: %s is missing section %d", stChunkFile.c_str(), i);
+			return (false);
+		}
+
+		if (c_uiSectionSizes[i] && chunk.GetSection(eSection).size() != c_uiSectionSizes[i])
+		{
+			sys_err("CTerrain::LoadChunk: %s section %d size mismatch: expected %zu, got %zu", stChunkFile.c_str(), i, c_uiSectionSizes[i], chunk.GetSection(eSection).size());
+			return (false);
+		}
+	}
+
+	const std::vector<GLubyte>& rWaterHeights = chunk.GetSection(TERRAIN_CHUNK_SECTION_WATER_HEIGHT);
+	const size_t uiNumWater = rWaterHeights.size() / sizeof(GLfloat);
+	if (rWaterHeights.size() % sizeof(GLfloat) != 0 || uiNumWater > MAX_WATER_NUM)
+	{
+		sys_err("CTerrain::LoadChunk: %s has an invalid water height section (%zu bytes)", stChunkFile.c_str(), rWaterHeights.size());
+		return (false);
+	}
+
+	const std::vector<GLubyte>& rName = chunk.GetSection(TERRAIN_CHUNK_SECTION_NAME);
+	SetName(std::string(rName.begin(), rName.end()));
+
+	m_fHeightMap.SetName("HeightMapGrid");
+	m_fHeightMap.InitGrid(HEIGHTMAP_RAW_XSIZE, HEIGHTMAP_RAW_ZSIZE);
+	memcpy(m_fHeightMap.GetBaseAddr(), chunk.GetSection(TERRAIN_CHUNK_SECTION_HEIGHT).data(), c_uiSectionSizes[TERRAIN_CHUNK_SECTION_HEIGHT]);
+
+	m_AttrData.m_ubAttrMap.SetName("AttributeMapGrid");
+	m_AttrData.m_ubAttrMap.InitGrid(ATTRMAP_XSIZE, ATTRMAP_ZSIZE);
+	memcpy(m_AttrData.m_ubAttrMap.GetBaseAddr(), chunk.GetSection(TERRAIN_CHUNK_SECTION_ATTR).data(), c_uiSectionSizes[TERRAIN_CHUNK_SECTION_ATTR]);
+
+	m_SplatData.weightGrid.SetName("SplatMapWeight");
+	m_SplatData.weightGrid.InitGrid(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE);
+	m_SplatData.indexGrid.SetName("SplatMapIndex");
+	m_SplatData.indexGrid.InitGrid(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE);
+
+	const GLubyte* pWeights = chunk.GetSection(TERRAIN_CHUNK_SECTION_SPLAT_WEIGHT).data();
+	const GLubyte* pIndices = chunk.GetSection(TERRAIN_CHUNK_SECTION_SPLAT_INDEX).data();
+	SVector4Df* pWeightTexels = m_SplatData.weightGrid.GetBaseAddr();
+	SVector4Di* pIndexTexels = m_SplatData.indexGrid.GetBaseAddr();
+
+	for (size_t i = 0; i < c_uiTexelCount; i++)
+	{
+		pWeightTexels[i] = SVector4Df(pWeights[i * 4 + 0] / 255.0f, pWeights[i * 4 + 1] / 255.0f, pWeights[i * 4 + 2] / 255.0f, pWeights[i * 4 + 3] / 255.0f);
+		pIndexTexels[i] = SVector4Di(pIndices[i * 4 + 0], pIndices[i * 4 + 1], pIndices[i * 4 + 2], pIndices[i * 4 + 3]);
+	}
+
+	m_WaterData.m_ubWaterMap.InitGrid(WATERMAP_XSIZE, WATERMAP_ZSIZE);
+	memcpy(m_WaterData.m_ubWaterMap.GetBaseAddr(), chunk.GetSection(TERRAIN_CHUNK_SECTION_WATER_MAP).data(), c_uiSectionSizes[TERRAIN_CHUNK_SECTION_WATER_MAP]);
+
+	m_WaterData.m_ubNumWater = static_cast<GLubyte>(uiNumWater);
+	for (size_t i = 0; i < MAX_WATER_NUM; ++i)
+	{
+		m_WaterData.m_fWaterHeight[i] = FLT_MIN;
+	}
+	if (uiNumWater > 0)
+	{
+		memcpy(m_WaterData.m_fWaterHeight, rWaterHeights.data(), rWaterHeights.size());
+	}
+
+	return (true);
+}
+
+/*
+ * SaveChunk - Writes the terrain to %map%\%id%\terrain.chunk.
+ * @stMapName: Map directory.
+ *
+ * Splat weights are quantized to bytes (error <= 0.5 / 255) and indices
+ * stored on a byte each, the textureset never goes past 255 entries.
+ */
+bool CTerrain::SaveChunk(const std::string& stMapName)
+{
+	const std::string stChunkFile = CTerrainChunk::GetFileName(stMapName, m_iTerrCoordX, m_iTerrCoordZ);
+
+	if (!m_fHeightMap.IsInitialized() || !m_AttrData.m_ubAttrMap.IsInitialized() || !m_WaterData.m_ubWaterMap.IsInitialized() ||
+		!m_SplatData.weightGrid.IsInitialized() || !m_SplatData.indexGrid.IsInitialized())
+	{
+		sys_err("CTerrain::SaveChunk: Failed to save chunk file: %s, terrain maps not Initialized", stChunkFile.c_str());
+		return (false);
+	}
+
+	RecalculateWaterMap();
+
+	CTerrainChunk chunk;
+	chunk.SetTerrainCoords(m_iTerrCoordX, m_iTerrCoordZ);
+
+	chunk.SetSection(TERRAIN_CHUNK_SECTION_NAME, m_stTerrainName.data(), m_stTerrainName.size());
+	chunk.SetSection(TERRAIN_CHUNK_SECTION_HEIGHT, m_fHeightMap.GetBaseAddr(), m_fHeightMap.GetSize() * sizeof(GLfloat));
+	chunk.SetSection(TERRAIN_CHUNK_SECTION_ATTR, m_AttrData.m_ubAttrMap.GetBaseAddr(), m_AttrData.m_ubAttrMap.GetSize());
+
+	const size_t c_uiTexelCount = static_cast<size_t>(TILEMAP_RAW_XSIZE) * TILEMAP_RAW_ZSIZE;
+	std::vector<GLubyte> vWeights(c_uiTexelCount * 4);
+	std::vector<GLubyte> vIndices(c_uiTexelCount * 4);
+	const SVector4Df* pWeightTexels = m_SplatData.weightGrid.GetBaseAddr();
+	const SVector4Di* pIndexTexels = m_SplatData.indexGrid.GetBaseAddr();
+
+	for (size_t i = 0; i < c_uiTexelCount; i++)
+	{
+		const GLfloat c_fWeights[4] = { pWeightTexels[i].x, pWeightTexels[i].y, pWeightTexels[i].z, pWeightTexels[i].w };
+		const GLint c_iIndices[4] = { pIndexTexels[i].x, pIndexTexels[i].y, pIndexTexels[i].z, pIndexTexels[i].w };
+
+		for (GLint c = 0; c < 4; c++)
+		{
+			vWeights[i * 4 + c] = static_cast<GLubyte>(MyMath::fminmax(0.0f, c_fWeights[c], 1.0f) * 255.0f + 0.5f);
+			vIndices[i * 4 + c] = static_cast<GLubyte>(MyMath::iminmax(0, c_iIndices[c], 255));
+		}
+	}
+
+	chunk.SetSection(TERRAIN_CHUNK_SECTION_SPLAT_WEIGHT, vWeights.data(), vWeights.size());
+	chunk.SetSection(TERRAIN_CHUNK_SECTION_SPLAT_INDEX, vIndices.data(), vIndices.size());
+
+	chunk.SetSection(TERRAIN_CHUNK_SECTION_WATER_MAP, m_WaterData.m_ubWaterMap.GetBaseAddr(), m_WaterData.m_ubWaterMap.GetSize());
+	chunk.SetSection(TERRAIN_CHUNK_SECTION_WATER_HEIGHT, m_WaterData.m_fWaterHeight, m_WaterData.m_ubNumWater * sizeof(GLfloat));
+
+	return (chunk.Save(stChunkFile));
+}
+
+/*
+ * LoadLegacyFiles - Reads TerrainData.json and the raw maps of the terrain.
+ * @stMapName: Map directory.
+ *
+ * Only the property file is mandatory, a missing map is logged and
+ * replaced by its default content.
+ */
+bool CTerrain::LoadLegacyFiles(const std::string& stMapName)
+{
+	const GLint iTerrainID = m_iTerrCoordX * 1000 + m_iTerrCoordZ;
+	const char* c_szMapDirectory = stMapName.c_str();
+
+	char c_szTerrainData[256];
+	sprintf_s(c_szTerrainData, "%s\\%06d\\TerrainData.json", c_szMapDirectory, iTerrainID);
+
+	// Open and read file
+	std::ifstream file(c_szTerrainData);
+	if (!file.is_open())
+	{
+		sys_err("CTerrain::LoadLegacyFiles: Failed to open Terrain Data File file: %s", c_szTerrainData);
+		return (false);
+	}
+
+	// Parse JSON
+	json jsonData;
+
+	try
+	{
+		file >> jsonData;
+	}
+	catch (const json::parse_error& e)
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) JSON parse error for File %s, error: %s", m_iTerrCoordX, m_iTerrCoordZ, c_szTerrainData, e.what());
+		return (false);
+	}
+
+	if (!jsonData.contains("script_type"))
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) JSON parse error File %s, error: Failed to Load Script Type", m_iTerrCoordX, m_iTerrCoordZ, c_szTerrainData);
+		return (false);
+	}
+
+	if (!jsonData.contains("terrain_name"))
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) JSON parse error File %s, error: Failed to Load Terrain Name", m_iTerrCoordX, m_iTerrCoordZ, c_szTerrainData);
+		return (false);
+	}
+
+	const std::string& stScriptType = jsonData["script_type"].get<std::string>();
+	const std::string& stTerrainName = jsonData["terrain_name"].get<std::string>();
+
+	if (stScriptType != "TerrainProperties")
+	{
+		sys_err("CTerrain::LoadLegacyFiles: Terrain Data FileFormat Error");
+		return (false);
+	}
+
+	char szRawHeightMapFileName[256];
+	char szRawAttributeMapFileName[256];
+	char szRawSplatWeightMapFileName[256];
+	char szRawSplatIndexMapFileName[256];
+	char szRawWaterMapFileName[256];
+
+	_snprintf_s(szRawHeightMapFileName, sizeof(szRawHeightMapFileName), "%s\\%06d\\height.raw", c_szMapDirectory, iTerrainID);
+	_snprintf_s(szRawAttributeMapFileName, sizeof(szRawAttributeMapFileName), "%s\\%06d\\attr.raw", c_szMapDirectory, iTerrainID);
+	_snprintf_s(szRawSplatWeightMapFileName, sizeof(szRawSplatWeightMapFileName), "%s\\%06d\\splat_weight.raw", c_szMapDirectory, iTerrainID);
+	_snprintf_s(szRawSplatIndexMapFileName, sizeof(szRawSplatIndexMapFileName), "%s\\%06d\\splat_index.raw", c_szMapDirectory, iTerrainID);
+	_snprintf_s(szRawWaterMapFileName, sizeof(szRawWaterMapFileName), "%s\\%06d\\water.raw", c_szMapDirectory, iTerrainID);
+
+	if (!LoadHeightMap(szRawHeightMapFileName))
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) Failed to Load HeightMap (%s)", m_iTerrCoordX, m_iTerrCoordZ, szRawHeightMapFileName);
+	}
+	if (!LoadAttributeMap(szRawAttributeMapFileName))
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) Failed to Load AttributeMap (%s)", m_iTerrCoordX, m_iTerrCoordZ, szRawAttributeMapFileName);
+	}
+	if (!LoadSplatMapWeight(szRawSplatWeightMapFileName))
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) Failed to Load SplatMap Weight (%s)", m_iTerrCoordX, m_iTerrCoordZ, szRawSplatWeightMapFileName);
+	}
+	if (!LoadSplatMapIndex(szRawSplatIndexMapFileName))
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) Failed to Load SplatMap Index (%s)", m_iTerrCoordX, m_iTerrCoordZ, szRawSplatIndexMapFileName);
+	}
+	if (!LoadWaterMap(szRawWaterMapFileName))
+	{
+		sys_err("CTerrain::LoadLegacyFiles: (%d, %d) Failed to Load WaterMap (%s)", m_iTerrCoordX, m_iTerrCoordZ, szRawWaterMapFileName);
+	}
+
+	// Missing maps get the defaults GenerateGLState would give them, a converted terrain has them all
+	if (!m_fHeightMap.IsInitialized())
+	{
+		m_fHeightMap.InitGrid(HEIGHTMAP_RAW_XSIZE, HEIGHTMAP_RAW_ZSIZE, 0.0f);
+	}
+	if (!m_AttrData.m_ubAttrMap.IsInitialized())
+	{
+		m_AttrData.m_ubAttrMap.InitGrid(ATTRMAP_XSIZE, ATTRMAP_ZSIZE, TERRAIN_ATTRIBUTE_NONE);
+	}
+	if (!m_SplatData.weightGrid.IsInitialized())
+	{
+		m_SplatData.weightGrid.InitGrid(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, SVector4Df(0.0f));
+	}
+	if (!m_SplatData.indexGrid.IsInitialized())
+	{
+		m_SplatData.indexGrid.InitGrid(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE, SVector4Di(0));
+	}
+
+	SetName(stTerrainName);
+	return (true);
+}
+
+// bGenerateGLState is false when the terrain is built off the GL thread, see GenerateGLState.
+// A terrain whose GL state was never generated (headless tools) stays CPU only either way.
+// The dirty patches are rebuilt on the job system when called from one of its threads, then
+// uploaded in order, each one only from the first to the last vertex row reached by the height changes.
+void CTerrain::CalculateTerrainPatches(bool bGenerateGLState)
+{
+	constexpr GLint iPatchCount = PATCH_XCOUNT * PATCH_ZCOUNT;
+
+	GLint aiDirtyPatches[iPatchCount];
+	GLint iDirtyCount = 0;
+
+	for (GLint iPatchNum = 0; iPatchNum < iPatchCount; iPatchNum++)
+	{
+		if (m_TerrainPatches[iPatchNum].IsUpdateNeeded())
+		{
+			aiDirtyPatches[iDirtyCount++] = iPatchNum;
+		}
+	}
+
+	bool abRebuilt[iPatchCount] = {};
+
+	const auto fnRebuild = [this, &aiDirtyPatches, &abRebuilt](GLint iBegin, GLint iEnd)
+	{
+		for (GLint i = iBegin; i < iEnd; i++)
+		{
+			const GLint iPatchNum = aiDirtyPatches[i];
+			abRebuilt[iPatchNum] = CalculateTerrainPatch(iPatchNum % PATCH_XCOUNT, iPatchNum / PATCH_XCOUNT);
+		}
+	};
+
+	// A patch only reads the terrain maps and writes itself, but rebuilds the missing maps first
+	const bool bMapsReady = m_fHeightMap.IsInitialized() && m_WaterData.m_ubWaterMap.IsInitialized();
+
+	// The terrain loader rebuilds alone, its chunks would land in the queue the main thread drains mid-frame
+	if (iDirtyCount > 1 && bMapsReady && CJobSystem::HasInstance() && CJobSystem::Instance().IsJobThread())
+	{
+		CJobSystem::Instance().ParallelFor(0, iDirtyCount, 1, fnRebuild);
+	}
+	else
+	{
+		fnRebuild(0, iDirtyCount);
+	}
+
+	if (!bGenerateGLState || !m_uiPatchesVBO)
+	{
+		return;
+	}
+
+	// GL objects stay on the calling thread, only the rows reached by the height changes are sent
+	for (GLint i = 0; i < iDirtyCount; i++)
+	{
+		const GLint iPatchNum = aiDirtyPatches[i];
+		if (!abRebuilt[iPatchNum])
+		{
+			continue;
+		}
+
+		GLint iFirstRow = 0;
+		GLint iLastRow = PATCH_ZSIZE;
+		GetPatchDirtyRows(m_HeightDirtyRect, iPatchNum % PATCH_XCOUNT, iPatchNum / PATCH_XCOUNT, &iFirstRow, &iLastRow);
+
+		CTerrainPatch& rPatch = m_TerrainPatches[iPatchNum];
+		UploadPatchVertices(iPatchNum, iFirstRow, iLastRow);
+
+		// If the patch has water, add the water vertices
+		if (rPatch.IsWaterPatch())
+		{
+			rPatch.GenerateWaterGLState();
+		}
+	}
+
+	m_HeightDirtyRect.Reset();
+}
+
+// Copies rows iFirstRow to iLastRow of the patch vertices into its range of the terrain vertex buffer
+void CTerrain::UploadPatchVertices(GLint iPatchNum, GLint iFirstRow, GLint iLastRow)
+{
+	if (!m_uiPatchesVBO)
+	{
+		return;
+	}
+
+	const std::vector<TTerrainVertex>& rVertices = m_TerrainPatches[iPatchNum].GetPatchVertices();
+	if (rVertices.size() != PATCH_VERTEX_COUNT)
+	{
+		sys_err("CTerrain::UploadPatchVertices: Patch %d has %zu vertices, expected %d", iPatchNum, rVertices.size(), PATCH_VERTEX_COUNT);
+		return;
+	}
+
+	iFirstRow = MyMath::imax(iFirstRow, 0);
+	iLastRow = MyMath::imin(iLastRow, PATCH_ZSIZE);
+	if (iFirstRow > iLastRow)
+	{
+		return;
+	}
+
+	const GLint iFirstVertex = iFirstRow * (PATCH_XSIZE + 1);
+	const GLint iVertexCount = (iLastRow - iFirstRow + 1) * (PATCH_XSIZE + 1);
+
+	const GLintptr offset = (static_cast<GLintptr>(iPatchNum) * PATCH_VERTEX_COUNT + iFirstVertex) * sizeof(TTerrainVertex);
+	glNamedBufferSubData(m_uiPatchesVBO, offset, iVertexCount * sizeof(TTerrainVertex), rVertices.data() + iFirstVertex);
 }
 
-bool CTerrain::SaveSplatMap(const std::string& stMapName)
+/*
+ * GetPatchDirtyRows - Vertex rows of a patch to upload after height edits.
+ * @heightRect: Changed heightmap cells.
+ * @iPatchNumX: Patch column.
+ * @iPatchNumZ: Patch row.
+ * @piFirstRow: Receives the first row, 0 to PATCH_ZSIZE.
+ * @piLastRow: Receives the last row, inclusive.
+ *
+ * A height also moves the normals of the vertices around it, so the rect
+ * is grown by one cell. Rows are whole, the patch range in the terrain
+ * vertex buffer stays one contiguous upload. When the rect misses the
+ * patch it was rebuilt for another reason and every row is returned.
+ */
+bool CTerrain::GetPatchDirtyRows(const TDirtyRect& heightRect, GLint iPatchNumX, GLint iPatchNumZ, GLint* piFirstRow, GLint* piLastRow)
 {
-	char szFileName[256] = {};
-	GLint iTerrainID = m_iTerrCoordX * 1000L + m_iTerrCoordZ;
-	// Write the grid to file
-	FILE* fp = nullptr;
+	*piFirstRow = 0;
+	*piLastRow = PATCH_ZSIZE;
 
-	// Save the weight map grid
-	sprintf_s(szFileName, "%s\\%06d\\splat_weight.raw", stMapName.c_str(), iTerrainID);
-	errno_t err = fopen_s(&fp, szFileName, "wb");
-	if (!fp || err != 0)
+	if (heightRect.IsEmpty())
 	{
-		sys_err("CTerrain::SaveSplatMap: Failed to save splat weight file: %s", szFileName);
 		return (false);
 	}
-	fwrite(m_SplatData.weightGrid.GetBaseAddr(), sizeof(SVector4Df), m_SplatData.weightGrid.GetSize(), fp);
-	fclose(fp);
 
-	// Save the index map grid
-	sprintf_s(szFileName, "%s\\%06d\\splat_index.raw", stMapName.c_str(), iTerrainID);
-	err = fopen_s(&fp, szFileName, "wb");
-	if (!fp || err != 0)
+	const GLint iPatchStartX = iPatchNumX * PATCH_XSIZE;
+	const GLint iPatchStartZ = iPatchNumZ * PATCH_ZSIZE;
+
+	const GLint iFirstColumn = MyMath::imax(heightRect.iMinX - 1 - iPatchStartX, 0);
+	const GLint iLastColumn = MyMath::imin(heightRect.iMaxX + 1 - iPatchStartX, PATCH_XSIZE);
+	const GLint iFirstRow = MyMath::imax(heightRect.iMinZ - 1 - iPatchStartZ, 0);
+	const GLint iLastRow = MyMath::imin(heightRect.iMaxZ + 1 - iPatchStartZ, PATCH_ZSIZE);
+
+	if (iFirstColumn > iLastColumn || iFirstRow > iLastRow)
 	{
-		sys_err("CTerrain::SaveSplatMap: Failed to save splat weight file: %s", szFileName);
 		return (false);
 	}
-	fwrite(m_SplatData.indexGrid.GetBaseAddr(), sizeof(SVector4Di), m_SplatData.indexGrid.GetSize(), fp);
-	fclose(fp);
 
+	*piFirstRow = iFirstRow;
+	*piLastRow = iLastRow;
 	return (true);
 }
 
-void CTerrain::UpdateSplatsData()
+/*
+ * UploadTextureRect - Sends the cells of a dirty rect to a texture.
+ * @uiTexture: Texture with the size of the grid.
+ * @rect: Cells to upload, inside the grid.
+ * @iGridWidth: Texels per grid row.
+ * @eFormat: Pixel format of the grid.
+ * @eType: Pixel type of the grid.
+ * @pGridBase: First texel of the grid.
+ * @lTexelSize: Bytes per texel.
+ *
+ * The unpack row length lets glTextureSubImage2D read the rect straight
+ * from the grid, it is set back to 0 for the other uploads.
+ */
+void CTerrain::UploadTextureRect(GLuint uiTexture, const TDirtyRect& rect, GLint iGridWidth, GLenum eFormat, GLenum eType, const void* pGridBase, GLsizeiptr lTexelSize)
 {
-	if (!m_SplatData.m_pWeightTexture || !m_SplatData.m_pIndexTexture)
+	if (!uiTexture || !pGridBase || rect.IsEmpty())
 	{
 		return;
 	}
 
-	glTextureSubImage2D(m_SplatData.m_pWeightTexture->GetTextureID(),
-		0, 0, 0,
-		TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE,
-		GL_RGBA, GL_FLOAT,
-		m_SplatData.weightGrid.GetBaseAddr());
+	const GLubyte* pFirstTexel = static_cast<const GLubyte*>(pGridBase) + (static_cast<GLsizeiptr>(rect.iMinZ) * iGridWidth + rect.iMinX) * lTexelSize;
 
-	// Upload Index Map
-	glTextureSubImage2D(m_SplatData.m_pIndexTexture->GetTextureID(),
-		0, 0, 0,
-		TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE,
-		GL_RGBA_INTEGER, GL_UNSIGNED_INT,
-		m_SplatData.indexGrid.GetBaseAddr());
- }
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, iGridWidth);
+	glTextureSubImage2D(uiTexture, 0, rect.iMinX, rect.iMinZ, rect.GetWidth(), rect.GetDepth(), eFormat, eType, pFirstTexel);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
 
-void CTerrain::SetSplatTexel(GLint iX, GLint iZ, const SVector4Df& weights, const SVector4Di& indices)
+const TDirtyRect& CTerrain::GetHeightDirtyRect() const
 {
-	if (iX < 0 || iZ < 0 || iX >= TILEMAP_RAW_XSIZE || iZ >= TILEMAP_RAW_ZSIZE)
-		return;
-
-	m_SplatData.weightGrid.Set(iX, iZ, weights);
-	m_SplatData.indexGrid.Set(iX, iZ, indices);
+	return (m_HeightDirtyRect);
 }
 
-void CTerrain::SetupBaseTexture()
+const TDirtyRect& CTerrain::GetSplatDirtyRect() const
 {
-	// Fill the weight grid: R=1.0, G/B/A=0.0
-	SVector4Df baseWeight(0.5f, 0.0f, 0.0f, 0.0f);
+	return (m_SplatDirtyRect);
+}
 
-	// Fill the index grid: all channels = 0
-	SVector4Di baseIndex(0, 1, 2, 3);
+const TDirtyRect& CTerrain::GetAttrDirtyRect() const
+{
+	return (m_AttrDirtyRect);
+}
 
-	for (int z = 0; z < TILEMAP_RAW_ZSIZE; ++z)
-	{
-		for (int x = 0; x < TILEMAP_RAW_XSIZE; ++x)
-		{
-			m_SplatData.weightGrid.Set(x, z, baseWeight);
-			m_SplatData.indexGrid.Set(x, z, baseIndex);
-		}
-	}
+const TDirtyRect& CTerrain::GetWaterDirtyRect() const
+{
+	return (m_WaterDirtyRect);
+}
 
-	// Upload to GPU
-	UpdateSplatsData();
+void CTerrain::ClearDirtyRects()
+{
+	m_HeightDirtyRect.Reset();
+	m_SplatDirtyRect.Reset();
+	m_AttrDirtyRect.Reset();
+	m_WaterDirtyRect.Reset();
 }
 
-void CTerrain::UpdateAttrsData()
+// A vertex on a patch border belongs to the patches on both sides, as in PutTerrainHeightMap
+void CTerrain::AddHeightDirtyRect(const TDirtyRect& rect)
 {
-	if (!m_AttrData.m_pAttrTexture)
+	TDirtyRect heightRect = rect;
+	heightRect.Clip(HEIGHTMAP_RAW_XSIZE, HEIGHTMAP_RAW_ZSIZE);
+	if (heightRect.IsEmpty())
 	{
 		return;
 	}
 
-	glTextureSubImage2D(m_AttrData.m_pAttrTexture->GetTextureID(),
-		0, 0, 0,
-		ATTRMAP_XSIZE, ATTRMAP_ZSIZE,
-		GL_RED_INTEGER, GL_UNSIGNED_BYTE,
-		m_AttrData.m_ubAttrMap.GetBaseAddr());
-}
-
-bool CTerrain::NewTerrainProperties(const std::string& stMapName)
-{
-	GLint iTerrainID = m_iTerrCoordX * 1000 + m_iTerrCoordZ;
-
-	char c_szTerrainData[256];
-	sprintf_s(c_szTerrainData, "%s\\%06d\\TerrainData.json", stMapName.c_str(), iTerrainID);
-	json jsonMapData;
-
-	jsonMapData["script_type"] = "TerrainProperties";
-	jsonMapData["terrain_name"] = m_stTerrainName;
-
-	// Save Map Settings File
-	try
-	{
-		std::ofstream file(c_szTerrainData);
-		file.exceptions(std::ofstream::failbit | std::ofstream::badbit); // <-- this is critical
+	m_HeightDirtyRect.Add(heightRect);
 
-		file << std::setw(4) << jsonMapData << std::endl;
-		file.close();
+	const GLint iFirstPatchX = MyMath::imax((heightRect.iMinX - 1) / PATCH_XSIZE, 0);
+	const GLint iFirstPatchZ = MyMath::imax((heightRect.iMinZ - 1) / PATCH_ZSIZE, 0);
+	const GLint iLastPatchX = MyMath::imin(heightRect.iMaxX / PATCH_XSIZE, PATCH_XCOUNT - 1);
+	const GLint iLastPatchZ = MyMath::imin(heightRect.iMaxZ / PATCH_ZSIZE, PATCH_ZCOUNT - 1);
 
-		sys_log("CTerrain::CreateTerrainProperties: successfully created area property file (%s)", c_szTerrainData);
-	}
-	catch (const std::exception& e)
+	for (GLint iPatchZ = iFirstPatchZ; iPatchZ <= iLastPatchZ; iPatchZ++)
 	{
-		sys_err("CTerrain::CreateTerrainProperties: Failed to created the file %s, error: %s", c_szTerrainData, e.what());
-		return (false);
+		for (GLint iPatchX = iFirstPatchX; iPatchX <= iLastPatchX; iPatchX++)
+		{
+			m_TerrainPatches[iPatchZ * PATCH_XCOUNT + iPatchX].SetUpdateNeed(true);
+		}
 	}
-
-	return (true);
 }
 
-bool CTerrain::SaveTerrainProperties(const std::string& stMapName)
+void CTerrain::AddSplatDirtyRect(const TDirtyRect& rect)
 {
-	GLint iTerrainID = m_iTerrCoordX * 1000 + m_iTerrCoordZ;
-
-	char c_szTerrainData[256];
-	sprintf_s(c_szTerrainData, "%s\\%06d\\TerrainData.json", stMapName.c_str(), iTerrainID);
-	json jsonMapData;
+	TDirtyRect splatRect = rect;
+	splatRect.Clip(TILEMAP_RAW_XSIZE, TILEMAP_RAW_ZSIZE);
+	m_SplatDirtyRect.Add(splatRect);
+}
 
-	jsonMapData["script_type"] = "TerrainProperties";
-	jsonMapData["terrain_name"] = m_stTerrainName;
+void CTerrain::AddAttrDirtyRect(const TDirtyRect& rect)
+{
+	TDirtyRect attrRect = rect;
+	attrRect.Clip(ATTRMAP_XSIZE, ATTRMAP_ZSIZE);
+	m_AttrDirtyRect.Add(attrRect);
+}
 
-	// Save Map Settings File
-	try
+// Water cells decide the water patches, every patch under the rect is rebuilt
+void CTerrain::AddWaterDirtyRect(const TDirtyRect& rect)
+{
+	TDirtyRect waterRect = rect;
+	waterRect.Clip(WATERMAP_XSIZE, WATERMAP_ZSIZE);
+	if (waterRect.IsEmpty())
 	{
-		std::ofstream file(c_szTerrainData);
-		file.exceptions(std::ofstream::failbit | std::ofstream::badbit); // <-- this is critical
+		return;
+	}
 
-		file << std::setw(4) << jsonMapData << std::endl;
-		file.close();
+	m_WaterDirtyRect.Add(waterRect);
 
-		sys_log("CTerrain::SaveTerrainProperties: successfully saved area property file (%s)", c_szTerrainData);
-	}
-	catch (const std::exception& e)
+	for (GLint iPatchZ = waterRect.iMinZ / PATCH_ZSIZE; iPatchZ <= waterRect.iMaxZ / PATCH_ZSIZE; iPatchZ++)
 	{
-		sys_err("CTerrain::SaveTerrainProperties: Failed to Save the file %s, error: %s", c_szTerrainData, e.what());
-		return (false);
+		for (GLint iPatchX = waterRect.iMinX / PATCH_XSIZE; iPatchX <= waterRect.iMaxX / PATCH_XSIZE; iPatchX++)
+		{
+			m_TerrainPatches[iPatchZ * PATCH_XCOUNT + iPatchX].SetUpdateNeed(true);
+		}
 	}
+}
 
-	return (true);
+void CTerrain::UpdateDirtyData()
+{
+	UpdateSplatsData();
+	UpdateAttrsData();
+	UpdateWaterData();
+	CalculateTerrainPatches();
 }
 
-void CTerrain::CalculateTerrainPatches()
+/*
+ * BuildPatchDrawCommands - Builds the indirect draw list of a terrain.
+ * @ulVisibleMask: Bit N set when patch N has to be drawn.
+ * @vCommands: Receives one command per visible patch, in patch order.
+ *
+ * Every patch draws the whole shared index buffer, the base vertex selects
+ * its range of the terrain vertex buffer. Pure CPU, returns the number of
+ * commands written.
+ */
+GLsizei CTerrain::BuildPatchDrawCommands(GLuint64 ulVisibleMask, std::vector<TDrawElementsIndirectCommand>& vCommands)
 {
-	for (GLint iPatchNumZ = 0; iPatchNumZ < PATCH_ZCOUNT; iPatchNumZ++)
+	static_assert(PATCH_XCOUNT * PATCH_ZCOUNT <= 64, "visibility mask holds 64 patches");
+
+	vCommands.clear();
+
+	for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
 	{
-		for (GLint iPatchNumX = 0; iPatchNumX < PATCH_XCOUNT; iPatchNumX++)
+		if ((ulVisibleMask & (static_cast<GLuint64>(1) << iPatchNum)) == 0)
 		{
-			CalculateTerrainPatch(iPatchNumX, iPatchNumZ);
+			continue;
 		}
+
+		TDrawElementsIndirectCommand command{};
+		command.uiCount = PATCH_INDEX_COUNT;
+		command.uiInstanceCount = 1;
+		command.uiFirstIndex = 0;
+		command.iBaseVertex = iPatchNum * PATCH_VERTEX_COUNT;
+		command.uiBaseInstance = iPatchNum;
+		vCommands.emplace_back(command);
 	}
+
+	return (static_cast<GLsizei>(vCommands.size()));
 }
 
-void CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
+// Builds the CPU side of the patch only, returns false if it was up to date
+bool CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
 {
 	if (!m_fHeightMap.IsInitialized())
 	{
@@ -775,10 +1411,11 @@ void CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
 
 	if (rPatch.IsUpdateNeeded() == false)
 	{
-		return;
+		return (false);
 	}
 
-	rPatch.Clear();
+	// Keeps the water buffers of the patch, GenerateWaterGLState refills them
+	rPatch.ResetData();
 
 	// ex: 1 * 32 = 32 .. 2 * 32 = 64 .. etc
 	GLint iPatchStartX = iPatchNumX * PATCH_XSIZE;
@@ -792,9 +1429,10 @@ void CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
 	GLfloat fPatchXSizeMeters = PATCH_XSIZE * CELL_SCALE_METER;
 	GLfloat fPatchZSizeMeters = PATCH_ZSIZE * CELL_SCALE_METER;
 
+	// Y is grown over every terrain vertex and water quad of the patch
 	TBoundingBox patchBox{};
-	patchBox.v3Min = SVector3Df(fX, 0.0f, fZ);
-	patchBox.v3Max = SVector3Df(fX + fPatchXSizeMeters, 0.0f, fZ + fPatchZSizeMeters);
+	patchBox.v3Min = SVector3Df(fX, FLT_MAX, fZ);
+	patchBox.v3Max = SVector3Df(fX + fPatchXSizeMeters, -FLT_MAX, fZ + fPatchZSizeMeters);
 
 	GLfloat fOrigX = fX;
 	GLfloat fOrigZ = fZ;
@@ -834,14 +1472,8 @@ void CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
 			GLfloat fHeight = (*pHeight++);
 
 			// complete bonuding box with height
-			if (fHeight > -999999.0f)
-			{
-				patchBox.v3Max.y = fHeight;
-			}
-			if (fHeight < 999999.0f)
-			{
-				patchBox.v3Min.y = fHeight;
-			}
+			patchBox.v3Min.y = MyMath::fmin(patchBox.v3Min.y, fHeight);
+			patchBox.v3Max.y = MyMath::fmax(patchBox.v3Max.y, fHeight);
 
 			// Create Terrain vertex
 			TTerrainVertex vertex;
@@ -987,6 +1619,10 @@ void CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
 							iWaterVertexCount += 6;
 							bPatchHasWater = true;
 							rPatch.SetWaterHeight(fWaterHeight);
+
+							// Water surface may stand above the terrain
+							patchBox.v3Min.y = MyMath::fmin(patchBox.v3Min.y, fWaterHeight);
+							patchBox.v3Max.y = MyMath::fmax(patchBox.v3Max.y, fWaterHeight);
 						}
 					}
 				}
@@ -1008,14 +1644,6 @@ void CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
 	// Must Init Indices since it's removed from Generating GL State
 	rPatch.InitPatchIndices();
 	rPatch.CalculatePatchNormals();
-	rPatch.GenerateGLState();
-
-	// If the patch has water, add the water vertices
-	if (bPatchHasWater)
-	{
-		rPatch.GenerateWaterGLState();
-
-	}
 
 	// Set the bounding box for the patch
 	rPatch.SetBoundingBox(patchBox);
@@ -1023,155 +1651,45 @@ void CTerrain::CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ)
 
 	// Set the patch as updated
 	rPatch.SetUpdateNeed(false);
+	return (true);
 }
 
-// Helper to calculate plane equation (nx*x + ny*y + nz*z + d = 0)
-// Point p on plane, normal n
-SVector4Df CTerrain::CalculateClipPlane(const SVector3Df& v4Normal, const SVector3Df& v3Point)
+// Main camera pass only, see CTerrainMap::Render for the water passes
+void CTerrain::Render()
 {
-	float d = -v4Normal.dot(v3Point);
-	return SVector4Df(v4Normal.x, v4Normal.y, v4Normal.z, d);
+	m_iCulledPatchesNum = RenderPatches(CCameraManager::Instance().GetCurrentCameraRef());
 }
 
-// --- Main Render Loop Adjustment ---
-// The main loop should orchestrate the passes per patch
-void CTerrain::Render()
+void CTerrain::CollectWaterHeights(const SFrustumCulling& frustumCulling, std::vector<GLfloat>& vWaterHeights) const
 {
-	// Loop through all terrain patches to find water patches
-	for (GLubyte bPatchNumZ = 0; bPatchNumZ < PATCH_ZCOUNT; bPatchNumZ++)
+	for (GLint iPatchNum = 0; iPatchNum < PATCH_XCOUNT * PATCH_ZCOUNT; iPatchNum++)
 	{
-		for (GLubyte bPatchNumX = 0; bPatchNumX < PATCH_XCOUNT; bPatchNumX++)
+		const CTerrainPatch& rTerrainPatch = m_TerrainPatches[iPatchNum];
+		if (!rTerrainPatch.IsWaterPatch())
 		{
-			GLint iPatchNum = bPatchNumZ * PATCH_XCOUNT + bPatchNumX;
-			CTerrainPatch& rTerrainPatch = m_TerrainPatches[iPatchNum];
+			continue;
+		}
 
-			if (rTerrainPatch.IsWaterPatch())
-			{
-				// Perform reflection and refraction passes for THIS specific water patch
-				// Pass the patch's height to the rendering functions
-				RenderTerrainReflectionPass(rTerrainPatch.GetWaterHeight());
-				RenderTerrainRefractionPass(rTerrainPatch.GetWaterHeight());
-			}
+		TBoundingBox boundingBox = rTerrainPatch.GetBoundingBox();
+		if (frustumCulling.IsBoxInsideViewFrustum(boundingBox.v3Min, boundingBox.v3Max))
+		{
+			vWaterHeights.push_back(rTerrainPatch.GetWaterHeight());
 		}
 	}
-
-	glDisable(GL_CLIP_DISTANCE0);
-
-	// --- Draw Terrain to Main FBO ---
-	// Pass the current camera and the "no-op" clipping plane.
-	// This ensures the terrain shader receives a uniform, but it doesn't clip any geometry.
-	CWindow::Instance().GetFrameBuffer()->BindForWriting();
-	RenderPatches(CCameraManager::Instance().GetCurrentCameraRef(), SVector4Df(0.0f, 0.0f, 0.0f, 0.0f));
-
-	// --- Draw Water to Main FBO ---
-	// The water shader will now sample from the reflection/refraction FBOs
-	// that were populated in the earlier passes.
-	RenderWater();
-	CWindow::Instance().GetFrameBuffer()->UnBindWriting();
-
-}
-
-// --- Modified Reflection Pass ---
-// Now accepts the specific water height for the current patch
-void CTerrain::RenderTerrainReflectionPass(float fWaterHeight)
-{
-	// 1. Bind the Reflection FBO for writing
-	m_pOwnerTerrainMap->GetReflectionFBOPtr()->BindForWriting();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	const CCamera& rOriginalCamera = CCameraManager::Instance().GetCurrentCameraRef();
-	CCamera reflectionCamera = rOriginalCamera; // Start with a copy of the original camera
-
-	// Mirror the camera position across THIS specific water patch's plane
-	SVector3Df v3OriginalCamPos = rOriginalCamera.GetPosition();
-	SVector3Df v3ReflectedCamPos = v3OriginalCamPos;
-	v3ReflectedCamPos.y = fWaterHeight - (v3OriginalCamPos.y - fWaterHeight);
-	reflectionCamera.SetPosition(v3ReflectedCamPos);
-
-	reflectionCamera.InvertCameraPitch();
-
-	// --- Define the clipping plane for THIS reflection pass ---
-	// Clip geometry *below* this water patch's surface.
-	SVector3Df v3PlaneNormal(0.0f, 1.0f, 0.0f); // Points upwards
-	// Offset slightly above this water patch's level to avoid artifacts
-	SVector3Df v3PointOnPlane(0.0f, fWaterHeight + 0.1f, 0.0f); // Use the provided waterHeight
-	SVector4Df v4ReflectionClipPlane = CalculateClipPlane(v3PlaneNormal, v3PointOnPlane);
-
-	// Enable clipping and change culling for reflection pass
-	glEnable(GL_CLIP_DISTANCE0);
-	glCullFace(GL_FRONT);
-
-	// Render the terrain using the reflected camera and specific clipping plane
-	// Make sure RenderPatches (or terrain.draw()) uses the passed camera and clip plane
-	// (This requires modifying `terrain.draw()` or a helper to pass these arguments,
-	// as per my previous answer's `RenderPatches(camera, clipPlane)` suggestion)
-	RenderPatches(reflectionCamera, v4ReflectionClipPlane); // Pass specific camera & clip plane
-
-	// Render reflection-specific volumetric clouds (if they should be clipped too)
-	// This `reflectionVolumetricClouds.draw()` should also use the reflection camera and clip plane.
-	// You might need a `draw(camera, clipPlane)` overload for it.
-	// For now, let's assume it handles its own camera and clipping.
-	// If clouds should *not* be clipped (i.e., you see the whole sky reflection)
-	// then draw them *before* enabling GL_CLIP_DISTANCE0.
-
-	CWindow::Instance().GetSkyBox()->Render(reflectionCamera);
-
-	// Restore culling and disable clipping
-	glCullFace(GL_BACK);
-	glDisable(GL_CLIP_DISTANCE0);
-
-	m_pOwnerTerrainMap->GetReflectionFBOPtr()->UnBindWriting();
-}
-
-void CTerrain::RenderTerrainRefractionPass(float fWaterHeight)
-{
-	// 1. Bind the Refraction FBO for writing
-	m_pOwnerTerrainMap->GetRefractionFBOPtr()->BindForWriting();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear refraction FBO
-
-	const CCamera& rOriginalCamera = CCameraManager::Instance().GetCurrentCameraRef();
-	// For refraction, we use the original camera.
-
-	// --- Define the clipping plane for THIS refraction pass ---
-	// Clip geometry *above* this water patch's surface.
-	SVector3Df v3PlaneNormal(0.0f, -1.0f, 0.0f); // Points downwards
-	// Offset slightly below this water patch's level to avoid artifacts
-	SVector3Df v3PointOnPlane(0.0f, fWaterHeight - 0.1f, 0.0f); // Use the provided waterHeight
-	SVector4Df v4RefractionClipPlane = CalculateClipPlane(v3PlaneNormal, v3PointOnPlane);
-
-	glEnable(GL_CLIP_DISTANCE0); // Enable clipping plane 0
-
-	// Render the terrain using the original camera and specific clipping plane
-	RenderPatches(rOriginalCamera, v4RefractionClipPlane); // Pass specific camera & clip plane
-	CWindow::Instance().GetSkyBox()->Render(rOriginalCamera);
-
-	glDisable(GL_CLIP_DISTANCE0); // Disable clipping plane 0
-
-	// 3. Unbind the Refraction FBO
-	m_pOwnerTerrainMap->GetRefractionFBOPtr()->UnBindWriting();
 }
 
-void CTerrain::RenderPatches(const CCamera& renderCam, const SVector4Df& v4ClipPlane)
+// Returns the number of patches rejected by the frustum. renderCam is only
+// used for culling, the shaders read the view from the frame uniform block.
+GLint CTerrain::RenderPatches(const CCamera& renderCam)
 {
 	CShader* pShader = m_pOwnerTerrainMap->GetTerrainShaderPtr();
 	pShader->Use();
 
 	CMatrix4Df matVewProj = renderCam.GetViewProjMatrix();
-	SVector3Df v3CamPos = renderCam.GetPosition();
-
-	// Vertex Shader
-	pShader->setMat4("u_matViewProjection", matVewProj);
 
 	// Tessellation Control Shader
-	pShader->setVec3("u_v3CameraPos", v3CamPos);
 	pShader->setFloat("u_fTessMultiplier", 0.5f);
 
-	// Tessellation Evaluation Shader
-	pShader->setMat4("u_mat4ViewProj", matVewProj);
-	pShader->setVec3("u_v3CameraPos", v3CamPos);
-
-	pShader->setVec4("u_v4ClipPlane", v4ClipPlane.x, v4ClipPlane.y, v4ClipPlane.z, v4ClipPlane.w);
-
 	// Fragment Shader
 	pShader->setBindlessSampler2D("splatWeightMap", m_SplatData.m_pWeightTexture->GetHandle());
 	pShader->setBindlessSampler2D("splatIndexMap", m_SplatData.m_pIndexTexture->GetHandle());
@@ -1186,6 +1704,11 @@ void CTerrain::RenderPatches(const CCamera& renderCam, const SVector4Df& v4ClipP
 	pShader->setBool("u_DebugVisualizeAttrMap", false);
 	pShader->setBool("u_DebugVisualizeWater", false);
 
+	SFrustumCulling frustumCulling(matVewProj);
+	GLint iCulledPatches = 0;
+
+	GLuint64 ulVisibleMask = 0;
+
 	for (GLubyte bPatchNumZ = 0; bPatchNumZ < PATCH_ZCOUNT; bPatchNumZ++)
 	{
 		for (GLubyte bPatchNumX = 0; bPatchNumX < PATCH_XCOUNT; bPatchNumX++)
@@ -1193,37 +1716,58 @@ void CTerrain::RenderPatches(const CCamera& renderCam, const SVector4Df& v4ClipP
 			GLint iPatchNum = bPatchNumZ * PATCH_XCOUNT + bPatchNumX;
 
 			CTerrainPatch& rTerrainPatch = m_TerrainPatches[iPatchNum];
-			// Render the patch with the selected LOD
-			rTerrainPatch.RenderPatch();
+
+			TBoundingBox boundingBox = rTerrainPatch.GetBoundingBox();
+			if (!frustumCulling.IsBoxInsideViewFrustum(boundingBox.v3Min, boundingBox.v3Max))
+			{
+				iCulledPatches++;
+				continue;
+			}
+
+			ulVisibleMask |= static_cast<GLuint64>(1) << iPatchNum;
 		}
 	}
+
+	const GLuint uiVAO = CTerrainVAO::GetVAO();
+	if (!uiVAO || !m_uiPatchesVBO || !m_uiDrawIndirectBuffer)
+	{
+		return (iCulledPatches);
+	}
+
+	const GLsizei iDrawCount = BuildPatchDrawCommands(ulVisibleMask, m_vDrawCommands);
+	if (iDrawCount == 0)
+	{
+		return (iCulledPatches);
+	}
+
+	glNamedBufferSubData(m_uiDrawIndirectBuffer, 0, iDrawCount * sizeof(TDrawElementsIndirectCommand), m_vDrawCommands.data());
+
+	// The shared index buffer is already bound to the VAO
+	glBindVertexArray(uiVAO);
+	glVertexArrayVertexBuffer(uiVAO, 0, m_uiPatchesVBO, 0, sizeof(TTerrainVertex));
+
+	// Set number of control points per patch (must match tessellation control shader)
+	glPatchParameteri(GL_PATCH_VERTICES, 3);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_uiDrawIndirectBuffer);
+	glMultiDrawElementsIndirect(GL_PATCHES, GL_UNSIGNED_INT, nullptr, iDrawCount, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindVertexArray(0);
+
+	return (iCulledPatches);
 }
 
-void CTerrain::RenderWater()
+// Draws the water patches lying on the plane fWaterHeight
+void CTerrain::RenderWater(GLfloat fWaterHeight)
 {
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	auto pCamera = CCameraManager::Instance().GetCurrentCamera();
-	CMatrix4Df matVewProj = pCamera->GetViewProjMatrix();
-	SVector3Df v3CamPos = pCamera->GetPosition();
-
-	// Water Rendering
+	// Water Rendering, camera and light come from the frame uniform block
 	CShader* pWaterShader = m_pOwnerTerrainMap->GetWaterShaderPtr();
 
 	pWaterShader->Use();
-	pWaterShader->setMat4("ViewProjectionMatrix", matVewProj);
-	pWaterShader->setVec3("u_v3CameraPosition", v3CamPos);
-
-	auto pSkyBox = CWindow::Instance().GetSkyBox();
-
-	SVector3Df v3LightPos = pSkyBox->GetLightPos();// - CCameraManager::Instance().GetCurrentCamera()->GetPosition());
-	SVector3Df v3LightDir = pSkyBox->GetLightDir();
-	v3LightDir.normalize();
-
-	pWaterShader->setVec3("v3LightDirection", v3LightDir);
-	pWaterShader->setVec3("v3LightColor", pSkyBox->GetLightColor());
-	pWaterShader->setVec3("v3LightPos", v3LightPos);
 
 	pWaterShader->setInt("DUDVMapTexture", 0);
 	pWaterShader->setInt("NormalMapTexture", 1);
@@ -1254,7 +1798,7 @@ void CTerrain::RenderWater()
 
 			CTerrainPatch& rTerrainPatch = m_TerrainPatches[iPatchNum];
 			// Render the patch with the selected LOD
-			if (rTerrainPatch.IsWaterPatch())
+			if (rTerrainPatch.IsWaterPatch() && rTerrainPatch.GetWaterHeight() == fWaterHeight)
 			{
 				rTerrainPatch.RenderWater();
 			}
@@ -1272,7 +1816,7 @@ CTerrainPatch* CTerrain::GetTerrainPatchPtr(GLint iPatchNumX, GLint iPatchNumZ)
 		return (nullptr);
 	}
 
-	return &m_TerrainPatches[iPatchNumX * PATCH_XCOUNT + iPatchNumZ];
+	return &m_TerrainPatches[iPatchNumZ * PATCH_XCOUNT + iPatchNumX];
 }
 
 SVector2Df CTerrain::GetWorldOrigin() const
@@ -1322,6 +1866,11 @@ GLint CTerrain::GetTerrainNumber() const
 	return (m_iTerrainNum);
 }
 
+GLint CTerrain::GetCulledPatchesNum() const
+{
+	return (m_iCulledPatchesNum);
+}
+
 GLfloat CTerrain::GetHeightMapValue(GLint iX, GLint iZ)
 {
 	return (m_fHeightMap.Get(iX, iZ));
@@ -1428,6 +1977,122 @@ GLfloat CTerrain::GetHeight(GLfloat fX, GLfloat fZ)
 	return GLfloat(0.0f);
 }
 
+/*
+ * GetHeights - Same interpolation as GetHeight, TERRAIN_HEIGHT_BATCH_LANES points at a time.
+ *
+ * The corner heights of each lane are read like GetHeight reads them, then
+ * the triangle pick, slopes and height run on the whole block with SSE2
+ * selects. The operations and their order are the ones of GetHeight, so the
+ * heights are bit for bit the same. A lane off the tile keeps zero corners
+ * and comes out at 0 like GetHeight.
+ *
+ * @pfXs, @pfZs: World coordinates, indexed by puiIndices.
+ * @puiIndices: Points to interpolate.
+ * @sCount: Number of indices.
+ * @pfHeights: Receives each height at the index of its point.
+ * @pv3Normals: Receives each surface normal at the index of its point, or nullptr.
+ */
+void CTerrain::GetHeights(const GLfloat* pfXs, const GLfloat* pfZs, const GLuint* puiIndices, size_t sCount, GLfloat* pfHeights, SVector3Df* pv3Normals)
+{
+	const GLfloat fInvCellScale = 1.0f / static_cast<GLfloat>(CELL_SCALE_METER);
+
+	alignas(16) GLfloat afLocalX[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afLocalZ[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afTL[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afTR[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afBL[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afBR[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afSlopeX[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afSlopeZ[TERRAIN_HEIGHT_BATCH_LANES];
+	alignas(16) GLfloat afHeight[TERRAIN_HEIGHT_BATCH_LANES];
+
+	for (size_t sBlock = 0; sBlock < sCount; sBlock += TERRAIN_HEIGHT_BATCH_LANES)
+	{
+		const size_t sLanes = std::min(TERRAIN_HEIGHT_BATCH_LANES, sCount - sBlock);
+
+		for (size_t sLane = 0; sLane < TERRAIN_HEIGHT_BATCH_LANES; ++sLane)
+		{
+			afLocalX[sLane] = afLocalZ[sLane] = 0.0f;
+			afTL[sLane] = afTR[sLane] = afBL[sLane] = afBR[sLane] = 0.0f;
+
+			if (sLane >= sLanes)
+			{
+				continue;
+			}
+
+			const GLuint uiPoint = puiIndices[sBlock + sLane];
+			GLint iX = static_cast<GLint>(pfXs[uiPoint]) - m_iTerrCoordX * TERRAIN_XSIZE;
+			GLint iZ = static_cast<GLint>(pfZs[uiPoint]) - m_iTerrCoordZ * TERRAIN_ZSIZE;
+
+			if (iX < 0 || iZ < 0 || iX > TERRAIN_XSIZE || iZ > TERRAIN_ZSIZE)
+			{
+				continue;
+			}
+
+			GLint iGridX = iX / CELL_SCALE_METER;
+			GLint iGridZ = iZ / CELL_SCALE_METER;
+
+			afLocalX[sLane] = static_cast<GLfloat>(iX % CELL_SCALE_METER);
+			afLocalZ[sLane] = static_cast<GLfloat>(iZ % CELL_SCALE_METER);
+			afTL[sLane] = m_fHeightMap.Get(iGridX, iGridZ);
+			afTR[sLane] = m_fHeightMap.Get(iGridX + 1, iGridZ);
+			afBL[sLane] = m_fHeightMap.Get(iGridX, iGridZ + 1);
+			afBR[sLane] = m_fHeightMap.Get(iGridX + 1, iGridZ + 1);
+		}
+
+#if defined(MATH_SIMD_SSE)
+		const __m128 xInvCellScale = _mm_set1_ps(fInvCellScale);
+		const __m128 xLocalX = _mm_load_ps(afLocalX);
+		const __m128 xLocalZ = _mm_load_ps(afLocalZ);
+		const __m128 xTL = _mm_load_ps(afTL);
+		const __m128 xTR = _mm_load_ps(afTR);
+		const __m128 xBL = _mm_load_ps(afBL);
+		const __m128 xBR = _mm_load_ps(afBR);
+
+		// All ones where fLocalX <= fLocalZ, the lane is in the TL-BL-BR triangle
+		const __m128 xUpper = _mm_cmple_ps(xLocalX, xLocalZ);
+
+		const __m128 xDiffX = _mm_or_ps(_mm_and_ps(xUpper, _mm_sub_ps(xBR, xBL)), _mm_andnot_ps(xUpper, _mm_sub_ps(xTR, xTL)));
+		const __m128 xDiffZ = _mm_or_ps(_mm_and_ps(xUpper, _mm_sub_ps(xBL, xTL)), _mm_andnot_ps(xUpper, _mm_sub_ps(xBR, xTR)));
+		const __m128 xSlopeX = _mm_mul_ps(xDiffX, xInvCellScale);
+		const __m128 xSlopeZ = _mm_mul_ps(xDiffZ, xInvCellScale);
+
+		_mm_store_ps(afSlopeX, xSlopeX);
+		_mm_store_ps(afSlopeZ, xSlopeZ);
+		_mm_store_ps(afHeight, _mm_add_ps(_mm_add_ps(xTL, _mm_mul_ps(xLocalX, xSlopeX)), _mm_mul_ps(xLocalZ, xSlopeZ)));
+#else
+		for (size_t sLane = 0; sLane < TERRAIN_HEIGHT_BATCH_LANES; ++sLane)
+		{
+			if (afLocalX[sLane] <= afLocalZ[sLane])
+			{
+				afSlopeX[sLane] = (afBR[sLane] - afBL[sLane]) * fInvCellScale;
+				afSlopeZ[sLane] = (afBL[sLane] - afTL[sLane]) * fInvCellScale;
+			}
+			else
+			{
+				afSlopeX[sLane] = (afTR[sLane] - afTL[sLane]) * fInvCellScale;
+				afSlopeZ[sLane] = (afBR[sLane] - afTR[sLane]) * fInvCellScale;
+			}
+
+			afHeight[sLane] = afTL[sLane] + (afLocalX[sLane] * afSlopeX[sLane]) + (afLocalZ[sLane] * afSlopeZ[sLane]);
+		}
+#endif
+
+		for (size_t sLane = 0; sLane < sLanes; ++sLane)
+		{
+			const GLuint uiPoint = puiIndices[sBlock + sLane];
+			pfHeights[uiPoint] = afHeight[sLane];
+
+			if (pv3Normals)
+			{
+				// Height grows by slopeX per meter along X and slopeZ along Z
+				pv3Normals[uiPoint] = SVector3Df(-afSlopeX[sLane], 1.0f, -afSlopeZ[sLane]);
+				pv3Normals[uiPoint].normalize();
+			}
+		}
+	}
+}
+
 GLfloat CTerrain::GetHeightMapValueGlobalNew(GLfloat fX, GLfloat fZ)
 {
 	const GLfloat fHeightMapXSize = HEIGHTMAP_RAW_XSIZE;
@@ -1925,6 +2590,16 @@ TTerrainSplatData& CTerrain::GetSplatData()
 	return m_SplatData;
 }
 
+TTerrainAttrData& CTerrain::GetAttrData()
+{
+	return (m_AttrData);
+}
+
+TTerrainWaterData& CTerrain::GetWaterData()
+{
+	return (m_WaterData);
+}
+
 bool CTerrain::IsAttributeOn(GLint iX, GLint iZ, GLubyte ubAttrFlag)
 {
 	if (iX < 0 || iZ < 0)
@@ -2290,6 +2965,8 @@ void CTerrain::DrawAttributeBrush(GLbyte bBrushShape, GLubyte ubAttrType, GLint
 				{
 					m_AttrData.m_ubAttrMap[iZ * ATTRMAP_XSIZE + iX] |= ubAttrType;
 				}
+
+				m_AttrDirtyRect.Add(iX, iZ);
 			}
 		}
 
@@ -2314,6 +2991,8 @@ void CTerrain::DrawAttributeBrush(GLbyte bBrushShape, GLubyte ubAttrType, GLint
 				{
 					m_AttrData.m_ubAttrMap[iZ * ATTRMAP_XSIZE + iX] |= ubAttrType;
 				}
+
+				m_AttrDirtyRect.Add(iX, iZ);
 			}
 		}
 	}
@@ -2393,6 +3072,9 @@ void CTerrain::DrawWaterBrush(GLbyte bBrushShape, GLint iCellX, GLint iCellZ, GL
 
 					// Update AttrMap to contain water as well
 					GLint iAttrToWaterRatio = ATTRMAP_XSIZE / WATERMAP_XSIZE;
+					m_WaterDirtyRect.Add(iX, iZ);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio, iZ * iAttrToWaterRatio);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio + 1, iZ * iAttrToWaterRatio + 1);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] &= ~(TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + (iX * iAttrToWaterRatio + 1)] &= ~(TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[(iZ * iAttrToWaterRatio + 1) * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] &= ~(TERRAIN_ATTRIBUTE_WATER);
@@ -2409,6 +3091,9 @@ void CTerrain::DrawWaterBrush(GLbyte bBrushShape, GLint iCellX, GLint iCellZ, GL
 
 					// Update AttrMap to contain water as well
 					GLint iAttrToWaterRatio = ATTRMAP_XSIZE / WATERMAP_XSIZE;
+					m_WaterDirtyRect.Add(iX, iZ);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio, iZ * iAttrToWaterRatio);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio + 1, iZ * iAttrToWaterRatio + 1);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] |= (TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + (iX * iAttrToWaterRatio + 1)] |= (TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[(iZ * iAttrToWaterRatio + 1) * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] |= (TERRAIN_ATTRIBUTE_WATER);
@@ -2426,7 +3111,7 @@ void CTerrain::DrawWaterBrush(GLbyte bBrushShape, GLint iCellX, GLint iCellZ, GL
 				GLint iX = static_cast<GLint>(fCenterX) + xOffset;
 				GLint iZ = static_cast<GLint>(fCenterZ) + zOffset;
 
-				if (iX < 0 || iZ < 0 || iX >= ATTRMAP_XSIZE || iZ >= ATTRMAP_ZSIZE)
+				if (iX < 0 || iZ < 0 || iX >= WATERMAP_XSIZE || iZ >= WATERMAP_ZSIZE)
 					continue;
 
 				GLint iOffset = iZ * WATERMAP_XSIZE + iX;
@@ -2446,6 +3131,9 @@ void CTerrain::DrawWaterBrush(GLbyte bBrushShape, GLint iCellX, GLint iCellZ, GL
 
 					// Update AttrMap to contain water as well
 					GLint iAttrToWaterRatio = ATTRMAP_XSIZE / WATERMAP_XSIZE;
+					m_WaterDirtyRect.Add(iX, iZ);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio, iZ * iAttrToWaterRatio);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio + 1, iZ * iAttrToWaterRatio + 1);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] &= ~(TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + (iX * iAttrToWaterRatio + 1)] &= ~(TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[(iZ * iAttrToWaterRatio + 1) * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] &= ~(TERRAIN_ATTRIBUTE_WATER);
@@ -2462,6 +3150,9 @@ void CTerrain::DrawWaterBrush(GLbyte bBrushShape, GLint iCellX, GLint iCellZ, GL
 
 					// Update AttrMap to contain water as well
 					GLint iAttrToWaterRatio = ATTRMAP_XSIZE / WATERMAP_XSIZE;
+					m_WaterDirtyRect.Add(iX, iZ);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio, iZ * iAttrToWaterRatio);
+					m_AttrDirtyRect.Add(iX * iAttrToWaterRatio + 1, iZ * iAttrToWaterRatio + 1);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] |= (TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[iZ * iAttrToWaterRatio * ATTRMAP_XSIZE + (iX * iAttrToWaterRatio + 1)] |= (TERRAIN_ATTRIBUTE_WATER);
 					m_AttrData.m_ubAttrMap[(iZ * iAttrToWaterRatio + 1) * ATTRMAP_XSIZE + iX * iAttrToWaterRatio] |= (TERRAIN_ATTRIBUTE_WATER);
@@ -2472,6 +3163,7 @@ void CTerrain::DrawWaterBrush(GLbyte bBrushShape, GLint iCellX, GLint iCellZ, GL
 	}
 
 	UpdateWaterData();
+	UpdateAttrsData();
 	CalculateTerrainPatches();
 }
 
@@ -2750,28 +3442,22 @@ void CTerrain::PutTerrainHeightMap(GLfloat fX, GLfloat fZ, GLfloat fValue, bool
 	// No +1 here
 	GLint iPos = (iZ) * HEIGHTMAP_RAW_XSIZE + (iX);
 	m_fHeightMap[iPos] = fValue;
+	m_HeightDirtyRect.Add(iX, iZ);
 
-	// Mark affected patch as needing update
-	GLint patchX = MyMath::imax(iX, 0) / PATCH_XSIZE;
-	GLint patchZ = MyMath::imax(iZ, 0) / PATCH_ZSIZE;
-	GLint iPatchPos = patchZ * PATCH_XCOUNT + patchX;
-	if (iPatchPos >= 0 && iPatchPos < PATCH_XCOUNT * PATCH_ZCOUNT)
-		m_TerrainPatches[iPatchPos].SetUpdateNeed(true);
+	// Mark every patch sharing this vertex as needing update, a vertex on a
+	// patch border belongs to up to 4 patches (their boxes must follow too)
+	GLint patchX = iX / PATCH_XSIZE;
+	GLint patchZ = iZ / PATCH_ZSIZE;
+	GLint iFirstPatchX = (iX % PATCH_XSIZE == 0) ? patchX - 1 : patchX;
+	GLint iFirstPatchZ = (iZ % PATCH_ZSIZE == 0) ? patchZ - 1 : patchZ;
 
-	// Check and mark adjacent patches (border cases)
-	if (iZ % PATCH_ZSIZE == 0)
-	{
-		if (iX % PATCH_XSIZE == 0)
-			iPatchPos = (patchZ - 1) * PATCH_XCOUNT + (patchX - 1);
-		else
-			iPatchPos = (patchZ - 1) * PATCH_XCOUNT + patchX;
-	}
-	else if (iX % PATCH_XSIZE == 0)
+	for (GLint iPatchZ = MyMath::imax(iFirstPatchZ, 0); iPatchZ <= patchZ && iPatchZ < PATCH_ZCOUNT; iPatchZ++)
 	{
-		iPatchPos = patchZ * PATCH_XCOUNT + (patchX - 1);
+		for (GLint iPatchX = MyMath::imax(iFirstPatchX, 0); iPatchX <= patchX && iPatchX < PATCH_XCOUNT; iPatchX++)
+		{
+			m_TerrainPatches[iPatchZ * PATCH_XCOUNT + iPatchX].SetUpdateNeed(true);
+		}
 	}
-	if (iPatchPos >= 0 && iPatchPos < PATCH_XCOUNT * PATCH_ZCOUNT)
-		m_TerrainPatches[iPatchPos].SetUpdateNeed(true);
 
 	if (!bRecursive)
 		return;
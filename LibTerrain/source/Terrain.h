@@ -7,6 +7,8 @@
 
 class CTerrainMap;
 
+constexpr size_t TERRAIN_HEIGHT_BATCH_LANES = 4;	// Points interpolated together by CTerrain::GetHeights
+
 typedef struct STerrainSplatData
 {
 	CGrid<SVector4Di> indexGrid;	// Texture indices (0-255 per channel)
@@ -111,19 +113,35 @@ public:
 	bool NewTerrainProperties(const std::string& stMapName);
 	bool SaveTerrainProperties(const std::string& stMapName);
 
-	void CalculateTerrainPatches();
+	// Binary chunk (terrain.chunk) holding the properties and every map of the terrain
+	bool LoadChunk(const std::string& stChunkFile);
+	bool SaveChunk(const std::string& stMapName);
+	// TerrainData.json and raw maps, read for maps that were not converted yet
+	bool LoadLegacyFiles(const std::string& stMapName);
+
+	void CalculateTerrainPatches(bool bGenerateGLState = true);
+	void GenerateGLState();
+
+	// One command per visible patch (bit N of ulVisibleMask is patch N)
+	static GLsizei BuildPatchDrawCommands(GLuint64 ulVisibleMask, std::vector<TDrawElementsIndirectCommand>& vCommands);
 protected:
-	void CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ);
-	SVector4Df CalculateClipPlane(const SVector3Df& v4Normal, const SVector3Df& v3Point);
+	bool CalculateTerrainPatch(GLint iPatchNumX, GLint iPatchNumZ);
+	void UploadPatchVertices(GLint iPatchNum, GLint iFirstRow = 0, GLint iLastRow = PATCH_ZSIZE);
+	// Uploads the cells of rect from a grid iGridWidth texels wide
+	static void UploadTextureRect(GLuint uiTexture, const TDirtyRect& rect, GLint iGridWidth, GLenum eFormat, GLenum eType, const void* pGridBase, GLsizeiptr lTexelSize);
+	void GenerateSplatTextures();
+	void GenerateAttrTexture();
+	void GenerateWaterTexture();
 
 public:
+	// Main camera pass, water passes are planned by CTerrainMap::Render
 	void Render();
 
-	void RenderTerrainReflectionPass(float fWaterHeight);
-	void RenderTerrainRefractionPass(float fWaterHeight);
+	GLint RenderPatches(const CCamera& renderCam);
+	void RenderWater(GLfloat fWaterHeight);
 
-	void RenderPatches(const CCamera& renderCam, const SVector4Df& v4ClipPlane);
-	void RenderWater();
+	// Appends the height of every water patch inside the frustum
+	void CollectWaterHeights(const SFrustumCulling& frustumCulling, std::vector<GLfloat>& vWaterHeights) const;
 
 	CTerrainPatch* GetTerrainPatchPtr(GLint iPatchNumX, GLint iPatchNumZ);
 
@@ -141,23 +159,48 @@ public:
 	void SetTerrainNumber(GLint iTerrainNum);
 	GLint GetTerrainNumber() const;
 
+	// Patches rejected by the frustum in the last RenderPatches call
+	GLint GetCulledPatchesNum() const;
+
 	// HeightMap
 	GLfloat GetHeightMapValue(GLint iX, GLint iZ);
 	GLfloat GetHeightMapValue(GLfloat fX, GLfloat fZ);
 	CGrid<GLfloat>& GetHeightMap();
 	GLfloat GetHeight(GLfloat fX, GLfloat fZ);
+	// GetHeight of the listed points, all of them on this tile; pv3Normals may be nullptr
+	void GetHeights(const GLfloat* pfXs, const GLfloat* pfZs, const GLuint* puiIndices, size_t sCount, GLfloat* pfHeights, SVector3Df* pv3Normals);
 	GLfloat GetHeightMapValueGlobal(GLfloat fX, GLfloat fZ);
 	GLfloat GetHeightMapValueGlobalNew(GLfloat fX, GLfloat fZ);
 
 	void SetTerrainMapOwner(CTerrainMap* pTerrainMapOwner);
 	CTerrainMap* GetTerrainMapOwner();
 	TTerrainSplatData& GetSplatData();
+	TTerrainAttrData& GetAttrData();
+	TTerrainWaterData& GetWaterData();
 
 	bool IsAttributeOn(GLint iX, GLint iZ, GLubyte ubAttrFlag);
 	GLubyte GetAttribute(GLint iX, GLint iZ);
 
 	void RecalculateWaterMap();
 
+	// Cells changed since their last upload, each reset once its grid has been uploaded
+	const TDirtyRect& GetHeightDirtyRect() const;
+	const TDirtyRect& GetSplatDirtyRect() const;
+	const TDirtyRect& GetAttrDirtyRect() const;
+	const TDirtyRect& GetWaterDirtyRect() const;
+	void ClearDirtyRects();
+
+	// Grows a dirty rect after its grid was written from outside, height and water also mark the patches they reach
+	void AddHeightDirtyRect(const TDirtyRect& rect);
+	void AddSplatDirtyRect(const TDirtyRect& rect);
+	void AddAttrDirtyRect(const TDirtyRect& rect);
+	void AddWaterDirtyRect(const TDirtyRect& rect);
+	// Uploads the dirty rects and rebuilds the patches marked for update
+	void UpdateDirtyData();
+
+	// Vertex rows of a patch that follow from the changed heights, false (and every row) when the rect misses it
+	static bool GetPatchDirtyRows(const TDirtyRect& heightRect, GLint iPatchNumX, GLint iPatchNumZ, GLint* piFirstRow, GLint* piLastRow);
+
 	// Editing Map Functions
 	void DrawHeightBrush(GLubyte bBrushShape, GLubyte bBrushType, GLint iCellx, GLint iCellZ, GLint iBrushSize, GLint iBrushStrength);
 	void DrawTextureBrush(GLubyte bBrushShape, GLint iCellX, GLint iCellZ, GLint iSubCellX, GLint iSubCellZ, GLint iBrushSize, GLint iBrushStrength, GLint iSelectedTextureIndex);
@@ -191,8 +234,15 @@ protected:
 	// Terrain Patches
 	CTerrainPatch m_TerrainPatches[PATCH_XCOUNT * PATCH_ZCOUNT];
 
+	// Vertices of all patches (patch N starts at N * PATCH_VERTEX_COUNT)
+	GLuint m_uiPatchesVBO;
+	// Indirect draw commands of the visible patches
+	GLuint m_uiDrawIndirectBuffer;
+	std::vector<TDrawElementsIndirectCommand> m_vDrawCommands;
+
 	// HeightMap
 	CGrid<GLfloat> m_fHeightMap;
+	TDirtyRect m_HeightDirtyRect;
 
 	// The terrain num among terrains (0,0) - (1, 0) - (1, 1);
 	GLint m_iTerrCoordX, m_iTerrCoordZ;
@@ -206,17 +256,23 @@ protected:
 	// Terrain Number
 	GLint m_iTerrainNum;
 
+	// Culled Patches Count (last RenderPatches call)
+	GLint m_iCulledPatchesNum;
+
 	// Owner Terrain Map poineter
 	CTerrainMap* m_pOwnerTerrainMap;
 
 	// Splat Data
 	TTerrainSplatData m_SplatData;
+	TDirtyRect m_SplatDirtyRect;
 
 	// Attributes Data
 	TTerrainAttrData m_AttrData;
+	TDirtyRect m_AttrDirtyRect;
 
 	// Water Data
 	TTerrainWaterData m_WaterData;
+	TDirtyRect m_WaterDirtyRect;
 
 	// Light Data
 	TTerrainLightingData m_LightingData;
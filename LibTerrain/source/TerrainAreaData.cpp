@@ -1,6 +1,7 @@
 #include "Stdafx.h"
 #include "TerrainAreaData.h"
 #include "../../LibGame/source/PhysicsObject.h"
+#include "../../LibMath/source/ray.h"
 
 CTerrainAreaData::CTerrainAreaData()
 {
@@ -19,23 +20,44 @@ void CTerrainAreaData::Clear()
 {
 	m_iAreaNum = 0;
 	m_vObjectsGroups.clear();
+
+	m_ObjectsBVH.Clear();
+	m_vBVHInstances.clear();
+	m_vGroupFirstItems.clear();
 }
 
 void CTerrainAreaData::Destroy()
 {
-	Clear();
 	for (auto & group : m_vObjectsGroups)
 	{
 		if (group.vecObjects.size() > 0)
 		{
 			for (auto& objectData : group.vecObjects)
 			{
+				if (objectData && objectData->pPhysicsObject)
+				{
+					// the physics world owns and deletes the object
+					CPhysicsWorld::Instance().RemoveObject(objectData->pPhysicsObject);
+					objectData->pPhysicsObject = nullptr;
+				}
 				safe_delete(objectData); // Delete each object data instance
 			}
 			group.vecObjects.clear();
 		}
+
+		if (group.uiInstanceBuffer)
+		{
+			glDeleteBuffers(1, &group.uiInstanceBuffer);
+			group.uiInstanceBuffer = 0;
+		}
+
+		if (group.uiVisibleBuffer)
+		{
+			glDeleteBuffers(1, &group.uiVisibleBuffer);
+			group.uiVisibleBuffer = 0;
+		}
 	}
-	m_vObjectsGroups.clear();
+	Clear();
 }
 
 void CTerrainAreaData::SetTerrainAreaDataMap(CTerrainMap* pMap)
@@ -91,98 +113,352 @@ void CTerrainAreaData::AddObjectInstanceGroup(CShader* pShader, CMesh* pMesh, co
 
 void CTerrainAreaData::RenderAreaObjects(GLfloat fDeltaTime)
 {
-	CMatrix4Df View = CCameraManager::Instance().GetCurrentCamera()->GetMatrix();
-	CMatrix4Df Projection{};
-	Projection.InitPersProjTransform(CCameraManager::Instance().GetCurrentCamera()->GetPersProjInfo());
+	// Physics is stepped by CWindow::Update, only blend its last two states here
+	UpdateInstanceMatrices(CPhysicsWorld::Instance().GetInterpolationAlpha());
+
+	const CCamera& rCamera = CCameraManager::Instance().GetCurrentCameraRef();
+	CullInstances(SFrustumCulling(rCamera.GetViewProjMatrix()), rCamera.GetPosition());
 
-	CMatrix4Df WVP = Projection * View;
+	CRingBuffer* pRingBuffer = m_pOwnerTerrainMap ? &m_pOwnerTerrainMap->GetInstanceRingBuffer() : nullptr;
 
-	const auto& objectGroups = GetObjectsGroups();
-	for (const auto& group : objectGroups)
+	for (auto& group : m_vObjectsGroups)
 	{
-		if (group.vecObjects.empty() || !group.pMesh || !group.pShader)
+		if (group.vecInstanceMatrices.empty() || !group.pMesh || !group.pShader)
 		{
 			continue;
 		}
 
-		// Create TEMPORARY lists for only the VISIBLE objects
-		std::vector<CMatrix4Df> visibleWorldMatrices;
-		std::vector<CMatrix4Df> visibleWvpMatrices;
+		// Matrices are uploaded even when nothing is visible, so they never fall behind
+		UploadInstanceMatrices(group, pRingBuffer);
 
-		// Reserve memory to avoid reallocations
-		visibleWorldMatrices.reserve(group.vecObjects.size());
-		visibleWvpMatrices.reserve(group.vecObjects.size());
+		if (group.uiVisibleCount == 0)
+		{
+			continue;
+		}
+
+		GLuint uiIndexBuffer = 0;
+		const GLintptr lIndexOffset = UploadVisibleInstances(group, pRingBuffer, &uiIndexBuffer);
+
+		// World * ViewProj is done by the vertex shader with the FrameUniforms block
+		group.pShader->Use();
+		group.pMesh->Render(group.uiVisibleCount, group.uiInstanceBuffer, uiIndexBuffer, lIndexOffset);
 
 		for (auto& objectData : group.vecObjects)
 		{
-			if (!objectData)
+			if (objectData && objectData->pPhysicsObject)
 			{
-				continue;
+				// 3. Create a TEMPORARY world-space box for drawing this frame
+				SBoundingBox worldBox = objectData->pPhysicsObject->GetBoundingBoxWorld();
+
+				// 4. Draw the correctly transformed box
+				//AABB.Draw(worldBox.v3Min, worldBox.v3Max);
+				worldBox.Draw(objectData->pPhysicsObject->IsSelectedObject());
 			}
+		}
+	}
+}
 
-			// You can add a distance check
-			float distanceToCamera = (CCameraManager::Instance().GetCurrentCamera()->GetPosition() - objectData->WorldTranslation.GetPosition()).length();
+/*
+ * UpdateInstanceMatrices - Brings the instance matrices up to date.
+ * @fPhysicsAlpha: Blend factor between the last two physics states.
+ *
+ * Each drawn object is compared with the matrix stored for it, only the
+ * ones that differ are written and marked for upload. Objects added or
+ * removed shift the following slots, which then differ as well. A static
+ * scene therefore costs one compare per object and no upload after its
+ * first frame. No GL call, usable without a context.
+ *
+ * The objects BVH follows: moved boxes are refitted, a slot added or
+ * removed anywhere builds it again.
+ */
+GLuint CTerrainAreaData::UpdateInstanceMatrices(GLfloat fPhysicsAlpha)
+{
+	GLuint uiChanged = 0;
+	bool bLayoutChanged = m_vGroupFirstItems.size() != m_vObjectsGroups.size();
 
-			// e.g., Don't render grass patches that are more than 8000 units away
-			if (distanceToCamera > 8000.0f)
-			{
-				//continue; // Skip to the next object
-			}
+	for (size_t iGroup = 0; iGroup < m_vObjectsGroups.size(); iGroup++)
+	{
+		TObjectInstanceGroup& group = m_vObjectsGroups[iGroup];
+		GLuint uiInstance = 0;
 
-			if (objectData->eObjectType == OBJECT_TYPE_NONE)
+		for (SObjectData* pObjectData : group.vecObjects)
+		{
+			if (!pObjectData || pObjectData->eObjectType == OBJECT_TYPE_NONE)
 			{
-				continue; // Skip objects with no type
+				continue;
 			}
 
-			CMatrix4Df worldMatrix{};
+			const CMatrix4Df worldMatrix = pObjectData->pPhysicsObject ? pObjectData->pPhysicsObject->GetInterpolatedMatrix(fPhysicsAlpha) : pObjectData->WorldTranslation.GetMatrix();
 
-			if (objectData->pPhysicsObject)
+			if (uiInstance == group.vecInstanceMatrices.size())
 			{
-				worldMatrix = objectData->pPhysicsObject->GetWorldTranslation().GetMatrix();
+				group.vecInstanceMatrices.push_back(worldMatrix);
+				group.vecInstanceBoxes.push_back(GetInstanceBox(group.pMesh, worldMatrix));
+				group.vecInstanceObjects.push_back(pObjectData);
+				bLayoutChanged = true;
+			}
+			else if (std::memcmp(&group.vecInstanceMatrices[uiInstance], &worldMatrix, sizeof(CMatrix4Df)) != 0)
+			{
+				group.vecInstanceMatrices[uiInstance] = worldMatrix;
+				group.vecInstanceBoxes[uiInstance] = GetInstanceBox(group.pMesh, worldMatrix);
+				group.vecInstanceObjects[uiInstance] = pObjectData;
+
+				if (!bLayoutChanged)
+				{
+					m_ObjectsBVH.SetItemBox(m_vGroupFirstItems[iGroup] + uiInstance, group.vecInstanceBoxes[uiInstance]);
+				}
 			}
 			else
 			{
-				SVector3Df objPos = objectData->WorldTranslation.GetPosition(); // e.g., (768, 0, 0) + (15, 0, 20) = (783, 0, 20)
-				SVector3Df objRot = objectData->WorldTranslation.GetRotation();
-				SVector3Df objScale = objectData->WorldTranslation.GetScale();
-
-				// 3. Build the world matrix using the FINAL world position
-				CMatrix4Df translation, rotation, scale;
-				translation.InitTranslationTransform(objPos);
-				rotation.InitRotateTransform(objRot);
-				scale.InitScaleTransform(objScale);
-				worldMatrix = translation * rotation * scale;
+				// Same matrix, but a removal before it may have shifted another object here
+				group.vecInstanceObjects[uiInstance] = pObjectData;
+				uiInstance++;
+				continue;
 			}
 
-			// Add the known-good matrices to the render list.
-			visibleWorldMatrices.push_back(worldMatrix);
-			visibleWvpMatrices.push_back(WVP * worldMatrix);
+			group.MarkInstanceDirty(uiInstance);
+			uiChanged++;
+			uiInstance++;
 		}
 
-		// IMPORTANT: Only render if there are any visible objects in this group
-		if (!visibleWorldMatrices.empty())
+		// Objects removed from the group, drop their trailing slots
+		if (uiInstance < group.vecInstanceMatrices.size())
 		{
-			group.pShader->Use();
-			//group.pMesh->Update(fDeltaTime);
-			// Pass the temporary vectors of VISIBLE objects to the render function
-			group.pMesh->Render(group.GetInstanceCount(), visibleWvpMatrices, visibleWorldMatrices);
+			group.vecInstanceMatrices.resize(uiInstance);
+			group.vecInstanceBoxes.resize(uiInstance);
+			group.vecInstanceObjects.resize(uiInstance);
+			group.uiDirtyEnd = std::min(group.uiDirtyEnd, uiInstance);
+			group.uiDirtyBegin = std::min(group.uiDirtyBegin, group.uiDirtyEnd);
+			bLayoutChanged = true;
+		}
+	}
 
-			for (auto& objectData : group.vecObjects)
-			{
-				if (objectData && objectData->pPhysicsObject)
-				{
-					CPhysicsWorld::Instance().Update(fDeltaTime);
+	if (bLayoutChanged)
+	{
+		BuildObjectsBVH();
+	}
+	else
+	{
+		m_ObjectsBVH.Refit();
+	}
 
-					// 3. Create a TEMPORARY world-space box for drawing this frame
-					SBoundingBox worldBox = objectData->pPhysicsObject->GetBoundingBoxWorld();
+	return (uiChanged);
+}
 
-					// 4. Draw the correctly transformed box
-					//AABB.Draw(worldBox.v3Min, worldBox.v3Max);
-					worldBox.Draw(objectData->pPhysicsObject->IsSelectedObject());
-				}
-			}
+// One item per instance slot, numbered group after group
+void CTerrainAreaData::BuildObjectsBVH()
+{
+	m_vGroupFirstItems.resize(m_vObjectsGroups.size());
+	m_vBVHInstances.clear();
+	m_vBVHBoxes.clear();
+
+	for (size_t iGroup = 0; iGroup < m_vObjectsGroups.size(); iGroup++)
+	{
+		const TObjectInstanceGroup& group = m_vObjectsGroups[iGroup];
+		m_vGroupFirstItems[iGroup] = static_cast<GLuint>(m_vBVHInstances.size());
+
+		for (GLuint uiInstance = 0; uiInstance < group.GetDrawCount(); uiInstance++)
+		{
+			m_vBVHInstances.push_back({ static_cast<GLuint>(iGroup), uiInstance });
+			m_vBVHBoxes.push_back(group.vecInstanceBoxes[uiInstance]);
 		}
 	}
+
+	m_ObjectsBVH.Build(m_vBVHBoxes.data(), static_cast<GLuint>(m_vBVHBoxes.size()));
+}
+
+/*
+ * CullInstances - Frustum and distance culling of the instances.
+ * @frustumCulling: Planes of the view.
+ * @v3Eye: Camera position, the mesh max draw distance is measured from it.
+ *
+ * Runs on the objects BVH kept by UpdateInstanceMatrices, so call it after
+ * that. The planes are tested against the tree, whole subtrees outside the
+ * view are skipped, then the distance of each instance left against the
+ * limit of its group. Only the visible indices of each group are drawn,
+ * in the order of the tree, the matrices stay where they are.
+ */
+GLuint CTerrainAreaData::CullInstances(const SFrustumCulling& frustumCulling, const SVector3Df& v3Eye)
+{
+	SVector4Df v4Planes[FRUSTUM_PLANES_NUM];
+	frustumCulling.GetPlanes(v4Planes);
+
+	m_vGroupMaxDistancesSq.resize(m_vObjectsGroups.size());
+	for (size_t iGroup = 0; iGroup < m_vObjectsGroups.size(); iGroup++)
+	{
+		TObjectInstanceGroup& rGroup = m_vObjectsGroups[iGroup];
+		m_vGroupMaxDistancesSq[iGroup] = SFrustumCulling::GetMaxDistanceSq(rGroup.pMesh ? rGroup.pMesh->GetMaxDrawDistance() : 0.0f);
+
+		rGroup.vecVisibleInstances.resize(rGroup.vecInstanceBoxes.size());
+		rGroup.uiVisibleCount = 0;
+	}
+
+	m_vVisibleItems.resize(m_ObjectsBVH.GetItemsCount());
+	const GLuint uiVisibleItems = m_ObjectsBVH.CullFrustum(v4Planes, m_vVisibleItems.data());
+
+	GLuint uiVisibleTotal = 0;
+	for (GLuint i = 0; i < uiVisibleItems; i++)
+	{
+		const TAreaInstanceRef& rRef = m_vBVHInstances[m_vVisibleItems[i]];
+		TObjectInstanceGroup& rGroup = m_vObjectsGroups[rRef.uiGroup];
+
+		if (SFrustumCulling::GetCullBoxDistanceSq(rGroup.vecInstanceBoxes[rRef.uiInstance], v3Eye) <= m_vGroupMaxDistancesSq[rRef.uiGroup])
+		{
+			rGroup.vecVisibleInstances[rGroup.uiVisibleCount++] = rRef.uiInstance;
+			uiVisibleTotal++;
+		}
+	}
+
+	return (uiVisibleTotal);
+}
+
+/*
+ * PickObject - Closest collidable object under the ray.
+ * @ray: World ray, hits past its range are ignored.
+ * @pfDistance: Receives the distance along the ray, FLT_MAX when nothing is hit.
+ *
+ * Walks the objects BVH, so the boxes are the drawn ones as of the last
+ * UpdateInstanceMatrices. Objects without a mesh or a physics object, or
+ * not collidable, cannot be picked.
+ */
+CPhysicsObject* CTerrainAreaData::PickObject(const CRay& ray, GLfloat* pfDistance) const
+{
+	const auto fnAccept = [this](GLuint uiItem)
+	{
+		const TAreaInstanceRef& rRef = m_vBVHInstances[uiItem];
+		const TObjectInstanceGroup& rGroup = m_vObjectsGroups[rRef.uiGroup];
+		const SObjectData* pObjectData = rGroup.vecInstanceObjects[rRef.uiInstance];
+
+		return (rGroup.pMesh && pObjectData->pPhysicsObject && pObjectData->pPhysicsObject->IsCollidable());
+	};
+
+	const GLint iItem = m_ObjectsBVH.Raycast(ray, pfDistance, fnAccept);
+	if (iItem < 0)
+	{
+		return (nullptr);
+	}
+
+	const TAreaInstanceRef& rRef = m_vBVHInstances[iItem];
+	return (m_vObjectsGroups[rRef.uiGroup].vecInstanceObjects[rRef.uiInstance]->pPhysicsObject);
+}
+
+/*
+ * UploadInstanceMatrices - Sends the dirty range of a group to the GPU.
+ * @rGroup: Group whose instance buffer is brought up to date.
+ * @pRingBuffer: Staging ring of the frame, may be nullptr.
+ *
+ * The range is written into the persistently mapped ring and copied on
+ * the GPU into the instance buffer, so the draw does not wait on a CPU
+ * write. glNamedBufferSubData is the fallback when the ring is missing or
+ * full for this frame. The instance buffer grows by recreating it, which
+ * uploads everything once.
+ */
+void CTerrainAreaData::UploadInstanceMatrices(TObjectInstanceGroup& rGroup, CRingBuffer* pRingBuffer)
+{
+	const GLuint uiCount = rGroup.GetDrawCount();
+
+	if (uiCount > rGroup.uiInstanceCapacity)
+	{
+		if (rGroup.uiInstanceBuffer)
+		{
+			glDeleteBuffers(1, &rGroup.uiInstanceBuffer);
+			rGroup.uiInstanceBuffer = 0;
+		}
+
+		if (rGroup.uiVisibleBuffer)
+		{
+			glDeleteBuffers(1, &rGroup.uiVisibleBuffer);
+			rGroup.uiVisibleBuffer = 0;
+		}
+
+		rGroup.uiInstanceCapacity = std::max(std::max(uiCount, rGroup.uiInstanceCapacity * 2), OBJECT_INSTANCE_MIN_CAPACITY);
+
+		glCreateBuffers(1, &rGroup.uiInstanceBuffer);
+		glNamedBufferStorage(rGroup.uiInstanceBuffer, sizeof(CMatrix4Df) * rGroup.uiInstanceCapacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		rGroup.uiDirtyBegin = 0;
+		rGroup.uiDirtyEnd = uiCount;
+	}
+
+	if (!rGroup.IsInstanceDataDirty())
+	{
+		return;
+	}
+
+	const GLintptr lDstOffset = sizeof(CMatrix4Df) * rGroup.uiDirtyBegin;
+	const GLsizeiptr lSize = sizeof(CMatrix4Df) * (rGroup.uiDirtyEnd - rGroup.uiDirtyBegin);
+	const CMatrix4Df* pSource = &rGroup.vecInstanceMatrices[rGroup.uiDirtyBegin];
+
+	void* pStaging = nullptr;
+	const GLintptr lSrcOffset = pRingBuffer ? pRingBuffer->Allocate(lSize, sizeof(SVector4Df), &pStaging) : -1;
+
+	if (lSrcOffset >= 0)
+	{
+		std::memcpy(pStaging, pSource, lSize);
+		glCopyNamedBufferSubData(pRingBuffer->GetBuffer(), rGroup.uiInstanceBuffer, lSrcOffset, lDstOffset, lSize);
+	}
+	else
+	{
+		glNamedBufferSubData(rGroup.uiInstanceBuffer, lDstOffset, lSize, pSource);
+	}
+
+	rGroup.uiDirtyBegin = rGroup.uiDirtyEnd = 0;
+}
+
+/*
+ * UploadVisibleInstances - Sends the visible indices of the frame.
+ * @rGroup: Group culled this frame.
+ * @pRingBuffer: Staging ring of the frame, may be nullptr.
+ * @puiIndexBuffer: Receives the buffer holding the indices.
+ *
+ * The indices change with the camera, so they live in the ring buffer and
+ * are read from there by the draw. The group's own index buffer is the
+ * fallback when the ring is missing or full. Returns the byte offset of
+ * the first index.
+ */
+GLintptr CTerrainAreaData::UploadVisibleInstances(TObjectInstanceGroup& rGroup, CRingBuffer* pRingBuffer, GLuint* puiIndexBuffer)
+{
+	const GLsizeiptr lSize = sizeof(GLuint) * rGroup.uiVisibleCount;
+
+	void* pStaging = nullptr;
+	const GLintptr lOffset = pRingBuffer ? pRingBuffer->Allocate(lSize, sizeof(GLuint), &pStaging) : -1;
+
+	if (lOffset >= 0)
+	{
+		std::memcpy(pStaging, rGroup.vecVisibleInstances.data(), lSize);
+		*puiIndexBuffer = pRingBuffer->GetBuffer();
+		return (lOffset);
+	}
+
+	if (!rGroup.uiVisibleBuffer)
+	{
+		glCreateBuffers(1, &rGroup.uiVisibleBuffer);
+		glNamedBufferStorage(rGroup.uiVisibleBuffer, sizeof(GLuint) * rGroup.uiInstanceCapacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	glNamedBufferSubData(rGroup.uiVisibleBuffer, 0, lSize, rGroup.vecVisibleInstances.data());
+
+	*puiIndexBuffer = rGroup.uiVisibleBuffer;
+	return (0);
+}
+
+/*
+ * GetInstanceBox - World box of an instance.
+ * @pMesh: Mesh of the group, its local box is moved by matWorld.
+ * @matWorld: World matrix of the instance.
+ *
+ * A missing mesh or a box never computed gives an unbounded box, such
+ * instances are always drawn.
+ */
+TCullBox CTerrainAreaData::GetInstanceBox(CMesh* pMesh, const CMatrix4Df& matWorld)
+{
+	if (!pMesh || pMesh->GetBoundingBox().v3Min.x > pMesh->GetBoundingBox().v3Max.x)
+	{
+		return (TCullBox(SVector3Df(-FLT_MAX, -FLT_MAX, -FLT_MAX), SVector3Df(FLT_MAX, FLT_MAX, FLT_MAX)));
+	}
+
+	const TBoundingBox& rLocalBox = pMesh->GetBoundingBox();
+	return (TCullBox::Transform(rLocalBox.v3Min, rLocalBox.v3Max, matWorld));
 }
 
 bool CTerrainAreaData::LoadAreaObjectsFromFile(const std::string& stAreaObjectsData)
@@ -454,7 +730,7 @@ CTerrainAreaData* CTerrainAreaData::New()
 
 void CTerrainAreaData::Delete(CTerrainAreaData* pkArea)
 {
-	pkArea->Clear();
+	pkArea->Destroy();
 	ms_AreaPool.Free(pkArea);
 }
 
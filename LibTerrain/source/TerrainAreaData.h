@@ -2,8 +2,10 @@
 
 #include "../../LibMath/source/vectors.h"
 #include "../../LibMath/source/world_translation.h"
+#include "../../LibMath/source/frustum.h"
 #include "../../LibGL/source/shader.h"
 #include "../../LibGame/source/mesh.h"
+#include "../../LibGame/source/BoundingVolumeHierarchy.h"
 #include "TerrainMap.h"
 
 typedef struct SObjectData
@@ -40,16 +42,66 @@ struct SObjectDataCompare
 	}
 };
 
+constexpr GLuint OBJECT_INSTANCE_MIN_CAPACITY = 64;	// Matrices of the first instance buffer of a group
+
 typedef struct SObjectInstanceGroup
 {
 	CShader* pShader;						// Pointer to the shader used for rendering the object
 	CMesh* pMesh;							// Pointer to the mesh data of the object
 	std::vector<SObjectData*> vecObjects;	// Vector of object data instances
 
+	// Instance data kept between frames, only the changed range is uploaded again
+	std::vector<CMatrix4Df> vecInstanceMatrices;	// World matrix of every drawn object, in vecObjects order
+	std::vector<TCullBox> vecInstanceBoxes;			// World box of every matrix, rebuilt with it
+	std::vector<SObjectData*> vecInstanceObjects;	// Object drawn by every matrix, picking maps a hit back to it
+	GLuint uiDirtyBegin;							// First matrix not uploaded yet
+	GLuint uiDirtyEnd;								// One past the last one, equal to uiDirtyBegin when up to date
+	GLuint uiInstanceBuffer;						// GPU copy of vecInstanceMatrices, released by CTerrainAreaData::Destroy
+	GLuint uiInstanceCapacity;						// Matrices uiInstanceBuffer can hold
+
+	// Culling result of the frame, indices into vecInstanceMatrices
+	std::vector<GLuint> vecVisibleInstances;
+	GLuint uiVisibleCount;
+	GLuint uiVisibleBuffer;							// Index buffer used when the ring buffer is full, uiInstanceCapacity indices
+
+	SObjectInstanceGroup()
+	{
+		pShader = nullptr;
+		pMesh = nullptr;
+		uiDirtyBegin = uiDirtyEnd = 0;
+		uiInstanceBuffer = 0;
+		uiInstanceCapacity = 0;
+		uiVisibleCount = 0;
+		uiVisibleBuffer = 0;
+	}
+
 	GLuint GetInstanceCount() const { return static_cast<GLuint>(vecObjects.size()); }
+	GLuint GetDrawCount() const { return static_cast<GLuint>(vecInstanceMatrices.size()); }
+	GLuint GetVisibleCount() const { return (uiVisibleCount); }
+	bool IsInstanceDataDirty() const { return (uiDirtyEnd > uiDirtyBegin); }
+
+	void MarkInstanceDirty(GLuint uiInstance)
+	{
+		if (!IsInstanceDataDirty())
+		{
+			uiDirtyBegin = uiInstance;
+			uiDirtyEnd = uiInstance + 1;
+			return;
+		}
+
+		uiDirtyBegin = std::min(uiDirtyBegin, uiInstance);
+		uiDirtyEnd = std::max(uiDirtyEnd, uiInstance + 1);
+	}
 
 } TObjectInstanceGroup;
 
+// Instance slot of a CTerrainAreaData::m_ObjectsBVH item
+typedef struct SAreaInstanceRef
+{
+	GLuint uiGroup;
+	GLuint uiInstance;
+} TAreaInstanceRef;
+
 class CTerrainAreaData
 {
 public:
@@ -69,6 +121,13 @@ public:
 
 	void RenderAreaObjects(GLfloat fDeltaTime);
 
+	// Refreshes the instance matrices, CPU side only, returns how many changed since the last call
+	GLuint UpdateInstanceMatrices(GLfloat fPhysicsAlpha);
+	// Fills the visible instances of every group, CPU side only, returns the visible total
+	GLuint CullInstances(const SFrustumCulling& frustumCulling, const SVector3Df& v3Eye);
+	// Closest collidable object whose instance box the ray hits, as of the last UpdateInstanceMatrices
+	CPhysicsObject* PickObject(const CRay& ray, GLfloat* pfDistance) const;
+
 	bool LoadAreaObjectsFromFile(const std::string& stAreaObjectsData);
 	bool SaveAreaObjectsFromFile(const std::string& stMapName);
 
@@ -80,7 +139,22 @@ public:
 	SVector3Df GetWorldOrigin() const;
 
 protected:
+	void UploadInstanceMatrices(TObjectInstanceGroup& rGroup, CRingBuffer* pRingBuffer);
+	GLintptr UploadVisibleInstances(TObjectInstanceGroup& rGroup, CRingBuffer* pRingBuffer, GLuint* puiIndexBuffer);
+
+	void BuildObjectsBVH();
+
+	static TCullBox GetInstanceBox(CMesh* pMesh, const CMatrix4Df& matWorld);
+
 	std::vector<TObjectInstanceGroup> m_vObjectsGroups;		// Vector of object instance groups
+
+	// Instance boxes of every group in one tree, item i is m_vBVHInstances[i]
+	CBoundingVolumeHierarchy m_ObjectsBVH;
+	std::vector<TAreaInstanceRef> m_vBVHInstances;
+	std::vector<GLuint> m_vGroupFirstItems;					// Item of the first instance of each group
+	std::vector<TCullBox> m_vBVHBoxes;						// Scratch of BuildObjectsBVH
+	std::vector<GLuint> m_vVisibleItems;					// Scratch of CullInstances
+	std::vector<GLfloat> m_vGroupMaxDistancesSq;			// Scratch of CullInstances
 	CTerrainMap* m_pOwnerTerrainMap;						// Pointer to the terrain map associated with this area
 
 	// The area num among terrains (0,0) - (1, 0) - (1, 1);
@@ -0,0 +1,288 @@
+#include "Stdafx.h"
+#include "TerrainChunk.h"
+
+CTerrainChunk::CTerrainChunk()
+{
+	Clear();
+}
+
+void CTerrainChunk::Clear()
+{
+	m_iTerrainCoordX = m_iTerrainCoordZ = 0;
+
+	for (GLint i = 0; i < TERRAIN_CHUNK_SECTION_MAX_NUM; i++)
+	{
+		m_bHasSection[i] = false;
+		m_vSectionData[i].clear();
+	}
+}
+
+void CTerrainChunk::SetSection(ETerrainChunkSection eType, const void* pData, size_t uiSize)
+{
+	if (eType < 0 || eType >= TERRAIN_CHUNK_SECTION_MAX_NUM)
+	{
+		sys_err("CTerrainChunk::SetSection: Invalid section type %d", eType);
+		return;
+	}
+
+	const GLubyte* pBytes = static_cast<const GLubyte*>(pData);
+	m_vSectionData[eType].assign(pBytes, pBytes + uiSize);
+	m_bHasSection[eType] = true;
+}
+
+bool CTerrainChunk::HasSection(ETerrainChunkSection eType) const
+{
+	if (eType < 0 || eType >= TERRAIN_CHUNK_SECTION_MAX_NUM)
+	{
+		return (false);
+	}
+
+	return (m_bHasSection[eType]);
+}
+
+const std::vector<GLubyte>& CTerrainChunk::GetSection(ETerrainChunkSection eType) const
+{
+	return (m_vSectionData[eType]);
+}
+
+void CTerrainChunk::SetTerrainCoords(GLint iTerrainCoordX, GLint iTerrainCoordZ)
+{
+	m_iTerrainCoordX = iTerrainCoordX;
+	m_iTerrainCoordZ = iTerrainCoordZ;
+}
+
+void CTerrainChunk::GetTerrainCoords(GLint* piTerrainCoordX, GLint* piTerrainCoordZ) const
+{
+	*piTerrainCoordX = m_iTerrainCoordX;
+	*piTerrainCoordZ = m_iTerrainCoordZ;
+}
+
+/*
+ * Save - Writes the header, the section table and the payloads.
+ * @stFileName: Destination file, overwritten.
+ *
+ * Every section is compressed up front so the table can be written with its
+ * final sizes; sections that do not shrink are stored as is.
+ */
+bool CTerrainChunk::Save(const std::string& stFileName) const
+{
+	std::vector<TTerrainChunkSection> vTable;
+	std::vector<std::vector<GLubyte>> vPayloads;
+
+	for (GLint i = 0; i < TERRAIN_CHUNK_SECTION_MAX_NUM; i++)
+	{
+		if (!m_bHasSection[i])
+		{
+			continue;
+		}
+
+		const std::vector<GLubyte>& rData = m_vSectionData[i];
+
+		TTerrainChunkSection section{};
+		section.uiType = static_cast<GLuint>(i);
+		section.uiRawSize = static_cast<GLuint>(rData.size());
+		section.uiChecksum = static_cast<GLuint>(crc32(0L, rData.data(), static_cast<uInt>(rData.size())));
+
+		std::vector<GLubyte> vCompressed(compressBound(static_cast<uLong>(rData.size())));
+		uLongf ulCompressedSize = static_cast<uLongf>(vCompressed.size());
+
+		if (!rData.empty() &&
+			compress2(vCompressed.data(), &ulCompressedSize, rData.data(), static_cast<uLong>(rData.size()), TERRAIN_CHUNK_COMPRESSION_LEVEL) == Z_OK &&
+			ulCompressedSize < rData.size())
+		{
+			vCompressed.resize(ulCompressedSize);
+			section.uiCompression = TERRAIN_CHUNK_COMPRESSION_ZLIB;
+			vPayloads.push_back(std::move(vCompressed));
+		}
+		else
+		{
+			section.uiCompression = TERRAIN_CHUNK_COMPRESSION_NONE;
+			vPayloads.push_back(rData);
+		}
+
+		section.uiStoredSize = static_cast<GLuint>(vPayloads.back().size());
+		vTable.push_back(section);
+	}
+
+	TTerrainChunkHeader header{};
+	header.uiMagic = TERRAIN_CHUNK_MAGIC;
+	header.uiVersion = TERRAIN_CHUNK_VERSION;
+	header.iTerrainCoordX = m_iTerrainCoordX;
+	header.iTerrainCoordZ = m_iTerrainCoordZ;
+	header.uiSectionCount = static_cast<GLuint>(vTable.size());
+
+	FILE* fp = nullptr;
+	errno_t err = fopen_s(&fp, stFileName.c_str(), "wb");
+
+	if (!fp || err != 0)
+	{
+		sys_err("CTerrainChunk::Save: Failed to open chunk file: %s, err: %d", stFileName.c_str(), err);
+		return (false);
+	}
+
+	bool bWritten = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (bWritten && !vTable.empty())
+	{
+		bWritten = fwrite(vTable.data(), sizeof(TTerrainChunkSection), vTable.size(), fp) == vTable.size();
+	}
+
+	for (size_t i = 0; bWritten && i < vPayloads.size(); i++)
+	{
+		bWritten = vPayloads[i].empty() || fwrite(vPayloads[i].data(), 1, vPayloads[i].size(), fp) == vPayloads[i].size();
+	}
+
+	fclose(fp);
+
+	if (!bWritten)
+	{
+		sys_err("CTerrainChunk::Save: Failed to write chunk file: %s", stFileName.c_str());
+		return (false);
+	}
+
+	return (true);
+}
+
+bool CTerrainChunk::Load(const std::string& stFileName)
+{
+	Clear();
+
+	FILE* fp = nullptr;
+	errno_t err = fopen_s(&fp, stFileName.c_str(), "rb");
+
+	if (!fp || err != 0)
+	{
+		sys_err("CTerrainChunk::Load: Failed to open chunk file: %s", stFileName.c_str());
+		return (false);
+	}
+
+	TTerrainChunkHeader header{};
+	if (fread(&header, sizeof(header), 1, fp) != 1)
+	{
+		sys_err("CTerrainChunk::Load: %s is too small for a chunk header", stFileName.c_str());
+		fclose(fp);
+		return (false);
+	}
+
+	if (header.uiMagic != TERRAIN_CHUNK_MAGIC)
+	{
+		sys_err("CTerrainChunk::Load: %s is not a terrain chunk (magic 0x%08X)", stFileName.c_str(), header.uiMagic);
+		fclose(fp);
+		return (false);
+	}
+
+	if (header.uiVersion != TERRAIN_CHUNK_VERSION)
+	{
+		sys_err("CTerrainChunk::Load: %s has unsupported version %u (expected %u)", stFileName.c_str(), header.uiVersion, TERRAIN_CHUNK_VERSION);
+		fclose(fp);
+		return (false);
+	}
+
+	if (header.uiSectionCount > TERRAIN_CHUNK_SECTION_MAX_NUM)
+	{
+		sys_err("CTerrainChunk::Load: %s has too many sections (%u)", stFileName.c_str(), header.uiSectionCount);
+		fclose(fp);
+		return (false);
+	}
+
+	std::vector<TTerrainChunkSection> vTable(header.uiSectionCount);
+	if (!vTable.empty() && fread(vTable.data(), sizeof(TTerrainChunkSection), vTable.size(), fp) != vTable.size())
+	{
+		sys_err("CTerrainChunk::Load: %s section table is truncated", stFileName.c_str());
+		fclose(fp);
+		return (false);
+	}
+
+	// Payload bytes left after the table, no section may claim more
+	const long lPayloadStart = ftell(fp);
+	fseek(fp, 0, SEEK_END);
+	const long lFileSize = ftell(fp);
+	fseek(fp, lPayloadStart, SEEK_SET);
+
+	if (lPayloadStart < 0 || lFileSize < lPayloadStart)
+	{
+		sys_err("CTerrainChunk::Load: Failed to get the size of %s", stFileName.c_str());
+		fclose(fp);
+		return (false);
+	}
+
+	size_t uiPayloadLeft = static_cast<size_t>(lFileSize - lPayloadStart);
+
+	std::vector<GLubyte> vStored;
+	for (const TTerrainChunkSection& rSection : vTable)
+	{
+		if (rSection.uiType >= TERRAIN_CHUNK_SECTION_MAX_NUM || m_bHasSection[rSection.uiType])
+		{
+			sys_err("CTerrainChunk::Load: %s has an invalid or duplicated section %u", stFileName.c_str(), rSection.uiType);
+			fclose(fp);
+			return (false);
+		}
+
+		// Sizes come from the file, bound them before allocating anything
+		if (rSection.uiRawSize > TERRAIN_CHUNK_MAX_SECTION_SIZE || rSection.uiStoredSize > uiPayloadLeft ||
+			rSection.uiStoredSize > compressBound(static_cast<uLong>(rSection.uiRawSize)))
+		{
+			sys_err("CTerrainChunk::Load: %s section %u has invalid sizes (raw %u, stored %u, %zu bytes left)",
+				stFileName.c_str(), rSection.uiType, rSection.uiRawSize, rSection.uiStoredSize, uiPayloadLeft);
+			fclose(fp);
+			return (false);
+		}
+
+		uiPayloadLeft -= rSection.uiStoredSize;
+
+		vStored.resize(rSection.uiStoredSize);
+		if (!vStored.empty() && fread(vStored.data(), 1, vStored.size(), fp) != vStored.size())
+		{
+			sys_err("CTerrainChunk::Load: %s section %u is truncated", stFileName.c_str(), rSection.uiType);
+			fclose(fp);
+			return (false);
+		}
+
+		std::vector<GLubyte>& rData = m_vSectionData[rSection.uiType];
+
+		if (rSection.uiCompression == TERRAIN_CHUNK_COMPRESSION_ZLIB)
+		{
+			rData.resize(rSection.uiRawSize);
+			uLongf ulRawSize = static_cast<uLongf>(rData.size());
+
+			if (uncompress(rData.data(), &ulRawSize, vStored.data(), static_cast<uLong>(vStored.size())) != Z_OK || ulRawSize != rSection.uiRawSize)
+			{
+				sys_err("CTerrainChunk::Load: %s section %u failed to decompress", stFileName.c_str(), rSection.uiType);
+				fclose(fp);
+				return (false);
+			}
+		}
+		else if (rSection.uiCompression == TERRAIN_CHUNK_COMPRESSION_NONE && rSection.uiStoredSize == rSection.uiRawSize)
+		{
+			rData.swap(vStored);
+		}
+		else
+		{
+			sys_err("CTerrainChunk::Load: %s section %u has unknown compression %u", stFileName.c_str(), rSection.uiType, rSection.uiCompression);
+			fclose(fp);
+			return (false);
+		}
+
+		const GLuint uiChecksum = static_cast<GLuint>(crc32(0L, rData.data(), static_cast<uInt>(rData.size())));
+		if (uiChecksum != rSection.uiChecksum)
+		{
+			sys_err("CTerrainChunk::Load: %s section %u checksum mismatch (0x%08X, expected 0x%08X)", stFileName.c_str(), rSection.uiType, uiChecksum, rSection.uiChecksum);
+			fclose(fp);
+			return (false);
+		}
+
+		m_bHasSection[rSection.uiType] = true;
+	}
+
+	fclose(fp);
+
+	m_iTerrainCoordX = header.iTerrainCoordX;
+	m_iTerrainCoordZ = header.iTerrainCoordZ;
+	return (true);
+}
+
+std::string CTerrainChunk::GetFileName(const std::string& stMapName, GLint iTerrainCoordX, GLint iTerrainCoordZ)
+{
+	char szFileName[256] = {};
+	sprintf_s(szFileName, "%s\\%06d\\terrain.chunk", stMapName.c_str(), iTerrainCoordX * 1000 + iTerrainCoordZ);
+	return (szFileName);
+}
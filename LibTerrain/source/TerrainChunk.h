@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// "TCHK", little endian
+constexpr GLuint TERRAIN_CHUNK_MAGIC = 0x4B484354;
+constexpr GLuint TERRAIN_CHUNK_VERSION = 1;
+constexpr GLint TERRAIN_CHUNK_COMPRESSION_LEVEL = 6;
+constexpr GLuint TERRAIN_CHUNK_MAX_SECTION_SIZE = 16 * 1024 * 1024;	// Bytes, far above the largest section (splat maps, 256 KB)
+
+enum ETerrainChunkSection
+{
+	TERRAIN_CHUNK_SECTION_NAME,				// Terrain name, no terminator
+	TERRAIN_CHUNK_SECTION_HEIGHT,			// HEIGHTMAP_RAW_XSIZE * HEIGHTMAP_RAW_ZSIZE floats
+	TERRAIN_CHUNK_SECTION_ATTR,				// ATTRMAP_XSIZE * ATTRMAP_ZSIZE bytes
+	TERRAIN_CHUNK_SECTION_SPLAT_WEIGHT,		// TILEMAP_RAW texels, 4 weights quantized to 0-255
+	TERRAIN_CHUNK_SECTION_SPLAT_INDEX,		// TILEMAP_RAW texels, 4 texture indices on a byte each
+	TERRAIN_CHUNK_SECTION_WATER_MAP,		// WATERMAP_XSIZE * WATERMAP_ZSIZE bytes
+	TERRAIN_CHUNK_SECTION_WATER_HEIGHT,		// One float per water
+	TERRAIN_CHUNK_SECTION_MAX_NUM,
+};
+
+enum ETerrainChunkCompression
+{
+	TERRAIN_CHUNK_COMPRESSION_NONE,
+	TERRAIN_CHUNK_COMPRESSION_ZLIB,
+};
+
+#pragma pack(push)
+#pragma pack(1)
+typedef struct STerrainChunkHeader
+{
+	GLuint uiMagic;
+	GLuint uiVersion;
+	GLint iTerrainCoordX;
+	GLint iTerrainCoordZ;
+	GLuint uiSectionCount;
+} TTerrainChunkHeader;
+
+// Section table entry, payloads follow the table in the same order
+typedef struct STerrainChunkSection
+{
+	GLuint uiType;			// ETerrainChunkSection
+	GLuint uiCompression;	// ETerrainChunkCompression
+	GLuint uiRawSize;		// Decompressed size
+	GLuint uiStoredSize;	// Size in the file
+	GLuint uiChecksum;		// crc32 of the decompressed data
+} TTerrainChunkSection;
+#pragma pack(pop)
+
+/**
+ * CTerrainChunk - Versioned binary container holding all the files of a terrain.
+ *
+ * One "terrain.chunk" per terrain directory replaces TerrainData.json and
+ * the raw maps. A section is zlib compressed when that makes it smaller and
+ * carries the crc32 of its decompressed bytes, checked by Load(). The chunk
+ * only moves bytes around, CTerrain::SaveChunk/LoadChunk own the encoding of
+ * each section.
+ */
+class CTerrainChunk
+{
+public:
+	CTerrainChunk();
+
+	void Clear();
+
+	// Replaces the section if it is already in the chunk
+	void SetSection(ETerrainChunkSection eType, const void* pData, size_t uiSize);
+	bool HasSection(ETerrainChunkSection eType) const;
+	const std::vector<GLubyte>& GetSection(ETerrainChunkSection eType) const;
+
+	void SetTerrainCoords(GLint iTerrainCoordX, GLint iTerrainCoordZ);
+	void GetTerrainCoords(GLint* piTerrainCoordX, GLint* piTerrainCoordZ) const;
+
+	bool Save(const std::string& stFileName) const;
+	bool Load(const std::string& stFileName);
+
+	static std::string GetFileName(const std::string& stMapName, GLint iTerrainCoordX, GLint iTerrainCoordZ);
+
+protected:
+	GLint m_iTerrainCoordX;
+	GLint m_iTerrainCoordZ;
+
+	bool m_bHasSection[TERRAIN_CHUNK_SECTION_MAX_NUM];
+	std::vector<GLubyte> m_vSectionData[TERRAIN_CHUNK_SECTION_MAX_NUM];	// Decompressed
+};
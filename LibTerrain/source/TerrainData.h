@@ -109,6 +109,16 @@ typedef struct STerrainWaterVertex
 } TTerrainWaterVertex;
 #pragma pack(pop)
 
+// Layout expected by glMultiDrawElementsIndirect
+typedef struct SDrawElementsIndirectCommand
+{
+	GLuint uiCount;				// Indices per draw
+	GLuint uiInstanceCount;
+	GLuint uiFirstIndex;		// Offset in the index buffer
+	GLint iBaseVertex;			// Added to every index (first vertex of the patch)
+	GLuint uiBaseInstance;
+} TDrawElementsIndirectCommand;
+
 enum ETerrainPatchData
 {
 	PATCH_TYPE_PLAIN,
@@ -116,6 +126,7 @@ enum ETerrainPatchData
 	PATCH_TYPE_CLIFF,
 
 	PATCH_VERTEX_COUNT = (PATCH_XSIZE + 1) * (PATCH_ZSIZE + 1),
+	PATCH_INDEX_COUNT = PATCH_XSIZE * PATCH_ZSIZE * 6,
 };
 
 enum ETerrainBrushShape
@@ -0,0 +1,673 @@
+#include "Stdafx.h"
+#include "TerrainHistory.h"
+#include "TerrainMap.h"
+
+CTerrainHistory::CTerrainHistory()
+{
+	m_lUsedBytes = 0;
+	m_lMaxBytes = TERRAIN_HISTORY_MAX_BYTES;
+	m_bInStroke = false;
+}
+
+void CTerrainHistory::Clear()
+{
+	m_dqUndo.clear();
+	m_dqRedo.clear();
+	m_lUsedBytes = 0;
+	m_vSnapshots.clear();
+	m_bInStroke = false;
+}
+
+/*
+ * BeginStroke - Copies the grids a brush is about to write.
+ * @pTerrainMap: Map holding the terrains.
+ * @uiGridMask: Grids written by the brush, bits of ETerrainHistoryGrid.
+ * @iTerrainCoordX: Terrain under the brush.
+ * @iTerrainCoordZ: Terrain under the brush.
+ * @iCellX: Brush center, in cells of that terrain.
+ * @iCellZ: Brush center, in cells of that terrain.
+ * @iBrushSize: Brush radius in cells.
+ *
+ * The brush square grown by TERRAIN_HISTORY_MARGIN is copied from the
+ * terrain and from every loaded neighbour it overlaps, in the local cells
+ * of each one. The neighbours are the slots the map brushes address, which
+ * wrap to the other side of the map at its borders, and the terrains
+ * around each of them that PutTerrainHeightMap finds by coordinates. Only
+ * a stroke whose grids changed is kept by EndStroke().
+ */
+void CTerrainHistory::BeginStroke(CTerrainMap* pTerrainMap, GLuint uiGridMask, GLint iTerrainCoordX, GLint iTerrainCoordZ, GLint iCellX, GLint iCellZ, GLint iBrushSize)
+{
+	if (m_bInStroke)
+	{
+		sys_err("CTerrainHistory::BeginStroke: Previous stroke was not ended, dropping it");
+	}
+
+	m_vSnapshots.clear();
+	m_bInStroke = true;
+
+	GLint iTerrainNum;
+	if (!pTerrainMap->GetTerrainNumByCoord(iTerrainCoordX, iTerrainCoordZ, &iTerrainNum))
+	{
+		return;
+	}
+
+	const GLint iReach = iBrushSize + TERRAIN_HISTORY_MARGIN;
+	std::vector<std::pair<CTerrain*, TDirtyRect>> vTerrains;
+
+	// Slots reached by the map brush, with the cells it passes to each one
+	for (GLint iOffsetZ = -1; iOffsetZ <= 1; iOffsetZ++)
+	{
+		for (GLint iOffsetX = -1; iOffsetX <= 1; iOffsetX++)
+		{
+			CTerrain* pTerrain = nullptr;
+			if (pTerrainMap->GetTerrainPtr(iTerrainNum + iOffsetZ * TERRAIN_HISTORY_BRUSH_ROW_STRIDE + iOffsetX, &pTerrain))
+			{
+				AddStrokeTerrain(vTerrains, pTerrain, TDirtyRect(iCellX - iReach - iOffsetX * XSIZE, iCellZ - iReach - iOffsetZ * ZSIZE, iCellX + iReach - iOffsetX * XSIZE, iCellZ + iReach - iOffsetZ * ZSIZE));
+			}
+		}
+	}
+
+	// PutTerrainHeightMap of each of them writes the same global cells in its neighbours
+	const size_t lReachedNum = vTerrains.size();
+	for (size_t i = 0; i < lReachedNum; i++)
+	{
+		const TDirtyRect reachedRect = vTerrains[i].second;
+
+		GLint iReachedX, iReachedZ;
+		vTerrains[i].first->GetTerrainCoords(&iReachedX, &iReachedZ);
+
+		for (GLint iOffsetZ = -1; iOffsetZ <= 1; iOffsetZ++)
+		{
+			for (GLint iOffsetX = -1; iOffsetX <= 1; iOffsetX++)
+			{
+				GLint iNeighbourNum;
+				CTerrain* pTerrain = nullptr;
+				if (!pTerrainMap->GetTerrainNumByCoord(iReachedX + iOffsetX, iReachedZ + iOffsetZ, &iNeighbourNum) || !pTerrainMap->GetTerrainPtr(iNeighbourNum, &pTerrain))
+				{
+					continue;
+				}
+
+				AddStrokeTerrain(vTerrains, pTerrain, TDirtyRect(reachedRect.iMinX - iOffsetX * XSIZE, reachedRect.iMinZ - iOffsetZ * ZSIZE, reachedRect.iMaxX - iOffsetX * XSIZE, reachedRect.iMaxZ - iOffsetZ * ZSIZE));
+			}
+		}
+	}
+
+	for (const std::pair<CTerrain*, TDirtyRect>& rTerrain : vTerrains)
+	{
+		CTerrain* pTerrain = rTerrain.first;
+
+		for (GLint iGrid = 0; iGrid < TERRAIN_HISTORY_GRID_MAX_NUM; iGrid++)
+		{
+			if ((uiGridMask & (1u << iGrid)) == 0)
+			{
+				continue;
+			}
+
+			GLubyte* pBase = nullptr;
+			GLint iWidth, iDepth, iTexelSize;
+			if (!GetGridView(pTerrain, iGrid, &pBase, &iWidth, &iDepth, &iTexelSize))
+			{
+				continue;
+			}
+
+			TTerrainHistorySnapshot snapshot;
+			snapshot.pTerrain = pTerrain;
+			snapshot.iGrid = iGrid;
+			snapshot.rect = GetGridRect(iGrid, rTerrain.second);
+			snapshot.rect.Clip(iWidth, iDepth);
+			snapshot.ubNumWater = pTerrain->GetWaterData().m_ubNumWater;
+
+			const size_t lRowBytes = static_cast<size_t>(snapshot.rect.GetWidth()) * iTexelSize;
+			snapshot.vBytes.resize(lRowBytes * snapshot.rect.GetDepth());
+
+			for (GLint iZ = snapshot.rect.iMinZ; iZ <= snapshot.rect.iMaxZ; iZ++)
+			{
+				const GLubyte* pRow = pBase + (static_cast<size_t>(iZ) * iWidth + snapshot.rect.iMinX) * iTexelSize;
+				memcpy(snapshot.vBytes.data() + (iZ - snapshot.rect.iMinZ) * lRowBytes, pRow, lRowBytes);
+			}
+
+			m_vSnapshots.push_back(std::move(snapshot));
+		}
+	}
+}
+
+// One snapshot per terrain and grid, two overlapping xors of the same texels would cancel out
+void CTerrainHistory::AddStrokeTerrain(std::vector<std::pair<CTerrain*, TDirtyRect>>& vTerrains, CTerrain* pTerrain, const TDirtyRect& cellRect)
+{
+	TDirtyRect clippedRect = cellRect;
+	clippedRect.Clip(HEIGHTMAP_RAW_XSIZE, HEIGHTMAP_RAW_ZSIZE);
+	if (clippedRect.IsEmpty())
+	{
+		return;
+	}
+
+	for (std::pair<CTerrain*, TDirtyRect>& rTerrain : vTerrains)
+	{
+		if (rTerrain.first == pTerrain)
+		{
+			rTerrain.second.Add(clippedRect);
+			return;
+		}
+	}
+
+	vTerrains.emplace_back(pTerrain, clippedRect);
+}
+
+// Turns the copies of the stroke into one step, nothing is kept when no grid changed
+void CTerrainHistory::EndStroke()
+{
+	if (!m_bInStroke)
+	{
+		return;
+	}
+
+	TTerrainHistoryStep step;
+
+	for (const TTerrainHistorySnapshot& rSnapshot : m_vSnapshots)
+	{
+		TTerrainHistoryDelta delta;
+		if (PackDelta(rSnapshot, delta))
+		{
+			step.vDeltas.push_back(std::move(delta));
+		}
+	}
+
+	m_vSnapshots.clear();
+	m_bInStroke = false;
+
+	if (step.vDeltas.empty())
+	{
+		return;
+	}
+
+	step.lBytes = GetStepBytes(step);
+
+	// A new stroke ends the redo branch
+	for (const TTerrainHistoryStep& rRedoStep : m_dqRedo)
+	{
+		m_lUsedBytes -= rRedoStep.lBytes;
+	}
+	m_dqRedo.clear();
+
+	PushUndoStep(step);
+}
+
+bool CTerrainHistory::Undo(CTerrainMap* pTerrainMap)
+{
+	if (m_dqUndo.empty())
+	{
+		return (false);
+	}
+
+	if (!ApplyStep(pTerrainMap, m_dqUndo.back()))
+	{
+		return (false);
+	}
+
+	m_dqRedo.push_back(std::move(m_dqUndo.back()));
+	m_dqUndo.pop_back();
+	return (true);
+}
+
+bool CTerrainHistory::Redo(CTerrainMap* pTerrainMap)
+{
+	if (m_dqRedo.empty())
+	{
+		return (false);
+	}
+
+	if (!ApplyStep(pTerrainMap, m_dqRedo.back()))
+	{
+		return (false);
+	}
+
+	m_dqUndo.push_back(std::move(m_dqRedo.back()));
+	m_dqRedo.pop_back();
+	return (true);
+}
+
+bool CTerrainHistory::CanUndo() const
+{
+	return (!m_dqUndo.empty());
+}
+
+bool CTerrainHistory::CanRedo() const
+{
+	return (!m_dqRedo.empty());
+}
+
+GLint CTerrainHistory::GetUndoCount() const
+{
+	return (static_cast<GLint>(m_dqUndo.size()));
+}
+
+GLint CTerrainHistory::GetRedoCount() const
+{
+	return (static_cast<GLint>(m_dqRedo.size()));
+}
+
+/*
+ * ForgetTerrain - Drops the deltas of one terrain.
+ * @iTerrainCoordX: Terrain coordinates.
+ * @iTerrainCoordZ: Terrain coordinates.
+ *
+ * An unloaded terrain comes back from its files, which the deltas no
+ * longer match. The deltas of the other terrains stay, each terrain is
+ * undone on its own chain of deltas, and steps left empty are removed.
+ */
+void CTerrainHistory::ForgetTerrain(GLint iTerrainCoordX, GLint iTerrainCoordZ)
+{
+	for (std::deque<TTerrainHistoryStep>* pSteps : { &m_dqUndo, &m_dqRedo })
+	{
+		for (TTerrainHistoryStep& rStep : *pSteps)
+		{
+			rStep.vDeltas.erase(std::remove_if(rStep.vDeltas.begin(), rStep.vDeltas.end(), [=](const TTerrainHistoryDelta& rDelta)
+			{
+				return (rDelta.iTerrainCoordX == iTerrainCoordX && rDelta.iTerrainCoordZ == iTerrainCoordZ);
+			}), rStep.vDeltas.end());
+
+			m_lUsedBytes -= rStep.lBytes;
+			rStep.lBytes = GetStepBytes(rStep);
+			m_lUsedBytes += rStep.lBytes;
+		}
+
+		for (auto it = pSteps->begin(); it != pSteps->end();)
+		{
+			if (it->vDeltas.empty())
+			{
+				m_lUsedBytes -= it->lBytes;
+				it = pSteps->erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	m_vSnapshots.erase(std::remove_if(m_vSnapshots.begin(), m_vSnapshots.end(), [=](const TTerrainHistorySnapshot& rSnapshot)
+	{
+		GLint iCoordX, iCoordZ;
+		rSnapshot.pTerrain->GetTerrainCoords(&iCoordX, &iCoordZ);
+		return (iCoordX == iTerrainCoordX && iCoordZ == iTerrainCoordZ);
+	}), m_vSnapshots.end());
+}
+
+void CTerrainHistory::SetMaxBytes(size_t lMaxBytes)
+{
+	m_lMaxBytes = lMaxBytes;
+	TrimToMaxBytes();
+}
+
+size_t CTerrainHistory::GetMaxBytes() const
+{
+	return (m_lMaxBytes);
+}
+
+size_t CTerrainHistory::GetUsedBytes() const
+{
+	return (m_lUsedBytes);
+}
+
+void CTerrainHistory::PushUndoStep(TTerrainHistoryStep& rStep)
+{
+	m_lUsedBytes += rStep.lBytes;
+	m_dqUndo.push_back(std::move(rStep));
+	TrimToMaxBytes();
+}
+
+// The oldest steps go first, the redo steps are newer than every undo step
+void CTerrainHistory::TrimToMaxBytes()
+{
+	while (m_lUsedBytes > m_lMaxBytes && !m_dqUndo.empty())
+	{
+		m_lUsedBytes -= m_dqUndo.front().lBytes;
+		m_dqUndo.pop_front();
+	}
+
+	while (m_lUsedBytes > m_lMaxBytes && !m_dqRedo.empty())
+	{
+		m_lUsedBytes -= m_dqRedo.front().lBytes;
+		m_dqRedo.pop_front();
+	}
+}
+
+/*
+ * ApplyStep - Swaps the grids of a step between their two states.
+ * @pTerrainMap: Map holding the terrains.
+ * @rStep: Step to apply, the same call undoes and redoes it.
+ *
+ * Every terrain has to be loaded and every delta has to unpack before a
+ * grid is touched, a step is applied whole or not at all. The changed
+ * rects are then marked dirty and each terrain uploads only those.
+ */
+bool CTerrainHistory::ApplyStep(CTerrainMap* pTerrainMap, const TTerrainHistoryStep& rStep)
+{
+	std::vector<CTerrain*> vTerrains(rStep.vDeltas.size(), nullptr);
+	std::vector<std::vector<GLubyte>> vXors(rStep.vDeltas.size());
+
+	for (size_t i = 0; i < rStep.vDeltas.size(); i++)
+	{
+		const TTerrainHistoryDelta& rDelta = rStep.vDeltas[i];
+
+		GLint iTerrainNum;
+		if (!pTerrainMap->GetTerrainNumByCoord(rDelta.iTerrainCoordX, rDelta.iTerrainCoordZ, &iTerrainNum) || !pTerrainMap->GetTerrainPtr(iTerrainNum, &vTerrains[i]))
+		{
+			sys_err("CTerrainHistory::ApplyStep: Terrain (%d, %d) is not loaded", rDelta.iTerrainCoordX, rDelta.iTerrainCoordZ);
+			return (false);
+		}
+
+		if (!UnpackDelta(rDelta, vXors[i]))
+		{
+			sys_err("CTerrainHistory::ApplyStep: Delta of terrain (%d, %d) grid %d failed to unpack", rDelta.iTerrainCoordX, rDelta.iTerrainCoordZ, rDelta.iGrid);
+			return (false);
+		}
+	}
+
+	std::vector<CTerrain*> vTouchedTerrains;
+
+	for (size_t i = 0; i < rStep.vDeltas.size(); i++)
+	{
+		const TTerrainHistoryDelta& rDelta = rStep.vDeltas[i];
+		CTerrain* pTerrain = vTerrains[i];
+
+		GLubyte* pBase = nullptr;
+		GLint iWidth, iDepth, iTexelSize;
+		if (!GetGridView(pTerrain, rDelta.iGrid, &pBase, &iWidth, &iDepth, &iTexelSize))
+		{
+			continue;
+		}
+
+		const size_t lRowBytes = static_cast<size_t>(rDelta.rect.GetWidth()) * iTexelSize;
+		const GLubyte* pXor = vXors[i].data();
+
+		for (GLint iZ = rDelta.rect.iMinZ; iZ <= rDelta.rect.iMaxZ; iZ++)
+		{
+			GLubyte* pRow = pBase + (static_cast<size_t>(iZ) * iWidth + rDelta.rect.iMinX) * iTexelSize;
+			for (size_t lByte = 0; lByte < lRowBytes; lByte++)
+			{
+				pRow[lByte] ^= pXor[lByte];
+			}
+			pXor += lRowBytes;
+		}
+
+		if (rDelta.iGrid == TERRAIN_HISTORY_GRID_WATER_HEIGHT)
+		{
+			pTerrain->GetWaterData().m_ubNumWater ^= rDelta.ubNumWaterXor;
+		}
+
+		MarkGridRectDirty(pTerrain, rDelta.iGrid, rDelta.rect);
+
+		if (std::find(vTouchedTerrains.begin(), vTouchedTerrains.end(), pTerrain) == vTouchedTerrains.end())
+		{
+			vTouchedTerrains.push_back(pTerrain);
+		}
+	}
+
+	for (CTerrain* pTerrain : vTouchedTerrains)
+	{
+		pTerrain->UpdateDirtyData();
+	}
+
+	return (true);
+}
+
+bool CTerrainHistory::GetGridView(CTerrain* pTerrain, GLint iGrid, GLubyte** ppBase, GLint* piWidth, GLint* piDepth, GLint* piTexelSize)
+{
+	*ppBase = nullptr;
+
+	switch (iGrid)
+	{
+	case TERRAIN_HISTORY_GRID_HEIGHT:
+	{
+		CGrid<GLfloat>& rGrid = pTerrain->GetHeightMap();
+		if (rGrid.IsInitialized())
+		{
+			*ppBase = reinterpret_cast<GLubyte*>(rGrid.GetBaseAddr());
+		}
+		*piWidth = HEIGHTMAP_RAW_XSIZE;
+		*piDepth = HEIGHTMAP_RAW_ZSIZE;
+		*piTexelSize = sizeof(GLfloat);
+		break;
+	}
+
+	case TERRAIN_HISTORY_GRID_SPLAT_WEIGHT:
+	{
+		CGrid<SVector4Df>& rGrid = pTerrain->GetSplatData().weightGrid;
+		if (rGrid.IsInitialized())
+		{
+			*ppBase = reinterpret_cast<GLubyte*>(rGrid.GetBaseAddr());
+		}
+		*piWidth = TILEMAP_RAW_XSIZE;
+		*piDepth = TILEMAP_RAW_ZSIZE;
+		*piTexelSize = sizeof(SVector4Df);
+		break;
+	}
+
+	case TERRAIN_HISTORY_GRID_SPLAT_INDEX:
+	{
+		CGrid<SVector4Di>& rGrid = pTerrain->GetSplatData().indexGrid;
+		if (rGrid.IsInitialized())
+		{
+			*ppBase = reinterpret_cast<GLubyte*>(rGrid.GetBaseAddr());
+		}
+		*piWidth = TILEMAP_RAW_XSIZE;
+		*piDepth = TILEMAP_RAW_ZSIZE;
+		*piTexelSize = sizeof(SVector4Di);
+		break;
+	}
+
+	case TERRAIN_HISTORY_GRID_ATTR:
+	{
+		CGrid<GLubyte>& rGrid = pTerrain->GetAttrData().m_ubAttrMap;
+		if (rGrid.IsInitialized())
+		{
+			*ppBase = rGrid.GetBaseAddr();
+		}
+		*piWidth = ATTRMAP_XSIZE;
+		*piDepth = ATTRMAP_ZSIZE;
+		*piTexelSize = sizeof(GLubyte);
+		break;
+	}
+
+	case TERRAIN_HISTORY_GRID_WATER:
+	{
+		CGrid<GLubyte>& rGrid = pTerrain->GetWaterData().m_ubWaterMap;
+		if (rGrid.IsInitialized())
+		{
+			*ppBase = rGrid.GetBaseAddr();
+		}
+		*piWidth = WATERMAP_XSIZE;
+		*piDepth = WATERMAP_ZSIZE;
+		*piTexelSize = sizeof(GLubyte);
+		break;
+	}
+
+	case TERRAIN_HISTORY_GRID_WATER_HEIGHT:
+		*ppBase = reinterpret_cast<GLubyte*>(pTerrain->GetWaterData().m_fWaterHeight);
+		*piWidth = MAX_WATER_NUM + 1;
+		*piDepth = 1;
+		*piTexelSize = sizeof(GLfloat);
+		break;
+
+	default:
+		sys_err("CTerrainHistory::GetGridView: Unknown grid %d", iGrid);
+		return (false);
+	}
+
+	return (*ppBase != nullptr);
+}
+
+TDirtyRect CTerrainHistory::GetGridRect(GLint iGrid, const TDirtyRect& cellRect)
+{
+	switch (iGrid)
+	{
+	case TERRAIN_HISTORY_GRID_SPLAT_WEIGHT:
+	case TERRAIN_HISTORY_GRID_SPLAT_INDEX:
+		return (TDirtyRect(cellRect.iMinX * HEIGHT_TILE_XRATIO, cellRect.iMinZ * HEIGHT_TILE_ZRATIO, (cellRect.iMaxX + 1) * HEIGHT_TILE_XRATIO - 1, (cellRect.iMaxZ + 1) * HEIGHT_TILE_ZRATIO - 1));
+
+	case TERRAIN_HISTORY_GRID_ATTR:
+		return (TDirtyRect(cellRect.iMinX * (ATTRMAP_XSIZE / XSIZE), cellRect.iMinZ * (ATTRMAP_ZSIZE / ZSIZE), (cellRect.iMaxX + 1) * (ATTRMAP_XSIZE / XSIZE) - 1, (cellRect.iMaxZ + 1) * (ATTRMAP_ZSIZE / ZSIZE) - 1));
+
+	case TERRAIN_HISTORY_GRID_WATER:
+		return (TDirtyRect(cellRect.iMinX * HEIGHT_WATER_XRATIO, cellRect.iMinZ * HEIGHT_WATER_ZRATIO, (cellRect.iMaxX + 1) * HEIGHT_WATER_XRATIO - 1, (cellRect.iMaxZ + 1) * HEIGHT_WATER_ZRATIO - 1));
+
+	case TERRAIN_HISTORY_GRID_WATER_HEIGHT:
+		return (TDirtyRect(0, 0, MAX_WATER_NUM, 0));
+
+	default:
+		return (cellRect);
+	}
+}
+
+void CTerrainHistory::MarkGridRectDirty(CTerrain* pTerrain, GLint iGrid, const TDirtyRect& rect)
+{
+	switch (iGrid)
+	{
+	case TERRAIN_HISTORY_GRID_HEIGHT:
+		pTerrain->AddHeightDirtyRect(rect);
+		break;
+
+	case TERRAIN_HISTORY_GRID_SPLAT_WEIGHT:
+	case TERRAIN_HISTORY_GRID_SPLAT_INDEX:
+		pTerrain->AddSplatDirtyRect(rect);
+		break;
+
+	case TERRAIN_HISTORY_GRID_ATTR:
+		pTerrain->AddAttrDirtyRect(rect);
+		break;
+
+	case TERRAIN_HISTORY_GRID_WATER:
+		pTerrain->AddWaterDirtyRect(rect);
+		break;
+
+	default:
+		// Water heights are read through the water map, which comes with them
+		break;
+	}
+}
+
+/*
+ * PackDelta - Keeps what a stroke changed in one snapshot.
+ * @rSnapshot: Grid area copied by BeginStroke().
+ * @rDelta: Receives the rect of changed texels and their xor.
+ *
+ * The xor of the old and new bytes is mostly zeros inside the rect, which
+ * zlib packs well. Returns false when the grid still holds the snapshot.
+ */
+bool CTerrainHistory::PackDelta(const TTerrainHistorySnapshot& rSnapshot, TTerrainHistoryDelta& rDelta)
+{
+	GLubyte* pBase = nullptr;
+	GLint iWidth, iDepth, iTexelSize;
+	if (!GetGridView(rSnapshot.pTerrain, rSnapshot.iGrid, &pBase, &iWidth, &iDepth, &iTexelSize))
+	{
+		return (false);
+	}
+
+	const TDirtyRect& rSnapshotRect = rSnapshot.rect;
+	const size_t lSnapshotRowBytes = static_cast<size_t>(rSnapshotRect.GetWidth()) * iTexelSize;
+
+	TDirtyRect changedRect;
+	for (GLint iZ = rSnapshotRect.iMinZ; iZ <= rSnapshotRect.iMaxZ; iZ++)
+	{
+		const GLubyte* pBefore = rSnapshot.vBytes.data() + (iZ - rSnapshotRect.iMinZ) * lSnapshotRowBytes;
+		const GLubyte* pAfter = pBase + (static_cast<size_t>(iZ) * iWidth + rSnapshotRect.iMinX) * iTexelSize;
+
+		if (memcmp(pBefore, pAfter, lSnapshotRowBytes) == 0)
+		{
+			continue;
+		}
+
+		for (GLint iX = rSnapshotRect.iMinX; iX <= rSnapshotRect.iMaxX; iX++)
+		{
+			const size_t lOffset = static_cast<size_t>(iX - rSnapshotRect.iMinX) * iTexelSize;
+			if (memcmp(pBefore + lOffset, pAfter + lOffset, iTexelSize) != 0)
+			{
+				changedRect.Add(iX, iZ);
+			}
+		}
+	}
+
+	GLint iCoordX, iCoordZ;
+	rSnapshot.pTerrain->GetTerrainCoords(&iCoordX, &iCoordZ);
+
+	rDelta.iTerrainCoordX = iCoordX;
+	rDelta.iTerrainCoordZ = iCoordZ;
+	rDelta.iGrid = rSnapshot.iGrid;
+	rDelta.rect = changedRect;
+	rDelta.ubNumWaterXor = 0;
+	rDelta.bCompressed = false;
+	rDelta.uiRawSize = 0;
+	rDelta.vPacked.clear();
+
+	if (rSnapshot.iGrid == TERRAIN_HISTORY_GRID_WATER_HEIGHT)
+	{
+		rDelta.ubNumWaterXor = rSnapshot.ubNumWater ^ rSnapshot.pTerrain->GetWaterData().m_ubNumWater;
+	}
+
+	if (changedRect.IsEmpty())
+	{
+		return (rDelta.ubNumWaterXor != 0);
+	}
+
+	const size_t lRowBytes = static_cast<size_t>(changedRect.GetWidth()) * iTexelSize;
+	std::vector<GLubyte> vXor(lRowBytes * changedRect.GetDepth());
+
+	for (GLint iZ = changedRect.iMinZ; iZ <= changedRect.iMaxZ; iZ++)
+	{
+		const GLubyte* pBefore = rSnapshot.vBytes.data() + (iZ - rSnapshotRect.iMinZ) * lSnapshotRowBytes + static_cast<size_t>(changedRect.iMinX - rSnapshotRect.iMinX) * iTexelSize;
+		const GLubyte* pAfter = pBase + (static_cast<size_t>(iZ) * iWidth + changedRect.iMinX) * iTexelSize;
+		GLubyte* pXor = vXor.data() + (iZ - changedRect.iMinZ) * lRowBytes;
+
+		for (size_t lByte = 0; lByte < lRowBytes; lByte++)
+		{
+			pXor[lByte] = pBefore[lByte] ^ pAfter[lByte];
+		}
+	}
+
+	rDelta.uiRawSize = static_cast<GLuint>(vXor.size());
+
+	std::vector<GLubyte> vCompressed(compressBound(static_cast<uLong>(vXor.size())));
+	uLongf ulCompressedSize = static_cast<uLongf>(vCompressed.size());
+
+	if (compress2(vCompressed.data(), &ulCompressedSize, vXor.data(), static_cast<uLong>(vXor.size()), TERRAIN_HISTORY_COMPRESSION_LEVEL) == Z_OK &&
+		ulCompressedSize < vXor.size())
+	{
+		vCompressed.resize(ulCompressedSize);
+		vCompressed.shrink_to_fit();
+		rDelta.vPacked = std::move(vCompressed);
+		rDelta.bCompressed = true;
+	}
+	else
+	{
+		rDelta.vPacked = std::move(vXor);
+	}
+
+	return (true);
+}
+
+bool CTerrainHistory::UnpackDelta(const TTerrainHistoryDelta& rDelta, std::vector<GLubyte>& vXor)
+{
+	if (!rDelta.bCompressed)
+	{
+		vXor = rDelta.vPacked;
+		return (vXor.size() == rDelta.uiRawSize);
+	}
+
+	vXor.resize(rDelta.uiRawSize);
+	uLongf ulRawSize = static_cast<uLongf>(vXor.size());
+
+	return (uncompress(vXor.data(), &ulRawSize, rDelta.vPacked.data(), static_cast<uLong>(rDelta.vPacked.size())) == Z_OK && ulRawSize == rDelta.uiRawSize);
+}
+
+size_t CTerrainHistory::GetStepBytes(const TTerrainHistoryStep& rStep)
+{
+	size_t lBytes = sizeof(TTerrainHistoryStep);
+
+	for (const TTerrainHistoryDelta& rDelta : rStep.vDeltas)
+	{
+		lBytes += sizeof(TTerrainHistoryDelta) + rDelta.vPacked.capacity();
+	}
+
+	return (lBytes);
+}
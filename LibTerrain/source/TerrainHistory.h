@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "../../LibMath/source/grid.h"
+
+class CTerrain;
+class CTerrainMap;
+
+constexpr size_t TERRAIN_HISTORY_MAX_BYTES = 64 * 1024 * 1024;	// Default memory cap of the undo and redo steps
+constexpr GLint TERRAIN_HISTORY_MARGIN = 2;						// Cells copied around the brush square, the texture brush reaches size + 1
+constexpr GLint TERRAIN_HISTORY_COMPRESSION_LEVEL = 1;
+constexpr GLint TERRAIN_HISTORY_BRUSH_ROW_STRIDE = 4;			// Terrain slots per row assumed by the CTerrainMap::Draw*Brush neighbour offsets
+
+enum ETerrainHistoryGrid
+{
+	TERRAIN_HISTORY_GRID_HEIGHT,
+	TERRAIN_HISTORY_GRID_SPLAT_WEIGHT,
+	TERRAIN_HISTORY_GRID_SPLAT_INDEX,
+	TERRAIN_HISTORY_GRID_ATTR,
+	TERRAIN_HISTORY_GRID_WATER,
+	TERRAIN_HISTORY_GRID_WATER_HEIGHT,	// One row of MAX_WATER_NUM + 1 floats, m_ubNumWater travels with it
+	TERRAIN_HISTORY_GRID_MAX_NUM,
+};
+
+// Grids written by each brush, bits of ETerrainHistoryGrid
+enum ETerrainHistoryBrush
+{
+	TERRAIN_HISTORY_BRUSH_HEIGHT = (1 << TERRAIN_HISTORY_GRID_HEIGHT),
+	TERRAIN_HISTORY_BRUSH_TEXTURE = (1 << TERRAIN_HISTORY_GRID_SPLAT_WEIGHT) | (1 << TERRAIN_HISTORY_GRID_SPLAT_INDEX),
+	TERRAIN_HISTORY_BRUSH_ATTR = (1 << TERRAIN_HISTORY_GRID_ATTR),
+	TERRAIN_HISTORY_BRUSH_WATER = (1 << TERRAIN_HISTORY_GRID_WATER) | (1 << TERRAIN_HISTORY_GRID_ATTR) | (1 << TERRAIN_HISTORY_GRID_WATER_HEIGHT),
+};
+
+// Changed texels of one grid of one terrain, before ^ after over the rect, zlib compressed
+typedef struct STerrainHistoryDelta
+{
+	GLint iTerrainCoordX;
+	GLint iTerrainCoordZ;
+	GLint iGrid;				// ETerrainHistoryGrid
+	TDirtyRect rect;			// In texels of the grid
+	GLuint uiRawSize;			// Bytes of the rect
+	GLubyte ubNumWaterXor;		// TERRAIN_HISTORY_GRID_WATER_HEIGHT only
+	bool bCompressed;			// vPacked is stored raw when zlib does not make it smaller
+	std::vector<GLubyte> vPacked;
+} TTerrainHistoryDelta;
+
+// One stroke, every terrain and grid it changed
+typedef struct STerrainHistoryStep
+{
+	std::vector<TTerrainHistoryDelta> vDeltas;
+	size_t lBytes;
+} TTerrainHistoryStep;
+
+// Grid area copied before a stroke
+typedef struct STerrainHistorySnapshot
+{
+	CTerrain* pTerrain;
+	GLint iGrid;
+	TDirtyRect rect;
+	GLubyte ubNumWater;
+	std::vector<GLubyte> vBytes;
+} TTerrainHistorySnapshot;
+
+/**
+ * CTerrainHistory - Undo and redo of the terrain brushes.
+ *
+ * BeginStroke() copies the grids a brush may write around the brush, in
+ * the terrain under it and in its neighbours, which PutTerrainHeightMap
+ * and the edge strokes reach. EndStroke() compares the copies with the
+ * grids and keeps, per terrain and grid, the rect of texels that changed
+ * as the compressed xor of their old and new bytes. The same xor applied
+ * again swaps the grid between the two states, so undo and redo are bit
+ * exact as long as nothing else edits the grids in between.
+ *
+ * Steps are dropped from the oldest one once the memory cap is reached.
+ * Only the changed rects are marked dirty after an undo or redo, so the
+ * terrain uploads no more than the stroke did.
+ */
+class CTerrainHistory
+{
+public:
+	CTerrainHistory();
+
+	void Clear();
+
+	void BeginStroke(CTerrainMap* pTerrainMap, GLuint uiGridMask, GLint iTerrainCoordX, GLint iTerrainCoordZ, GLint iCellX, GLint iCellZ, GLint iBrushSize);
+	void EndStroke();
+
+	bool Undo(CTerrainMap* pTerrainMap);
+	bool Redo(CTerrainMap* pTerrainMap);
+
+	bool CanUndo() const;
+	bool CanRedo() const;
+	GLint GetUndoCount() const;
+	GLint GetRedoCount() const;
+
+	// Drops the deltas of a terrain whose grids are given back to the pool
+	void ForgetTerrain(GLint iTerrainCoordX, GLint iTerrainCoordZ);
+
+	void SetMaxBytes(size_t lMaxBytes);
+	size_t GetMaxBytes() const;
+	size_t GetUsedBytes() const;
+
+protected:
+	// Adds the brush cells of one terrain, merged with the ones already found for it
+	static void AddStrokeTerrain(std::vector<std::pair<CTerrain*, TDirtyRect>>& vTerrains, CTerrain* pTerrain, const TDirtyRect& cellRect);
+	void PushUndoStep(TTerrainHistoryStep& rStep);
+	void TrimToMaxBytes();
+	bool ApplyStep(CTerrainMap* pTerrainMap, const TTerrainHistoryStep& rStep);
+
+	static bool GetGridView(CTerrain* pTerrain, GLint iGrid, GLubyte** ppBase, GLint* piWidth, GLint* piDepth, GLint* piTexelSize);
+	// Texels of a grid covered by a rect of terrain cells
+	static TDirtyRect GetGridRect(GLint iGrid, const TDirtyRect& cellRect);
+	static void MarkGridRectDirty(CTerrain* pTerrain, GLint iGrid, const TDirtyRect& rect);
+	// False when the grids still hold the snapshot
+	static bool PackDelta(const TTerrainHistorySnapshot& rSnapshot, TTerrainHistoryDelta& rDelta);
+	static bool UnpackDelta(const TTerrainHistoryDelta& rDelta, std::vector<GLubyte>& vXor);
+	static size_t GetStepBytes(const TTerrainHistoryStep& rStep);
+
+protected:
+	std::deque<TTerrainHistoryStep> m_dqUndo;
+	std::deque<TTerrainHistoryStep> m_dqRedo;
+	size_t m_lUsedBytes;
+	size_t m_lMaxBytes;
+
+	// Copies of the stroke in progress
+	std::vector<TTerrainHistorySnapshot> m_vSnapshots;
+	bool m_bInStroke;
+};
@@ -0,0 +1,157 @@
+#include "Stdafx.h"
+#include <filesystem>
+#include "TerrainLoader.h"
+#include "Terrain.h"
+#include "TerrainChunk.h"
+#include "ScopedTimer.h"
+
+CTerrainLoader::CTerrainLoader()
+{
+	m_bBusy = false;
+	m_bStop = true;
+}
+
+CTerrainLoader::~CTerrainLoader()
+{
+	Stop();
+}
+
+void CTerrainLoader::Start()
+{
+	if (m_Worker.joinable())
+	{
+		return;
+	}
+
+	m_bStop = false;
+	m_Worker = std::thread(&CTerrainLoader::WorkerLoop, this);
+}
+
+void CTerrainLoader::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStop = true;
+	}
+	m_RequestCond.notify_all();
+
+	if (m_Worker.joinable())
+	{
+		m_Worker.join();
+	}
+
+	m_dqPending.clear();
+	m_dqLoaded.clear();
+	m_bBusy = false;
+}
+
+void CTerrainLoader::Request(const TTerrainLoadRequest& rRequest)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_dqPending.push_back(rRequest);
+	}
+	m_RequestCond.notify_one();
+}
+
+bool CTerrainLoader::PopLoaded(TTerrainLoadRequest* pRequest)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_dqLoaded.empty())
+	{
+		return (false);
+	}
+
+	*pRequest = m_dqLoaded.front();
+	m_dqLoaded.pop_front();
+	return (true);
+}
+
+void CTerrainLoader::Clear()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_dqPending.clear();
+	m_IdleCond.wait(lock, [this] { return (!m_bBusy); });
+	m_dqLoaded.clear();
+}
+
+void CTerrainLoader::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_IdleCond.wait(lock, [this] { return (m_dqPending.empty() && !m_bBusy) || m_bStop; });
+}
+
+bool CTerrainLoader::IsIdle()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return (m_dqPending.empty() && m_dqLoaded.empty() && !m_bBusy);
+}
+
+void CTerrainLoader::WorkerLoop()
+{
+	while (true)
+	{
+		TTerrainLoadRequest request;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_RequestCond.wait(lock, [this] { return (m_bStop || !m_dqPending.empty()); });
+
+			if (m_bStop)
+			{
+				break;
+			}
+
+			request = m_dqPending.front();
+			m_dqPending.pop_front();
+			m_bBusy = true;
+		}
+
+		request.bLoaded = LoadTerrainData(request);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_dqLoaded.push_back(request);
+			m_bBusy = false;
+		}
+		m_IdleCond.notify_all();
+	}
+
+	m_IdleCond.notify_all();
+}
+
+/*
+ * LoadTerrainData - CPU stage of a terrain load.
+ * @rRequest: Request holding a cleared terrain and its coordinates.
+ *
+ * Reads the terrain chunk, or the TerrainData.json and raw maps of a map
+ * that was not converted yet, and generates the patch vertices. Runs on the
+ * worker thread, so it must not issue any GL call; the terrain textures do
+ * not exist yet, which keeps SetupBaseTexture on the CPU side only.
+ */
+bool CTerrainLoader::LoadTerrainData(TTerrainLoadRequest& rRequest)
+{
+	ScopedTimer timer("CTerrainLoader::LoadTerrainData");
+
+	CTerrain* pTerrain = rRequest.pTerrain;
+	const std::string stChunkFile = CTerrainChunk::GetFileName(rRequest.stMapDirectory, rRequest.iTerrainCoordX, rRequest.iTerrainCoordZ);
+
+	if (std::filesystem::exists(stChunkFile))
+	{
+		if (!pTerrain->LoadChunk(stChunkFile))
+		{
+			sys_err("CTerrainLoader::LoadTerrainData: (%d, %d) Failed to Load Terrain Chunk (%s)", rRequest.iTerrainCoordX, rRequest.iTerrainCoordZ, stChunkFile.c_str());
+			return (false);
+		}
+	}
+	else if (!pTerrain->LoadLegacyFiles(rRequest.stMapDirectory))
+	{
+		return (false);
+	}
+
+	// Setup Base Texture (0)
+	pTerrain->SetupBaseTexture();
+
+	pTerrain->CalculateTerrainPatches(false);
+
+	return (true);
+}
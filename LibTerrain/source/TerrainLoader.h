@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+class CTerrain;
+
+typedef struct STerrainLoadRequest
+{
+	CTerrain* pTerrain;			// Allocated and cleared on the main thread
+	std::string stMapDirectory;
+	GLint iTerrainCoordX;
+	GLint iTerrainCoordZ;
+	GLint iTerrainNum;
+	bool bLoaded;				// Result of the CPU stage
+} TTerrainLoadRequest;
+
+/**
+ * CTerrainLoader - Builds the CPU side of terrains on a worker thread.
+ *
+ * Requests are queued by the main thread with a terrain taken from the pool,
+ * the worker reads and decodes the terrain files and generates the patch
+ * vertices, then hands the request back. GL objects are never touched by the
+ * worker, the main thread creates them from PopLoaded().
+ *
+ * The loads do not go through CJobSystem on purpose. A job queued from the
+ * main thread lands in the shared queue, the one the main thread pops first
+ * while it waits in ParallelFor, so a physics step or a patch rebuild would
+ * end up reading and decoding a terrain in the middle of the frame. A load
+ * also spends most of its time blocked on the disk, which would hold a
+ * compute worker. For the same reason a load builds its patches on the
+ * loader thread alone, CalculateTerrainPatches only spreads them over
+ * ParallelFor on the main thread and the job workers.
+ */
+class CTerrainLoader
+{
+public:
+	CTerrainLoader();
+	~CTerrainLoader();
+
+	void Start();
+	void Stop();
+
+	void Request(const TTerrainLoadRequest& rRequest);
+	bool PopLoaded(TTerrainLoadRequest* pRequest);
+
+	// Drops queued and finished requests, waits for the one in flight
+	void Clear();
+	// Blocks until every queued request has been built
+	void WaitIdle();
+
+	bool IsIdle();
+
+	// CPU stage, no GL context required
+	static bool LoadTerrainData(TTerrainLoadRequest& rRequest);
+
+protected:
+	void WorkerLoop();
+
+protected:
+	std::thread m_Worker;
+	std::mutex m_Mutex;
+	std::condition_variable m_RequestCond;
+	std::condition_variable m_IdleCond;
+
+	std::deque<TTerrainLoadRequest> m_dqPending;
+	std::deque<TTerrainLoadRequest> m_dqLoaded;
+
+	bool m_bBusy;
+	bool m_bStop;
+};
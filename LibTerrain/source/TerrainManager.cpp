@@ -133,7 +133,17 @@ bool CTerrainManager::UpdateMap(const SVector3Df& v3Pos)
 	}
 
 	CTerrainMap& rMap = GetMapRef();
-	rMap.UpdateMap(v3Pos);
+	if (!rMap.UpdateMap(v3Pos))
+	{
+		return (false);
+	}
+
+	// The picked object may have been streamed out with its area
+	if (m_pCurrentPickedObject && !CPhysicsWorld::Instance().HasObject(m_pCurrentPickedObject))
+	{
+		m_pCurrentPickedObject = nullptr;
+	}
+
 	return (true);
 }
 
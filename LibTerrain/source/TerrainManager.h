@@ -52,6 +52,7 @@ public:
 	bool SaveMapSettings(const std::string& stMapName);
 	bool SaveTerrains();
 	bool SaveAreas();
+	bool ConvertTerrainFiles();
 
 	void UpdateEditingPoint(SVector3Df* v3IntersectionPoint);
 	void GetEditingData(GLint* iEditX, GLint* iEditZ, GLint* iSubCellX, GLint* iSubCellZ, GLint* iEditTerrainNumX, GLint* iEditTerrainNumZ);
@@ -62,6 +63,12 @@ public:
 	void EditAttributes();
 	void EditTerrainWater();
 
+	// Undo and redo of the brush strokes
+	bool UndoEdit();
+	bool RedoEdit();
+	bool CanUndoEdit() const;
+	bool CanRedoEdit() const;
+
 	CTerrainMap& GetTerrainMapRef();
 	CTerrainMap* GetTerrainMapPtr();
 
@@ -163,6 +163,11 @@ bool CTerrainManager::SaveAreas()
 	return (m_pTerrainMap->SaveAreas());
 }
 
+bool CTerrainManager::ConvertTerrainFiles()
+{
+	return (m_pTerrainMap->ConvertTerrainFiles());
+}
+
 void CTerrainManager::UpdateEditingPoint(SVector3Df* v3IntersectionPoint)
 {
 	m_pTerrainMap->GetPickingCoordinate(v3IntersectionPoint, &m_iEditX, &m_iEditZ, &m_iSubCellX, &m_iSubCellZ, &m_iEditTerrainNumX, &m_iEditTerrainNumZ);
@@ -227,6 +232,36 @@ void CTerrainManager::EditTerrainWater()
 	m_pTerrainMap->DrawWaterBrush(m_bBrushShape, m_iEditTerrainNumX, m_iEditTerrainNumZ, m_iEditX, m_iEditZ, m_iSubCellX, m_iSubCellZ, m_iBrushSize, m_iBrushStrength, m_fWaterBrushHeight, m_bEraseWater);
 }
 
+bool CTerrainManager::UndoEdit()
+{
+	if (!m_pTerrainMap)
+	{
+		return (false);
+	}
+
+	return (m_pTerrainMap->UndoEdit());
+}
+
+bool CTerrainManager::RedoEdit()
+{
+	if (!m_pTerrainMap)
+	{
+		return (false);
+	}
+
+	return (m_pTerrainMap->RedoEdit());
+}
+
+bool CTerrainManager::CanUndoEdit() const
+{
+	return (m_pTerrainMap && m_pTerrainMap->CanUndoEdit());
+}
+
+bool CTerrainManager::CanRedoEdit() const
+{
+	return (m_pTerrainMap && m_pTerrainMap->CanRedoEdit());
+}
+
 CTerrainMap& CTerrainManager::GetTerrainMapRef()
 {
 	assert(m_pTerrainMap != nullptr);
@@ -536,7 +571,9 @@ void CTerrainManager::SetPickingObjects(bool bIsPicking)
 
 void CTerrainManager::PickObject(const CRay& ray)
 {
-	CPhysicsObject* pPickedObject = CPhysicsWorld::Instance().PickObject(ray);
+	// The placed objects rarely move, their area BVH is cheaper to walk than the physics grid
+	GLfloat fDistance = 0.0f;
+	CPhysicsObject* pPickedObject = m_pTerrainMap->PickObject(ray, &fDistance);
 	if (pPickedObject != m_pCurrentPickedObject)
 	{
 		// Unselect previous
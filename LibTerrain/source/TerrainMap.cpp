@@ -1,6 +1,7 @@
 #include "Stdafx.h"
 #include "TerrainMap.h"
 #include "TerrainAreaData.h"
+#include "../../LibGame/source/Skybox.h"
 
 CTerrainMap::CTerrainMap()
 {
@@ -27,6 +28,12 @@ void CTerrainMap::Initialize()
 	m_iNumTerrains = 0;
 	m_iNumAreas = 0;
 
+	m_iTerrainLoadSize = TERRAIN_LOAD_SIZE;
+	m_iPlayerTerrainX = m_iPlayerTerrainZ = -1;
+	m_fUploadBudgetMs = 2.0f;
+	m_uiTerrainUploads = 0;
+	m_bGLState = true;
+
 	m_uiTerrainHandlesSSBO = 0;
 	m_sUploadedTextureCount = 0; // Track New Textures
 	m_sAllocatedSSBOSlots = 0; // Track New Textures
@@ -52,6 +59,8 @@ void CTerrainMap::Destroy()
 	m_sAllocatedSSBOSlots = 0; // Track New Textures
 	m_vTextureHandles.clear();
 
+	m_InstanceRingBuffer.Destroy();
+
 	// Release Water Data
 	safe_delete(m_pWaterDudvTex);
 	safe_delete(m_pWaterNormalTex);
@@ -66,26 +75,185 @@ void CTerrainMap::Destroy()
 	CTerrainWaterVAO::Destroy();
 }
 
+/*
+ * UpdateMap - Streams the terrains around the player.
+ * @v3PlayerPos: World position of the player (or camera).
+ *
+ * Keeps only the ring of m_iTerrainLoadSize terrains around the terrain the
+ * player stands on resident. Terrains (and their areas) leaving the ring are
+ * given back to their pools, missing ones are requested from the loader
+ * nearest first. Terrains built by the loader are uploaded every call within
+ * m_fUploadBudgetMs; the ring itself only changes when the player enters
+ * another terrain, or after a call that stopped on the resident budget.
+ */
 bool CTerrainMap::UpdateMap(const SVector3Df& v3PlayerPos)
 {
+	m_v3Player = v3PlayerPos;
+
+	if (m_iTerrainCountX <= 0 || m_iTerrainCountZ <= 0)
+	{
+		return (false);
+	}
+
+	const size_t sTerrainSlots = static_cast<size_t>(m_iTerrainCountX) * m_iTerrainCountZ;
+	if (m_vLoadedTerrains.size() != sTerrainSlots)
+	{
+		m_vLoadedTerrains.resize(sTerrainSlots, nullptr);
+		m_vPendingTerrains.resize(sTerrainSlots, nullptr);
+		m_vLoadedAreas.resize(sTerrainSlots, nullptr);
+	}
+
+	ProcessTerrainUploads(m_fUploadBudgetMs);
+
+	GLint iPlayerTerrainX = static_cast<GLint>(std::floor(v3PlayerPos.x / static_cast<GLfloat>(TERRAIN_XSIZE)));
+	GLint iPlayerTerrainZ = static_cast<GLint>(std::floor(v3PlayerPos.z / static_cast<GLfloat>(TERRAIN_ZSIZE)));
+	iPlayerTerrainX = std::clamp(iPlayerTerrainX, 0, m_iTerrainCountX - 1);
+	iPlayerTerrainZ = std::clamp(iPlayerTerrainZ, 0, m_iTerrainCountZ - 1);
+
+	if (iPlayerTerrainX == m_iPlayerTerrainX && iPlayerTerrainZ == m_iPlayerTerrainZ)
+	{
+		return (true);
+	}
+
+	m_iPlayerTerrainX = iPlayerTerrainX;
+	m_iPlayerTerrainZ = iPlayerTerrainZ;
+
+	// Unload everything that left the ring first so the pools can reuse it
 	for (GLint iTerrainZ = 0; iTerrainZ < m_iTerrainCountZ; iTerrainZ++)
 	{
-		for (GLushort iTerrainX = 0; iTerrainX < m_iTerrainCountX; iTerrainX++)
+		for (GLint iTerrainX = 0; iTerrainX < m_iTerrainCountX; iTerrainX++)
+		{
+			if (std::abs(iTerrainX - iPlayerTerrainX) <= m_iTerrainLoadSize && std::abs(iTerrainZ - iPlayerTerrainZ) <= m_iTerrainLoadSize)
+			{
+				continue;
+			}
+
+			const GLint iTerrainNum = iTerrainZ * m_iTerrainCountX + iTerrainX;
+			UnloadTerrain(iTerrainNum);
+			UnloadArea(iTerrainNum);
+		}
+	}
+
+	// Ring sizes bigger than the default one raise the budget with them
+	const GLint iRingSide = 2 * m_iTerrainLoadSize + 1;
+	const GLint iMaxResidentTerrains = std::max<GLint>(MAX_RENDER_TERRAINS_NUM, iRingSide * iRingSide);
+
+	// Walk the ring outward so the terrain under the player is always loaded first
+	for (GLint iRing = 0; iRing <= m_iTerrainLoadSize; iRing++)
+	{
+		for (GLint iTerrainZ = iPlayerTerrainZ - iRing; iTerrainZ <= iPlayerTerrainZ + iRing; iTerrainZ++)
 		{
-			LoadTerrain(iTerrainX, iTerrainZ, m_iNumTerrains);
-			LoadArea(iTerrainX, iTerrainZ, m_iNumTerrains);
-			m_iNumTerrains++;
+			for (GLint iTerrainX = iPlayerTerrainX - iRing; iTerrainX <= iPlayerTerrainX + iRing; iTerrainX++)
+			{
+				if (std::max(std::abs(iTerrainX - iPlayerTerrainX), std::abs(iTerrainZ - iPlayerTerrainZ)) != iRing)
+				{
+					continue;
+				}
+
+				if (iTerrainX < 0 || iTerrainZ < 0 || iTerrainX >= m_iTerrainCountX || iTerrainZ >= m_iTerrainCountZ)
+				{
+					continue;
+				}
+
+				if (IsTerrainLoaded(iTerrainX, iTerrainZ))
+				{
+					continue;
+				}
+
+				if (m_iNumTerrains >= iMaxResidentTerrains)
+				{
+					sys_err("CTerrainMap::UpdateMap: Resident terrains budget (%d) reached", iMaxResidentTerrains);
+
+					// Forget the player terrain so the next call queues the rest of the ring
+					m_iPlayerTerrainX = m_iPlayerTerrainZ = -1;
+					return (false);
+				}
+
+				// The area follows once the terrain is uploaded, see ProcessTerrainUploads
+				LoadTerrain(iTerrainX, iTerrainZ, iTerrainZ * m_iTerrainCountX + iTerrainX);
+			}
 		}
 	}
 
 	return (true);
 }
 
+void CTerrainMap::SetTerrainLoadSize(GLint iLoadSize)
+{
+	m_iTerrainLoadSize = std::max(0, iLoadSize);
+
+	// Force the ring to be rebuilt on the next UpdateMap
+	m_iPlayerTerrainX = m_iPlayerTerrainZ = -1;
+}
+
+GLint CTerrainMap::GetTerrainLoadSize() const
+{
+	return (m_iTerrainLoadSize);
+}
+
+GLint CTerrainMap::GetNumLoadedTerrains() const
+{
+	return (m_iNumTerrains);
+}
+
+GLuint CTerrainMap::GetNumTerrainUploads() const
+{
+	return (m_uiTerrainUploads);
+}
+
+void CTerrainMap::SetUploadBudget(GLfloat fBudgetMs)
+{
+	m_fUploadBudgetMs = fBudgetMs;
+}
+
+GLfloat CTerrainMap::GetUploadBudget() const
+{
+	return (m_fUploadBudgetMs);
+}
+
+/*
+ * GetCulledPatchesNum - Patches rejected by the frustum on the last frame.
+ *
+ * Sums the counters of the ready terrains. Only CTerrain::Render (the main
+ * camera pass) stores its count, the water passes are not counted.
+ */
+GLint CTerrainMap::GetCulledPatchesNum() const
+{
+	GLint iCulledPatches = 0;
+
+	for (const auto& it : m_vLoadedTerrains)
+	{
+		if (it && it->IsReady())
+		{
+			iCulledPatches += it->GetCulledPatchesNum();
+		}
+	}
+
+	return (iCulledPatches);
+}
+
+/*
+ * Render - Draws the areas, the terrains and their water.
+ * @fDeltaTime: Frame time, forwarded to the area objects.
+ *
+ * The water planes are gathered from the water patches visible by the
+ * current camera. Each distinct height gets one reflection and one
+ * refraction pass over every terrain; the water at that height is drawn
+ * right after, before the next plane reuses the two frame buffers. Nothing
+ * is rendered for water when no water patch is visible.
+ */
 void CTerrainMap::Render(GLfloat fDeltaTime)
 {
 	// Bind SSBO to index 0
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_uiTerrainHandlesSSBO);
 
+	if (!m_InstanceRingBuffer.IsCreated())
+	{
+		m_InstanceRingBuffer.Create(INSTANCE_RING_FRAME_SIZE);
+	}
+
+	m_InstanceRingBuffer.BeginFrame();
+
 	for (const auto& it : m_vLoadedAreas)
 	{
 		if (it)
@@ -94,6 +262,27 @@ void CTerrainMap::Render(GLfloat fDeltaTime)
 		}
 	}
 
+	m_InstanceRingBuffer.EndFrame();
+
+	SFrustumCulling frustumCulling(CCameraManager::Instance().GetCurrentCameraRef().GetViewProjMatrix());
+
+	m_vWaterHeights.clear();
+	for (const auto& it : m_vLoadedTerrains)
+	{
+		if (it && it->IsReady())
+		{
+			it->CollectWaterHeights(frustumCulling, m_vWaterHeights);
+		}
+	}
+
+	PlanWaterPlanes(m_vWaterHeights, m_vWaterPlanes);
+
+	glDisable(GL_CLIP_DISTANCE0);
+
+	// --- Draw Terrains to Main FBO ---
+	CFrameBuffer* pFrameBuffer = CWindow::Instance().GetFrameBuffer();
+	pFrameBuffer->BindForWriting();
+
 	for (const auto& it : m_vLoadedTerrains)
 	{
 		if (it && it->IsReady())
@@ -102,14 +291,160 @@ void CTerrainMap::Render(GLfloat fDeltaTime)
 		}
 	}
 
+	pFrameBuffer->UnBindWriting();
+
+	// --- Water, one pass pair per plane ---
+	const CCamera& rMainCamera = CCameraManager::Instance().GetCurrentCameraRef();
+	for (const GLfloat fWaterHeight : m_vWaterPlanes)
+	{
+		RenderReflectionPass(fWaterHeight);
+		RenderRefractionPass(fWaterHeight);
+
+		// The passes above left their own view in the frame uniform block
+		CWindow::Instance().UpdateFrameUniforms(rMainCamera);
+
+		// The water shader samples the reflection/refraction FBOs filled above
+		pFrameBuffer->BindForWriting();
+
+		for (const auto& it : m_vLoadedTerrains)
+		{
+			if (it && it->IsReady())
+			{
+				it->RenderWater(fWaterHeight);
+			}
+		}
+
+		pFrameBuffer->UnBindWriting();
+	}
+
 	// Unbind SSBO from index 0
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0); // Critical for safety
 }
 
+/*
+ * PlanWaterPlanes - Reduces water patch heights to the planes to render.
+ * @vWaterHeights: Height of every visible water patch, in any order.
+ * @vWaterPlanes: Receives each distinct height once, ascending.
+ *
+ * Pure CPU. Patches share a plane only when their heights are equal, the
+ * same test CTerrain::RenderWater uses to pick the patches of a plane.
+ */
+void CTerrainMap::PlanWaterPlanes(const std::vector<GLfloat>& vWaterHeights, std::vector<GLfloat>& vWaterPlanes)
+{
+	vWaterPlanes.assign(vWaterHeights.begin(), vWaterHeights.end());
+	std::sort(vWaterPlanes.begin(), vWaterPlanes.end());
+	vWaterPlanes.erase(std::unique(vWaterPlanes.begin(), vWaterPlanes.end()), vWaterPlanes.end());
+}
+
+GLint CTerrainMap::GetNumWaterPlanes() const
+{
+	return (static_cast<GLint>(m_vWaterPlanes.size()));
+}
+
+void CTerrainMap::RenderReflectionPass(GLfloat fWaterHeight)
+{
+	// 1. Bind the Reflection FBO for writing
+	m_pReflectionFBO->BindForWriting();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	const CCamera& rOriginalCamera = CCameraManager::Instance().GetCurrentCameraRef();
+	CCamera reflectionCamera = rOriginalCamera; // Start with a copy of the original camera
+
+	// Mirror the camera position across the water plane
+	SVector3Df v3OriginalCamPos = rOriginalCamera.GetPosition();
+	SVector3Df v3ReflectedCamPos = v3OriginalCamPos;
+	v3ReflectedCamPos.y = fWaterHeight - (v3OriginalCamPos.y - fWaterHeight);
+	reflectionCamera.SetPosition(v3ReflectedCamPos);
+
+	reflectionCamera.InvertCameraPitch();
+
+	// Clip geometry *below* the water surface, slightly above it to avoid artifacts
+	SVector3Df v3PlaneNormal(0.0f, 1.0f, 0.0f);
+	SVector3Df v3PointOnPlane(0.0f, fWaterHeight + 0.1f, 0.0f);
+	SVector4Df v4ReflectionClipPlane = CalculateClipPlane(v3PlaneNormal, v3PointOnPlane);
+
+	// Enable clipping and change culling for reflection pass
+	glEnable(GL_CLIP_DISTANCE0);
+	glCullFace(GL_FRONT);
+
+	CWindow::Instance().UpdateFrameUniforms(reflectionCamera, v4ReflectionClipPlane);
+
+	for (const auto& it : m_vLoadedTerrains)
+	{
+		if (it && it->IsReady())
+		{
+			it->RenderPatches(reflectionCamera);
+		}
+	}
+
+	CWindow::Instance().GetSkyBox()->Render();
+
+	// Restore culling and disable clipping
+	glCullFace(GL_BACK);
+	glDisable(GL_CLIP_DISTANCE0);
+
+	m_pReflectionFBO->UnBindWriting();
+}
+
+void CTerrainMap::RenderRefractionPass(GLfloat fWaterHeight)
+{
+	// 1. Bind the Refraction FBO for writing
+	m_pRefractionFBO->BindForWriting();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// For refraction, we use the original camera.
+	const CCamera& rOriginalCamera = CCameraManager::Instance().GetCurrentCameraRef();
+
+	// Clip geometry *above* the water surface, slightly below it to avoid artifacts
+	SVector3Df v3PlaneNormal(0.0f, -1.0f, 0.0f);
+	SVector3Df v3PointOnPlane(0.0f, fWaterHeight - 0.1f, 0.0f);
+	SVector4Df v4RefractionClipPlane = CalculateClipPlane(v3PlaneNormal, v3PointOnPlane);
+
+	glEnable(GL_CLIP_DISTANCE0);
+
+	CWindow::Instance().UpdateFrameUniforms(rOriginalCamera, v4RefractionClipPlane);
+
+	for (const auto& it : m_vLoadedTerrains)
+	{
+		if (it && it->IsReady())
+		{
+			it->RenderPatches(rOriginalCamera);
+		}
+	}
+
+	CWindow::Instance().GetSkyBox()->Render();
+
+	glDisable(GL_CLIP_DISTANCE0);
+
+	m_pRefractionFBO->UnBindWriting();
+}
+
+// Helper to calculate plane equation (nx*x + ny*y + nz*z + d = 0)
+// Point p on plane, normal n
+SVector4Df CTerrainMap::CalculateClipPlane(const SVector3Df& v3Normal, const SVector3Df& v3Point)
+{
+	float d = -v3Normal.dot(v3Point);
+	return SVector4Df(v3Normal.x, v3Normal.y, v3Normal.z, d);
+}
+
 void CTerrainMap::DestroyTerrains()
 {
+	// The worker may still be filling a pooled terrain
+	m_TerrainLoader.Clear();
+	m_vPendingTerrains.clear();
+
+	for (GLint iNum = 0; iNum < static_cast<GLint>(m_vLoadedAreas.size()); iNum++)
+	{
+		UnloadArea(iNum);
+	}
+
 	m_vLoadedTerrains.clear();
 	m_vLoadedAreas.clear();
+	m_iNumTerrains = 0;
+	m_iNumAreas = 0;
+	m_iPlayerTerrainX = m_iPlayerTerrainZ = -1;
+	m_uiTerrainUploads = 0;
+	m_EditHistory.Clear();
 
 	CTerrain::ms_TerrainPool.FreeAll();
 	CTerrainAreaData::ms_AreaPool.FreeAll();
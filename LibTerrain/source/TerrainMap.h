@@ -1,8 +1,13 @@
 #pragma once
 
 #include "Terrain.h"
+#include "TerrainLoader.h"
+#include "TerrainHistory.h"
 #include "../../LibGL/source/shader.h"
 #include "../../LibGL/source/screen.h"
+#include "../../LibGL/source/RingBuffer.h"
+
+class CPhysicsObject;
 
 enum EMapOutdoorData
 {
@@ -10,12 +15,70 @@ enum EMapOutdoorData
 	MAX_RENDER_TERRAINS_NUM = 9,
 };
 
+// Height slack (meters) of the picking range tests, covers the rounding of the ray height at cell borders
+constexpr GLfloat PICKING_HEIGHT_EPSILON = 0.01f;
+
+// Per frame staging space of the area object instance uploads, 16384 matrices
+constexpr GLsizeiptr INSTANCE_RING_FRAME_SIZE = 1024 * 1024;
+
 typedef struct SOutdoorMapCoordinate
 {
 	GLint m_iTerrainCoordX;		// Terrain Coordinates
 	GLint m_iTerrainCoordZ;
 } TOutdoorMapCoordinate;
 
+/*
+ * TGridWalk2D - 2D DDA over a square grid in the XZ plane.
+ *
+ * Visits the grid cells crossed by the ray v3Origin + t * v3Dir in order
+ * of t. GetExitT() is the ray parameter where the current cell is left,
+ * Step() moves to the next cell. The start cell is clamped to the given
+ * index range, so t may sit exactly on a border.
+ */
+typedef struct SGridWalk2D
+{
+	GLint iX, iZ;
+	GLint iStepX, iStepZ;
+	GLfloat fNextX, fNextZ;		// Ray parameter of the next X / Z grid line
+	GLfloat fDeltaX, fDeltaZ;	// Ray parameter span of one cell along X / Z
+
+	void Begin(const SVector3Df& v3Origin, const SVector3Df& v3Dir, GLfloat fT, GLfloat fCellSize, GLint iMinX, GLint iMaxX, GLint iMinZ, GLint iMaxZ)
+	{
+		iX = static_cast<GLint>(std::floor((v3Origin.x + v3Dir.x * fT) / fCellSize));
+		iZ = static_cast<GLint>(std::floor((v3Origin.z + v3Dir.z * fT) / fCellSize));
+		iX = MyMath::iminmax(iMinX, iX, iMaxX);
+		iZ = MyMath::iminmax(iMinZ, iZ, iMaxZ);
+
+		iStepX = (v3Dir.x >= 0.0f) ? 1 : -1;
+		iStepZ = (v3Dir.z >= 0.0f) ? 1 : -1;
+
+		fDeltaX = (v3Dir.x != 0.0f) ? fCellSize / std::fabs(v3Dir.x) : FLT_MAX;
+		fDeltaZ = (v3Dir.z != 0.0f) ? fCellSize / std::fabs(v3Dir.z) : FLT_MAX;
+
+		fNextX = (v3Dir.x != 0.0f) ? (static_cast<GLfloat>(iX + (iStepX > 0 ? 1 : 0)) * fCellSize - v3Origin.x) / v3Dir.x : FLT_MAX;
+		fNextZ = (v3Dir.z != 0.0f) ? (static_cast<GLfloat>(iZ + (iStepZ > 0 ? 1 : 0)) * fCellSize - v3Origin.z) / v3Dir.z : FLT_MAX;
+	}
+
+	GLfloat GetExitT() const
+	{
+		return (MyMath::fmin(fNextX, fNextZ));
+	}
+
+	void Step()
+	{
+		if (fNextX < fNextZ)
+		{
+			iX += iStepX;
+			fNextX += fDeltaX;
+		}
+		else
+		{
+			iZ += iStepZ;
+			fNextZ += fDeltaZ;
+		}
+	}
+} TGridWalk2D;
+
 class CTerrainMap : public CScreen
 {
 public:
@@ -26,11 +89,32 @@ public:
 	void Initialize();
 	void Destroy();
 
-	bool LoadMap(const SVector3Df& v3PlayerPos);
+	// bGLState false streams the CPU side only (no GL context needed): no shader, texture, terrain buffer or area
+	bool LoadMap(const SVector3Df& v3PlayerPos, bool bGLState = true);
+	// Every terrain, CPU side only (no GL context needed)
+	bool LoadMapData();
 	bool UpdateMap(const SVector3Df& v3PlayerPos);
+	// Blocks until the loader is idle and makes every terrain it built resident
+	void FinishTerrainLoads();
+
+	// Terrain Streaming
+	void SetTerrainLoadSize(GLint iLoadSize);
+	GLint GetTerrainLoadSize() const;
+	GLint GetNumLoadedTerrains() const;
+	// Terrains made resident since the map was loaded
+	GLuint GetNumTerrainUploads() const;
+	void SetUploadBudget(GLfloat fBudgetMs);
+	GLfloat GetUploadBudget() const;
+
+	// Profiling
+	GLint GetCulledPatchesNum() const;
 
 	void Render(GLfloat fDeltaTime);
 
+	// Distinct water plane heights in ascending order, one water pass pair each
+	static void PlanWaterPlanes(const std::vector<GLfloat>& vWaterHeights, std::vector<GLfloat>& vWaterPlanes);
+	GLint GetNumWaterPlanes() const;
+
 	// Map Methods
 	void SetMapReady(bool bReady);
 	bool IsMapReady() const;
@@ -54,6 +138,9 @@ public:
 	bool GetTerrainNumByCoord(GLint iTerrainCoordX, GLint iTerrainCoordZ, GLint* piTerrainNum);
 	GLfloat GetTerrainHeight(GLfloat fX, GLfloat fZ);
 	GLfloat GetHeight(GLfloat fX, GLfloat fZ);
+	// GetHeight of sCount points, grouped by terrain; normals are (0, 1, 0) where the height is 0 for lack of a terrain
+	void GetHeights(const GLfloat* pfXs, const GLfloat* pfZs, GLfloat* pfHeights, size_t sCount);
+	void GetHeights(const GLfloat* pfXs, const GLfloat* pfZs, GLfloat* pfHeights, SVector3Df* pv3Normals, size_t sCount);
 
 	GLfloat GetWaterHeight(GLfloat fX, GLfloat fZ);
 
@@ -76,18 +163,30 @@ public:
 	CFrameBuffer& GetReflectionFBORef();
 	CFrameBuffer& GetRefractionFBORef();
 
+	// Staging of the area object instance matrices, valid between the BeginFrame/EndFrame of Render
+	CRingBuffer& GetInstanceRingBuffer();
+
 
 protected:
 	void InitializeMapShaders();
 	void InitializeMapWaterData();
 
-	bool LoadSettings(const std::string& stSettingsFile);
+	bool LoadSettings(const std::string& stSettingsFile, bool bLoadTextureset = true);
 	bool LoadTerrain(GLint iTerrainCoordX, GLint iTerrainCoordZ, GLint iTerrainNum = 0);
 	bool LoadArea(GLint iAreaCoordX, GLint iAreaCoordZ, GLint iAreaNum = 0);
 	bool IsTerrainLoaded(GLint iTerrainCoordX, GLint iTerrainCoordZ);
 	bool IsAreaLoaded(GLint iAreaCoordX, GLint iAreaCoordZ);
+	void UnloadTerrain(GLint iTerrainNum);
+	void ProcessTerrainUploads(GLfloat fBudgetMs);
+	void UnloadArea(GLint iAreaNum);
 
 	void DestroyTerrains();
+
+	// Water Passes
+	void RenderReflectionPass(GLfloat fWaterHeight);
+	void RenderRefractionPass(GLfloat fWaterHeight);
+	static SVector4Df CalculateClipPlane(const SVector3Df& v3Normal, const SVector3Df& v3Point);
+
 	// Textures Splatting
 	void TexturesetBindlessSetup();
 	void TexturesetBindlessUpdate();
@@ -100,12 +199,24 @@ public:
 	bool SaveSettingsFile(const std::string& stMapName);
 	bool SaveTerrains();
 	bool SaveAreas();
+	// Writes terrain.chunk for the terrains of the map still in the json and raw format
+	bool ConvertTerrainFiles();
 
 	// Ray Intersection Part
 	bool GetPickingCoordinate(SVector3Df* v3IntersectPt, GLint* iCellX, GLint* iCellZ, GLint* iSubCellX, GLint* iSubCellZ, GLint* iTerrainNumX, GLint* iTerrainNumZ);
 	bool GetPickingCoordinateWithRay(const CRay& rRay, SVector3Df* v3IntersectPt, GLint* iCellX, GLint* iCellZ, GLint* iSubCellX, GLint* iSubCellZ, GLint* iTerrainNumX, GLint* iTerrainNumZ);
 	void ConvertToMapCoordindates(GLfloat fX, GLfloat fZ, GLint* iCellX, GLint* iCellZ, GLint* iSubCellX, GLint* iSubCellZ, GLint* iTerrainNumX, GLint* iTerrainNumZ);
 
+	// Exact hit against the rendered terrain triangles, *pfHitT is on [0, 1] from v3Start to v3End
+	bool IntersectRayWithTerrains(const SVector3Df& v3Start, const SVector3Df& v3End, GLfloat* pfHitT);
+	// Two-sided Moller-Trumbore, *pfT is in units of v3Dir
+	static bool IntersectRayWithTriangle(const SVector3Df& v3Origin, const SVector3Df& v3Dir, const SVector3Df& v3A, const SVector3Df& v3B, const SVector3Df& v3C, GLfloat* pfT);
+	// Closest area object over the loaded areas, see CTerrainAreaData::PickObject
+	CPhysicsObject* PickObject(const CRay& rRay, GLfloat* pfDistance);
+protected:
+	bool IntersectRayWithPatch(CTerrain* pTerrain, GLint iPatchNumX, GLint iPatchNumZ, const SVector3Df& v3Origin, const SVector3Df& v3Dir, GLfloat fTEnter, GLfloat fTExit, GLfloat* pfHitT);
+public:
+
 	void DrawHeightBrush(GLbyte bBrushShape, GLbyte bBrushType, GLint iTerrainNumX, GLint iTerrainNumZ, GLint iCellX, GLint iCellZ, GLint iBrushSize, GLint iBrushStrength);
 	void DrawTextureBrush(GLbyte bBrushShape, GLint iTerrainNumX, GLint iTerrainNumZ, GLint iCellX, GLint iCellZ, GLint iSubCellX, GLint iSubCellZ, GLint iBrushSize, GLint iBrushStrength, GLint iSelectedTextureIndex);
 	void DrawAttributeBrush(GLbyte bBrushShape, GLubyte ubAttrType, GLint iTerrainNumX, GLint iTerrainNumZ, GLint iCellX, GLint iCellZ, GLint iSubCellX, GLint iSubCellZ, GLint iBrushSize, GLint iBrushStrength, bool bEraseAttr);
@@ -123,6 +234,13 @@ public:
 
 	void ReloadTextures();
 
+	// Brush strokes history, each Draw*Brush call is one step
+	bool UndoEdit();
+	bool RedoEdit();
+	bool CanUndoEdit() const;
+	bool CanRedoEdit() const;
+	CTerrainHistory& GetEditHistory();
+
 protected:
 	// Map Variables
 	std::string m_strMapName;
@@ -148,13 +266,26 @@ protected:
 	CTerrainTextureset m_TerrainTextureset;
 
 	// Terrains Vector to track only, no "NEW" allocations
+	// One slot per terrain (z * m_iTerrainCountX + x), nullptr when not resident
 	std::vector<CTerrain*> m_vLoadedTerrains;
 	std::vector<CTerrainAreaData*> m_vLoadedAreas;
 
 	// Player Coordinates
 	SVector3Df m_v3Player;
 
-	// Number of loaded terrains
+	// Terrains handed to the loader, same slots as m_vLoadedTerrains
+	std::vector<CTerrain*> m_vPendingTerrains;
+	CTerrainLoader m_TerrainLoader;
+	GLfloat m_fUploadBudgetMs;
+	GLuint m_uiTerrainUploads;
+	bool m_bGLState;	// Resident terrains get their GL objects and areas
+
+	// Streaming ring, in terrains around the player terrain
+	GLint m_iTerrainLoadSize;
+	GLint m_iPlayerTerrainX;
+	GLint m_iPlayerTerrainZ;
+
+	// Number of loaded terrains (including the ones still loading)
 	GLint m_iNumTerrains;
 	GLint m_iNumAreas;
 
@@ -163,11 +294,18 @@ protected:
 	size_t m_sUploadedTextureCount; // Track New Textures
 	size_t m_sAllocatedSSBOSlots; // Track New Textures
 
+	CRingBuffer m_InstanceRingBuffer;
+
 	// Brushes Data
 	GLint m_iBrushStrength;
 	GLint m_iBrushMaxStrength;
 	GLint m_iBrushSize;
 	GLint m_iBrushMaxSize;
+	CTerrainHistory m_EditHistory;
+
+	// Water planes of the current frame
+	std::vector<GLfloat> m_vWaterHeights;
+	std::vector<GLfloat> m_vWaterPlanes;
 
 	// Water Data
 	CTexture* m_pWaterDudvTex;
@@ -1,6 +1,8 @@
 #include "Stdafx.h"
 #include "TerrainMap.h"
 #include "TerrainAreaData.h"
+#include "TerrainChunk.h"
+#include <filesystem>
 
 // A Getters & Setters!
 void CTerrainMap::SetMapReady(bool bReady)
@@ -54,7 +56,7 @@ void CTerrainMap::GetBasePosXZ(GLint* piBaseX, GLint* piBaseZ)
 
 bool CTerrainMap::GetAreaPtr(GLint iAreaNum, CTerrainAreaData** ppAreaData)
 {
-	if (iAreaNum > m_vLoadedAreas.size())
+	if (iAreaNum < 0 || iAreaNum >= static_cast<GLint>(m_vLoadedAreas.size()))
 	{
 		*ppAreaData = nullptr;
 		return (false);
@@ -72,7 +74,7 @@ bool CTerrainMap::GetAreaPtr(GLint iAreaNum, CTerrainAreaData** ppAreaData)
 
 bool CTerrainMap::GetTerrainPtr(GLint iTerrainNum, CTerrain** ppTerrain)
 {
-	if (iTerrainNum > m_vLoadedTerrains.size())
+	if (iTerrainNum < 0 || iTerrainNum >= static_cast<GLint>(m_vLoadedTerrains.size()))
 	{
 		*ppTerrain = nullptr;
 		return (false);
@@ -170,6 +172,91 @@ GLfloat CTerrainMap::GetHeight(GLfloat fX, GLfloat fZ)
 	return (fTerrainHeight);
 }
 
+void CTerrainMap::GetHeights(const GLfloat* pfXs, const GLfloat* pfZs, GLfloat* pfHeights, size_t sCount)
+{
+	GetHeights(pfXs, pfZs, pfHeights, nullptr, sCount);
+}
+
+/*
+ * GetHeights - GetHeight of many points, one CTerrain::GetHeights call per terrain.
+ *
+ * The points are bucketed by terrain with a counting sort, so each terrain
+ * pointer is looked up once and its points are interpolated together. The
+ * buckets are local, several threads may query the same map.
+ *
+ * @pfXs, @pfZs: World coordinates of the points.
+ * @pfHeights: Receives the heights, the same values as GetHeight.
+ * @pv3Normals: Receives the surface normals, or nullptr.
+ * @sCount: Number of points.
+ */
+void CTerrainMap::GetHeights(const GLfloat* pfXs, const GLfloat* pfZs, GLfloat* pfHeights, SVector3Df* pv3Normals, size_t sCount)
+{
+	const size_t sTerrains = m_vLoadedTerrains.size();
+	const GLfloat fMapSizeX = static_cast<GLfloat>(m_iTerrainCountX * TERRAIN_XSIZE);
+	const GLfloat fMapSizeZ = static_cast<GLfloat>(m_iTerrainCountZ * TERRAIN_ZSIZE);
+	const GLfloat fTerrainXSize = TERRAIN_XSIZE;
+	const GLfloat fTerrainZSize = TERRAIN_XSIZE;
+
+	std::vector<GLint> vPointTerrains(sCount);
+	std::vector<GLuint> vBucketStarts(sTerrains + 1, 0);
+
+	for (size_t sPoint = 0; sPoint < sCount; ++sPoint)
+	{
+		const GLfloat fX = pfXs[sPoint];
+		const GLfloat fZ = pfZs[sPoint];
+
+		// Same rejections as GetHeight, in the same order
+		const bool bOnMap = !(fX < 0.0f || fZ < 0.0f || fX >= fMapSizeX || fZ >= fMapSizeZ);
+
+		GLint iTerrainNum = -1;
+		if (!bOnMap || !GetTerrainNumByCoord(static_cast<GLint>(fX / fTerrainXSize), static_cast<GLint>(fZ / fTerrainZSize), &iTerrainNum))
+		{
+			iTerrainNum = -1;
+		}
+
+		vPointTerrains[sPoint] = iTerrainNum;
+
+		if (iTerrainNum < 0)
+		{
+			pfHeights[sPoint] = 0.0f;
+			if (pv3Normals)
+			{
+				pv3Normals[sPoint] = SVector3Df(0.0f, 1.0f, 0.0f);
+			}
+			continue;
+		}
+
+		++vBucketStarts[iTerrainNum + 1];
+	}
+
+	for (size_t sTerrain = 0; sTerrain < sTerrains; ++sTerrain)
+	{
+		vBucketStarts[sTerrain + 1] += vBucketStarts[sTerrain];
+	}
+
+	std::vector<GLuint> vBucketFill(vBucketStarts.begin(), vBucketStarts.end() - 1);
+	std::vector<GLuint> vBucketPoints(vBucketStarts[sTerrains]);
+
+	for (size_t sPoint = 0; sPoint < sCount; ++sPoint)
+	{
+		if (vPointTerrains[sPoint] >= 0)
+		{
+			vBucketPoints[vBucketFill[vPointTerrains[sPoint]]++] = static_cast<GLuint>(sPoint);
+		}
+	}
+
+	for (size_t sTerrain = 0; sTerrain < sTerrains; ++sTerrain)
+	{
+		const GLuint uiBegin = vBucketStarts[sTerrain];
+		const GLuint uiEnd = vBucketStarts[sTerrain + 1];
+
+		if (uiBegin < uiEnd)
+		{
+			m_vLoadedTerrains[sTerrain]->GetHeights(pfXs, pfZs, vBucketPoints.data() + uiBegin, uiEnd - uiBegin, pfHeights, pv3Normals);
+		}
+	}
+}
+
 GLfloat CTerrainMap::GetWaterHeight(GLfloat fX, GLfloat fZ)
 {
 	GLint iX = static_cast<GLint>(fX);
@@ -298,6 +385,11 @@ CFrameBuffer& CTerrainMap::GetRefractionFBORef()
 	return (*m_pRefractionFBO);
 }
 
+CRingBuffer& CTerrainMap::GetInstanceRingBuffer()
+{
+	return (m_InstanceRingBuffer);
+}
+
 bool CTerrainMap::CreateTexturesetFile(const std::string& stMapName)
 {
 	std::string stTextureSetFile = stMapName + "\\textureset.json";
@@ -444,7 +536,7 @@ bool CTerrainMap::SaveSettingsFile(const std::string& stMapName)
 
 bool CTerrainMap::SaveTerrains()
 {
-	for (GLbyte i = 0; i < m_vLoadedTerrains.size(); i++)
+	for (GLint i = 0; i < static_cast<GLint>(m_vLoadedTerrains.size()); i++)
 	{
 		CTerrain* pTerrain = nullptr;
 		if (!GetTerrainPtr(i, (CTerrain**)&pTerrain))
@@ -452,51 +544,57 @@ bool CTerrainMap::SaveTerrains()
 			continue;
 		}
 
-		GLint iCoordX, iCoordZ;
-		pTerrain->GetTerrainCoords(&iCoordX, &iCoordZ);
-
-		// Save Property of the terrain
-		if (!pTerrain->SaveTerrainProperties(m_strMapName))
+		// Properties and every map of the terrain go to its chunk
+		if (!pTerrain->SaveChunk(m_strMapName))
 		{
-			sys_err("CTerrainMap::SaveTerrains: Failed to Save Terrain Property File");
+			sys_err("CTerrainMap::SaveTerrains: Failed to Save Terrain Chunk");
 			return (false);
 		}
+	}
+	return (true);
+}
 
-		// Save HeightMap of the terrain
-		if (!pTerrain->SaveHeightMap(m_strMapName))
-		{
-			sys_err("CTerrainMapOutdoor::SaveTerrains: Failed to Save Terrain HeightMap");
-			return (false);
-		}
+/*
+ * ConvertTerrainFiles - Writes a chunk for every terrain still stored as json and raw files.
+ *
+ * Only terrains without a chunk are converted, resident terrains are saved
+ * by SaveTerrains. The legacy files are left in place.
+ */
+bool CTerrainMap::ConvertTerrainFiles()
+{
+	GLint iConverted = 0;
 
-		// Save AttributeMap of the terrain
-		if (!pTerrain->SaveAttributeMap(m_strMapName))
+	for (GLint iTerrainCoordZ = 0; iTerrainCoordZ < m_iTerrainCountZ; iTerrainCoordZ++)
+	{
+		for (GLint iTerrainCoordX = 0; iTerrainCoordX < m_iTerrainCountX; iTerrainCoordX++)
 		{
-			sys_err("CTerrainMapOutdoor::SaveTerrains: Failed to Save Terrain AttributeMap");
-			return (false);
-		}
+			if (std::filesystem::exists(CTerrainChunk::GetFileName(m_strMapName, iTerrainCoordX, iTerrainCoordZ)))
+			{
+				continue;
+			}
 
-		// Save SplatMap of the terrain
-		if (!pTerrain->SaveSplatMap(m_strMapName))
-		{
-			sys_err("CTerrainMapOutdoor::SaveTerrains: Failed to Save Terrain SplatMaps");
-			return (false);
-		}
+			CTerrain* pTerrain = new CTerrain;
+			pTerrain->SetTerrainCoords(iTerrainCoordX, iTerrainCoordZ);
 
-		// Save WaterMap of the terrain
-		if (!pTerrain->SaveWaterMap(m_strMapName))
-		{
-			sys_err("CTerrainMapOutdoor::SaveTerrains: Failed to Save Terrain WaterMap");
-			return (false);
-		}
+			if (!pTerrain->LoadLegacyFiles(m_strMapName) || !pTerrain->SaveChunk(m_strMapName))
+			{
+				sys_err("CTerrainMap::ConvertTerrainFiles: Failed to Convert Terrain (%d, %d) of Map: %s", iTerrainCoordX, iTerrainCoordZ, m_strMapName.c_str());
+				safe_delete(pTerrain);
+				return (false);
+			}
 
+			safe_delete(pTerrain);
+			iConverted++;
+		}
 	}
+
+	sys_log("CTerrainMap::ConvertTerrainFiles: Converted %d terrains of Map: %s", iConverted, m_strMapName.c_str());
 	return (true);
 }
 
 bool CTerrainMap::SaveAreas()
 {
-	for (GLbyte i = 0; i < m_vLoadedAreas.size(); i++)
+	for (GLint i = 0; i < static_cast<GLint>(m_vLoadedAreas.size()); i++)
 	{
 		CTerrainAreaData* pArea = nullptr;
 		if (!GetAreaPtr(i, &pArea))
@@ -518,6 +616,32 @@ bool CTerrainMap::SaveAreas()
 	return (true);
 }
 
+CPhysicsObject* CTerrainMap::PickObject(const CRay& rRay, GLfloat* pfDistance)
+{
+	CPhysicsObject* pClosestObject = nullptr;
+	*pfDistance = FLT_MAX;
+
+	for (GLint i = 0; i < static_cast<GLint>(m_vLoadedAreas.size()); i++)
+	{
+		CTerrainAreaData* pArea = nullptr;
+		if (!GetAreaPtr(i, &pArea))
+		{
+			continue;
+		}
+
+		GLfloat fDistance = FLT_MAX;
+		CPhysicsObject* pObject = pArea->PickObject(rRay, &fDistance);
+
+		if (pObject && fDistance < *pfDistance)
+		{
+			*pfDistance = fDistance;
+			pClosestObject = pObject;
+		}
+	}
+
+	return (pClosestObject);
+}
+
 bool CTerrainMap::GetPickingCoordinate(SVector3Df* v3IntersectPt, GLint* iCellX, GLint* iCellZ, GLint* iSubCellX, GLint* iSubCellZ, GLint* iTerrainNumX, GLint* iTerrainNumZ)
 {
 	return GetPickingCoordinateWithRay(ms_Ray, v3IntersectPt, iCellX, iCellZ, iSubCellX, iSubCellZ, iTerrainNumX, iTerrainNumZ);
@@ -525,48 +649,244 @@ bool CTerrainMap::GetPickingCoordinate(SVector3Df* v3IntersectPt, GLint* iCellX,
 
 bool CTerrainMap::GetPickingCoordinateWithRay(const CRay& rRay, SVector3Df* v3IntersectPt, GLint* iCellX, GLint* iCellZ, GLint* iSubCellX, GLint* iSubCellZ, GLint* iTerrainNumX, GLint* iTerrainNumZ)
 {
-	CTerrain* pTerrain = nullptr;
-
 	SVector3Df v3Start, v3End, v3CursorPos;
 
 	rRay.GetStartPoint(&v3Start);
 	rRay.GetEndPoint(&v3End);
 
-	GLfloat fAdd = 1.0f / static_cast<GLfloat>(TERRAIN_XSIZE);
+	GLfloat fHitT = 0.0f;
+	if (!IntersectRayWithTerrains(v3Start, v3End, &fHitT))
+	{
+		return (false);
+	}
+
+	Vec3Lerp(v3CursorPos, v3Start, v3End, fHitT);
+
+	ConvertToMapCoordindates(v3CursorPos.x, v3CursorPos.z, iCellX, iCellZ, iSubCellX, iSubCellZ, iTerrainNumX, iTerrainNumZ);
+	*v3IntersectPt = v3CursorPos;
+	return (true);
+}
+
+/*
+ * IntersectRayWithTerrains - First hit of a segment with the terrain surface.
+ * @v3Start: Segment start, world space.
+ * @v3End: Segment end, world space.
+ * @pfHitT: Receives the hit position on [0, 1] along the segment.
+ *
+ * Two levels of 2D DDA: the segment walks the patch grid of the whole map
+ * and skips any patch whose height range it passes over or under, then
+ * walks the heightmap cells of the remaining patches and tests the two
+ * triangles of each cell. The first cell with a hit holds the nearest hit.
+ * Terrains that are not resident or not ready are treated as empty.
+ */
+bool CTerrainMap::IntersectRayWithTerrains(const SVector3Df& v3Start, const SVector3Df& v3End, GLfloat* pfHitT)
+{
+	const SVector3Df v3Dir = v3End - v3Start;
+
+	const GLfloat fMapXSize = static_cast<GLfloat>(m_iTerrainCountX * TERRAIN_XSIZE);
+	const GLfloat fMapZSize = static_cast<GLfloat>(m_iTerrainCountZ * TERRAIN_ZSIZE);
+
+	// Clip the segment to the map rectangle
+	GLfloat fTMin = 0.0f;
+	GLfloat fTMax = 1.0f;
+
+	const GLfloat fOrigins[2] = { v3Start.x, v3Start.z };
+	const GLfloat fDirs[2] = { v3Dir.x, v3Dir.z };
+	const GLfloat fSizes[2] = { fMapXSize, fMapZSize };
+
+	for (GLint iAxis = 0; iAxis < 2; iAxis++)
+	{
+		if (fDirs[iAxis] == 0.0f)
+		{
+			if (fOrigins[iAxis] < 0.0f || fOrigins[iAxis] > fSizes[iAxis])
+			{
+				return (false);
+			}
+			continue;
+		}
+
+		GLfloat fT0 = (0.0f - fOrigins[iAxis]) / fDirs[iAxis];
+		GLfloat fT1 = (fSizes[iAxis] - fOrigins[iAxis]) / fDirs[iAxis];
+		if (fT0 > fT1)
+		{
+			std::swap(fT0, fT1);
+		}
+
+		fTMin = MyMath::fmax(fTMin, fT0);
+		fTMax = MyMath::fmin(fTMax, fT1);
+	}
+
+	if (fTMin >= fTMax)
+	{
+		return (false);
+	}
+
+	const GLfloat fPatchXSizeMeters = static_cast<GLfloat>(PATCH_XSIZE * CELL_SCALE_METER);
+	const GLint iMapPatchesX = m_iTerrainCountX * PATCH_XCOUNT;
+	const GLint iMapPatchesZ = m_iTerrainCountZ * PATCH_ZCOUNT;
 
-	GLfloat fT = 0.0f;
+	TGridWalk2D patchWalk;
+	patchWalk.Begin(v3Start, v3Dir, fTMin, fPatchXSizeMeters, 0, iMapPatchesX - 1, 0, iMapPatchesZ - 1);
 
-	while (fT < 1.0f)
+	GLfloat fTEnter = fTMin;
+	while (fTEnter < fTMax)
 	{
-		Vec3Lerp(v3CursorPos, v3Start, v3End, fT);
+		const GLfloat fTExit = MyMath::fmin(patchWalk.GetExitT(), fTMax);
+
 		GLint iTerrainNum;
-		GLfloat fMultiplier = 1.0f;
+		CTerrain* pTerrain = nullptr;
+		if (GetTerrainNumByCoord(patchWalk.iX / PATCH_XCOUNT, patchWalk.iZ / PATCH_ZCOUNT, &iTerrainNum) &&
+			GetTerrainPtr(iTerrainNum, &pTerrain) && pTerrain->IsReady())
+		{
+			if (IntersectRayWithPatch(pTerrain, patchWalk.iX % PATCH_XCOUNT, patchWalk.iZ % PATCH_ZCOUNT, v3Start, v3Dir, fTEnter, fTExit, pfHitT))
+			{
+				return (true);
+			}
+		}
 
-		if (GetTerrainNum(v3CursorPos.x, v3CursorPos.z, &iTerrainNum))
+		fTEnter = fTExit;
+		patchWalk.Step();
+
+		if (patchWalk.iX < 0 || patchWalk.iZ < 0 || patchWalk.iX >= iMapPatchesX || patchWalk.iZ >= iMapPatchesZ)
 		{
-			if (GetTerrainPtr(iTerrainNum, &pTerrain))
+			break;
+		}
+	}
+
+	return (false);
+}
+
+bool CTerrainMap::IntersectRayWithPatch(CTerrain* pTerrain, GLint iPatchNumX, GLint iPatchNumZ, const SVector3Df& v3Origin, const SVector3Df& v3Dir, GLfloat fTEnter, GLfloat fTExit, GLfloat* pfHitT)
+{
+	// Patch level: the patch box Y covers every vertex (and water) of the patch
+	const TBoundingBox patchBox = pTerrain->GetTerrainPatchPtr(iPatchNumX, iPatchNumZ)->GetBoundingBox();
+
+	GLfloat fRayY0 = v3Origin.y + v3Dir.y * fTEnter;
+	GLfloat fRayY1 = v3Origin.y + v3Dir.y * fTExit;
+	if (MyMath::fmin(fRayY0, fRayY1) > patchBox.v3Max.y + PICKING_HEIGHT_EPSILON || MyMath::fmax(fRayY0, fRayY1) < patchBox.v3Min.y - PICKING_HEIGHT_EPSILON)
+	{
+		return (false);
+	}
+
+	GLint iTerrainCoordX, iTerrainCoordZ;
+	pTerrain->GetTerrainCoords(&iTerrainCoordX, &iTerrainCoordZ);
+
+	const GLfloat fCellSize = static_cast<GLfloat>(CELL_SCALE_METER);
+	const GLint iTerrainCellX = iTerrainCoordX * XSIZE;
+	const GLint iTerrainCellZ = iTerrainCoordZ * ZSIZE;
+
+	// Map wide cell range of this patch
+	const GLint iMinCellX = iTerrainCellX + iPatchNumX * PATCH_XSIZE;
+	const GLint iMinCellZ = iTerrainCellZ + iPatchNumZ * PATCH_ZSIZE;
+	const GLint iMaxCellX = iMinCellX + PATCH_XSIZE - 1;
+	const GLint iMaxCellZ = iMinCellZ + PATCH_ZSIZE - 1;
+
+	TGridWalk2D cellWalk;
+	cellWalk.Begin(v3Origin, v3Dir, fTEnter, fCellSize, iMinCellX, iMaxCellX, iMinCellZ, iMaxCellZ);
+
+	GLfloat fCellTEnter = fTEnter;
+	while (fCellTEnter < fTExit)
+	{
+		const GLfloat fCellTExit = MyMath::fmin(cellWalk.GetExitT(), fTExit);
+
+		const GLint iX = cellWalk.iX - iTerrainCellX;
+		const GLint iZ = cellWalk.iZ - iTerrainCellZ;
+
+		const GLfloat fH00 = pTerrain->GetHeightMapValue(iX, iZ);
+		const GLfloat fH10 = pTerrain->GetHeightMapValue(iX + 1, iZ);
+		const GLfloat fH01 = pTerrain->GetHeightMapValue(iX, iZ + 1);
+		const GLfloat fH11 = pTerrain->GetHeightMapValue(iX + 1, iZ + 1);
+
+		// Cell level: skip when the segment passes over or under the 4 corners
+		fRayY0 = v3Origin.y + v3Dir.y * fCellTEnter;
+		fRayY1 = v3Origin.y + v3Dir.y * fCellTExit;
+
+		const GLfloat fCellMinY = MyMath::fmin(MyMath::fmin(fH00, fH10), MyMath::fmin(fH01, fH11));
+		const GLfloat fCellMaxY = MyMath::fmax(MyMath::fmax(fH00, fH10), MyMath::fmax(fH01, fH11));
+
+		if (MyMath::fmin(fRayY0, fRayY1) <= fCellMaxY + PICKING_HEIGHT_EPSILON && MyMath::fmax(fRayY0, fRayY1) >= fCellMinY - PICKING_HEIGHT_EPSILON)
+		{
+			const GLfloat fX0 = static_cast<GLfloat>(cellWalk.iX) * fCellSize;
+			const GLfloat fZ0 = static_cast<GLfloat>(cellWalk.iZ) * fCellSize;
+			const GLfloat fX1 = fX0 + fCellSize;
+			const GLfloat fZ1 = fZ0 + fCellSize;
+
+			// Same split as CTerrainVAO::BuildPatchIndices (top right to bottom left)
+			const SVector3Df v3TopLeft(fX0, fH00, fZ0);
+			const SVector3Df v3TopRight(fX1, fH10, fZ0);
+			const SVector3Df v3BottomLeft(fX0, fH01, fZ1);
+			const SVector3Df v3BottomRight(fX1, fH11, fZ1);
+
+			GLfloat fBestT = FLT_MAX;
+			GLfloat fT = 0.0f;
+
+			if (IntersectRayWithTriangle(v3Origin, v3Dir, v3TopLeft, v3BottomLeft, v3TopRight, &fT) && fT >= 0.0f && fT <= 1.0f)
+			{
+				fBestT = fT;
+			}
+
+			if (IntersectRayWithTriangle(v3Origin, v3Dir, v3TopRight, v3BottomLeft, v3BottomRight, &fT) && fT >= 0.0f && fT <= 1.0f)
 			{
-				GLfloat fMapHeight = pTerrain->GetHeight(v3CursorPos.x, std::fabs(v3CursorPos.z));
-				if (fMapHeight >= v3CursorPos.y)
-				{
-					ConvertToMapCoordindates(v3CursorPos.x, v3CursorPos.z, iCellX, iCellZ, iSubCellX, iSubCellZ, iTerrainNumX, iTerrainNumZ);
-					*v3IntersectPt = v3CursorPos;
-					return (true);
-				}
-				else
-				{
-					fMultiplier = MyMath::fmax(1.0f, 0.01f * (v3CursorPos.y - fMapHeight));
-				}
+				fBestT = MyMath::fmin(fBestT, fT);
+			}
 
+			if (fBestT != FLT_MAX)
+			{
+				*pfHitT = fBestT;
+				return (true);
 			}
 		}
 
-		fT += fAdd * fMultiplier;
+		fCellTEnter = fCellTExit;
+		cellWalk.Step();
+
+		if (cellWalk.iX < iMinCellX || cellWalk.iZ < iMinCellZ || cellWalk.iX > iMaxCellX || cellWalk.iZ > iMaxCellZ)
+		{
+			break;
+		}
 	}
 
 	return (false);
 }
 
+bool CTerrainMap::IntersectRayWithTriangle(const SVector3Df& v3Origin, const SVector3Df& v3Dir, const SVector3Df& v3A, const SVector3Df& v3B, const SVector3Df& v3C, GLfloat* pfT)
+{
+	const GLfloat fEpsilon = 1e-8f;
+	// Barycentric slack, a hit on the edge shared by two cells must not fall between them
+	const GLfloat fEdgeEpsilon = 1e-5f;
+
+	const SVector3Df v3EdgeAB = v3B - v3A;
+	const SVector3Df v3EdgeAC = v3C - v3A;
+
+	const SVector3Df v3P = v3Dir.cross(v3EdgeAC);
+	const GLfloat fDet = v3EdgeAB.dot(v3P);
+
+	// Ray parallel to the triangle plane
+	if (std::fabs(fDet) < fEpsilon)
+	{
+		return (false);
+	}
+
+	const GLfloat fInvDet = 1.0f / fDet;
+	const SVector3Df v3S = v3Origin - v3A;
+
+	const GLfloat fU = v3S.dot(v3P) * fInvDet;
+	if (fU < -fEdgeEpsilon || fU > 1.0f + fEdgeEpsilon)
+	{
+		return (false);
+	}
+
+	const SVector3Df v3Q = v3S.cross(v3EdgeAB);
+	const GLfloat fV = v3Dir.dot(v3Q) * fInvDet;
+	if (fV < -fEdgeEpsilon || fU + fV > 1.0f + fEdgeEpsilon)
+	{
+		return (false);
+	}
+
+	*pfT = v3EdgeAC.dot(v3Q) * fInvDet;
+	return (true);
+}
+
 void CTerrainMap::ConvertToMapCoordindates(GLfloat fX, GLfloat fZ, GLint* iCellX, GLint* iCellZ, GLint* iSubCellX, GLint* iSubCellZ, GLint* iTerrainNumX, GLint* iTerrainNumZ)
 {
 	GLfloat fTerrainXSize = TERRAIN_XSIZE;
@@ -636,6 +956,9 @@ void CTerrainMap::DrawHeightBrush(GLbyte bBrushShape, GLbyte bBrushType, GLint i
 		return;
 	}
 
+	// Copies what the brush may write, here and in the neighbours it reaches
+	m_EditHistory.BeginStroke(this, TERRAIN_HISTORY_BRUSH_HEIGHT, iTerrainNumX, iTerrainNumZ, iCellX, iCellZ, iBrushSize);
+
 	CTerrain* pMapTerrain = nullptr;
 
 	if (iCellZ < iBrushSize)
@@ -800,6 +1123,8 @@ void CTerrainMap::DrawHeightBrush(GLbyte bBrushShape, GLbyte bBrushType, GLint i
 			}
 		}
 	}
+
+	m_EditHistory.EndStroke();
 }
 
 
@@ -818,6 +1143,8 @@ void CTerrainMap::DrawTextureBrush(GLbyte bBrushShape, GLint iTerrainNumX, GLint
 		return;
 	}
 
+	m_EditHistory.BeginStroke(this, TERRAIN_HISTORY_BRUSH_TEXTURE, iTerrainNumX, iTerrainNumZ, iCellX, iCellZ, iBrushSize);
+
 	CTerrain* pMapTerrain = nullptr;
 
 	if (iCellZ < iBrushSize)
@@ -982,6 +1309,8 @@ void CTerrainMap::DrawTextureBrush(GLbyte bBrushShape, GLint iTerrainNumX, GLint
 			}
 		}
 	}
+
+	m_EditHistory.EndStroke();
 }
 
 void CTerrainMap::DrawAttributeBrush(GLbyte bBrushShape, GLubyte ubAttrType, GLint iTerrainNumX, GLint iTerrainNumZ, GLint iCellX, GLint iCellZ, GLint iSubCellX, GLint iSubCellZ, GLint iBrushSize, GLint iBrushStrength, bool bEraseAttr)
@@ -999,6 +1328,8 @@ void CTerrainMap::DrawAttributeBrush(GLbyte bBrushShape, GLubyte ubAttrType, GLi
 		return;
 	}
 
+	m_EditHistory.BeginStroke(this, TERRAIN_HISTORY_BRUSH_ATTR, iTerrainNumX, iTerrainNumZ, iCellX, iCellZ, iBrushSize);
+
 	CTerrain* pMapTerrain = nullptr;
 
 	if (iCellZ < iBrushSize)
@@ -1163,6 +1494,8 @@ void CTerrainMap::DrawAttributeBrush(GLbyte bBrushShape, GLubyte ubAttrType, GLi
 			}
 		}
 	}
+
+	m_EditHistory.EndStroke();
 }
 
 void CTerrainMap::DrawWaterBrush(GLbyte bBrushShape, GLint iTerrainNumX, GLint iTerrainNumZ, GLint iCellX, GLint iCellZ, GLint iSubCellX, GLint iSubCellZ, GLint iBrushSize, GLint iBrushStrength, GLfloat fWaterHeight, bool bEraseWater)
@@ -1180,6 +1513,8 @@ void CTerrainMap::DrawWaterBrush(GLbyte bBrushShape, GLint iTerrainNumX, GLint i
 		return;
 	}
 
+	m_EditHistory.BeginStroke(this, TERRAIN_HISTORY_BRUSH_WATER, iTerrainNumX, iTerrainNumZ, iCellX, iCellZ, iBrushSize);
+
 	CTerrain* pMapTerrain = nullptr;
 
 	if (iCellZ < iBrushSize)
@@ -1344,6 +1679,8 @@ void CTerrainMap::DrawWaterBrush(GLbyte bBrushShape, GLint iTerrainNumX, GLint i
 			}
 		}
 	}
+
+	m_EditHistory.EndStroke();
 }
 
 void CTerrainMap::SetBrushStrength(GLint iBrushStr)
@@ -1391,3 +1728,28 @@ void CTerrainMap::ReloadTextures()
 	m_TerrainTextureset.Reload();
 	TexturesetBindlessUpdate();
 }
+
+bool CTerrainMap::UndoEdit()
+{
+	return (m_EditHistory.Undo(this));
+}
+
+bool CTerrainMap::RedoEdit()
+{
+	return (m_EditHistory.Redo(this));
+}
+
+bool CTerrainMap::CanUndoEdit() const
+{
+	return (m_EditHistory.CanUndo());
+}
+
+bool CTerrainMap::CanRedoEdit() const
+{
+	return (m_EditHistory.CanRedo());
+}
+
+CTerrainHistory& CTerrainMap::GetEditHistory()
+{
+	return (m_EditHistory);
+}
@@ -3,39 +3,112 @@
 #include "Terrain.h"
 #include "ScopedTimer.h"
 #include <fstream>
-#include <mutex>
 #include "TerrainAreaData.h"
 #include "../../LibGame/source/ResourcesManager.h"
 
 #define USE_OPTIMIZED_TEXTURES_SETUP
 
-bool CTerrainMap::LoadMap(const SVector3Df& v3PlayerPos)
+bool CTerrainMap::LoadMap(const SVector3Df& v3PlayerPos, bool bGLState)
 {
 	Destroy();
+	m_bGLState = bGLState;
 
-	CTerrainVAO::Initialize();
-	CTerrainWaterVAO::Initialize();
+	if (m_bGLState)
+	{
+		CTerrainVAO::Initialize();
+		CTerrainWaterVAO::Initialize();
 
-	// SetMap Name First
-	InitializeMapShaders();
-	InitializeMapWaterData();
+		// SetMap Name First
+		InitializeMapShaders();
+		InitializeMapWaterData();
+	}
 
 	std::string strSettingsFile = GetMapDirectoy() + "\\map_settings.json";
-	if (!LoadSettings(strSettingsFile))
+	if (!LoadSettings(strSettingsFile, m_bGLState))
 	{
 		sys_err("CTerrainMap::LoadMap: Failed to Load Map %s Settings File", GetMapName().c_str());
 		return (false);
 	}
 
 	// Do it after Loading Settings to load textureset
-	TexturesetBindlessUpdate();
+	if (m_bGLState)
+	{
+		TexturesetBindlessUpdate();
+	}
 
-	// Update And Create Terrain
+	// Update And Create Terrain, the first ring is waited for so the map is complete once loaded
+	m_TerrainLoader.Start();
 	UpdateMap(v3PlayerPos);
+	FinishTerrainLoads();
 
 	return (true);
 }
 
+void CTerrainMap::FinishTerrainLoads()
+{
+	m_TerrainLoader.WaitIdle();
+	ProcessTerrainUploads(FLT_MAX);
+}
+
+/*
+ * LoadMapData - Builds the CPU side of every terrain of the map.
+ *
+ * Reads the settings without the textureset and loads each terrain on the
+ * calling thread, nothing is streamed and no shader, texture or buffer is
+ * created. Meant for tools running without a GL context.
+ */
+bool CTerrainMap::LoadMapData()
+{
+	Destroy();
+	m_bGLState = false;
+
+	std::string strSettingsFile = GetMapDirectoy() + "\\map_settings.json";
+	if (!LoadSettings(strSettingsFile, false))
+	{
+		sys_err("CTerrainMap::LoadMapData: Failed to Load Map %s Settings File", GetMapName().c_str());
+		return (false);
+	}
+
+	const size_t sTerrainSlots = static_cast<size_t>(m_iTerrainCountX) * m_iTerrainCountZ;
+	m_vLoadedTerrains.assign(sTerrainSlots, nullptr);
+	m_vPendingTerrains.assign(sTerrainSlots, nullptr);
+	m_vLoadedAreas.assign(sTerrainSlots, nullptr);
+
+	for (GLint iTerrainCoordZ = 0; iTerrainCoordZ < m_iTerrainCountZ; iTerrainCoordZ++)
+	{
+		for (GLint iTerrainCoordX = 0; iTerrainCoordX < m_iTerrainCountX; iTerrainCoordX++)
+		{
+			const GLint iTerrainNum = iTerrainCoordZ * m_iTerrainCountX + iTerrainCoordX;
+
+			CTerrain* pTerrain = CTerrain::New();
+			pTerrain->Clear();
+			pTerrain->SetTerrainMapOwner(this);
+			pTerrain->SetTerrainCoords(iTerrainCoordX, iTerrainCoordZ);
+			pTerrain->SetTerrainNumber(iTerrainNum);
+
+			TTerrainLoadRequest request{};
+			request.pTerrain = pTerrain;
+			request.stMapDirectory = GetMapDirectoy();
+			request.iTerrainCoordX = iTerrainCoordX;
+			request.iTerrainCoordZ = iTerrainCoordZ;
+			request.iTerrainNum = iTerrainNum;
+
+			if (!CTerrainLoader::LoadTerrainData(request))
+			{
+				sys_err("CTerrainMap::LoadMapData: Failed to Load Terrain (%d, %d)", iTerrainCoordX, iTerrainCoordZ);
+				CTerrain::Delete(pTerrain);
+				continue;
+			}
+
+			pTerrain->SetReady(true);
+			m_vLoadedTerrains[iTerrainNum] = pTerrain;
+			m_iNumTerrains++;
+		}
+	}
+
+	return (m_iNumTerrains > 0);
+}
+
 void CTerrainMap::InitializeMapShaders()
 {
 	if (!m_pMapShader)
@@ -102,7 +175,7 @@ void CTerrainMap::InitializeMapWaterData()
 	m_pRefractionFBO->Init(1024, 1024);
 }
 
-bool CTerrainMap::LoadSettings(const std::string& stSettingsFile)
+bool CTerrainMap::LoadSettings(const std::string& stSettingsFile, bool bLoadTextureset)
 {
 	// Open and read file
 	std::ifstream file(stSettingsFile);
@@ -170,6 +243,12 @@ bool CTerrainMap::LoadSettings(const std::string& stSettingsFile)
 	SetTerrainsCount(iMapSizeX, iMapSizeZ);
 	SetBasePosXZ(iBasePositionX, iBasePositionZ);
 
+	// The textureset creates GL textures
+	if (!bLoadTextureset)
+	{
+		return (true);
+	}
+
 	std::string stTexturesetPath = stTextureSet;
 	if (!m_TerrainTextureset.Load(stTexturesetPath))
 	{
@@ -181,117 +260,107 @@ bool CTerrainMap::LoadSettings(const std::string& stSettingsFile)
 	return (true);
 }
 
+// Hands a pooled terrain to the loader, it becomes visible in ProcessTerrainUploads
 bool CTerrainMap::LoadTerrain(GLint iTerrainCoordX, GLint iTerrainCoordZ, GLint iTerrainNum)
 {
-	ScopedTimer timer("CTerrainMap::LoadTerrain");
-	GLint iTerrainID = iTerrainCoordX * 1000 + iTerrainCoordZ;
-
-	char c_szTerrainData[256];
-	sprintf_s(c_szTerrainData, "%s\\%06d\\TerrainData.json", GetMapDirectoy().c_str(), iTerrainID);
-
-	// Open and read file
-	std::ifstream file(c_szTerrainData);
-	if (!file.is_open())
+	if (iTerrainNum < 0 || iTerrainNum >= static_cast<GLint>(m_vLoadedTerrains.size()))
 	{
-		sys_err("CTerrainMap::LoadTerrain: Failed to open Terrain Data File file: %s", c_szTerrainData);
+		sys_err("CTerrainMap::LoadTerrain: (%d, %d) Invalid Terrain Num %d", iTerrainCoordX, iTerrainCoordZ, iTerrainNum);
 		return (false);
 	}
 
-	// Parse JSON
-	json jsonData;
-
-	try
-	{
-		file >> jsonData;
-	}
-	catch (const json::parse_error& e)
-	{
-		// logger.error("JSON parse error: {}", e.what());
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) JSON parse error for File %s, error: %s", iTerrainCoordX, iTerrainCoordZ, c_szTerrainData, e.what());
-		return (false);
-	}
-
-	// a script type for safety? then that log should be deleted ...
-	if (!jsonData.contains("script_type"))
-	{
-		// logger.error("Invalid texture file format");
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) JSON parse error File %s, error: Failed to Load Script Type", iTerrainCoordX, iTerrainCoordZ, c_szTerrainData);
-		return (false);
-	}
-
-	if (!jsonData.contains("terrain_name"))
-	{
-		// logger.error("Invalid texture file format");
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) JSON parse error File %s, error: Failed to Load Terrain Name", iTerrainCoordX, iTerrainCoordZ, c_szTerrainData);
-		return (false);
-	}
-
-	const std::string& stScriptType = jsonData["script_type"].get<std::string>();
-	const std::string& stTerrainName = jsonData["terrain_name"].get<std::string>();
-
-	if (stScriptType != "TerrainProperties")
-	{
-		sys_err("CTerrainMap::LoadTerrain: Terrain Data FileFormat Error");
-		return false;
-	}
-
+	// Pool and GL calls stay on this thread, the worker gets a clean terrain
 	CTerrain* pTerrain = CTerrain::New();
 	pTerrain->Clear();
 	pTerrain->SetTerrainMapOwner(this);
 	pTerrain->SetTerrainCoords(iTerrainCoordX, iTerrainCoordZ);
 	pTerrain->SetTerrainNumber(iTerrainNum);
 
-	char szRawHeightMapFileName[64 + 1];
-	char szRawAttributeMapFileName[64 + 1];
-	char szRawSplatWeightMapFileName[64 + 1];
-	char szRawSplatIndexMapFileName[64 + 1];
-	char szRawWaterMapFileName[64 + 1];
+	TTerrainLoadRequest request{};
+	request.pTerrain = pTerrain;
+	request.stMapDirectory = GetMapDirectoy();
+	request.iTerrainCoordX = iTerrainCoordX;
+	request.iTerrainCoordZ = iTerrainCoordZ;
+	request.iTerrainNum = iTerrainNum;
+	request.bLoaded = false;
 
-	_snprintf_s(szRawHeightMapFileName, sizeof(szRawHeightMapFileName), "%s\\%06d\\height.raw", GetMapDirectoy().c_str(), iTerrainID);
-	_snprintf_s(szRawAttributeMapFileName, sizeof(szRawAttributeMapFileName), "%s\\%06d\\attr.raw", GetMapDirectoy().c_str(), iTerrainID);
-	_snprintf_s(szRawSplatWeightMapFileName, sizeof(szRawSplatWeightMapFileName), "%s\\%06d\\splat_weight.raw", GetMapDirectoy().c_str(), iTerrainID);
-	_snprintf_s(szRawSplatIndexMapFileName, sizeof(szRawSplatIndexMapFileName), "%s\\%06d\\splat_index.raw", GetMapDirectoy().c_str(), iTerrainID);
-	_snprintf_s(szRawWaterMapFileName, sizeof(szRawWaterMapFileName), "%s\\%06d\\water.raw", GetMapDirectoy().c_str(), iTerrainID);
+	m_vPendingTerrains[iTerrainNum] = pTerrain;
+	m_iNumTerrains++;
 
-	if (!pTerrain->LoadHeightMap(szRawHeightMapFileName))
-	{
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) Failed to Load HeightMap (%s)", iTerrainCoordX, iTerrainCoordZ, szRawHeightMapFileName);
-	}
-	if (!pTerrain->LoadAttributeMap(szRawAttributeMapFileName))
-	{
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) Failed to Load AttributeMap (%s)", iTerrainCoordX, iTerrainCoordZ, szRawAttributeMapFileName);
-	}
-	if (!pTerrain->LoadSplatMapWeight(szRawSplatWeightMapFileName))
-	{
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) Failed to Load SplatMap Weight (%s)", iTerrainCoordX, iTerrainCoordZ, szRawSplatWeightMapFileName);
-	}
-	if (!pTerrain->LoadSplatMapIndex(szRawSplatIndexMapFileName))
-	{
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) Failed to Load SplatMap Index (%s)", iTerrainCoordX, iTerrainCoordZ, szRawSplatIndexMapFileName);
-	}
-	if (!pTerrain->LoadWaterMap(szRawWaterMapFileName))
+	m_TerrainLoader.Request(request);
+	return (true);
+}
+
+/*
+ * ProcessTerrainUploads - Finishes the terrains built by the loader.
+ * @fBudgetMs: Time allowed for GL uploads in this call.
+ *
+ * Creates the GL objects of loaded terrains, publishes them in their slot and
+ * loads their area; a map loaded without GL state only publishes them. A
+ * terrain that failed to load goes back to the pool and gets no area. At
+ * least one terrain is processed per call so a small budget cannot stall
+ * streaming. Terrains unloaded while they were loading are given back to
+ * the pool here.
+ */
+void CTerrainMap::ProcessTerrainUploads(GLfloat fBudgetMs)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	TTerrainLoadRequest request;
+	while (m_TerrainLoader.PopLoaded(&request))
 	{
-		sys_err("CTerrainMap::LoadTerrain: (%d, %d) Failed to Load WaterMap (%s)", iTerrainCoordX, iTerrainCoordZ, szRawWaterMapFileName);
-	}
+		const GLint iTerrainNum = request.iTerrainNum;
+		CTerrain* pTerrain = request.pTerrain;
 
-	// Setup Base Texture (0)
-	pTerrain->SetupBaseTexture();
+		if (iTerrainNum < 0 || iTerrainNum >= static_cast<GLint>(m_vPendingTerrains.size()) || m_vPendingTerrains[iTerrainNum] != pTerrain)
+		{
+			CTerrain::Delete(pTerrain);
+			continue;
+		}
+
+		m_vPendingTerrains[iTerrainNum] = nullptr;
+
+		if (!request.bLoaded)
+		{
+			sys_err("CTerrainMap::ProcessTerrainUploads: Failed to Load Terrain (%d, %d)", request.iTerrainCoordX, request.iTerrainCoordZ);
+			CTerrain::Delete(pTerrain);
+			m_iNumTerrains--;
+		}
+		else
+		{
+			if (m_bGLState)
+			{
+				pTerrain->GenerateGLState();
+			}
 
-	pTerrain->SetName(stTerrainName);
-	pTerrain->CalculateTerrainPatches();
-	pTerrain->SetReady(true);
-	
-	static std::mutex mtx;
-	std::unique_lock<std::mutex> lock(mtx);
+			pTerrain->SetReady(true);
+			m_vLoadedTerrains[iTerrainNum] = pTerrain;
+			m_uiTerrainUploads++;
 
-	m_vLoadedTerrains.push_back(pTerrain);
+			// Areas hold models, without GL the terrains stream alone
+			if (m_bGLState && !IsAreaLoaded(request.iTerrainCoordX, request.iTerrainCoordZ))
+			{
+				LoadArea(request.iTerrainCoordX, request.iTerrainCoordZ, iTerrainNum);
+			}
+		}
 
-	return (true);
+		const std::chrono::duration<GLfloat, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= fBudgetMs)
+		{
+			break;
+		}
+	}
 }
 
 bool CTerrainMap::LoadArea(GLint iAreaCoordX, GLint iAreaCoordZ, GLint iAreaNum)
 {
 	ScopedTimer timer("CTerrainMap::LoadArea");
+	if (iAreaNum < 0 || iAreaNum >= static_cast<GLint>(m_vLoadedAreas.size()))
+	{
+		sys_err("CTerrainMap::LoadArea: (%d, %d) Invalid Area Num %d", iAreaCoordX, iAreaCoordZ, iAreaNum);
+		return (false);
+	}
+
 	GLint iAreaID = iAreaCoordX * 1000 + iAreaCoordZ;
 
 	char c_szAreaData[256];
@@ -305,45 +374,81 @@ bool CTerrainMap::LoadArea(GLint iAreaCoordX, GLint iAreaCoordZ, GLint iAreaNum)
 		sys_err("CTerrainMap::LoadArea: Failed to Load Area Objects from File for Area (%d, %d)", iAreaCoordX, iAreaCoordZ);
 	}
 
-	m_vLoadedAreas.push_back(pArea);
+	m_vLoadedAreas[iAreaNum] = pArea;
+	m_iNumAreas++;
 
 	return (true);
 }
 
-// Check if given terrain X - Z is Loaded
+// Check if given terrain X - Z is Loaded (or being loaded)
 bool CTerrainMap::IsTerrainLoaded(GLint iTerrainCoordX, GLint iTerrainCoordZ)
 {
-	for (size_t i = 0; i < m_vLoadedTerrains.size(); i++)
+	if (iTerrainCoordX < 0 || iTerrainCoordZ < 0 || iTerrainCoordX >= m_iTerrainCountX || iTerrainCoordZ >= m_iTerrainCountZ)
 	{
-		CTerrain* pTerrain = m_vLoadedTerrains[i];
-		GLint iCoordX, iCoordZ;
-		pTerrain->GetTerrainCoords(&iCoordX, &iCoordZ);
+		return (false);
+	}
 
-		if (iTerrainCoordX == iCoordX && iTerrainCoordZ == iCoordZ)
-		{
-			return (true);
-		}
+	const GLint iTerrainNum = iTerrainCoordZ * m_iTerrainCountX + iTerrainCoordX;
+	if (iTerrainNum < static_cast<GLint>(m_vPendingTerrains.size()) && m_vPendingTerrains[iTerrainNum])
+	{
+		return (true);
 	}
 
-	return false;
+	CTerrain* pTerrain = nullptr;
+	return (GetTerrainPtr(iTerrainNum, &pTerrain));
 }
 
 // Check if given area X - Z is Loaded
 bool CTerrainMap::IsAreaLoaded(GLint iAreaCoordX, GLint iAreaCoordZ)
 {
-	for (size_t i = 0; i < m_vLoadedAreas.size(); i++)
+	if (iAreaCoordX < 0 || iAreaCoordZ < 0 || iAreaCoordX >= m_iTerrainCountX || iAreaCoordZ >= m_iTerrainCountZ)
 	{
-		CTerrainAreaData* pArea = m_vLoadedAreas[i];
-		GLint iCoordX, iCoordZ;
-		pArea->GetAreaCoords(&iCoordX, &iCoordZ);
+		return (false);
+	}
 
-		if (iAreaCoordX == iCoordX && iAreaCoordZ == iCoordZ)
-		{
-			return (true);
-		}
+	CTerrainAreaData* pArea = nullptr;
+	return (GetAreaPtr(iAreaCoordZ * m_iTerrainCountX + iAreaCoordX, &pArea));
+}
+
+// Give the terrain back to the pool, its slot becomes free
+void CTerrainMap::UnloadTerrain(GLint iTerrainNum)
+{
+	// Still loading: drop the slot, the loader result gets discarded
+	if (iTerrainNum >= 0 && iTerrainNum < static_cast<GLint>(m_vPendingTerrains.size()) && m_vPendingTerrains[iTerrainNum])
+	{
+		m_vPendingTerrains[iTerrainNum] = nullptr;
+		m_iNumTerrains--;
+		return;
+	}
+
+	CTerrain* pTerrain = nullptr;
+	if (!GetTerrainPtr(iTerrainNum, &pTerrain))
+	{
+		return;
+	}
+
+	// Edits of the terrain are lost with it, it comes back from its files
+	GLint iTerrainCoordX, iTerrainCoordZ;
+	pTerrain->GetTerrainCoords(&iTerrainCoordX, &iTerrainCoordZ);
+	m_EditHistory.ForgetTerrain(iTerrainCoordX, iTerrainCoordZ);
+
+	CTerrain::Delete(pTerrain);
+	m_vLoadedTerrains[iTerrainNum] = nullptr;
+	m_iNumTerrains--;
+}
+
+// Give the area back to the pool, its objects leave the physics world
+void CTerrainMap::UnloadArea(GLint iAreaNum)
+{
+	CTerrainAreaData* pArea = nullptr;
+	if (!GetAreaPtr(iAreaNum, &pArea))
+	{
+		return;
 	}
 
-	return false;
+	CTerrainAreaData::Delete(pArea);
+	m_vLoadedAreas[iAreaNum] = nullptr;
+	m_iNumAreas--;
 }
 
 void CTerrainMap::TexturesetBindlessSetup()
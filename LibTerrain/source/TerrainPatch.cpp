@@ -3,6 +3,8 @@
 
 CTerrainPatch::CTerrainPatch()
 {
+	m_uiWaterVBO = 0;
+	m_uiWaterIBO = 0;
 	Clear();
 }
 
@@ -13,20 +15,7 @@ CTerrainPatch::~CTerrainPatch()
 
 void CTerrainPatch::Clear()
 {
-	if (m_uiVBO)
-	{
-		glDeleteBuffers(1, &m_uiVBO);
-		m_uiVBO = 0;
-	}
-
-	if (m_uiIBO)
-	{
-		glDeleteBuffers(1, &m_uiIBO);
-		m_uiIBO = 0;
-	}
-
-	m_vecVertices.clear();
-	m_vecIndices.clear();
+	ResetData();
 
 	if (m_uiWaterVBO)
 	{
@@ -40,6 +29,16 @@ void CTerrainPatch::Clear()
 		m_uiWaterIBO = 0;
 	}
 
+	m_lWaterVBOSize = 0;
+	m_lWaterIBOSize = 0;
+}
+
+// Safe without a GL context, the terrain rebuilds patches on the job system
+void CTerrainPatch::ResetData()
+{
+	m_vecVertices.clear();
+	m_vecIndices.clear();
+
 	m_vecWaterVertices.clear();
 	m_vecWaterIndices.clear();
 
@@ -60,29 +59,6 @@ void CTerrainPatch::Clear()
 	m_fPatchWaterHeight = 0.0f;
 }
 
-void CTerrainPatch::GenerateGLState()
-{
-	// Create VBO
-	if (!m_uiVBO)
-	{
-		glCreateBuffers(1, &m_uiVBO);
-	}
-
-	// Allocate storage for VBO
-	const GLsizeiptr vertexBufferSize = m_vecVertices.size() * sizeof(TTerrainVertex);
-	glNamedBufferStorage(m_uiVBO, vertexBufferSize, m_vecVertices.data(), GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
-
-	// Create IBO
-	if (!m_uiIBO)
-	{
-		glCreateBuffers(1, &m_uiIBO);
-	}
-
-	// Allocate storage for IBO
-	const GLsizeiptr indexBufferSize = m_vecIndices.size() * sizeof(GLuint);
-	glNamedBufferStorage(m_uiIBO, indexBufferSize, m_vecIndices.data(), GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
-}
-
 void CTerrainPatch::GenerateWaterGLState()
 {
 	// Create VBO
@@ -92,14 +68,23 @@ void CTerrainPatch::GenerateWaterGLState()
 		return;
 	}
 
-	if (!m_uiWaterVBO)
+	// Storage is immutable, a buffer too small is replaced and one large enough is only refilled
+	const GLsizeiptr vertexBufferSize = m_vecWaterVertices.size() * sizeof(TTerrainWaterVertex);
+	if (m_uiWaterVBO && vertexBufferSize <= m_lWaterVBOSize)
 	{
-		glCreateBuffers(1, &m_uiWaterVBO);
+		glNamedBufferSubData(m_uiWaterVBO, 0, vertexBufferSize, m_vecWaterVertices.data());
 	}
+	else
+	{
+		if (m_uiWaterVBO)
+		{
+			glDeleteBuffers(1, &m_uiWaterVBO);
+		}
 
-	// Allocate storage for VBO
-	const GLsizeiptr vertexBufferSize = m_vecWaterVertices.size() * sizeof(TTerrainWaterVertex);
-	glNamedBufferStorage(m_uiWaterVBO, vertexBufferSize, m_vecWaterVertices.data(), GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers(1, &m_uiWaterVBO);
+		glNamedBufferStorage(m_uiWaterVBO, vertexBufferSize, m_vecWaterVertices.data(), GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+		m_lWaterVBOSize = vertexBufferSize;
+	}
 
 	// Create IBO
 	if (m_vecWaterIndices.empty())
@@ -108,38 +93,21 @@ void CTerrainPatch::GenerateWaterGLState()
 		return;
 	}
 
-	if (!m_uiWaterIBO)
-	{
-		glCreateBuffers(1, &m_uiWaterIBO);
-	}
-
-	// Allocate storage for IBO
 	const GLsizeiptr indexBufferSize = m_vecWaterIndices.size() * sizeof(GLuint);
-	glNamedBufferStorage(m_uiWaterIBO, indexBufferSize, m_vecWaterIndices.data(), GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
-}
-
-void CTerrainPatch::UpdateBuffers()
-{
-	if (m_uiVBO)
+	if (m_uiWaterIBO && indexBufferSize <= m_lWaterIBOSize)
 	{
-		void* ptr = glMapNamedBuffer(m_uiVBO, GL_WRITE_ONLY);
-		if (ptr)
-		{
-			const GLsizeiptr vertexBufferSize = m_vecVertices.size() * sizeof(TTerrainVertex);
-			memcpy(ptr, m_vecVertices.data(), vertexBufferSize);
-			glUnmapNamedBuffer(m_uiVBO);
-		}
+		glNamedBufferSubData(m_uiWaterIBO, 0, indexBufferSize, m_vecWaterIndices.data());
 	}
-
-	if (m_uiIBO)
+	else
 	{
-		void* ptr = glMapNamedBuffer(m_uiIBO, GL_WRITE_ONLY);
-		if (ptr)
+		if (m_uiWaterIBO)
 		{
-			const GLsizeiptr vertexBufferSize = m_vecIndices.size() * sizeof(GLuint);
-			memcpy(ptr, m_vecIndices.data(), vertexBufferSize);
-			glUnmapNamedBuffer(m_uiIBO);
+			glDeleteBuffers(1, &m_uiWaterIBO);
 		}
+
+		glCreateBuffers(1, &m_uiWaterIBO);
+		glNamedBufferStorage(m_uiWaterIBO, indexBufferSize, m_vecWaterIndices.data(), GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+		m_lWaterIBOSize = indexBufferSize;
 	}
 }
 
@@ -196,30 +164,8 @@ void CTerrainPatch::InitPatchVertices()
 
 void CTerrainPatch::InitPatchIndices()
 {
-	m_vecIndices.clear();
-	m_vecIndices.reserve(TERRAIN_PATCHSIZE * TERRAIN_PATCHSIZE * 6);
-
-	for (GLint iZ = 0; iZ < m_iPatchDepth - 1; iZ++)
-	{
-		for (GLint iX = 0; iX < m_iPatchWidth - 1; iX++)
-		{
-			// Vertex indices of the quad
-			GLint iTopLeft = iZ * m_iPatchWidth + iX;
-			GLint iTopRight = iZ * m_iPatchWidth + (iX + 1);
-			GLint iBottomLeft = (iZ + 1) * m_iPatchWidth + iX;
-			GLint iBottomRight = (iZ + 1) * m_iPatchWidth + (iX + 1);
-
-			// Triangle 1
-			m_vecIndices.push_back(iTopLeft);
-			m_vecIndices.push_back(iBottomLeft);
-			m_vecIndices.push_back(iTopRight);
-
-			// Triangle 2
-			m_vecIndices.push_back(iTopRight);
-			m_vecIndices.push_back(iBottomLeft);
-			m_vecIndices.push_back(iBottomRight);
-		}
-	}
+	// Same list as the shared GPU index buffer, kept for the normals
+	CTerrainVAO::BuildPatchIndices(m_vecIndices);
 }
 
 void CTerrainPatch::CalculatePatchNormals()
@@ -256,37 +202,6 @@ void CTerrainPatch::CalculatePatchNormals()
 	}
 }
 
-void CTerrainPatch::RenderPatch()
-{
-	if (!m_uiVBO || !m_uiIBO)
-	{
-		return;
-	}
-
-	static GLuint uiVAO = CTerrainVAO::GetVAO();
-	if (uiVAO)
-	{
-		// Bind the shared VAO
-		glBindVertexArray(uiVAO);
-
-		// Bind this patch's VBO to the VAO's binding point 0
-		glVertexArrayVertexBuffer(uiVAO, 0, m_uiVBO, 0, sizeof(TTerrainVertex));
-
-		// Bind this patch's IBO to the VAO
-		glVertexArrayElementBuffer(uiVAO, m_uiIBO);
-
-		// Draw
-		// Set number of control points per patch (must match tessellation control shader)
-		glPatchParameteri(GL_PATCH_VERTICES, 3);
-
-		// Draw as patches, not triangles
-		glDrawElements(GL_PATCHES, static_cast<GLsizei>(m_vecIndices.size()), GL_UNSIGNED_INT, nullptr);
-
-		// Reset to Zero
-		glBindVertexArray(0);
-	}
-}
-
 void CTerrainPatch::InitWaterVertices()
 {
 	m_vecWaterVertices.resize(PATCH_VERTEX_COUNT);
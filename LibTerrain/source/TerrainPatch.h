@@ -12,11 +12,11 @@ public:
 	~CTerrainPatch();
 
 	void Clear();
+	// CPU side of Clear(), keeps the water buffers for GenerateWaterGLState
+	void ResetData();
 
-	void GenerateGLState();
 	void GenerateWaterGLState();
 
-	void UpdateBuffers();
 	void UpdateWaterBuffers();
 
 	void InitPatchVertices();
@@ -24,8 +24,6 @@ public:
 
 	void CalculatePatchNormals();
 
-	void RenderPatch();
-
 	void InitWaterVertices();
 	void InitWaterIndices();
 
@@ -64,15 +62,15 @@ public:
 	void SetWaterHeight(float fHeight);
 
 private:
-	// OpenGL Patch Data
-	GLuint m_uiVBO;
-	GLuint m_uiIBO;
+	// Patch Data (uploaded into the owner terrain vertex buffer)
 	std::vector<TTerrainVertex> m_vecVertices;
 	std::vector<GLuint> m_vecIndices;
 
 	// OpenGL Water Data
 	GLuint m_uiWaterVBO;
 	GLuint m_uiWaterIBO;
+	GLsizeiptr m_lWaterVBOSize; // Storage sizes, reused while the data fits
+	GLsizeiptr m_lWaterIBOSize;
 	std::vector<TTerrainWaterVertex> m_vecWaterVertices;
 	std::vector<GLuint> m_vecWaterIndices;
 
@@ -2,14 +2,56 @@
 
 #include "TerrainData.h"
 #include "../../LibGL/source/Utils.h"
-
+#include <vector>
+
+/**
+ * CTerrainVAO - Vertex layout and index buffer shared by every terrain patch.
+ *
+ * All patches have the same (PATCH_XSIZE + 1) * (PATCH_ZSIZE + 1) vertex grid,
+ * so a single index buffer serves them all; each draw selects its patch with
+ * a base vertex, see CTerrain::BuildPatchDrawCommands.
+ */
 class CTerrainVAO final
 {
 public:
+	// Patch-local triangle list, the same for every patch
+	inline static void BuildPatchIndices(std::vector<GLuint>& vIndices)
+	{
+		vIndices.clear();
+		vIndices.reserve(PATCH_INDEX_COUNT);
+
+		const GLint iPatchWidth = PATCH_XSIZE + 1;
+
+		for (GLint iZ = 0; iZ < PATCH_ZSIZE; iZ++)
+		{
+			for (GLint iX = 0; iX < PATCH_XSIZE; iX++)
+			{
+				// Vertex indices of the quad
+				GLuint uiTopLeft = iZ * iPatchWidth + iX;
+				GLuint uiTopRight = iZ * iPatchWidth + (iX + 1);
+				GLuint uiBottomLeft = (iZ + 1) * iPatchWidth + iX;
+				GLuint uiBottomRight = (iZ + 1) * iPatchWidth + (iX + 1);
+
+				// Triangle 1
+				vIndices.push_back(uiTopLeft);
+				vIndices.push_back(uiBottomLeft);
+				vIndices.push_back(uiTopRight);
+
+				// Triangle 2
+				vIndices.push_back(uiTopRight);
+				vIndices.push_back(uiBottomLeft);
+				vIndices.push_back(uiBottomRight);
+			}
+		}
+	}
+
 	inline static void Initialize()
 	{
 		if (!ms_bInitialized)
 		{
+			std::vector<GLuint> vIndices;
+			BuildPatchIndices(vIndices);
+
 			if (IsGLVersionHigher(4, 5))
 			{
 				glCreateVertexArrays(1, &ms_uiVAO);
@@ -32,6 +74,11 @@ public:
 				glEnableVertexArrayAttrib(ms_uiVAO, iNormals);
 				glVertexArrayAttribFormat(ms_uiVAO, iNormals, 3, GL_FLOAT, GL_FALSE, offsetof(TTerrainVertex, m_v3Normals));
 				glVertexArrayAttribBinding(ms_uiVAO, iNormals, 0);
+
+				// Shared index buffer
+				glCreateBuffers(1, &ms_uiIBO);
+				glNamedBufferStorage(ms_uiIBO, vIndices.size() * sizeof(GLuint), vIndices.data(), 0);
+				glVertexArrayElementBuffer(ms_uiVAO, ms_uiIBO);
 			}
 			else
 			{
@@ -61,6 +108,11 @@ public:
 				glEnableVertexAttribArray(iNormals);
 				glVertexAttribPointer(iNormals, 3, GL_FLOAT, GL_FALSE, sizeof(TTerrainVertex), (const void*)offsetof(TTerrainVertex, m_v3Normals));
 
+				// Shared index buffer (element binding is VAO state)
+				glGenBuffers(1, &ms_uiIBO);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ms_uiIBO);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, vIndices.size() * sizeof(GLuint), vIndices.data(), GL_STATIC_DRAW);
+
 				// Unbind VAO
 				glBindVertexArray(0);
 
@@ -73,10 +125,17 @@ public:
 
 	inline static void Destroy()
 	{
+		if (ms_uiIBO)
+		{
+			glDeleteBuffers(1, &ms_uiIBO);
+			ms_uiIBO = 0;
+		}
+
 		if (ms_uiVAO)
 		{
 			glDeleteVertexArrays(1, &ms_uiVAO);
 			ms_uiVAO = 0;
+			ms_bInitialized = false;
 		}
 	}
 
@@ -85,8 +144,14 @@ public:
 		return (ms_uiVAO);
 	}
 
+	inline static GLuint GetIBO()
+	{
+		return (ms_uiIBO);
+	}
+
 private:
 	inline static GLuint ms_uiVAO = 0;
+	inline static GLuint ms_uiIBO = 0;
 	inline static bool ms_bInitialized = false;
 };
 
@@ -4,7 +4,22 @@ layout (location = 0) in vec3 m_v3Pos;
 layout (location = 1) in vec2 m_v2TexCoord;
 layout (location = 2) in vec3 m_v3Normals;
 
-uniform mat4 u_matViewProjection;
+// Per-view uniforms, must match TFrameUniforms (LibGL/source/UniformBuffer.h)
+layout (std140, row_major, binding = 0) uniform FrameUniforms
+{
+    mat4 u_mat4View;
+    mat4 u_mat4Projection;
+    mat4 u_mat4ViewProj;
+    mat4 u_mat4InvView;
+    mat4 u_mat4InvProjection;
+    vec4 u_v4CameraPos;
+    vec4 u_v4LightDir;
+    vec4 u_v4LightPos;
+    vec4 u_v4LightColor;
+    vec4 u_v4ClipPlane;
+    vec2 u_v2Resolution;
+    float u_fTime;
+};
 
 out vec3 v3WorldPos;
 out vec2 v2TexCoord;
@@ -16,5 +31,5 @@ void main()
 	v2TexCoord = m_v2TexCoord;
 	v3Normals = m_v3Normals;
 
-	//gl_Position = u_matViewProjection * vec4(m_v3Pos, 1.0f);
+	//gl_Position = u_mat4ViewProj * vec4(m_v3Pos, 1.0f);
 }
\ No newline at end of file
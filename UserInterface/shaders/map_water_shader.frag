@@ -25,10 +25,22 @@ uniform float specularPower = 20.0f;
 uniform float near = 1.0f;
 uniform float far = 1000.0f;
 
-uniform vec3 u_v3CameraPosition;
-uniform vec3 v3LightDirection;
-uniform vec3 v3LightColor;
-uniform vec3 v3LightPos;
+// Per-view uniforms, must match TFrameUniforms (LibGL/source/UniformBuffer.h)
+layout (std140, row_major, binding = 0) uniform FrameUniforms
+{
+    mat4 u_mat4View;
+    mat4 u_mat4Projection;
+    mat4 u_mat4ViewProj;
+    mat4 u_mat4InvView;
+    mat4 u_mat4InvProjection;
+    vec4 u_v4CameraPos;
+    vec4 u_v4LightDir;
+    vec4 u_v4LightPos;
+    vec4 u_v4LightColor;
+    vec4 u_v4ClipPlane;
+    vec2 u_v2Resolution;
+    float u_fTime;
+};
 
 void main()
 {
@@ -71,12 +83,12 @@ void main()
 	refractiveFactor = pow(refractiveFactor, 0.5);
 	refractiveFactor = clamp(refractiveFactor, 0.001, 0.999);
 
-	vec3 FromLight = v3LightPos - v3WorldPos;
+	vec3 FromLight = u_v4LightPos.xyz - v3WorldPos;
 
-	vec3 reflectedLight = reflect(normalize(v3WorldPos - v3LightPos), normal);
+	vec3 reflectedLight = reflect(normalize(v3WorldPos - u_v4LightPos.xyz), normal);
 	float specular = max(dot(reflectedLight, viewVector), 0.0);
 	specular = pow(specular, specularPower);
-	vec3 specularHighlights = v3LightColor * specular * 0.5;
+	vec3 specularHighlights = u_v4LightColor.rgb * specular * 0.5;
 
 
 	//FragColor = mix(reflectColor, refractColor, refractiveFactor);
@@ -13,9 +13,24 @@ out vec4 v4Color;
 out vec4 v4ClipSpaceCoords; // Calculated here, but used in fragment shader to calculate clipped space coords
 out vec3 v3VertexToCamera;	// Calcualted here, but used in fragment shader to calculate distance to camera
 
-uniform mat4 ViewProjectionMatrix;
+// Per-view uniforms, must match TFrameUniforms (LibGL/source/UniformBuffer.h)
+layout (std140, row_major, binding = 0) uniform FrameUniforms
+{
+    mat4 u_mat4View;
+    mat4 u_mat4Projection;
+    mat4 u_mat4ViewProj;
+    mat4 u_mat4InvView;
+    mat4 u_mat4InvProjection;
+    vec4 u_v4CameraPos;
+    vec4 u_v4LightDir;
+    vec4 u_v4LightPos;
+    vec4 u_v4LightColor;
+    vec4 u_v4ClipPlane;
+    vec2 u_v2Resolution;
+    float u_fTime;
+};
+
 uniform float u_fMoveFactor;
-uniform vec3 v3CameraPos;
 
 
 // New Float Values For Water
@@ -46,8 +61,8 @@ void main()
     v3NewPos.y += GerstnerWave(normalize(vec2(0.0, 1.0)), 12.0, 0.06, u_fMoveFactor * 1.2);
     v3NewPos.y += GerstnerWave(normalize(vec2(-1.0, 0.7)), 22.0, 0.07, u_fMoveFactor * 0.8);
 
-    v4ClipSpaceCoords = ViewProjectionMatrix * vec4(v3NewPos, 1.0f);
-    v3VertexToCamera = v3CameraPos - v3NewPos;
+    v4ClipSpaceCoords = u_mat4ViewProj * vec4(v3NewPos, 1.0f);
+    v3VertexToCamera = u_v4CameraPos.xyz - v3NewPos;
 
     gl_Position = v4ClipSpaceCoords;
 }
\ No newline at end of file
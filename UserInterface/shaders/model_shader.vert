@@ -4,9 +4,31 @@ layout (location = 0) in vec3 m_v3Position;
 layout (location = 1) in vec3 m_v3Normals;
 layout (location = 2) in vec2 m_v2TexCoord;
 
-// Per-instance attributes (assuming you set up the attribute pointers for these)
-layout (location = 3) in mat4 aInstanceWVP;   // Your WVP_MAT_BUFFER
-layout (location = 7) in mat4 aInstanceWorld; // Your WORLD_MAT_BUFFER
+// Per-instance index into the world matrices, only the visible instances are drawn
+layout (location = 3) in uint m_uiInstance;
+
+// World matrices of every instance of the group (INSTANCE_MATRICES_BINDING of CMesh)
+layout (std430, row_major, binding = 3) readonly buffer InstanceMatrices
+{
+    mat4 m_mat4InstanceWorld[];
+};
+
+// Per-view uniforms, must match TFrameUniforms (LibGL/source/UniformBuffer.h)
+layout (std140, row_major, binding = 0) uniform FrameUniforms
+{
+    mat4 u_mat4View;
+    mat4 u_mat4Projection;
+    mat4 u_mat4ViewProj;
+    mat4 u_mat4InvView;
+    mat4 u_mat4InvProjection;
+    vec4 u_v4CameraPos;
+    vec4 u_v4LightDir;
+    vec4 u_v4LightPos;
+    vec4 u_v4LightColor;
+    vec4 u_v4ClipPlane;
+    vec2 u_v2Resolution;
+    float u_fTime;
+};
 
 out vec3 v3WorldPos;
 out vec3 v3Normals;
@@ -14,10 +36,11 @@ out vec2 v2TexCoord;
 
 void main()
 {
-    mat4 model = transpose(aInstanceWorld);
-    v3WorldPos = vec3(aInstanceWVP * vec4(m_v3Position, 1.0));
-    v3Normals = mat3(transpose(inverse(aInstanceWVP))) * m_v3Normals;
-    v2TexCoord = m_v2TexCoord;
-    gl_Position = model * vec4(m_v3Position, 1.0);
+    mat4 mat4World = m_mat4InstanceWorld[m_uiInstance];
+    vec4 v4WorldPos = mat4World * vec4(m_v3Position, 1.0);
 
+    v3WorldPos = v4WorldPos.xyz;
+    v3Normals = mat3(transpose(inverse(mat4World))) * m_v3Normals;
+    v2TexCoord = m_v2TexCoord;
+    gl_Position = u_mat4ViewProj * v4WorldPos;
 }
@@ -94,6 +94,13 @@ void CUserInterface::RenderMapsUI()
 	{
 		pTerrainManager->SaveMap();
 	}
+
+	ImGui::SameLine();
+	// "Convert Map" writes the binary chunk of every terrain still in the raw format
+	if (ImGui::Button("Convert Map", buttonSize))
+	{
+		pTerrainManager->ConvertTerrainFiles();
+	}
 }
 
 void CUserInterface::RenderCreateNewMapPopUP(bool& showPopup, CTerrainManager* pTerrainManager)
@@ -684,6 +691,8 @@ void CUserInterface::Render()
 
 	ImGui::NewLine();
 	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+	ImGui::Text("Culled terrain patches: %d", m_pWindow->GetTerrainManager()->GetTerrainMapPtr()->GetCulledPatchesNum());
+	ImGui::Text("Water planes: %d", m_pWindow->GetTerrainManager()->GetTerrainMapPtr()->GetNumWaterPlanes());
 	ImGui::End();
 
 	//actual drawing
@@ -712,6 +721,19 @@ void CUserInterface::Update()
 	if (m_bShowDemoWindow)
 		ImGui::ShowDemoWindow(&m_bShowDemoWindow);
 
+	// Brush strokes undo and redo, text fields keep these keys for themselves
+	if (!ImGui::GetIO().WantTextInput)
+	{
+		if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z))
+		{
+			m_pWindow->GetTerrainManager()->UndoEdit();
+		}
+		else if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y))
+		{
+			m_pWindow->GetTerrainManager()->RedoEdit();
+		}
+	}
+
 	ImGui::GetStyle().FramePadding = ImVec2(8, 6); // Padding for menu items
 	ImGui::PushStyleColor(ImGuiCol_MenuBarBg, ImVec4(0.1f, 0.1f, 0.1f, 1.0f)); // Dark background
 
@@ -741,14 +763,16 @@ void CUserInterface::Update()
 
 		if (ImGui::BeginMenu("Edit"))
 		{
-			if (ImGui::MenuItem("Undo", "Ctrl+Z"))
+			CTerrainManager* pTerrainManager = m_pWindow->GetTerrainManager();
+
+			if (ImGui::MenuItem("Undo", "Ctrl+Z", false, pTerrainManager->CanUndoEdit()))
 			{
-				/* Action */
+				pTerrainManager->UndoEdit();
 			}
-			if (ImGui::MenuItem("Redo", "Ctrl+Y", false, false))
+			if (ImGui::MenuItem("Redo", "Ctrl+Y", false, pTerrainManager->CanRedoEdit()))
 			{
-				// Disabled
-			} 
+				pTerrainManager->RedoEdit();
+			}
 			ImGui::EndMenu();
 		}
 